@@ -26,6 +26,7 @@
 #include <net-snmp/agent/net-snmp-agent-includes.h>
 
 #include <net-snmp/agent/bulk_to_next.h>
+#include <net-snmp/agent/agent_workers.h>
 
 netsnmp_feature_child_of(agent_handler, libnetsnmpagent)
 
@@ -782,6 +783,7 @@ void
 netsnmp_handler_registration_free(netsnmp_handler_registration *reginfo)
 {
     if (reginfo != NULL) {
+        netsnmp_agent_workers_wait_reginfo(reginfo);
         netsnmp_handler_free(reginfo->handler);
         SNMP_FREE(reginfo->handlerName);
         SNMP_FREE(reginfo->contextName);
@@ -77,7 +77,8 @@ netsnmp_feature_child_of(agent_registry_all, libnetsnmpagent)
 netsnmp_feature_child_of(unregister_mib_table_row, agent_registry_all)
 
 /** @defgroup agent_lookup_cache Lookup cache, storing the registered OIDs.
- *     Maintain the cache used for locating sub-trees and OIDs.
+ *     Kept for compatibility only: lookups now use the subtree index,
+ *     see @ref agent_subtree_index.
  *   @ingroup agent_registry
  *
  * @{
@@ -89,29 +90,10 @@ netsnmp_feature_child_of(unregister_mib_table_row, agent_registry_all)
 #define SUBTREE_MAX_CACHE_SIZE     32
 int lookup_cache_size = 0; /*enabled later after registrations are loaded */
 
-typedef struct lookup_cache_s {
-   netsnmp_subtree *next;
-   netsnmp_subtree *previous;
-} lookup_cache;
-
-typedef struct lookup_cache_context_s {
-   char *context;
-   struct lookup_cache_context_s *next;
-   int thecachecount;
-   int currentpos;
-   lookup_cache cache[SUBTREE_MAX_CACHE_SIZE];
-} lookup_cache_context;
-
-static lookup_cache_context *thecontextcache = NULL;
-
-/** Set the lookup cache size for optimized agent registration performance.
- * Note that it is only used by master agent - sub-agent doesn't need the cache.
- * The rough guide is that the cache size should be equal to the maximum
- * number of simultaneous managers you expect to talk to the agent (M) times 80%
- * (or so, he says randomly) the average number (N) of varbinds you
- * expect to receive in a given request for a manager.  ie, M times N.
- * Bigger does NOT necessarily mean better.  Certainly 16 should be an
- * upper limit.  32 is the hard coded limit.
+/** Set the lookup cache size.
+ * The lookup cache has been replaced by a per-context index of the
+ * registered subtrees (see @ref agent_subtree_index), which needs no
+ * tuning; the value is only remembered for netsnmp_get_lookup_cache_size().
  *
  * @param newsize set to the maximum size of a cache for a given
  * context.  Set to 0 to completely disable caching, or to -1 to set
@@ -128,7 +110,6 @@ netsnmp_set_lookup_cache_size(int newsize) {
 }
 
 /** Retrieves the current value of the lookup cache size
- *  Should be called from master agent only - sub-agent doesn't need the cache.
  *
  *  @return the current lookup cache size
  */
@@ -137,148 +118,261 @@ netsnmp_get_lookup_cache_size(void) {
     return lookup_cache_size;
 }
 
-/** Returns lookup cache entry for the context of given name.
- *
- *  @param context Name of the context. Name is case sensitive.
+/**  @} */
+/* End of Lookup cache code */
+
+subtree_context_cache *context_subtrees = NULL;
+
+/** @defgroup agent_subtree_index Subtree index, a radix tree of the registered OIDs.
+ *     For each context, maps the start OID of every subtree in the list
+ *     of registrations to that subtree, so that finding the subtree
+ *     responsible for an OID takes time proportional to the length of
+ *     the OID rather than to the number of registrations.  The list is
+ *     still what is used to walk the registrations in order.
+ *
+ *     The index is kept up to date as subtrees are loaded, split, joined
+ *     and unloaded.  A context without an index (a new one, or one whose
+ *     index could not be updated) gets it rebuilt from the list on the
+ *     next lookup.
+ *   @ingroup agent_registry
  *
- *  @return the lookup cache context
+ * @{
+ */
+
+typedef struct netsnmp_subtree_index_s {
+    oid              subid;
+    netsnmp_subtree *subtree;       /* registered at this OID, or NULL */
+    struct netsnmp_subtree_index_s **children; /* sorted by subid */
+    int              nchildren;
+    int              maxchildren;
+} subtree_index;
+
+/** @private
+ *  Returns the context cache entry of the given context name, or NULL.
  */
-NETSNMP_STATIC_INLINE lookup_cache_context *
-get_context_lookup_cache(const char *context) {
-    lookup_cache_context *ptr;
-    if (!context)
-        context = "";
-
-    for(ptr = thecontextcache; ptr; ptr = ptr->next) {
-        if (strcmp(ptr->context, context) == 0)
+static subtree_context_cache *
+subtree_index_context(const char *context_name)
+{
+    subtree_context_cache *ptr;
+
+    if (!context_name)
+        context_name = "";
+    for (ptr = context_subtrees; ptr != NULL; ptr = ptr->next)
+        if (ptr->context_name != NULL &&
+            strcmp(ptr->context_name, context_name) == 0)
             break;
-    }
-    if (!ptr) {
-        if (netsnmp_subtree_find_first(context)) {
-            ptr = SNMP_MALLOC_TYPEDEF(lookup_cache_context);
-            ptr->next = thecontextcache;
-            ptr->context = strdup(context);
-            thecontextcache = ptr;
-        } else {
-            return NULL;
-        }
-    }
     return ptr;
 }
 
-/** Adds an entry to the Lookup Cache under specified context name.
- *
- *  @param context  Name of the context. Name is case sensitive.
- *
- *  @param next     Next subtree item.
- *
- *  @param previous Previous subtree item.
+/** @private
+ *  Binary search for a child node.  Returns 1 and its position if there
+ *  is a child for subid, or 0 and the position to insert one at.
  */
-NETSNMP_STATIC_INLINE void
-lookup_cache_add(const char *context,
-                 netsnmp_subtree *next, netsnmp_subtree *previous) {
-    lookup_cache_context *cptr;
+static int
+subtree_index_child(const subtree_index *node, oid subid, int *pos)
+{
+    int lo = 0, hi = node->nchildren - 1, mid;
 
-    if ((cptr = get_context_lookup_cache(context)) == NULL)
-        return;
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+        if (node->children[mid]->subid == subid) {
+            *pos = mid;
+            return 1;
+        }
+        if (node->children[mid]->subid < subid)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    *pos = lo;
+    return 0;
+}
 
-    if (cptr->thecachecount < lookup_cache_size)
-        cptr->thecachecount++;
+/** @private
+ *  Frees an index node and everything below it.
+ */
+static void
+subtree_index_free(subtree_index *node)
+{
+    int i;
 
-    cptr->cache[cptr->currentpos].next = next;
-    cptr->cache[cptr->currentpos].previous = previous;
+    if (node == NULL)
+        return;
+    for (i = 0; i < node->nchildren; i++)
+        subtree_index_free(node->children[i]);
+    free(node->children);
+    free(node);
+}
 
-    if (++cptr->currentpos >= lookup_cache_size)
-        cptr->currentpos = 0;
+/** @private
+ *  Drops the index of a context; it gets rebuilt on the next lookup.
+ */
+static void
+subtree_index_invalidate(subtree_context_cache *ptr)
+{
+    if (ptr != NULL) {
+        subtree_index_free(ptr->subtree_index);
+        ptr->subtree_index = NULL;
+    }
 }
 
 /** @private
- *  Replaces next and previous pointer in given Lookup Cache.
- *
- *  @param ptr      Lookup Cache pointer.
- *
- *  @param next     Next subtree item.
+ *  Makes sub the subtree found at its start OID.
  *
- *  @param previous Previous subtree item.
+ *  @return 0 on success, -1 if out of memory.
  */
-NETSNMP_STATIC_INLINE void
-lookup_cache_replace(lookup_cache *ptr,
-                     netsnmp_subtree *next, netsnmp_subtree *previous) {
+static int
+subtree_index_insert(subtree_index *node, netsnmp_subtree *sub)
+{
+    subtree_index *child, **children;
+    size_t i;
+    int pos;
 
-    ptr->next = next;
-    ptr->previous = previous;
+    for (i = 0; i < sub->start_len; i++) {
+        if (subtree_index_child(node, sub->start_a[i], &pos)) {
+            node = node->children[pos];
+            continue;
+        }
+        if (node->nchildren == node->maxchildren) {
+            children = (subtree_index **)
+                realloc(node->children, (node->maxchildren ?
+                                         2 * node->maxchildren : 2) *
+                        sizeof(subtree_index *));
+            if (children == NULL)
+                return -1;
+            node->children = children;
+            node->maxchildren = node->maxchildren ?
+                2 * node->maxchildren : 2;
+        }
+        child = SNMP_MALLOC_TYPEDEF(subtree_index);
+        if (child == NULL)
+            return -1;
+        child->subid = sub->start_a[i];
+        memmove(&node->children[pos + 1], &node->children[pos],
+                (node->nchildren - pos) * sizeof(subtree_index *));
+        node->children[pos] = child;
+        node->nchildren++;
+        node = child;
+    }
+    node->subtree = sub;
+    return 0;
 }
 
-/** Finds an entry in the Lookup Cache.
- *
- *  @param context  Case sensitive name of the context.
- *
- *  @param name     The OID we're searching for.
- *
- *  @param name_len Number of sub-ids (single integers) in the OID.
- *
- *  @param retcmp   Value set to snmp_oid_compare() call result.
- *                  The value, if set, is always nonnegative.
- *
- *  @return gives Lookup Cache entry, or NULL if not found.
+/** @private
+ *  Removes the entry for name if it refers to sub, pruning nodes that
+ *  are left empty.
  *
- *  @see snmp_oid_compare()
+ *  @return 1 if node is now empty and may be freed.
  */
-NETSNMP_STATIC_INLINE lookup_cache *
-lookup_cache_find(const char *context, const oid *name, size_t name_len,
-                  int *retcmp) {
-    lookup_cache_context *cptr;
-    lookup_cache *ret = NULL;
-    int cmp;
-    int i;
+static int
+subtree_index_delete(subtree_index *node, const oid *name, size_t len,
+                     const netsnmp_subtree *sub)
+{
+    int pos;
+
+    if (len == 0) {
+        if (node->subtree == sub)
+            node->subtree = NULL;
+    } else if (subtree_index_child(node, name[0], &pos) &&
+               subtree_index_delete(node->children[pos], name + 1, len - 1,
+                                    sub)) {
+        subtree_index_free(node->children[pos]);
+        memmove(&node->children[pos], &node->children[pos + 1],
+                (node->nchildren - pos - 1) * sizeof(subtree_index *));
+        node->nchildren--;
+    }
+    return node->subtree == NULL && node->nchildren == 0;
+}
 
-    if ((cptr = get_context_lookup_cache(context)) == NULL)
-        return NULL;
+/** @private
+ *  Returns the index of a context, building it from the list of
+ *  registrations if needed, or NULL if that fails.
+ */
+static subtree_index *
+subtree_index_get(subtree_context_cache *ptr)
+{
+    netsnmp_subtree *sub;
 
-    for(i = 0; i < cptr->thecachecount && i < lookup_cache_size; i++) {
-        if (cptr->cache[i].previous->start_a)
-            cmp = snmp_oid_compare(name, name_len,
-                                   cptr->cache[i].previous->start_a,
-                                   cptr->cache[i].previous->start_len);
-        else
-            cmp = 1;
-        if (cmp >= 0) {
-            *retcmp = cmp;
-            ret = &(cptr->cache[i]);
+    if (ptr->subtree_index != NULL)
+        return ptr->subtree_index;
+    ptr->subtree_index = SNMP_MALLOC_TYPEDEF(subtree_index);
+    if (ptr->subtree_index == NULL)
+        return NULL;
+    for (sub = ptr->first_subtree; sub != NULL; sub = sub->next) {
+        if (subtree_index_insert(ptr->subtree_index, sub) < 0) {
+            snmp_log(LOG_WARNING, "out of memory indexing the registry\n");
+            subtree_index_invalidate(ptr);
+            return NULL;
         }
     }
-    return ret;
+    return ptr->subtree_index;
 }
 
 /** @private
- *  Clears cache count and position in Lookup Cache.
+ *  Records that sub is in the list of registrations of a context.
  */
-NETSNMP_STATIC_INLINE void
-invalidate_lookup_cache(const char *context) {
-    lookup_cache_context *cptr;
-    if ((cptr = get_context_lookup_cache(context)) != NULL) {
-        cptr->thecachecount = 0;
-        cptr->currentpos = 0;
-    }
+static void
+subtree_index_add(netsnmp_subtree *sub, const char *context_name)
+{
+    subtree_context_cache *ptr = subtree_index_context(context_name);
+
+    if (ptr != NULL && ptr->subtree_index != NULL &&
+        subtree_index_insert(ptr->subtree_index, sub) < 0)
+        subtree_index_invalidate(ptr);
 }
 
-void
-clear_lookup_cache(void) {
+/** @private
+ *  Records that sub is no longer in the list of registrations.  With
+ *  no context name, the indexes of all contexts are checked.
+ */
+static void
+subtree_index_remove(const netsnmp_subtree *sub, const char *context_name)
+{
+    subtree_context_cache *ptr;
 
-    lookup_cache_context *ptr = NULL, *next = NULL;
+    for (ptr = context_name ? subtree_index_context(context_name) :
+             context_subtrees; ptr != NULL;
+         ptr = context_name ? NULL : ptr->next)
+        if (ptr->subtree_index != NULL)
+            subtree_index_delete(ptr->subtree_index, sub->start_a,
+                                 sub->start_len, sub);
+}
 
-    ptr = thecontextcache;
-    while (ptr) {
-	next = ptr->next;
-	SNMP_FREE(ptr->context);
-	SNMP_FREE(ptr);
-	ptr = next;
+/** @private
+ *  Finds the last subtree that starts at or before name.
+ */
+static netsnmp_subtree *
+subtree_index_find_prev(const subtree_index *node, const oid *name,
+                        size_t len)
+{
+    const subtree_index *smaller;
+    netsnmp_subtree *found = NULL;
+    size_t i;
+    int pos, matched;
+
+    for (i = 0; ; i++) {
+        if (node->subtree)
+            found = node->subtree;
+        if (i == len)
+            break;
+        /*  Everything under the children before name[i] comes earlier;
+            the last of it is the rightmost leaf of the nearest one.  */
+        matched = subtree_index_child(node, name[i], &pos);
+        if (pos > 0) {
+            for (smaller = node->children[pos - 1]; smaller->nchildren > 0;
+                 smaller = smaller->children[smaller->nchildren - 1])
+                ;
+            found = smaller->subtree;
+        }
+        if (!matched)
+            break;
+        node = node->children[pos];
     }
-    thecontextcache = NULL; /* !!! */
+    return found;
 }
 
 /**  @} */
-/* End of Lookup cache code */
+/* End of Subtree index code */
 
 /** @defgroup agent_context_cache Context cache, storing the OIDs under their contexts.
  *     Maintain the cache used for locating sub-trees registered under different contexts.
@@ -286,8 +380,6 @@ clear_lookup_cache(void) {
  *
  * @{
  */
-subtree_context_cache *context_subtrees = NULL;
-
 /** Returns the top element of context subtrees cache.
  *  Use it if you wish to sweep through the cache elements.
  *  Note that the return may be NULL (cache may be empty).
@@ -366,6 +458,7 @@ netsnmp_remove_subtree(netsnmp_subtree *tree)
 {
     subtree_context_cache *ptr;
 
+    subtree_index_remove(tree, NULL);
     if (!tree->prev) {
         for (ptr = context_subtrees; ptr; ptr = ptr->next)
             if (ptr->first_subtree == tree)
@@ -403,6 +496,8 @@ netsnmp_subtree_replace_first(netsnmp_subtree *new_tree,
     for (ptr = context_subtrees; ptr != NULL; ptr = ptr->next) {
         if (ptr->context_name != NULL &&
 	    strcmp(ptr->context_name, context_name) == 0) {
+            if (ptr->first_subtree != new_tree)
+                subtree_index_invalidate(ptr);
             ptr->first_subtree = new_tree;
             return ptr->first_subtree;
         }
@@ -432,13 +527,13 @@ clear_context(void) {
 	    clear_subtree(t);
 	}
 
+        subtree_index_free(ptr->subtree_index);
         free(NETSNMP_REMOVE_CONST(char*, ptr->context_name));
         SNMP_FREE(ptr);
 
 	ptr = next;
     }
     context_subtrees = NULL; /* !!! */
-    clear_lookup_cache();
 }
 
 /**  @} */
@@ -617,6 +712,7 @@ netsnmp_subtree_join(netsnmp_subtree *root)
             /*
              * Probably need to free children too?  
              */
+            subtree_index_remove(s, NULL);
             for (c = s->children; c != NULL; c = d) {
                 d = c->children;
                 netsnmp_subtree_free(c);
@@ -825,6 +921,7 @@ netsnmp_subtree_load(netsnmp_subtree *new_sub, const char *context_name)
 	    }
 
             netsnmp_subtree_change_next(new_sub, tree2);
+            subtree_index_add(new_sub, context_name);
 
 #if 0
             /* The code below cannot be reached which is why it has been
@@ -845,6 +942,8 @@ netsnmp_subtree_load(netsnmp_subtree *new_sub, const char *context_name)
 			     tree1->start_a,   tree1->start_len) != 0) {
 	    tree1 = netsnmp_subtree_split(tree1, new_sub->start_a, 
 					  new_sub->start_len);
+	    if (tree1 != NULL)
+	        subtree_index_add(tree1, context_name);
 	}
 
         if (tree1 == NULL) {
@@ -867,7 +966,10 @@ netsnmp_subtree_load(netsnmp_subtree *new_sub, const char *context_name)
 
 	case -1:
 	    /*  Existing subtree contains new one.  */
-	    netsnmp_subtree_split(tree1, new_sub->end_a, new_sub->end_len);
+	    tree2 = netsnmp_subtree_split(tree1, new_sub->end_a,
+	                                  new_sub->end_len);
+	    if (tree2 != NULL)
+	        subtree_index_add(tree2, context_name);
 	    /* Fall Through */
 
 	case  0:
@@ -929,6 +1031,10 @@ netsnmp_subtree_load(netsnmp_subtree *new_sub, const char *context_name)
 		for (prev = new_sub->prev; prev != NULL;prev = prev->children){
                     netsnmp_subtree_change_next(prev, new_sub);
 		}
+
+		if (new_sub->prev == NULL)
+		    netsnmp_subtree_replace_first(new_sub, context_name);
+		subtree_index_add(new_sub, context_name);
 	    }
 	    break;
 
@@ -976,27 +1082,23 @@ netsnmp_subtree *
 netsnmp_subtree_find_prev(const oid *name, size_t len, netsnmp_subtree *subtree,
 			  const char *context_name)
 {
-    lookup_cache *lookup_cache = NULL;
+    subtree_context_cache *ptr;
+    subtree_index *idx;
     netsnmp_subtree *myptr = NULL, *previous = NULL;
-    int cmp = 1;
     size_t ll_off = 0;
 
-    if (subtree) {
-        myptr = subtree;
-    } else {
-	/* look through everything */
-        if (lookup_cache_size) {
-            lookup_cache = lookup_cache_find(context_name, name, len, &cmp);
-            if (lookup_cache) {
-                myptr = lookup_cache->next;
-                previous = lookup_cache->previous;
-            }
-            if (!myptr)
-                myptr = netsnmp_subtree_find_first(context_name);
-        } else {
-            myptr = netsnmp_subtree_find_first(context_name);
+    if (subtree == NULL || subtree->prev == NULL) {
+	/* look through everything, using the index if possible */
+        ptr = subtree_index_context(context_name);
+        if (ptr != NULL &&
+            (subtree == NULL || subtree == ptr->first_subtree)) {
+            idx = subtree_index_get(ptr);
+            if (idx != NULL)
+                return subtree_index_find_prev(idx, name, len);
+            subtree = ptr->first_subtree;
         }
     }
+    myptr = subtree;
 
     /*
      * this optimization causes a segfault on sf cf alpha-linux1.
@@ -1030,13 +1132,6 @@ netsnmp_subtree_find_prev(const oid *name, size_t len, netsnmp_subtree *subtree,
 #else
         if (snmp_oid_compare(name, len, myptr->start_a, myptr->start_len) < 0) {
 #endif
-            if (lookup_cache_size && previous && cmp) {
-                if (lookup_cache) {
-                    lookup_cache_replace(lookup_cache, myptr, previous);
-                } else {
-                    lookup_cache_add(context_name, myptr, previous);
-                }
-            }
             return previous;
         }
     }
@@ -1137,7 +1232,6 @@ netsnmp_register_mib(const char *moduleName,
     netsnmp_subtree *subtree, *sub2;
     int             res;
     struct register_parameters reg_parms;
-    int old_lookup_cache_val = netsnmp_get_lookup_cache_size();
 
     if (moduleName == NULL ||
         mibloc     == NULL) {
@@ -1209,7 +1303,6 @@ netsnmp_register_mib(const char *moduleName,
     subtree->flags |= SUBTREE_ATTACHED;
     subtree->global_cacheid = reginfo->global_cacheid;
 
-    netsnmp_set_lookup_cache_size(0);
     res = netsnmp_subtree_load(subtree, context);
 
     /*  If registering a range, use the first subtree as a template for the
@@ -1223,8 +1316,6 @@ netsnmp_register_mib(const char *moduleName,
 	    if (sub2 == NULL) {
                 unregister_mib_context(mibloc, mibloclen, priority,
                                        range_subid, range_ubound, context);
-                netsnmp_set_lookup_cache_size(old_lookup_cache_val);
-                invalidate_lookup_cache(context);
                 return MIB_REGISTRATION_FAILED;
             }
 
@@ -1245,15 +1336,11 @@ netsnmp_register_mib(const char *moduleName,
                                        range_subid, range_ubound, context);
                 netsnmp_remove_subtree(sub2);
 		netsnmp_subtree_free(sub2);
-                netsnmp_set_lookup_cache_size(old_lookup_cache_val);
-                invalidate_lookup_cache(context);
                 return res;
             }
         }
     } else if (res == MIB_DUPLICATE_REGISTRATION ||
                res == MIB_REGISTRATION_FAILED) {
-        netsnmp_set_lookup_cache_size(old_lookup_cache_val);
-        invalidate_lookup_cache(context);
         netsnmp_subtree_free(subtree);
         return res;
     }
@@ -1285,8 +1372,6 @@ netsnmp_register_mib(const char *moduleName,
                             SNMPD_CALLBACK_REGISTER_OID, &reg_parms);
     }
 
-    netsnmp_set_lookup_cache_size(old_lookup_cache_val);
-    invalidate_lookup_cache(context);
     return res;
 }
 
@@ -1619,7 +1704,6 @@ netsnmp_subtree_unload(netsnmp_subtree *sub, netsnmp_subtree *prev, const char *
 
     if (prev != NULL) {         /* non-leading entries are easy */
         prev->children = sub->children;
-        invalidate_lookup_cache(context);
         return;
     }
     /*
@@ -1637,6 +1721,7 @@ netsnmp_subtree_unload(netsnmp_subtree *sub, netsnmp_subtree *prev, const char *
 	if (sub->prev == NULL) {
 	    netsnmp_subtree_replace_first(sub->next, context);
 	}
+        subtree_index_remove(sub, context);
 
     } else {
         for (ptr = sub->prev; ptr; ptr = ptr->children)
@@ -1647,8 +1732,8 @@ netsnmp_subtree_unload(netsnmp_subtree *sub, netsnmp_subtree *prev, const char *
 	if (sub->prev == NULL) {
 	    netsnmp_subtree_replace_first(sub->children, context);
 	}
+        subtree_index_add(sub->children, context);
     }
-    invalidate_lookup_cache(context);
 }
 
 /**
@@ -1691,11 +1776,9 @@ unregister_mib_context(oid * name, size_t len, int priority,
     netsnmp_subtree *list, *myptr = NULL;
     netsnmp_subtree *prev, *child, *next; /* loop through children */
     struct register_parameters reg_parms;
-    int old_lookup_cache_val = netsnmp_get_lookup_cache_size();
     int unregistering = 1;
     int orig_subid_val = -1;
 
-    netsnmp_set_lookup_cache_size(0);
 
     if ((range_subid > 0) &&  ((size_t)range_subid <= len))
         orig_subid_val = name[range_subid-1];
@@ -1777,8 +1860,6 @@ unregister_mib_context(oid * name, size_t len, int priority,
                         SNMPD_CALLBACK_UNREGISTER_OID, &reg_parms);
 
     netsnmp_subtree_free(myptr);
-    netsnmp_set_lookup_cache_size(old_lookup_cache_val);
-    invalidate_lookup_cache(context);
     return MIB_UNREGISTERED_OK;
 }
 
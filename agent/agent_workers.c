@@ -0,0 +1,490 @@
+/*
+ * agent_workers.c: worker thread pool for thread-safe MIB handlers
+ *
+ * See agent_workers.h for an overview.  The main thread builds the
+ * subtree cache of a request as usual and calls the handlers of all
+ * registrations that are not thread-safe itself.  The remaining entries
+ * of the cache become a job: their requests are marked delegated, the
+ * job is queued, and the agent session waits on agent_delegated_list like
+ * any other delegated request.  A worker runs the handlers and moves the
+ * job to the done list; a byte written to a pipe wakes up the main loop,
+ * which clears the delegated flags and lets
+ * netsnmp_check_outstanding_agent_requests() continue the request.
+ */
+#include <net-snmp/net-snmp-config.h>
+
+#include <sys/types.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#include <errno.h>
+#include <signal.h>
+
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/agent/agent_workers.h>
+#include <net-snmp/library/fd_event_manager.h>
+
+#if defined(NETSNMP_REENTRANT) && defined(HAVE_PTHREAD_H) && !defined(WIN32)
+#define NETSNMP_AGENT_WORKERS 1
+#include <pthread.h>
+#endif
+
+#ifdef NETSNMP_AGENT_WORKERS
+
+#define MAX_WORKER_THREADS 64
+
+typedef struct netsnmp_agent_worker_job_s {
+    netsnmp_agent_session *asp;
+    int            *cache_index;   /* treecache entries to run */
+    netsnmp_handler_registration **reginfo;
+    int             count;
+    int             status;
+    struct netsnmp_agent_worker_job_s *next;
+} netsnmp_agent_worker_job;
+
+static pthread_mutex_t workers_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  idle_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t       workers[MAX_WORKER_THREADS];
+static int             workers_num = 0;
+static int             workers_stopping = 0;
+static int             workers_failed = 0;
+static int             workers_wakeup[2] = { -1, -1 };
+
+/* all protected by workers_lock */
+static netsnmp_agent_worker_job *queued_head = NULL, *queued_tail = NULL;
+static netsnmp_agent_worker_job *running = NULL;
+static netsnmp_agent_worker_job *done_head = NULL, *done_tail = NULL;
+
+static void
+_job_free(netsnmp_agent_worker_job *job)
+{
+    SNMP_FREE(job->cache_index);
+    SNMP_FREE(job->reginfo);
+    SNMP_FREE(job);
+}
+
+static int
+_job_uses(const netsnmp_agent_worker_job *job,
+          const netsnmp_handler_registration *reginfo)
+{
+    int             i;
+
+    for (i = 0; i < job->count; i++)
+        if (job->reginfo[i] == reginfo)
+            return 1;
+    return 0;
+}
+
+/*
+ * A job may start if no running job shares a registration with it;
+ * helpers such as bulk_to_next keep per-call state in their handler.
+ */
+static int
+_job_can_run(const netsnmp_agent_worker_job *job)
+{
+    netsnmp_agent_worker_job *r;
+    int             i;
+
+    for (r = running; r; r = r->next)
+        for (i = 0; i < job->count; i++)
+            if (_job_uses(r, job->reginfo[i]))
+                return 0;
+    return 1;
+}
+
+static netsnmp_agent_worker_job *
+_job_unlink(netsnmp_agent_worker_job **head, netsnmp_agent_worker_job **tail,
+            netsnmp_agent_worker_job *job)
+{
+    netsnmp_agent_worker_job *j, *prev = NULL;
+
+    for (j = *head; j; prev = j, j = j->next) {
+        if (j != job)
+            continue;
+        if (prev)
+            prev->next = j->next;
+        else
+            *head = j->next;
+        if (tail && *tail == j)
+            *tail = prev;
+        j->next = NULL;
+        return j;
+    }
+    return NULL;
+}
+
+static netsnmp_agent_worker_job *
+_job_find(netsnmp_agent_worker_job *list, netsnmp_agent_session *asp)
+{
+    for (; list; list = list->next)
+        if (list->asp == asp)
+            return list;
+    return NULL;
+}
+
+static void    *
+_worker_main(void *arg)
+{
+    netsnmp_agent_worker_job *job;
+    netsnmp_agent_session *asp;
+    sigset_t        set;
+    int             i, status;
+
+    /* signals are for the main thread */
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    pthread_mutex_lock(&workers_lock);
+    while (!workers_stopping) {
+        for (job = queued_head; job; job = job->next)
+            if (_job_can_run(job))
+                break;
+        if (job == NULL) {
+            pthread_cond_wait(&work_cond, &workers_lock);
+            continue;
+        }
+        _job_unlink(&queued_head, &queued_tail, job);
+        job->next = running;
+        running = job;
+        pthread_mutex_unlock(&workers_lock);
+
+        asp = job->asp;
+        for (i = 0; i < job->count; i++) {
+            status = netsnmp_call_handlers(job->reginfo[i], asp->reqinfo,
+                                           asp->treecache[job->cache_index[i]].
+                                           requests_begin);
+            if (status != SNMP_ERR_NOERROR && job->status == SNMP_ERR_NOERROR)
+                job->status = status;
+        }
+
+        pthread_mutex_lock(&workers_lock);
+        _job_unlink(&running, NULL, job);
+        if (done_tail)
+            done_tail->next = job;
+        else
+            done_head = job;
+        done_tail = job;
+        if (write(workers_wakeup[1], "", 1) < 0 && errno != EAGAIN)
+            snmp_log(LOG_ERR, "agent worker: cannot wake up main loop: %s\n",
+                     strerror(errno));
+        pthread_cond_broadcast(&work_cond);
+        pthread_cond_broadcast(&idle_cond);
+    }
+    pthread_mutex_unlock(&workers_lock);
+    return NULL;
+}
+
+/*
+ * Called from the main loop when a worker has finished a job.
+ */
+static void
+_workers_collect(int fd, void *data)
+{
+    netsnmp_agent_worker_job *job, *list;
+    netsnmp_agent_session *asp;
+    netsnmp_request_info *request;
+    char            buf[64];
+    int             i;
+
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+
+    pthread_mutex_lock(&workers_lock);
+    list = done_head;
+    done_head = done_tail = NULL;
+    pthread_mutex_unlock(&workers_lock);
+
+    while ((job = list) != NULL) {
+        list = job->next;
+        asp = job->asp;
+        DEBUGMSGTL(("agent_workers", "asp %p done, status %d\n", asp,
+                    job->status));
+        for (i = 0; i < job->count; i++)
+            for (request = asp->treecache[job->cache_index[i]].requests_begin;
+                 request; request = request->next)
+                request->delegated = REQUEST_IS_NOT_DELEGATED;
+        asp->flags &= ~SNMP_AGENT_FLAGS_IN_WORKER;
+        if (job->status != SNMP_ERR_NOERROR && asp->status == SNMP_ERR_NOERROR)
+            asp->status = job->status;
+
+        /*
+         * Unhandled GET results -> noSuchInstance, as handle_pdu()
+         * would have done had the handlers run synchronously.
+         */
+        if (asp->pdu->command == SNMP_MSG_GET &&
+            netsnmp_check_all_requests_status(asp, 0) == SNMP_ERR_NOERROR)
+            snmp_replace_var_types(asp->pdu->variables, ASN_NULL,
+                                   SNMP_NOSUCHINSTANCE);
+        _job_free(job);
+    }
+
+    netsnmp_check_outstanding_agent_requests();
+}
+
+static int
+_workers_start(int num)
+{
+    int             i, flags;
+
+    if (num > MAX_WORKER_THREADS)
+        num = MAX_WORKER_THREADS;
+
+    if (pipe(workers_wakeup) != 0) {
+        snmp_log(LOG_ERR, "agentWorkerThreads: pipe: %s\n", strerror(errno));
+        return 0;
+    }
+    for (i = 0; i < 2; i++) {
+        flags = fcntl(workers_wakeup[i], F_GETFL, 0);
+        fcntl(workers_wakeup[i], F_SETFL, flags | O_NONBLOCK);
+    }
+    if (register_readfd(workers_wakeup[0], _workers_collect, NULL) !=
+        FD_REGISTERED_OK) {
+        snmp_log(LOG_ERR, "agentWorkerThreads: cannot register wakeup fd\n");
+        close(workers_wakeup[0]);
+        close(workers_wakeup[1]);
+        workers_wakeup[0] = workers_wakeup[1] = -1;
+        return 0;
+    }
+
+    workers_stopping = 0;
+    for (i = 0; i < num; i++) {
+        if (pthread_create(&workers[i], NULL, _worker_main, NULL) != 0) {
+            snmp_log(LOG_ERR, "agentWorkerThreads: only %d of %d threads "
+                     "started\n", i, num);
+            break;
+        }
+    }
+    workers_num = i;
+    if (workers_num == 0) {
+        shutdown_agent_workers();
+        return 0;
+    }
+    DEBUGMSGTL(("agent_workers", "started %d worker threads\n",
+                workers_num));
+    return workers_num;
+}
+
+int
+netsnmp_agent_workers_accept(netsnmp_agent_session *asp)
+{
+    int             n;
+
+    switch (asp->mode) {
+    case SNMP_MSG_GET:
+    case SNMP_MSG_GETNEXT:
+    case SNMP_MSG_GETBULK:
+        break;
+    default:
+        return 0;
+    }
+    if (asp->flags & (SNMP_AGENT_FLAGS_CANCEL_IN_PROGRESS |
+                      SNMP_AGENT_FLAGS_IN_WORKER))
+        return 0;
+    if (workers_num == 0) {
+        /*
+         * started on first use, i.e. after snmpd has forked 
+         */
+        n = netsnmp_ds_get_int(NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_WORKER_THREADS);
+        if (n <= 0 || workers_failed)
+            return 0;
+        if (!_workers_start(n)) {
+            workers_failed = 1;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int
+netsnmp_agent_workers_submit(netsnmp_agent_session *asp)
+{
+    netsnmp_agent_worker_job *job;
+    netsnmp_handler_registration *reginfo;
+    netsnmp_request_info *request;
+    int             i, n;
+
+    for (i = 0, n = 0; i <= asp->treecache_num; i++) {
+        reginfo = asp->treecache[i].subtree->reginfo;
+        if (reginfo && (reginfo->modes & HANDLER_CAN_THREADSAFE))
+            n++;
+    }
+    if (n == 0)
+        return 0;
+
+    job = SNMP_MALLOC_TYPEDEF(netsnmp_agent_worker_job);
+    if (job) {
+        job->cache_index = (int *) calloc(n, sizeof(int));
+        job->reginfo = (netsnmp_handler_registration **)
+            calloc(n, sizeof(netsnmp_handler_registration *));
+    }
+    if (!job || !job->cache_index || !job->reginfo) {
+        if (job)
+            _job_free(job);
+        return 0;
+    }
+
+    job->asp = asp;
+    for (i = 0; i <= asp->treecache_num; i++) {
+        reginfo = asp->treecache[i].subtree->reginfo;
+        if (!reginfo || !(reginfo->modes & HANDLER_CAN_THREADSAFE))
+            continue;
+        job->cache_index[job->count] = i;
+        job->reginfo[job->count++] = reginfo;
+        for (request = asp->treecache[i].requests_begin; request;
+             request = request->next)
+            request->delegated = REQUEST_IS_DELEGATED;
+    }
+    asp->flags |= SNMP_AGENT_FLAGS_IN_WORKER;
+    DEBUGMSGTL(("agent_workers", "asp %p: %d subtree(s) queued\n", asp,
+                job->count));
+
+    pthread_mutex_lock(&workers_lock);
+    if (queued_tail)
+        queued_tail->next = job;
+    else
+        queued_head = job;
+    queued_tail = job;
+    pthread_cond_signal(&work_cond);
+    pthread_mutex_unlock(&workers_lock);
+    return 1;
+}
+
+void
+netsnmp_agent_workers_cancel(netsnmp_agent_session *asp)
+{
+    netsnmp_agent_worker_job *job;
+
+    pthread_mutex_lock(&workers_lock);
+    while (_job_find(running, asp))
+        pthread_cond_wait(&idle_cond, &workers_lock);
+    job = _job_find(queued_head, asp);
+    if (job)
+        _job_unlink(&queued_head, &queued_tail, job);
+    else if ((job = _job_find(done_head, asp)) != NULL)
+        _job_unlink(&done_head, &done_tail, job);
+    pthread_mutex_unlock(&workers_lock);
+
+    if (job) {
+        DEBUGMSGTL(("agent_workers", "asp %p cancelled\n", asp));
+        _job_free(job);
+    }
+    asp->flags &= ~SNMP_AGENT_FLAGS_IN_WORKER;
+}
+
+void
+netsnmp_agent_workers_wait_reginfo(netsnmp_handler_registration *reginfo)
+{
+    netsnmp_agent_worker_job *job;
+
+    if (workers_num == 0 || !(reginfo->modes & HANDLER_CAN_THREADSAFE))
+        return;
+
+    pthread_mutex_lock(&workers_lock);
+    for (;;) {
+        for (job = running; job; job = job->next)
+            if (_job_uses(job, reginfo))
+                break;
+        if (job == NULL)
+            for (job = queued_head; job; job = job->next)
+                if (_job_uses(job, reginfo))
+                    break;
+        if (job == NULL)
+            break;
+        pthread_cond_wait(&idle_cond, &workers_lock);
+    }
+    pthread_mutex_unlock(&workers_lock);
+}
+
+int
+netsnmp_agent_workers_running(void)
+{
+    return workers_num;
+}
+
+void
+shutdown_agent_workers(void)
+{
+    int             i;
+
+    workers_failed = 0;
+    if (workers_wakeup[0] < 0)
+        return;
+
+    pthread_mutex_lock(&workers_lock);
+    workers_stopping = 1;
+    pthread_cond_broadcast(&work_cond);
+    pthread_mutex_unlock(&workers_lock);
+    for (i = 0; i < workers_num; i++)
+        pthread_join(workers[i], NULL);
+    workers_num = 0;
+
+    /*
+     * Jobs still queued or done belong to agent sessions that are
+     * waiting on agent_delegated_list; they are dropped when those
+     * sessions are freed.
+     */
+    unregister_readfd(workers_wakeup[0]);
+    close(workers_wakeup[0]);
+    close(workers_wakeup[1]);
+    workers_wakeup[0] = workers_wakeup[1] = -1;
+    DEBUGMSGTL(("agent_workers", "worker threads stopped\n"));
+}
+
+#else /* !NETSNMP_AGENT_WORKERS */
+
+int
+netsnmp_agent_workers_accept(netsnmp_agent_session *asp)
+{
+    static int      warned = 0;
+
+    if (!warned && netsnmp_ds_get_int(NETSNMP_DS_APPLICATION_ID,
+                                      NETSNMP_DS_AGENT_WORKER_THREADS) > 0) {
+        snmp_log(LOG_WARNING, "agentWorkerThreads ignored: the agent was "
+                 "built without --enable-reentrant\n");
+        warned = 1;
+    }
+    return 0;
+}
+
+int
+netsnmp_agent_workers_submit(netsnmp_agent_session *asp)
+{
+    return 0;
+}
+
+void
+netsnmp_agent_workers_cancel(netsnmp_agent_session *asp)
+{
+}
+
+void
+netsnmp_agent_workers_wait_reginfo(netsnmp_handler_registration *reginfo)
+{
+}
+
+int
+netsnmp_agent_workers_running(void)
+{
+    return 0;
+}
+
+void
+shutdown_agent_workers(void)
+{
+}
+
+#endif /* !NETSNMP_AGENT_WORKERS */
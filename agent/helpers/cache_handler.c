@@ -98,6 +98,22 @@ void            release_cached_resources(unsigned int regNo,
  *  not be used if cache is not synchronized automatically as it would
  *  result in stale cache information when if polling happens too fast.
  *
+ *  If NETSNMP_CACHE_MERGE_ON_RELOAD is set, a valid cache is not freed
+ *  before it is reloaded. Instead, the load_cache routine is called with
+ *  the magic pointer set to an empty copy of the cache container, and the
+ *  rows it loads there are merged into the existing container: rows which
+ *  are new are inserted, rows which are no longer there are removed and
+ *  freed, and for rows which are in both, the merge_row routine is called
+ *  to update the existing row from the new one. merge_row should return
+ *  a positive number if the row changed, 0 if it did not, and a negative
+ *  number if the row could not be updated, in which case it is replaced
+ *  by the new one (as it is when there is no merge_row routine). Rows are
+ *  freed with the free_row routine, or the container's free_item routine
+ *  if there is none. The magic pointer must be the cache container. If
+ *  load_cache loads more than one row with the same index, only the first
+ *  is kept. The number of rows inserted, updated, deleted and left
+ *  unchanged can be read with netsnmp_cache_get_merge_stats().
+ *
  *
  *  Here are some suggestions for some common situations.
  *
@@ -136,6 +152,16 @@ void            release_cached_resources(unsigned int regNo,
  *
  *          NETSNMP_CACHE_RESET_TIMER_ON_USE
  *
+ *  Large tables which change slowly:
+ *      If a table has many rows, most of which are the same from one
+ *      load to the next (e.g. the TCP connection table), rows which
+ *      haven't changed can be kept rather than freed and allocated again,
+ *      and a walk of the table which spans a reload will still find the
+ *      rows it has already been through. Set a merge_row routine and a
+ *      free_row routine, and set the following flag:
+ *
+ *          NETSNMP_CACHE_MERGE_ON_RELOAD
+ *
  *  @{
  */
 
@@ -264,6 +290,9 @@ netsnmp_cache_free(netsnmp_cache *cache)
     if (cache->valid)
         _cache_free(cache);
 
+    if (cache->snapshot)
+        CONTAINER_FREE(cache->snapshot);
+
     if (cache->timestampM)
 	free(cache->timestampM);
 
@@ -372,6 +401,16 @@ netsnmp_cache_timer_stop(netsnmp_cache *cache)
     cache->flags |= NETSNMP_CACHE_AUTO_RELOAD;
 }
 
+/** copies the row counts of the merged reloads of a cache into *stats */
+void
+netsnmp_cache_get_merge_stats(netsnmp_cache *cache,
+                              netsnmp_cache_merge_stats *stats)
+{
+    if ((NULL == cache) || (NULL == stats))
+        return;
+    *stats = cache->merge_stats;
+}
+
 
 /** returns a cache handler that can be injected into a given handler chain.  
  */
@@ -719,20 +758,202 @@ _cache_free( netsnmp_cache *cache )
     }
 }
 
+typedef struct cache_merge_s {
+    netsnmp_cache     *cache;
+    netsnmp_container *current;
+    netsnmp_container *fresh;
+    netsnmp_container_obj_func *free_row;
+    void             **gone;    /* rows of current not in fresh */
+    size_t             gone_count;
+    void             **added;   /* rows to insert into current */
+    size_t             added_count;
+    size_t             dropped; /* of added, not inserted */
+    u_long             replaced;
+    u_long             updated;
+    u_long             unchanged;
+} cache_merge;
+
+static void
+_cache_merge_find_gone(void *row, void *context)
+{
+    cache_merge *merge = (cache_merge *)context;
+
+    if (NULL == CONTAINER_FIND(merge->fresh, row))
+        merge->gone[merge->gone_count++] = row;
+}
+
+static void
+_cache_merge_row(void *row, void *context)
+{
+    cache_merge *merge = (cache_merge *)context;
+    void        *old_row;
+    int          rc = -1;
+
+    old_row = CONTAINER_FIND(merge->current, row);
+    if (NULL == old_row) {
+        merge->added[merge->added_count++] = row;
+        return;
+    }
+    if (merge->cache->merge_row)
+        rc = merge->cache->merge_row(merge->cache, old_row, row);
+    if (rc < 0) {
+        /*
+         * couldn't update the row in place, so replace it. The old row
+         * goes now, so that a later row with the same index (the
+         * snapshot allows duplicates) is treated as new, and dropped
+         * as a duplicate when it is inserted.
+         */
+        CONTAINER_REMOVE(merge->current, old_row);
+        if (merge->free_row)
+            merge->free_row(old_row, NULL);
+        merge->added[merge->added_count++] = row;
+        ++merge->replaced;
+        ++merge->updated;
+        return;
+    }
+    if (rc > 0)
+        ++merge->updated;
+    else
+        ++merge->unchanged;
+    if (merge->free_row)
+        merge->free_row(row, NULL);
+}
+
+/*
+ * returns an empty container like the cache container, for reloading the
+ * cache into. If there isn't one, the cache is reloaded without merging.
+ */
+static netsnmp_container *
+_cache_snapshot( netsnmp_cache *cache )
+{
+    netsnmp_container *current = (netsnmp_container *)cache->magic;
+
+    if ((NULL == cache->snapshot) && current->duplicate) {
+        cache->snapshot = CONTAINER_DUP(current, NULL, 0);
+        if (cache->snapshot)
+            CONTAINER_CLEAR(cache->snapshot, NULL, NULL);
+    }
+    if (NULL == cache->snapshot) {
+        snmp_log(LOG_WARNING, "cache container can't be copied, "
+                 "reloading without merging\n");
+        cache->flags &= ~NETSNMP_CACHE_MERGE_ON_RELOAD;
+    }
+    return cache->snapshot;
+}
+
+/*
+ * load the cache into the snapshot container, and merge the snapshot
+ * into the cache container.
+ */
 static int
-_cache_load( netsnmp_cache *cache )
+_cache_merge_load( netsnmp_cache *cache )
 {
-    int ret = -1;
+    netsnmp_container *current = (netsnmp_container *)cache->magic;
+    cache_merge        merge;
+    size_t             i;
+    int                ret, unsorted = 0;
+
+    memset(&merge, 0, sizeof(merge));
+    merge.cache = cache;
+    merge.current = current;
+    merge.fresh = cache->snapshot;
+    merge.free_row = cache->free_row ? cache->free_row : current->free_item;
 
     /*
-     * If we've got a valid cache, then release it before reloading
+     * The snapshot isn't searched until it is loaded, so where the
+     * container allows it, add the rows unsorted and sort them once.
+     * Duplicates are dropped by the merge.
      */
-    if (cache->valid &&
-        (! (cache->flags & NETSNMP_CACHE_DONT_FREE_BEFORE_LOAD)))
-        _cache_free(cache);
+    if (merge.fresh->options)
+        unsorted = (merge.fresh->options(merge.fresh, 1,
+                                         CONTAINER_KEY_ALLOW_DUPLICATES |
+                                         CONTAINER_KEY_UNSORTED) != -1);
+
+    cache->magic = merge.fresh;
+    ret = cache->load_cache(cache, cache->magic);
+    cache->magic = current;
+
+    if (unsorted)
+        merge.fresh->options(merge.fresh, 1, CONTAINER_KEY_ALLOW_DUPLICATES);
+    if (ret < 0) {
+        CONTAINER_CLEAR(merge.fresh, merge.free_row, NULL);
+        return ret;
+    }
+
+    merge.gone = (void **)malloc((CONTAINER_SIZE(current) + 1) *
+                                 sizeof(void *));
+    merge.added = (void **)malloc((CONTAINER_SIZE(merge.fresh) + 1) *
+                                  sizeof(void *));
+    if ((NULL == merge.gone) || (NULL == merge.added)) {
+        snmp_log(LOG_ERR, "malloc error merging cache reload\n");
+        SNMP_FREE(merge.gone);
+        SNMP_FREE(merge.added);
+        CONTAINER_CLEAR(merge.fresh, merge.free_row, NULL);
+        return -1;
+    }
+
+    /*
+     * Find the rows which have gone before the fresh rows are merged
+     * (and freed), and don't insert any rows until all the lookups are
+     * done, since an insert may leave a sorted container to be sorted
+     * again on the next lookup (a remove doesn't).
+     */
+    CONTAINER_FOR_EACH(current, _cache_merge_find_gone, &merge);
+    CONTAINER_FOR_EACH(merge.fresh, _cache_merge_row, &merge);
+    CONTAINER_CLEAR(merge.fresh, NULL, NULL);
+
+    for (i = 0; i < merge.gone_count; ++i) {
+        CONTAINER_REMOVE(current, merge.gone[i]);
+        if (merge.free_row)
+            merge.free_row(merge.gone[i], NULL);
+    }
+    for (i = 0; i < merge.added_count; ++i) {
+        if (CONTAINER_INSERT(current, merge.added[i]) != 0) {
+            DEBUGMSGTL(("helper:cache_handler:merge",
+                        "not inserting duplicate row\n"));
+            ++merge.dropped;
+            if (merge.free_row)
+                merge.free_row(merge.added[i], NULL);
+        }
+    }
 
-    if ( cache->load_cache)
-        ret = cache->load_cache(cache, cache->magic);
+    cache->merge_stats.rows_inserted += merge.added_count - merge.dropped -
+        merge.replaced;
+    cache->merge_stats.rows_updated += merge.updated;
+    cache->merge_stats.rows_deleted += merge.gone_count;
+    cache->merge_stats.rows_unchanged += merge.unchanged;
+    DEBUGMSGT(("helper:cache_handler:merge",
+               " %lu new, %lu updated, %lu gone, %lu unchanged\n",
+               (u_long)(merge.added_count - merge.dropped - merge.replaced),
+               merge.updated, (u_long)merge.gone_count, merge.unchanged));
+
+    free(merge.gone);
+    free(merge.added);
+    return ret;
+}
+
+static int
+_cache_load( netsnmp_cache *cache )
+{
+    int ret = -1;
+
+    if (cache->valid && cache->magic && cache->load_cache &&
+        (cache->flags & NETSNMP_CACHE_MERGE_ON_RELOAD) &&
+        _cache_snapshot(cache)) {
+        ret = _cache_merge_load(cache);
+        if (ret < 0)
+            _cache_free(cache);
+    } else {
+        /*
+         * If we've got a valid cache, then release it before reloading
+         */
+        if (cache->valid &&
+            (! (cache->flags & NETSNMP_CACHE_DONT_FREE_BEFORE_LOAD)))
+            _cache_free(cache);
+
+        if ( cache->load_cache)
+            ret = cache->load_cache(cache, cache->magic);
+    }
     if (ret < 0) {
         DEBUGMSGT(("helper:cache_handler", " load failed (%d)\n", ret));
         cache->valid = 0;
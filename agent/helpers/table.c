@@ -60,6 +60,11 @@ sparse_table_helper_handler(netsnmp_mib_handler *handler,
                             netsnmp_handler_registration *reginfo,
                             netsnmp_agent_request_info *reqinfo,
                             netsnmp_request_info *requests);
+static int
+table_helper_bulk(netsnmp_mib_handler *handler,
+                  netsnmp_handler_registration *reginfo,
+                  netsnmp_agent_request_info *reqinfo,
+                  netsnmp_request_info *requests);
 
 /** @defgroup table table
  *  Helps you implement a table.
@@ -151,6 +156,13 @@ void netsnmp_registration_owns_table_info(netsnmp_handler_registration *reg)
 /** creates a table handler given the netsnmp_table_registration_info object,
  *  inserts it into the request chain and then calls
  *  netsnmp_register_handler() to register the table into the agent.
+ *
+ *  Tables whose rows are kept in a container (the table_container and
+ *  table_tdata helpers, and MFD tables) answer GETBULK requests
+ *  themselves, a row after another, instead of returning to the agent
+ *  for each repetition; any other table can ask for this by setting
+ *  HANDLER_CAN_GETBULK in reginfo->modes, provided the handlers below
+ *  the table handler cope with being called for GETNEXT repeatedly.
  */
 int
 netsnmp_register_table(netsnmp_handler_registration *reginfo,
@@ -165,6 +177,9 @@ netsnmp_register_table(netsnmp_handler_registration *reginfo,
         return MIB_REGISTRATION_FAILED;
     }
 
+    if (netsnmp_find_handler_by_name(reginfo, "table_container"))
+        reginfo->modes |= HANDLER_CAN_GETBULK;
+
     return netsnmp_register_handler(reginfo);
 }
 
@@ -239,6 +254,9 @@ table_helper_handler(netsnmp_mib_handler *handler,
         return SNMP_ERR_GENERR;
     }
 
+    if (reqinfo->mode == MODE_GETBULK)
+        return table_helper_bulk(handler, reginfo, reqinfo, requests);
+
     DEBUGIF("helper:table:req") {
         DEBUGMSGTL(("helper:table:req",
                     "Got %s (%d) mode request for handler %s: base oid:",
@@ -735,6 +753,144 @@ table_helper_handler(netsnmp_mib_handler *handler,
     return status;
 }
 
+/** moves a GETBULK request on to its next repetition, which starts
+ *  from the OID the current one returned */
+static void
+table_bulk_next_repetition(netsnmp_request_info *request, u_char type)
+{
+    netsnmp_variable_list *var = request->requestvb;
+
+    request->repeat--;
+    snmp_set_var_objid(var->next_variable, var->name, var->name_length);
+    request->requestvb = var->next_variable;
+    request->requestvb->type = type;
+    request->inclusive = 0;
+}
+
+/** implements GETBULK for the table helper
+ * @internal
+ *
+ * Runs the GETNEXT pass of the table handler, and of the handlers below
+ * it, once for each repetition, without going back to the agent between
+ * them.  Each pass is given the requests that got an answer in the table
+ * in the previous one, moved on to their next repetition.  A request
+ * stays with the agent once it has no repetitions left or no answer
+ * here; answers outside the requester's view are looked past, as the
+ * agent would.  Should a pass delegate a request or fail, the rest are
+ * moved on as the bulk_to_next helper would and the agent takes over.
+ */
+static int
+table_helper_bulk(netsnmp_mib_handler *handler,
+                  netsnmp_handler_registration *reginfo,
+                  netsnmp_agent_request_info *reqinfo,
+                  netsnmp_request_info *requests)
+{
+    netsnmp_request_info *request, **reqs, *active, **tail, *after;
+    netsnmp_variable_list *var;
+    netsnmp_pdu    *pdu = reqinfo->asp ? reqinfo->asp->pdu : NULL;
+    char           *more;
+    long            rough_size = 0;
+    int             status, count, i, again, delegated, check_view;
+
+    for (count = 0, request = requests; request; request = request->next)
+        count++;
+    if (count == 0)
+        return SNMP_ERR_NOERROR;
+    reqs = (netsnmp_request_info **) malloc(count * sizeof(*reqs));
+    more = (char *) malloc(count);
+    if (reqs == NULL || more == NULL) {
+        free(reqs);
+        free(more);
+        return SNMP_ERR_GENERR;
+    }
+    for (i = 0, request = requests; request; i++, request = request->next) {
+        reqs[i] = request;
+        more[i] = 1;
+    }
+    after = reqs[count - 1]->next;
+
+    /*
+     * no need to look at each answer if the whole table is in view
+     */
+    check_view = pdu &&
+        netsnmp_acm_check_subtree(pdu, reginfo->rootoid,
+                                  reginfo->rootoid_len) != VACM_SUCCESS;
+
+    reqinfo->mode = MODE_GETNEXT;
+    for (;;) {
+        active = NULL;
+        tail = &active;
+        for (i = 0; i < count; i++)
+            if (more[i]) {
+                *tail = reqs[i];
+                tail = &reqs[i]->next;
+            }
+        *tail = NULL;
+        status = table_helper_handler(handler, reginfo, reqinfo, active);
+        for (i = 0; i < count - 1; i++)
+            reqs[i]->next = reqs[i + 1];
+        reqs[count - 1]->next = after;
+
+        delegated = 0;
+        for (i = 0; i < count; i++)
+            if (more[i] && reqs[i]->delegated)
+                delegated = 1;
+        if (status != SNMP_ERR_NOERROR || delegated) {
+            netsnmp_bulk_to_next_fix_requests(requests);
+            break;
+        }
+
+        again = 0;
+        for (i = 0; i < count; i++) {
+            if (!more[i])
+                continue;
+            more[i] = 0;
+            request = reqs[i];
+            var = request->requestvb;
+            if (request->status != SNMP_ERR_NOERROR ||
+                var->type == ASN_NULL || var->type == ASN_PRIV_RETRY ||
+                var->type == SNMP_ENDOFMIBVIEW ||
+                var->type == SNMP_NOSUCHOBJECT ||
+                var->type == SNMP_NOSUCHINSTANCE ||
+                snmp_oid_compare(var->name, var->name_length,
+                                 request->range_end,
+                                 request->range_end_len) >= 0)
+                continue;
+
+            if (check_view && in_a_view(var->name, &var->name_length, pdu,
+                                 var->type) != VACM_SUCCESS) {
+                /*
+                 * look again, from here, for the next one in view
+                 */
+                snmp_set_var_typed_value(var, ASN_NULL, NULL, 0);
+                request->inclusive = 0;
+            } else if (request->repeat > 0 && var->next_variable) {
+                rough_size += var->name_length + var->val_len;
+                if (pdu && rough_size > pdu->msgMaxSize) {
+                    /*
+                     * the agent will see that the response is full
+                     */
+                    table_bulk_next_repetition(request, ASN_PRIV_RETRY);
+                    continue;
+                }
+                table_bulk_next_repetition(request, ASN_NULL);
+            } else
+                continue;
+
+            request->processed = 0;
+            netsnmp_free_request_data_sets(request);
+            more[i] = again = 1;
+        }
+        if (!again)
+            break;
+    }
+    reqinfo->mode = MODE_GETBULK;
+
+    free(reqs);
+    free(more);
+    return status;
+}
+
 #define SPARSE_TABLE_HANDLER_NAME "sparse_table"
 
 /** implements the sparse table helper handler
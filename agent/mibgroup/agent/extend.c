@@ -35,6 +35,28 @@ typedef struct extend_registration_block_s {
 } extend_registration_block;
 extend_registration_block *ereg_head = NULL;
 
+/*
+ * Requests held (delegated) while the commands they need are run in
+ * the background, and answered once all of those have finished
+ */
+typedef struct extend_waiter_s {
+    netsnmp_delegated_cache *cache;
+    Netsnmp_Node_Handler    *answer;
+    int                      mode;
+    int                      num_entries;
+    int                      max_entries;
+    netsnmp_extend         **entries;
+    struct extend_waiter_s  *next;
+} extend_waiter;
+static extend_waiter *extend_waiters = NULL;
+static int            extend_replaying = 0;
+
+/* the results of a background run, for extend_load_cache to pick up */
+static netsnmp_extend *extend_staged = NULL;
+static char          *extend_staged_output;
+static int            extend_staged_len;
+static int            extend_staged_result;
+
 
 #ifndef USING_UCD_SNMP_EXTENSIBLE_MODULE
 typedef struct netsnmp_old_extend_s {
@@ -284,6 +306,11 @@ void init_extend( void )
     snmpd_register_config_handler("exec2", extend_parse_config, NULL, NULL);
     snmpd_register_config_handler("sh2",   extend_parse_config, NULL, NULL);
     snmpd_register_config_handler("execFix2", extend_parse_config, NULL, NULL);
+    netsnmp_ds_register_config(ASN_BOOLEAN,
+                               netsnmp_ds_get_string(NETSNMP_DS_LIBRARY_ID,
+                                                     NETSNMP_DS_LIB_APPTYPE),
+                               "extend_refresh", NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_EXTEND_REFRESH);
     (void)_register_extend( ns_extend_oid, OID_LENGTH(ns_extend_oid));
 
 #ifndef USING_UCD_SNMP_EXTENSIBLE_MODULE
@@ -319,6 +346,10 @@ shutdown_extend(void)
          *
          *************************/
 
+static void _extend_schedule_refresh( netsnmp_extend *extension );
+static void _extend_run_done( int result, char *output, int out_len,
+                              void *magic );
+
 int
 extend_load_cache(netsnmp_cache *cache, void *magic)
 {
@@ -331,7 +362,7 @@ extend_load_cache(netsnmp_cache *cache, void *magic)
     int  cmd_len = 255*2 + 2;	/* 2 * DisplayStrings */
     char cmd_buf[ 255*2 + 2 ];
     int  ret;
-    char *cp;
+    char *cp, *out = out_buf;
     char *line_buf[ 1024 ];
     netsnmp_extend *extension = (netsnmp_extend *)magic;
 
@@ -342,15 +373,22 @@ extend_load_cache(netsnmp_cache *cache, void *magic)
         snprintf( cmd_buf, cmd_len, "%s %s", extension->command, extension->args );
     else 
         snprintf( cmd_buf, cmd_len, "%s", extension->command );
-    if ( extension->flags & NS_EXTEND_FLAGS_SHELL )
+    if ( extension == extend_staged ) {
+        /*
+         * This has just been run in the background
+         */
+        ret     = extend_staged_result;
+        out     = extend_staged_output;
+        out_len = extend_staged_len;
+    } else if ( extension->flags & NS_EXTEND_FLAGS_SHELL )
         ret = run_shell_command( cmd_buf, extension->input, out_buf, &out_len);
     else
         ret = run_exec_command(  cmd_buf, extension->input, out_buf, &out_len);
     DEBUGMSG(( "nsExtendTable:cache", ": %s : %d\n", cmd_buf, ret));
     if (ret >= 0) {
-        if (out_buf[   out_len-1 ] == '\n')
-            out_buf[ --out_len   ] =  '\0';	/* Stomp on trailing newline */
-        extension->output   = strdup( out_buf );
+        if (out_len > 0 && out[ out_len-1 ] == '\n')
+            out[ --out_len   ] =  '\0';	/* Stomp on trailing newline */
+        extension->output   = strdup( out );
         extension->out_len  = out_len;
         /*
          * Now we need to pick the output apart into separate lines.
@@ -373,6 +411,7 @@ extend_load_cache(netsnmp_cache *cache, void *magic)
         }
     }
     extension->result = ret;
+    _extend_schedule_refresh( extension );
     return ret;
 #endif /* !defined(USING_UTILITIES_EXECUTE_MODULE) */
 }
@@ -397,6 +436,259 @@ extend_free_cache(netsnmp_cache *cache, void *magic)
     extension->numlines = 0;
 }
 
+        /*************************
+         *
+         *  Running commands in the background
+         *  Requests needing output that isn't ready are
+         *   delegated until the commands have finished.
+         *
+         *************************/
+
+static int
+_extend_start( netsnmp_extend *extension, int force )
+{
+#ifdef USING_UTILITIES_EXECUTE_MODULE
+    int  cmd_len = 255*2 + 2;	/* 2 * DisplayStrings */
+    char cmd_buf[ 255*2 + 2 ];
+
+    if (extension->job)
+        return 1;
+    if (!force && extension->cache->valid &&
+        !netsnmp_cache_check_expired( extension->cache ))
+        return 0;
+
+    if ( extension->args )
+        snprintf( cmd_buf, cmd_len, "%s %s", extension->command, extension->args );
+    else 
+        snprintf( cmd_buf, cmd_len, "%s", extension->command );
+    extension->job = run_command_async( cmd_buf, extension->input,
+                             (extension->flags & NS_EXTEND_FLAGS_SHELL) != 0,
+                             1024*100, extension->timeout,
+                             _extend_run_done, extension );
+    if (!extension->job)
+        return 0;   /* run it synchronously, when it's needed */
+    DEBUGMSGTL(( "nsExtendTable:run", "started %s\n", extension->token ));
+    extension->flags &= ~NS_EXTEND_FLAGS_READ;
+    return 1;
+#else
+    return 0;
+#endif /* !defined(USING_UTILITIES_EXECUTE_MODULE) */
+}
+
+/*
+ * While answering held requests, use the results of the background
+ *  runs rather than running anything again
+ */
+static int
+_extend_check_and_reload( netsnmp_extend *extension )
+{
+    if (extend_replaying)
+        return extension->cache->valid ? 0 : -1;
+    return netsnmp_cache_check_and_reload( extension->cache );
+}
+
+static void
+_extend_waiter_free( extend_waiter *waiter )
+{
+    netsnmp_free_delegated_cache( waiter->cache );
+    SNMP_FREE( waiter->entries );
+    SNMP_FREE( waiter );
+}
+
+static void
+_extend_waiter_answer( extend_waiter *waiter, int failed )
+{
+    netsnmp_delegated_cache *cache;
+    int mode;
+
+    cache = netsnmp_handler_check_cache( waiter->cache );
+    if (!cache) {
+        DEBUGMSGTL(( "nsExtendTable:run", "request gone\n"));
+        _extend_waiter_free( waiter );
+        return;
+    }
+    netsnmp_handler_mark_requests_as_delegated( cache->requests,
+                                                REQUEST_IS_NOT_DELEGATED );
+    mode = cache->reqinfo->mode;
+    if (failed) {
+        netsnmp_request_set_error_all( cache->requests, SNMP_ERR_GENERR );
+    } else {
+        cache->reqinfo->mode = waiter->mode;
+        extend_replaying = 1;
+        (*waiter->answer)( cache->handler, cache->reginfo,
+                           cache->reqinfo, cache->requests );
+        extend_replaying = 0;
+        cache->reqinfo->mode = mode;
+        if (mode == MODE_GETBULK)
+            netsnmp_bulk_to_next_fix_requests( cache->requests );
+    }
+    _extend_waiter_free( waiter );
+}
+
+/*
+ * Answer the held requests whose commands have all finished
+ *  (or, if 'extension' is given, fail those that need it)
+ */
+static void
+_extend_waiters_run( netsnmp_extend *extension )
+{
+    extend_waiter *waiter, **wp;
+    int i, again = 1;
+
+    while (again) {
+        again = 0;
+        for (wp = &extend_waiters; (waiter = *wp); wp = &waiter->next) {
+            for (i = 0; i < waiter->num_entries; i++)
+                if (extension ? waiter->entries[i] == extension
+                              : waiter->entries[i]->job != NULL)
+                    break;
+            if (extension ? i == waiter->num_entries
+                          : i < waiter->num_entries)
+                continue;
+            /*
+             * Answering may start (or finish) further runs,
+             *  so start again from the top afterwards
+             */
+            *wp = waiter->next;
+            _extend_waiter_answer( waiter, extension != NULL );
+            again = 1;
+            break;
+        }
+    }
+}
+
+static void
+_extend_run_done( int result, char *output, int out_len, void *magic )
+{
+    netsnmp_extend *extension = (netsnmp_extend *)magic;
+
+    DEBUGMSGTL(( "nsExtendTable:run", "finished %s : %d\n",
+                  extension->token, result ));
+    extension->job = NULL;
+
+    /*
+     * Load the results into the output cache...
+     */
+    extend_staged        = extension;
+    extend_staged_output = output;
+    extend_staged_len    = out_len;
+    extend_staged_result = result;
+    extension->cache->expired = 1;
+    (void)netsnmp_cache_check_and_reload( extension->cache );
+    extend_staged        = NULL;
+
+    /*
+     * ... and answer whatever was waiting for them
+     */
+    _extend_waiters_run( NULL );
+}
+
+static void
+_extend_refresh( unsigned int clientreg, void *clientarg )
+{
+    netsnmp_extend *extension = (netsnmp_extend *)clientarg;
+
+    extension->refresh = 0;
+    if ((extension->flags & (NS_EXTEND_FLAGS_ACTIVE | NS_EXTEND_FLAGS_READ |
+                             NS_EXTEND_FLAGS_WRITEABLE)) ==
+                            (NS_EXTEND_FLAGS_ACTIVE | NS_EXTEND_FLAGS_READ)) {
+        DEBUGMSGTL(( "nsExtendTable:run", "refresh %s\n", extension->token ));
+        (void)_extend_start( extension, 1 );
+    }
+}
+
+/*
+ * With 'extend_refresh' set, rerun a 'run-on-read' entry when three
+ *  quarters of its cache time are up, if its output was read since
+ *  the last run, so that regular polling doesn't have to wait for it
+ */
+static void
+_extend_schedule_refresh( netsnmp_extend *extension )
+{
+    struct timeval t;
+    long ms;
+
+    if (extension->refresh) {
+        snmp_alarm_unregister( extension->refresh );
+        extension->refresh = 0;
+    }
+    if (!netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID,
+                                NETSNMP_DS_AGENT_EXTEND_REFRESH) ||
+        (extension->flags & NS_EXTEND_FLAGS_WRITEABLE) ||
+        extension->cache->timeout <= 0)
+        return;
+    ms = extension->cache->timeout * 750L;
+    t.tv_sec  = ms / 1000;
+    t.tv_usec = (ms % 1000) * 1000;
+    extension->refresh = snmp_alarm_register_hr( t, 0, _extend_refresh,
+                                                 extension );
+}
+
+/*
+ * Note that a request needs the output of this entry,
+ *  starting it running if that output isn't ready
+ */
+static extend_waiter *
+_extend_need( extend_waiter *waiter, netsnmp_extend *extension )
+{
+    netsnmp_extend **entries;
+    int i;
+
+    if (!extension || !(extension->flags & NS_EXTEND_FLAGS_ACTIVE))
+        return waiter;
+    i = _extend_start( extension, 0 );
+    extension->flags |= NS_EXTEND_FLAGS_READ;
+    if (!i)
+        return waiter;
+
+    if (!waiter) {
+        waiter = SNMP_MALLOC_TYPEDEF( extend_waiter );
+        if (!waiter)
+            return NULL;
+    }
+    for (i = 0; i < waiter->num_entries; i++)
+        if (waiter->entries[i] == extension)
+            return waiter;
+    if (waiter->num_entries == waiter->max_entries) {
+        entries = (netsnmp_extend **)realloc( waiter->entries,
+                      (waiter->max_entries + 8) * sizeof(netsnmp_extend *));
+        if (!entries)
+            return waiter;
+        waiter->entries      = entries;
+        waiter->max_entries += 8;
+    }
+    waiter->entries[ waiter->num_entries++ ] = extension;
+    return waiter;
+}
+
+/*
+ * Hold the requests until the output they need is ready
+ */
+static int
+_extend_delegate( extend_waiter                *waiter,
+                  Netsnmp_Node_Handler         *answer,
+                  netsnmp_mib_handler          *handler,
+                  netsnmp_handler_registration *reginfo,
+                  netsnmp_agent_request_info   *reqinfo,
+                  netsnmp_request_info         *requests)
+{
+    waiter->cache = netsnmp_create_delegated_cache( handler, reginfo,
+                                                    reqinfo, requests, NULL );
+    if (!waiter->cache) {
+        _extend_waiter_free( waiter );
+        return (*answer)( handler, reginfo, reqinfo, requests );
+    }
+    DEBUGMSGTL(( "nsExtendTable:run", "delegating, for %d entries\n",
+                  waiter->num_entries ));
+    waiter->answer = answer;
+    waiter->mode   = reqinfo->mode;
+    waiter->next   = extend_waiters;
+    extend_waiters = waiter;
+    netsnmp_handler_mark_requests_as_delegated( requests,
+                                                REQUEST_IS_DELEGATED );
+    return SNMP_ERR_NOERROR;
+}
+
 
         /*************************
          *
@@ -433,6 +725,12 @@ _free_extension( netsnmp_extend *extension, extend_registration_block *ereg )
         netsnmp_table_data_remove_and_delete_row( ereg->dinfo, extension->row);
     }
 
+    if (extension->job)
+        run_command_async_cancel( extension->job );
+    if (extension->refresh)
+        snmp_alarm_unregister( extension->refresh );
+    _extend_waiters_run( extension );
+
     SNMP_FREE( extension->token );
     SNMP_FREE( extension->cache );
     SNMP_FREE( extension->command );
@@ -457,6 +755,7 @@ _new_extension( char *exec_name, int exec_flags, extend_registration_block *ereg
         return NULL;
     extension->token    = strdup( exec_name );
     extension->flags    = exec_flags;
+    extension->timeout  = NETSNMP_MAXREADCOUNT;
     extension->cache    = netsnmp_cache_create( 0, extend_load_cache,
                                                    extend_free_cache, NULL, 0 );
     if (extension->cache)
@@ -519,25 +818,32 @@ extend_parse_config(const char *token, char *cptr)
     extend_registration_block *eptr;
     int  flags;
     int cache_timeout = 0;
+    int run_timeout = NETSNMP_MAXREADCOUNT;
     int exec_type = NS_EXTEND_ETYPE_EXEC;
 
     cptr = copy_nword(cptr, exec_name, sizeof(exec_name));
-    if (strcmp(exec_name, "-cacheTime") == 0) {
-        char cache_timeout_str[32];
-
-        cptr = copy_nword(cptr, cache_timeout_str, sizeof(cache_timeout_str));
-        /* If atoi can't do the conversion, it returns 0 */
-        cache_timeout = atoi(cache_timeout_str);
-        cptr = copy_nword(cptr, exec_name, sizeof(exec_name));
-    }
-    if (strcmp(exec_name, "-execType") == 0) {
-        char exec_type_str[16];
-
-        cptr = copy_nword(cptr, exec_type_str, sizeof(exec_type_str));
-        if (strcmp(exec_type_str, "sh") == 0)
-            exec_type = NS_EXTEND_ETYPE_SHELL;
-        else
-            exec_type = NS_EXTEND_ETYPE_EXEC;
+    while (*exec_name == '-') {
+        char option_str[32];
+
+        cptr = copy_nword(cptr, option_str, sizeof(option_str));
+        if (strcmp(exec_name, "-cacheTime") == 0) {
+            /* If atoi can't do the conversion, it returns 0 */
+            cache_timeout = atoi(option_str);
+        } else if (strcmp(exec_name, "-execType") == 0) {
+            if (strcmp(option_str, "sh") == 0)
+                exec_type = NS_EXTEND_ETYPE_SHELL;
+            else
+                exec_type = NS_EXTEND_ETYPE_EXEC;
+        } else if (strcmp(exec_name, "-timeout") == 0) {
+            run_timeout = atoi(option_str);
+            if (run_timeout <= 0) {
+                config_perror("ERROR: the -timeout must be a number of seconds");
+                return;
+            }
+        } else {
+            config_perror("ERROR: Unrecognised option" );
+            return;
+        }
         cptr = copy_nword(cptr, exec_name, sizeof(exec_name));
     }
     if ( *exec_name == '.' ) {
@@ -585,6 +891,7 @@ extend_parse_config(const char *token, char *cptr)
             extension->args = strdup( cptr );
         if (cache_timeout != 0)
             extension->cache->timeout = cache_timeout;
+        extension->timeout = run_timeout;
     } else {
         snmp_log(LOG_ERR, "Failed to register extend entry '%s' - possibly duplicate name.\n", exec_name );
         return;
@@ -1107,8 +1414,8 @@ handle_nsExtendConfigTable(netsnmp_mib_handler          *handler,
 }
 
 
-int
-handle_nsExtendOutput1Table(netsnmp_mib_handler          *handler,
+static int
+_extend_output1_answer(netsnmp_mib_handler          *handler,
                      netsnmp_handler_registration *reginfo,
                      netsnmp_agent_request_info   *reqinfo,
                      netsnmp_request_info         *requests)
@@ -1140,7 +1447,7 @@ handle_nsExtendOutput1Table(netsnmp_mib_handler          *handler,
                 continue;
             }
             if (!(extension->flags & NS_EXTEND_FLAGS_WRITEABLE) &&
-                (netsnmp_cache_check_and_reload( extension->cache ) < 0 )) {
+                (_extend_check_and_reload( extension ) < 0 )) {
                 /*
                  * If reloading the output cache of a 'run-on-read'
                  * entry fails, then skip it.
@@ -1213,6 +1520,36 @@ handle_nsExtendOutput1Table(netsnmp_mib_handler          *handler,
 }
 
 
+int
+handle_nsExtendOutput1Table(netsnmp_mib_handler          *handler,
+                     netsnmp_handler_registration *reginfo,
+                     netsnmp_agent_request_info   *reqinfo,
+                     netsnmp_request_info         *requests)
+{
+    netsnmp_request_info       *request;
+    netsnmp_extend             *extension;
+    extend_waiter              *waiter = NULL;
+
+    /*
+     * Start the 'run-on-read' entries whose output has expired,
+     *  and hold the request until they've finished
+     */
+    if (reqinfo->mode == MODE_GET) {
+        for ( request=requests; request; request=request->next ) {
+            if (request->processed)
+                continue;
+            extension = (netsnmp_extend*)netsnmp_extract_table_row_data( request );
+            if (extension && !(extension->flags & NS_EXTEND_FLAGS_WRITEABLE))
+                waiter = _extend_need( waiter, extension );
+        }
+    }
+    if (waiter)
+        return _extend_delegate( waiter, _extend_output1_answer,
+                                 handler, reginfo, reqinfo, requests );
+    return _extend_output1_answer( handler, reginfo, reqinfo, requests );
+}
+
+
         /*************************
          *
          *  Multi-line output table handler
@@ -1264,7 +1601,7 @@ _extend_find_entry( netsnmp_request_info       *request,
              * Ensure the output is available...
              */
             if (!(eptr->flags & NS_EXTEND_FLAGS_ACTIVE) ||
-               (netsnmp_cache_check_and_reload( eptr->cache ) < 0 ))
+               (_extend_check_and_reload( eptr ) < 0 ))
                 return NULL;
 
             /*
@@ -1288,7 +1625,7 @@ _extend_find_entry( netsnmp_request_info       *request,
              */
             for (eptr = ereg->ehead; eptr; eptr = eptr->next ) {
                 if ((eptr->flags & NS_EXTEND_FLAGS_ACTIVE) &&
-                    (netsnmp_cache_check_and_reload( eptr->cache ) >= 0 )) {
+                    (_extend_check_and_reload( eptr ) >= 0 )) {
                     line_idx = 1;
                     break;
                 }
@@ -1319,7 +1656,7 @@ _extend_find_entry( netsnmp_request_info       *request,
              */
             for (    ; eptr; eptr = eptr->next ) {
                 if ((eptr->flags & NS_EXTEND_FLAGS_ACTIVE) &&
-                    (netsnmp_cache_check_and_reload( eptr->cache ) >= 0 )) {
+                    (_extend_check_and_reload( eptr ) >= 0 )) {
                     break;
                 }
                 line_idx = 1;
@@ -1341,7 +1678,7 @@ _extend_find_entry( netsnmp_request_info       *request,
                     line_idx = 1;
                     for (eptr = eptr->next ; eptr; eptr = eptr->next ) {
                         if ((eptr->flags & NS_EXTEND_FLAGS_ACTIVE) &&
-                            (netsnmp_cache_check_and_reload( eptr->cache ) >= 0 )) {
+                            (_extend_check_and_reload( eptr ) >= 0 )) {
                             break;
                         }
                     }
@@ -1399,8 +1736,8 @@ _extend_find_entry( netsnmp_request_info       *request,
  *  Locate the appropriate entry (using _extend_find_entry)
  *  and return the appropriate output line
  */
-int
-handle_nsExtendOutput2Table(netsnmp_mib_handler          *handler,
+static int
+_extend_output2_answer(netsnmp_mib_handler          *handler,
                      netsnmp_handler_registration *reginfo,
                      netsnmp_agent_request_info   *reqinfo,
                      netsnmp_request_info         *requests)
@@ -1474,6 +1811,58 @@ handle_nsExtendOutput2Table(netsnmp_mib_handler          *handler,
     return SNMP_ERR_NOERROR;
 }
 
+int
+handle_nsExtendOutput2Table(netsnmp_mib_handler          *handler,
+                     netsnmp_handler_registration *reginfo,
+                     netsnmp_agent_request_info   *reqinfo,
+                     netsnmp_request_info         *requests)
+{
+    netsnmp_request_info       *request;
+    netsnmp_table_request_info *table_info;
+    netsnmp_extend             *eptr;
+    extend_registration_block  *ereg;
+    extend_waiter              *waiter = NULL;
+    char  *token;
+    size_t token_len;
+
+    /*
+     * Start the entries whose output has expired - the one requested,
+     *  or (for GETNEXT) any from there on - and hold the request
+     *  until they've finished
+     */
+    for ( request=requests; request; request=request->next ) {
+        if (request->processed)
+            continue;
+        table_info = netsnmp_extract_table_info( request );
+        if (!table_info || !table_info->indexes
+                        || !table_info->indexes->next_variable)
+            continue;
+        ereg = _find_extension_block( request->requestvb->name,
+                                      request->requestvb->name_length );
+        if (!ereg)
+            continue;
+        token     = (char *) table_info->indexes->val.string;
+        token_len = table_info->indexes->val_len;
+        for ( eptr = ereg->ehead; eptr; eptr = eptr->next ) {
+            if ( reqinfo->mode == MODE_GET ) {
+                if ( strcmp( eptr->token, token ))
+                    continue;
+            } else if ( token_len ) {
+                if ( strlen(eptr->token) < token_len )
+                    continue;
+                if ( strlen(eptr->token) == token_len &&
+                     strcmp(eptr->token, token) < 0 )
+                    continue;
+            }
+            waiter = _extend_need( waiter, eptr );
+        }
+    }
+    if (waiter)
+        return _extend_delegate( waiter, _extend_output2_answer,
+                                 handler, reginfo, reqinfo, requests );
+    return _extend_output2_answer( handler, reginfo, reqinfo, requests );
+}
+
 #ifndef USING_UCD_SNMP_EXTENSIBLE_MODULE
         /*************************
          *
@@ -21,6 +21,9 @@ typedef struct netsnmp_extend_s {
     int      result;
 
     int      flags;
+    int      timeout;
+    struct netsnmp_run_job_s *job;
+    unsigned int       refresh;
     netsnmp_cache     *cache;
     netsnmp_table_row *row;
     netsnmp_table_data *dinfo;
@@ -61,6 +64,7 @@ void                 extend_parse_config(const char*, char*);
 #define NS_EXTEND_FLAGS_SHELL       0x02
 #define NS_EXTEND_FLAGS_WRITEABLE   0x04
 #define NS_EXTEND_FLAGS_CONFIG      0x08
+#define NS_EXTEND_FLAGS_READ        0x10	/* since the last run */
 
 #define NS_EXTEND_ETYPE_EXEC    1
 #define NS_EXTEND_ETYPE_SHELL   2
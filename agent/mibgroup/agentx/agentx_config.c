@@ -138,6 +138,19 @@ agentx_parse_agentx_retries(const char *token, char *cptr)
     netsnmp_ds_set_int(NETSNMP_DS_APPLICATION_ID,
                        NETSNMP_DS_AGENT_AGENTX_RETRIES, x);
 }
+
+void
+agentx_parse_agentx_window(const char *token, char *cptr)
+{
+    int x = atoi(cptr);
+    DEBUGMSGTL(("agentx/config/window", "%s\n", cptr));
+    if (x < 1) {
+        config_perror("agentxWindow must be at least 1");
+        return;
+    }
+    netsnmp_ds_set_int(NETSNMP_DS_APPLICATION_ID,
+                       NETSNMP_DS_AGENT_AGENTX_WINDOW, x);
+}
 #endif                          /* USING_AGENTX_MASTER_MODULE */
 
 /* ---------------------------------------------------------------------
@@ -204,6 +217,9 @@ agentx_config_init(void)
     agentx_register_config_handler("agentxTimeout",
                                   agentx_parse_agentx_timeout, NULL,
                                   "AgentX Timeout (seconds)");
+    agentx_register_config_handler("agentxWindow",
+                                  agentx_parse_agentx_window, NULL,
+                                  "AgentX requests outstanding to each subagent");
     }
 #endif                          /* USING_AGENTX_MASTER_MODULE */
 
@@ -54,6 +54,59 @@
 netsnmp_feature_require(handler_mark_requests_as_delegated)
 netsnmp_feature_require(unix_socket_paths)
 netsnmp_feature_require(free_agent_snmp_session_by_session)
+netsnmp_feature_require(snmp_split_pdu)
+
+/*
+ * Requests for a subagent are not sent by the master handler itself but
+ * queued, and sent from a zero-length alarm once the agent has dealt with
+ * everything it read in this pass.  Compatible GET and GETNEXT varbinds
+ * from different agent requests are merged into one AgentX PDU on the
+ * way, and at most agentxWindow AgentX requests are outstanding to a
+ * subagent at once; the rest wait in its queue for replies.
+ */
+#define AGENTX_DEFAULT_WINDOW       8
+#define AGENTX_BATCH_MAX_VARBINDS   64
+
+typedef struct agentx_part_s {
+    netsnmp_delegated_cache *cache;
+    int             nvars;          /* of the PDU's varbinds, in order */
+    struct agentx_part_s *next;
+} agentx_part;
+
+typedef struct agentx_batch_s {
+    struct agentx_subagent_s *sa;   /* NULL once the subagent has gone */
+    netsnmp_pdu    *pdu;
+    agentx_part    *parts, *last;
+    int             nparts;
+    int             nvars;
+    int             timeout;        /* seconds, or 0 for agentxTimeout */
+    int             alone;          /* don't add any more requests */
+    struct timeval  sent;
+    struct agentx_batch_s *next;
+} agentx_batch;
+
+typedef struct agentx_subagent_s {
+    netsnmp_session *session;       /* the subagent's connection */
+    u_long          index;
+    agentx_batch   *queue, *queue_tail;
+    agentx_batch   *outstanding;
+    u_long          in_flight;
+    u_long          queued;         /* varbinds */
+    u_long          requests;       /* AgentX requests sent */
+    u_long          varbinds;
+    u_long          batched;        /* agent requests merged into another's */
+    u_long          timeouts;
+    u_long          latency;        /* smoothed, in microseconds */
+    u_long          max_latency;
+    struct agentx_subagent_s *next;
+} agentx_subagent;
+
+static agentx_subagent *agentx_subagents;
+static u_long   agentx_last_subagent_index;
+static unsigned int agentx_flush_alarm;
+static agentx_batch *agentx_sending;
+
+static void     init_agentx_subagent_table(void);
 
 void
 real_init_master(void)
@@ -196,107 +249,294 @@ real_init_master(void)
 #endif
 
     SNMP_FREE(agentx_sockets);
+    init_agentx_subagent_table();
     DEBUGMSGTL(("agentx/master", "initializing...   DONE\n"));
 }
 
-        /*
-         * Handle the response from an AgentX subagent,
-         *   merging the answers back into the original query
-         */
-int
-agentx_got_response(int operation,
-                    netsnmp_session * session,
-                    int reqid, netsnmp_pdu *pdu, void *magic)
+int             agentx_got_response(int operation,
+                                    netsnmp_session * session,
+                                    int reqid, netsnmp_pdu *pdu,
+                                    void *magic);
+
+/*
+ * The queue and statistics for a subagent's connection
+ */
+static agentx_subagent *
+agentx_find_subagent(netsnmp_session * session, int create)
 {
-    netsnmp_delegated_cache *cache = (netsnmp_delegated_cache *) magic;
-    int             i, ret;
-    netsnmp_request_info *requests, *request;
-    netsnmp_variable_list *var;
-    netsnmp_session *ax_session;
+    agentx_subagent *sa, **prev;
 
-    cache = netsnmp_handler_check_cache(cache);
-    if (!cache) {
-        DEBUGMSGTL(("agentx/master", "response too late on session %8p\n",
-                    session));
-        /* response is too late, free the cache */
-        if (magic)
-            netsnmp_free_delegated_cache((netsnmp_delegated_cache*) magic);
-        return 0;
-    }
-    requests = cache->requests;
+    for (prev = &agentx_subagents; (sa = *prev) != NULL; prev = &sa->next)
+        if (sa->session == session)
+            return sa;
+    if (!create)
+        return NULL;
 
-    switch (operation) {
-    case NETSNMP_CALLBACK_OP_TIMED_OUT:{
-            void           *s = snmp_sess_pointer(session);
-            DEBUGMSGTL(("agentx/master", "timeout on session %8p req=0x%x\n",
-                        session, (unsigned)reqid));
+    sa = SNMP_MALLOC_TYPEDEF(agentx_subagent);
+    if (sa == NULL)
+        return NULL;
+    sa->session = session;
+    sa->index = ++agentx_last_subagent_index;
+    *prev = sa;
+    return sa;
+}
 
-            netsnmp_handler_mark_requests_as_delegated(requests,
-                                       REQUEST_IS_NOT_DELEGATED);
-            netsnmp_set_request_error(cache->reqinfo, requests,
-                                      /* XXXWWW: should be index=0 */
-                                      SNMP_ERR_GENERR);
+static void
+agentx_batch_free(agentx_batch *batch)
+{
+    agentx_part    *part, *next;
 
-            /*
-             * This is a bit sledgehammer because the other sessions on this
-             * transport may be okay (e.g. some thread in the subagent has
-             * wedged, but the others are alright).  OTOH the overwhelming
-             * probability is that the whole agent has died somehow.  
-             */
+    for (part = batch->parts; part; part = next) {
+        next = part->next;
+        free(part);
+    }
+    free(batch);
+}
 
-            if (s != NULL) {
-                netsnmp_transport *t = snmp_sess_transport(s);
-                close_agentx_session(session, -1);
+/*
+ * Take a batch off its subagent's list of outstanding requests
+ */
+static void
+agentx_batch_unlink(agentx_batch *batch)
+{
+    agentx_subagent *sa = batch->sa;
+    agentx_batch  **prev;
 
-                if (t != NULL) {
-                    DEBUGMSGTL(("agentx/master", "close transport\n"));
-                    t->f_close(t);
-                } else {
-                    DEBUGMSGTL(("agentx/master", "NULL transport??\n"));
-                }
-            } else {
-                DEBUGMSGTL(("agentx/master", "NULL sess_pointer??\n"));
-            }
-            ax_session = (netsnmp_session *) cache->localinfo;
-            netsnmp_free_agent_snmp_session_by_session(ax_session, NULL);
-            netsnmp_free_delegated_cache(cache);
-            return 0;
+    if (sa == NULL)
+        return;
+    for (prev = &sa->outstanding; *prev; prev = &(*prev)->next) {
+        if (*prev == batch) {
+            *prev = batch->next;
+            sa->in_flight--;
+            break;
         }
+    }
+}
 
-    case NETSNMP_CALLBACK_OP_DISCONNECT:
-    case NETSNMP_CALLBACK_OP_SEND_FAILED:
-        if (operation == NETSNMP_CALLBACK_OP_DISCONNECT) {
-            DEBUGMSGTL(("agentx/master", "disconnect on session %8p\n",
-                        session));
-        } else {
-            DEBUGMSGTL(("agentx/master", "send failed on session %8p\n",
-                        session));
-        }
-        close_agentx_session(session, -1);
-        netsnmp_handler_mark_requests_as_delegated(requests,
+static int
+agentx_batch_add(agentx_batch *batch, netsnmp_delegated_cache *cache,
+                 int nvars, int timeout)
+{
+    agentx_part    *part = SNMP_MALLOC_TYPEDEF(agentx_part);
+
+    if (part == NULL)
+        return -1;
+    part->cache = cache;
+    part->nvars = nvars;
+    if (batch->last)
+        batch->last->next = part;
+    else
+        batch->parts = part;
+    batch->last = part;
+    batch->nparts++;
+    batch->nvars += nvars;
+    if (timeout > batch->timeout)
+        batch->timeout = timeout;
+    return 0;
+}
+
+/*
+ * Give up on an agent request: genErr, unless it has finished already
+ */
+static void
+agentx_part_fail(agentx_part *part)
+{
+    netsnmp_delegated_cache *cache = netsnmp_handler_check_cache(part->cache);
+
+    if (cache) {
+        netsnmp_handler_mark_requests_as_delegated(cache->requests,
                                                    REQUEST_IS_NOT_DELEGATED);
-        netsnmp_set_request_error(cache->reqinfo, requests,     /* XXXWWW: should be index=0 */
+        netsnmp_set_request_error(cache->reqinfo, cache->requests,
+                                  /* XXXWWW: should be index=0 */
                                   SNMP_ERR_GENERR);
-        netsnmp_free_delegated_cache(cache);
-        return 0;
+    }
+    netsnmp_free_delegated_cache(part->cache);
+}
 
-    case NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE:
-        /*
-         * This session is alive 
-         */
-        CLEAR_SNMP_STRIKE_FLAGS(session->flags);
-        break;
-    default:
-        snmp_log(LOG_ERR, "Unknown operation %d in agentx_got_response\n",
-                 operation);
-        netsnmp_free_delegated_cache(cache);
-        return 0;
+static void
+agentx_batch_fail(agentx_batch *batch)
+{
+    agentx_part    *part;
+
+    for (part = batch->parts; part; part = part->next)
+        agentx_part_fail(part);
+}
+
+/*
+ * Forget a subagent's connection, which is being closed.  Requests still
+ * queued for it fail, and the replies to those already sent will find
+ * no subagent to account them to.
+ */
+void
+agentx_master_forget_session(netsnmp_session * session)
+{
+    agentx_subagent *sa, **prev;
+    agentx_batch   *batch, *next;
+
+    for (prev = &agentx_subagents; (sa = *prev) != NULL; prev = &sa->next)
+        if (sa->session == session)
+            break;
+    if (sa == NULL)
+        return;
+    *prev = sa->next;
+
+    for (batch = sa->queue; batch; batch = next) {
+        next = batch->next;
+        agentx_batch_fail(batch);
+        snmp_free_pdu(batch->pdu);
+        agentx_batch_free(batch);
     }
+    for (batch = sa->outstanding; batch; batch = batch->next)
+        batch->sa = NULL;
+    free(sa);
+}
 
-    DEBUGMSGTL(("agentx/master", "got response errstat=%ld, (req=0x%x,trans="
-                "0x%x,sess=0x%x)\n",
-                pdu->errstat, (unsigned)pdu->reqid, (unsigned)pdu->transid,
-		(unsigned)pdu->sessid));
+static int
+agentx_master_shutdown(int majorID, int minorID, void *serverarg,
+                       void *clientarg)
+{
+    while (agentx_subagents)
+        agentx_master_forget_session(agentx_subagents->session);
+    return 0;
+}
+
+static void
+agentx_batch_send(agentx_subagent *sa, agentx_batch *batch)
+{
+    netsnmp_pdu    *pdu = batch->pdu;
+
+    if (batch->timeout > 0) {
+        pdu->time = batch->timeout;
+        pdu->flags |= UCD_MSG_FLAG_PDU_TIMEOUT;
+    }
+    batch->sa = sa;
+    batch->next = sa->outstanding;
+    sa->outstanding = batch;
+    sa->in_flight++;
+    sa->requests++;
+    sa->varbinds += batch->nvars;
+    sa->batched += batch->nparts - 1;
+    netsnmp_get_monotonic_clock(&batch->sent);
+
+    DEBUGMSGTL(("agentx/master", "sending pdu (req=0x%x,trans=0x%x,sess=0x%x)"
+                " for %d request(s)\n", (unsigned)pdu->reqid,
+                (unsigned)pdu->transid, (unsigned)pdu->sessid,
+                batch->nparts));
+    /*
+     * A send that fails may or may not have been reported to
+     * agentx_got_response already; if it hasn't, clean up here.
+     */
+    agentx_sending = batch;
+    if (snmp_async_send(sa->session, pdu, agentx_got_response, batch) == 0) {
+        if (agentx_sending == batch) {
+            agentx_batch_unlink(batch);
+            agentx_batch_fail(batch);
+            agentx_batch_free(batch);
+        }
+        snmp_free_pdu(pdu);
+    }
+    agentx_sending = NULL;
+}
+
+/*
+ * Send what the window allows from a subagent's queue
+ */
+static void
+agentx_run_queue(netsnmp_session * session)
+{
+    agentx_subagent *sa;
+    agentx_batch   *batch;
+    int             window;
+
+    window = netsnmp_ds_get_int(NETSNMP_DS_APPLICATION_ID,
+                                NETSNMP_DS_AGENT_AGENTX_WINDOW);
+    if (window <= 0)
+        window = AGENTX_DEFAULT_WINDOW;
+
+    while ((sa = agentx_find_subagent(session, 0)) != NULL && sa->queue &&
+           sa->in_flight < (u_long) window) {
+        batch = sa->queue;
+        sa->queue = batch->next;
+        if (sa->queue == NULL)
+            sa->queue_tail = NULL;
+        sa->queued -= batch->nvars;
+        agentx_batch_send(sa, batch);
+    }
+}
+
+static void
+agentx_flush(unsigned int clientreg, void *clientarg)
+{
+    agentx_subagent *sa, *next;
+
+    agentx_flush_alarm = 0;
+    for (sa = agentx_subagents; sa; sa = next) {
+        next = sa->next;
+        agentx_run_queue(sa->session);
+    }
+}
+
+static void
+agentx_schedule_flush(netsnmp_session * session)
+{
+    static const struct timeval now = { 0, 0 };
+
+    if (agentx_flush_alarm)
+        return;
+    agentx_flush_alarm = snmp_alarm_register_hr(now, 0, agentx_flush, NULL);
+    if (!agentx_flush_alarm)
+        agentx_run_queue(session);
+}
+
+/*
+ * Ask again for one agent request from a batch, on its own, at the head
+ * of the queue: the subagent failed another request in the batch, and
+ * that says nothing about this one.
+ */
+static agentx_batch *
+agentx_part_retry(agentx_batch *batch, agentx_part *part, int skip)
+{
+    agentx_batch   *retry = NULL;
+
+    if (batch->sa != NULL && netsnmp_handler_check_cache(part->cache) &&
+        (retry = SNMP_MALLOC_TYPEDEF(agentx_batch)) != NULL) {
+        retry->pdu = snmp_split_pdu(batch->pdu, skip, part->nvars);
+        if (retry->pdu == NULL ||
+            agentx_batch_add(retry, part->cache, part->nvars,
+                             batch->timeout) < 0) {
+            snmp_free_pdu(retry->pdu);
+            agentx_batch_free(retry);
+            retry = NULL;
+        }
+    }
+    if (retry == NULL) {
+        agentx_part_fail(part);
+        return NULL;
+    }
+    retry->pdu->reqid = snmp_get_next_transid();
+    retry->pdu->flags &= ~UCD_MSG_FLAG_PDU_TIMEOUT;
+    retry->alone = 1;
+    return retry;
+}
+
+/*
+ * Merge a subagent's answers for one agent request back into it
+ */
+static void
+agentx_part_answer(agentx_part *part, netsnmp_pdu *pdu, long errindex,
+                   netsnmp_variable_list *var)
+{
+    netsnmp_delegated_cache *cache = netsnmp_handler_check_cache(part->cache);
+    netsnmp_request_info *requests, *request;
+    int             i, ret;
+
+    if (!cache) {
+        DEBUGMSGTL(("agentx/master", "response too late\n"));
+        /* response is too late, free the cache */
+        netsnmp_free_delegated_cache(part->cache);
+        return;
+    }
+    requests = cache->requests;
 
     if (pdu->errstat != AGENTX_ERR_NOERROR) {
         /* [RFC 2471 - 7.2.5.2.]
@@ -333,7 +573,7 @@ agentx_got_response(int operation,
         ret = 0;
         for (request = requests, i = 1; request;
              request = request->next, i++) {
-            if (i == pdu->errindex) {
+            if (i == errindex) {
                 /*
                  * Mark this varbind as the one generating the error.
                  * Note that the AgentX errindex may not match the
@@ -352,9 +592,7 @@ agentx_got_response(int operation,
             netsnmp_set_request_error(cache->reqinfo, requests,
                                       SNMP_ERR_GENERR);
         }
-        netsnmp_free_delegated_cache(cache);
         DEBUGMSGTL(("agentx/master", "end error branch\n"));
-        return 1;
     } else if (cache->reqinfo->mode == MODE_GET ||
                cache->reqinfo->mode == MODE_GETNEXT ||
                cache->reqinfo->mode == MODE_GETBULK) {
@@ -363,7 +601,7 @@ agentx_got_response(int operation,
          */
         DEBUGMSGTL(("agentx/master",
                     "agentx_got_response() beginning...\n"));
-        for (var = pdu->variables, request = requests; request && var;
+        for (request = requests; request && var;
              request = request->next, var = var->next_variable) {
             /*
              * Otherwise, process successful requests
@@ -397,6 +635,8 @@ agentx_got_response(int operation,
              */
             snmp_log(LOG_ERR,
                      "response to agentx request illegal.  bailing out.\n");
+            netsnmp_handler_mark_requests_as_delegated(requests,
+                                                   REQUEST_IS_NOT_DELEGATED);
             netsnmp_set_request_error(cache->reqinfo, requests,
                                       SNMP_ERR_GENERR);
         }
@@ -411,99 +651,205 @@ agentx_got_response(int operation,
             request->delegated = REQUEST_IS_NOT_DELEGATED;
         }
     }
-    DEBUGMSGTL(("agentx/master",
-                "handle_agentx_response() finishing...\n"));
     netsnmp_free_delegated_cache(cache);
-    return 1;
 }
 
 /*
- *
- * AgentX State diagram.  [mode] = internal mode it's mapped from:
- *
- * TESTSET -success-> COMMIT -success-> CLEANUP
- * [RESERVE1]         [ACTION]          [COMMIT]
- *    |                 |
- *    |                 \--failure-> UNDO
- *    |                              [UNDO]
- *    |
- *     --failure-> CLEANUP
- *                 [FREE]
+ * Share a response out between the agent requests in the batch.  An
+ * error belongs to the request holding the varbind it names; the others
+ * are asked again on their own.
  */
-int
-agentx_master_handler(netsnmp_mib_handler *handler,
-                      netsnmp_handler_registration *reginfo,
-                      netsnmp_agent_request_info *reqinfo,
-                      netsnmp_request_info *requests)
+static void
+agentx_batch_answer(agentx_batch *batch, netsnmp_pdu *pdu)
 {
-    netsnmp_session *ax_session = (netsnmp_session *) handler->myvoid;
-    netsnmp_request_info *request = requests;
-    netsnmp_pdu    *pdu;
-    void           *cb_data;
-    int             result;
-
-    DEBUGMSGTL(("agentx/master",
-                "agentx master handler starting, mode = 0x%02x\n",
-                reqinfo->mode));
-
-    if (!ax_session) {
-        netsnmp_set_request_error(reqinfo, requests, SNMP_ERR_GENERR);
-        return SNMP_ERR_NOERROR;
-    }        
+    netsnmp_variable_list *var, *last, *next;
+    agentx_batch   *retries = NULL, *retry_tail = NULL, *retry;
+    agentx_part    *part;
+    agentx_subagent *sa = batch->sa;
+    int             first, n;
 
-    /*
-     * build a new pdu based on the pdu type coming in 
-     */
-    switch (reqinfo->mode) {
-    case MODE_GET:
-        pdu = snmp_pdu_create(AGENTX_MSG_GET);
-        break;
+    DEBUGMSGTL(("agentx/master", "got response errstat=%ld, (req=0x%x,trans="
+                "0x%x,sess=0x%x) for %d request(s)\n",
+                pdu->errstat, (unsigned)pdu->reqid, (unsigned)pdu->transid,
+		(unsigned)pdu->sessid, batch->nparts));
 
-    case MODE_GETNEXT:
-        pdu = snmp_pdu_create(AGENTX_MSG_GETNEXT);
-        break;
+    if (pdu->errstat == AGENTX_ERR_NOERROR && batch->nparts > 1) {
+        for (n = 0, var = pdu->variables; var; var = var->next_variable)
+            n++;
+        if (n != batch->nvars) {
+            snmp_log(LOG_ERR,
+                     "response to agentx request illegal.  bailing out.\n");
+            agentx_batch_fail(batch);
+            return;
+        }
+    }
 
-    case MODE_GETBULK:         /* WWWXXX */
-        pdu = snmp_pdu_create(AGENTX_MSG_GETNEXT);
-        break;
+    var = pdu->variables;
+    for (part = batch->parts, first = 1; part; part = part->next) {
+        /*
+         * hand each part only its own varbinds; the last gets any extra
+         */
+        for (n = 1, last = var; n < part->nvars && last; n++)
+            last = last->next_variable;
+        next = last ? last->next_variable : NULL;
+        if (last && part->next)
+            last->next_variable = NULL;
+        if (pdu->errstat != AGENTX_ERR_NOERROR && batch->nparts > 1 &&
+            (pdu->errindex < first || pdu->errindex >= first + part->nvars)) {
+            retry = agentx_part_retry(batch, part, first - 1);
+            if (retry) {
+                if (retry_tail)
+                    retry_tail->next = retry;
+                else
+                    retries = retry;
+                retry_tail = retry;
+                sa->queued += retry->nvars;
+            }
+        } else
+            agentx_part_answer(part, pdu, pdu->errindex - first + 1, var);
+        if (last && part->next)
+            last->next_variable = next;
+        var = next;
+        first += part->nvars;
+    }
 
-#ifndef NETSNMP_NO_WRITE_SUPPORT
-    case MODE_SET_RESERVE1:
-        pdu = snmp_pdu_create(AGENTX_MSG_TESTSET);
-        break;
+    if (retries) {
+        retry_tail->next = sa->queue;
+        if (sa->queue == NULL)
+            sa->queue_tail = retry_tail;
+        sa->queue = retries;
+    }
+}
 
-    case MODE_SET_RESERVE2:
         /*
-         * don't do anything here for AgentX.  Assume all is fine
-         * and go on since AgentX only has one test phase. 
+         * Handle the response from an AgentX subagent,
+         *   merging the answers back into the original queries
          */
-        return SNMP_ERR_NOERROR;
+int
+agentx_got_response(int operation,
+                    netsnmp_session * session,
+                    int reqid, netsnmp_pdu *pdu, void *magic)
+{
+    agentx_batch   *batch = (agentx_batch *) magic;
+    agentx_subagent *sa = batch->sa;
+    struct timeval  now;
+    u_long          usec;
 
-    case MODE_SET_ACTION:
-        pdu = snmp_pdu_create(AGENTX_MSG_COMMITSET);
-        break;
+    if (batch == agentx_sending)
+        agentx_sending = NULL;
+    agentx_batch_unlink(batch);
 
-    case MODE_SET_UNDO:
-        pdu = snmp_pdu_create(AGENTX_MSG_UNDOSET);
-        break;
+    switch (operation) {
+    case NETSNMP_CALLBACK_OP_TIMED_OUT:{
+            void           *s = snmp_sess_pointer(session);
+            DEBUGMSGTL(("agentx/master", "timeout on session %8p req=0x%x\n",
+                        session, (unsigned)reqid));
 
-    case MODE_SET_COMMIT:
-    case MODE_SET_FREE:
-        pdu = snmp_pdu_create(AGENTX_MSG_CLEANUPSET);
-        break;
-#endif /* !NETSNMP_NO_WRITE_SUPPORT */
+            if (sa)
+                sa->timeouts++;
+            agentx_batch_fail(batch);
+            agentx_batch_free(batch);
+
+            /*
+             * This is a bit sledgehammer because the other sessions on this
+             * transport may be okay (e.g. some thread in the subagent has
+             * wedged, but the others are alright).  OTOH the overwhelming
+             * probability is that the whole agent has died somehow.
+             */
+
+            if (s != NULL) {
+                netsnmp_transport *t = snmp_sess_transport(s);
+                close_agentx_session(session, -1);
+
+                if (t != NULL) {
+                    DEBUGMSGTL(("agentx/master", "close transport\n"));
+                    t->f_close(t);
+                } else {
+                    DEBUGMSGTL(("agentx/master", "NULL transport??\n"));
+                }
+            } else {
+                DEBUGMSGTL(("agentx/master", "NULL sess_pointer??\n"));
+            }
+            netsnmp_free_agent_snmp_session_by_session(session, NULL);
+            return 0;
+        }
+
+    case NETSNMP_CALLBACK_OP_DISCONNECT:
+    case NETSNMP_CALLBACK_OP_SEND_FAILED:
+        if (operation == NETSNMP_CALLBACK_OP_DISCONNECT) {
+            DEBUGMSGTL(("agentx/master", "disconnect on session %8p\n",
+                        session));
+        } else {
+            DEBUGMSGTL(("agentx/master", "send failed on session %8p\n",
+                        session));
+        }
+        agentx_batch_fail(batch);
+        agentx_batch_free(batch);
+        close_agentx_session(session, -1);
+        return 0;
 
+    case NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE:
+        /*
+         * This session is alive
+         */
+        CLEAR_SNMP_STRIKE_FLAGS(session->flags);
+        break;
     default:
-        snmp_log(LOG_WARNING,
-                 "unsupported mode for agentx/master called\n");
-        return SNMP_ERR_NOERROR;
+        snmp_log(LOG_ERR, "Unknown operation %d in agentx_got_response\n",
+                 operation);
+        agentx_batch_fail(batch);
+        agentx_batch_free(batch);
+        return 0;
     }
 
-    if (!pdu) {
-        netsnmp_set_request_error(reqinfo, requests, SNMP_ERR_GENERR);
-        return SNMP_ERR_NOERROR;
+    if (sa) {
+        netsnmp_get_monotonic_clock(&now);
+        usec = (now.tv_sec - batch->sent.tv_sec) * 1000000 +
+            now.tv_usec - batch->sent.tv_usec;
+        sa->latency = sa->latency ? (sa->latency * 7 + usec) / 8 : usec;
+        if (usec > sa->max_latency)
+            sa->max_latency = usec;
     }
+    agentx_batch_answer(batch, pdu);
+    agentx_batch_free(batch);
+    DEBUGMSGTL(("agentx/master",
+                "handle_agentx_response() finishing...\n"));
+    agentx_run_queue(session);
+    return 1;
+}
+
+/*
+ * Can an agent request's varbinds go in a batch that's still queued?
+ */
+static int
+agentx_batch_fits(agentx_batch *batch, int command, int nvars,
+                  netsnmp_session * ax_session, const char *context)
+{
+    netsnmp_pdu    *pdu = batch->pdu;
+
+    if (batch->alone || pdu->command != command ||
+        batch->nvars + nvars > AGENTX_BATCH_MAX_VARBINDS ||
+        pdu->sessid != ax_session->subsession->sessid)
+        return 0;
+    if (context == NULL)
+        return pdu->community == NULL;
+    return pdu->community != NULL &&
+        pdu->community_len == strlen(context) &&
+        memcmp(pdu->community, context, pdu->community_len) == 0;
+}
+
+/*
+ * A new AgentX request PDU for the subagent
+ */
+static netsnmp_pdu *
+agentx_master_pdu(int command, netsnmp_session * ax_session,
+                  netsnmp_handler_registration *reginfo,
+                  netsnmp_agent_request_info *reqinfo)
+{
+    netsnmp_pdu    *pdu = snmp_pdu_create(command);
 
+    if (!pdu)
+        return NULL;
     pdu->version = AGENTX_VERSION_1;
     pdu->reqid = snmp_get_next_transid();
     pdu->transid = reqinfo->asp->pdu->transid;
@@ -515,7 +861,17 @@ agentx_master_handler(netsnmp_mib_handler *handler,
     }
     if (ax_session->subsession->flags & AGENTX_MSG_FLAG_NETWORK_BYTE_ORDER)
         pdu->flags |= AGENTX_MSG_FLAG_NETWORK_BYTE_ORDER;
+    return pdu;
+}
 
+/*
+ * Add an agent request's varbinds to an AgentX PDU
+ */
+static void
+agentx_master_add_requests(netsnmp_pdu *pdu,
+                           netsnmp_agent_request_info *reqinfo,
+                           netsnmp_request_info *request)
+{
     while (request) {
 
         size_t nlen = request->requestvb->name_length;
@@ -587,30 +943,314 @@ agentx_master_handler(netsnmp_mib_handler *handler,
          */
         request = request->next;
     }
+}
+
+/*
+ *
+ * AgentX State diagram.  [mode] = internal mode it's mapped from:
+ *
+ * TESTSET -success-> COMMIT -success-> CLEANUP
+ * [RESERVE1]         [ACTION]          [COMMIT]
+ *    |                 |
+ *    |                 \--failure-> UNDO
+ *    |                              [UNDO]
+ *    |
+ *     --failure-> CLEANUP
+ *                 [FREE]
+ */
+int
+agentx_master_handler(netsnmp_mib_handler *handler,
+                      netsnmp_handler_registration *reginfo,
+                      netsnmp_agent_request_info *reqinfo,
+                      netsnmp_request_info *requests)
+{
+    netsnmp_session *ax_session = (netsnmp_session *) handler->myvoid;
+    netsnmp_request_info *request = requests;
+    netsnmp_pdu    *pdu;
+    netsnmp_delegated_cache *cache;
+    agentx_subagent *sa;
+    agentx_batch   *batch = NULL;
+    int             command, nvars, timeout;
+
+    DEBUGMSGTL(("agentx/master",
+                "agentx master handler starting, mode = 0x%02x\n",
+                reqinfo->mode));
+
+    if (!ax_session) {
+        netsnmp_set_request_error(reqinfo, requests, SNMP_ERR_GENERR);
+        return SNMP_ERR_NOERROR;
+    }        
+
+    /*
+     * build a new pdu based on the pdu type coming in 
+     */
+    switch (reqinfo->mode) {
+    case MODE_GET:
+        command = AGENTX_MSG_GET;
+        break;
+
+    case MODE_GETNEXT:
+        command = AGENTX_MSG_GETNEXT;
+        break;
+
+    case MODE_GETBULK:         /* WWWXXX */
+        command = AGENTX_MSG_GETNEXT;
+        break;
+
+#ifndef NETSNMP_NO_WRITE_SUPPORT
+    case MODE_SET_RESERVE1:
+        command = AGENTX_MSG_TESTSET;
+        break;
+
+    case MODE_SET_RESERVE2:
+        /*
+         * don't do anything here for AgentX.  Assume all is fine
+         * and go on since AgentX only has one test phase. 
+         */
+        return SNMP_ERR_NOERROR;
+
+    case MODE_SET_ACTION:
+        command = AGENTX_MSG_COMMITSET;
+        break;
+
+    case MODE_SET_UNDO:
+        command = AGENTX_MSG_UNDOSET;
+        break;
+
+    case MODE_SET_COMMIT:
+    case MODE_SET_FREE:
+        command = AGENTX_MSG_CLEANUPSET;
+        break;
+#endif /* !NETSNMP_NO_WRITE_SUPPORT */
+
+    default:
+        snmp_log(LOG_WARNING,
+                 "unsupported mode for agentx/master called\n");
+        return SNMP_ERR_NOERROR;
+    }
 
     /*
      * When the master sends a CleanupSet PDU, it will never get a response
      * back from the subagent. So we shouldn't allocate the
      * netsnmp_delegated_cache structure in this case.
      */
-    if (pdu->command != AGENTX_MSG_CLEANUPSET)
-        cb_data = netsnmp_create_delegated_cache(handler, reginfo,
-                                                 reqinfo, requests,
-                                                 (void *) ax_session);
-    else
-        cb_data = NULL;
+    if (command == AGENTX_MSG_CLEANUPSET) {
+        pdu = agentx_master_pdu(command, ax_session, reginfo, reqinfo);
+        if (!pdu) {
+            netsnmp_set_request_error(reqinfo, requests, SNMP_ERR_GENERR);
+            return SNMP_ERR_NOERROR;
+        }
+        agentx_master_add_requests(pdu, reqinfo, requests);
+        DEBUGMSGTL(("agentx/master", "sending pdu (req=0x%x,trans=0x%x,sess=0x%x)\n",
+                    (unsigned)pdu->reqid, (unsigned)pdu->transid, (unsigned)pdu->sessid));
+        if (snmp_async_send(ax_session, pdu, NULL, NULL) == 0)
+            snmp_free_pdu(pdu);
+        return SNMP_ERR_NOERROR;
+    }
+
+    for (nvars = 0; request; request = request->next)
+        nvars++;
 
     /*
-     * send the requests out.
+     * Wait for as long as the subagent asked, when it registered the
+     * subtree or failing that when it opened its session.
      */
-    DEBUGMSGTL(("agentx/master", "sending pdu (req=0x%x,trans=0x%x,sess=0x%x)\n",
-                (unsigned)pdu->reqid, (unsigned)pdu->transid, (unsigned)pdu->sessid));
-    result = snmp_async_send(ax_session, pdu, agentx_got_response, cb_data);
-    if (result == 0) {
-        snmp_free_pdu(pdu);
-        if (cb_data)
-            netsnmp_free_delegated_cache((netsnmp_delegated_cache*) cb_data);
+    timeout = requests->subtree ? requests->subtree->timeout : 0;
+    if (timeout <= 0)
+        timeout = ax_session->subsession->timeout;
+
+    /*
+     * GETs and GETNEXTs join the last request queued for the subagent
+     * if they can; everything else goes in an AgentX PDU of its own.
+     */
+    sa = agentx_find_subagent(ax_session, 1);
+    cache = netsnmp_create_delegated_cache(handler, reginfo, reqinfo,
+                                           requests, (void *) ax_session);
+    if (!sa || !cache) {
+        netsnmp_set_request_error(reqinfo, requests, SNMP_ERR_GENERR);
+        if (cache)
+            netsnmp_free_delegated_cache(cache);
+        return SNMP_ERR_NOERROR;
+    }
+    if ((command == AGENTX_MSG_GET || command == AGENTX_MSG_GETNEXT) &&
+        sa->queue_tail && agentx_batch_fits(sa->queue_tail, command, nvars,
+                                            ax_session, reginfo->contextName))
+        batch = sa->queue_tail;
+    else if ((batch = SNMP_MALLOC_TYPEDEF(agentx_batch)) != NULL &&
+             (batch->pdu = agentx_master_pdu(command, ax_session, reginfo,
+                                             reqinfo)) == NULL)
+        SNMP_FREE(batch);
+    if (!batch || agentx_batch_add(batch, cache, nvars, timeout) < 0) {
+        netsnmp_set_request_error(reqinfo, requests, SNMP_ERR_GENERR);
+        netsnmp_free_delegated_cache(cache);
+        if (batch && batch != sa->queue_tail) {
+            snmp_free_pdu(batch->pdu);
+            agentx_batch_free(batch);
+        }
+        return SNMP_ERR_NOERROR;
+    }
+    agentx_master_add_requests(batch->pdu, reqinfo, requests);
+
+    if (batch->nparts == 1) {
+        /*
+         * SETs go straight away; other requests wait for the rest of
+         * this pass, and for room in the window
+         */
+        if (command != AGENTX_MSG_GET && command != AGENTX_MSG_GETNEXT) {
+            batch->alone = 1;
+            agentx_batch_send(sa, batch);
+            return SNMP_ERR_NOERROR;
+        }
+        if (sa->queue_tail)
+            sa->queue_tail->next = batch;
+        else
+            sa->queue = batch;
+        sa->queue_tail = batch;
     }
+    sa->queued += nvars;
+    agentx_schedule_flush(ax_session);
+
+    return SNMP_ERR_NOERROR;
+}
+
+/*
+ * NET-SNMP-AGENT-MIB::nsAgentxSubagentTable, one row for each subagent
+ * connection
+ */
+#define COLUMN_NSAGENTXSUBAGENTDESCR        2
+#define COLUMN_NSAGENTXSUBAGENTINFLIGHT     3
+#define COLUMN_NSAGENTXSUBAGENTQUEUED       4
+#define COLUMN_NSAGENTXSUBAGENTREQUESTS     5
+#define COLUMN_NSAGENTXSUBAGENTVARBINDS     6
+#define COLUMN_NSAGENTXSUBAGENTBATCHED      7
+#define COLUMN_NSAGENTXSUBAGENTTIMEOUTS     8
+#define COLUMN_NSAGENTXSUBAGENTLATENCY      9
+#define COLUMN_NSAGENTXSUBAGENTMAXLATENCY   10
+
+static netsnmp_variable_list *
+agentx_subagent_next_data_point(void **my_loop_context,
+                                void **my_data_context,
+                                netsnmp_variable_list *put_index_data,
+                                netsnmp_iterator_info *iinfo)
+{
+    agentx_subagent *sa = (agentx_subagent *) *my_loop_context;
+
+    if (sa == NULL)
+        return NULL;
+    *my_loop_context = (void *) sa->next;
+    *my_data_context = (void *) sa;
+    snmp_set_var_typed_integer(put_index_data, ASN_UNSIGNED, sa->index);
+    return put_index_data;
+}
+
+static netsnmp_variable_list *
+agentx_subagent_first_data_point(void **my_loop_context,
+                                 void **my_data_context,
+                                 netsnmp_variable_list *put_index_data,
+                                 netsnmp_iterator_info *iinfo)
+{
+    *my_loop_context = (void *) agentx_subagents;
+    return agentx_subagent_next_data_point(my_loop_context, my_data_context,
+                                           put_index_data, iinfo);
+}
+
+static int
+agentx_subagent_table_handler(netsnmp_mib_handler *handler,
+                              netsnmp_handler_registration *reginfo,
+                              netsnmp_agent_request_info *reqinfo,
+                              netsnmp_request_info *requests)
+{
+    netsnmp_table_request_info *table_info;
+    netsnmp_variable_list *var;
+    agentx_subagent *sa;
+    const char     *descr;
+
+    for (; requests; requests = requests->next) {
+        var = requests->requestvb;
+        if (requests->processed != 0)
+            continue;
+
+        sa = (agentx_subagent *) netsnmp_extract_iterator_context(requests);
+        if (sa == NULL) {
+            netsnmp_set_request_error(reqinfo, requests,
+                                      SNMP_NOSUCHINSTANCE);
+            continue;
+        }
+        table_info = netsnmp_extract_table_info(requests);
+        if (!table_info)
+            continue;
 
+        switch (table_info->colnum) {
+        case COLUMN_NSAGENTXSUBAGENTDESCR:
+            descr = sa->session->subsession &&
+                sa->session->subsession->securityName ?
+                sa->session->subsession->securityName : "";
+            snmp_set_var_typed_value(var, ASN_OCTET_STR,
+                                     (const u_char *) descr, strlen(descr));
+            break;
+        case COLUMN_NSAGENTXSUBAGENTINFLIGHT:
+            snmp_set_var_typed_integer(var, ASN_GAUGE, sa->in_flight);
+            break;
+        case COLUMN_NSAGENTXSUBAGENTQUEUED:
+            snmp_set_var_typed_integer(var, ASN_GAUGE, sa->queued);
+            break;
+        case COLUMN_NSAGENTXSUBAGENTREQUESTS:
+            snmp_set_var_typed_integer(var, ASN_COUNTER, sa->requests);
+            break;
+        case COLUMN_NSAGENTXSUBAGENTVARBINDS:
+            snmp_set_var_typed_integer(var, ASN_COUNTER, sa->varbinds);
+            break;
+        case COLUMN_NSAGENTXSUBAGENTBATCHED:
+            snmp_set_var_typed_integer(var, ASN_COUNTER, sa->batched);
+            break;
+        case COLUMN_NSAGENTXSUBAGENTTIMEOUTS:
+            snmp_set_var_typed_integer(var, ASN_COUNTER, sa->timeouts);
+            break;
+        case COLUMN_NSAGENTXSUBAGENTLATENCY:
+            snmp_set_var_typed_integer(var, ASN_GAUGE, sa->latency);
+            break;
+        case COLUMN_NSAGENTXSUBAGENTMAXLATENCY:
+            snmp_set_var_typed_integer(var, ASN_GAUGE, sa->max_latency);
+            break;
+        default:
+            netsnmp_set_request_error(reqinfo, requests,
+                                      SNMP_NOSUCHOBJECT);
+        }
+    }
     return SNMP_ERR_NOERROR;
 }
+
+static void
+init_agentx_subagent_table(void)
+{
+    const oid nsAgentxSubagentTable_oid[] =
+        { 1, 3, 6, 1, 4, 1, 8072, 1, 8, 2 };
+    netsnmp_table_registration_info *table_info;
+    netsnmp_handler_registration *reg;
+    netsnmp_iterator_info *iinfo;
+
+    snmp_register_callback(SNMP_CALLBACK_LIBRARY, SNMP_CALLBACK_SHUTDOWN,
+                           agentx_master_shutdown, NULL);
+
+    table_info = SNMP_MALLOC_TYPEDEF(netsnmp_table_registration_info);
+    iinfo = SNMP_MALLOC_TYPEDEF(netsnmp_iterator_info);
+    reg = netsnmp_create_handler_registration(
+        "nsAgentxSubagentTable", agentx_subagent_table_handler,
+        nsAgentxSubagentTable_oid, OID_LENGTH(nsAgentxSubagentTable_oid),
+        HANDLER_CAN_RONLY);
+    if (!reg || !table_info || !iinfo) {
+        if (reg)
+            netsnmp_handler_registration_free(reg);
+        SNMP_FREE(table_info);
+        SNMP_FREE(iinfo);
+        return;
+    }
+
+    netsnmp_table_helper_add_index(table_info, ASN_UNSIGNED);
+    table_info->min_column = COLUMN_NSAGENTXSUBAGENTDESCR;
+    table_info->max_column = COLUMN_NSAGENTXSUBAGENTMAXLATENCY;
+    iinfo->get_first_data_point = agentx_subagent_first_data_point;
+    iinfo->get_next_data_point = agentx_subagent_next_data_point;
+    iinfo->table_reginfo = table_info;
+    netsnmp_register_table_iterator2(reg, iinfo);
+}
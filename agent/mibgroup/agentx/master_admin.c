@@ -37,6 +37,7 @@
 #include "agentx/client.h"
 #include "agentx/subagent.h"
 #include "agentx/master_admin.h"
+#include "agentx/master.h"
 
 #include <net-snmp/agent/agent_index.h>
 #include <net-snmp/agent/agent_trap.h>
@@ -148,6 +149,7 @@ close_agentx_session(netsnmp_session * session, int sessid)
             }
         }
                 
+        agentx_master_forget_session(session);
         unregister_mibs_by_session(session);
         unregister_index_by_session(session);
         unregister_sysORTable_by_session(session);
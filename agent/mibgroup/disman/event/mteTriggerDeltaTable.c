@@ -65,7 +65,8 @@ init_mteTriggerDeltaTable(void)
     rc = netsnmp_tdata_register(reg, trigger_table_data, table_info);
     if (rc != SNMPERR_SUCCESS)
         return;
-    netsnmp_handler_owns_table_info(reg->handler->next);
+    netsnmp_handler_owns_table_info(
+        netsnmp_find_handler_by_name(reg, "table"));
     DEBUGMSGTL(("disman:event:init", "Trigger Delta Table\n"));
 }
 
@@ -66,7 +66,8 @@ init_mteTriggerExistenceTable(void)
     if (rc != SNMPERR_SUCCESS)
         return;
 
-    netsnmp_handler_owns_table_info(reg->handler->next);
+    netsnmp_handler_owns_table_info(
+        netsnmp_find_handler_by_name(reg, "table"));
     DEBUGMSGTL(("disman:event:init", "Trigger Exist Table\n"));
 }
 
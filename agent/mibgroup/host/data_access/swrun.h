@@ -38,6 +38,7 @@ config_exclude(host/hr_swrun)
     config_require(host/data_access/swrun_kinfo)
 #elif defined( linux )
     config_require(host/data_access/swrun_procfs_status)
+    config_require(util_funcs/proc_snapshot)
 #elif defined( cygwin )
     config_require(host/data_access/swrun_cygwin)
 #else
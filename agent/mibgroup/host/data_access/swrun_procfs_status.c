@@ -1,7 +1,8 @@
 /*
  * swrun_procfs_linux.c:
  *     hrSWRunTable data access:
- *     /proc/{pid}/status interface - Linux
+ *     /proc/{pid}/stat and cmdline interface - Linux,
+ *     read by util_funcs/proc_snapshot
  */
 #include <net-snmp/net-snmp-config.h>
 
@@ -30,6 +31,7 @@
 #include <net-snmp/library/snmp_debug.h>
 #include <net-snmp/data_access/swrun.h>
 #include "swrun_private.h"
+#include "mibgroup/util_funcs/proc_snapshot.h"
 
 static long pagesize;
 static long sc_clk_tck;
@@ -53,16 +55,14 @@ netsnmp_arch_swrun_init(void)
 int
 netsnmp_arch_swrun_container_load( netsnmp_container *container, u_int flags)
 {
-    DIR                 *procdir = NULL;
-    struct dirent       *procentry_p;
-    FILE                *fp;
-    int                  pid, i;
-    unsigned long long   cpu;
-    char                 buf[BUFSIZ], buf2[BUFSIZ], *cp, *cp1;
+    netsnmp_proc_snapshot *procs;
+    netsnmp_proc_entry  *proc;
     netsnmp_swrun_entry *entry;
-    
-    procdir = opendir("/proc");
-    if ( NULL == procdir ) {
+    size_t               i, len;
+    char                *cp, *end;
+
+    procs = netsnmp_proc_snapshot_get(NETSNMP_PROC_STAT | NETSNMP_PROC_CMDLINE);
+    if ( NULL == procs ) {
         snmp_log( LOG_ERR, "Failed to open /proc" );
         return -1;
     }
@@ -70,83 +70,47 @@ netsnmp_arch_swrun_container_load( netsnmp_container *container, u_int flags)
     /*
      * Walk through the list of processes in the /proc tree
      */
-    while ( NULL != (procentry_p = readdir( procdir ))) {
-        pid = atoi( procentry_p->d_name );
-        if ( 0 == pid )
-            continue;   /* Presumably '.' or '..' */
+    for (i = 0; i < procs->count; i++) {
+        proc = &procs->entries[i];
 
-        entry = netsnmp_swrun_entry_create(pid);
+        entry = netsnmp_swrun_entry_create(proc->pid);
         if (NULL == entry)
             continue;   /* error already logged by function */
 
-        /*
-         * Now extract the interesting information
-         *   from the various /proc{PID}/ interface files
-         */
-
         /*
          *   Name:  process name
          */
-        snprintf( buf2, BUFSIZ, "/proc/%d/status", pid );
-        fp = fopen( buf2, "r" );
-        if (!fp) {
-            netsnmp_swrun_entry_free(entry);
-            continue; /* file (process) probably went away */
-	}
-        memset(buf, 0, sizeof(buf));
-        if (fgets( buf, BUFSIZ-1, fp ) == NULL) {
-            fclose(fp);
-            netsnmp_swrun_entry_free(entry);
-            continue;
-        }
-        fclose(fp);
-
-        for ( cp = buf; *cp != ':'; cp++ )
-            ;
-        while (isspace(*(++cp)))	/* Skip ':' and following spaces */
-            ;
         entry->hrSWRunName_len = snprintf(entry->hrSWRunName,
-                                   sizeof(entry->hrSWRunName)-1, "%s", cp);
-        if ( '\n' == entry->hrSWRunName[ entry->hrSWRunName_len-1 ]) {
-            entry->hrSWRunName[ entry->hrSWRunName_len-1 ] = '\0';
-            entry->hrSWRunName_len--;           /* Stamp on trailing newline */
-        }
+                                   sizeof(entry->hrSWRunName)-1, "%s",
+                                   proc->name);
 
         /*
          *  Command Line:
          *     argv[0] '\0' argv[1] '\0' ....
          */
-        snprintf( buf2, BUFSIZ, "/proc/%d/cmdline", pid );
-        fp = fopen( buf2, "r" );
-        if (!fp) {
-            netsnmp_swrun_entry_free(entry);
-            continue; /* file (process) probably went away */
-        }
         entry->hrSWRunType = HRSWRUNTYPE_APPLICATION;
-        memset(buf, 0, sizeof(buf));
-        cp = fgets( buf, BUFSIZ-1, fp );
-        fclose(fp);
-        if (cp != NULL) {
+        if (proc->cmdline_len) {
             /*
              *     argv[0]   is hrSWRunPath
              */ 
+            len = strlen(proc->cmdline);
             entry->hrSWRunPath_len = snprintf(entry->hrSWRunPath,
-                                       sizeof(entry->hrSWRunPath)-1, "%s", buf);
+                                       sizeof(entry->hrSWRunPath)-1, "%s",
+                                       proc->cmdline);
+            if (entry->hrSWRunPath_len > sizeof(entry->hrSWRunPath)-1)
+                entry->hrSWRunPath_len = sizeof(entry->hrSWRunPath)-1;
             /*
              * Stitch together argv[1..] to construct hrSWRunParameters
              */
-            cp = buf + entry->hrSWRunPath_len+1;
-            while ( 1 ) {
-                while (*cp)
-                    cp++;
-                if ( '\0' == *(cp+1))
-                    break;      /* '\0''\0' => End of command line */
-                *cp = ' ';
-            }
-            entry->hrSWRunParameters_len
-                = sprintf(entry->hrSWRunParameters, "%.*s",
-                          (int)sizeof(entry->hrSWRunParameters) - 1,
-                          buf + entry->hrSWRunPath_len + 1);
+            cp  = proc->cmdline + len + 1;
+            end = proc->cmdline + proc->cmdline_len;
+            if (cp < end && '\0' == *(end-1))
+                end--;          /* '\0' at the end of the last argument */
+            len = 0;
+            for ( ; cp < end && len < sizeof(entry->hrSWRunParameters)-1; cp++)
+                entry->hrSWRunParameters[len++] = *cp ? *cp : ' ';
+            entry->hrSWRunParameters[len] = '\0';
+            entry->hrSWRunParameters_len = len;
         } else {
             /* empty /proc/PID/cmdline, it's probably a kernel thread */
             entry->hrSWRunPath_len = 0;
@@ -154,33 +118,7 @@ netsnmp_arch_swrun_container_load( netsnmp_container *container, u_int flags)
             entry->hrSWRunType = HRSWRUNTYPE_OPERATINGSYSTEM;
         }
 
-        /*
-         *   {xxx} {xxx} STATUS  {xxx}*10  UTIME STIME  {xxx}*8 RSS
-         */
-        snprintf( buf, BUFSIZ, "/proc/%d/stat", pid );
-        fp = fopen( buf, "r" );
-        if (!fp) {
-            netsnmp_swrun_entry_free(entry);
-            continue; /* file (process) probably went away */
-	}
-        if (fgets( buf, BUFSIZ-1, fp ) == NULL) {
-            fclose(fp);
-            netsnmp_swrun_entry_free(entry);
-            continue;
-        }
-        fclose(fp);
-
-        cp = buf;
-        while ( ' ' != *(cp++))    /* Skip first field */
-            ;
-        cp1 = cp;                  /* Skip second field */
-        while (*cp1) {
-            if (*cp1 == ')') cp = cp1;
-            cp1++;
-        }
-        cp += 2;
-        
-        switch (*cp) {
+        switch (proc->state) {
         case 'R':  entry->hrSWRunStatus = HRSWRUNSTATUS_RUNNING;
                    break;
         case 'S':  entry->hrSWRunStatus = HRSWRUNSTATUS_RUNNABLE;
@@ -192,27 +130,11 @@ netsnmp_arch_swrun_container_load( netsnmp_container *container, u_int flags)
         default:   entry->hrSWRunStatus = HRSWRUNSTATUS_INVALID;
                    break;
         }
-        for (i=11; i; i--) {   /* Skip STATUS + 10 fields */
-            while (' ' != *(++cp))
-                ;
-            cp++;
-        }
-        cpu  = atol( cp );                     /*  utime */
-        while ( ' ' != *(++cp))
-            ;
-        cpu += atol( cp );                     /* +stime */
-        entry->hrSWRunPerfCPU  = cpu * 100 / sc_clk_tck;
-
-        for (i=9; i; i--) {   /* Skip stime + 8 fields */
-            while (' ' != *(++cp))
-                ;
-            cp++;
-        }
-        entry->hrSWRunPerfMem  = atol( cp );       /* rss   */
+        entry->hrSWRunPerfCPU  = proc->cpu * 100 / sc_clk_tck;
+        entry->hrSWRunPerfMem  = proc->rss;        /* rss   */
         entry->hrSWRunPerfMem *= (pagesize/1024);  /* in kB */
         CONTAINER_INSERT(container, entry);
     }
-    closedir( procdir );
 
     DEBUGMSGTL(("swrun:load:arch"," loaded %" NETSNMP_PRIz "d entries\n",
                 CONTAINER_SIZE(container)));
@@ -18,10 +18,17 @@ extern          "C" {
 /**---------------------------------------------------------------------*/
 /**/
 
+int
+netsnmp_access_interface_ioctl_arphrd_type(int hwtype);
+
 int
 netsnmp_access_interface_ioctl_physaddr_get(int fd,
                                             netsnmp_interface_entry *ifentry);
 
+void
+netsnmp_access_interface_ioctl_flags_update(netsnmp_interface_entry *ifentry,
+                                            unsigned int os_flags);
+
 int
 netsnmp_access_interface_ioctl_flags_get(int fd,
                                          netsnmp_interface_entry *ifentry);
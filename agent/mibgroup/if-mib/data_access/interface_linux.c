@@ -75,6 +75,7 @@ typedef __u8 u8;           /* ditto */
 #include "if-mib/data_access/interface.h"
 #include "mibgroup/util_funcs.h"
 #include "interface_ioctl.h"
+#include "interface_linux.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -83,6 +84,11 @@ typedef __u8 u8;           /* ditto */
 
 #include <linux/sockios.h>
 #include <linux/if_ether.h>
+#ifdef HAVE_LINUX_RTNETLINK_H
+#include <stddef.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#endif
 
 #ifndef IF_NAMESIZE
 #define IF_NAMESIZE 16
@@ -133,6 +139,20 @@ int netsnmp_prefix_listen(void);
 #endif
 
 
+void
+init_interface_linux(void)
+{
+    char *app = netsnmp_ds_get_string(NETSNMP_DS_LIBRARY_ID,
+                                      NETSNMP_DS_LIB_APPTYPE);
+
+    netsnmp_ds_register_config(ASN_BOOLEAN, app, "interface_netlink_disable",
+                               NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_NO_INTERFACE_NETLINK);
+    netsnmp_ds_register_config(ASN_BOOLEAN, app, "interface_monitor",
+                               NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_INTERFACE_MONITOR);
+}
+
 void
 netsnmp_arch_interface_init(void)
 {
@@ -450,6 +470,218 @@ _arch_interface_flags_v6_get(netsnmp_interface_entry *entry)
 }
 #endif /* NETSNMP_ENABLE_IPV6 */
 
+/**
+ * @internal
+ */
+static void
+_arch_interface_type_guess(netsnmp_interface_entry *entry)
+{
+    /*
+     * physaddr should have set type. make some guesses (based
+     * on name) if not.
+     */
+    if(0 == entry->type) {
+        typedef struct _match_if {
+           int             mi_type;
+           const char     *mi_name;
+        }              *pmatch_if, match_if;
+        
+        static match_if lmatch_if[] = {
+            {IANAIFTYPE_SOFTWARELOOPBACK, "lo"},
+            {IANAIFTYPE_ETHERNETCSMACD, "eth"},
+            {IANAIFTYPE_ETHERNETCSMACD, "vmnet"},
+            {IANAIFTYPE_ISO88025TOKENRING, "tr"},
+            {IANAIFTYPE_FASTETHER, "feth"},
+            {IANAIFTYPE_GIGABITETHERNET,"gig"},
+            {IANAIFTYPE_INFINIBAND,"ib"},
+            {IANAIFTYPE_PPP, "ppp"},
+            {IANAIFTYPE_SLIP, "sl"},
+            {IANAIFTYPE_TUNNEL, "sit"},
+            {IANAIFTYPE_BASICISDN, "ippp"},
+            {IANAIFTYPE_PROPVIRTUAL, "bond"}, /* Bonding driver find fastest slave */
+            {IANAIFTYPE_PROPVIRTUAL, "vad"},  /* ANS driver - ?speed? */
+            {0, NULL}                  /* end of list */
+        };
+
+        int             len;
+        register pmatch_if pm;
+        
+        for (pm = lmatch_if; pm->mi_name; pm++) {
+            len = strlen(pm->mi_name);
+            if (0 == strncmp(entry->name, pm->mi_name, len)) {
+                entry->type = pm->mi_type;
+                break;
+            }
+        }
+        if(NULL == pm->mi_name)
+            entry->type = IANAIFTYPE_OTHER;
+    }
+}
+
+/**
+ * @internal
+ */
+static void
+_arch_interface_v6_if_id_set(netsnmp_interface_entry *entry)
+{
+    /*
+     * interface identifier is specified based on physaddr and type
+     */
+    switch (entry->type) {
+    case IANAIFTYPE_ETHERNETCSMACD:
+    case IANAIFTYPE_ETHERNET3MBIT:
+    case IANAIFTYPE_FASTETHER:
+    case IANAIFTYPE_FASTETHERFX:
+    case IANAIFTYPE_GIGABITETHERNET:
+    case IANAIFTYPE_FDDI:
+    case IANAIFTYPE_ISO88025TOKENRING:
+        if (NULL != entry->paddr && ETH_ALEN != entry->paddr_len)
+            break;
+
+        entry->v6_if_id_len = entry->paddr_len + 2;
+        memcpy(entry->v6_if_id, entry->paddr, 3);
+        memcpy(entry->v6_if_id + 5, entry->paddr + 3, 3);
+        entry->v6_if_id[0] ^= 2;
+        entry->v6_if_id[3] = 0xFF;
+        entry->v6_if_id[4] = 0xFE;
+
+        entry->ns_flags |= NETSNMP_INTERFACE_FLAGS_HAS_V6_IFID;
+        break;
+
+    case IANAIFTYPE_SOFTWARELOOPBACK:
+        entry->v6_if_id_len = 0;
+        entry->ns_flags |= NETSNMP_INTERFACE_FLAGS_HAS_V6_IFID;
+        break;
+    }
+}
+
+/**
+ * @internal
+ */
+static void
+_arch_interface_speed_get(int fd, netsnmp_interface_entry *entry)
+{
+    if (IANAIFTYPE_ETHERNETCSMACD == entry->type) {
+        unsigned long long speed;
+        unsigned long long defaultspeed = NOMINAL_LINK_SPEED;
+        if (!(entry->os_flags & IFF_RUNNING)) {
+            /*
+             * use speed 0 if the if speed cannot be determined *and* the
+             * interface is down
+             */
+            defaultspeed = 0;
+        }
+        speed = netsnmp_linux_interface_get_if_speed(fd,
+                entry->name, defaultspeed);
+        if (speed > 0xffffffffL) {
+            entry->speed = 0xffffffff;
+        } else
+            entry->speed = speed;
+        entry->speed_high = speed / 1000000LL;
+    }
+#ifdef APPLIED_PATCH_836390   /* xxx-rks ifspeed fixes */
+    else if (IANAIFTYPE_PROPVIRTUAL == entry->type)
+        entry->speed = _get_bonded_if_speed(entry);
+#endif
+    else
+        netsnmp_access_interface_entry_guess_speed(entry);
+}
+
+/**
+ * @internal
+ */
+static void
+_arch_interface_entry_finish(netsnmp_interface_entry *entry)
+{
+    /*
+     * Zero speed means link problem.
+     * - i'm not sure this is always true...
+     */
+    if((entry->speed == 0) && (entry->os_flags & IFF_UP)) {
+        entry->os_flags &= ~IFF_RUNNING;
+    }
+
+    /*
+     * check for promiscuous mode.
+     *  NOTE: there are 2 ways to set promiscuous mode in Linux
+     *  (kernels later than 2.2.something) - using ioctls and
+     *  using setsockopt. The ioctl method tested here does not
+     *  detect if an interface was set using setsockopt. google
+     *  on IFF_PROMISC and linux to see lots of arguments about it.
+     */
+    if(entry->os_flags & IFF_PROMISC) {
+        entry->promiscuous = 1; /* boolean */
+    }
+
+    /*
+     * hardcoded max packet size
+     * (see ip_frag_reasm: if(len > 65535) goto out_oversize;)
+     */
+    entry->reasm_max_v4 = entry->reasm_max_v6 = 65535;
+    entry->ns_flags |= 
+        NETSNMP_INTERFACE_FLAGS_HAS_V4_REASMMAX |
+        NETSNMP_INTERFACE_FLAGS_HAS_V6_REASMMAX;
+
+    netsnmp_access_interface_entry_overrides(entry);
+}
+
+/**
+ * @internal
+ * set the counters read from /proc/net/dev or netlink
+ */
+static void
+_arch_interface_stats_set(netsnmp_interface_entry *entry,
+                          unsigned long long rec_oct,
+                          unsigned long long rec_pkt,
+                          unsigned long long rec_err,
+                          unsigned long long rec_drop,
+                          unsigned long long rec_mcast,
+                          unsigned long long snd_oct,
+                          unsigned long long snd_pkt,
+                          unsigned long long snd_err,
+                          unsigned long long snd_drop,
+                          unsigned long long coll)
+{
+    entry->ns_flags |= NETSNMP_INTERFACE_FLAGS_ACTIVE;
+    
+    /*
+     * linux previous to 1.3.~13 may miss transmitted loopback pkts: 
+     */
+    if (!strcmp(entry->name, "lo") && rec_pkt > 0 && !snd_pkt)
+        snd_pkt = rec_pkt;
+    
+    /*
+     * subtract out multicast packets from rec_pkt before
+     * we store it as unicast counter.
+     */
+    entry->ns_flags |= NETSNMP_INTERFACE_FLAGS_CALCULATE_UCAST;
+    entry->stats.ibytes.low = rec_oct & 0xffffffff;
+    entry->stats.iall.low = rec_pkt & 0xffffffff;
+    entry->stats.imcast.low = rec_mcast & 0xffffffff;
+    entry->stats.obytes.low = snd_oct & 0xffffffff;
+    entry->stats.oucast.low = snd_pkt & 0xffffffff;
+    entry->stats.ibytes.high = rec_oct >> 32;
+    entry->stats.iall.high = rec_pkt >> 32;
+    entry->stats.imcast.high = rec_mcast >> 32;
+    entry->stats.obytes.high = snd_oct >> 32;
+    entry->stats.oucast.high = snd_pkt >> 32;
+    entry->stats.ierrors   = rec_err;
+    entry->stats.idiscards = rec_drop;
+    entry->stats.oerrors   = snd_err;
+    entry->stats.odiscards = snd_drop;
+    entry->stats.collisions = coll;
+    
+    /*
+     * calculated stats.
+     *
+     *  we have imcast, but not ibcast.
+     */
+    entry->stats.inucast = entry->stats.imcast.low +
+        entry->stats.ibcast.low;
+    entry->stats.onucast = entry->stats.omcast.low +
+        entry->stats.obcast.low;
+}
+
 /**
  * @internal
  */
@@ -543,48 +775,491 @@ _parse_stats(netsnmp_interface_entry *entry, char *stats, int expected)
                  expected, scan_count);
         return scan_count;
     }
-    entry->ns_flags |= NETSNMP_INTERFACE_FLAGS_ACTIVE;
-    
+    _arch_interface_stats_set(entry, rec_oct, rec_pkt, rec_err, rec_drop,
+                              rec_mcast, snd_oct, snd_pkt, snd_err, snd_drop,
+                              coll);
+    return 0;
+}
+
+#ifdef HAVE_LINUX_RTNETLINK_H
+/* bigger than the largest link message the kernel sends without VF info */
+#define IF_NL_BUF_SIZE 65536
+
+static char    *_nl_buf = NULL;
+static int      _monitor_fd = -1;
+static netsnmp_access_interface_monitor_callback *_monitor_callback = NULL;
+
+static void
+_entry_release(netsnmp_interface_entry *entry, void *context)
+{
+    netsnmp_access_interface_entry_free(entry);
+}
+
+/**
+ * @internal
+ * create an interface entry from a RTM_NEWLINK or RTM_DELLINK message
+ */
+static netsnmp_interface_entry *
+_entry_from_ifinfo(struct nlmsghdr *h, u_int load_flags)
+{
+    struct ifinfomsg *ifi = (struct ifinfomsg *) NLMSG_DATA(h);
+    struct rtnl_link_stats64 stats;
+    struct rtattr  *rta;
+    netsnmp_interface_entry *entry;
+    const char     *name = NULL;
+    const char     *addr = NULL;
+    int             len, addr_len = 0, has_stats = 0;
+    u_int           mtu = 0;
+
+    len = (int) h->nlmsg_len - (int) NLMSG_LENGTH(sizeof(*ifi));
+    if (len < 0)
+        return NULL;
+
+    memset(&stats, 0, sizeof(stats));
+    for (rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        switch (rta->rta_type) {
+        case IFLA_IFNAME:
+            if (memchr(RTA_DATA(rta), 0, RTA_PAYLOAD(rta)))
+                name = (const char *) RTA_DATA(rta);
+            break;
+        case IFLA_ADDRESS:
+            addr = (const char *) RTA_DATA(rta);
+            addr_len = (int) RTA_PAYLOAD(rta);
+            break;
+        case IFLA_MTU:
+            if (RTA_PAYLOAD(rta) >= sizeof(mtu))
+                memcpy(&mtu, RTA_DATA(rta), sizeof(mtu));
+            break;
+        case IFLA_STATS64:
+            /*
+             * newer kernels append counters; we need up to
+             * rx_missed_errors, which every kernel has
+             */
+            if (RTA_PAYLOAD(rta) <
+                offsetof(struct rtnl_link_stats64, tx_aborted_errors))
+                break;
+            memcpy(&stats, RTA_DATA(rta),
+                   SNMP_MIN(RTA_PAYLOAD(rta), sizeof(stats)));
+            has_stats = 1;
+            break;
+        }
+    }
+    if (NULL == name)
+        return NULL;
+
+    entry = netsnmp_access_interface_entry_create(name, ifi->ifi_index);
+    if (NULL == entry)
+        return NULL;
+
+#ifdef HAVE_PCI_LOOKUP_NAME
+    _arch_interface_description_get(entry);
+#endif
+
     /*
-     * linux previous to 1.3.~13 may miss transmitted loopback pkts: 
+     * like SIOCGIFHWADDR, always 6 bytes of physaddr
      */
-    if (!strcmp(entry->name, "lo") && rec_pkt > 0 && !snd_pkt)
-        snd_pkt = rec_pkt;
-    
+    entry->paddr = (char *) calloc(1, IFHWADDRLEN);
+    if (NULL == entry->paddr) {
+        netsnmp_access_interface_entry_free(entry);
+        return NULL;
+    }
+    entry->paddr_len = IFHWADDRLEN;
+    if (addr)
+        memcpy(entry->paddr, addr, SNMP_MIN(addr_len, IFHWADDRLEN));
+
+    entry->type = netsnmp_access_interface_ioctl_arphrd_type(ifi->ifi_type);
+    _arch_interface_type_guess(entry);
+    _arch_interface_v6_if_id_set(entry);
+
     /*
-     * subtract out multicast packets from rec_pkt before
-     * we store it as unicast counter.
+     * SIOCGIFFLAGS only has the low 16 bits
      */
-    entry->ns_flags |= NETSNMP_INTERFACE_FLAGS_CALCULATE_UCAST;
-    entry->stats.ibytes.low = rec_oct & 0xffffffff;
-    entry->stats.iall.low = rec_pkt & 0xffffffff;
-    entry->stats.imcast.low = rec_mcast & 0xffffffff;
-    entry->stats.obytes.low = snd_oct & 0xffffffff;
-    entry->stats.oucast.low = snd_pkt & 0xffffffff;
-#ifdef SCNuMAX   /* XXX - should be flag for 64-bit variables */
-    entry->stats.ibytes.high = rec_oct >> 32;
-    entry->stats.iall.high = rec_pkt >> 32;
-    entry->stats.imcast.high = rec_mcast >> 32;
-    entry->stats.obytes.high = snd_oct >> 32;
-    entry->stats.oucast.high = snd_pkt >> 32;
+    netsnmp_access_interface_ioctl_flags_update(entry,
+                                                ifi->ifi_flags & 0xffff);
+    entry->mtu = mtu;
+
+    if (has_stats && !(load_flags & NETSNMP_ACCESS_INTERFACE_LOAD_NO_STATS)) {
+        entry->ns_flags |= NETSNMP_INTERFACE_FLAGS_HAS_BYTES |
+            NETSNMP_INTERFACE_FLAGS_HAS_DROPS |
+            NETSNMP_INTERFACE_FLAGS_HAS_MCAST_PKTS |
+            NETSNMP_INTERFACE_FLAGS_HAS_HIGH_SPEED |
+            NETSNMP_INTERFACE_FLAGS_HAS_HIGH_BYTES |
+            NETSNMP_INTERFACE_FLAGS_HAS_HIGH_PACKETS;
+        /*
+         * the same counters /proc/net/dev shows
+         */
+        _arch_interface_stats_set(entry, stats.rx_bytes, stats.rx_packets,
+                                  stats.rx_errors,
+                                  stats.rx_dropped + stats.rx_missed_errors,
+                                  stats.multicast, stats.tx_bytes,
+                                  stats.tx_packets, stats.tx_errors,
+                                  stats.tx_dropped, stats.collisions);
+    }
+
+    return entry;
+}
+
+/**
+ * @internal
+ * fill in what a link message doesn't have: the ip versions of each
+ * interface, from one pass over the addresses, its speed, and the
+ * neighbour settings. Interfaces without the ip version load_flags asks
+ * for are removed.
+ */
+static void
+_netlink_entries_complete(netsnmp_container *container, u_int load_flags)
+{
+    netsnmp_container *addr_container;
+    netsnmp_ipaddress_entry *addr_entry;
+    netsnmp_interface_entry *entry, **excluded;
+    netsnmp_iterator *it;
+    int             fd, i, count = 0;
+
+    addr_container = netsnmp_access_ipaddress_container_load(NULL, 0);
+    if (NULL != addr_container) {
+        it = CONTAINER_ITERATOR(addr_container);
+        for (addr_entry = ITERATOR_FIRST(it); addr_entry;
+             addr_entry = ITERATOR_NEXT(it)) {
+            entry = netsnmp_access_interface_entry_get_by_index(container,
+                                                     addr_entry->if_index);
+            if (NULL == entry)
+                continue;
+            if (4 == addr_entry->ia_address_len)
+                entry->ns_flags |= NETSNMP_INTERFACE_FLAGS_HAS_IPV4;
+#ifdef NETSNMP_ENABLE_IPV6
+            else
+                entry->ns_flags |= NETSNMP_INTERFACE_FLAGS_HAS_IPV6;
 #endif
-    entry->stats.ierrors   = rec_err;
-    entry->stats.idiscards = rec_drop;
-    entry->stats.oerrors   = snd_err;
-    entry->stats.odiscards = snd_drop;
-    entry->stats.collisions = coll;
-    
+        }
+        ITERATOR_RELEASE(it);
+        netsnmp_access_ipaddress_container_free(addr_container, 0);
+    }
+
+    excluded = (netsnmp_interface_entry **)
+        calloc(CONTAINER_SIZE(container) + 1, sizeof(*excluded));
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    it = CONTAINER_ITERATOR(container);
+    for (entry = ITERATOR_FIRST(it); entry; entry = ITERATOR_NEXT(it)) {
+        /*
+         * do we only want one address type?
+         */
+        if (((load_flags & NETSNMP_ACCESS_INTERFACE_LOAD_IP4_ONLY) &&
+             ((entry->ns_flags & NETSNMP_INTERFACE_FLAGS_HAS_IPV4) == 0)) ||
+            ((load_flags & NETSNMP_ACCESS_INTERFACE_LOAD_IP6_ONLY) &&
+             ((entry->ns_flags & NETSNMP_INTERFACE_FLAGS_HAS_IPV6) == 0))) {
+            DEBUGMSGTL(("9:access:ifcontainer",
+                        "interface '%s' excluded by ip version\n",
+                        entry->name));
+            if (excluded)
+                excluded[count++] = entry;
+            continue;
+        }
+
+        _arch_interface_speed_get(fd, entry);
+        _arch_interface_entry_finish(entry);
+
+        if (entry->ns_flags & NETSNMP_INTERFACE_FLAGS_HAS_IPV4)
+            _arch_interface_flags_v4_get(entry);
+#ifdef NETSNMP_ENABLE_IPV6
+        if (entry->ns_flags & NETSNMP_INTERFACE_FLAGS_HAS_IPV6)
+            _arch_interface_flags_v6_get(entry);
+#endif
+    }
+    ITERATOR_RELEASE(it);
+    if (fd >= 0)
+        close(fd);
+
+    for (i = 0; i < count; i++) {
+        CONTAINER_REMOVE(container, excluded[i]);
+        netsnmp_access_interface_entry_free(excluded[i]);
+    }
+    free(excluded);
+}
+
+/**
+ * @internal
+ * receive a netlink message into _nl_buf
+ *
+ * @retval >0 length
+ * @retval -1 error (errno is set)
+ * @retval -2 a message was too big for the buffer, and was dropped
+ */
+static int
+_netlink_recv(int fd, int flags)
+{
+    int             len;
+
+    if (NULL == _nl_buf) {
+        _nl_buf = (char *) malloc(IF_NL_BUF_SIZE);
+        if (NULL == _nl_buf) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+
+    do
+        len = recv(fd, _nl_buf, IF_NL_BUF_SIZE, flags | MSG_TRUNC);
+    while (len < 0 && EINTR == errno);
+
+    if (len > IF_NL_BUF_SIZE) {
+        snmp_log(LOG_ERR, "interface netlink message too big (%d)\n", len);
+        return -2;
+    }
+    return len;
+}
+
+/**
+ * @internal
+ * load the interfaces with a single RTM_GETLINK dump, which has the
+ * name, index, type, address, flags, mtu and counters of every one
+ *
+ * @retval  0 success
+ * @retval -2 netlink is disabled, or the kernel can't dump the links; read
+ *            /proc/net/dev instead.
+ * @retval <0 other errors
+ */
+static int
+_load_netlink(netsnmp_container *container, u_int load_flags)
+{
+    struct {
+        struct nlmsghdr  nlh;
+        struct ifinfomsg ifi;
+        char             attrs[RTA_SPACE(sizeof(__u32))];
+    }               request;
+    struct sockaddr_nl sa;
+    struct nlmsghdr *h;
+    netsnmp_interface_entry *entry;
+    int             fd, len, rc = 0, done = 0;
+
+    if (netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_NO_INTERFACE_NETLINK))
+        return -2;
+
+    DEBUGMSGTL(("access:interface:container:arch", "load netlink\n"));
+
+    fd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_ROUTE);
+    if (fd < 0) {
+        DEBUGMSGTL(("access:interface", "no netlink socket: %s\n",
+                    strerror(errno)));
+        return -2;
+    }
+
+    memset(&request, 0, sizeof(request));
+    request.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(request.ifi));
+    request.nlh.nlmsg_type = RTM_GETLINK;
+    request.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.nlh.nlmsg_seq = 1;
+    request.ifi.ifi_family = AF_UNSPEC;
+#ifdef RTEXT_FILTER_SKIP_STATS
+    if (load_flags & NETSNMP_ACCESS_INTERFACE_LOAD_NO_STATS) {
+        struct rtattr  *rta = (struct rtattr *)
+            ((char *) &request + NLMSG_ALIGN(request.nlh.nlmsg_len));
+        __u32           mask = RTEXT_FILTER_SKIP_STATS;
+
+        rta->rta_type = IFLA_EXT_MASK;
+        rta->rta_len = RTA_LENGTH(sizeof(mask));
+        memcpy(RTA_DATA(rta), &mask, sizeof(mask));
+        request.nlh.nlmsg_len = NLMSG_ALIGN(request.nlh.nlmsg_len) +
+            RTA_SPACE(sizeof(mask));
+    }
+#endif
+
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    if (sendto(fd, &request, request.nlh.nlmsg_len, 0,
+               (struct sockaddr *) &sa, sizeof(sa)) < 0) {
+        DEBUGMSGTL(("access:interface", "sendto: %s\n", strerror(errno)));
+        close(fd);
+        return -2;
+    }
+
+    while (!done) {
+        len = _netlink_recv(fd, 0);
+        if (len <= 0) {
+            if (-1 == len || 0 == len)
+                snmp_log(LOG_ERR, "interface netlink recv: %s\n",
+                         len ? strerror(errno) : "end of file");
+            rc = -2;
+            break;
+        }
+
+        for (h = (struct nlmsghdr *) _nl_buf; NLMSG_OK(h, len);
+             h = NLMSG_NEXT(h, len)) {
+            if (NLMSG_DONE == h->nlmsg_type) {
+                done = 1;
+                break;
+            }
+            if (NLMSG_ERROR == h->nlmsg_type) {
+                struct nlmsgerr *err = (struct nlmsgerr *) NLMSG_DATA(h);
+                DEBUGMSGTL(("access:interface", "netlink error: %s\n",
+                            strerror(-err->error)));
+                rc = -2;
+                done = 1;
+                break;
+            }
+            if (RTM_NEWLINK != h->nlmsg_type)
+                continue;
+
+            entry = _entry_from_ifinfo(h, load_flags);
+            if (NULL == entry)
+                continue;
+            if (CONTAINER_INSERT(container, entry) < 0) {
+                DEBUGMSGTL(("access:interface", "error with interface_entry: insert into container failed.\n"));
+                netsnmp_access_interface_entry_free(entry);
+            }
+        }
+    }
+    close(fd);
+
+    if (0 != rc) {
+        /*
+         * start over, from /proc/net/dev
+         */
+        CONTAINER_CLEAR(container,
+                        (netsnmp_container_obj_func *) _entry_release, NULL);
+        return rc;
+    }
+
+    _netlink_entries_complete(container, load_flags);
+    return 0;
+}
+
+/**
+ * @internal
+ * apply the link changes the kernel has reported since the last call
+ */
+static void
+_monitor_read(int fd, void *data)
+{
+    netsnmp_container *changed, *removed;
+    netsnmp_interface_entry *entry, *old;
+    struct nlmsghdr *h;
+    int             len, lost = 0;
+
+    changed = netsnmp_access_interface_container_init(NETSNMP_ACCESS_INTERFACE_INIT_NOFLAGS);
+    removed = netsnmp_access_interface_container_init(NETSNMP_ACCESS_INTERFACE_INIT_NOFLAGS);
+    if (NULL == changed || NULL == removed)
+        lost = 1;
+
     /*
-     * calculated stats.
-     *
-     *  we have imcast, but not ibcast.
+     * drain the socket. Only the last message about an interface counts.
      */
-    entry->stats.inucast = entry->stats.imcast.low +
-        entry->stats.ibcast.low;
-    entry->stats.onucast = entry->stats.omcast.low +
-        entry->stats.obcast.low;
-    
+    for (;;) {
+        len = _netlink_recv(fd, MSG_DONTWAIT);
+        if (-2 == len || (len < 0 && ENOBUFS == errno)) {
+            lost = 1;
+            continue;
+        }
+        if (len <= 0)
+            break;
+        if (lost)
+            continue;
+
+        for (h = (struct nlmsghdr *) _nl_buf; NLMSG_OK(h, len);
+             h = NLMSG_NEXT(h, len)) {
+            if (RTM_NEWLINK != h->nlmsg_type && RTM_DELLINK != h->nlmsg_type)
+                continue;
+            entry = _entry_from_ifinfo(h, NETSNMP_ACCESS_INTERFACE_LOAD_NOFLAGS);
+            if (NULL == entry)
+                continue;
+
+            old = netsnmp_access_interface_entry_get_by_index(changed,
+                                                              entry->index);
+            if (NULL == old)
+                old = netsnmp_access_interface_entry_get_by_index(removed,
+                                                              entry->index);
+            if (NULL != old) {
+                CONTAINER_REMOVE(changed, old);
+                CONTAINER_REMOVE(removed, old);
+                netsnmp_access_interface_entry_free(old);
+            }
+            CONTAINER_INSERT(RTM_NEWLINK == h->nlmsg_type ? changed : removed,
+                             entry);
+        }
+    }
+
+    if (lost) {
+        /*
+         * we missed some messages, so the caller must reload everything
+         */
+        DEBUGMSGTL(("access:interface:monitor", "link messages lost\n"));
+        if (NULL != changed)
+            netsnmp_access_interface_container_free(changed,
+                                          NETSNMP_ACCESS_INTERFACE_FREE_NOFLAGS);
+        changed = NULL;
+        (*_monitor_callback)(NULL, NULL);
+    }
+    else if (CONTAINER_SIZE(changed) || CONTAINER_SIZE(removed)) {
+        DEBUGMSGTL(("access:interface:monitor", "%d changed, %d removed\n",
+                    (int) CONTAINER_SIZE(changed),
+                    (int) CONTAINER_SIZE(removed)));
+        _netlink_entries_complete(changed,
+                                  NETSNMP_ACCESS_INTERFACE_LOAD_NOFLAGS);
+        (*_monitor_callback)(changed, removed);
+    }
+
+    /*
+     * the callback has claimed or freed the changed entries
+     */
+    if (NULL != changed)
+        netsnmp_access_interface_container_free(changed,
+                                       NETSNMP_ACCESS_INTERFACE_FREE_DONT_CLEAR);
+    if (NULL != removed)
+        netsnmp_access_interface_container_free(removed,
+                                       NETSNMP_ACCESS_INTERFACE_FREE_NOFLAGS);
+}
+#endif /* HAVE_LINUX_RTNETLINK_H */
+
+/**
+ * subscribe to the kernel's link notifications. callback is called with
+ * the interfaces which were added or changed, and with those which
+ * were removed, each time some are; it must take or free each entry in
+ * the first container. If some notifications were lost, it is called
+ * with two NULLs, and all interfaces must be reloaded.
+ *
+ * @retval  0 success, or already subscribed
+ * @retval -1 error
+ */
+int
+netsnmp_access_interface_monitor_start(netsnmp_access_interface_monitor_callback *callback)
+{
+#ifdef HAVE_LINUX_RTNETLINK_H
+    struct sockaddr_nl sa;
+    int             fd;
+
+    if (_monitor_fd >= 0)
+        return 0;
+
+    fd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_ROUTE);
+    if (fd < 0) {
+        snmp_log_perror("interface monitor: netlink socket create error");
+        return -1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    sa.nl_groups = RTMGRP_LINK;
+    if (bind(fd, (struct sockaddr *) &sa, sizeof(sa)) < 0) {
+        snmp_log_perror("interface monitor: netlink bind failed");
+        close(fd);
+        return -1;
+    }
+
+    if (register_readfd(fd, _monitor_read, NULL) != 0) {
+        snmp_log(LOG_ERR,
+                 "interface monitor: error registering netlink socket\n");
+        close(fd);
+        return -1;
+    }
+
+    _monitor_callback = callback;
+    _monitor_fd = fd;
+    DEBUGMSGTL(("access:interface:monitor", "started\n"));
     return 0;
+#else
+    return -1;
+#endif /* HAVE_LINUX_RTNETLINK_H */
 }
 
 /*
@@ -602,7 +1277,7 @@ netsnmp_arch_interface_container_load(netsnmp_container* container,
     char            line[256];
     netsnmp_interface_entry *entry = NULL;
     static char     scan_expected = 0;
-    int             fd;
+    int             fd, rc;
 #ifdef NETSNMP_ENABLE_IPV6
     netsnmp_container *addr_container;
 #endif
@@ -615,6 +1290,11 @@ netsnmp_arch_interface_container_load(netsnmp_container* container,
         return -1;
     }
 
+#ifdef HAVE_LINUX_RTNETLINK_H
+    if (-2 != (rc = _load_netlink(container, load_flags)))
+        return rc;
+#endif
+
     if (!(devin = fopen("/proc/net/dev", "r"))) {
         DEBUGMSGTL(("access:interface",
                     "Failed to load Interface Table (linux1)\n"));
@@ -750,136 +1430,17 @@ netsnmp_arch_interface_container_load(netsnmp_container* container,
          */
         netsnmp_access_interface_ioctl_physaddr_get(fd, entry);
 
-        /*
-         * physaddr should have set type. make some guesses (based
-         * on name) if not.
-         */
-        if(0 == entry->type) {
-            typedef struct _match_if {
-               int             mi_type;
-               const char     *mi_name;
-            }              *pmatch_if, match_if;
-            
-            static match_if lmatch_if[] = {
-                {IANAIFTYPE_SOFTWARELOOPBACK, "lo"},
-                {IANAIFTYPE_ETHERNETCSMACD, "eth"},
-                {IANAIFTYPE_ETHERNETCSMACD, "vmnet"},
-                {IANAIFTYPE_ISO88025TOKENRING, "tr"},
-                {IANAIFTYPE_FASTETHER, "feth"},
-                {IANAIFTYPE_GIGABITETHERNET,"gig"},
-                {IANAIFTYPE_INFINIBAND,"ib"},
-                {IANAIFTYPE_PPP, "ppp"},
-                {IANAIFTYPE_SLIP, "sl"},
-                {IANAIFTYPE_TUNNEL, "sit"},
-                {IANAIFTYPE_BASICISDN, "ippp"},
-                {IANAIFTYPE_PROPVIRTUAL, "bond"}, /* Bonding driver find fastest slave */
-                {IANAIFTYPE_PROPVIRTUAL, "vad"},  /* ANS driver - ?speed? */
-                {0, NULL}                  /* end of list */
-            };
-
-            int             len;
-            register pmatch_if pm;
-            
-            for (pm = lmatch_if; pm->mi_name; pm++) {
-                len = strlen(pm->mi_name);
-                if (0 == strncmp(entry->name, pm->mi_name, len)) {
-                    entry->type = pm->mi_type;
-                    break;
-                }
-            }
-            if(NULL == pm->mi_name)
-                entry->type = IANAIFTYPE_OTHER;
-        }
+        _arch_interface_type_guess(entry);
 
-        /*
-         * interface identifier is specified based on physaddr and type
-         */
-        switch (entry->type) {
-        case IANAIFTYPE_ETHERNETCSMACD:
-        case IANAIFTYPE_ETHERNET3MBIT:
-        case IANAIFTYPE_FASTETHER:
-        case IANAIFTYPE_FASTETHERFX:
-        case IANAIFTYPE_GIGABITETHERNET:
-        case IANAIFTYPE_FDDI:
-        case IANAIFTYPE_ISO88025TOKENRING:
-            if (NULL != entry->paddr && ETH_ALEN != entry->paddr_len)
-                break;
+        _arch_interface_v6_if_id_set(entry);
 
-            entry->v6_if_id_len = entry->paddr_len + 2;
-            memcpy(entry->v6_if_id, entry->paddr, 3);
-            memcpy(entry->v6_if_id + 5, entry->paddr + 3, 3);
-            entry->v6_if_id[0] ^= 2;
-            entry->v6_if_id[3] = 0xFF;
-            entry->v6_if_id[4] = 0xFE;
-
-            entry->ns_flags |= NETSNMP_INTERFACE_FLAGS_HAS_V6_IFID;
-            break;
-
-        case IANAIFTYPE_SOFTWARELOOPBACK:
-            entry->v6_if_id_len = 0;
-            entry->ns_flags |= NETSNMP_INTERFACE_FLAGS_HAS_V6_IFID;
-            break;
-        }
-
-        if (IANAIFTYPE_ETHERNETCSMACD == entry->type) {
-            unsigned long long speed;
-            unsigned long long defaultspeed = NOMINAL_LINK_SPEED;
-            if (!(entry->os_flags & IFF_RUNNING)) {
-                /*
-                 * use speed 0 if the if speed cannot be determined *and* the
-                 * interface is down
-                 */
-                defaultspeed = 0;
-            }
-            speed = netsnmp_linux_interface_get_if_speed(fd,
-                    entry->name, defaultspeed);
-            if (speed > 0xffffffffL) {
-                entry->speed = 0xffffffff;
-            } else
-                entry->speed = speed;
-            entry->speed_high = speed / 1000000LL;
-        }
-#ifdef APPLIED_PATCH_836390   /* xxx-rks ifspeed fixes */
-        else if (IANAIFTYPE_PROPVIRTUAL == entry->type)
-            entry->speed = _get_bonded_if_speed(entry);
-#endif
-        else
-            netsnmp_access_interface_entry_guess_speed(entry);
+        _arch_interface_speed_get(fd, entry);
         
         netsnmp_access_interface_ioctl_flags_get(fd, entry);
 
         netsnmp_access_interface_ioctl_mtu_get(fd, entry);
 
-        /*
-         * Zero speed means link problem.
-         * - i'm not sure this is always true...
-         */
-        if((entry->speed == 0) && (entry->os_flags & IFF_UP)) {
-            entry->os_flags &= ~IFF_RUNNING;
-        }
-
-        /*
-         * check for promiscuous mode.
-         *  NOTE: there are 2 ways to set promiscuous mode in Linux
-         *  (kernels later than 2.2.something) - using ioctls and
-         *  using setsockopt. The ioctl method tested here does not
-         *  detect if an interface was set using setsockopt. google
-         *  on IFF_PROMISC and linux to see lots of arguments about it.
-         */
-        if(entry->os_flags & IFF_PROMISC) {
-            entry->promiscuous = 1; /* boolean */
-        }
-
-        /*
-         * hardcoded max packet size
-         * (see ip_frag_reasm: if(len > 65535) goto out_oversize;)
-         */
-        entry->reasm_max_v4 = entry->reasm_max_v6 = 65535;
-        entry->ns_flags |= 
-            NETSNMP_INTERFACE_FLAGS_HAS_V4_REASMMAX |
-            NETSNMP_INTERFACE_FLAGS_HAS_V6_REASMMAX;
-
-        netsnmp_access_interface_entry_overrides(entry);
+        _arch_interface_entry_finish(entry);
 
         if (! (load_flags & NETSNMP_ACCESS_INTERFACE_LOAD_NO_STATS))
             _parse_stats(entry, stats, scan_expected);
@@ -0,0 +1,18 @@
+/*
+ * interface data access header for linux
+ */
+#ifndef NETSNMP_ACCESS_INTERFACE_LINUX_H
+#define NETSNMP_ACCESS_INTERFACE_LINUX_H
+
+void            init_interface_linux(void);
+
+/*
+ * link change monitor, over a netlink socket. ifTable applies the
+ * changes to its rows as they happen.
+ */
+typedef void    (netsnmp_access_interface_monitor_callback)
+                (netsnmp_container *changed, netsnmp_container *removed);
+
+int             netsnmp_access_interface_monitor_start(netsnmp_access_interface_monitor_callback *callback);
+
+#endif /* NETSNMP_ACCESS_INTERFACE_LINUX_H */
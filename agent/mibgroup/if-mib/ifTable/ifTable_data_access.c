@@ -30,6 +30,10 @@ netsnmp_feature_require(container_linked_list)
 #   include "mibgroup/ip-mib/ipv6InterfaceTable/ipv6InterfaceTable.h"
 #endif
 
+#if defined( linux )
+#   include "if-mib/data_access/interface_linux.h"
+#endif
+
 typedef struct cd_container_s {
     netsnmp_container *current;
     netsnmp_container *deleted;
@@ -50,6 +54,11 @@ static int fadeout = IFTABLE_REMOVE_MISSING_AFTER;
  */
 static int replace_old = 0;
 
+/*
+ * our cache, for the link monitor to expire
+ */
+static netsnmp_cache *_cache = NULL;
+
 static void
 _delete_missing_interface(ifTable_rowreq_ctx *rowreq_ctx,
                           netsnmp_container *container);
@@ -197,6 +206,7 @@ ifTable_container_init(netsnmp_container **container_ptr_ptr,
      * At 100 Mbps it is ~5 minutes, and at 1 Gbps, ~34 seconds.
      */
     cache->timeout = IFTABLE_CACHE_TIMEOUT;     /* seconds */
+    _cache = cache;
 
     /*
      * don't release resources
@@ -544,6 +554,87 @@ _delete_missing_interface(ifTable_rowreq_ctx *rowreq_ctx,
     ifTable_release_rowreq_ctx(rowreq_ctx);
 }
 
+#if defined( linux )
+static void
+_free_interface_entry(void *ifentry, void *context)
+{
+    netsnmp_access_interface_entry_free((netsnmp_interface_entry *) ifentry);
+}
+
+static void
+_find_changed_row(netsnmp_interface_entry *ifentry, netsnmp_container *rows)
+{
+    ifTable_rowreq_ctx *rowreq_ctx;
+
+    rowreq_ctx = (ifTable_rowreq_ctx *)
+        CONTAINER_FIND(ifTable_container_get(), ifentry);
+    if (NULL != rowreq_ctx)
+        CONTAINER_INSERT(rows, rowreq_ctx);
+}
+
+/**
+ * apply the link changes reported by the interface monitor, the same
+ * way a reload would, but only to the rows of the interfaces which
+ * changed.
+ */
+static void
+_interfaces_changed(netsnmp_container *changed, netsnmp_container *removed)
+{
+    netsnmp_container *container = ifTable_container_get();
+    netsnmp_container *rows;
+    cd_container    cdc;
+
+    if ((NULL == changed) || (NULL == container)) {
+        /*
+         * we've missed some changes; reload everything on the next request
+         */
+        if (NULL != _cache)
+            _cache->expired = 1;
+        return;
+    }
+
+    rows = netsnmp_container_find("ifTable_changed:linked_list");
+    if (NULL == rows) {
+        snmp_log(LOG_ERR, "couldn't create container for changed interfaces\n");
+        if (NULL != _cache)
+            _cache->expired = 1;
+        CONTAINER_FOR_EACH(changed, _free_interface_entry, NULL);
+        return;
+    }
+
+    /*
+     * the rows of the changed and removed interfaces. A removed one is
+     * not in changed, so it is marked missing.
+     */
+    CONTAINER_FOR_EACH(changed, (netsnmp_container_obj_func *)
+                       _find_changed_row, rows);
+    CONTAINER_FOR_EACH(removed, (netsnmp_container_obj_func *)
+                       _find_changed_row, rows);
+
+    cdc.current = changed;
+    cdc.deleted = NULL;
+    CONTAINER_FOR_EACH(rows, (netsnmp_container_obj_func *)
+                       _check_interface_entry_for_updates, &cdc);
+    CONTAINER_CLEAR(rows, NULL, NULL);
+    CONTAINER_FREE(rows);
+
+    if (NULL != cdc.deleted) {
+       CONTAINER_FOR_EACH(cdc.deleted,
+                          (netsnmp_container_obj_func *) _delete_missing_interface,
+                          container);
+       CONTAINER_CLEAR(cdc.deleted, NULL, NULL);
+       CONTAINER_FREE(cdc.deleted);
+    }
+
+    /*
+     * whatever is left in changed is new
+     */
+    CONTAINER_FOR_EACH(changed,
+                       (netsnmp_container_obj_func *) _add_new_interface,
+                       container);
+}
+#endif /* linux */
+
 /**
  * container shutdown
  *
@@ -666,6 +757,15 @@ ifTable_container_load(netsnmp_container *container)
     if (_first_load)
         _first_load = 0;
 
+#if defined( linux )
+    /*
+     * from now on, apply link changes as they happen
+     */
+    if (netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_INTERFACE_MONITOR))
+        netsnmp_access_interface_monitor_start(_interfaces_changed);
+#endif
+
     return MFD_SUCCESS;
 }                               /* ifTable_container_load */
 
@@ -17,6 +17,27 @@
 #include "if-mib/data_access/interface_ioctl.h"
 #include "route.h"
 #include "route_private.h"
+#include "route_linux.h"
+
+#ifdef HAVE_LINUX_RTNETLINK_H
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <errno.h>
+#endif
+
+void
+init_route_linux(void)
+{
+    char *app = netsnmp_ds_get_string(NETSNMP_DS_LIBRARY_ID,
+                                      NETSNMP_DS_LIB_APPTYPE);
+
+    netsnmp_ds_register_config(ASN_BOOLEAN, app, "route_netlink_disable",
+                               NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_NO_ROUTE_NETLINK);
+    netsnmp_ds_register_config(ASN_BOOLEAN, app, "route_monitor",
+                               NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_ROUTE_MONITOR);
+}
 
 static int
 _type_from_flags(unsigned int flags)
@@ -338,6 +359,412 @@ _load_ipv6(netsnmp_container* container, u_long *index )
 }
 #endif
 
+#ifdef HAVE_LINUX_RTNETLINK_H
+/* bigger than the largest message the kernel sends for a dump */
+#define ROUTE_NL_BUF_SIZE 65536
+
+static int
+_type_from_rtm(const struct rtmsg *rtm, int gateway)
+{
+    if (rtm->rtm_flags & RTNH_F_DEAD)
+        return 0; /* route not up */
+
+    switch (rtm->rtm_type) {
+    case RTN_UNICAST:
+        return gateway ? INETCIDRROUTETYPE_REMOTE : INETCIDRROUTETYPE_LOCAL;
+    case RTN_BLACKHOLE:
+        return INETCIDRROUTETYPE_BLACKHOLE;
+    case RTN_UNREACHABLE:
+    case RTN_PROHIBIT:
+        return INETCIDRROUTETYPE_REJECT;
+    case RTN_THROW:
+    case RTN_NAT:
+    case RTN_XRESOLVE:
+        return 0; /* doesn't forward or reject traffic */
+    default:
+        /* local, anycast and multicast, as /proc/net/ipv6_route shows them */
+        return INETCIDRROUTETYPE_LOCAL;
+    }
+}
+
+static int
+_proto_from_rtm(const struct rtmsg *rtm)
+{
+    switch (rtm->rtm_protocol) {
+    case RTPROT_REDIRECT:
+    case RTPROT_RA:
+        return IANAIPROUTEPROTOCOL_ICMP;
+    case RTPROT_STATIC:
+        return IANAIPROUTEPROTOCOL_NETMGMT;
+#ifdef RTPROT_BGP
+    case RTPROT_BGP:
+        return IANAIPROUTEPROTOCOL_BGP;
+    case RTPROT_ISIS:
+        return IANAIPROUTEPROTOCOL_ISIS;
+    case RTPROT_OSPF:
+        return IANAIPROUTEPROTOCOL_OSPF;
+    case RTPROT_RIP:
+        return IANAIPROUTEPROTOCOL_RIP;
+#endif
+    default:
+        return IANAIPROUTEPROTOCOL_LOCAL;
+    }
+}
+
+/*
+ * make a route entry from an RTM_NEWROUTE message. Returns NULL for the
+ * routes we don't list, with *rc set to -3 if out of memory.
+ */
+static netsnmp_route_entry *
+_entry_from_rtm(struct nlmsghdr *h, u_long *index, int *rc)
+{
+    struct rtmsg   *rtm = (struct rtmsg *) NLMSG_DATA(h);
+    struct rtattr  *rta;
+    netsnmp_route_entry *entry;
+    int             len = RTM_PAYLOAD(h), addr_len;
+    const void     *dest = NULL, *gateway = NULL;
+    uint32_t        table = rtm->rtm_table, metric = 0;
+    int             if_index = 0;
+
+    if (AF_INET == rtm->rtm_family)
+        addr_len = 4;
+#ifdef NETSNMP_ENABLE_IPV6
+    else if (AF_INET6 == rtm->rtm_family)
+        addr_len = 16;
+#endif
+    else
+        return NULL; /* multicast routing tables and such */
+
+    if (rtm->rtm_flags & RTM_F_CLONED)
+        return NULL;
+
+    for (rta = RTM_RTA(rtm); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        switch (rta->rta_type) {
+        case RTA_DST:
+            if ((int) RTA_PAYLOAD(rta) == addr_len)
+                dest = RTA_DATA(rta);
+            break;
+        case RTA_GATEWAY:
+            if ((int) RTA_PAYLOAD(rta) == addr_len)
+                gateway = RTA_DATA(rta);
+            break;
+        case RTA_OIF:
+            if_index = *(int *) RTA_DATA(rta);
+            break;
+        case RTA_PRIORITY:
+            metric = *(uint32_t *) RTA_DATA(rta);
+            break;
+        case RTA_TABLE:
+            table = *(uint32_t *) RTA_DATA(rta);
+            break;
+        case RTA_MULTIPATH: {
+            /* like /proc/net/route, list the first next hop */
+            struct rtnexthop *rtnh = (struct rtnexthop *) RTA_DATA(rta);
+            struct rtattr  *nh_rta;
+            int             nh_len;
+
+            if (RTA_PAYLOAD(rta) < sizeof(*rtnh) ||
+                rtnh->rtnh_len < sizeof(*rtnh))
+                break;
+            if_index = rtnh->rtnh_ifindex;
+            nh_len = rtnh->rtnh_len - sizeof(*rtnh);
+            for (nh_rta = RTNH_DATA(rtnh); RTA_OK(nh_rta, nh_len);
+                 nh_rta = RTA_NEXT(nh_rta, nh_len))
+                if (RTA_GATEWAY == nh_rta->rta_type &&
+                    (int) RTA_PAYLOAD(nh_rta) == addr_len)
+                    gateway = RTA_DATA(nh_rta);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    /*
+     * the local table has the local and broadcast addresses, which
+     * /proc/net/route leaves out too.
+     */
+    if (4 == addr_len && RT_TABLE_LOCAL == table)
+        return NULL;
+
+    entry = netsnmp_access_route_entry_create();
+    if (NULL == entry) {
+        *rc = -3;
+        return NULL;
+    }
+
+    entry->if_index = if_index;
+
+    /*
+     * arbitrary index
+     */
+    entry->ns_rt_index = ++(*index);
+
+    /*
+     * copy dest & next hop; the entry is zeroed for default routes and
+     * routes without a gateway
+     */
+    entry->rt_dest_type = (4 == addr_len) ? INETADDRESSTYPE_IPV4 :
+                                            INETADDRESSTYPE_IPV6;
+    entry->rt_dest_len = addr_len;
+    if (dest)
+        memcpy(entry->rt_dest, dest, addr_len);
+    entry->rt_nexthop_type = entry->rt_dest_type;
+    entry->rt_nexthop_len = addr_len;
+    if (gateway)
+        memcpy(entry->rt_nexthop, gateway, addr_len);
+    entry->rt_pfx_len = rtm->rtm_dst_len;
+    entry->rt_metric1 = metric;
+
+#ifdef USING_IP_FORWARD_MIB_IPCIDRROUTETABLE_IPCIDRROUTETABLE_MODULE
+    if (4 == addr_len) {
+        uint32_t        mask = rtm->rtm_dst_len ?
+            htonl(0xffffffffU << (32 - rtm->rtm_dst_len)) : 0;
+        memcpy(&entry->rt_mask, &mask, 4);
+    }
+    entry->rt_tos = rtm->rtm_tos;
+#endif
+
+#ifdef USING_IP_FORWARD_MIB_INETCIDRROUTETABLE_INETCIDRROUTETABLE_MODULE
+    /*
+     * use the same policies as the /proc loaders: the if index for
+     * ipv4 routes without a next hop, and our arbitrary index for ipv6.
+     * ipv4 routes from the other (policy routing) tables add the table,
+     * to tell them from the main table's.
+     */
+    if (4 == addr_len && (RT_TABLE_MAIN != table || NULL == gateway)) {
+        entry->rt_policy = calloc(3, sizeof(oid));
+        if (entry->rt_policy) {
+            entry->rt_policy[1] = (RT_TABLE_MAIN == table) ? 0 : table;
+            entry->rt_policy[2] = entry->if_index;
+            entry->rt_policy_len = sizeof(oid)*3;
+        }
+    } else if (16 == addr_len) {
+        entry->rt_policy = calloc(3, sizeof(oid));
+        if (entry->rt_policy) {
+            entry->rt_policy[2] = entry->ns_rt_index;
+            entry->rt_policy_len = sizeof(oid)*3;
+        }
+    }
+#endif
+
+    entry->rt_type = _type_from_rtm(rtm, NULL != gateway);
+    entry->rt_proto = _proto_from_rtm(rtm);
+
+    return entry;
+}
+
+static void
+_entry_release(netsnmp_route_entry *entry, void *context)
+{
+    netsnmp_access_route_entry_free(entry);
+}
+
+/**
+ * load the routes of every table with an RTM_GETROUTE dump
+ *
+ * @retval  0 success
+ * @retval -2 netlink not available, read /proc instead
+ * @retval <0 other errors
+ */
+static int
+_load_netlink(netsnmp_container* container, u_long *index, u_char family)
+{
+    struct {
+        struct nlmsghdr nlh;
+        struct rtmsg    rtm;
+    }               request;
+    struct sockaddr_nl sa;
+    struct nlmsghdr *h;
+    netsnmp_route_entry *entry;
+    char           *buf;
+    int             fd, len, rc = 0, done = 0;
+
+    DEBUGMSGTL(("access:route:container",
+                "route_container_arch_load netlink (family %d)\n", family));
+
+    netsnmp_assert(NULL != container);
+
+    fd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_ROUTE);
+    if (fd < 0) {
+        DEBUGMSGTL(("access:route:container", "no netlink socket: %s\n",
+                    strerror(errno)));
+        return -2;
+    }
+
+    buf = (char *) malloc(ROUTE_NL_BUF_SIZE);
+    if (NULL == buf) {
+        snmp_log(LOG_ERR, "malloc error in route _load_netlink\n");
+        close(fd);
+        return -1;
+    }
+
+    memset(&request, 0, sizeof(request));
+    request.nlh.nlmsg_len = sizeof(request);
+    request.nlh.nlmsg_type = RTM_GETROUTE;
+    request.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.nlh.nlmsg_seq = 1;
+    request.rtm.rtm_family = family;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    if (sendto(fd, &request, sizeof(request), 0, (struct sockaddr *) &sa,
+               sizeof(sa)) < 0) {
+        DEBUGMSGTL(("access:route:container", "sendto: %s\n",
+                    strerror(errno)));
+        free(buf);
+        close(fd);
+        return -2;
+    }
+
+    while (!done) {
+        len = recv(fd, buf, ROUTE_NL_BUF_SIZE, 0);
+        if (len < 0 && EINTR == errno)
+            continue;
+        if (len <= 0) {
+            snmp_log(LOG_ERR, "route netlink recv: %s\n",
+                     len ? strerror(errno) : "end of file");
+            rc = -1;
+            break;
+        }
+
+        for (h = (struct nlmsghdr *) buf; NLMSG_OK(h, len);
+             h = NLMSG_NEXT(h, len)) {
+            if (NLMSG_DONE == h->nlmsg_type) {
+                done = 1;
+                break;
+            }
+            if (NLMSG_ERROR == h->nlmsg_type) {
+                struct nlmsgerr *err = (struct nlmsgerr *) NLMSG_DATA(h);
+                DEBUGMSGTL(("access:route:container", "netlink error: %s\n",
+                            strerror(-err->error)));
+                rc = -2;
+                done = 1;
+                break;
+            }
+            if (RTM_NEWROUTE != h->nlmsg_type ||
+                h->nlmsg_len < NLMSG_LENGTH(sizeof(struct rtmsg)))
+                continue;
+
+            entry = _entry_from_rtm(h, index, &rc);
+            if (NULL == entry) {
+                if (rc < 0) {
+                    done = 1;
+                    break;
+                }
+                continue;
+            }
+
+            /*
+             * insert into container
+             */
+            if (CONTAINER_INSERT(container, entry) < 0) {
+                DEBUGMSGTL(("access:route:container", "error with route_entry: insert into container failed.\n"));
+                netsnmp_access_route_entry_free(entry);
+            }
+        }
+    }
+
+    free(buf);
+    close(fd);
+
+    if (-2 == rc) {
+        /*
+         * start over, from /proc/net
+         */
+        CONTAINER_CLEAR(container,
+                        (netsnmp_container_obj_func *) _entry_release, NULL);
+        *index = 0;
+    }
+    return rc;
+}
+
+/*
+ * route change monitor: a netlink socket in the route groups, which
+ * bumps a generation count whenever the kernel reports a change.
+ */
+static int      _monitor_fd = -1;
+static u_long   _monitor_generation = 1;
+
+static void
+_monitor_read(int fd, void *data)
+{
+    char            buf[8192];
+    int             r;
+
+    /*
+     * we only want to know that something changed, so drain the socket.
+     * ENOBUFS means we missed some messages, which changes nothing.
+     */
+    do
+        r = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+    while (r > 0 || (r < 0 && (EINTR == errno || ENOBUFS == errno)));
+
+    ++_monitor_generation;
+    DEBUGMSGTL(("access:route:monitor", "routes changed (generation %lu)\n",
+                _monitor_generation));
+}
+#endif /* HAVE_LINUX_RTNETLINK_H */
+
+/**
+ * subscribe to the kernel's route change notifications
+ *
+ * @retval  0 success, or already subscribed
+ * @retval -1 error
+ */
+int
+netsnmp_access_route_monitor_start(void)
+{
+#ifdef HAVE_LINUX_RTNETLINK_H
+    struct sockaddr_nl sa;
+    int             fd;
+
+    if (_monitor_fd >= 0)
+        return 0;
+
+    fd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_ROUTE);
+    if (fd < 0) {
+        snmp_log_perror("route monitor: netlink socket create error");
+        return -1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    sa.nl_groups = RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+    if (bind(fd, (struct sockaddr *) &sa, sizeof(sa)) < 0) {
+        snmp_log_perror("route monitor: netlink bind failed");
+        close(fd);
+        return -1;
+    }
+
+    if (register_readfd(fd, _monitor_read, NULL) != 0) {
+        snmp_log(LOG_ERR, "route monitor: error registering netlink socket\n");
+        close(fd);
+        return -1;
+    }
+
+    _monitor_fd = fd;
+    DEBUGMSGTL(("access:route:monitor", "started\n"));
+    return 0;
+#else
+    return -1;
+#endif /* HAVE_LINUX_RTNETLINK_H */
+}
+
+/**
+ * @retval  0 no monitor is running; the routes may have changed
+ * @retval >0 a count which changes whenever the routes do
+ */
+u_long
+netsnmp_access_route_monitor_generation(void)
+{
+#ifdef HAVE_LINUX_RTNETLINK_H
+    if (_monitor_fd >= 0)
+        return _monitor_generation;
+#endif
+    return 0;
+}
+
 /** arch specific load
  * @internal
  *
@@ -360,6 +787,25 @@ netsnmp_access_route_container_arch_load(netsnmp_container* container,
         return -1;
     }
 
+#ifdef HAVE_LINUX_RTNETLINK_H
+    /*
+     * one netlink dump has the routes of every table; read /proc/net if
+     * netlink isn't there (-2)
+     */
+    if (!netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID,
+                                NETSNMP_DS_AGENT_NO_ROUTE_NETLINK)) {
+#ifdef NETSNMP_ENABLE_IPV6
+        u_char family = (load_flags & NETSNMP_ACCESS_ROUTE_LOAD_IPV4_ONLY) ?
+                        AF_INET : AF_UNSPEC;
+#else
+        u_char family = AF_INET;
+#endif
+        rc = _load_netlink(container, &count, family);
+        if (-2 != rc)
+            return rc;
+    }
+#endif
+
     rc = _load_ipv4(container, &count);
     
 #ifdef NETSNMP_ENABLE_IPV6
@@ -0,0 +1,16 @@
+/*
+ * route data access header for linux
+ */
+#ifndef NETSNMP_ACCESS_ROUTE_LINUX_H
+#define NETSNMP_ACCESS_ROUTE_LINUX_H
+
+void            init_route_linux(void);
+
+/*
+ * route change monitor, over a netlink socket. inetCidrRouteTable only
+ * reloads its cache when the generation has changed.
+ */
+int             netsnmp_access_route_monitor_start(void);
+u_long          netsnmp_access_route_monitor_generation(void);
+
+#endif /* NETSNMP_ACCESS_ROUTE_LINUX_H */
@@ -19,6 +19,17 @@
 
 #include "inetCidrRouteTable_data_access.h"
 
+#if defined( linux )
+#include "ip-forward-mib/data_access/route_linux.h"
+
+/*
+ * with the route monitor running, the generation of the routes in the
+ * container, and when they were last loaded in full.
+ */
+static u_long   _loaded_generation = 0;
+static time_t   _loaded_time = 0;
+#endif
+
 /** @ingroup interface 
  * @addtogroup data_access data_access: Routines to access data
  *
@@ -211,6 +222,58 @@ inetCidrRouteTable_container_shutdown(netsnmp_container *container_ptr)
 
 }                               /* inetCidrRouteTable_container_shutdown */
 
+#if defined( linux )
+static void
+_release_row(inetCidrRouteTable_rowreq_ctx *rowreq_ctx, void *context)
+{
+    inetCidrRouteTable_release_rowreq_ctx(rowreq_ctx);
+}
+
+/*
+ * with "route_monitor yes", keep the rows as long as the kernel reports
+ * no route changes, instead of reloading them when the cache expires.
+ * The cache then leaves the rows alone, and the load function replaces
+ * them itself when they have changed.
+ *
+ * @retval 1 the rows in the container are current
+ * @retval 0 load the routes
+ */
+static int
+_routes_unchanged(netsnmp_container *container)
+{
+    netsnmp_cache  *cache = inetCidrRouteTable_get_cache();
+    struct timeval  now;
+    u_long          generation;
+
+    if (!netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID,
+                                NETSNMP_DS_AGENT_ROUTE_MONITOR) ||
+        NULL == cache || netsnmp_access_route_monitor_start() < 0)
+        return 0;
+
+    cache->flags |= NETSNMP_CACHE_DONT_FREE_BEFORE_LOAD |
+        NETSNMP_CACHE_DONT_FREE_EXPIRED;
+
+    /*
+     * load in full now and then anyway, as the kernel doesn't report
+     * every change (e.g. routes whose next hop has gone down).
+     */
+    netsnmp_get_monotonic_clock(&now);
+    generation = netsnmp_access_route_monitor_generation();
+    if (generation == _loaded_generation && CONTAINER_SIZE(container) &&
+        now.tv_sec - _loaded_time < INETCIDRROUTETABLE_MONITOR_MAX_AGE) {
+        DEBUGMSGTL(("inetCidrRouteTable:monitor", "routes unchanged\n"));
+        return 1;
+    }
+
+    DEBUGMSGTL(("inetCidrRouteTable:monitor", "reloading routes\n"));
+    CONTAINER_CLEAR(container, (netsnmp_container_obj_func *) _release_row,
+                    NULL);
+    _loaded_generation = generation;
+    _loaded_time = now.tv_sec;
+    return 0;
+}
+#endif
+
 /**
  * load initial data
  *
@@ -259,6 +322,10 @@ inetCidrRouteTable_container_load(netsnmp_container *container)
      *
      * we use the netsnmp data access api to get the data
      */
+#if defined( linux )
+    if (_routes_unchanged(container))
+        return MFD_SUCCESS;
+#endif
     route_container =
         netsnmp_access_route_container_load(NULL,
                                             NETSNMP_ACCESS_ROUTE_LOAD_NOFLAGS);
@@ -45,6 +45,10 @@ extern          "C" {
      * The number of seconds before the cache times out
      */
 #define INETCIDRROUTETABLE_CACHE_TIMEOUT   60
+    /*
+     * with route_monitor, the longest time between full reloads (seconds)
+     */
+#define INETCIDRROUTETABLE_MONITOR_MAX_AGE 600
 
     void            inetCidrRouteTable_container_init(netsnmp_container
                                                       **container_ptr_ptr,
@@ -1259,26 +1259,21 @@ vacm_check_view(netsnmp_pdu *pdu, oid * name, size_t namelen,
                                     VACM_CHECK_VIEW_CONTENTS_NO_FLAGS);
 }
 
-int
-vacm_check_view_contents(netsnmp_pdu *pdu, oid * name, size_t namelen,
-                         int check_subtree, int viewtype, int flags)
+/*
+ * Returns the security name a request is checked against: for SNMPv1
+ * and SNMPv2c, the one the com2sec mappings give for its community and
+ * source address (which also set the PDU's context name), and for
+ * SNMPv3 the PDU's own.  NULL if there is none.
+ */
+const char *
+vacm_pdu_secname(netsnmp_pdu *pdu)
 {
-    struct vacm_accessEntry *ap;
-    struct vacm_groupEntry *gp;
-    struct vacm_viewEntry *vp;
 #if !defined(NETSNMP_DISABLE_SNMPV1) || !defined(NETSNMP_DISABLE_SNMPV2C)
     char            vacm_default_context[1] = "";
     const char     *contextName = vacm_default_context;
     const char     *pdu_community;
 #endif
     const char     *sn = NULL;
-    char           *vn;
-
-    /*
-     * len defined by the vacmContextName object 
-     */
-#define CONTEXTNAMEINDEXLEN 32
-    char            contextNameIndex[CONTEXTNAMEINDEXLEN + 1];
 
 #if !defined(NETSNMP_DISABLE_SNMPV1) || !defined(NETSNMP_DISABLE_SNMPV2C)
 #if defined(NETSNMP_DISABLE_SNMPV1)
@@ -1402,6 +1397,26 @@ vacm_check_view_contents(netsnmp_pdu *pdu, oid * name, size_t namelen,
         sn = NULL;
     }
 
+    return sn;
+}
+
+int
+vacm_check_view_contents(netsnmp_pdu *pdu, oid * name, size_t namelen,
+                         int check_subtree, int viewtype, int flags)
+{
+    struct vacm_accessEntry *ap;
+    struct vacm_groupEntry *gp;
+    struct vacm_viewEntry *vp;
+    const char     *sn;
+    char           *vn;
+
+    /*
+     * len defined by the vacmContextName object 
+     */
+#define CONTEXTNAMEINDEXLEN 32
+    char            contextNameIndex[CONTEXTNAMEINDEXLEN + 1];
+
+    sn = vacm_pdu_secname(pdu);
     if (sn == NULL) {
 #if !defined(NETSNMP_DISABLE_SNMPV1) || !defined(NETSNMP_DISABLE_SNMPV2C)
         snmp_increment_statistic(STAT_SNMPINBADCOMMUNITYNAMES);
@@ -44,6 +44,7 @@ config_belongs_in(agent_module)
      int             vacm_check_view(netsnmp_pdu *, oid *, size_t, int, int);
      int             vacm_check_view_contents(netsnmp_pdu *, oid *, size_t,
                                               int, int, int);
+     const char     *vacm_pdu_secname(netsnmp_pdu *);
 
 #define VACM_CHECK_VIEW_CONTENTS_NO_FLAGS        0
 #define VACM_CHECK_VIEW_CONTENTS_DNE_CONTEXT_OK  1
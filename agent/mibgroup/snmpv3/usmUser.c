@@ -356,27 +356,39 @@ var_usmUser(struct variable * vp,
             uptr = usm_get_userList();
 
         } else {
-            for (nptr = usm_get_userList(), uptr = NULL;
-                 nptr != NULL; nptr = nptr->next) {
+            /*
+             * look the index up directly: an exact match, or the user
+             * before the one wanted for a GETNEXT (usm_get_userList()
+             * puts the list in index order)
+             */
+            nptr = usm_get_userList() ? usm_parse_user(name, *length) : NULL;
+            if (nptr != NULL) {
                 indexOid =
                     usm_generate_OID(vp->name, vp->namelen, nptr, &len);
-                result = snmp_oid_compare(name, *length, indexOid, len);
-                DEBUGMSGTL(("9:usmUser", "Checking user: %s - ",
-                            nptr->name));
-                for (i = 0; i < (int) nptr->engineIDLen; i++) {
-                    DEBUGMSG(("9:usmUser", " %x", nptr->engineID[i]));
-                }
-                DEBUGMSG(("9:usmUser", " - %d \n  -> OID: ", result));
-                DEBUGMSGOID(("9:usmUser", indexOid, len));
-                DEBUGMSG(("9:usmUser", "\n"));
-
+                if (indexOid == NULL ||
+                    snmp_oid_compare(name, *length, indexOid, len) != 0)
+                    nptr = NULL;
                 free(indexOid);
-
-                if (exact) {
-                    if (result == 0) {
-                        uptr = nptr;
+            }
+            if (nptr != NULL)
+                uptr = exact ? nptr : nptr->next;
+            else if (!exact) {
+                for (nptr = usm_get_userList(), uptr = NULL;
+                     nptr != NULL; nptr = nptr->next) {
+                    indexOid =
+                        usm_generate_OID(vp->name, vp->namelen, nptr, &len);
+                    result = snmp_oid_compare(name, *length, indexOid, len);
+                    DEBUGMSGTL(("9:usmUser", "Checking user: %s - ",
+                                nptr->name));
+                    for (i = 0; i < (int) nptr->engineIDLen; i++) {
+                        DEBUGMSG(("9:usmUser", " %x", nptr->engineID[i]));
                     }
-                } else {
+                    DEBUGMSG(("9:usmUser", " - %d \n  -> OID: ", result));
+                    DEBUGMSGOID(("9:usmUser", indexOid, len));
+                    DEBUGMSG(("9:usmUser", "\n"));
+
+                    free(indexOid);
+
                     if (result == 0) {
                         /*
                          * found an exact match.  Need the next one for !exact 
@@ -19,6 +19,7 @@ struct extensible {
     oid             miboid[MIBMAX];
     size_t          miblen;
     int             mibpriority;
+    int             timeout;
     netsnmp_pid_t   pid;
 #if defined(WIN32)
     HANDLE          tid;                /* WIN32 thread */
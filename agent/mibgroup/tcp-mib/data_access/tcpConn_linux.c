@@ -12,6 +12,7 @@
 #include "tcp-mib/tcpConnectionTable/tcpConnectionTable_constants.h"
 #include "tcp-mib/data_access/tcpConn_private.h"
 #include "mibgroup/util_funcs/get_pid_from_inode.h"
+#include "mibgroup/util_funcs/sock_diag.h"
 static int
 linux_states[12] = { 1, 5, 3, 4, 6, 7, 11, 1, 8, 9, 2, 10 };
 
@@ -19,6 +20,10 @@ static int _load4(netsnmp_container *container, u_int flags);
 #if defined (NETSNMP_ENABLE_IPV6)
 static int _load6(netsnmp_container *container, u_int flags);
 #endif
+#if HAVE_LINUX_SOCK_DIAG_H
+static int _load_diag(netsnmp_container *container, u_char family,
+                      u_int flags);
+#endif
 
 /*
  * initialize arch specific storage
@@ -92,6 +97,14 @@ netsnmp_arch_tcpconn_container_load(netsnmp_container *container,
         return -1;
     }
 
+    /*
+     * ask the kernel over netlink first; read /proc/net/tcp{,6} if
+     * sock_diag is disabled or not there (-2)
+     */
+#if HAVE_LINUX_SOCK_DIAG_H
+    rc = _load_diag(container, AF_INET, load_flags);
+    if (-2 == rc)
+#endif
     rc = _load4(container, load_flags);
 
 #if defined (NETSNMP_ENABLE_IPV6)
@@ -102,6 +115,10 @@ netsnmp_arch_tcpconn_container_load(netsnmp_container *container,
      * load ipv6. ipv6 module might not be loaded,
      * so ignore -2 err (file not found)
      */
+#if HAVE_LINUX_SOCK_DIAG_H
+    rc = _load_diag(container, AF_INET6, load_flags);
+    if (-2 == rc)
+#endif
     rc = _load6(container, load_flags);
     if (-2 == rc)
         rc = 0;
@@ -400,3 +417,92 @@ _load6(netsnmp_container *container, u_int load_flags)
     return 0;
 }
 #endif /* NETSNMP_ENABLE_IPV6 */
+
+#if HAVE_LINUX_SOCK_DIAG_H
+#define LINUX_TCP_LISTEN 10
+
+/*
+ * add the connection in a sock_diag message to the container
+ */
+static int
+_add_diag(const struct inet_diag_msg *msg, void *context)
+{
+    netsnmp_container *container = (netsnmp_container *) context;
+    netsnmp_tcpconn_entry *entry;
+    int             addr_len = (AF_INET6 == msg->idiag_family) ? 16 : 4;
+
+    entry = netsnmp_access_tcpconn_entry_create();
+    if (NULL == entry)
+        return -3;
+
+    entry->loc_port = ntohs(msg->id.idiag_sport);
+    entry->rmt_port = ntohs(msg->id.idiag_dport);
+    memcpy(entry->loc_addr, msg->id.idiag_src, addr_len);
+    entry->loc_addr_len = addr_len;
+    memcpy(entry->rmt_addr, msg->id.idiag_dst, addr_len);
+    entry->rmt_addr_len = addr_len;
+    entry->tcpConnState = (msg->idiag_state & 0xf) < 12 ?
+        linux_states[msg->idiag_state & 0xf] : 2;
+    entry->pid = netsnmp_get_pid_from_inode(msg->idiag_inode);
+
+    /*
+     * add entry to container
+     */
+    entry->arbitrary_index = CONTAINER_SIZE(container) + 1;
+    CONTAINER_INSERT(container, entry);
+
+    return 0;
+}
+
+/*
+ * take out the connections numbered after count again, when a dump has
+ * failed part way and /proc is read instead
+ */
+static void
+_drop_diag(netsnmp_container *container, size_t count)
+{
+    netsnmp_tcpconn_entry *entry;
+    netsnmp_index   key;
+    oid             index;
+
+    key.len = 1;
+    key.oids = &index;
+    for (index = CONTAINER_SIZE(container); index > count; index--) {
+        entry = (netsnmp_tcpconn_entry *) CONTAINER_FIND(container, &key);
+        if (NULL == entry)
+            continue;
+        CONTAINER_REMOVE(container, entry);
+        netsnmp_access_tcpconn_entry_free(entry);
+    }
+}
+
+/**
+ * load the connections of a family over a sock_diag socket. The kernel
+ * leaves out the listeners, or everything else, itself.
+ *
+ * @retval  0 no errors
+ * @retval -2 sock_diag not available, read /proc instead
+ * @retval !0 errors
+ */
+static int
+_load_diag(netsnmp_container *container, u_char family, u_int load_flags)
+{
+    u_int           states = ~0U;
+    size_t          count;
+    int             rc;
+
+    netsnmp_assert(NULL != container);
+
+    if (load_flags & NETSNMP_ACCESS_TCPCONN_LOAD_NOLISTEN)
+        states &= ~(1U << LINUX_TCP_LISTEN);
+    else if (load_flags & NETSNMP_ACCESS_TCPCONN_LOAD_ONLYLISTEN)
+        states = 1U << LINUX_TCP_LISTEN;
+
+    count = CONTAINER_SIZE(container);
+    rc = netsnmp_sock_diag_dump(family, IPPROTO_TCP, states, _add_diag,
+                                container);
+    if (-2 == rc)
+        _drop_diag(container, count);
+    return rc;
+}
+#endif /* HAVE_LINUX_SOCK_DIAG_H */
@@ -40,6 +40,10 @@
  * OID: .1.3.6.1.2.1.6.19, length: 8
  */
 
+static int      _merge_connection(netsnmp_cache *cache, void *old_row,
+                                  void *new_row);
+static void     _free_connection(void *row, void *context);
+
 /**
  * initialization for tcpConnectionTable data access
  *
@@ -131,6 +135,14 @@ tcpConnectionTable_container_init(netsnmp_container **container_ptr_ptr,
      */
     cache->timeout = TCPCONNECTIONTABLE_CACHE_TIMEOUT;  /* seconds */
     cache->flags |= NETSNMP_CACHE_DONT_INVALIDATE_ON_SET;
+
+    /*
+     * most connections are still there on the next load, so keep their
+     * rows and only update the state and pid.
+     */
+    cache->flags |= NETSNMP_CACHE_MERGE_ON_RELOAD;
+    cache->merge_row = _merge_connection;
+    cache->free_row = _free_connection;
 }                               /* tcpConnectionTable_container_init */
 
 /**
@@ -206,6 +218,31 @@ _add_connection(netsnmp_tcpconn_entry *entry, netsnmp_container *container)
     }
 }
 
+/**
+ * update a connection which is still there after a reload
+ */
+static int
+_merge_connection(netsnmp_cache *cache, void *old_row, void *new_row)
+{
+    tcpConnectionTable_rowreq_ctx *old_ctx =
+        (tcpConnectionTable_rowreq_ctx *) old_row;
+    tcpConnectionTable_rowreq_ctx *new_ctx =
+        (tcpConnectionTable_rowreq_ctx *) new_row;
+
+    return netsnmp_access_tcpconn_entry_update(old_ctx->data,
+                                               new_ctx->data);
+}
+
+/**
+ * release a connection which has gone, or a reloaded duplicate
+ */
+static void
+_free_connection(void *row, void *context)
+{
+    tcpConnectionTable_release_rowreq_ctx((tcpConnectionTable_rowreq_ctx *)
+                                          row);
+}
+
 /**
  * load initial data
  *
@@ -23,6 +23,12 @@
 #if HAVE_SYS_WAIT_H
 # include <sys/wait.h>
 #endif
+#if HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#if HAVE_SYS_SELECT_H
+#include <sys/select.h>
+#endif
 #ifdef HAVE_LIMITS_H
 #include <limits.h>
 #endif
@@ -35,6 +41,7 @@
 
 #include <net-snmp/net-snmp-includes.h>
 #include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/library/large_fd_set.h>
 
 #include "struct.h"
 #include "pass_persist.h"
@@ -47,10 +54,55 @@ netsnmp_feature_require(parse_miboid)
 
 struct extensible *persistpassthrus = NULL;
 int             numpersistpassthrus = 0;
+
+/*
+ * Requests are written to the helpers as they come in, without waiting
+ * for the replies to earlier ones, and the GET/GETNEXT requests are
+ * delegated until the replies have been read, from the agent's fd
+ * event loop.  Neither pipe blocks: what a helper hasn't taken yet is
+ * queued and written as its pipe becomes writable.  A helper that
+ * doesn't reply within its timeout is killed (and restarted by the
+ * next request).
+ */
+#define PERSIST_PING    0
+#define PERSIST_GET     1
+#define PERSIST_GETNEXT 2
+#define PERSIST_SET     3
+
+#define PERSIST_DEFAULT_TIMEOUT 10
+
+/*
+ * The GET/GETNEXT varbinds of one handler call, delegated until they
+ * have all been answered
+ */
+typedef struct persist_call_s {
+    netsnmp_delegated_cache *cache;
+    int             pending;
+    int             active;             /* still in the handler */
+} persist_call;
+
+typedef struct persist_request_s {
+    int             type;
+    persist_call   *call;               /* NULL if waited for */
+    netsnmp_request_info *request;
+    int             nlines;
+    char           *lines[3];
+    int             done;               /* 1 = answered, -1 = failed */
+    struct persist_request_s *next;
+} persist_request;
+
 struct persist_pipe_type {
-    FILE           *fIn, *fOut;
     int             fdIn, fdOut;
     netsnmp_pid_t   pid;
+    int             registered;         /* with the fd event loop */
+    int             timeout;
+    unsigned int    timer;
+    persist_request *requests;          /* waiting for replies, in order */
+    int             len;
+    char            buf[SNMP_MAXBUF];
+    char           *out;                /* not yet taken by the helper */
+    size_t          out_len, out_size;
+    int             writing;            /* fdOut registered with the loop */
 }              *persist_pipes = (struct persist_pipe_type *) NULL;
 static unsigned pipe_check_alarm_id;
 static int      init_persist_pipes(void);
@@ -59,17 +111,9 @@ static int      open_persist_pipe(int iindex, char *command);
 static void     check_persist_pipes(unsigned clientreg, void *clientarg);
 static void     destruct_persist_pipes(void);
 static int      write_persist_pipe(int iindex, const char *data);
-
-/*
- * the relocatable extensible commands variables 
- */
-struct variable2 extensible_persist_passthru_variables[] = {
-    /*
-     * bogus entry.  Only some of it is actually used. 
-     */
-    {MIBINDEX, ASN_INTEGER, NETSNMP_OLDAPI_RWRITE,
-     var_extensible_pass_persist, 0, {MIBINDEX}},
-};
+static int      persist_pipe_flush(int iindex);
+static void     persist_request_done(persist_request *req, int ok);
+static Netsnmp_Node_Handler handle_pass_persist;
 
 void
 init_pass_persist(void)
@@ -134,12 +178,14 @@ pass_persist_parse_config(const char *token, char *cptr)
     struct extensible **ppass = &persistpassthrus, **etmp, *ptmp;
     char           *tcptr, *endopt;
     int             i;
-    long int        priority;
+    long int        priority, timeout;
+    netsnmp_handler_registration *reg;
 
     /*
      * options
      */
     priority = DEFAULT_MIB_PRIORITY;
+    timeout = PERSIST_DEFAULT_TIMEOUT;
     while (*cptr == '-') {
       cptr++;
       switch (*cptr) {
@@ -159,6 +205,22 @@ pass_persist_parse_config(const char *token, char *cptr)
 	cptr = endopt;
 	cptr = skip_white(cptr);
 	break;
+      case 't':
+	/* seconds to wait for each reply */
+	cptr++;
+	cptr = skip_white(cptr);
+	if (! isdigit((unsigned char)(*cptr))) {
+	  config_perror("timeout must be an integer");
+	  return;
+	}
+	timeout = strtol((const char*) cptr, &endopt, 0);
+	if (timeout <= 0 || timeout > INT_MAX) {
+	  config_perror("timeout out of range");
+	  return;
+	}
+	cptr = endopt;
+	cptr = skip_white(cptr);
+	break;
       default:
 	config_perror("unknown option for pass directive");
 	return;
@@ -183,6 +245,7 @@ pass_persist_parse_config(const char *token, char *cptr)
         return;
     (*ppass)->type = PASSTHRU_PERSIST;
     (*ppass)->mibpriority = priority;
+    (*ppass)->timeout = timeout;
 
     (*ppass)->miblen = parse_miboid(cptr, (*ppass)->miboid);
     while (isdigit((unsigned char)(*cptr)) || *cptr == '.')
@@ -207,10 +270,17 @@ pass_persist_parse_config(const char *token, char *cptr)
     strlcpy((*ppass)->name, (*ppass)->command, sizeof((*ppass)->name));
     (*ppass)->next = NULL;
 
-    register_mib_priority("pass_persist",
-                 (struct variable *) extensible_persist_passthru_variables,
-                 sizeof(struct variable2), 1, (*ppass)->miboid,
-                 (*ppass)->miblen, (*ppass)->mibpriority);
+    reg = netsnmp_create_handler_registration("pass_persist",
+                                              handle_pass_persist,
+                                              (*ppass)->miboid,
+                                              (*ppass)->miblen,
+                                              HANDLER_CAN_RWRITE);
+    if (reg) {
+        reg->priority = (*ppass)->mibpriority;
+        reg->my_reg_void = *ppass;
+        if (netsnmp_register_handler(reg) != MIB_REGISTERED_OK)
+            config_perror("failed to register pass_persist");
+    }
 
     /*
      * argggg -- pasthrus must be sorted 
@@ -245,19 +315,15 @@ void
 pass_persist_free_config(void)
 {
     struct extensible *etmp, *etmp2;
-    int i;
 
     for (etmp = persistpassthrus; etmp != NULL;) {
         etmp2 = etmp;
         etmp = etmp->next;
         unregister_mib_priority(etmp2->miboid, etmp2->miblen, etmp2->mibpriority);
+        free(etmp2->command);
         free(etmp2);
     }
-    if (persist_pipes) {
-        for (i = 0; i <= numpersistpassthrus; i++) {
-            close_persist_pipe(i);
-        }
-    }
+    destruct_persist_pipes();
     persistpassthrus = NULL;
     numpersistpassthrus = 0;
 }
@@ -284,206 +350,491 @@ int get_exten_group_id(struct extensible *persistpassthru,
 }
 #endif /* USING_SINGLE_COMMON_PASSPERSIST_INSTANCE */
 
-u_char         *
-var_extensible_pass_persist(struct variable *vp,
-                            oid * name,
-                            size_t * length,
-                            int exact,
-                            size_t * var_len, WriteMethod ** write_method)
+/*
+ * The index of the pipe to the helper for a pass_persist entry, which
+ * is changed to the entry running that helper if they are grouped
+ */
+static int
+persist_pipe_index(struct extensible **persistpassthru)
+{
+    struct extensible *ptmp;
+    int             i;
+
+    for (i = 1, ptmp = persistpassthrus; ptmp != NULL;
+         ptmp = ptmp->next, i++) {
+        if (ptmp == *persistpassthru)
+            break;
+    }
+    if (ptmp == NULL)
+        return 0;
+#ifdef USING_SINGLE_COMMON_PASSPERSIST_INSTANCE
+    {
+        int             pipe_idx =
+            get_exten_group_id((*persistpassthru)->passpersist_inst, i);
+
+        if (pipe_idx != i) {
+            *persistpassthru = (*persistpassthru)->passpersist_inst;
+            i = pipe_idx;
+        }
+    }
+#endif /* USING_SINGLE_COMMON_PASSPERSIST_INSTANCE */
+    return i;
+}
+
+static persist_request *
+persist_request_new(int type, persist_call *call,
+                    netsnmp_request_info *request)
 {
-    oid             newname[MAX_OID_LEN];
-    int             i, rtest, newlen;
-    char            buf[SNMP_MAXBUF];
-    static char     buf2[SNMP_MAXBUF];
-    struct extensible *persistpassthru;
-    FILE           *file;
-    int             pipe_idx;
+    persist_request *req = SNMP_MALLOC_TYPEDEF(persist_request);
+
+    if (req) {
+        req->type = type;
+        req->call = call;
+        req->request = request;
+    }
+    return req;
+}
+
+static void
+persist_request_free(persist_request *req)
+{
+    int             i;
+
+    for (i = 0; i < req->nlines; i++)
+        free(req->lines[i]);
+    free(req);
+}
+
+/*
+ * (Re)start the timer for the oldest request still waiting for a reply
+ */
+static void
+persist_pipe_timeout(unsigned clientreg, void *clientarg)
+{
+    int             iindex = (struct persist_pipe_type *) clientarg -
+                             persist_pipes;
+
+    persist_pipes[iindex].timer = 0;
+    snmp_log(LOG_WARNING,
+             "pass_persist[%d]: no reply within %d seconds - closing pipe\n",
+             iindex, persist_pipes[iindex].timeout);
+    close_persist_pipe(iindex);
+}
+
+static void
+persist_pipe_arm(int iindex)
+{
+    struct persist_pipe_type *p = &persist_pipes[iindex];
+
+    if (p->timer) {
+        snmp_alarm_unregister(p->timer);
+        p->timer = 0;
+    }
+    if (p->requests)
+        p->timer = snmp_alarm_register(p->timeout, 0, persist_pipe_timeout,
+                                       p);
+}
+
+/*
+ * A line of output from a helper, for the oldest request waiting.
+ * Returns -1 if the helper isn't making sense.
+ */
+static int
+persist_pipe_line(int iindex, const char *line, int len)
+{
+    struct persist_pipe_type *p = &persist_pipes[iindex];
+    persist_request *req = p->requests;
+    int             need;
+
+    if (req == NULL) {
+        DEBUGMSGTL(("ucd-snmp/pass_persist",
+                    "pass_persist[%d]: unexpected output %.*s", iindex,
+                    len, line));
+        return 0;
+    }
+    req->lines[req->nlines] = (char *) malloc(len + 1);
+    if (req->lines[req->nlines] == NULL)
+        return -1;
+    memcpy(req->lines[req->nlines], line, len);
+    req->lines[req->nlines++][len] = '\0';
 
     /*
-     * Make sure that our basic pipe structure is malloced 
+     * persistent scripts return "NONE\n" on invalid items
      */
-    init_persist_pipes();
-
-    for (i = 1; i <= numpersistpassthrus; i++) {
-        persistpassthru = get_exten_instance(persistpassthrus, i);
-        rtest = snmp_oidtree_compare(name, *length,
-                                     persistpassthru->miboid,
-                                     persistpassthru->miblen);
-        if ((exact && rtest == 0) || (!exact && rtest <= 0)) {
-            /*
-             * setup args 
-             */
-            if (persistpassthru->miblen >= *length || rtest < 0)
-                sprint_mib_oid(buf, persistpassthru->miboid,
-                               persistpassthru->miblen);
+    if (req->type == PERSIST_GET || req->type == PERSIST_GETNEXT)
+        need = strncmp(req->lines[0], "NONE", 4) ? 3 : 1;
+    else
+        need = 1;
+    if (req->nlines < need)
+        return 0;
+
+    p->requests = req->next;
+    persist_pipe_arm(iindex);
+    if (req->type == PERSIST_PING) {
+        need = strncmp(req->lines[0], "PONG", 4);
+        if (need)
+            DEBUGMSGTL(("ucd-snmp/pass_persist",
+                        "pass_persist[%d]: Got %s instead of PONG!\n",
+                        iindex, req->lines[0]));
+        persist_request_free(req);
+        return need ? -1 : 0;
+    }
+    persist_request_done(req, 1);
+    return 0;
+}
+
+/*
+ * Read what a helper has written so far.
+ * Returns -1 if it has gone away, or isn't making sense.
+ */
+static int
+persist_pipe_read(int iindex)
+{
+    struct persist_pipe_type *p = &persist_pipes[iindex];
+    ssize_t         count;
+    char           *nl;
+    int             len;
+
+    for (;;) {
+        count = read(p->fdIn, p->buf + p->len, sizeof(p->buf) - 1 - p->len);
+        if (count < 0)
+            return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+        if (count == 0)
+            return -1;
+        p->len += count;
+        while (p->len > 0) {
+            nl = (char *) memchr(p->buf, '\n', p->len);
+            if (nl)
+                len = nl - p->buf + 1;
+            else if (p->len == sizeof(p->buf) - 1)
+                len = p->len;           /* as much of the line as fits */
             else
-                sprint_mib_oid(buf, name, *length);
+                break;
+            if (persist_pipe_line(iindex, p->buf, len) < 0)
+                return -1;
+            memmove(p->buf, p->buf + len, p->len - len);
+            p->len -= len;
+        }
+    }
+}
 
-            pipe_idx = i;
-#ifdef USING_SINGLE_COMMON_PASSPERSIST_INSTANCE
-            pipe_idx = 
-               get_exten_group_id(persistpassthru->passpersist_inst, i);
+static void
+persist_pipe_readable(int fd, void *data)
+{
+    int             iindex = (struct persist_pipe_type *) data -
+                             persist_pipes;
 
-            if (pipe_idx != i) {
-                  persistpassthru = persistpassthru->passpersist_inst;
-            }
-#endif /* USING_SINGLE_COMMON_PASSPERSIST_INSTANCE */
-            /*
-             * Open our pipe if necessary 
-             */
-            if (!open_persist_pipe(pipe_idx, persistpassthru->name)) {
-                return (NULL);
-            }
+    if (persist_pipe_read(iindex) < 0) {
+        DEBUGMSGTL(("ucd-snmp/pass_persist",
+                    "pass_persist[%d]: read failed - closing pipe\n",
+                    iindex));
+        close_persist_pipe(iindex);
+    }
+}
 
-            free(persistpassthru->command);
-            if (asprintf(&persistpassthru->command, "%s\n%s\n",
-                         exact ? "get" : "getnext", buf) < 0) {
-                persistpassthru->command = NULL;
-                *var_len = 0;
-                return NULL;
-            }
+/*
+ * Wait for the replies to everything written to a helper, for requests
+ * that can't be delegated
+ */
+static void
+persist_pipe_drain(int iindex)
+{
+    struct persist_pipe_type *p = &persist_pipes[iindex];
+    netsnmp_large_fd_set readfds, writefds;
+    struct timeval  timeout;
+    int             rc, numfds;
+
+    /* the helper's fds may be above FD_SETSIZE */
+    netsnmp_large_fd_set_init(&readfds, FD_SETSIZE);
+    netsnmp_large_fd_set_init(&writefds, FD_SETSIZE);
+    while (p->requests && p->fdIn != -1) {
+        NETSNMP_LARGE_FD_ZERO(&readfds);
+        NETSNMP_LARGE_FD_ZERO(&writefds);
+        NETSNMP_LARGE_FD_SET(p->fdIn, &readfds);
+        numfds = p->fdIn + 1;
+        if (p->out_len > 0) {
+            NETSNMP_LARGE_FD_SET(p->fdOut, &writefds);
+            if (p->fdOut >= numfds)
+                numfds = p->fdOut + 1;
+        }
+        timeout.tv_sec = p->timeout;
+        timeout.tv_usec = 0;
+        rc = netsnmp_large_fd_set_select(numfds, &readfds, &writefds, NULL,
+                                         &timeout);
+        if (rc < 0 && errno == EINTR)
+            continue;
+        if (rc <= 0) {
+            snmp_log(LOG_WARNING, "pass_persist[%d]: no reply within %d "
+                     "seconds - closing pipe\n", iindex, p->timeout);
+            close_persist_pipe(iindex);
+            continue;
+        }
+        if (p->out_len > 0 && NETSNMP_LARGE_FD_ISSET(p->fdOut, &writefds) &&
+            !persist_pipe_flush(iindex))
+            continue;                   /* the pipe has been closed */
+        if (NETSNMP_LARGE_FD_ISSET(p->fdIn, &readfds) &&
+            persist_pipe_read(iindex) < 0)
+            close_persist_pipe(iindex);
+    }
+    netsnmp_large_fd_set_cleanup(&readfds);
+    netsnmp_large_fd_set_cleanup(&writefds);
+}
 
-            DEBUGMSGTL(("ucd-snmp/pass_persist",
-                        "persistpass-sending:\n%s",
-                        persistpassthru->command));
-            if (!write_persist_pipe(pipe_idx, persistpassthru->command)) {
-                *var_len = 0;
-                /*
-                 * close_persist_pipes is called in write_persist_pipe 
-                 */
-                return (NULL);
-            }
+/*
+ * Write a request to a helper, starting it if need be; if it has gone
+ * away, start it again and retry once.  Returns 1 if the request has
+ * been written and is waiting for its reply, 0 otherwise.
+ */
+static int
+persist_send(int iindex, struct extensible *persistpassthru,
+             const char *data, persist_request *req)
+{
+    struct persist_pipe_type *p = &persist_pipes[iindex];
+    persist_request **rp;
+    int             tries;
+
+    DEBUGMSGTL(("ucd-snmp/pass_persist", "persistpass-sending:\n%s",
+                data));
+    for (tries = 0; tries < 2; tries++) {
+        p->timeout = persistpassthru->timeout > 0 ?
+            persistpassthru->timeout : PERSIST_DEFAULT_TIMEOUT;
+        if (!open_persist_pipe(iindex, persistpassthru->name))
+            return 0;
+        if (write_persist_pipe(iindex, data)) {
+            for (rp = &p->requests; *rp; rp = &(*rp)->next)
+                ;
+            *rp = req;
+            if (rp == &p->requests)
+                persist_pipe_arm(iindex);
+            return 1;
+        }
+        /*
+         * close_persist_pipe is called in write_persist_pipe
+         */
+        DEBUGMSGTL(("ucd-snmp/pass_persist",
+                    "persist_send: reopening pipe %d\n", iindex));
+    }
+    return 0;
+}
 
-            /*
-             * valid call.  Exec and get output 
-             */
-		
-            if ((file = persist_pipes[pipe_idx].fIn)) {
-                if (fgets(buf, sizeof(buf), file) == NULL) {
-                    *var_len = 0;
-                    close_persist_pipe(pipe_idx);
-                    return (NULL);
-                }
-                /*
-                 * persistent scripts return "NONE\n" on invalid items 
-                 */
-                if (!strncmp(buf, "NONE", 4)) {
-                    if (exact) {
-                        *var_len = 0;
-                        return (NULL);
-                    }
-                    continue;
-                }
-                newlen = parse_miboid(buf, newname);
-
-                /*
-                 * its good, so copy onto name/length 
-                 */
-                memcpy((char *) name, (char *) newname,
-                       (int) newlen * sizeof(oid));
-                *length = newlen;
-
-                /*
-                 * set up return pointer for setable stuff 
-                 */
-                *write_method = setPassPersist;
-
-                if (newlen == 0 || fgets(buf, sizeof(buf), file) == NULL
-                    || fgets(buf2, sizeof(buf2), file) == NULL) {
-                    *var_len = 0;
-                    close_persist_pipe(pipe_idx);
-                    return (NULL);
-                }
-                return netsnmp_internal_pass_parse(buf, buf2, var_len, vp);
+static netsnmp_delegated_cache *
+persist_call_cache(persist_call *call)
+{
+    if (call->active)
+        return call->cache;
+    return netsnmp_handler_check_cache(call->cache);
+}
+
+/*
+ * One of a call's varbinds is done with; once they all are, the
+ * requests are handed back to the agent
+ */
+static void
+persist_call_release(persist_call *call)
+{
+    netsnmp_delegated_cache *cache;
+
+    if (--call->pending > 0)
+        return;
+    cache = persist_call_cache(call);
+    if (cache && !call->active &&
+        cache->reqinfo->mode == MODE_GETBULK)
+        netsnmp_bulk_to_next_fix_requests(cache->requests);
+    netsnmp_free_delegated_cache(call->cache);
+    free(call);
+}
+
+static void
+persist_request_done(persist_request *req, int ok)
+{
+    netsnmp_delegated_cache *cache;
+    netsnmp_variable_list *var;
+    struct variable vp;
+    oid             newname[MAX_OID_LEN];
+    int             newlen;
+    size_t          var_len;
+    u_char         *val;
+
+    if (req->type == PERSIST_PING) {
+        persist_request_free(req);
+        return;
+    }
+    if (req->call == NULL) {
+        req->done = ok ? 1 : -1;
+        return;
+    }
+
+    cache = persist_call_cache(req->call);
+    if (cache) {
+        req->request->delegated = REQUEST_IS_NOT_DELEGATED;
+        var = req->request->requestvb;
+        /*
+         * leave anything unanswered for the agent to deal with
+         */
+        if (ok && strncmp(req->lines[0], "NONE", 4)) {
+            newlen = parse_miboid(req->lines[0], newname);
+            val = netsnmp_internal_pass_parse(req->lines[1], req->lines[2],
+                                              &var_len, &vp);
+            if (newlen > 0 && val) {
+                if (req->type == PERSIST_GETNEXT)
+                    snmp_set_var_objid(var, newname, newlen);
+                snmp_set_var_typed_value(var, vp.type, val, var_len);
             }
-            *var_len = 0;
-            return (NULL);
         }
     }
-    if (var_len)
-        *var_len = 0;
-    *write_method = NULL;
-    return (NULL);
+    persist_call_release(req->call);
+    persist_request_free(req);
 }
 
-int
-setPassPersist(int action,
-               u_char * var_val,
-               u_char var_val_type,
-               size_t var_val_len,
-               u_char * statP, oid * name, size_t name_len)
+/*
+ * Send a request to a helper, and wait for its reply
+ */
+static int
+persist_request_wait(int iindex, struct extensible *persistpassthru,
+                     int type, const char *data, char *reply,
+                     size_t reply_len)
 {
-    int             i, rtest;
-    struct extensible *persistpassthru;
+    persist_request *req = persist_request_new(type, NULL, NULL);
+    int             ok = 0;
+
+    if (req == NULL)
+        return 0;
+    if (persist_send(iindex, persistpassthru, data, req)) {
+        persist_pipe_drain(iindex);
+        if (req->done > 0) {
+            ok = 1;
+            if (reply)
+                strlcpy(reply, req->lines[0], reply_len);
+            if (type == PERSIST_GET && !strncmp(req->lines[0], "NONE", 4))
+                ok = 0;
+        }
+    }
+    persist_request_free(req);
+    return ok;
+}
 
+static int
+handle_pass_persist(netsnmp_mib_handler *handler,
+                    netsnmp_handler_registration *reginfo,
+                    netsnmp_agent_request_info *reqinfo,
+                    netsnmp_request_info *requests)
+{
+    struct extensible *persistpassthru, *registered;
+    netsnmp_request_info *request;
+    netsnmp_variable_list *var;
+    persist_call   *call = NULL;
+    persist_request *req;
     char            buf[SNMP_MAXBUF], buf2[SNMP_MAXBUF];
-    int             pipe_idx;
+    char           *data;
+    int             pipe_idx, rtest, type;
 
     /*
      * Make sure that our basic pipe structure is malloced 
      */
-    init_persist_pipes();
-
-    for (i = 1; i <= numpersistpassthrus; i++) {
-        persistpassthru = get_exten_instance(persistpassthrus, i);
-        rtest = snmp_oidtree_compare(name, name_len,
-                                     persistpassthru->miboid,
-                                     persistpassthru->miblen);
-        pipe_idx = i;
-#ifdef USING_SINGLE_COMMON_PASSPERSIST_INSTANCE
-        pipe_idx = 
-           get_exten_group_id(persistpassthru->passpersist_inst, i);
+    if (!init_persist_pipes())
+        return SNMP_ERR_GENERR;
+    registered = persistpassthru = (struct extensible *) reginfo->my_reg_void;
+    pipe_idx = persist_pipe_index(&persistpassthru);
+    if (pipe_idx == 0)
+        return SNMP_ERR_GENERR;
+
+    for (request = requests; request; request = request->next) {
+        if (request->processed)
+            continue;
+        var = request->requestvb;
 
-        if (pipe_idx != i) {
-           persistpassthru = persistpassthru->passpersist_inst;
-        }
-#endif /* USING_SINGLE_COMMON_PASSPERSIST_INSTANCE */
-        if (rtest <= 0) {
-            if (action != ACTION)
-                return SNMP_ERR_NOERROR;
-            /*
-             * setup args 
-             */
-            if (persistpassthru->miblen >= name_len || rtest < 0)
-                sprint_mib_oid(buf, persistpassthru->miboid,
-                               persistpassthru->miblen);
-            else
-                sprint_mib_oid(buf, name, name_len);
-            netsnmp_internal_pass_set_format(buf2, var_val, var_val_type,
-                                             var_val_len);
-            free(persistpassthru->command);
-            if (asprintf(&persistpassthru->command, "set\n%s\n%s\n", buf,
-                         buf2) < 0) {
-                persistpassthru->command = NULL;
+        /*
+         * setup args 
+         */
+        rtest = snmp_oidtree_compare(var->name, var->name_length,
+                                     registered->miboid, registered->miblen);
+        if (registered->miblen >= var->name_length || rtest < 0)
+            sprint_mib_oid(buf, registered->miboid, registered->miblen);
+        else
+            sprint_mib_oid(buf, var->name, var->name_length);
+
+        switch (reqinfo->mode) {
+        case MODE_GET:
+        case MODE_GETNEXT:
+            type = reqinfo->mode == MODE_GET ? PERSIST_GET : PERSIST_GETNEXT;
+            if (asprintf(&data, "%s\n%s\n",
+                         type == PERSIST_GET ? "get" : "getnext", buf) < 0)
                 return SNMP_ERR_GENERR;
+            if (call == NULL) {
+                call = SNMP_MALLOC_TYPEDEF(persist_call);
+                if (call)
+                    call->cache = netsnmp_create_delegated_cache(handler,
+                                      reginfo, reqinfo, requests, NULL);
+                if (call == NULL || call->cache == NULL) {
+                    free(call);
+                    free(data);
+                    return SNMP_ERR_GENERR;
+                }
+                call->active = 1;
+                call->pending = 1;      /* until the end of this call */
             }
-
-            if (!open_persist_pipe(pipe_idx, persistpassthru->name)) {
-                return SNMP_ERR_NOTWRITABLE;
+            req = persist_request_new(type, call, request);
+            if (req == NULL) {
+                free(data);
+                break;
             }
-
+            request->delegated = REQUEST_IS_DELEGATED;
+            call->pending++;
+            if (!persist_send(pipe_idx, persistpassthru, data, req))
+                persist_request_done(req, 0);
+            free(data);
+            break;
+
+#ifndef NETSNMP_NO_WRITE_SUPPORT
+        case MODE_SET_RESERVE1:
+            /*
+             * only what the helper can GET can be SET
+             */
+            if (asprintf(&data, "get\n%s\n", buf) < 0)
+                return SNMP_ERR_GENERR;
+            if (!persist_request_wait(pipe_idx, persistpassthru, PERSIST_GET,
+                                      data, NULL, 0))
+                netsnmp_set_request_error(reqinfo, request,
+                                          SNMP_ERR_NOTWRITABLE);
+            free(data);
+            break;
+
+        case MODE_SET_ACTION:
+            netsnmp_internal_pass_set_format(buf2, var->val.string,
+                                             var->type, var->val_len);
+            if (asprintf(&data, "set\n%s\n%s\n", buf, buf2) < 0)
+                return SNMP_ERR_GENERR;
             DEBUGMSGTL(("ucd-snmp/pass_persist",
-                        "persistpass-writing:  %s\n",
-                        persistpassthru->command));
-            if (!write_persist_pipe(pipe_idx, persistpassthru->command)) {
-                close_persist_pipe(pipe_idx);
-                return SNMP_ERR_NOTWRITABLE;
-            }
-
-            if (fgets(buf, sizeof(buf), persist_pipes[pipe_idx].fIn) == NULL) {
-                close_persist_pipe(pipe_idx);
-                return SNMP_ERR_NOTWRITABLE;
-            }
-
-            return netsnmp_internal_pass_str_to_errno(buf);
+                        "persistpass-writing:  %s\n", data));
+            if (!persist_request_wait(pipe_idx, persistpassthru, PERSIST_SET,
+                                      data, buf, sizeof(buf)))
+                netsnmp_set_request_error(reqinfo, request,
+                                          SNMP_ERR_NOTWRITABLE);
+            else if ((rtest = netsnmp_internal_pass_str_to_errno(buf)) !=
+                     SNMP_ERR_NOERROR)
+                netsnmp_set_request_error(reqinfo, request, rtest);
+            free(data);
+            break;
+#endif /* NETSNMP_NO_WRITE_SUPPORT */
+
+        default:
+            break;
         }
     }
-    if (snmp_get_do_debugging()) {
-        sprint_mib_oid(buf2, name, name_len);
-        DEBUGMSGTL(("ucd-snmp/pass_persist", "persistpass-notfound:  %s\n",
-                    buf2));
+
+    if (call) {
+        /*
+         * without the fd event loop, wait for the replies here
+         */
+        if (!persist_pipes[pipe_idx].registered ||
+            (persist_pipes[pipe_idx].out_len > 0 &&
+             !persist_pipes[pipe_idx].writing))
+            persist_pipe_drain(pipe_idx);
+        if (call->pending > 1)
+            call->active = 0;
+        persist_call_release(call);
     }
-    return SNMP_ERR_NOSUCHNAME;
+    return SNMP_ERR_NOERROR;
 }
 
 int
@@ -499,7 +850,7 @@ pass_persist_compare(const void *a, const void *b)
 /*
  * Initialize our persistent pipes
  *   - Returns 1 on success, 0 on failure.
- *   - Initializes all FILE pointers to NULL to indicate "closed"
+ *   - Initializes all fds to -1 to indicate "closed"
  */
 static int
 init_persist_pipes(void)
@@ -520,8 +871,9 @@ init_persist_pipes(void)
         malloc(sizeof(struct persist_pipe_type) *
                (numpersistpassthrus + 1));
     if (persist_pipes) {
+        memset(persist_pipes, 0, sizeof(struct persist_pipe_type) *
+               (numpersistpassthrus + 1));
         for (i = 0; i <= numpersistpassthrus; i++) {
-            persist_pipes[i].fIn = persist_pipes[i].fOut = (FILE *) 0;
             persist_pipes[i].fdIn = persist_pipes[i].fdOut = -1;
             persist_pipes[i].pid = NETSNMP_NO_SUCH_PROCESS;
         }
@@ -597,10 +949,10 @@ destruct_persist_pipes(void)
 static int
 open_persist_pipe(int iindex, char *command)
 {
-    static int      recurse = 0;        /* used to allow one level of recursion */
+    persist_request *req;
 
-    DEBUGMSGTL(("ucd-snmp/pass_persist", "open_persist_pipe(%d,'%s') recurse=%d\n",
-                iindex, command, recurse));
+    DEBUGMSGTL(("ucd-snmp/pass_persist", "open_persist_pipe(%d,'%s')\n",
+                iindex, command));
     /*
      * Open if it's not already open 
      */
@@ -615,7 +967,6 @@ open_persist_pipe(int iindex, char *command)
             (pid == NETSNMP_NO_SUCH_PROCESS)) {
             DEBUGMSGTL(("ucd-snmp/pass_persist",
                         "open_persist_pipe: pid == -1\n"));
-            recurse = 0;
             return 0;
         }
 
@@ -625,77 +976,62 @@ open_persist_pipe(int iindex, char *command)
         persist_pipes[iindex].pid = pid;
         persist_pipes[iindex].fdIn = fdIn;
         persist_pipes[iindex].fdOut = fdOut;
-        persist_pipes[iindex].fIn = fdopen(fdIn, "r");
-        persist_pipes[iindex].fOut = fdopen(fdOut, "w");
+        persist_pipes[iindex].len = 0;
 
         /*
-         * Setup our -non-buffered-io- 
+         * Read the replies as they arrive, from the fd event loop
+         * (or, if it has no room for them, wait for them as they
+         * are needed); requests the helper hasn't taken yet are
+         * written as its pipe becomes writable
          */
-        setbuf(persist_pipes[iindex].fOut, (char *) 0);
+#ifdef O_NONBLOCK
+        fcntl(fdIn, F_SETFL, fcntl(fdIn, F_GETFL) | O_NONBLOCK);
+        fcntl(fdOut, F_SETFL, fcntl(fdOut, F_GETFL) | O_NONBLOCK);
+#endif
+        persist_pipes[iindex].registered =
+            register_readfd(fdIn, persist_pipe_readable,
+                            &persist_pipes[iindex]) == FD_REGISTERED_OK;
         DEBUGMSGTL(("ucd-snmp/pass_persist", "open_persist_pipe: opened the pipes\n"));
-    }
 
-    /*
-     * Send test packet always so we can self-catch 
-     */
-    {
-        char            buf[SNMP_MAXBUF];
         /*
-         * Should catch SIGPIPE around this call! 
+         * Send a test packet first, so we can self-catch; the
+         * requests that follow needn't wait for the reply
          */
-        if (!write_persist_pipe(iindex, "PING\n")) {
+        req = persist_request_new(PERSIST_PING, NULL, NULL);
+        if (req == NULL || !write_persist_pipe(iindex, "PING\n")) {
             DEBUGMSGTL(("ucd-snmp/pass_persist",
                         "open_persist_pipe: Error writing PING\n"));
+            if (req)
+                persist_request_free(req);
             close_persist_pipe(iindex);
-
-            /*
-             * Recurse one time if we get a SIGPIPE 
-             */
-            if (!recurse) {
-                DEBUGMSGTL(("ucd-snmp/pass_persist", "open_persist_pipe: recursing to reopen\n"));
-                recurse = 1;
-                return open_persist_pipe(iindex, command);
-            }
-            recurse = 0;
-            return 0;
-        }
-        if (fgets(buf, sizeof(buf), persist_pipes[iindex].fIn) == NULL) {
-            DEBUGMSGTL(("ucd-snmp/pass_persist",
-                        "open_persist_pipe: Error reading for PONG\n"));
-            close_persist_pipe(iindex);
-            recurse = 0;
-            return 0;
-        }
-
-        if (strncmp(buf, "PONG", 4)) {
-            DEBUGMSGTL(("ucd-snmp/pass_persist",
-                        "open_persist_pipe: Got %s instead of PONG!\n", buf));
-            close_persist_pipe(iindex);
-            recurse = 0;
             return 0;
         }
+        persist_pipes[iindex].requests = req;
+        persist_pipe_arm(iindex);
     }
 
-    recurse = 0;
     return 1;
 }
 
+static void
+persist_pipe_writable(int fd, void *data)
+{
+    persist_pipe_flush((struct persist_pipe_type *) data - persist_pipes);
+}
+
+/*
+ * Write as much of what is queued for a helper as its pipe takes; the
+ * rest is written when the pipe becomes writable again.  Returns 0 if
+ * the helper has gone away (and the pipe has been closed), 1 otherwise.
+ */
 static int
-write_persist_pipe(int iindex, const char *data)
+persist_pipe_flush(int iindex)
 {
+    struct persist_pipe_type *p = &persist_pipes[iindex];
+    ssize_t         wret = 0;
+    int             werrno = 0;
 #if HAVE_SIGNAL
     struct sigaction sa, osa;
-    int             wret = 0, werrno = 0;
-
-    /*
-     * Don't write to a non-existant process 
-     */
-    if (persist_pipes[iindex].pid == NETSNMP_NO_SUCH_PROCESS) {
-        DEBUGMSGTL(("ucd-snmp/pass_persist",
-                    "write_persist_pipe: not writing %s, process is non-existent",
-                    data));
-        return 0;
-    }
 
     /*
      * Setup our signal action to ignore SIGPIPEs 
@@ -707,19 +1043,28 @@ write_persist_pipe(int iindex, const char *data)
         DEBUGMSGTL(("ucd-snmp/pass_persist",
                     "write_persist_pipe: sigaction failed: %d", errno));
     }
+#endif                          /* HAVE_SIGNAL */
 
-    /*
-     * Do the write 
-     */
-    wret = write(persist_pipes[iindex].fdOut, data, strlen(data));
-    werrno = errno;
+    while (p->out_len > 0) {
+        wret = write(p->fdOut, p->out, p->out_len);
+        if (wret < 0) {
+            werrno = errno;
+            if (werrno == EINTR)
+                continue;
+            break;
+        }
+        p->out_len -= wret;
+        memmove(p->out, p->out + wret, p->out_len);
+    }
 
+#if HAVE_SIGNAL
     /*
      * Reset the signal handler 
      */
     sigaction(SIGPIPE, &osa, (struct sigaction *) 0);
+#endif                          /* HAVE_SIGNAL */
 
-    if (wret < 0) {
+    if (wret < 0 && werrno != EAGAIN) {
         if (werrno != EPIPE) {
             DEBUGMSGTL(("ucd-snmp/pass_persist",
                         "write_persist_pipe: write returned unknown error %d (%s)\n",
@@ -728,33 +1073,57 @@ write_persist_pipe(int iindex, const char *data)
         close_persist_pipe(iindex);
         return 0;
     }
-#endif                          /* HAVE_SIGNAL */
-#if defined(WIN32) && !defined (mingw32) && !defined (HAVE_SIGNAL)
-/* We have no signal here (maybe we can make a Thread?) so write may block, 
- * but probably never will.
+
+    if (p->out_len > 0 && !p->writing)
+        p->writing = register_writefd(p->fdOut, persist_pipe_writable,
+                                      p) == FD_REGISTERED_OK;
+    else if (p->out_len == 0 && p->writing) {
+        unregister_writefd(p->fdOut);
+        p->writing = 0;
+    }
+    return 1;
+}
+
+/*
+ * Queue data for a helper, and write what its pipe takes now.
+ * Returns 0 if the helper has gone away, 1 otherwise.
  */
-    int wret = 0, werrno = 0;
+static int
+write_persist_pipe(int iindex, const char *data)
+{
+    struct persist_pipe_type *p = &persist_pipes[iindex];
+    size_t          len = strlen(data);
+    char           *out;
 
     /*
-     * Do the write 
+     * Don't write to a non-existant process 
      */
-    wret = write(persist_pipes[iindex].fdOut, data,strlen(data));
-    werrno = errno;
-    
-    if (wret < 0) {
-      if (werrno != EINTR) {
-        DEBUGMSGTL(("ucd-snmp/pass_persist", "write_persist_pipe: write returned unknown error %d\n",errno));
-      }
-      close_persist_pipe(iindex);
-      return 0;
+    if (p->pid == NETSNMP_NO_SUCH_PROCESS) {
+        DEBUGMSGTL(("ucd-snmp/pass_persist",
+                    "write_persist_pipe: not writing %s, process is non-existent",
+                    data));
+        return 0;
     }
-#endif                          /* WIN32 */
-    return 1;
+
+    if (p->out_len + len > p->out_size) {
+        out = (char *) realloc(p->out, p->out_len + len + SNMP_MAXBUF);
+        if (out == NULL) {
+            close_persist_pipe(iindex);
+            return 0;
+        }
+        p->out = out;
+        p->out_size = p->out_len + len + SNMP_MAXBUF;
+    }
+    memcpy(p->out + p->out_len, data, len);
+    p->out_len += len;
+    return persist_pipe_flush(iindex);
 }
 
 static void
 close_persist_pipe(int iindex)
 {
+    persist_request *req, *next;
+
 /*	Alexander Prömel, alexander@proemel.de 08/24/2006
 	The hard coded pathnames, are temporary.
 	I'll fix it soon.
@@ -771,36 +1140,23 @@ close_persist_pipe(int iindex)
     /*
      * Check and nix every item 
      */
-    if (persist_pipes[iindex].fOut) {
-        fclose(persist_pipes[iindex].fOut);
-        persist_pipes[iindex].fOut = (FILE *) 0;
-    }
     if (persist_pipes[iindex].fdOut != -1) {
-#ifndef WIN32
-        /*
-         * The sequence open()/fdopen()/fclose()/close() triggers an access
-         * violation with the MSVC runtime. Hence skip the close() call when
-         * using the MSVC runtime.
-         */
+        if (persist_pipes[iindex].writing)
+            unregister_writefd(persist_pipes[iindex].fdOut);
+        persist_pipes[iindex].writing = 0;
         close(persist_pipes[iindex].fdOut);
-#endif
         persist_pipes[iindex].fdOut = -1;
     }
-    if (persist_pipes[iindex].fIn) {
-        fclose(persist_pipes[iindex].fIn);
-        persist_pipes[iindex].fIn = (FILE *) 0;
-    }
+    SNMP_FREE(persist_pipes[iindex].out);
+    persist_pipes[iindex].out_len = persist_pipes[iindex].out_size = 0;
     if (persist_pipes[iindex].fdIn != -1) {
-#ifndef WIN32
-        /*
-         * The sequence open()/fdopen()/fclose()/close() triggers an access
-         * violation with the MSVC runtime. Hence skip the close() call when
-         * using the MSVC runtime.
-         */
+        if (persist_pipes[iindex].registered)
+            unregister_readfd(persist_pipes[iindex].fdIn);
+        persist_pipes[iindex].registered = 0;
         close(persist_pipes[iindex].fdIn);
-#endif
         persist_pipes[iindex].fdIn = -1;
     }
+    persist_pipes[iindex].len = 0;
 
 #ifdef __uClinux__
 	/*remove the pipes*/
@@ -827,4 +1183,14 @@ close_persist_pipe(int iindex)
         persist_pipes[iindex].pid = NETSNMP_NO_SUCH_PROCESS;
     }
 
+    /*
+     * and fail anything still waiting for a reply
+     */
+    req = persist_pipes[iindex].requests;
+    persist_pipes[iindex].requests = NULL;
+    persist_pipe_arm(iindex);
+    for (; req; req = next) {
+        next = req->next;
+        persist_request_done(req, 0);
+    }
 }
@@ -10,8 +10,6 @@ config_require(utilities/execute)
 
 void            init_pass_persist(void);
 void            shutdown_pass_persist(void);
-extern FindVarMethod var_extensible_pass_persist;
-extern WriteMethod setPassPersist;
 
 /*
  * config file parsing routines 
@@ -503,82 +503,54 @@ sh_count_procs(char *procname)
 
 #elif NETSNMP_OSTYPE == NETSNMP_LINUXID
 
-#include <dirent.h>
-#include <fcntl.h>
-#include <unistd.h>
+#include "util_funcs/proc_snapshot.h"
 
 int
 sh_count_procs(char *procname)
 {
-    DIR *dir;
-    char cmdline[512], *tmpc;
-    char state[64];
-    struct dirent *ent;
+    netsnmp_proc_snapshot *procs;
+    netsnmp_proc_entry *proc;
+    size_t i;
 #ifdef USE_PROC_CMDLINE
-    int fd;
+    char cmdline[512];
+    size_t len,plen=strlen(procname);
 #endif
-    int len,plen=strlen(procname),total = 0;
-    FILE *status;
+    int total = 0;
 
-    if ((dir = opendir("/proc")) == NULL) return -1;
-    while (NULL != (ent = readdir(dir))) {
-      if(!(ent->d_name[0] >= '0' && ent->d_name[0] <= '9')) continue;
 #ifdef USE_PROC_CMDLINE  /* old method */
-      /* read /proc/XX/cmdline */
-      sprintf(cmdline,"/proc/%s/cmdline",ent->d_name);
-      if((fd = open(cmdline, O_RDONLY)) < 0) continue;
-      len = read(fd,cmdline,sizeof(cmdline) - 1);
-      close(fd);
-      if(len <= 0) continue;
+    if ((procs = netsnmp_proc_snapshot_get(NETSNMP_PROC_CMDLINE)) == NULL)
+        return -1;
+    for (i = 0; i < procs->count; i++) {
+      proc = &procs->entries[i];
+      /* argv[0] argv[1] ... from /proc/XX/cmdline */
+      len = proc->cmdline_len;
+      while(len && !proc->cmdline[len-1]) len--;
+      if(len == 0) continue;
+      if(len > sizeof(cmdline) - 1) len = sizeof(cmdline) - 1;
+      memcpy(cmdline, proc->cmdline, len);
       cmdline[len] = 0;
-      while(--len && !cmdline[len]);
-      if(len <= 0) continue;
       while(--len) if(!cmdline[len]) cmdline[len] = ' ';
       if(!strncmp(cmdline,procname,plen)) total++;
+    }
 #else
-      /* read /proc/XX/status */
-      sprintf(cmdline,"/proc/%s/status",ent->d_name);
-      if ((status = fopen(cmdline, "r")) == NULL)
-          continue;
-      if (fgets(cmdline, sizeof(cmdline), status) == NULL) {
-          fclose(status);
-          continue;
-      }
-      /* Grab the state of the process as well
-       * (so we can ignore zombie processes)
-       * XXX: Assumes the second line is the status
-       */
-      if (fgets(state, sizeof(state), status) == NULL) {
-          state[0]='\0';
-      }
-      fclose(status);
-      cmdline[sizeof(cmdline)-1] = '\0';
-      state[sizeof(state)-1] = '\0';
-      /* XXX: assumes Name: is first */
-      if (strncmp("Name:",cmdline, 5) != 0)
-          break;
-      tmpc = skip_token(cmdline);
-      if (!tmpc)
-          break;
-      for (len=0;; len++) {
-	if (tmpc[len] && isgraph(tmpc[len])) continue;
-	tmpc[len]='\0';
-	break;
-      }
+    /* the name and state of the process from /proc/XX/stat */
+    if ((procs = netsnmp_proc_snapshot_get(NETSNMP_PROC_STAT)) == NULL)
+        return -1;
+    for (i = 0; i < procs->count; i++) {
+      proc = &procs->entries[i];
       DEBUGMSGTL(("proc","Comparing wanted %s against %s\n",
-                  procname, tmpc));
-      if(len==plen && !strncmp(tmpc,procname,plen)) {
+                  procname, proc->name));
+      if(!strcmp(proc->name,procname)) {
           /* Do not count zombie process as they are not running processes */
-          if ( strstr(state, "zombie") == NULL ) {
+          if ( proc->state != 'Z' ) {
               total++;
               DEBUGMSGTL(("proc", " Matched.  total count now=%d\n", total));
           } else {
               DEBUGMSGTL(("proc", " Skipping zombie process.\n"));
           }
       }
-#endif      
     }
-    closedir(dir);
+#endif      
     return total;
 }
 
@@ -5,6 +5,9 @@
 #define _MIBGROUP_PROC_H
 
 config_require(util_funcs)
+#if defined(linux)
+config_require(util_funcs/proc_snapshot)
+#endif
 
      void            init_proc(void);
 
@@ -16,11 +16,15 @@
 
 #include "udp-mib/udpEndpointTable/udpEndpointTable_constants.h"
 #include "mibgroup/util_funcs/get_pid_from_inode.h"
+#include "mibgroup/util_funcs/sock_diag.h"
 #include "udp_endpoint_private.h"
 
 #include <fcntl.h>
 
 netsnmp_feature_require(text_utils)
+#if HAVE_LINUX_SOCK_DIAG_H
+netsnmp_feature_require(udp_endpoint_entry_create)
+#endif
 netsnmp_feature_child_of(udp_endpoint_all, libnetsnmpmibs)
 netsnmp_feature_child_of(udp_endpoint_writable, udp_endpoint_all)
 
@@ -28,6 +32,9 @@ static int _load4(netsnmp_container *container, u_int flags);
 #if defined (NETSNMP_ENABLE_IPV6)
 static int _load6(netsnmp_container *container, u_int flags);
 #endif
+#if HAVE_LINUX_SOCK_DIAG_H
+static int _load_diag(netsnmp_container *container, u_char family);
+#endif
 
 /*
  * initialize arch specific storage
@@ -94,6 +101,14 @@ netsnmp_arch_udp_endpoint_container_load(netsnmp_container *container,
     /* Setup the pid_from_inode table, and fill it.*/
     netsnmp_get_pid_from_inode_init();
 
+    /*
+     * ask the kernel over netlink first; read /proc/net/udp{,6} if
+     * sock_diag is disabled or not there (-2)
+     */
+#if HAVE_LINUX_SOCK_DIAG_H
+    rc = _load_diag(container, AF_INET);
+    if (-2 == rc)
+#endif
     rc = _load4(container, load_flags);
     if(rc < 0) {
         u_int flags = NETSNMP_ACCESS_UDP_ENDPOINT_FREE_KEEP_CONTAINER;
@@ -102,6 +117,10 @@ netsnmp_arch_udp_endpoint_container_load(netsnmp_container *container,
     }
 
 #if defined (NETSNMP_ENABLE_IPV6)
+#if HAVE_LINUX_SOCK_DIAG_H
+    rc = _load_diag(container, AF_INET6);
+    if (-2 == rc)
+#endif
     rc = _load6(container, load_flags);
     if(rc < 0) {
         u_int flags = NETSNMP_ACCESS_UDP_ENDPOINT_FREE_KEEP_CONTAINER;
@@ -311,3 +330,87 @@ _load6(netsnmp_container *container, u_int load_flags)
     return (NULL == container);
 }
 #endif /* NETSNMP_ENABLE_IPV6 */
+
+#if HAVE_LINUX_SOCK_DIAG_H
+/*
+ * add the endpoint in a sock_diag message to the container
+ */
+static int
+_add_diag(const struct inet_diag_msg *msg, void *context)
+{
+    netsnmp_container *container = (netsnmp_container *) context;
+    netsnmp_udp_endpoint_entry *ep;
+    int             addr_len = (AF_INET6 == msg->idiag_family) ? 16 : 4;
+
+    ep = netsnmp_access_udp_endpoint_entry_create();
+    if (NULL == ep)
+        return -1;
+
+    ep->loc_port = ntohs(msg->id.idiag_sport);
+    ep->rmt_port = ntohs(msg->id.idiag_dport);
+    memcpy(ep->loc_addr, msg->id.idiag_src, addr_len);
+    ep->loc_addr_len = addr_len;
+    memcpy(ep->rmt_addr, msg->id.idiag_dst, addr_len);
+    ep->rmt_addr_len = addr_len;
+    ep->state = msg->idiag_state;
+
+    /*
+     * Use inode as instance value.
+     */
+    ep->instance = msg->idiag_inode;
+    ep->pid = netsnmp_get_pid_from_inode(msg->idiag_inode);
+
+    /* numbered on from the endpoints already loaded, as for /proc */
+    ep->index = CONTAINER_SIZE(container);
+
+    CONTAINER_INSERT(container, ep);
+
+    return 0;
+}
+
+/*
+ * take out the endpoints numbered from count on again, when a dump has
+ * failed part way and /proc is read instead
+ */
+static void
+_drop_diag(netsnmp_container *container, size_t count)
+{
+    netsnmp_udp_endpoint_entry *ep;
+    netsnmp_index   key;
+    oid             index;
+
+    key.len = 1;
+    key.oids = &index;
+    for (index = CONTAINER_SIZE(container); index-- > count; ) {
+        ep = (netsnmp_udp_endpoint_entry *) CONTAINER_FIND(container, &key);
+        if (NULL == ep)
+            continue;
+        CONTAINER_REMOVE(container, ep);
+        netsnmp_access_udp_endpoint_entry_free(ep);
+    }
+}
+
+/**
+ * load the endpoints of a family over a sock_diag socket
+ *
+ * @retval  0 no errors
+ * @retval -2 sock_diag not available, read /proc instead
+ * @retval !0 errors
+ */
+static int
+_load_diag(netsnmp_container *container, u_char family)
+{
+    size_t          count;
+    int             rc;
+
+    if (NULL == container)
+        return -1;
+
+    count = CONTAINER_SIZE(container);
+    rc = netsnmp_sock_diag_dump(family, IPPROTO_UDP, ~0U, _add_diag,
+                                container);
+    if (-2 == rc)
+        _drop_diag(container, count);
+    return rc;
+}
+#endif /* HAVE_LINUX_SOCK_DIAG_H */
@@ -9,6 +9,8 @@
 config_error(get_pid_from_inode is only suppored on linux)
 #endif
 
+config_require(util_funcs/proc_snapshot)
+
 #define _LARGEFILE64_SOURCE 1
 
 #if HAVE_DIRENT_H
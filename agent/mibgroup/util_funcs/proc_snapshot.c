@@ -0,0 +1,450 @@
+/*
+ * util_funcs/proc_snapshot.c:  one scan of /proc on linux, shared by
+ * hrSWRunTable, hrSWRunPerfTable, prTable and the pid lookups of the
+ * TCP, UDP and SCTP tables, instead of a scan each.
+ *
+ * Each consumer asks for the parts of /proc/<pid> it needs. A snapshot
+ * taken less than PROC_SNAPSHOT_MAX_AGE seconds ago is used again, and
+ * only the parts it lacks are read; otherwise /proc is scanned again.
+ * Up to PROC_DIRFDS_MAX of the /proc/<pid> directories are kept open
+ * between scans, so that each file is opened relative to its directory
+ * rather than by its full path.
+ */
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+
+#include "proc_snapshot.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/resource.h>
+
+#define PROC_PATH               "/proc"
+#define SOCKET_TYPE_1           "socket:["
+#define SOCKET_TYPE_2           "[0000]:"
+
+/* A scan of /proc is used by all the tables loaded within this time.*/
+#define PROC_SNAPSHOT_MAX_AGE   5 /* seconds */
+
+/* more than hrSWRunPath and hrSWRunParameters need of a command line */
+#define PROC_READ_MAX           4096
+
+/*
+ * Directories kept open, and no more than a quarter of the fd limit:
+ * the agent's sockets and pipes must stay below FD_SETSIZE.
+ */
+#define PROC_DIRFDS_MAX         256
+
+static netsnmp_proc_snapshot snapshot;
+static size_t           snapshot_length = 0;    /* entries allocated */
+static struct timeval   snapshot_taken;
+static DIR             *proc_dir = NULL;
+static char            *read_buf = NULL;
+static int              dirfds_open = 0;
+static int              dirfds_max = -1;
+
+static void
+_close_dir(netsnmp_proc_entry *entry)
+{
+    if (entry->dirfd >= 0) {
+        close(entry->dirfd);
+        entry->dirfd = -1;
+        dirfds_open--;
+    }
+}
+
+static int
+_open_dir(netsnmp_proc_entry *entry)
+{
+    char            name[16];
+
+    snprintf(name, sizeof(name), "%d", (int) entry->pid);
+    entry->dirfd = openat(dirfd(proc_dir), name,
+                          O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (entry->dirfd < 0)
+        return -1;
+    dirfds_open++;
+    return 0;
+}
+
+static void
+_entry_clear(netsnmp_proc_entry *entry)
+{
+    SNMP_FREE(entry->cmdline);
+    entry->cmdline_len = 0;
+    SNMP_FREE(entry->sockets);
+    entry->nsockets = 0;
+    entry->parts = 0;
+}
+
+static void
+_entry_free(netsnmp_proc_entry *entry)
+{
+    _entry_clear(entry);
+    _close_dir(entry);
+}
+
+/*
+ * reads a file of the process into read_buf, and terminates it
+ */
+static int
+_read(netsnmp_proc_entry *entry, const char *file)
+{
+    int             fd, len;
+
+    fd = openat(entry->dirfd, file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    len = pread(fd, read_buf, PROC_READ_MAX - 1, 0);
+    close(fd);
+    if (len >= 0)
+        read_buf[len] = '\0';
+    return len;
+}
+
+static char *
+_skip_fields(char *cp, int n)
+{
+    while (cp && n--) {
+        cp = strchr(cp, ' ');
+        if (cp)
+            cp++;
+    }
+    return cp;
+}
+
+/*
+ *   PID (NAME) STATE  {xxx}*10  UTIME STIME  {xxx}*8 RSS
+ */
+static int
+_read_stat(netsnmp_proc_entry *entry)
+{
+    char           *name, *cp;
+    size_t          len;
+
+    if (_read(entry, "stat") <= 0)
+        return -1;
+
+    /* The name may contain spaces and brackets: it ends at the last ')'.*/
+    name = strchr(read_buf, '(');
+    cp = strrchr(read_buf, ')');
+    if (NULL == name || NULL == cp || cp < name || cp[1] != ' ')
+        return -1;
+    len = cp - ++name;
+    if (len >= sizeof(entry->name))
+        len = sizeof(entry->name) - 1;
+    memcpy(entry->name, name, len);
+    entry->name[len] = '\0';
+
+    cp += 2;
+    entry->state = *cp;
+    cp = _skip_fields(cp, 11);          /* Skip STATE + 10 fields */
+    if (NULL == cp)
+        return -1;
+    entry->cpu = strtoull(cp, &cp, 10);         /*  utime */
+    entry->cpu += strtoull(cp, &cp, 10);        /* +stime */
+    cp = _skip_fields(cp + 1, 8);
+    if (NULL == cp)
+        return -1;
+    entry->rss = strtoul(cp, NULL, 10);
+    entry->parts |= NETSNMP_PROC_STAT;
+    return 0;
+}
+
+static int
+_read_cmdline(netsnmp_proc_entry *entry)
+{
+    int             len;
+
+    len = _read(entry, "cmdline");
+    if (len < 0)
+        return -1;
+    SNMP_FREE(entry->cmdline);
+    entry->cmdline_len = 0;
+    if (len > 0) {
+        /* Keep the '\0' _read added, so that argv[0] is always ended.*/
+        entry->cmdline = (char *) malloc(len + 1);
+        if (NULL == entry->cmdline)
+            return -1;
+        memcpy(entry->cmdline, read_buf, len + 1);
+        entry->cmdline_len = len;
+    }
+    entry->parts |= NETSNMP_PROC_CMDLINE;
+    return 0;
+}
+
+static int
+_read_sockets(netsnmp_proc_entry *entry)
+{
+    DIR            *dir;
+    struct dirent  *fdinfo;
+    char            socket_lnk[NAME_MAX + 1];
+    ino64_t         inode, *sockets;
+    size_t          length = 0;
+    int             fd, len;
+
+    SNMP_FREE(entry->sockets);
+    entry->nsockets = 0;
+
+    fd = openat(entry->dirfd, "fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno != EACCES && errno != EPERM)
+            return -1;
+        /* another user's process: its sockets can't be found */
+        entry->parts |= NETSNMP_PROC_SOCKETS;
+        return 0;
+    }
+    dir = fdopendir(fd);
+    if (NULL == dir) {
+        close(fd);
+        return -1;
+    }
+
+    /* The file descriptors are symbolic links to sockets or files.*/
+    while ((fdinfo = readdir(dir)) != NULL) {
+        if (!isdigit((unsigned char) fdinfo->d_name[0]))
+            continue;
+        len = readlinkat(fd, fdinfo->d_name, socket_lnk,
+                         sizeof(socket_lnk) - 1);
+        if (len < 0)
+            continue;
+        socket_lnk[len] = '\0';
+
+        if (!strncmp(socket_lnk, SOCKET_TYPE_1, 8))
+            inode = strtoull(socket_lnk + 8, NULL, 0);
+        else if (!strncmp(socket_lnk, SOCKET_TYPE_2, 7))
+            inode = strtoull(socket_lnk + 7, NULL, 0);
+        else
+            continue;
+        if (inode == 0)
+            continue;
+
+        if (entry->nsockets == length) {
+            length = length ? 2 * length : 8;
+            sockets = (ino64_t *) realloc(entry->sockets,
+                                          length * sizeof(ino64_t));
+            if (NULL == sockets)
+                break;
+            entry->sockets = sockets;
+        }
+        entry->sockets[entry->nsockets++] = inode;
+    }
+    closedir(dir);
+    entry->parts |= NETSNMP_PROC_SOCKETS;
+    return 0;
+}
+
+/*
+ * reads the parts of a process that haven't been read yet
+ *
+ * @retval  0: success
+ * @retval -1: the process has gone
+ */
+static int
+_read_parts(netsnmp_proc_entry *entry, u_int parts)
+{
+    int             opened = 0, rc;
+
+    parts &= ~entry->parts;
+    if (!parts)
+        return 0;
+    if (entry->dirfd < 0) {
+        if (_open_dir(entry) < 0)
+            return -1;
+        opened = 1;
+    }
+
+    for (;;) {
+        rc = 0;
+        if (parts & NETSNMP_PROC_STAT)
+            rc = _read_stat(entry);
+        if (rc == 0 && (parts & NETSNMP_PROC_CMDLINE))
+            rc = _read_cmdline(entry);
+        if (rc == 0 && (parts & NETSNMP_PROC_SOCKETS))
+            rc = _read_sockets(entry);
+        if (rc == 0 || opened)
+            break;
+
+        /*
+         * The process the directory was kept open for has gone, but its
+         * pid may have been used again: read all of the new process.
+         */
+        parts |= entry->parts;
+        _entry_free(entry);
+        if (_open_dir(entry) < 0)
+            return -1;
+        opened = 1;
+    }
+
+    if (dirfds_open > dirfds_max)
+        _close_dir(entry);
+    return rc;
+}
+
+static int
+_compare_pids(const void *a, const void *b)
+{
+    const netsnmp_proc_entry *ea = (const netsnmp_proc_entry *) a;
+    const netsnmp_proc_entry *eb = (const netsnmp_proc_entry *) b;
+
+    return (ea->pid > eb->pid) - (ea->pid < eb->pid);
+}
+
+static int
+_scan(u_int parts)
+{
+    netsnmp_proc_entry *old = snapshot.entries, *entries = NULL, *entry;
+    netsnmp_proc_entry  key, *found;
+    size_t          old_count = snapshot.count, count = 0, i;
+    struct dirent  *procinfo;
+    const char     *name;
+    int             sorted = 1;
+
+    if (NULL == proc_dir) {
+        proc_dir = opendir(PROC_PATH);
+        if (NULL == proc_dir) {
+            NETSNMP_LOGONCE((LOG_ERR, "snmpd: cannot open /proc\n"));
+            return -1;
+        }
+    } else
+        rewinddir(proc_dir);
+
+    /* Fill a new array, taking the open directories from the old one.*/
+    snapshot_length = 0;
+    while ((procinfo = readdir(proc_dir)) != NULL) {
+        /* A pid directory only contains digits, check for those.*/
+        for (name = procinfo->d_name; isdigit((unsigned char) *name);
+             name++)
+            ;
+        if (*name || name == procinfo->d_name)
+            continue;
+
+        if (count == snapshot_length) {
+            size_t      length = snapshot_length ? 2 * snapshot_length : 256;
+
+            entry = (netsnmp_proc_entry *)
+                realloc(entries, length * sizeof(netsnmp_proc_entry));
+            if (NULL == entry)
+                break;
+            entries = entry;
+            snapshot_length = length;
+        }
+        entry = &entries[count];
+        memset(entry, 0, sizeof(*entry));
+        entry->pid = atoi(procinfo->d_name);
+        entry->dirfd = -1;
+
+        key.pid = entry->pid;
+        found = (netsnmp_proc_entry *)
+            bsearch(&key, old, old_count, sizeof(netsnmp_proc_entry),
+                    _compare_pids);
+        if (found) {
+            entry->dirfd = found->dirfd;
+            found->dirfd = -1;
+        }
+        if (_read_parts(entry, parts) < 0) {
+            _entry_free(entry);
+            continue;   /* the process went away */
+        }
+        if (count && entry->pid < entries[count - 1].pid)
+            sorted = 0;
+        count++;
+    }
+
+    for (i = 0; i < old_count; i++)
+        _entry_free(&old[i]);
+    free(old);
+
+    if (!sorted)
+        qsort(entries, count, sizeof(netsnmp_proc_entry), _compare_pids);
+    snapshot.entries = entries;
+    snapshot.count = count;
+    snapshot.parts = parts;
+    netsnmp_get_monotonic_clock(&snapshot_taken);
+
+    DEBUGMSGTL(("proc_snapshot", "%" NETSNMP_PRIz "d processes, %d kept open\n",
+                count, dirfds_open));
+    return 0;
+}
+
+netsnmp_proc_snapshot *
+netsnmp_proc_snapshot_get(u_int parts)
+{
+    struct timeval  now;
+    struct rlimit   rl;
+    size_t          i, count;
+
+    if (dirfds_max < 0) {
+        dirfds_max = PROC_DIRFDS_MAX;
+        if (getrlimit(RLIMIT_NOFILE, &rl) == 0 &&
+            rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur / 4 < dirfds_max)
+            dirfds_max = rl.rlim_cur / 4;
+    }
+    if (NULL == read_buf) {
+        read_buf = (char *) malloc(PROC_READ_MAX);
+        if (NULL == read_buf) {
+            snmp_log(LOG_ERR, "malloc error in netsnmp_proc_snapshot_get\n");
+            return NULL;
+        }
+    }
+
+    netsnmp_get_monotonic_clock(&now);
+    if (snapshot_taken.tv_sec == 0 ||
+        now.tv_sec - snapshot_taken.tv_sec >= PROC_SNAPSHOT_MAX_AGE) {
+        DEBUGMSGTL(("proc_snapshot", "scanning /proc for 0x%x\n", parts));
+        if (_scan(parts) < 0)
+            return NULL;
+    } else if ((snapshot.parts & parts) != parts) {
+        DEBUGMSGTL(("proc_snapshot", "reading 0x%x\n",
+                    parts & ~snapshot.parts));
+        for (i = count = 0; i < snapshot.count; i++) {
+            if (_read_parts(&snapshot.entries[i], parts) < 0) {
+                _entry_free(&snapshot.entries[i]);
+                continue;
+            }
+            snapshot.entries[count++] = snapshot.entries[i];
+        }
+        snapshot.count = count;
+        snapshot.parts |= parts;
+    }
+    return &snapshot;
+}
+
+void
+netsnmp_proc_snapshot_expire(void)
+{
+    snapshot_taken.tv_sec = 0;
+}
+
+void
+shutdown_proc_snapshot(void)
+{
+    size_t          i;
+
+    for (i = 0; i < snapshot.count; i++)
+        _entry_free(&snapshot.entries[i]);
+    SNMP_FREE(snapshot.entries);
+    snapshot.count = 0;
+    snapshot.parts = 0;
+    snapshot_length = 0;
+    snapshot_taken.tv_sec = 0;
+    if (proc_dir) {
+        closedir(proc_dir);
+        proc_dir = NULL;
+    }
+    SNMP_FREE(read_buf);
+}
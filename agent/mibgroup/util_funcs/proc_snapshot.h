@@ -0,0 +1,64 @@
+/*
+ * util_funcs/proc_snapshot.h:  one scan of the processes in /proc on
+ * linux, shared by the tables that need to look at every process.
+ */
+#ifndef NETSNMP_MIBGROUP_UTIL_FUNCS_PROC_SNAPSHOT_H
+#define NETSNMP_MIBGROUP_UTIL_FUNCS_PROC_SNAPSHOT_H
+
+#ifndef linux
+config_error(proc_snapshot is only supported on linux)
+#endif
+
+#define _LARGEFILE64_SOURCE 1
+
+#include <sys/types.h>
+
+/*
+ * the parts of /proc/<pid> a consumer can ask for
+ */
+#define NETSNMP_PROC_STAT       0x01    /* name, state, cpu and rss */
+#define NETSNMP_PROC_CMDLINE    0x02    /* argv[0] '\0' argv[1] '\0' ... */
+#define NETSNMP_PROC_SOCKETS    0x04    /* inodes of the sockets in fd/ */
+
+typedef struct netsnmp_proc_entry_s {
+    pid_t               pid;
+    int                 dirfd;          /* /proc/<pid>, or -1 */
+    u_int               parts;          /* the parts read */
+
+    /* NETSNMP_PROC_STAT */
+    char                name[64 + 1];
+    char                state;          /* R, S, D, Z, T ... */
+    unsigned long long  cpu;            /* utime + stime, in clock ticks */
+    unsigned long       rss;            /* in pages */
+
+    /* NETSNMP_PROC_CMDLINE: NULL and 0 for a kernel thread */
+    char               *cmdline;
+    size_t              cmdline_len;
+
+    /* NETSNMP_PROC_SOCKETS */
+    ino64_t            *sockets;
+    size_t              nsockets;
+} netsnmp_proc_entry;
+
+typedef struct netsnmp_proc_snapshot_s {
+    netsnmp_proc_entry *entries;        /* sorted by pid */
+    size_t              count;
+    u_int               parts;          /* the parts read for every entry */
+} netsnmp_proc_snapshot;
+
+/*
+ * returns the processes, with at least the parts asked for read for
+ * each. The snapshot is only valid until the next call.
+ *
+ * @retval NULL: /proc can't be read
+ */
+netsnmp_proc_snapshot *netsnmp_proc_snapshot_get(u_int parts);
+
+/*
+ * makes the next netsnmp_proc_snapshot_get() scan /proc again
+ */
+void netsnmp_proc_snapshot_expire(void);
+
+void shutdown_proc_snapshot(void);
+
+#endif /* NETSNMP_MIBGROUP_UTIL_FUNCS_PROC_SNAPSHOT_H */
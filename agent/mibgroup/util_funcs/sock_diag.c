@@ -0,0 +1,139 @@
+/*
+ * util_funcs/sock_diag.c:  dump the kernel's socket tables over a
+ * NETLINK_SOCK_DIAG socket on linux. Unlike /proc/net/{tcp,udp}{,6}, the
+ * records are binary, and the kernel only sends the sockets in the
+ * states that are asked for.
+ */
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+
+#include "sock_diag.h"
+
+#include <errno.h>
+#if HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/socket.h>
+
+void
+init_sock_diag(void)
+{
+    char *app = netsnmp_ds_get_string(NETSNMP_DS_LIBRARY_ID,
+                                      NETSNMP_DS_LIB_APPTYPE);
+
+    netsnmp_ds_register_config(ASN_BOOLEAN, app, "sock_diag_disable",
+                               NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_NO_SOCK_DIAG);
+}
+
+#if HAVE_LINUX_SOCK_DIAG_H
+
+/* bigger than the largest message the kernel sends for a dump */
+#define SOCK_DIAG_BUF_SIZE 65536
+
+static char    *sock_diag_buf = NULL;
+
+int
+netsnmp_sock_diag_dump(u_char family, u_char protocol, u_int states,
+                       netsnmp_sock_diag_callback *callback, void *context)
+{
+    static u_int    seq = 0;
+    struct {
+        struct nlmsghdr         nlh;
+        struct inet_diag_req_v2 req;
+    }               request;
+    struct sockaddr_nl sa;
+    struct nlmsghdr *h;
+    int             fd, len, rc = 0, done = 0;
+
+    if (netsnmp_ds_get_boolean(NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_NO_SOCK_DIAG))
+        return -2;
+
+    if (NULL == sock_diag_buf) {
+        sock_diag_buf = (char *) malloc(SOCK_DIAG_BUF_SIZE);
+        if (NULL == sock_diag_buf) {
+            snmp_log(LOG_ERR, "malloc error in netsnmp_sock_diag_dump\n");
+            return -1;
+        }
+    }
+
+    fd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_SOCK_DIAG);
+    if (fd < 0) {
+        DEBUGMSGTL(("sock_diag", "no sock_diag socket: %s\n",
+                    strerror(errno)));
+        return -2;
+    }
+
+    memset(&request, 0, sizeof(request));
+    request.nlh.nlmsg_len = sizeof(request);
+    request.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+    request.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.nlh.nlmsg_seq = ++seq;
+    request.req.sdiag_family = family;
+    request.req.sdiag_protocol = protocol;
+    request.req.idiag_states = states;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    if (sendto(fd, &request, sizeof(request), 0, (struct sockaddr *) &sa,
+               sizeof(sa)) < 0) {
+        DEBUGMSGTL(("sock_diag", "sendto: %s\n", strerror(errno)));
+        close(fd);
+        return -2;
+    }
+
+    while (!done) {
+        len = recv(fd, sock_diag_buf, SOCK_DIAG_BUF_SIZE, 0);
+        if (len < 0 && EINTR == errno)
+            continue;
+        if (len <= 0) {
+            snmp_log(LOG_ERR, "sock_diag: recv: %s\n",
+                     len ? strerror(errno) : "end of file");
+            rc = -1;
+            break;
+        }
+
+        for (h = (struct nlmsghdr *) sock_diag_buf; NLMSG_OK(h, len);
+             h = NLMSG_NEXT(h, len)) {
+            if (h->nlmsg_seq != seq)
+                continue;
+            if (NLMSG_DONE == h->nlmsg_type) {
+                done = 1;
+                break;
+            }
+            if (NLMSG_ERROR == h->nlmsg_type) {
+                /*
+                 * the kernel has no sock_diag support for this family or
+                 * protocol (e.g. udp_diag isn't loaded)
+                 */
+                struct nlmsgerr *err = (struct nlmsgerr *) NLMSG_DATA(h);
+                DEBUGMSGTL(("sock_diag", "family %d protocol %d: %s\n",
+                            family, protocol, strerror(-err->error)));
+                rc = -2;
+                done = 1;
+                break;
+            }
+            if ((SOCK_DIAG_BY_FAMILY != h->nlmsg_type) ||
+                (h->nlmsg_len < NLMSG_LENGTH(sizeof(struct inet_diag_msg))))
+                continue;
+            rc = (*callback)((const struct inet_diag_msg *) NLMSG_DATA(h),
+                             context);
+            if (rc < 0) {
+                done = 1;
+                break;
+            }
+            rc = 0;
+        }
+    }
+
+    close(fd);
+    return rc;
+}
+#endif /* HAVE_LINUX_SOCK_DIAG_H */
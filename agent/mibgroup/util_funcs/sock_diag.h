@@ -0,0 +1,41 @@
+/*
+ * util_funcs/sock_diag.h:  utility function to dump the kernel's socket
+ * tables over a NETLINK_SOCK_DIAG socket on linux.
+ */
+#ifndef NETSNMP_MIBGROUP_UTIL_FUNCS_SOCK_DIAG_H
+#define NETSNMP_MIBGROUP_UTIL_FUNCS_SOCK_DIAG_H
+
+#ifndef linux
+config_error(sock_diag is only supported on linux)
+#endif
+
+#if HAVE_LINUX_SOCK_DIAG_H
+#include <linux/netlink.h>
+#include <linux/sock_diag.h>
+#include <linux/inet_diag.h>
+
+/*
+ * called for each socket in the dump. A negative return stops the dump,
+ * and is returned by netsnmp_sock_diag_dump().
+ */
+typedef int (netsnmp_sock_diag_callback)(const struct inet_diag_msg *msg,
+                                         void *context);
+
+/*
+ * dump the sockets of a family (AF_INET or AF_INET6) and protocol
+ * (IPPROTO_TCP or IPPROTO_UDP) whose state is in the states bitmask
+ * (1 << TCP_LISTEN etc.)
+ *
+ * @retval  0: success
+ * @retval -1: error
+ * @retval -2: sock_diag is disabled, or the kernel can't dump these
+ *             sockets; read /proc/net instead.
+ */
+int netsnmp_sock_diag_dump(u_char family, u_char protocol, u_int states,
+                           netsnmp_sock_diag_callback *callback,
+                           void *context);
+#endif /* HAVE_LINUX_SOCK_DIAG_H */
+
+void init_sock_diag(void);
+
+#endif /* NETSNMP_MIBGROUP_UTIL_FUNCS_SOCK_DIAG_H */
@@ -28,11 +28,13 @@
 #if HAVE_SYS_SELECT_H
 #include <sys/select.h>
 #endif
+#include <signal.h>
 
 #include <errno.h>
 
 #include <net-snmp/net-snmp-includes.h>
 #include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/library/large_fd_set.h>
 #include <ucd-snmp/errormib.h>
 
 #include <net-snmp/agent/netsnmp_close_fds.h>
@@ -411,3 +413,480 @@ run_exec_command( char *command, char *input,
     return run_shell_command( command, input, output, out_len );
 #endif
 }
+
+
+#if HAVE_EXECV
+/*
+ * Commands run in the background.  The output is read as it arrives,
+ * from the agent's fd event loop, and the callback gets the result and
+ * the output once the command has exited (or has been killed for
+ * overrunning its timeout).  Commands beyond what the fd event loop
+ * can watch at once wait in a queue for a running one to finish.
+ */
+struct netsnmp_run_job_s {
+    char           *command;
+    char           *input;
+    size_t          in_len;
+    size_t          in_off;
+    int             in_fd;
+    int             writing;
+    int             shell;
+    pid_t           pid;
+    int             fd;
+    char           *output;
+    int             out_len;
+    int             out_max;
+    unsigned int    timer;
+    unsigned int    reaper;
+    netsnmp_run_callback *callback;
+    void           *magic;
+    struct netsnmp_run_job_s *next;
+};
+
+/* leave some of the fd event loop's slots for everyone else */
+#define RUN_ASYNC_FD_RESERVE    4
+
+static netsnmp_run_job *_run_jobs;        /* running */
+static netsnmp_run_job *_run_queue;       /* waiting for an fd slot */
+
+static void _run_job_start_queued(void);
+
+static void
+_run_job_unlink(netsnmp_run_job **list, netsnmp_run_job *job)
+{
+    for (; *list; list = &(*list)->next)
+        if (*list == job) {
+            *list = job->next;
+            break;
+        }
+}
+
+static void
+_run_job_free(netsnmp_run_job *job)
+{
+    if (job->timer)
+        snmp_alarm_unregister(job->timer);
+    if (job->reaper)
+        snmp_alarm_unregister(job->reaper);
+    SNMP_FREE(job->command);
+    SNMP_FREE(job->input);
+    SNMP_FREE(job->output);
+    free(job);
+}
+
+static void
+_run_job_close_input(netsnmp_run_job *job)
+{
+    if (job->in_fd >= 0) {
+        if (job->writing)
+            unregister_writefd(job->in_fd);
+        job->writing = 0;
+        close(job->in_fd);
+        job->in_fd = -1;
+    }
+}
+
+static void
+_run_job_close(netsnmp_run_job *job)
+{
+    _run_job_close_input(job);
+    if (job->fd >= 0) {
+        unregister_readfd(job->fd);
+        close(job->fd);
+        job->fd = -1;
+    }
+}
+
+/*
+ * hand the result over, and let a queued command have the fd slot
+ */
+static void
+_run_job_done(netsnmp_run_job *job, int result)
+{
+    DEBUGMSGTL(("run:async", "  child %d finished. result=%d\n",
+                (int)job->pid, result));
+    _run_job_unlink(&_run_jobs, job);
+    _run_job_unlink(&_run_queue, job);
+    if (job->output)
+        job->output[job->out_len] = 0;
+    (*job->callback)(result, result < 0 ? NULL : job->output,
+                     result < 0 ? 0 : job->out_len, job->magic);
+    _run_job_free(job);
+    _run_job_start_queued();
+}
+
+static int
+_run_job_reap(netsnmp_run_job *job, int options)
+{
+    int             status, rc;
+
+    rc = waitpid(job->pid, &status, options);
+    if (rc == 0)
+        return 0;
+    if (rc < 0) {
+        snmp_log_perror("waitpid");
+        _run_job_done(job, -1);
+    } else
+        _run_job_done(job, job->shell ? status : WEXITSTATUS(status));
+    return 1;
+}
+
+static void
+_run_job_reaper(unsigned int clientreg, void *clientarg)
+{
+    _run_job_reap((netsnmp_run_job *) clientarg, WNOHANG);
+}
+
+/*
+ * Write as much of the input as the child's pipe takes; the rest is
+ * written when it becomes writable again.  A command that exits without
+ * reading it still gets its output read.
+ */
+static void
+_run_job_writable(int fd, void *data)
+{
+    netsnmp_run_job *job = (netsnmp_run_job *) data;
+    ssize_t         n;
+
+    while (job->in_off < job->in_len) {
+        n = write(fd, job->input + job->in_off, job->in_len - job->in_off);
+        if (n >= 0) {
+            job->in_off += n;
+            continue;
+        }
+        if (errno == EINTR)
+            continue;
+        if (errno == EAGAIN) {
+            if (!job->writing)
+                job->writing = register_writefd(fd, _run_job_writable,
+                                                job) == FD_REGISTERED_OK;
+            if (job->writing)
+                return;
+            snmp_log(LOG_WARNING, "can't wait to write the rest of the "
+                     "input of '%s'\n", job->command);
+        } else if (errno == EPIPE)
+            DEBUGMSGTL(("run:async", "'%s' didn't read its input\n",
+                        job->command));
+        else
+            snmp_log(LOG_WARNING, "couldn't write the input of '%s': %s\n",
+                     job->command, strerror(errno));
+        break;
+    }
+    _run_job_close_input(job);
+}
+
+static void
+_run_job_readable(int fd, void *data)
+{
+    static const struct timeval reap_interval = { 0, 10000 };
+    netsnmp_run_job *job = (netsnmp_run_job *) data;
+    char            discard[1024];
+    ssize_t         count;
+
+    for (;;) {
+        if (!job->output) {
+            /* output not wanted: read it all, and throw it away */
+            count = read(fd, discard, sizeof(discard));
+            if (count > 0)
+                continue;
+        } else
+            count = read(fd, job->output + job->out_len,
+                         job->out_max - 1 - job->out_len);
+        if (count > 0) {
+            job->out_len += count;
+            if (job->out_len < job->out_max - 1)
+                continue;
+            DEBUGMSGTL(("verbose:run:async", "      output full\n"));
+        } else if (count < 0 && (errno == EAGAIN || errno == EINTR))
+            return;
+        else if (count < 0)
+            snmp_log_perror("read");
+        break;
+    }
+
+    /*
+     * end of the output: the child has exited, or is about to
+     */
+    _run_job_close(job);
+    if (!_run_job_reap(job, WNOHANG))
+        job->reaper = snmp_alarm_register_hr(reap_interval, SA_REPEAT,
+                                             _run_job_reaper, job);
+}
+
+static void
+_run_job_timeout(unsigned int clientreg, void *clientarg)
+{
+    netsnmp_run_job *job = (netsnmp_run_job *) clientarg;
+
+    job->timer = 0;
+    if (job->pid <= 0) {
+        snmp_log(LOG_WARNING, "'%s' not started within its timeout\n",
+                 job->command);
+        _run_job_done(job, -1);
+        return;
+    }
+    snmp_log(LOG_WARNING, "'%s' timed out, killing process %d\n",
+             job->command, (int)job->pid);
+    _run_job_close(job);
+    kill(job->pid, SIGKILL);
+    if (waitpid(job->pid, NULL, 0) < 0)
+        snmp_log_perror("waitpid");
+    _run_job_done(job, -1);
+}
+
+static int
+_run_job_fork(netsnmp_run_job *job)
+{
+    int             ipipe[2], opipe[2];
+    char          **argv;
+    int             argc;
+
+    DEBUGMSGTL(("run:async", "running '%s'\n", job->command));
+    if (pipe(ipipe) < 0)
+        return -1;
+    if (pipe(opipe) < 0) {
+        close(ipipe[0]);
+        close(ipipe[1]);
+        return -1;
+    }
+    if ((job->pid = fork()) == 0) {
+        /*
+         * Child process: set stdin/out (and err, for exec) to use the
+         *   pipes, and close everything else
+         */
+        close(0);
+        dup(  ipipe[0]);
+        close(ipipe[0]);
+        close(ipipe[1]);
+
+        close(1);
+        dup(  opipe[1]);
+        close(opipe[0]);
+        close(opipe[1]);
+
+        if (!job->shell) {
+            close(2);
+            dup(1);
+        }
+
+        netsnmp_close_fds(2);
+
+        if (job->shell) {
+            execl("/bin/sh", "sh", "-c", job->command, (char *) NULL);
+            perror("/bin/sh");
+        } else {
+            argv = tokenize_exec_command( job->command, &argc );
+            execv( argv[0], argv );
+            perror( argv[0] );
+        }
+        exit(1);	/* End of child */
+    }
+
+    close(ipipe[0]);
+    close(opipe[1]);
+    if (job->pid < 0) {
+        snmp_log_perror("fork");
+        close(ipipe[1]);
+        close(opipe[0]);
+        return -1;
+    }
+
+    job->fd = opipe[0];
+    fcntl(job->fd, F_SETFL, fcntl(job->fd, F_GETFL) | O_NONBLOCK);
+    if (register_readfd(job->fd, _run_job_readable, job) != FD_REGISTERED_OK) {
+        close(job->fd);
+        job->fd = -1;
+        kill(job->pid, SIGKILL);
+        waitpid(job->pid, NULL, 0);
+        job->pid = 0;
+        close(ipipe[1]);
+        return -1;
+    }
+    job->next = _run_jobs;
+    _run_jobs = job;
+
+    /*
+     * the output is read as the input is written, so that a command
+     * that writes before it has read all of its input can't block us
+     */
+    job->in_fd = ipipe[1];
+    fcntl(job->in_fd, F_SETFL, fcntl(job->in_fd, F_GETFL) | O_NONBLOCK);
+    _run_job_writable(job->in_fd, job);
+    return 0;
+}
+
+static void
+_run_job_start_queued(void)
+{
+    netsnmp_run_job *job;
+
+    while (_run_queue &&
+           external_readfdlen < NUM_EXTERNAL_FDS - RUN_ASYNC_FD_RESERVE) {
+        job = _run_queue;
+        _run_queue = job->next;
+        if (_run_job_fork(job) < 0)
+            _run_job_done(job, -1);
+    }
+}
+#endif /* HAVE_EXECV */
+
+/*
+ * Run a command (through /bin/sh if 'shell' is set) without waiting
+ * for it.  When it finishes, 'callback' is called with the result as
+ * run_shell_command or run_exec_command would return it, and with up
+ * to out_max - 1 bytes of its output (none, and the output is read and
+ * discarded, if out_max is 0); a command still running after
+ * 'timeout' seconds is killed and gets a result of -1.
+ *
+ * Returns NULL if the command can't be run in the background, and the
+ * caller should fall back to running it synchronously.
+ */
+netsnmp_run_job *
+run_command_async(char *command, char *input, int shell, int out_max,
+                  int timeout, netsnmp_run_callback *callback, void *magic)
+{
+#if HAVE_EXECV
+    netsnmp_run_job *job, **qp;
+
+    if (!command || !callback || out_max < 0 || timeout < 1)
+        return NULL;
+    /*
+     * no free fd slot, and nothing of ours to give one up either
+     */
+    if (external_readfdlen >= NUM_EXTERNAL_FDS - RUN_ASYNC_FD_RESERVE &&
+        !_run_jobs)
+        return NULL;
+
+    job = SNMP_MALLOC_TYPEDEF(netsnmp_run_job);
+    if (!job)
+        return NULL;
+    job->command = strdup(command);
+    job->input = input ? strdup(input) : NULL;
+    job->in_len = input ? strlen(input) : 0;
+    job->output = out_max ? (char *) malloc(out_max) : NULL;
+    if (!job->command || (input && !job->input) ||
+        (out_max && !job->output)) {
+        _run_job_free(job);
+        return NULL;
+    }
+    job->shell = shell;
+    job->in_fd = -1;
+    job->fd = -1;
+    job->out_max = out_max;
+    job->callback = callback;
+    job->magic = magic;
+
+    if (external_readfdlen >= NUM_EXTERNAL_FDS - RUN_ASYNC_FD_RESERVE) {
+        DEBUGMSGTL(("run:async", "queueing '%s'\n", command));
+        for (qp = &_run_queue; *qp; qp = &(*qp)->next)
+            ;
+        *qp = job;
+    } else if (_run_job_fork(job) < 0) {
+        _run_job_free(job);
+        return NULL;
+    }
+    job->timer = snmp_alarm_register(timeout, 0, _run_job_timeout, job);
+    return job;
+#else
+    return NULL;
+#endif
+}
+
+/*
+ * Wait for the commands started by run_command_async to finish (or to
+ * be killed at their timeout), calling their callbacks, for when the
+ * event loop that would otherwise do that isn't running any more.
+ */
+void
+run_command_async_wait(void)
+{
+#if HAVE_EXECV
+    netsnmp_run_job *job;
+    struct timeval  timeout, *tvp;
+    netsnmp_large_fd_set readfds, writefds;
+    int             numfds, count;
+
+    /* the pipes may be above FD_SETSIZE */
+    netsnmp_large_fd_set_init(&readfds, FD_SETSIZE);
+    netsnmp_large_fd_set_init(&writefds, FD_SETSIZE);
+    while (_run_jobs || _run_queue) {
+        if (!_run_jobs) {
+            _run_job_start_queued();
+            if (!_run_jobs) {
+                /* no fd slot will be given up while we wait here */
+                while ((job = _run_queue) != NULL)
+                    _run_job_done(job, -1);
+                break;
+            }
+        }
+        NETSNMP_LARGE_FD_ZERO(&readfds);
+        NETSNMP_LARGE_FD_ZERO(&writefds);
+        numfds = 0;
+        for (job = _run_jobs; job; job = job->next) {
+            if (job->fd >= 0) {
+                NETSNMP_LARGE_FD_SET(job->fd, &readfds);
+                if (job->fd >= numfds)
+                    numfds = job->fd + 1;
+            }
+            if (job->in_fd >= 0) {
+                NETSNMP_LARGE_FD_SET(job->in_fd, &writefds);
+                if (job->in_fd >= numfds)
+                    numfds = job->in_fd + 1;
+            }
+        }
+        tvp = get_next_alarm_delay_time(&timeout) ? &timeout : NULL;
+        count = netsnmp_large_fd_set_select(numfds, &readfds, &writefds,
+                                            NULL, tvp);
+        if (count < 0 && errno != EINTR) {
+            snmp_log_perror("select");
+            break;
+        }
+        /* a callback may change the list, so look again after each */
+        while (count > 0) {
+            for (job = _run_jobs; job; job = job->next)
+                if ((job->in_fd >= 0 &&
+                     NETSNMP_LARGE_FD_ISSET(job->in_fd, &writefds)) ||
+                    (job->fd >= 0 &&
+                     NETSNMP_LARGE_FD_ISSET(job->fd, &readfds)))
+                    break;
+            if (!job)
+                break;
+            if (job->in_fd >= 0 &&
+                NETSNMP_LARGE_FD_ISSET(job->in_fd, &writefds)) {
+                NETSNMP_LARGE_FD_CLR(job->in_fd, &writefds);
+                _run_job_writable(job->in_fd, job);
+            } else {
+                NETSNMP_LARGE_FD_CLR(job->fd, &readfds);
+                _run_job_readable(job->fd, job);
+            }
+            count--;
+        }
+        run_alarms();
+    }
+    netsnmp_large_fd_set_cleanup(&readfds);
+    netsnmp_large_fd_set_cleanup(&writefds);
+#endif
+}
+
+/*
+ * Stop a command started by run_command_async; its callback won't be
+ * called.
+ */
+void
+run_command_async_cancel(netsnmp_run_job *job)
+{
+#if HAVE_EXECV
+    if (!job)
+        return;
+    DEBUGMSGTL(("run:async", "cancelling '%s'\n", job->command));
+    _run_job_unlink(&_run_jobs, job);
+    _run_job_unlink(&_run_queue, job);
+    _run_job_close(job);
+    if (job->pid > 0) {
+        kill(job->pid, SIGKILL);
+        waitpid(job->pid, NULL, 0);
+    }
+    _run_job_free(job);
+    _run_job_start_queued();
+#endif
+}
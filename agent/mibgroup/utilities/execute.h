@@ -8,4 +8,14 @@ int run_shell_command(char *command, char *input,
 int run_exec_command( char *command, char *input,
                       char *output,  int  *out_len);
 
+typedef struct netsnmp_run_job_s netsnmp_run_job;
+typedef void (netsnmp_run_callback)(int result, char *output, int out_len,
+                                    void *magic);
+netsnmp_run_job *run_command_async(char *command, char *input, int shell,
+                                   int out_max, int timeout,
+                                   netsnmp_run_callback *callback,
+                                   void *magic);
+void run_command_async_cancel(netsnmp_run_job *job);
+void run_command_async_wait(void);
+
 #endif /* _MIBGROUP_EXECUTE_H */
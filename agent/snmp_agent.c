@@ -97,6 +97,7 @@ int             deny_severity = LOG_WARNING;
 #include "snmpd.h"
 #include <net-snmp/agent/mib_module_config.h>
 #include <net-snmp/agent/mib_modules.h>
+#include <net-snmp/agent/agent_workers.h>
 
 #ifdef USING_AGENTX_PROTOCOL_MODULE
 #include "agentx/protocol.h"
@@ -775,6 +776,7 @@ agent_check_and_process(int block)
     struct timeval       timeout = { LONG_MAX, 0 }, *tvp = &timeout;
     int                  count;
     int                  fakeblock = 0;
+    int                  use_epoll = 0;
 
     numfds = 0;
     netsnmp_large_fd_set_init(&readfds, FD_SETSIZE);
@@ -783,7 +785,14 @@ agent_check_and_process(int block)
     NETSNMP_LARGE_FD_ZERO(&readfds);
     NETSNMP_LARGE_FD_ZERO(&writefds);
     NETSNMP_LARGE_FD_ZERO(&exceptfds);
-    snmp_select_info2(&numfds, &readfds, tvp, &fakeblock);
+#ifdef NETSNMP_USE_EPOLL
+    /*
+     * The session sockets and external fds are already in the epoll set,
+     * so only the timeout has to be computed.
+     */
+    use_epoll = netsnmp_epoll_active();
+#endif
+    snmp_select_info2(&numfds, use_epoll ? NULL : &readfds, tvp, &fakeblock);
     if (block != 0 && fakeblock != 0) {
         /*
          * There are no alarms registered, and the caller asked for blocking, so
@@ -806,21 +815,33 @@ agent_check_and_process(int block)
         timerclear(tvp);
     }
 
+#ifdef NETSNMP_USE_EPOLL
+    if (use_epoll)
+        count = netsnmp_epoll_dispatch(tvp);
+    else
+#endif
+    {
 #ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
-    netsnmp_external_event_info2(&numfds, &readfds, &writefds, &exceptfds);
+        netsnmp_external_event_info2(&numfds, &readfds, &writefds, &exceptfds);
 #endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
 
-    count = netsnmp_large_fd_set_select(numfds, &readfds, &writefds, &exceptfds, tvp);
+        count = netsnmp_large_fd_set_select(numfds, &readfds, &writefds,
+                                            &exceptfds, tvp);
+    }
 
     if (count > 0) {
         /*
-         * packets found, process them 
+         * packets found, process them (netsnmp_epoll_dispatch() already
+         * did)
          */
+        if (!use_epoll) {
 #ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
-        netsnmp_dispatch_external_events2(&count, &readfds, &writefds, &exceptfds);
+            netsnmp_dispatch_external_events2(&count, &readfds, &writefds,
+                                              &exceptfds);
 #endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
 
-        snmp_read2(&readfds);
+            snmp_read2(&readfds);
+        }
     } else
         switch (count) {
         case 0:
@@ -1599,6 +1620,8 @@ free_agent_snmp_session(netsnmp_agent_session *asp)
 
     DEBUGMSGTL(("snmp_agent","agent_session %8p released\n", asp));
 
+    if (asp->flags & SNMP_AGENT_FLAGS_IN_WORKER)
+        netsnmp_agent_workers_cancel(asp);
     netsnmp_remove_from_delegated(asp);
     
     DEBUGMSGTL(("verbose:asp", "asp %p reqinfo %p freed\n",
@@ -1634,6 +1657,12 @@ netsnmp_check_for_delegated(netsnmp_agent_session *asp)
     if (NULL == asp->treecache)
         return 0;
 
+    /*
+     * a worker thread may be using the requests right now 
+     */
+    if (asp->flags & SNMP_AGENT_FLAGS_IN_WORKER)
+        return 1;
+
     if (asp->flags & SNMP_AGENT_FLAGS_CANCEL_IN_PROGRESS)
         return 0;
     
@@ -2705,8 +2734,7 @@ netsnmp_create_subtree_cache(netsnmp_agent_session *asp)
                     asp->bulkcache[bulkcount++] = vbptr;
 
                     for (i = 1; i < asp->pdu->errindex; i++) {
-                        vbptr->next_variable =
-                            SNMP_MALLOC_STRUCT(variable_list);
+                        vbptr->next_variable = netsnmp_varbind_alloc();
                         /*
                          * don't clone the oid as it's got to be
                          * overwritten anyway 
@@ -2972,91 +3000,122 @@ netsnmp_check_all_requests_status(netsnmp_agent_session *asp,
     return asp->status;
 }
 
-int
-handle_var_requests(netsnmp_agent_session *asp)
+/*
+ * calls the handlers for one subtree cache entry and folds the
+ * result into final_status
+ */
+static int
+_handle_var_requests_cache(netsnmp_agent_session *asp, int i,
+                           int final_status)
 {
-    int             i, retstatus = SNMP_ERR_NOERROR,
-        status = SNMP_ERR_NOERROR, final_status = SNMP_ERR_NOERROR;
+    int             retstatus, status = SNMP_ERR_NOERROR;
     netsnmp_handler_registration *reginfo;
 
-    asp->reqinfo->asp = asp;
-    asp->reqinfo->mode = asp->mode;
-
     /*
-     * now, have the subtrees in the cache go search for their results 
+     * don't call handlers w/null reginfo.
+     * - when is this? sub agent disconnected while request processing?
+     * - should this case encompass more of this subroutine?
+     *   - does check_request_status make send if handlers weren't called?
      */
-    for (i = 0; i <= asp->treecache_num; i++) {
-        /*
-         * don't call handlers w/null reginfo.
-         * - when is this? sub agent disconnected while request processing?
-         * - should this case encompass more of this subroutine?
-         *   - does check_request_status make send if handlers weren't called?
-         */
-        if(NULL != asp->treecache[i].subtree->reginfo) {
-            reginfo = asp->treecache[i].subtree->reginfo;
-            status = netsnmp_call_handlers(reginfo, asp->reqinfo,
-                                           asp->treecache[i].requests_begin);
-        }
-        else
-            status = SNMP_ERR_GENERR;
+    if(NULL != asp->treecache[i].subtree->reginfo) {
+        reginfo = asp->treecache[i].subtree->reginfo;
+        status = netsnmp_call_handlers(reginfo, asp->reqinfo,
+                                       asp->treecache[i].requests_begin);
+    }
+    else
+        status = SNMP_ERR_GENERR;
 
-        /*
-         * find any errors marked in the requests.  For later parts of
-         * SET processing, only check for new errors specific to that
-         * set processing directive (which must superceed the previous
-         * errors).
-         */
-        switch (asp->mode) {
+    /*
+     * find any errors marked in the requests.  For later parts of
+     * SET processing, only check for new errors specific to that
+     * set processing directive (which must superceed the previous
+     * errors).
+     */
+    switch (asp->mode) {
 #ifndef NETSNMP_NO_WRITE_SUPPORT
-        case MODE_SET_COMMIT:
-            retstatus = netsnmp_check_requests_status(asp,
-						      asp->treecache[i].
-						      requests_begin,
-						      SNMP_ERR_COMMITFAILED);
-            break;
+    case MODE_SET_COMMIT:
+        retstatus = netsnmp_check_requests_status(asp,
+                                                  asp->treecache[i].
+                                                  requests_begin,
+                                                  SNMP_ERR_COMMITFAILED);
+        break;
 
-        case MODE_SET_UNDO:
-            retstatus = netsnmp_check_requests_status(asp,
-						      asp->treecache[i].
-						      requests_begin,
-						      SNMP_ERR_UNDOFAILED);
-            break;
+    case MODE_SET_UNDO:
+        retstatus = netsnmp_check_requests_status(asp,
+                                                  asp->treecache[i].
+                                                  requests_begin,
+                                                  SNMP_ERR_UNDOFAILED);
+        break;
 #endif /* NETSNMP_NO_WRITE_SUPPORT */
 
-        default:
-            retstatus = netsnmp_check_requests_status(asp,
-						      asp->treecache[i].
-						      requests_begin, 0);
-            break;
-        }
+    default:
+        retstatus = netsnmp_check_requests_status(asp,
+                                                  asp->treecache[i].
+                                                  requests_begin, 0);
+        break;
+    }
 
-        /*
-         * always take lowest varbind if possible 
-         */
-        if (retstatus != SNMP_ERR_NOERROR) {
-            status = retstatus;
-	}
+    /*
+     * always take lowest varbind if possible 
+     */
+    if (retstatus != SNMP_ERR_NOERROR) {
+        status = retstatus;
+    }
 
+    /*
+     * other things we know less about (no index) 
+     */
+    /*
+     * WWW: drop support for this? 
+     */
+    if (final_status == SNMP_ERR_NOERROR && status != SNMP_ERR_NOERROR) {
         /*
-         * other things we know less about (no index) 
-         */
-        /*
-         * WWW: drop support for this? 
+         * we can't break here, since some processing needs to be
+         * done for all requests anyway (IE, SET handling for UNDO
+         * needs to be called regardless of previous status
+         * results.
+         * WWW:  This should be predictable though and
+         * breaking should be possible in some cases (eg GET,
+         * GETNEXT, ...) 
          */
-        if (final_status == SNMP_ERR_NOERROR && status != SNMP_ERR_NOERROR) {
-            /*
-             * we can't break here, since some processing needs to be
-             * done for all requests anyway (IE, SET handling for UNDO
-             * needs to be called regardless of previous status
-             * results.
-             * WWW:  This should be predictable though and
-             * breaking should be possible in some cases (eg GET,
-             * GETNEXT, ...) 
-             */
-            final_status = status;
+        final_status = status;
+    }
+    return final_status;
+}
+
+int
+handle_var_requests(netsnmp_agent_session *asp)
+{
+    int             i, use_workers, deferred = 0,
+        final_status = SNMP_ERR_NOERROR;
+    netsnmp_handler_registration *reginfo;
+
+    asp->reqinfo->asp = asp;
+    asp->reqinfo->mode = asp->mode;
+
+    /*
+     * with agentWorkerThreads, the subtrees of thread-safe registrations
+     * are left to the worker pool; see agent_workers.c 
+     */
+    use_workers = netsnmp_agent_workers_accept(asp);
+
+    /*
+     * now, have the subtrees in the cache go search for their results 
+     */
+    for (i = 0; i <= asp->treecache_num; i++) {
+        reginfo = asp->treecache[i].subtree->reginfo;
+        if (use_workers && reginfo &&
+            (reginfo->modes & HANDLER_CAN_THREADSAFE)) {
+            deferred++;
+            continue;
         }
+        final_status = _handle_var_requests_cache(asp, i, final_status);
     }
 
+    if (deferred && !netsnmp_agent_workers_submit(asp) &&
+        final_status == SNMP_ERR_NOERROR)
+        final_status = SNMP_ERR_GENERR;
+
     return final_status;
 }
 
@@ -3207,6 +3266,15 @@ check_delayed_request(netsnmp_agent_session *asp)
                 asp));
 
     switch (asp->mode) {
+    case SNMP_MSG_GET:
+        /*
+         * the GET pass of an INCLUSIVE getNext (see handle_pdu)
+         * goes on with the getNext loop
+         */
+        if (asp->pdu->command == SNMP_MSG_GET)
+            break;
+        /* FALL THROUGH */
+
     case SNMP_MSG_GETBULK:
     case SNMP_MSG_GETNEXT:
         netsnmp_check_all_requests_status(asp, 0);
@@ -3786,9 +3854,11 @@ handle_pdu(netsnmp_agent_session *asp)
          * Deal with unhandled results -> noSuchInstance (rather
          * than noSuchObject -- in that case, the type will
          * already have been set to noSuchObject when we realised
-         * we couldn't find an appropriate tree).  
+         * we couldn't find an appropriate tree).  If a worker thread
+         * is still busy, this is done once it has finished.
          */
-        if (status == SNMP_ERR_NOERROR)
+        if (status == SNMP_ERR_NOERROR &&
+            !(asp->flags & SNMP_AGENT_FLAGS_IN_WORKER))
             snmp_replace_var_types(asp->pdu->variables, ASN_NULL,
                                    SNMP_NOSUCHINSTANCE);
         break;
@@ -136,6 +136,7 @@ PERFORMANCE OF THIS SOFTWARE.
 #include <net-snmp/agent/net-snmp-agent-includes.h>
 #include <net-snmp/agent/mib_modules.h>
 #include <net-snmp/agent/agent_sysORTable.h>
+#include <net-snmp/agent/agent_workers.h>
 #include "kernel.h"
 
 #include "mibgroup/struct.h"
@@ -371,6 +372,7 @@ void
 shutdown_agent(void) {
 
     /* probably some of this can be called as shutdown callback */
+    shutdown_agent_workers();
     shutdown_tree();
     clear_context();
     netsnmp_clear_callback_list();
@@ -1205,6 +1205,7 @@ receive(void)
     netsnmp_large_fd_set readfds, writefds, exceptfds;
     struct timeval  timeout, *tvp = &timeout;
     int             count, block, i;
+    int             use_epoll = 0;
 #ifdef	USING_SMUX_MODULE
     int             sd;
 #endif                          /* USING_SMUX_MODULE */
@@ -1258,7 +1259,14 @@ receive(void)
         NETSNMP_LARGE_FD_ZERO(&writefds);
         NETSNMP_LARGE_FD_ZERO(&exceptfds);
         block = 0;
-        snmp_select_info2(&numfds, &readfds, tvp, &block);
+#ifdef NETSNMP_USE_EPOLL
+        use_epoll = netsnmp_epoll_active();
+#ifdef USING_SMUX_MODULE
+        if (smux_listen_sd >= 0)
+            use_epoll = 0;      /* SMUX peers are not in the epoll set */
+#endif                          /* USING_SMUX_MODULE */
+#endif                          /* NETSNMP_USE_EPOLL */
+        snmp_select_info2(&numfds, use_epoll ? NULL : &readfds, tvp, &block);
         if (block == 1) {
             tvp = NULL;         /* block without timeout */
 	}
@@ -1281,7 +1289,9 @@ receive(void)
 #endif                          /* USING_SMUX_MODULE */
 
 #ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
-        netsnmp_external_event_info2(&numfds, &readfds, &writefds, &exceptfds);
+        if (!use_epoll)
+            netsnmp_external_event_info2(&numfds, &readfds, &writefds,
+                                         &exceptfds);
 #endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
 
     reselect:
@@ -1299,11 +1309,18 @@ receive(void)
         if (tvp)
             DEBUGMSGTL(("timer", "tvp %ld.%ld\n", (long) tvp->tv_sec,
                         (long) tvp->tv_usec));
+#ifdef NETSNMP_USE_EPOLL
+        if (use_epoll)
+            count = netsnmp_epoll_dispatch(tvp);
+        else
+#endif
         count = netsnmp_large_fd_set_select(numfds, &readfds, &writefds, &exceptfds,
 				     tvp);
         DEBUGMSGTL(("snmpd/select", "returned, count = %d\n", count));
 
-        if (count > 0) {
+        if (count > 0 && use_epoll) {
+            /* netsnmp_epoll_dispatch() has processed the events */
+        } else if (count > 0) {
 
 #ifdef USING_SMUX_MODULE
             /*
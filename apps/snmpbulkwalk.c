@@ -56,6 +56,7 @@ SOFTWARE.
 #endif
 #include <stdio.h>
 #include <ctype.h>
+#include <errno.h>
 #if HAVE_NETDB_H
 #include <netdb.h>
 #endif
@@ -64,6 +65,8 @@ SOFTWARE.
 #endif
 
 #include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/large_fd_set.h>
+#include <net-snmp/library/snmp_walk.h>
 
 #define NETSNMP_DS_WALK_INCLUDE_REQUESTED		1
 #define NETSNMP_DS_WALK_PRINT_STATISTICS		2
@@ -72,6 +75,7 @@ SOFTWARE.
 oid             objid_mib[] = { 1, 3, 6, 1, 2, 1 };
 int             numprinted = 0;
 int             reps = 10, non_reps = 0;
+int             parallel = 1;
 
 void
 usage(void)
@@ -89,6 +93,8 @@ usage(void)
     fprintf(stderr, "\t\t\t  n<NUM>:  set non-repeaters to <NUM>\n");
     fprintf(stderr,
             "\t\t\t  p:       print the number of variables found\n");
+    fprintf(stderr,
+            "\t\t\t  P<NUM>:  keep up to <NUM> requests outstanding\n");
     fprintf(stderr, "\t\t\t  r<NUM>:  set max-repeaters to <NUM>\n");
 }
 
@@ -114,6 +120,112 @@ snmp_get_and_print(netsnmp_session * ss, oid * theoid, size_t theoid_len)
     }
 }
 
+/*
+ * The parallel walk: its callback prints the varbinds as they come, in
+ * order, and the errors the way the loop in main() does.
+ */
+static struct {
+    netsnmp_session *ss;
+    int             done;
+    int             status;
+    int             exitval;
+} pwalk;
+
+static void
+pwalk_callback(int op, netsnmp_walk *walk, netsnmp_variable_list *vars,
+               void *magic)
+{
+    if (op == NETSNMP_WALK_OP_VARBINDS) {
+        for (; vars; vars = vars->next_variable) {
+            numprinted++;
+            print_variable(vars->name, vars->name_length, vars);
+        }
+        return;
+    }
+
+    pwalk.done = 1;
+    pwalk.status = walk->status;
+    if (walk->status == STAT_TIMEOUT) {
+        fprintf(stderr, "Timeout: No Response from %s\n",
+                pwalk.ss->peername);
+        pwalk.exitval = 1;
+    } else if (walk->status == STAT_ERROR && walk->badoid_len) {
+        fprintf(stderr, "Error: OID not increasing: ");
+        fprint_objid(stderr, walk->erroid, walk->erroid_len);
+        fprintf(stderr, " >= ");
+        fprint_objid(stderr, walk->badoid, walk->badoid_len);
+        fprintf(stderr, "\n");
+        pwalk.status = STAT_SUCCESS;
+        pwalk.exitval = 1;
+    } else if (walk->status == STAT_ERROR && walk->errstat) {
+        fprintf(stderr, "Error in packet.\nReason: %s\n",
+                snmp_errstring(walk->errstat));
+        fprintf(stderr, "Failed object: ");
+        fprint_objid(stderr, walk->erroid, walk->erroid_len);
+        fprintf(stderr, "\n");
+        pwalk.status = STAT_SUCCESS;
+        pwalk.exitval = 2;
+    } else if (walk->status == STAT_ERROR) {
+        snmp_sess_perror("snmpbulkwalk", pwalk.ss);
+        pwalk.exitval = 1;
+    }
+}
+
+/*
+ * Walks root with up to parallel requests outstanding; returns the
+ * status of the walk and sets *exitval.
+ */
+static int
+parallel_walk(netsnmp_session *ss, oid *root, size_t rootlen, int check,
+              int *exitval)
+{
+    void                 *sessp = snmp_sess_pointer(ss);
+    netsnmp_walk         *walk;
+    netsnmp_large_fd_set  fdset;
+    struct timeval        timeout, *tvp;
+    int                   numfds, count, block;
+
+    pwalk.ss = ss;
+    walk = netsnmp_walk_create(sessp, root, rootlen, pwalk_callback, NULL);
+    if (walk == NULL) {
+        snmp_sess_perror("snmpbulkwalk", ss);
+        *exitval = 1;
+        return STAT_ERROR;
+    }
+    walk->max_repetitions = reps;
+    walk->parallel = parallel;
+    if (!check)
+        walk->flags |= NETSNMP_WALK_DONT_CHECK_LEXICOGRAPHIC;
+    netsnmp_walk_start(walk);
+
+    netsnmp_large_fd_set_init(&fdset, FD_SETSIZE);
+    while (!pwalk.done) {
+        numfds = 0;
+        NETSNMP_LARGE_FD_ZERO(&fdset);
+        block = NETSNMP_SNMPBLOCK;
+        tvp = &timeout;
+        timerclear(tvp);
+        snmp_sess_select_info2_flags(sessp, &numfds, &fdset, tvp, &block,
+                                     NETSNMP_SELECT_NOALARMS);
+        if (block == 1)
+            tvp = NULL;
+        count = netsnmp_large_fd_set_select(numfds, &fdset, NULL, NULL, tvp);
+        if (count > 0)
+            snmp_sess_read2(sessp, &fdset);
+        else if (count == 0)
+            snmp_sess_timeout(sessp);
+        else if (errno != EINTR) {
+            perror("select");
+            pwalk.status = STAT_ERROR;
+            pwalk.exitval = 1;
+            break;
+        }
+    }
+    netsnmp_large_fd_set_cleanup(&fdset);
+    *exitval = pwalk.exitval;
+    return pwalk.status;
+}
+
 static
     void
 optProc(int argc, char *const *argv, int opt)
@@ -136,8 +248,11 @@ optProc(int argc, char *const *argv, int opt)
 
             case 'n':
             case 'r':
+            case 'P':
                 if (*(optarg - 1) == 'r') {
                     reps = strtol(optarg, &endptr, 0);
+                } else if (*(optarg - 1) == 'P') {
+                    parallel = strtol(optarg, &endptr, 0);
                 } else {
                     non_reps = strtol(optarg, &endptr, 0);
                 }
@@ -265,6 +380,11 @@ main(int argc, char *argv[])
 
     exitval = 0;
 
+    if (parallel > 1) {
+        status = parallel_walk(ss, root, rootlen, check, &exitval);
+        running = 0;
+    }
+
     while (running) {
         /*
          * create PDU for GETBULK request and add object name to request 
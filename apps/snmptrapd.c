@@ -106,6 +106,7 @@ SOFTWARE.
 #include "snmptrapd_log.h"
 #include "snmptrapd_auth.h"
 #include "snmptrapd_sql.h"
+#include "snmptrapd_structured.h"
 #include "notification-log-mib/notification_log.h"
 #include "tlstm-mib/snmpTlstmCertToTSNTable/snmpTlstmCertToTSNTable.h"
 #include "mibII/vacm_conf.h"
@@ -538,6 +539,9 @@ snmptrapd_main_loop(void)
     int             count, numfds, block;
     fd_set          readfds,writefds,exceptfds;
     struct timeval  timeout, *tvp;
+#ifdef NETSNMP_USE_EPOLL
+    int             use_epoll = netsnmp_epoll_active();
+#endif
 
     while (netsnmp_running) {
         if (reconfig) {
@@ -564,6 +568,26 @@ snmptrapd_main_loop(void)
         tvp = &timeout;
         timerclear(tvp);
         tvp->tv_sec = 5;
+#ifdef NETSNMP_USE_EPOLL
+        if (use_epoll) {
+            /*
+             * All sockets are in the epoll set already; only get the
+             * timeout.
+             */
+            snmp_select_info2(&numfds, NULL, tvp, &block);
+            if (block == 1)
+                tvp = NULL;
+            count = netsnmp_epoll_dispatch(tvp);
+            if (count == 0)
+                snmp_timeout();
+            else if (count < 0 && errno != EINTR) {
+                snmp_log_perror("epoll_wait");
+                netsnmp_running = 0;
+            }
+            run_alarms();
+            continue;
+        }
+#endif /* NETSNMP_USE_EPOLL */
         snmp_select_info(&numfds, &readfds, tvp, &block);
         if (block == 1)
             tvp = NULL;         /* block without timeout */
@@ -678,6 +702,7 @@ main(int argc, char *argv[])
 #ifdef NETSNMP_USE_MYSQL
     snmptrapd_register_sql_configs( );
 #endif
+    snmptrapd_register_structured_configs( );
 #ifdef NETSNMP_SECMOD_USM
     init_usm_conf( "snmptrapd" );
 #endif /* NETSNMP_SECMOD_USM */
@@ -1326,6 +1351,10 @@ main(int argc, char *argv[])
 #ifdef NETSNMP_EMBEDDED_PERL
     shutdown_perl();
 #endif
+    snmptrapd_free_forward();
+    snmptrapd_free_structured();
+    snmptrapd_flush_traphandle();
+    shutdown_netsnmp_trapd_auth();
     snmptrapd_close_sessions(sess_list);
     snmp_shutdown("snmptrapd");
 #ifdef WIN32SERVICE
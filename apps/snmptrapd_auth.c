@@ -33,6 +33,131 @@
 
 #include <net-snmp/agent/agent_trap.h>
 
+#ifdef USING_MIBII_VACM_CONF_MODULE
+/*
+ * The VACM checks for a notification depend only on who sent it (its
+ * security model, name and level), its context and its trap OID, so
+ * their result is kept for each of those, in a direct-mapped cache
+ * that is emptied whenever the configuration is read.
+ */
+#define AUTH_CACHE_SIZE 256
+
+typedef struct trapd_auth_cache_s {
+    int             in_use;
+    int             securityModel;
+    int             securityLevel;
+    char            securityName[VACMSTRINGLEN];
+    char            contextName[VACMSTRINGLEN];
+    oid            *trapoid;
+    size_t          trapoid_len;
+    int             authtypes;
+} trapd_auth_cache;
+
+static trapd_auth_cache auth_cache[AUTH_CACHE_SIZE];
+static u_long   auth_cache_hits, auth_cache_misses;
+
+#define AUTH_CACHE_HASH(h, c)   ((h) = ((h) ^ (u_int) (c)) * 16777619U)
+
+static void
+auth_cache_clear(void)
+{
+    int             i;
+
+    for (i = 0; i < AUTH_CACHE_SIZE; i++) {
+        SNMP_FREE(auth_cache[i].trapoid);
+        auth_cache[i].in_use = 0;
+    }
+}
+
+static int
+auth_cache_flush(int majorID, int minorID, void *serverarg,
+                 void *clientarg)
+{
+    DEBUGMSGTL(("snmptrapd:auth", "emptying the authorization cache\n"));
+    auth_cache_clear();
+    return SNMPERR_SUCCESS;
+}
+
+/*
+ * returns the cache entry for a notification, with in_use set if it
+ * holds the result of its checks, or NULL if it can't be cached
+ */
+static trapd_auth_cache *
+auth_cache_find(netsnmp_pdu *pdu, const char *sn, oid *trapoid,
+                size_t trapoid_len)
+{
+    trapd_auth_cache *entry;
+    size_t          sn_len = strlen(sn), i;
+    u_int           hash = 2166136261U;
+
+    if (sn_len >= VACMSTRINGLEN || pdu->contextNameLen >= VACMSTRINGLEN)
+        return NULL;
+
+    AUTH_CACHE_HASH(hash, pdu->securityModel);
+    AUTH_CACHE_HASH(hash, pdu->securityLevel);
+    for (i = 0; i < sn_len; i++)
+        AUTH_CACHE_HASH(hash, (u_char) sn[i]);
+    for (i = 0; i < pdu->contextNameLen; i++)
+        AUTH_CACHE_HASH(hash, (u_char) pdu->contextName[i]);
+    for (i = 0; i < trapoid_len; i++)
+        AUTH_CACHE_HASH(hash, trapoid[i]);
+    entry = &auth_cache[hash % AUTH_CACHE_SIZE];
+
+    if (entry->in_use &&
+        entry->securityModel == pdu->securityModel &&
+        entry->securityLevel == pdu->securityLevel &&
+        strcmp(entry->securityName, sn) == 0 &&
+        strlen(entry->contextName) == pdu->contextNameLen &&
+        memcmp(entry->contextName, pdu->contextName,
+               pdu->contextNameLen) == 0 &&
+        snmp_oid_compare(entry->trapoid, entry->trapoid_len,
+                         trapoid, trapoid_len) == 0)
+        return entry;
+
+    /* replace whatever was there, once the result is known */
+    SNMP_FREE(entry->trapoid);
+    entry->in_use = 0;
+    entry->trapoid = snmp_duplicate_objid(trapoid, trapoid_len);
+    if (!entry->trapoid)
+        return NULL;
+    entry->trapoid_len = trapoid_len;
+    entry->securityModel = pdu->securityModel;
+    entry->securityLevel = pdu->securityLevel;
+    memcpy(entry->securityName, sn, sn_len + 1);
+    if (pdu->contextNameLen)
+        memcpy(entry->contextName, pdu->contextName, pdu->contextNameLen);
+    entry->contextName[pdu->contextNameLen] = '\0';
+    return entry;
+}
+
+/*
+ * checks the pdu against each type of VACM access we may want to check
+ * up on later, returning the bitmask of those it is authorized for
+ */
+static int
+auth_check_views(netsnmp_pdu *pdu, netsnmp_variable_list *var)
+{
+    int authtypes = 0;
+    int i;
+
+    for(i = 0; i < VACM_MAX_VIEWS; i++) {
+        /* pass the PDU to the VACM routine for handling authorization */
+        DEBUGMSGTL(("snmptrapd:auth", "Calling VACM for checking phase %d:%s\n",
+                    i, se_find_label_in_slist(VACM_VIEW_ENUM_NAME, i)));
+        if (vacm_check_view_contents(pdu, var->val.objid,
+                                     var->val_len/sizeof(oid), 0, i,
+                                     VACM_CHECK_VIEW_CONTENTS_DNE_CONTEXT_OK)
+            == VACM_SUCCESS) {
+            DEBUGMSGTL(("snmptrapd:auth", "  result: authorized\n"));
+            authtypes |= 1 << i;
+        } else {
+            DEBUGMSGTL(("snmptrapd:auth", "  result: not authorized\n"));
+        }
+    }
+    return authtypes;
+}
+#endif /* USING_MIBII_VACM_CONF_MODULE */
+
 /**
  * initializes the snmptrapd authorization code registering needed
  * handlers and config parsers.
@@ -49,6 +174,11 @@ init_netsnmp_trapd_auth(void)
 #ifdef USING_MIBII_VACM_CONF_MODULE
     /* register our configuration tokens for VACM configs */
     init_vacm_config_tokens();
+
+    /* the cached authorizations are out of date once it is re-read */
+    snmp_register_callback(SNMP_CALLBACK_LIBRARY,
+                           SNMP_CALLBACK_PRE_READ_CONFIG,
+                           auth_cache_flush, NULL);
 #endif
 
     /* register a config token for turning off the authorization entirely */
@@ -74,7 +204,8 @@ netsnmp_trapd_auth(netsnmp_pdu           *pdu,
     netsnmp_pdu *newpdu = pdu;
     netsnmp_variable_list *var;
 #ifdef USING_MIBII_VACM_CONF_MODULE
-    int i;
+    trapd_auth_cache *cache = NULL;
+    const char *sn;
 #endif
 
     /* check to see if authorization was not disabled */
@@ -128,24 +259,24 @@ netsnmp_trapd_auth(netsnmp_pdu           *pdu,
     }
 
 #ifdef USING_MIBII_VACM_CONF_MODULE
-    /* check the pdu against each typo of VACM access we may want to
-       check up on later.  We cache the results for future lookup on
-       each call to netsnmp_trapd_check_auth */
-    for(i = 0; i < VACM_MAX_VIEWS; i++) {
-        /* pass the PDU to the VACM routine for handling authorization */
-        DEBUGMSGTL(("snmptrapd:auth", "Calling VACM for checking phase %d:%s\n",
-                    i, se_find_label_in_slist(VACM_VIEW_ENUM_NAME, i)));
-        if (vacm_check_view_contents(newpdu, var->val.objid,
-                                     var->val_len/sizeof(oid), 0, i,
-                                     VACM_CHECK_VIEW_CONTENTS_DNE_CONTEXT_OK)
-            == VACM_SUCCESS) {
-            DEBUGMSGTL(("snmptrapd:auth", "  result: authorized\n"));
-            ret |= 1 << i;
-        } else {
-            DEBUGMSGTL(("snmptrapd:auth", "  result: not authorized\n"));
+    /* the same sender, context and trap as one checked before? */
+    sn = vacm_pdu_secname(newpdu);
+    if (sn)
+        cache = auth_cache_find(newpdu, sn, var->val.objid,
+                                var->val_len/sizeof(oid));
+    if (cache && cache->in_use) {
+        auth_cache_hits++;
+        ret = cache->authtypes;
+        DEBUGMSGTL(("snmptrapd:auth", "Cached bitmask auth: %x\n", ret));
+    } else {
+        auth_cache_misses++;
+        ret = auth_check_views(newpdu, var);
+        DEBUGMSGTL(("snmptrapd:auth", "Final bitmask auth: %x\n", ret));
+        if (cache) {
+            cache->authtypes = ret;
+            cache->in_use = 1;
         }
     }
-    DEBUGMSGTL(("snmptrapd:auth", "Final bitmask auth: %x\n", ret));
 #endif
 
     if (ret) {
@@ -187,3 +318,17 @@ netsnmp_trapd_check_auth(int authtypes)
     return ((authtypes & lastlookup) == authtypes);
 }
 
+/**
+ * Logs how often the cached authorization of a notification was used,
+ * and empties the cache.
+ */
+void
+shutdown_netsnmp_trapd_auth(void)
+{
+#ifdef USING_MIBII_VACM_CONF_MODULE
+    if (auth_cache_hits || auth_cache_misses)
+        snmp_log(LOG_INFO, "authorization cache: %lu hits, %lu misses\n",
+                 auth_cache_hits, auth_cache_misses);
+    auth_cache_clear();
+#endif
+}
@@ -50,6 +50,16 @@ char *exec_format2   = NULL;
 int   SyslogTrap = 0;
 int   dropauth = 0;
 
+static int forward_queue_size = 0;
+
+#define TRAPHANDLE_WORKERS      1
+#define TRAPHANDLE_QUEUE_SIZE   1000
+#define TRAPHANDLE_TIMEOUT      60      /* seconds */
+
+static int traphandle_workers    = TRAPHANDLE_WORKERS;
+static int traphandle_queue_size = TRAPHANDLE_QUEUE_SIZE;
+static int traphandle_timeout    = TRAPHANDLE_TIMEOUT;
+
 const char     *trap1_std_str = "%.4y-%.2m-%.2l %.2h:%.2j:%.2k %B [%b] (via %A [%a]): %N\n\t%W Trap (%q) Uptime: %#T\n%v\n";
 const char     *trap2_std_str = "%.4y-%.2m-%.2l %.2h:%.2j:%.2k %B [%b]:\n%v\n";
 
@@ -217,6 +227,49 @@ parse_forward(const char *token, char *line)
     }
 }
 
+static void
+parse_forward_queue_size(const char *token, char *line)
+{
+    int             size = atoi(line);
+
+    if (size < 0) {
+        netsnmp_config_error("Bad forwardQueueSize: %s", line);
+        return;
+    }
+    forward_queue_size = size;
+}
+
+static void
+free_forward_queue_size(void)
+{
+    forward_queue_size = 0;
+}
+
+static void
+parse_traphandle_limit(const char *token, char *line)
+{
+    int             value = atoi(line);
+
+    if (value < 0 || (value == 0 && !strcmp(token, "traphandleTimeout"))) {
+        netsnmp_config_error("Bad %s: %s", token, line);
+        return;
+    }
+    if (!strcmp(token, "traphandleWorkers"))
+        traphandle_workers = value;
+    else if (!strcmp(token, "traphandleQueueSize"))
+        traphandle_queue_size = value;
+    else
+        traphandle_timeout = value;
+}
+
+static void
+free_traphandle_limits(void)
+{
+    traphandle_workers    = TRAPHANDLE_WORKERS;
+    traphandle_queue_size = TRAPHANDLE_QUEUE_SIZE;
+    traphandle_timeout    = TRAPHANDLE_TIMEOUT;
+}
+
 
 void
 parse_format(const char *token, char *line)
@@ -327,6 +380,13 @@ snmptrapd_register_configs( void )
                             snmptrapd_parse_traphandle,
                             snmptrapd_free_traphandle,
                             "oid|\"default\" program [args ...] ");
+    register_config_handler("snmptrapd", "traphandleWorkers",
+                            parse_traphandle_limit, free_traphandle_limits,
+                            "integer");
+    register_config_handler("snmptrapd", "traphandleQueueSize",
+                            parse_traphandle_limit, NULL, "integer");
+    register_config_handler("snmptrapd", "traphandleTimeout",
+                            parse_traphandle_limit, NULL, "seconds");
     register_config_handler("snmptrapd", "format1",
                             parse_trap1_fmt, free_trap1_fmt, "format");
     register_config_handler("snmptrapd", "format2",
@@ -335,7 +395,11 @@ snmptrapd_register_configs( void )
                             parse_format, NULL,
 			    "[print{,1,2}|syslog{,1,2}|execute{,1,2}] format");
     register_config_handler("snmptrapd", "forward",
-                            parse_forward, NULL, "OID|\"default\" destination");
+                            parse_forward, snmptrapd_free_forward,
+                            "OID|\"default\" destination");
+    register_config_handler("snmptrapd", "forwardQueueSize",
+                            parse_forward_queue_size, free_forward_queue_size,
+                            "integer");
 }
 
 
@@ -352,6 +416,22 @@ netsnmp_trapd_handler *netsnmp_post_global_traphandlers   = NULL;
 netsnmp_trapd_handler *netsnmp_default_traphandlers  = NULL;
 netsnmp_trapd_handler *netsnmp_specific_traphandlers = NULL;
 
+/*
+ * The trap-specific handlers are also indexed by a trie of their trap
+ * OIDs, with a node for each sub-identifier, so that finding the
+ * handlers for a trap takes time proportional to the length of its OID
+ * rather than to the number of trap OIDs with handlers.
+ */
+typedef struct traphandler_trie_s {
+    oid                    subid;
+    netsnmp_trapd_handler *handlers;    /* registered at this OID, or NULL */
+    struct traphandler_trie_s **children;       /* sorted by subid */
+    int                    nchildren;
+    int                    maxchildren;
+} traphandler_trie;
+
+static traphandler_trie traphandler_root;
+
 typedef struct netsnmp_handler_map_t {
    netsnmp_trapd_handler **handler;
    const char             *descr;
@@ -424,6 +504,86 @@ netsnmp_add_default_traphandler(Netsnmp_Trap_Handler *handler) {
 #endif /* NETSNMP_FEATURE_REMOVE_ADD_DEFAULT_TRAPHANDLER */
 
 
+/*
+ * Binary search for a child of a trie node.  Returns 1 and its position
+ * if there is a child for subid, or 0 and the position to insert one at.
+ */
+static int
+traphandler_trie_child(const traphandler_trie *node, oid subid, int *pos)
+{
+    int lo = 0, hi = node->nchildren - 1, mid;
+
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+        if (node->children[mid]->subid == subid) {
+            *pos = mid;
+            return 1;
+        }
+        if (node->children[mid]->subid < subid)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    *pos = lo;
+    return 0;
+}
+
+/*
+ * Returns the trie node for a trap OID, adding the missing nodes
+ * (or NULL if out of memory)
+ */
+static traphandler_trie *
+traphandler_trie_add(const oid *trapOid, int trapOidLen)
+{
+    traphandler_trie *node = &traphandler_root, *child, **children;
+    int i, pos;
+
+    for (i = 0; i < trapOidLen; i++) {
+        if (traphandler_trie_child(node, trapOid[i], &pos)) {
+            node = node->children[pos];
+            continue;
+        }
+        if (node->nchildren == node->maxchildren) {
+            children = (traphandler_trie **)
+                realloc(node->children, (node->maxchildren ?
+                                         2 * node->maxchildren : 2) *
+                        sizeof(traphandler_trie *));
+            if (children == NULL)
+                return NULL;
+            node->children = children;
+            node->maxchildren = node->maxchildren ?
+                2 * node->maxchildren : 2;
+        }
+        child = SNMP_MALLOC_TYPEDEF(traphandler_trie);
+        if (child == NULL)
+            return NULL;
+        child->subid = trapOid[i];
+        memmove(&node->children[pos + 1], &node->children[pos],
+                (node->nchildren - pos) * sizeof(traphandler_trie *));
+        node->children[pos] = child;
+        node->nchildren++;
+        node = child;
+    }
+    return node;
+}
+
+/*
+ * Frees the nodes below a trie node
+ */
+static void
+traphandler_trie_clear(traphandler_trie *node)
+{
+    int i;
+
+    for (i = 0; i < node->nchildren; i++) {
+        traphandler_trie_clear(node->children[i]);
+        free(node->children[i]);
+    }
+    SNMP_FREE(node->children);
+    node->nchildren = node->maxchildren = 0;
+    node->handlers = NULL;
+}
+
 /*
  * Register a new trap-specific traphandler
  */
@@ -431,6 +591,7 @@ netsnmp_trapd_handler *
 netsnmp_add_traphandler(Netsnmp_Trap_Handler* handler,
                         oid *trapOid, int trapOidLen ) {
     netsnmp_trapd_handler *traph, *traph2;
+    traphandler_trie *node;
 
     if ( !handler )
         return NULL;
@@ -448,64 +609,34 @@ netsnmp_add_traphandler(Netsnmp_Trap_Handler* handler,
     traph->trapoid_len = trapOidLen;
     traph->trapoid     = snmp_duplicate_objid(trapOid, trapOidLen);
 
-    /*
-     * Now try to find the appropriate place in the trap-specific
-     * list for this particular trap OID.  If there's a matching OID
-     * already, then find it.  Otherwise find the one that follows.
-     * If we run out of entried, the new one should be tacked onto the end.
-     */
-    for (traph2 = netsnmp_specific_traphandlers;
-         traph2; traph2 = traph2->nextt) {
-	    		/* XXX - check this! */
-        if (snmp_oid_compare(traph2->trapoid, traph2->trapoid_len,
-                             trapOid, trapOidLen) <= 0)
-	    break;
+    node = traphandler_trie_add(trapOid, trapOidLen);
+    if (!node) {
+        SNMP_FREE(traph->trapoid);
+        free(traph);
+        return NULL;
     }
-    if (traph2) {
+
+    if (node->handlers) {
         /*
-         * OK - We've either got an exact match, or we've found the
-	 *   entry *after* where the new one should go.
+         * There are handlers for this trap OID already, so
+         *   tack this new entry onto the end of their list...
          */
-        if (!snmp_oid_compare(traph->trapoid,  traph->trapoid_len,
-                              traph2->trapoid, traph2->trapoid_len)) {
-            /*
-             * Exact match, so find the end of the *handler* list
-             *   and tack on this new entry...
-             */
-            while (traph2->nexth)
-                traph2 = traph2->nexth;
-            traph2->nexth = traph;
-            traph->nextt  = traph2->nextt;   /* Might as well... */
-            traph->prevt  = traph2->prevt;
-        } else {
-            /*
-             * .. or the following entry, so insert the new one before it.
-             */
-            traph->prevt  = traph2->prevt;
-            if (traph2->prevt)
-	        traph2->prevt->nextt = traph;
-            else
-	        netsnmp_specific_traphandlers = traph;
-            traph2->prevt = traph;
-            traph->nextt  = traph2;
-        }
+        traph2 = node->handlers;
+        while (traph2->nexth)
+            traph2 = traph2->nexth;
+        traph2->nexth = traph;
+        traph->nextt  = traph2->nextt;   /* Might as well... */
+        traph->prevt  = traph2->prevt;
     } else {
         /*
-         * If we've run out of entries without finding a suitable spot,
-	 *   the new one should be tacked onto the end.....
+         * .. or start a new list, at the front of the trap-specific
+         *   list (which is only walked to free the handlers).
          */
-	if (netsnmp_specific_traphandlers) {
-            traph2 = netsnmp_specific_traphandlers;
-            while (traph2->nextt)
-                traph2 = traph2->nextt;
-            traph2->nextt = traph;
-            traph->prevt  = traph2;
-	} else {
-            /*
-             * .... unless this is the very first entry, of course!
-             */
-            netsnmp_specific_traphandlers = traph;
-        }
+        node->handlers = traph;
+        traph->nextt   = netsnmp_specific_traphandlers;
+        if (netsnmp_specific_traphandlers)
+            netsnmp_specific_traphandlers->prevt = traph;
+        netsnmp_specific_traphandlers = traph;
     }
 
     return traph;
@@ -551,6 +682,7 @@ snmptrapd_free_traphandle(void)
 	traph = nextt;
     }
     netsnmp_specific_traphandlers = NULL;
+    traphandler_trie_clear(&traphandler_root);
 }
 
 /*
@@ -559,8 +691,10 @@ snmptrapd_free_traphandle(void)
  */
 netsnmp_trapd_handler *
 netsnmp_get_traphandler( oid *trapOid, int trapOidLen ) {
-    netsnmp_trapd_handler *traph;
-    
+    netsnmp_trapd_handler *traph, *found = NULL;
+    traphandler_trie *node;
+    int i, pos;
+
     if (!trapOid || !trapOidLen) {
         DEBUGMSGTL(( "snmptrapd:lookup", "get_traphandler no OID!\n"));
         return NULL;
@@ -570,46 +704,35 @@ netsnmp_get_traphandler( oid *trapOid, int trapOidLen ) {
     DEBUGMSG(( "snmptrapd:lookup", "\n"));
 
     /*
-     * Look for a matching OID, and return that list...
+     * Look for the longest matching OID, and return that list.
+     *   Walk down the trie along the trap OID: handlers registered
+     *   at a prefix match if they were wildcarded, and those
+     *   registered at the trap OID itself unless they were for
+     *   its subtree *strictly* (i.e. not including an exact match).
      */
-    for (traph = netsnmp_specific_traphandlers;
-         traph; traph=traph->nextt ) {
-
-        /*
-         * If the trap handler wasn't wildcarded, then the trapOID
-         *   should match the registered OID exactly.
-         */
-        if (!(traph->flags & NETSNMP_TRAPHANDLER_FLAG_MATCH_TREE)) {
-            if (snmp_oid_compare(traph->trapoid, traph->trapoid_len,
-                                 trapOid, trapOidLen) == 0) {
-                DEBUGMSGTL(( "snmptrapd:lookup",
-                             "get_traphandler exact match (%p)\n", traph));
-	        return traph;
+    node = &traphandler_root;
+    for (i = 0; ; i++) {
+        traph = node->handlers;
+        if (traph) {
+            if (i < trapOidLen) {
+                if (traph->flags & NETSNMP_TRAPHANDLER_FLAG_MATCH_TREE)
+                    found = traph;
+            } else if (!(traph->flags &
+                         NETSNMP_TRAPHANDLER_FLAG_STRICT_SUBTREE)) {
+                found = traph;
             }
-	} else {
-           /*
-            * If the trap handler *was* wildcarded, then the trapOID
-            *   should have the registered OID as a prefix...
-            */
-            if (snmp_oidsubtree_compare(traph->trapoid,
-                                        traph->trapoid_len,
-                                        trapOid, trapOidLen) == 0) {
-                if (traph->flags & NETSNMP_TRAPHANDLER_FLAG_STRICT_SUBTREE) {
-                    /*
-                     * ... and (optionally) *strictly* as a prefix
-                     *   i.e. not including an exact match.
-                     */
-                    if (snmp_oid_compare(traph->trapoid, traph->trapoid_len,
-                                         trapOid, trapOidLen) != 0) {
-                        DEBUGMSGTL(( "snmptrapd:lookup", "get_traphandler strict subtree match (%p)\n", traph));
-	                return traph;
-                    }
-                } else {
-                    DEBUGMSGTL(( "snmptrapd:lookup", "get_traphandler subtree match (%p)\n", traph));
-	            return traph;
-                }
-            }
-	}
+        }
+        if (i == trapOidLen || !traphandler_trie_child(node, trapOid[i], &pos))
+            break;
+        node = node->children[pos];
+    }
+    if (found) {
+        DEBUGMSGTL(( "snmptrapd:lookup", "get_traphandler %s match (%p)\n",
+                     !(found->flags & NETSNMP_TRAPHANDLER_FLAG_MATCH_TREE) ?
+                     "exact" :
+                     (found->flags & NETSNMP_TRAPHANDLER_FLAG_STRICT_SUBTREE) ?
+                     "strict subtree" : "subtree", found));
+        return found;
     }
 
     /*
@@ -791,6 +914,176 @@ int   print_handler(   netsnmp_pdu           *pdu,
 
 #define EXECUTE_FORMAT	"%B\n%b\n%V\n%v\n"
 
+#ifdef USING_UTILITIES_EXECUTE_MODULE
+/*
+ *  traphandle commands
+ *
+ *  Commands are run in the background, so that a burst of traps does
+ *  not hold up receiving more: at most traphandleWorkers of them at
+ *  once, with up to traphandleQueueSize more traps waiting for one of
+ *  them to finish.  A trap that arrives with the queue full is dropped.
+ *  A command still running after traphandleTimeout seconds is killed.
+ *  With traphandleWorkers 0, each command is run to completion when the
+ *  trap is received, as it used to be.
+ */
+typedef struct traphandle_job_s {
+    char           *command;
+    char           *input;          /* the formatted trap */
+    struct timeval  received;
+    struct traphandle_job_s *next;
+} traphandle_job;
+
+static traphandle_job *traphandle_queue;
+static traphandle_job **traphandle_queue_tail = &traphandle_queue;
+static int      traphandle_queued;
+static int      traphandle_running;
+static int      traphandle_dropping;
+
+static struct {
+    u_long          run;
+    u_long          failed;         /* non-zero exit status, or killed */
+    u_long          dropped;        /* the queue was full */
+    int             queue_max;
+    double          latency_total;  /* ms, from receipt to exit */
+    double          latency_max;
+} traphandle_stats;
+
+static void     traphandle_start(void);
+
+static void
+traphandle_finish(traphandle_job *job, int result)
+{
+    struct timeval  now;
+    double          ms;
+
+    netsnmp_get_monotonic_clock(&now);
+    ms = (now.tv_sec - job->received.tv_sec) * 1e3 +
+        (now.tv_usec - job->received.tv_usec) / 1e3;
+    traphandle_stats.run++;
+    if (result != 0)
+        traphandle_stats.failed++;
+    traphandle_stats.latency_total += ms;
+    if (ms > traphandle_stats.latency_max)
+        traphandle_stats.latency_max = ms;
+    DEBUGMSGTL(("snmptrapd:traphandle", "'%s' exited with %d, %.1f ms "
+                "after the trap was received\n", job->command, result, ms));
+    free(job->command);
+    free(job->input);
+    free(job);
+}
+
+static void
+traphandle_done(int result, char *output, int out_len, void *magic)
+{
+    traphandle_running--;
+    traphandle_finish((traphandle_job *) magic, result);
+    traphandle_start();
+}
+
+/*
+ * starts queued commands, while there are free workers
+ */
+static void
+traphandle_start(void)
+{
+    traphandle_job *job;
+
+    while (traphandle_queue && traphandle_running < traphandle_workers) {
+        job = traphandle_queue;
+        traphandle_queue = job->next;
+        if (!traphandle_queue)
+            traphandle_queue_tail = &traphandle_queue;
+        traphandle_queued--;
+        if (run_command_async(job->command, job->input, 1, 0,
+                              traphandle_timeout, traphandle_done, job)) {
+            traphandle_running++;
+            continue;
+        }
+        /* it can't be run in the background */
+        traphandle_finish(job, run_shell_command(job->command, job->input,
+                                                 NULL, NULL));
+    }
+    if (traphandle_dropping && !traphandle_queued) {
+        snmp_log(LOG_WARNING, "traphandle queue emptied, "
+                 "%lu traps dropped so far\n", traphandle_stats.dropped);
+        traphandle_dropping = 0;
+    }
+}
+
+/*
+ * runs a command for a trap, or queues it; takes the input
+ */
+static void
+traphandle_run(char *command, char *input)
+{
+    traphandle_job *job;
+
+    if (traphandle_workers == 0) {
+        run_shell_command(command, input, NULL, NULL);
+        free(input);
+        return;
+    }
+    if (traphandle_queued >= traphandle_queue_size &&
+        traphandle_running >= traphandle_workers) {
+        if (!traphandle_dropping)
+            snmp_log(LOG_WARNING, "traphandle queue full (%d traps), "
+                     "dropping traps\n", traphandle_queued);
+        traphandle_dropping = 1;
+        traphandle_stats.dropped++;
+        free(input);
+        return;
+    }
+
+    job = SNMP_MALLOC_TYPEDEF(traphandle_job);
+    if (job)
+        job->command = strdup(command);
+    if (!job || !job->command) {
+        snmp_log(LOG_ERR, "couldn't queue trap -- malloc failed\n");
+        free(job);
+        free(input);
+        return;
+    }
+    job->input = input;
+    netsnmp_get_monotonic_clock(&job->received);
+    *traphandle_queue_tail = job;
+    traphandle_queue_tail = &job->next;
+    if (++traphandle_queued > traphandle_stats.queue_max)
+        traphandle_stats.queue_max = traphandle_queued;
+    traphandle_start();
+}
+#endif /* USING_UTILITIES_EXECUTE_MODULE */
+
+/*
+ * waits for the commands still running, and runs those still queued
+ * (and waits for them too), then logs how many traphandle commands were
+ * run and how long traps waited for them
+ */
+void
+snmptrapd_flush_traphandle(void)
+{
+#ifdef USING_UTILITIES_EXECUTE_MODULE
+    traphandle_job *job;
+
+    /* traphandle_done() starts the queued ones as the running ones end */
+    run_command_async_wait();
+    while ((job = traphandle_queue) != NULL) {
+        traphandle_queue = job->next;
+        traphandle_finish(job, run_shell_command(job->command, job->input,
+                                                 NULL, NULL));
+    }
+    traphandle_queue_tail = &traphandle_queue;
+    traphandle_queued = 0;
+
+    if (traphandle_stats.run || traphandle_stats.dropped)
+        snmp_log(LOG_INFO, "traphandle: %lu run, %lu failed, %lu dropped, "
+                 "queue max %d, latency avg %.1f ms max %.1f ms\n",
+                 traphandle_stats.run, traphandle_stats.failed,
+                 traphandle_stats.dropped, traphandle_stats.queue_max,
+                 traphandle_stats.run ? traphandle_stats.latency_total /
+                 traphandle_stats.run : 0, traphandle_stats.latency_max);
+#endif /* USING_UTILITIES_EXECUTE_MODULE */
+}
+
 /*
  *  Trap handler for invoking a suitable script
  */
@@ -856,12 +1149,11 @@ int   command_handler( netsnmp_pdu           *pdu,
         /*
          *  and pass this formatted string to the command specified
          */
-        run_shell_command(handler->token, (char*)rbuf, NULL, NULL);   /* Not interested in output */
+        traphandle_run(handler->token, (char*)rbuf);   /* Not interested in output */
         netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID, 
                                NETSNMP_DS_LIB_QUICK_PRINT, oldquick);
         if (pdu->command == SNMP_MSG_TRAP)
             snmp_free_pdu(v2_pdu);
-        free(rbuf);
     }
     return NETSNMPTRAPD_HANDLER_OK;
 #endif /* !def USING_UTILITIES_EXECUTE_MODULE */
@@ -881,6 +1173,249 @@ int axforward_handler( netsnmp_pdu           *pdu,
     return NETSNMPTRAPD_HANDLER_OK;
 }
 
+/*
+ *  Forwarding destinations
+ *
+ *  Each destination (and SNMP version) gets one session, opened when the
+ *  first notification is forwarded there and kept open until the
+ *  configuration is re-read.  A session that fails to send, or whose
+ *  connection is closed by the receiver, is reopened for the next
+ *  notification; if it can't be opened, no attempt is made again for
+ *  FORWARD_RETRY_INTERVAL seconds.
+ *
+ *  With "forwardQueueSize N", notifications are queued instead and sent
+ *  together at the end of the current pass through the event loop (or
+ *  as soon as N are waiting), with the transport corked so that UDP
+ *  sends them with as few system calls as possible.  While a
+ *  destination can't be reached, up to N notifications are kept for it
+ *  and any more are dropped.
+ */
+#define FORWARD_RETRY_INTERVAL  1       /* seconds */
+
+typedef struct forward_target_s {
+    char            *peername;
+    long             version;
+    netsnmp_session *ss;
+    time_t           retry;         /* don't try to open before this */
+    int              opened;        /* times the session was opened */
+
+    netsnmp_pdu    **queue;
+    int              queued;
+
+    u_long           forwarded;
+    u_long           dropped;       /* the queue was full */
+    u_long           failed;        /* could not be sent */
+    u_long           reconnects;
+
+    struct forward_target_s *next;
+} forward_target;
+
+static forward_target *forward_targets;
+static u_int    forward_alarm;
+
+static void     forward_flush(unsigned int clientreg, void *clientarg);
+
+static int
+forward_callback(int op, netsnmp_session *session, int reqid,
+                 netsnmp_pdu *pdu, void *magic)
+{
+    forward_target *target = (forward_target *) magic;
+
+    if (op == NETSNMP_CALLBACK_OP_DISCONNECT && target->ss == session) {
+        /*
+         * the library only closes the transport; the session can't be
+         * closed from here, so forward_target_open() does that
+         */
+        DEBUGMSGTL(("snmptrapd:forward", "%s closed the connection\n",
+                    target->peername));
+        target->retry = 0;
+    }
+    return 1;
+}
+
+static forward_target *
+forward_target_get(const char *dest, long version)
+{
+    forward_target *target;
+    char            buf[BUFSIZ];
+
+    if (strchr(dest, ':') == NULL) {
+        snprintf(buf, sizeof(buf), "%s:%d", dest, SNMP_TRAP_PORT);
+        dest = buf;
+    }
+    for (target = forward_targets; target; target = target->next)
+        if (target->version == version && !strcmp(target->peername, dest))
+            return target;
+
+    target = SNMP_MALLOC_TYPEDEF(forward_target);
+    if (!target)
+        return NULL;
+    target->peername = strdup(dest);
+    if (forward_queue_size)
+        target->queue = (netsnmp_pdu **) calloc(forward_queue_size,
+                                                sizeof(netsnmp_pdu *));
+    if (!target->peername || (forward_queue_size && !target->queue)) {
+        free(target->peername);
+        free(target);
+        return NULL;
+    }
+    target->version = version;
+    target->next = forward_targets;
+    forward_targets = target;
+    return target;
+}
+
+static netsnmp_session *
+forward_target_open(forward_target *target)
+{
+    netsnmp_session session;
+    netsnmp_transport *t;
+    time_t          now;
+
+    if (target->ss) {
+        t = snmp_sess_transport(snmp_sess_pointer(target->ss));
+        if (t && t->sock >= 0)
+            return target->ss;
+        /* the other end closed the connection */
+        snmp_close(target->ss);
+        target->ss = NULL;
+    }
+    now = time(NULL);
+    if (now < target->retry)
+        return NULL;
+
+    snmp_sess_init( &session );
+    session.peername = target->peername;
+    session.version  = target->version;
+    session.callback = forward_callback;
+    session.callback_magic = target;
+    target->ss = snmp_open( &session );
+    if (!target->ss) {
+        snmp_sess_perror("Forward failed", &session);
+        target->retry = now + FORWARD_RETRY_INTERVAL;
+        return NULL;
+    }
+    if (target->opened++)
+        target->reconnects++;
+    DEBUGMSGTL(("snmptrapd:forward", "opened session to %s (%d)\n",
+                target->peername, target->opened));
+    return target->ss;
+}
+
+static void
+forward_target_close(forward_target *target)
+{
+    if (target->ss) {
+        snmp_close(target->ss);
+        target->ss = NULL;
+    }
+}
+
+/*
+ * sends (and takes) one notification over the open session
+ *
+ * @retval 0: sent
+ * @retval -1: not sent; the session should be reopened
+ */
+static int
+forward_target_send(forward_target *target, netsnmp_pdu *pdu)
+{
+    netsnmp_session *ss = target->ss;
+
+    ss->s_snmp_errno = SNMPERR_SUCCESS;
+    if (!snmp_send( ss, pdu ) &&
+            ss->s_snmp_errno != SNMPERR_SUCCESS) {
+        snmp_sess_perror("Forward failed", ss);
+        snmp_free_pdu(pdu);
+        target->failed++;
+        return -1;
+    }
+    target->forwarded++;
+    return 0;
+}
+
+/*
+ * sends the queued notifications, as far as the destination can be
+ * reached
+ */
+static void
+forward_target_flush(forward_target *target)
+{
+    netsnmp_transport *t;
+    int             i, rc = 0, corked = 0;
+
+    if (!target->queued || !forward_target_open(target))
+        return;
+
+    t = snmp_sess_transport(snmp_sess_pointer(target->ss));
+    if (t && t->f_flush && !(t->flags & NETSNMP_TRANSPORT_FLAG_CORKED)) {
+        t->flags |= NETSNMP_TRANSPORT_FLAG_CORKED;
+        corked = 1;
+    }
+    for (i = 0; i < target->queued && rc == 0; i++)
+        rc = forward_target_send(target, target->queue[i]);
+    if (corked) {
+        t->flags &= ~NETSNMP_TRANSPORT_FLAG_CORKED;
+        t->f_flush(t);
+    }
+    if (rc)
+        forward_target_close(target);
+
+    DEBUGMSGTL(("snmptrapd:forward", "%s: sent %d of %d queued\n",
+                target->peername, i, target->queued));
+    target->queued -= i;
+    memmove(target->queue, target->queue + i,
+            target->queued * sizeof(netsnmp_pdu *));
+}
+
+static void
+forward_flush(unsigned int clientreg, void *clientarg)
+{
+    forward_target *target;
+    int             waiting = 0;
+
+    forward_alarm = 0;
+    for (target = forward_targets; target; target = target->next) {
+        forward_target_flush(target);
+        waiting |= target->queued;
+    }
+    if (waiting)
+        forward_alarm = snmp_alarm_register(FORWARD_RETRY_INTERVAL, 0,
+                                            forward_flush, NULL);
+}
+
+/*
+ * sends what is still queued, then closes the sessions to the forwarding
+ * destinations and logs how many notifications went to each
+ */
+void
+snmptrapd_free_forward(void)
+{
+    forward_target *target;
+    int             i;
+
+    if (forward_alarm) {
+        snmp_alarm_unregister(forward_alarm);
+        forward_alarm = 0;
+    }
+    while ((target = forward_targets) != NULL) {
+        forward_targets = target->next;
+        forward_target_flush(target);
+        for (i = 0; i < target->queued; i++)
+            snmp_free_pdu(target->queue[i]);
+        target->dropped += target->queued;
+        forward_target_close(target);
+        if (target->opened)
+            snmp_log(LOG_INFO, "forward %s: %lu forwarded, %lu dropped, "
+                     "%lu failed, %lu reconnects\n", target->peername,
+                     target->forwarded, target->dropped, target->failed,
+                     target->reconnects);
+        free(target->queue);
+        free(target->peername);
+        free(target);
+    }
+}
+
 /*
  *  Trap handler for forwarding to another destination
  */
@@ -888,43 +1423,45 @@ int   forward_handler( netsnmp_pdu           *pdu,
                        netsnmp_transport     *transport,
                        netsnmp_trapd_handler *handler)
 {
-    netsnmp_session session, *ss;
+    forward_target *target;
     netsnmp_pdu *pdu2;
-    char buf[BUFSIZ], *cp;
 
     DEBUGMSGTL(( "snmptrapd", "forward_handler (%s)\n", handler->token));
 
-    snmp_sess_init( &session );
-    if (strchr( handler->token, ':') == NULL) {
-        snprintf( buf, BUFSIZ, "%s:%d", handler->token, SNMP_TRAP_PORT);
-        cp = buf;
-    } else {
-        cp = handler->token;
-    }
-    session.peername = cp;
-    session.version  = pdu->version;
-    ss = snmp_open( &session );
-    if (!ss)
+    target = forward_target_get(handler->token, pdu->version);
+    if (!target)
         return NETSNMPTRAPD_HANDLER_FAIL;
 
-    /* XXX: wjh we should be caching sessions here and not always
-       reopening a session.  It's very ineffecient, especially with v3
-       INFORMS which may require engineID probing */
-
     pdu2 = snmp_clone_pdu(pdu);
+    if (!pdu2)
+        return NETSNMPTRAPD_HANDLER_FAIL;
     if (pdu2->transport_data) {
         free(pdu2->transport_data);
         pdu2->transport_data        = NULL;
         pdu2->transport_data_length = 0;
     }
 
-    ss->s_snmp_errno = SNMPERR_SUCCESS;
-    if (!snmp_send( ss, pdu2 ) &&
-            ss->s_snmp_errno != SNMPERR_SUCCESS) {
-        snmp_sess_perror("Forward failed", ss);
+    if (!forward_queue_size) {
+        if (!forward_target_open(target)) {
+            target->failed++;
+            snmp_free_pdu(pdu2);
+            return NETSNMPTRAPD_HANDLER_FAIL;
+        }
+        if (forward_target_send(target, pdu2))
+            forward_target_close(target);
+        return NETSNMPTRAPD_HANDLER_OK;
+    }
+
+    if (target->queued == forward_queue_size)
+        forward_target_flush(target);
+    if (target->queued == forward_queue_size) {
+        target->dropped++;
         snmp_free_pdu(pdu2);
+        return NETSNMPTRAPD_HANDLER_FAIL;
     }
-    snmp_close( ss );
+    target->queue[target->queued++] = pdu2;
+    if (!forward_alarm)
+        forward_alarm = snmp_alarm_register(0, 0, forward_flush, NULL);
     return NETSNMPTRAPD_HANDLER_OK;
 }
 
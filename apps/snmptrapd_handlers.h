@@ -39,6 +39,8 @@ Netsnmp_Trap_Handler   mysql_handler;
 
 void free_trap1_fmt(void);
 void free_trap2_fmt(void);
+void snmptrapd_free_forward(void);
+void snmptrapd_flush_traphandle(void);
 extern char *print_format1;
 extern char *print_format2;
 extern int   SyslogTrap;
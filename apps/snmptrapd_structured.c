@@ -0,0 +1,861 @@
+/*
+ * snmptrapd_structured.c - log notifications as structured records
+ *
+ * Each notification is written as one record, in the format named by
+ * the structuredLog directive, to the file it names:
+ *
+ *  json:   one JSON object per line, with the time it was received, its
+ *          source, version, PDU type and security information, the trap
+ *          OID, and each varbind with its OID, type and typed value: a
+ *          number, text, or null, or the hex of the bytes of a value
+ *          that is none of these.
+ *
+ *  binary: length-prefixed records, with all integers in network byte
+ *          order.  A str is a u16 length and that many bytes, an oid a
+ *          u8 number of sub-identifiers and that many u32s.
+ *
+ *              u32 length of the rest of the record
+ *              u8  record format (STRUCTURED_BINARY_VERSION)
+ *              u8  SNMP version (0 for SNMPv1, 1 for SNMPv2c, 3 for SNMPv3)
+ *              u8  PDU type
+ *              u8  security model
+ *              u8  security level
+ *              u64 microseconds since the epoch when received
+ *              u32 request ID
+ *              u32 uptime (SNMPv1 traps, otherwise 0)
+ *              str source address
+ *              str agent address (SNMPv1 traps, otherwise empty)
+ *              str community (SNMPv1, SNMPv2c) or security name (SNMPv3)
+ *              str context name
+ *              oid trap OID
+ *              u16 number of varbinds, each of them:
+ *                  oid name
+ *                  u8  ASN.1 type
+ *                  str value: a u32 for the 32-bit integer types (an
+ *                      INTEGER as two's complement), a u64 for
+ *                      Counter64, a u32 per sub-identifier for an OBJECT
+ *                      IDENTIFIER, the bytes of the others
+ *
+ * Records are collected in a buffer for each file, and written together
+ * once it holds structuredLogBufferSize bytes, or structuredLogFlushInterval
+ * seconds after the first of them was received.
+ */
+#include <net-snmp/net-snmp-config.h>
+
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#include <stdio.h>
+#include <math.h>
+#if HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#include <sys/types.h>
+#if TIME_WITH_SYS_TIME
+# include <sys/time.h>
+# include <time.h>
+#else
+# if HAVE_SYS_TIME_H
+#  include <sys/time.h>
+# else
+#  include <time.h>
+# endif
+#endif
+#if HAVE_NETINET_IN_H
+#include <netinet/in.h>
+#endif
+
+#include <net-snmp/net-snmp-includes.h>
+#include "snmptrapd_handlers.h"
+#include "snmptrapd_auth.h"
+#include "snmptrapd_structured.h"
+
+#define STRUCTURED_JSON                 1
+#define STRUCTURED_BINARY               2
+
+#define STRUCTURED_BINARY_VERSION       1
+
+#define STRUCTURED_FLUSH_INTERVAL       1       /* seconds */
+#define STRUCTURED_BUFFER_SIZE          65536   /* bytes */
+
+typedef struct structured_sink_s {
+    char           *path;           /* "-" for the standard output */
+    int             format;
+    FILE           *fp;
+    u_char         *buf;            /* records not yet written */
+    size_t          buf_len;
+    size_t          buf_size;
+    u_long          queued;         /* records in buf */
+    u_long          records;        /* records written */
+    u_long          writes;
+    u_long          bytes;
+    u_long          failed;         /* records that couldn't be written */
+    struct structured_sink_s *next;
+} structured_sink;
+
+static structured_sink *structured_sinks;
+static int      structured_flush_interval = STRUCTURED_FLUSH_INTERVAL;
+static size_t   structured_buffer_size = STRUCTURED_BUFFER_SIZE;
+static u_int    structured_alarm;
+static int      structured_registered;
+
+static const char hexdigits[] = "0123456789abcdef";
+
+/*
+ *  Appending to a sink's buffer
+ */
+
+static int
+structured_reserve(structured_sink *sink, size_t len)
+{
+    size_t          size = sink->buf_size ? sink->buf_size : 4096;
+    u_char         *buf;
+
+    if (sink->buf_len + len <= sink->buf_size)
+        return 1;
+    while (size < sink->buf_len + len)
+        size *= 2;
+    buf = (u_char *) realloc(sink->buf, size);
+    if (!buf)
+        return 0;
+    sink->buf = buf;
+    sink->buf_size = size;
+    return 1;
+}
+
+static void
+structured_put(structured_sink *sink, const void *data, size_t len)
+{
+    if (structured_reserve(sink, len)) {
+        memcpy(sink->buf + sink->buf_len, data, len);
+        sink->buf_len += len;
+    }
+}
+
+static void
+structured_puts(structured_sink *sink, const char *str)
+{
+    structured_put(sink, str, strlen(str));
+}
+
+static void
+structured_put_u8(structured_sink *sink, u_int value)
+{
+    u_char          c = value;
+
+    structured_put(sink, &c, 1);
+}
+
+static void
+structured_put_u16(structured_sink *sink, u_int value)
+{
+    u_char          b[2];
+
+    b[0] = value >> 8;
+    b[1] = value;
+    structured_put(sink, b, 2);
+}
+
+static void
+structured_put_u32(structured_sink *sink, u_long value)
+{
+    u_char          b[4];
+
+    b[0] = value >> 24;
+    b[1] = value >> 16;
+    b[2] = value >> 8;
+    b[3] = value;
+    structured_put(sink, b, 4);
+}
+
+static void
+structured_put_u64(structured_sink *sink, u_long high, u_long low)
+{
+    structured_put_u32(sink, high);
+    structured_put_u32(sink, low);
+}
+
+/* a binary str; longer ones are cut short */
+static void
+structured_put_str(structured_sink *sink, const void *data, size_t len)
+{
+    if (len > 0xffff)
+        len = 0xffff;
+    structured_put_u16(sink, len);
+    structured_put(sink, data, len);
+}
+
+/* a binary oid */
+static void
+structured_put_oid(structured_sink *sink, const oid *name, size_t len)
+{
+    size_t          i;
+
+    if (len > 0xff)
+        len = 0xff;
+    structured_put_u8(sink, len);
+    for (i = 0; i < len; i++)
+        structured_put_u32(sink, name[i]);
+}
+
+/* a JSON string; bytes outside printable ASCII are escaped */
+static void
+structured_put_json_str(structured_sink *sink, const u_char *str,
+                        size_t len)
+{
+    u_char         *cp;
+    size_t          i;
+
+    /* at worst, \u00XX for every byte */
+    if (!structured_reserve(sink, len * 6 + 2))
+        return;
+    cp = sink->buf + sink->buf_len;
+    *cp++ = '"';
+    for (i = 0; i < len; i++) {
+        switch (str[i]) {
+        case '"':
+        case '\\':
+            *cp++ = '\\';
+            *cp++ = str[i];
+            break;
+        case '\n':
+            *cp++ = '\\';
+            *cp++ = 'n';
+            break;
+        case '\r':
+            *cp++ = '\\';
+            *cp++ = 'r';
+            break;
+        case '\t':
+            *cp++ = '\\';
+            *cp++ = 't';
+            break;
+        default:
+            if (str[i] < 0x20 || str[i] >= 0x7f) {
+                memcpy(cp, "\\u00", 4);
+                cp[4] = hexdigits[str[i] >> 4];
+                cp[5] = hexdigits[str[i] & 0xf];
+                cp += 6;
+            } else
+                *cp++ = str[i];
+        }
+    }
+    *cp++ = '"';
+    sink->buf_len = cp - sink->buf;
+}
+
+/* a JSON string of hex digits */
+static void
+structured_put_json_hex(structured_sink *sink, const u_char *data,
+                        size_t len)
+{
+    u_char         *cp;
+    size_t          i;
+
+    if (!structured_reserve(sink, len * 2 + 2))
+        return;
+    cp = sink->buf + sink->buf_len;
+    *cp++ = '"';
+    for (i = 0; i < len; i++) {
+        *cp++ = hexdigits[data[i] >> 4];
+        *cp++ = hexdigits[data[i] & 0xf];
+    }
+    *cp++ = '"';
+    sink->buf_len = cp - sink->buf;
+}
+
+/* a JSON string of a numeric OID */
+static void
+structured_put_json_oid(structured_sink *sink, const oid *name, size_t len)
+{
+    char            subid[16];
+    size_t          i;
+
+    structured_put(sink, "\"", 1);
+    for (i = 0; i < len; i++) {
+        snprintf(subid, sizeof(subid), ".%lu", (u_long) name[i]);
+        structured_puts(sink, subid);
+    }
+    structured_put(sink, "\"", 1);
+}
+
+static void
+structured_put_json_num(structured_sink *sink, const char *fmt, long value)
+{
+    char            num[24];
+
+    snprintf(num, sizeof(num), fmt, value);
+    structured_puts(sink, num);
+}
+
+/* whether an OCTET STRING can be written as a JSON string */
+static int
+structured_is_text(const u_char *str, size_t len)
+{
+    size_t          i;
+
+    for (i = 0; i < len; i++)
+        if ((str[i] < 0x20 && str[i] != '\n' && str[i] != '\r' &&
+             str[i] != '\t') || str[i] >= 0x7f)
+            return 0;
+    return 1;
+}
+
+/*
+ *  The notification
+ */
+
+/*
+ * the trap OID: snmpTrapOID.0 in an SNMPv2 notification, or converted
+ * from an SNMPv1 trap as in RFC 2576
+ */
+static size_t
+structured_trapoid(netsnmp_pdu *pdu, oid *buf, size_t size, oid **name)
+{
+    static oid      trapoids[] = { 1, 3, 6, 1, 6, 3, 1, 1, 5, 0 };
+    netsnmp_variable_list *vars;
+    size_t          len;
+
+    if (pdu->command == SNMP_MSG_TRAP) {
+        if (pdu->trap_type != SNMP_TRAP_ENTERPRISESPECIFIC) {
+            trapoids[OID_LENGTH(trapoids) - 1] = pdu->trap_type + 1;
+            *name = trapoids;
+            return OID_LENGTH(trapoids);
+        }
+        len = pdu->enterprise_length;
+        if (len + 2 > size)
+            return 0;
+        memcpy(buf, pdu->enterprise, len * sizeof(oid));
+        if (len && buf[len - 1] != 0)
+            buf[len++] = 0;
+        buf[len++] = pdu->specific_type;
+        *name = buf;
+        return len;
+    }
+    vars = pdu->variables;
+    if (vars && vars->next_variable &&
+        vars->next_variable->type == ASN_OBJECT_ID) {
+        *name = vars->next_variable->val.objid;
+        return vars->next_variable->val_len / sizeof(oid);
+    }
+    return 0;
+}
+
+static const char *
+structured_type_name(u_char type)
+{
+    switch (type) {
+    case ASN_INTEGER:           return "INTEGER";
+    case ASN_BIT_STR:           return "BITS";
+    case ASN_OCTET_STR:         return "OCTET STRING";
+    case ASN_NULL:              return "NULL";
+    case ASN_OBJECT_ID:         return "OBJECT IDENTIFIER";
+    case ASN_IPADDRESS:         return "IpAddress";
+    case ASN_COUNTER:           return "Counter32";
+    case ASN_GAUGE:             return "Gauge32";
+    case ASN_TIMETICKS:         return "TimeTicks";
+    case ASN_OPAQUE:            return "Opaque";
+    case ASN_COUNTER64:         return "Counter64";
+    case ASN_UINTEGER:          return "UInteger32";
+#ifdef NETSNMP_WITH_OPAQUE_SPECIAL_TYPES
+    case ASN_OPAQUE_COUNTER64:  return "Opaque Counter64";
+    case ASN_OPAQUE_U64:        return "Opaque U64";
+    case ASN_OPAQUE_I64:        return "Opaque I64";
+    case ASN_OPAQUE_FLOAT:      return "Opaque Float";
+    case ASN_OPAQUE_DOUBLE:     return "Opaque Double";
+#endif
+    case SNMP_NOSUCHOBJECT:     return "noSuchObject";
+    case SNMP_NOSUCHINSTANCE:   return "noSuchInstance";
+    case SNMP_ENDOFMIBVIEW:     return "endOfMibView";
+    default:                    return "unknown";
+    }
+}
+
+static void
+structured_json_value(structured_sink *sink, netsnmp_variable_list *var)
+{
+    char            num[I64CHARSZ + 1];
+
+    /* values that are not numbers or text are written as hex */
+    switch (var->type) {
+    case ASN_OCTET_STR:
+        if (structured_is_text(var->val.string, var->val_len))
+            break;
+        /* FALL THROUGH */
+    case ASN_BIT_STR:
+    case ASN_OPAQUE:
+        structured_puts(sink, "\"hex\":");
+        structured_put_json_hex(sink, var->val.string, var->val_len);
+        return;
+    case ASN_IPADDRESS:
+        if (var->val_len == 4)
+            break;
+        structured_puts(sink, "\"hex\":");
+        structured_put_json_hex(sink, var->val.string, var->val_len);
+        return;
+    }
+
+    structured_puts(sink, "\"value\":");
+    switch (var->type) {
+    case ASN_INTEGER:
+        structured_put_json_num(sink, "%ld", *var->val.integer);
+        break;
+    case ASN_COUNTER:
+    case ASN_GAUGE:
+    case ASN_TIMETICKS:
+    case ASN_UINTEGER:
+        structured_put_json_num(sink, "%lu",
+                                (u_long) (*var->val.integer & 0xffffffff));
+        break;
+    case ASN_COUNTER64:
+#ifdef NETSNMP_WITH_OPAQUE_SPECIAL_TYPES
+    case ASN_OPAQUE_COUNTER64:
+    case ASN_OPAQUE_U64:
+#endif
+        printU64(num, var->val.counter64);
+        structured_puts(sink, num);
+        break;
+#ifdef NETSNMP_WITH_OPAQUE_SPECIAL_TYPES
+    case ASN_OPAQUE_I64:
+        printI64(num, var->val.counter64);
+        structured_puts(sink, num);
+        break;
+    case ASN_OPAQUE_FLOAT:
+        /* JSON has no NaN or Infinity */
+        if (!isfinite(*var->val.floatVal)) {
+            structured_puts(sink, "null");
+            break;
+        }
+        snprintf(num, sizeof(num), "%g", *var->val.floatVal);
+        structured_puts(sink, num);
+        break;
+    case ASN_OPAQUE_DOUBLE:
+        if (!isfinite(*var->val.doubleVal)) {
+            structured_puts(sink, "null");
+            break;
+        }
+        snprintf(num, sizeof(num), "%g", *var->val.doubleVal);
+        structured_puts(sink, num);
+        break;
+#endif
+    case ASN_OCTET_STR:
+        structured_put_json_str(sink, var->val.string, var->val_len);
+        break;
+    case ASN_IPADDRESS:
+        snprintf(num, sizeof(num), "\"%u.%u.%u.%u\"", var->val.string[0],
+                 var->val.string[1], var->val.string[2], var->val.string[3]);
+        structured_puts(sink, num);
+        break;
+    case ASN_OBJECT_ID:
+        structured_put_json_oid(sink, var->val.objid,
+                                var->val_len / sizeof(oid));
+        break;
+    default:
+        structured_puts(sink, "null");
+        break;
+    }
+}
+
+static void
+structured_json_record(structured_sink *sink, netsnmp_pdu *pdu,
+                       const char *source, const struct timeval *now,
+                       const oid *trapoid, size_t trapoid_len)
+{
+    netsnmp_variable_list *var;
+    char            buf[64];
+
+    snprintf(buf, sizeof(buf), "{\"time\":%lu.%06lu,\"source\":",
+             (u_long) now->tv_sec, (u_long) now->tv_usec);
+    structured_puts(sink, buf);
+    structured_put_json_str(sink, (const u_char *) source, strlen(source));
+
+    structured_puts(sink, ",\"version\":");
+    structured_puts(sink, pdu->version == SNMP_VERSION_1 ? "\"1\"" :
+                    pdu->version == SNMP_VERSION_2c ? "\"2c\"" :
+                    pdu->version == SNMP_VERSION_3 ? "\"3\"" : "null");
+    structured_puts(sink, ",\"type\":");
+    structured_puts(sink, "\"");
+    /* snmp_pdu_type() doesn't know the SNMPv1 Trap-PDU */
+    structured_puts(sink, pdu->command == SNMP_MSG_TRAP ? "TRAP" :
+                    snmp_pdu_type(pdu->command));
+    structured_puts(sink, "\",\"requestID\":");
+    structured_put_json_num(sink, "%ld", pdu->reqid);
+    structured_puts(sink, ",\"securityModel\":");
+    structured_put_json_num(sink, "%ld", pdu->securityModel);
+
+    if (pdu->version == SNMP_VERSION_3) {
+        structured_puts(sink, ",\"securityName\":");
+        structured_put_json_str(sink, (u_char *) pdu->securityName,
+                                pdu->securityName ?
+                                pdu->securityNameLen : 0);
+        structured_puts(sink, ",\"securityLevel\":");
+        structured_put_json_num(sink, "%ld", pdu->securityLevel);
+        structured_puts(sink, ",\"contextName\":");
+        structured_put_json_str(sink, (u_char *) pdu->contextName,
+                                pdu->contextName ? pdu->contextNameLen : 0);
+        structured_puts(sink, ",\"contextEngineID\":");
+        structured_put_json_hex(sink, pdu->contextEngineID,
+                                pdu->contextEngineID ?
+                                pdu->contextEngineIDLen : 0);
+    } else {
+        structured_puts(sink, ",\"community\":");
+        structured_put_json_str(sink, pdu->community,
+                                pdu->community ? pdu->community_len : 0);
+    }
+
+    if (pdu->command == SNMP_MSG_TRAP) {
+        structured_puts(sink, ",\"enterprise\":");
+        structured_put_json_oid(sink, pdu->enterprise,
+                                pdu->enterprise_length);
+        snprintf(buf, sizeof(buf), ",\"agentAddress\":\"%u.%u.%u.%u\"",
+                 pdu->agent_addr[0], pdu->agent_addr[1],
+                 pdu->agent_addr[2], pdu->agent_addr[3]);
+        structured_puts(sink, buf);
+        snprintf(buf, sizeof(buf), ",\"genericTrap\":%ld,"
+                 "\"specificTrap\":%ld,\"uptime\":%lu", pdu->trap_type,
+                 pdu->specific_type, (u_long) pdu->time);
+        structured_puts(sink, buf);
+    }
+
+    structured_puts(sink, ",\"trapOID\":");
+    if (trapoid_len)
+        structured_put_json_oid(sink, trapoid, trapoid_len);
+    else
+        structured_puts(sink, "null");
+
+    structured_puts(sink, ",\"varbinds\":[");
+    for (var = pdu->variables; var; var = var->next_variable) {
+        structured_puts(sink, var == pdu->variables ? "{\"oid\":" :
+                        ",{\"oid\":");
+        structured_put_json_oid(sink, var->name, var->name_length);
+        structured_puts(sink, ",\"type\":\"");
+        structured_puts(sink, structured_type_name(var->type));
+        structured_puts(sink, "\",");
+        structured_json_value(sink, var);
+        structured_puts(sink, "}");
+    }
+    structured_puts(sink, "]}\n");
+}
+
+static void
+structured_binary_value(structured_sink *sink, netsnmp_variable_list *var)
+{
+    size_t          i, len;
+
+    switch (var->type) {
+    case ASN_INTEGER:
+    case ASN_COUNTER:
+    case ASN_GAUGE:
+    case ASN_TIMETICKS:
+    case ASN_UINTEGER:
+        structured_put_u16(sink, 4);
+        structured_put_u32(sink, *var->val.integer);
+        break;
+    case ASN_COUNTER64:
+#ifdef NETSNMP_WITH_OPAQUE_SPECIAL_TYPES
+    case ASN_OPAQUE_COUNTER64:
+    case ASN_OPAQUE_U64:
+    case ASN_OPAQUE_I64:
+#endif
+        structured_put_u16(sink, 8);
+        structured_put_u64(sink, var->val.counter64->high,
+                           var->val.counter64->low);
+        break;
+    case ASN_OBJECT_ID:
+        len = var->val_len / sizeof(oid);
+        if (len > 0xffff / 4)
+            len = 0xffff / 4;
+        structured_put_u16(sink, len * 4);
+        for (i = 0; i < len; i++)
+            structured_put_u32(sink, var->val.objid[i]);
+        break;
+    case ASN_NULL:
+    case SNMP_NOSUCHOBJECT:
+    case SNMP_NOSUCHINSTANCE:
+    case SNMP_ENDOFMIBVIEW:
+        structured_put_u16(sink, 0);
+        break;
+    default:
+        structured_put_str(sink, var->val.string, var->val_len);
+        break;
+    }
+}
+
+static void
+structured_binary_record(structured_sink *sink, netsnmp_pdu *pdu,
+                         const char *source, const struct timeval *now,
+                         const oid *trapoid, size_t trapoid_len)
+{
+    netsnmp_variable_list *var;
+    size_t          start = sink->buf_len;
+    uint64_t        usec;
+    int             count;
+
+    structured_put_u32(sink, 0);        /* the length, filled in below */
+    structured_put_u8(sink, STRUCTURED_BINARY_VERSION);
+    structured_put_u8(sink, pdu->version);
+    structured_put_u8(sink, pdu->command);
+    structured_put_u8(sink, pdu->securityModel);
+    structured_put_u8(sink, pdu->securityLevel);
+    usec = (uint64_t) now->tv_sec * 1000000 + now->tv_usec;
+    structured_put_u64(sink, (u_long) (usec >> 32),
+                       (u_long) (usec & 0xffffffff));
+    structured_put_u32(sink, pdu->reqid);
+    structured_put_u32(sink, pdu->command == SNMP_MSG_TRAP ? pdu->time : 0);
+    structured_put_str(sink, source, strlen(source));
+    if (pdu->command == SNMP_MSG_TRAP)
+        structured_put_str(sink, pdu->agent_addr, 4);
+    else
+        structured_put_u16(sink, 0);
+    if (pdu->version == SNMP_VERSION_3)
+        structured_put_str(sink, pdu->securityName,
+                           pdu->securityName ? pdu->securityNameLen : 0);
+    else
+        structured_put_str(sink, pdu->community,
+                           pdu->community ? pdu->community_len : 0);
+    structured_put_str(sink, pdu->contextName,
+                       pdu->contextName ? pdu->contextNameLen : 0);
+    structured_put_oid(sink, trapoid, trapoid_len);
+
+    for (count = 0, var = pdu->variables; var; var = var->next_variable)
+        count++;
+    structured_put_u16(sink, count);
+    for (var = pdu->variables; var; var = var->next_variable) {
+        structured_put_oid(sink, var->name, var->name_length);
+        structured_put_u8(sink, var->type);
+        structured_binary_value(sink, var);
+    }
+
+    if (sink->buf_len >= start + 4) {
+        u_long          len = sink->buf_len - start - 4;
+
+        sink->buf[start] = len >> 24;
+        sink->buf[start + 1] = len >> 16;
+        sink->buf[start + 2] = len >> 8;
+        sink->buf[start + 3] = len;
+    }
+}
+
+/*
+ *  Writing the buffered records
+ */
+
+static int
+structured_open(structured_sink *sink)
+{
+    if (sink->fp)
+        return 1;
+    if (!strcmp(sink->path, "-")) {
+        sink->fp = stdout;
+        return 1;
+    }
+    sink->fp = fopen(sink->path,
+                     sink->format == STRUCTURED_BINARY ? "ab" : "a");
+    if (!sink->fp) {
+        snmp_log(LOG_ERR, "structuredLog: couldn't open %s\n", sink->path);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * writes the buffered records of a sink together
+ */
+static void
+structured_sink_flush(structured_sink *sink)
+{
+    if (!sink->buf_len)
+        return;
+    if (!structured_open(sink) ||
+        fwrite(sink->buf, 1, sink->buf_len, sink->fp) != sink->buf_len ||
+        fflush(sink->fp) != 0) {
+        snmp_log(LOG_ERR, "structuredLog: couldn't write to %s\n",
+                 sink->path);
+        /* the records are dropped, rather than kept growing */
+        sink->failed += sink->queued;
+    } else {
+        sink->records += sink->queued;
+        sink->writes++;
+        sink->bytes += sink->buf_len;
+    }
+    DEBUGMSGTL(("snmptrapd:structured", "%s: wrote %" NETSNMP_PRIz "u "
+                "bytes\n", sink->path, sink->buf_len));
+    sink->buf_len = 0;
+    sink->queued = 0;
+}
+
+static void
+structured_flush(unsigned int clientreg, void *clientarg)
+{
+    structured_sink *sink;
+
+    structured_alarm = 0;
+    for (sink = structured_sinks; sink; sink = sink->next)
+        structured_sink_flush(sink);
+}
+
+/*
+ *  Trap handler for writing structured records
+ */
+int
+structured_handler(netsnmp_pdu           *pdu,
+                   netsnmp_transport     *transport,
+                   netsnmp_trapd_handler *handler)
+{
+    structured_sink *sink;
+    struct timeval  now;
+    oid             buf[MAX_OID_LEN], *trapoid = NULL;
+    size_t          trapoid_len;
+    char           *source = NULL;
+
+    if (!structured_sinks)
+        return NETSNMPTRAPD_HANDLER_OK;
+
+    DEBUGMSGTL(("snmptrapd:structured", "structured_handler\n"));
+    gettimeofday(&now, NULL);
+    trapoid_len = structured_trapoid(pdu, buf, OID_LENGTH(buf), &trapoid);
+    if (transport && transport->f_fmtaddr)
+        source = transport->f_fmtaddr(transport, pdu->transport_data,
+                                      pdu->transport_data_length);
+
+    for (sink = structured_sinks; sink; sink = sink->next) {
+        if (sink->format == STRUCTURED_JSON)
+            structured_json_record(sink, pdu, source ? source : "",
+                                   &now, trapoid, trapoid_len);
+        else
+            structured_binary_record(sink, pdu, source ? source : "",
+                                     &now, trapoid, trapoid_len);
+        sink->queued++;
+        if (sink->buf_len >= structured_buffer_size)
+            structured_sink_flush(sink);
+        else if (!structured_alarm)
+            structured_alarm = snmp_alarm_register(structured_flush_interval,
+                                                   0, structured_flush,
+                                                   NULL);
+    }
+    free(source);
+    return NETSNMPTRAPD_HANDLER_OK;
+}
+
+/*
+ *  Configuration
+ */
+
+static void
+parse_structured_log(const char *token, char *line)
+{
+    char            format[SNMP_MAXBUF_SMALL];
+    structured_sink *sink, **prev;
+    netsnmp_trapd_handler *traph;
+    char           *cp;
+
+    cp = copy_nword(line, format, sizeof(format));
+    if (!cp || !*cp) {
+        netsnmp_config_error("Missing structuredLog file: %s", line);
+        return;
+    }
+    sink = SNMP_MALLOC_TYPEDEF(structured_sink);
+    if (!sink)
+        return;
+    if (!strcmp(format, "json"))
+        sink->format = STRUCTURED_JSON;
+    else if (!strcmp(format, "binary"))
+        sink->format = STRUCTURED_BINARY;
+    else {
+        netsnmp_config_error("Unknown structuredLog format: %s", format);
+        free(sink);
+        return;
+    }
+    sink->path = strdup(cp);
+    if (!sink->path) {
+        free(sink);
+        return;
+    }
+
+    /* kept in the order they were configured */
+    for (prev = &structured_sinks; *prev; prev = &(*prev)->next)
+        ;
+    *prev = sink;
+
+    if (!structured_registered) {
+        traph = netsnmp_add_global_traphandler(NETSNMPTRAPD_PRE_HANDLER,
+                                               structured_handler);
+        if (traph) {
+            traph->authtypes = TRAP_AUTH_LOG;
+            structured_registered = 1;
+        }
+    }
+}
+
+static void
+parse_structured_limit(const char *token, char *line)
+{
+    int             value = atoi(line);
+
+    if (!strcmp(token, "structuredLogFlushInterval")) {
+        if (value < 0) {
+            netsnmp_config_error("Bad %s: %s", token, line);
+            return;
+        }
+        structured_flush_interval = value;
+    } else {
+        if (value <= 0) {
+            netsnmp_config_error("Bad %s: %s", token, line);
+            return;
+        }
+        structured_buffer_size = value;
+    }
+}
+
+static void
+free_structured_limits(void)
+{
+    structured_flush_interval = STRUCTURED_FLUSH_INTERVAL;
+    structured_buffer_size = STRUCTURED_BUFFER_SIZE;
+}
+
+/*
+ * register the structured log configuration tokens
+ */
+void
+snmptrapd_register_structured_configs(void)
+{
+    register_config_handler("snmptrapd", "structuredLog",
+                            parse_structured_log, snmptrapd_free_structured,
+                            "json|binary FILE");
+    register_config_handler("snmptrapd", "structuredLogFlushInterval",
+                            parse_structured_limit, free_structured_limits,
+                            "seconds");
+    register_config_handler("snmptrapd", "structuredLogBufferSize",
+                            parse_structured_limit, NULL, "bytes");
+}
+
+/*
+ * writes the buffered records, then closes the structured log files and
+ * logs how much was written to each
+ */
+void
+snmptrapd_free_structured(void)
+{
+    structured_sink *sink;
+
+    if (structured_alarm) {
+        snmp_alarm_unregister(structured_alarm);
+        structured_alarm = 0;
+    }
+    while ((sink = structured_sinks) != NULL) {
+        structured_sinks = sink->next;
+        structured_sink_flush(sink);
+        if (sink->writes || sink->failed)
+            snmp_log(LOG_INFO, "structuredLog %s: %lu records, %lu bytes in "
+                     "%lu writes, %lu failed\n", sink->path, sink->records,
+                     sink->bytes, sink->writes, sink->failed);
+        if (sink->fp && sink->fp != stdout)
+            fclose(sink->fp);
+        free(sink->path);
+        free(sink->buf);
+        free(sink);
+    }
+}
@@ -0,0 +1,9 @@
+#ifndef SNMPTRAPD_STRUCTURED_H
+#define SNMPTRAPD_STRUCTURED_H
+
+void snmptrapd_register_structured_configs(void);
+void snmptrapd_free_structured(void);
+int structured_handler(netsnmp_pdu *pdu, netsnmp_transport *transport,
+                       netsnmp_trapd_handler *handler);
+
+#endif /* SNMPTRAPD_STRUCTURED_H */
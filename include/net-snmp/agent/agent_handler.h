@@ -83,10 +83,21 @@ typedef struct netsnmp_mib_handler_s {
  */
 #define HANDLER_CAN_GETANDGETNEXT     0x01       /* must be able to do both */
 #define HANDLER_CAN_SET               0x02           /* implies create, too */
+/*
+ * Registrations without HANDLER_CAN_GETBULK get a bulk_to_next handler
+ * put in front of their own by netsnmp_register_handler().  Tables
+ * registered with netsnmp_register_table() over a table_container
+ * handler (table_container, table_tdata and MFD tables) set it, and
+ * answer GETBULK in the table helper instead, so reg->handler->next
+ * is no longer the handler below the first one; look handlers up
+ * with netsnmp_find_handler_by_name() rather than by their position.
+ */
 #define HANDLER_CAN_GETBULK           0x04
 #define HANDLER_CAN_NOT_CREATE        0x08         /* auto set if ! CAN_SET */
 #define HANDLER_CAN_BABY_STEP         0x10
 #define HANDLER_CAN_STASH             0x20
+/* may run in agentWorkerThreads; no in-tree handler sets it */
+#define HANDLER_CAN_THREADSAFE        0x40
 
 
 #define HANDLER_CAN_RONLY   (HANDLER_CAN_GETANDGETNEXT)
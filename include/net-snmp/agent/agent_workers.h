@@ -0,0 +1,73 @@
+/*
+ * agent_workers.h: worker thread pool for thread-safe MIB handlers
+ *
+ * When snmpd.conf sets "agentWorkerThreads N" (N > 0) and the agent was
+ * built with --enable-reentrant, the handlers of registrations made with
+ * HANDLER_CAN_THREADSAFE are called on one of N worker threads for GET,
+ * GETNEXT and GETBULK requests.  Parsing, access control, the registry
+ * lookups, all other handlers and the response encoding stay on the main
+ * thread; the request is treated like a delegated one there and picked
+ * up again when the worker is done, so a slow handler no longer holds up
+ * other requests.
+ *
+ * A thread-safe handler must protect any data it shares with the rest of
+ * the agent itself and must not delegate requests.  The pool never runs
+ * two passes that use the same registration at the same time.
+ *
+ * No MIB module in this tree sets HANDLER_CAN_THREADSAFE: they share
+ * caches, containers and library state with the main thread, which
+ * reloads and frees them from alarms.  The pool is for modules that set
+ * it themselves after making sure of the above.
+ */
+#ifndef AGENT_WORKERS_H
+#define AGENT_WORKERS_H
+
+#ifdef __cplusplus
+extern          "C" {
+#endif
+
+struct netsnmp_agent_session_s;
+struct netsnmp_handler_registration_s;
+
+/*
+ * Returns 1 if the pool takes the thread-safe subtrees of the current
+ * pass of asp, starting the worker threads on first use, or 0 if the
+ * caller must run all of them itself.
+ */
+int             netsnmp_agent_workers_accept(struct netsnmp_agent_session_s
+                                             *asp);
+
+/*
+ * Queues the thread-safe subtrees of the current pass of asp, once the
+ * caller has run the others.  Their requests are marked delegated and
+ * asp is flagged SNMP_AGENT_FLAGS_IN_WORKER until a worker is done.
+ * Returns 0 if nothing could be queued.
+ */
+int             netsnmp_agent_workers_submit(struct netsnmp_agent_session_s
+                                             *asp);
+
+/*
+ * Makes sure no worker uses asp any more: a queued pass is dropped and a
+ * running one is waited for.  Called before asp is freed.
+ */
+void            netsnmp_agent_workers_cancel(struct netsnmp_agent_session_s
+                                             *asp);
+
+/*
+ * Waits until no queued or running job uses reginfo.  Called before a
+ * registration is freed.
+ */
+void            netsnmp_agent_workers_wait_reginfo(struct
+                                                   netsnmp_handler_registration_s
+                                                   *reginfo);
+
+/* Number of running worker threads (0 if the pool is not in use) */
+int             netsnmp_agent_workers_running(void);
+
+void            shutdown_agent_workers(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AGENT_WORKERS_H */
@@ -30,6 +30,19 @@ extern          "C" {
 
     typedef int  (NetsnmpCacheLoad)(netsnmp_cache *, void*);
     typedef void (NetsnmpCacheFree)(netsnmp_cache *, void*);
+    typedef int  (NetsnmpCacheMergeRow)(netsnmp_cache *, void *old_row,
+                                        void *new_row);
+
+    /*
+     * What the merged reloads of a cache (NETSNMP_CACHE_MERGE_ON_RELOAD)
+     * did to its rows, totalled over all of them.
+     */
+    typedef struct netsnmp_cache_merge_stats_s {
+        u_long          rows_inserted;
+        u_long          rows_updated;   /* incl. rows replaced by new ones */
+        u_long          rows_deleted;
+        u_long          rows_unchanged;
+    } netsnmp_cache_merge_stats;
 
     struct netsnmp_cache_s {
 	/** Number of handlers whose myvoid member points at this structure. */
@@ -67,6 +80,15 @@ extern          "C" {
         oid *rootoid;
         int  rootoid_len;
 
+        /*
+         * For merging a reload into the existing container
+         * (NETSNMP_CACHE_MERGE_ON_RELOAD)
+         */
+        NetsnmpCacheMergeRow       *merge_row;
+        netsnmp_container_obj_func *free_row;
+        netsnmp_container          *snapshot; /* the reload goes here */
+        netsnmp_cache_merge_stats   merge_stats;
+
     };
 
 
@@ -110,6 +132,9 @@ extern          "C" {
     unsigned int netsnmp_cache_timer_start(netsnmp_cache *cache);
     void netsnmp_cache_timer_stop(netsnmp_cache *cache);
 
+    void netsnmp_cache_get_merge_stats(netsnmp_cache *cache,
+                                       netsnmp_cache_merge_stats *stats);
+
 /*
  * Flags affecting cache handler operation
  */
@@ -120,6 +145,7 @@ extern          "C" {
 #define NETSNMP_CACHE_PRELOAD                               0x0010
 #define NETSNMP_CACHE_AUTO_RELOAD                           0x0020
 #define NETSNMP_CACHE_RESET_TIMER_ON_USE                    0x0040
+#define NETSNMP_CACHE_MERGE_ON_RELOAD                       0x0080
 
 #define NETSNMP_CACHE_HINT_HANDLER_ARGS                     0x1000
 
@@ -40,6 +40,12 @@
 #define NETSNMP_DS_AGENT_DISKIO_NO_FD   18      /* 1 = don't report /dev/fd*   entries in diskIOTable */
 #define NETSNMP_DS_AGENT_DISKIO_NO_LOOP 19      /* 1 = don't report /dev/loop* entries in diskIOTable */
 #define NETSNMP_DS_AGENT_DISKIO_NO_RAM  20      /* 1 = don't report /dev/ram*  entries in diskIOTable */
+#define NETSNMP_DS_AGENT_NO_SOCK_DIAG   21      /* 1 = read sockets from /proc/net, not netlink sock_diag */
+#define NETSNMP_DS_AGENT_NO_ROUTE_NETLINK 22    /* 1 = read routes from /proc/net, not netlink */
+#define NETSNMP_DS_AGENT_ROUTE_MONITOR  23      /* 1 = reload routes only when the kernel reports changes */
+#define NETSNMP_DS_AGENT_NO_INTERFACE_NETLINK 24 /* 1 = read interfaces from /proc/net/dev, not netlink */
+#define NETSNMP_DS_AGENT_INTERFACE_MONITOR 25   /* 1 = apply link changes as the kernel reports them */
+#define NETSNMP_DS_AGENT_EXTEND_REFRESH 26      /* 1 = rerun extend commands before their results expire */
 
 /* WARNING: The trap receiver also uses DS flags and must not conflict with these!
  * If you define additional boolean entries, check in "apps/snmptrapd_ds.h" first */
@@ -77,4 +83,6 @@
 #define NETSNMP_DS_AGENT_AVG_BULKVARBINDSIZE 15 /* avg varbind size estimate */
 #define NETSNMP_DS_AGENT_PDU_STATS_MAX       16 /* size of top N array*/
 #define NETSNMP_DS_AGENT_PDU_STATS_THRESHOLD 17 /* minimum threshold time */
+#define NETSNMP_DS_AGENT_WORKER_THREADS      18 /* size of the worker pool */
+#define NETSNMP_DS_AGENT_AGENTX_WINDOW       19 /* AgentX requests outstanding */
 #endif
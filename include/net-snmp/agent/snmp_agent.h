@@ -39,6 +39,7 @@ extern          "C" {
 
 #define SNMP_AGENT_FLAGS_NONE                   0x0
 #define SNMP_AGENT_FLAGS_CANCEL_IN_PROGRESS     0x1
+#define SNMP_AGENT_FLAGS_IN_WORKER              0x2 /* see agent_workers.h */
 
     extern int      netsnmp_running;
 
@@ -267,6 +268,8 @@ extern          "C" {
     int             netsnmp_check_requests_error(netsnmp_request_info *reqs);
     int             netsnmp_check_all_requests_error(netsnmp_agent_session *asp,
                                                      int look_for_specific);
+    int             netsnmp_check_all_requests_status(netsnmp_agent_session *asp,
+                                                      int look_for_specific);
     int
         netsnmp_set_all_requests_error(netsnmp_agent_request_info *reqinfo,
                                        netsnmp_request_info *requests,
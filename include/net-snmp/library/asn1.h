@@ -264,6 +264,55 @@ SOFTWARE.
 
     NETSNMP_IMPORT
     int             asn_realloc(u_char **, size_t *);
+    NETSNMP_IMPORT
+    int             asn_realloc_reserve(u_char **, size_t *, size_t, size_t);
+
+    /*
+     * Sizes of the objects built by the reverse encoder functions below,
+     * for sizing a buffer before encoding into it.  The header size does
+     * not include the object itself; the others do.  0 means the object
+     * cannot be encoded.
+     */
+    NETSNMP_IMPORT
+    size_t          asn_rbuild_size_header(size_t length);
+    NETSNMP_IMPORT
+    size_t          asn_rbuild_size_int(const long *intp);
+    NETSNMP_IMPORT
+    size_t          asn_rbuild_size_unsigned_int(const u_long *intp);
+    NETSNMP_IMPORT
+    size_t          asn_rbuild_size_unsigned_int64(const struct counter64
+                                                   *cp);
+    NETSNMP_IMPORT
+    size_t          asn_rbuild_size_objid(const oid *objid,
+                                          size_t objidlength);
+
+    /*
+     * Reverse encoders that build straight into a buffer known to have
+     * room, backwards from the pointer passed in to the one returned.
+     */
+    NETSNMP_IMPORT
+    u_char         *asn_rbuild_header_unchecked(u_char *cp, u_char type,
+                                                size_t length);
+    NETSNMP_IMPORT
+    u_char         *asn_rbuild_int_unchecked(u_char *cp, u_char type,
+                                             long integer);
+    NETSNMP_IMPORT
+    u_char         *asn_rbuild_unsigned_int_unchecked(u_char *cp,
+                                                      u_char type,
+                                                      u_long integer);
+    NETSNMP_IMPORT
+    u_char         *asn_rbuild_unsigned_int64_unchecked(u_char *cp,
+                                                        u_char type,
+                                                        const struct
+                                                        counter64 *c64);
+    NETSNMP_IMPORT
+    u_char         *asn_rbuild_string_unchecked(u_char *cp, u_char type,
+                                                const u_char *str,
+                                                size_t strlength);
+    NETSNMP_IMPORT
+    u_char         *asn_rbuild_objid_unchecked(u_char *cp, u_char type,
+                                               const oid *objid,
+                                               size_t objidlength);
 
     /*
      * Re-allocating reverse ASN.1 encoder functions.  Synopsis:
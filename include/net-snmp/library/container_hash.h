@@ -0,0 +1,48 @@
+/*
+ * container_hash.h
+ * $Id$
+ *
+ */
+#ifndef NETSNMP_CONTAINER_HASH_H
+#define NETSNMP_CONTAINER_HASH_H
+
+
+#include <net-snmp/library/container.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+    /*
+     * function returning the hash of an object's key. Objects which
+     * compare equal must hash to the same value.
+     */
+    typedef u_int (netsnmp_container_hash_func)(const void *data);
+
+    /*
+     * get a container which uses a hash table for storage. Exact
+     * lookups don't depend on the number of entries; find_next has to
+     * look at every entry, and iterators don't return them in order.
+     */
+    netsnmp_container *netsnmp_container_get_hash(void);
+    netsnmp_factory   *netsnmp_container_get_hash_factory(void);
+
+    /*
+     * set the hash function for a hash container. Without one, a hash
+     * function is picked to match the compare routines in container.h
+     * (netsnmp_index, cstring, long ...); for any other compare routine,
+     * a hash function must be set.
+     */
+    NETSNMP_IMPORT
+    int netsnmp_container_hash_set_func(netsnmp_container *c,
+                                        netsnmp_container_hash_func *f);
+
+    NETSNMP_IMPORT
+    void netsnmp_container_hash_init(void);
+
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /** NETSNMP_CONTAINER_HASH_H */
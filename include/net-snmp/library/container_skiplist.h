@@ -0,0 +1,31 @@
+/*
+ * container_skiplist.h
+ * $Id$
+ *
+ */
+#ifndef NETSNMP_CONTAINER_SKIPLIST_H
+#define NETSNMP_CONTAINER_SKIPLIST_H
+
+
+#include <net-snmp/library/container.h>
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+    /*
+     * get a container which uses a skip list for storage. Entries are
+     * kept sorted; find, find_next, insert and remove take log(n) steps.
+     */
+    netsnmp_container *netsnmp_container_get_skiplist(void);
+    netsnmp_factory   *netsnmp_container_get_skiplist_factory(void);
+
+    NETSNMP_IMPORT
+    void netsnmp_container_skiplist_init(void);
+
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /** NETSNMP_CONTAINER_SKIPLIST_H */
@@ -128,6 +128,46 @@ void netsnmp_dispatch_external_events2(int *count,
                                        netsnmp_large_fd_set *readfds,
                                        netsnmp_large_fd_set *writefds,
                                        netsnmp_large_fd_set *exceptfds);
+
+#ifdef NETSNMP_USE_EPOLL
+/*
+ * epoll backend (configure --enable-epoll)
+ *
+ * Description:
+ *   Session sockets and the fds registered above are added to a single
+ *   epoll set once, when they are opened or registered, instead of being
+ *   collected into fd_sets on every pass through the event loop.  An
+ *   event loop that finds netsnmp_epoll_active() true should compute its
+ *   timeout with snmp_select_info2() passing a NULL fd set and then call
+ *   netsnmp_epoll_dispatch() in place of select(),
+ *   netsnmp_dispatch_external_events2() and snmp_read2().  See
+ *   agent_check_and_process() for an example.
+ */
+#define NETSNMP_FD_EVENT_READ           0x01
+#define NETSNMP_FD_EVENT_WRITE          0x02
+#define NETSNMP_FD_EVENT_EXCEPT         0x04
+
+/* maximum number of ready fds handled per netsnmp_epoll_dispatch() call */
+#define NETSNMP_EPOLL_MAX_EVENTS        256
+
+/* Returns 1 if the epoll set could be created, 0 to fall back to select() */
+NETSNMP_IMPORT
+int  netsnmp_epoll_active(void);
+
+/* Add/remove NETSNMP_FD_EVENT_* interest in fd to/from the epoll set */
+NETSNMP_IMPORT
+int  netsnmp_epoll_watch(int fd, int events);
+NETSNMP_IMPORT
+int  netsnmp_epoll_unwatch(int fd, int events);
+
+/*
+ * Wait at most *timeout (forever if timeout is NULL) for activity and
+ * dispatch it.  Returns the number of ready fds, 0 on timeout or -1 on
+ * error with errno set, like select().
+ */
+NETSNMP_IMPORT
+int  netsnmp_epoll_dispatch(struct timeval *timeout);
+#endif /* NETSNMP_USE_EPOLL */
 #ifdef __cplusplus
 }
 #endif
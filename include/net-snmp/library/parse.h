@@ -238,6 +238,12 @@ SOFTWARE.
     void            print_mib_tree(FILE *, struct tree *, int);
     int             get_mib_parse_error_count(void);
     NETSNMP_IMPORT
+    int             netsnmp_mib_image_save(const char *file,
+                                           const char *key);
+    NETSNMP_IMPORT
+    int             netsnmp_mib_image_load(const char *file,
+                                           const char *key);
+    NETSNMP_IMPORT
     int             snmp_get_token(FILE * fp, char *token, int maxtlen);
     NETSNMP_IMPORT
     struct tree    *find_best_tree_node(const char *name,
@@ -168,6 +168,58 @@ typedef struct netsnmp_priv_alg_info_s {
                                u_char * ciphertext, u_int ctlen,
                                u_char * plaintext, size_t * ptlen);
 
+    /*
+     * The same with the key state kept between calls in *cache, e.g. one
+     * per user: the HMAC context that has taken in the key and the cipher
+     * key schedule.  *cache starts out NULL and is set up again whenever
+     * the type or the key changes; sc_free_cache() releases it.  A cache
+     * must not be used by two threads at once.
+     */
+    typedef struct netsnmp_sc_cache_s netsnmp_sc_cache;
+
+    NETSNMP_IMPORT
+    int             sc_generate_keyed_hash_cached(netsnmp_sc_cache **cache,
+                                                  const oid * authtype,
+                                                  size_t authtypelen,
+                                                  const u_char * key,
+                                                  u_int keylen,
+                                                  const u_char * message,
+                                                  u_int msglen,
+                                                  u_char * MAC,
+                                                  size_t * maclen);
+
+    NETSNMP_IMPORT
+    int             sc_check_keyed_hash_cached(netsnmp_sc_cache **cache,
+                                               const oid * authtype,
+                                               size_t authtypelen,
+                                               const u_char * key,
+                                               u_int keylen,
+                                               const u_char * message,
+                                               u_int msglen,
+                                               const u_char * MAC,
+                                               u_int maclen);
+
+    NETSNMP_IMPORT
+    int             sc_encrypt_cached(netsnmp_sc_cache **cache,
+                                      const oid * privtype,
+                                      size_t privtypelen,
+                                      u_char * key, u_int keylen,
+                                      u_char * iv, u_int ivlen,
+                                      const u_char * plaintext, u_int ptlen,
+                                      u_char * ciphertext, size_t * ctlen);
+
+    NETSNMP_IMPORT
+    int             sc_decrypt_cached(netsnmp_sc_cache **cache,
+                                      const oid * privtype,
+                                      size_t privtypelen,
+                                      u_char * key, u_int keylen,
+                                      u_char * iv, u_int ivlen,
+                                      u_char * ciphertext, u_int ctlen,
+                                      u_char * plaintext, size_t * ptlen);
+
+    NETSNMP_IMPORT
+    void            sc_free_cache(netsnmp_sc_cache *cache);
+
     NETSNMP_IMPORT
     int             sc_hash_type(int auth_type, const u_char * buf,
                                  size_t buf_len, u_char * MAC,
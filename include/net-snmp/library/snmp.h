@@ -364,6 +364,19 @@ SOFTWARE.
                                                u_char value_type,
                                                u_char * value,
                                                size_t value_length);
+    size_t          snmp_rbuild_size_var_op(const oid * name,
+                                            size_t name_len,
+                                            u_char value_type,
+                                            const u_char * value,
+                                            size_t value_length);
+    int             snmp_rbuild_var_op_unchecked(u_char * pkt,
+                                                 size_t pkt_len,
+                                                 size_t * offset,
+                                                 const oid * name,
+                                                 size_t name_len,
+                                                 u_char value_type,
+                                                 const u_char * value,
+                                                 size_t value_length);
 #endif
 
 #ifdef __cplusplus
@@ -23,6 +23,7 @@ extern          "C" {
                              void **opaque, int *olength);
     int netsnmp_udpbase_send(netsnmp_transport *t, const void *buf, int size,
                              void **opaque, int *olength);
+    int netsnmp_udpbase_flush(netsnmp_transport *t);
 
 #if defined(HAVE_IP_PKTINFO) || defined(HAVE_IP_RECVDSTADDR)
     int netsnmp_udpbase_recvfrom(int s, void *buf, int len,
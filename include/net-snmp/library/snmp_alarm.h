@@ -25,7 +25,10 @@ extern          "C" {
         struct timeval  t_nextM;
         void           *clientarg;
         SNMPAlarmCallback *thecallback;
+        /** Next alarm in the same hash bucket. */
         struct snmp_alarm *next;
+        /** Position in the heap of pending alarms. */
+        size_t          heap_index;
     };
 
     /*
@@ -301,6 +301,31 @@ typedef struct request_list {
 
     NETSNMP_IMPORT void snmp_free_var_internals(netsnmp_variable_list *);     /* frees contents only */
 
+    /*
+     * PDU and varbind pool.  With "pduPoolSize N" in snmp.conf, up to N
+     * freed PDUs and N freed varbinds are kept and handed out again by
+     * netsnmp_pdu_alloc() and netsnmp_varbind_alloc(), which return
+     * cleared structures like calloc() does.  Pooled structures are
+     * ordinary malloc() blocks, so they may still be freed with free().
+     */
+    typedef struct netsnmp_pdu_pool_stats_s {
+        u_long          pdu_allocs;     /* PDUs handed out */
+        u_long          pdu_reused;     /* ... of those, taken from the pool */
+        u_long          pdu_frees;      /* PDUs freed */
+        u_long          pdu_pooled;     /* ... of those, kept in the pool */
+        u_long          varbind_allocs;
+        u_long          varbind_reused;
+        u_long          varbind_frees;
+        u_long          varbind_pooled;
+        u_long          pdus_free;      /* PDUs in the pool now */
+        u_long          varbinds_free;  /* varbinds in the pool now */
+    } netsnmp_pdu_pool_stats;
+
+    NETSNMP_IMPORT netsnmp_pdu *netsnmp_pdu_alloc(void);
+    NETSNMP_IMPORT netsnmp_variable_list *netsnmp_varbind_alloc(void);
+    NETSNMP_IMPORT void netsnmp_pdu_pool_get_stats(netsnmp_pdu_pool_stats *);
+    NETSNMP_IMPORT void netsnmp_pdu_pool_clear(void);
+
 
     /*
      * This routine must be supplied by the application:
@@ -472,6 +497,8 @@ typedef struct request_list {
     NETSNMP_IMPORT
     int        snmp_pdu_realloc_rbuild(u_char ** pkt, size_t * pkt_len,
                                 size_t * offset, netsnmp_pdu *pdu);
+    NETSNMP_IMPORT
+    size_t     snmp_pdu_rbuild_size(netsnmp_pdu *pdu);
 #endif
 
 
@@ -734,9 +761,22 @@ struct netsnmp_transport_s;
 #define  STAT_TLSTM_STATS_START                 STAT_TLSTM_SNMPTLSTMSESSIONOPENS
 #define  STAT_TLSTM_STATS_END          STAT_TLSTM_SNMPTLSTMSESSIONINVALIDCACHES
 
+    /*
+     * UDP transport batching counters (recvmmsg/sendmmsg); the average
+     * batch size is PKTS / BATCHES, FULL counts batches that hit the limit
+     */
+#define  STAT_UDP_RECVBATCHES                  57
+#define  STAT_UDP_RECVBATCHPKTS                58
+#define  STAT_UDP_RECVBATCHFULL                59
+#define  STAT_UDP_SENDBATCHES                  60
+#define  STAT_UDP_SENDBATCHPKTS                61
+
+#define  STAT_UDP_STATS_START                  STAT_UDP_RECVBATCHES
+#define  STAT_UDP_STATS_END                    STAT_UDP_SENDBATCHPKTS
+
     /* this previously was end+1; don't know why the +1 is needed;
        XXX: check the code */
-#define  NETSNMP_STAT_MAX_STATS              (STAT_TLSTM_STATS_END+1)
+#define  NETSNMP_STAT_MAX_STATS              (STAT_UDP_STATS_END+1)
 /** backwards compatability */
 #define MAX_STATS NETSNMP_STAT_MAX_STATS
 
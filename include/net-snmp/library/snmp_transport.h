@@ -56,6 +56,10 @@ extern          "C" {
 #define		NETSNMP_TRANSPORT_FLAG_OPENED	 0x20  /* f_open called */
 #define		NETSNMP_TRANSPORT_FLAG_SHARED	 0x40
 #define		NETSNMP_TRANSPORT_FLAG_HOSTNAME	 0x80  /* for fmtaddr hook */
+#define		NETSNMP_TRANSPORT_FLAG_MORE_PKTS 0x100 /* f_recv has more packets
+                                                          queued; per-message */
+#define		NETSNMP_TRANSPORT_FLAG_CORKED	 0x200 /* f_send may queue packets
+                                                          until f_flush */
 
 /*  The standard SNMP domains.  */
 
@@ -213,6 +217,13 @@ typedef struct netsnmp_transport_s {
     /* allocated host name identifier; used by configuration system
        to load localhost.conf for host-specific configuration */
     u_char         *identifier; /* udp:localhost:161 -> "localhost" */
+
+    /*  Optional callback to send the packets f_send queued while the
+        transport was corked (see NETSNMP_TRANSPORT_FLAG_CORKED) */
+    int            (*f_flush)(struct netsnmp_transport_s *);
+
+    /*  Receive/send batching state, private to the transport (not copied) */
+    void           *batch;
 } netsnmp_transport;
 
 typedef struct netsnmp_transport_list_s {
@@ -0,0 +1,104 @@
+/*
+ * snmp_walk.h: asynchronous, parallel walks of a subtree.
+ *
+ * A walk retrieves everything below a root OID with GETBULK requests
+ * (GETNEXT for SNMPv1) sent with snmp_sess_async_send(), so any number
+ * of walks, on any number of sessions, can run from one event loop.
+ * With parallel > 1 a walk also keeps several requests outstanding on
+ * its own session, each working through a part of the subtree:
+ *
+ *  - by default, the subtree is split at the columns of the table the
+ *    root names (or at the children of the root, for an entry or a
+ *    group), starting a request at the next column whenever one is
+ *    free.  The columns are found as the walk goes, so gaps in the
+ *    numbering cost a request at most.
+ *  - netsnmp_walk_split_at() instead splits it at fixed OIDs, for
+ *    instance at index values that divide a large routing table.
+ *
+ * Whatever the split, the callback gets the varbinds in the order a
+ * plain walk would have returned them; the parts that arrive ahead of
+ * their turn are held until then.
+ */
+#ifndef NET_SNMP_SNMP_WALK_H
+#define NET_SNMP_SNMP_WALK_H
+
+#include <net-snmp/types.h>
+
+#ifdef __cplusplus
+extern          "C" {
+#endif
+
+    struct netsnmp_walk_s;
+    struct netsnmp_walk_range_s;
+
+    /*
+     * Called with NETSNMP_WALK_OP_VARBINDS for each batch of varbinds,
+     * which belong to the library and are freed when the callback
+     * returns, and then once with NETSNMP_WALK_OP_DONE and vars NULL,
+     * after which the walk is freed.
+     */
+    typedef void    (netsnmp_walk_callback) (int op,
+                                             struct netsnmp_walk_s *walk,
+                                             netsnmp_variable_list *vars,
+                                             void *magic);
+
+#define NETSNMP_WALK_OP_VARBINDS        1
+#define NETSNMP_WALK_OP_DONE            2
+
+    /*
+     * flags
+     */
+#define NETSNMP_WALK_DONT_CHECK_LEXICOGRAPHIC  0x01
+
+    typedef struct netsnmp_walk_s {
+        /*
+         * set by netsnmp_walk_create(), may be changed before
+         * netsnmp_walk_start()
+         */
+        int             max_repetitions;        /* default 10 */
+        int             parallel;       /* requests in flight, default 1 */
+        u_int           flags;
+
+        /*
+         * results, valid in the NETSNMP_WALK_OP_DONE callback
+         */
+        int             status;         /* STAT_SUCCESS, _ERROR or _TIMEOUT */
+        long            errstat;        /* error-status of the response */
+        oid             erroid[MAX_OID_LEN];    /* the OID requested */
+        size_t          erroid_len;
+        oid             badoid[MAX_OID_LEN];    /* OID not increasing */
+        size_t          badoid_len;
+        u_long          count;          /* varbinds delivered */
+
+        /*
+         * internal
+         */
+        void           *sessp;
+        int             version;
+        oid             root[MAX_OID_LEN];
+        size_t          root_len;
+        netsnmp_walk_callback *callback;
+        void           *magic;
+        struct netsnmp_walk_range_s *ranges, *last_range;
+        int             outstanding;
+        int             started, finished, explicit_split, tail_created;
+        oid             prefix[MAX_OID_LEN];    /* split at prefix.<column> */
+        size_t          prefix_len;     /* 0 until known */
+        u_long          next_column, last_column;
+    } netsnmp_walk;
+
+    NETSNMP_IMPORT
+    netsnmp_walk   *netsnmp_walk_create(void *sessp, const oid *root,
+                                        size_t root_len,
+                                        netsnmp_walk_callback *callback,
+                                        void *magic);
+    NETSNMP_IMPORT
+    int             netsnmp_walk_split_at(netsnmp_walk *walk,
+                                          const oid *name, size_t len);
+    NETSNMP_IMPORT
+    int             netsnmp_walk_start(netsnmp_walk *walk);
+
+#ifdef __cplusplus
+}
+#endif
+#endif                          /* NET_SNMP_SNMP_WALK_H */
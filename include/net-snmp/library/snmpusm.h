@@ -97,6 +97,8 @@ extern          "C" {
         void           *usmDHUserPrivKeyChange;
         struct usmUser *next;
         struct usmUser *prev;
+        struct usmUser *hashNext; /* private: chain in the user hash */
+        struct netsnmp_sc_cache_s *scCache; /* private: crypto key state */
     };
 
 #define USMUSER_FLAG_KEEP_MASTER_KEY             0x01
@@ -120,6 +120,15 @@ extern          "C" {
     NETSNMP_IMPORT
     void            snmp_read2(netsnmp_large_fd_set *);
 
+#ifdef NETSNMP_USE_EPOLL
+    /*
+     * snmp_read_fd() reads from the session owning a socket that the
+     * epoll backend reported as readable; see netsnmp_epoll_dispatch().
+     */
+    NETSNMP_IMPORT
+    int             snmp_read_fd(int);
+#endif
+
 
     NETSNMP_IMPORT
     int             snmp_synch_response(netsnmp_session *, netsnmp_pdu *,
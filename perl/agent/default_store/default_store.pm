@@ -33,6 +33,12 @@ use vars qw(@ISA %EXPORT_TAGS @EXPORT_OK @EXPORT $VERSION $AUTOLOAD);
 				   NETSNMP_DS_AGENT_DONT_RETAIN_NOTIFICATIONS
 				   NETSNMP_DS_AGENT_DONT_LOG_TCPWRAPPERS_CONNECTS
 				   NETSNMP_DS_AGENT_SKIPNFSINHOSTRESOURCES
+				   NETSNMP_DS_AGENT_NO_SOCK_DIAG
+				   NETSNMP_DS_AGENT_NO_ROUTE_NETLINK
+				   NETSNMP_DS_AGENT_ROUTE_MONITOR
+				   NETSNMP_DS_AGENT_NO_INTERFACE_NETLINK
+				   NETSNMP_DS_AGENT_INTERFACE_MONITOR
+				   NETSNMP_DS_AGENT_EXTEND_REFRESH
 				   NETSNMP_DS_AGENT_PROGNAME
 				   NETSNMP_DS_AGENT_X_SOCKET
 				   NETSNMP_DS_AGENT_PORTS
@@ -55,6 +61,8 @@ use vars qw(@ISA %EXPORT_TAGS @EXPORT_OK @EXPORT $VERSION $AUTOLOAD);
 				   NETSNMP_DS_AGENT_INTERNAL_SECLEVEL
 				   NETSNMP_DS_AGENT_MAX_GETBULKREPEATS
 				   NETSNMP_DS_AGENT_MAX_GETBULKRESPONSES
+				   NETSNMP_DS_AGENT_WORKER_THREADS
+				   NETSNMP_DS_AGENT_AGENTX_WINDOW
 ) ] );
 
 @EXPORT_OK = ( @{ $EXPORT_TAGS{'all'} } );
@@ -73,6 +81,12 @@ use vars qw(@ISA %EXPORT_TAGS @EXPORT_OK @EXPORT $VERSION $AUTOLOAD);
 				   NETSNMP_DS_AGENT_DONT_RETAIN_NOTIFICATIONS
 				   NETSNMP_DS_AGENT_DONT_LOG_TCPWRAPPERS_CONNECTS
 				   NETSNMP_DS_AGENT_SKIPNFSINHOSTRESOURCES
+				   NETSNMP_DS_AGENT_NO_SOCK_DIAG
+				   NETSNMP_DS_AGENT_NO_ROUTE_NETLINK
+				   NETSNMP_DS_AGENT_ROUTE_MONITOR
+				   NETSNMP_DS_AGENT_NO_INTERFACE_NETLINK
+				   NETSNMP_DS_AGENT_INTERFACE_MONITOR
+				   NETSNMP_DS_AGENT_EXTEND_REFRESH
 				   NETSNMP_DS_AGENT_PROGNAME
 				   NETSNMP_DS_AGENT_X_SOCKET
 				   NETSNMP_DS_AGENT_PORTS
@@ -95,6 +109,8 @@ use vars qw(@ISA %EXPORT_TAGS @EXPORT_OK @EXPORT $VERSION $AUTOLOAD);
 				   NETSNMP_DS_AGENT_INTERNAL_SECLEVEL
 				   NETSNMP_DS_AGENT_MAX_GETBULKREPEATS
 				   NETSNMP_DS_AGENT_MAX_GETBULKRESPONSES
+				   NETSNMP_DS_AGENT_WORKER_THREADS
+				   NETSNMP_DS_AGENT_AGENTX_WINDOW
 );
 $VERSION = '5.08';
 
@@ -162,6 +178,12 @@ None by default.
 				   NETSNMP_DS_AGENT_DONT_RETAIN_NOTIFICATIONS
 				   NETSNMP_DS_AGENT_DONT_LOG_TCPWRAPPERS_CONNECTS
 				   NETSNMP_DS_AGENT_SKIPNFSINHOSTRESOURCES
+				   NETSNMP_DS_AGENT_NO_SOCK_DIAG
+				   NETSNMP_DS_AGENT_NO_ROUTE_NETLINK
+				   NETSNMP_DS_AGENT_ROUTE_MONITOR
+				   NETSNMP_DS_AGENT_NO_INTERFACE_NETLINK
+				   NETSNMP_DS_AGENT_INTERFACE_MONITOR
+				   NETSNMP_DS_AGENT_EXTEND_REFRESH
 				   NETSNMP_DS_AGENT_PROGNAME
 				   NETSNMP_DS_AGENT_X_SOCKET
 				   NETSNMP_DS_AGENT_PORTS
@@ -184,6 +206,8 @@ None by default.
 				   NETSNMP_DS_AGENT_INTERNAL_SECLEVEL
 				   NETSNMP_DS_AGENT_MAX_GETBULKREPEATS
 				   NETSNMP_DS_AGENT_MAX_GETBULKRESPONSES
+				   NETSNMP_DS_AGENT_WORKER_THREADS
+				   NETSNMP_DS_AGENT_AGENTX_WINDOW
 
 
 				   NETSNMP_DS_AGENT_VERBOSE
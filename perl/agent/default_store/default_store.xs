@@ -123,17 +123,74 @@ constant_24 (pTHX_ const char *name, IV *iv_return) {
   return PERL_constant_NOTFOUND;
 }
 
+static int
+constant_29 (pTHX_ const char *name, IV *iv_return) {
+  /* When generated this function returned values for the list of names given
+     here.  However, subsequent manual editing may have added or removed some.
+     NETSNMP_DS_AGENT_DISABLE_PERL NETSNMP_DS_AGENT_NO_SOCK_DIAG
+     NETSNMP_DS_AGENT_X_SOCK_GROUP */
+  /* Offset 28 gives the best switch position.  */
+  switch (name[28]) {
+  case 'G':
+    if (memEQ(name, "NETSNMP_DS_AGENT_NO_SOCK_DIA", 28)) {
+    /*                                           G      */
+#ifdef NETSNMP_DS_AGENT_NO_SOCK_DIAG
+      *iv_return = NETSNMP_DS_AGENT_NO_SOCK_DIAG;
+      return PERL_constant_ISIV;
+#else
+      return PERL_constant_NOTDEF;
+#endif
+    }
+    break;
+  case 'L':
+    if (memEQ(name, "NETSNMP_DS_AGENT_DISABLE_PER", 28)) {
+    /*                                           L      */
+#ifdef NETSNMP_DS_AGENT_DISABLE_PERL
+      *iv_return = NETSNMP_DS_AGENT_DISABLE_PERL;
+      return PERL_constant_ISIV;
+#else
+      return PERL_constant_NOTDEF;
+#endif
+    }
+    break;
+  case 'P':
+    if (memEQ(name, "NETSNMP_DS_AGENT_X_SOCK_GROU", 28)) {
+    /*                                           P      */
+#ifdef NETSNMP_DS_AGENT_X_SOCK_GROUP
+      *iv_return = NETSNMP_DS_AGENT_X_SOCK_GROUP;
+      return PERL_constant_ISIV;
+#else
+      return PERL_constant_NOTDEF;
+#endif
+    }
+    break;
+  }
+  return PERL_constant_NOTFOUND;
+}
+
 static int
 constant_30 (pTHX_ const char *name, IV *iv_return) {
   /* When generated this function returned values for the list of names given
      here.  However, subsequent manual editing may have added or removed some.
-     NETSNMP_DS_AGENT_AGENTX_MASTER NETSNMP_DS_AGENT_CACHE_TIMEOUT
-     NETSNMP_DS_AGENT_LEAVE_PIDFILE NETSNMP_DS_AGENT_STRICT_DISMAN */
-  /* Offset 27 gives the best switch position.  */
-  switch (name[27]) {
-  case 'I':
+     NETSNMP_DS_AGENT_AGENTX_MASTER NETSNMP_DS_AGENT_AGENTX_WINDOW
+     NETSNMP_DS_AGENT_CACHE_TIMEOUT NETSNMP_DS_AGENT_LEAVE_PIDFILE
+     NETSNMP_DS_AGENT_ROUTE_MONITOR NETSNMP_DS_AGENT_STRICT_DISMAN */
+  /* Offset 25 gives the best switch position.  */
+  switch (name[25]) {
+  case 'A':
+    if (memEQ(name, "NETSNMP_DS_AGENT_AGENTX_MASTER", 30)) {
+    /*                                        ^           */
+#ifdef NETSNMP_DS_AGENT_AGENTX_MASTER
+      *iv_return = NETSNMP_DS_AGENT_AGENTX_MASTER;
+      return PERL_constant_ISIV;
+#else
+      return PERL_constant_NOTDEF;
+#endif
+    }
+    break;
+  case 'D':
     if (memEQ(name, "NETSNMP_DS_AGENT_LEAVE_PIDFILE", 30)) {
-    /*                                          ^         */
+    /*                                        ^           */
 #ifdef NETSNMP_DS_AGENT_LEAVE_PIDFILE
       *iv_return = NETSNMP_DS_AGENT_LEAVE_PIDFILE;
       return PERL_constant_ISIV;
@@ -142,9 +199,18 @@ constant_30 (pTHX_ const char *name, IV *iv_return) {
 #endif
     }
     break;
-  case 'M':
+  case 'I':
+    if (memEQ(name, "NETSNMP_DS_AGENT_AGENTX_WINDOW", 30)) {
+    /*                                        ^           */
+#ifdef NETSNMP_DS_AGENT_AGENTX_WINDOW
+      *iv_return = NETSNMP_DS_AGENT_AGENTX_WINDOW;
+      return PERL_constant_ISIV;
+#else
+      return PERL_constant_NOTDEF;
+#endif
+    }
     if (memEQ(name, "NETSNMP_DS_AGENT_STRICT_DISMAN", 30)) {
-    /*                                          ^         */
+    /*                                        ^           */
 #ifdef NETSNMP_DS_AGENT_STRICT_DISMAN
       *iv_return = NETSNMP_DS_AGENT_STRICT_DISMAN;
       return PERL_constant_ISIV;
@@ -153,9 +219,9 @@ constant_30 (pTHX_ const char *name, IV *iv_return) {
 #endif
     }
     break;
-  case 'O':
+  case 'M':
     if (memEQ(name, "NETSNMP_DS_AGENT_CACHE_TIMEOUT", 30)) {
-    /*                                          ^         */
+    /*                                        ^           */
 #ifdef NETSNMP_DS_AGENT_CACHE_TIMEOUT
       *iv_return = NETSNMP_DS_AGENT_CACHE_TIMEOUT;
       return PERL_constant_ISIV;
@@ -164,11 +230,11 @@ constant_30 (pTHX_ const char *name, IV *iv_return) {
 #endif
     }
     break;
-  case 'T':
-    if (memEQ(name, "NETSNMP_DS_AGENT_AGENTX_MASTER", 30)) {
-    /*                                          ^         */
-#ifdef NETSNMP_DS_AGENT_AGENTX_MASTER
-      *iv_return = NETSNMP_DS_AGENT_AGENTX_MASTER;
+  case 'N':
+    if (memEQ(name, "NETSNMP_DS_AGENT_ROUTE_MONITOR", 30)) {
+    /*                                        ^           */
+#ifdef NETSNMP_DS_AGENT_ROUTE_MONITOR
+      *iv_return = NETSNMP_DS_AGENT_ROUTE_MONITOR;
       return PERL_constant_ISIV;
 #else
       return PERL_constant_NOTDEF;
@@ -184,12 +250,13 @@ constant_31 (pTHX_ const char *name, IV *iv_return) {
   /* When generated this function returned values for the list of names given
      here.  However, subsequent manual editing may have added or removed some.
      NETSNMP_DS_AGENT_AGENTX_RETRIES NETSNMP_DS_AGENT_AGENTX_TIMEOUT
-     NETSNMP_DS_AGENT_NO_ROOT_ACCESS NETSNMP_DS_AGENT_PERL_INIT_FILE */
-  /* Offset 27 gives the best switch position.  */
-  switch (name[27]) {
+     NETSNMP_DS_AGENT_EXTEND_REFRESH NETSNMP_DS_AGENT_NO_ROOT_ACCESS
+     NETSNMP_DS_AGENT_PERL_INIT_FILE NETSNMP_DS_AGENT_WORKER_THREADS */
+  /* Offset 26 gives the best switch position.  */
+  switch (name[26]) {
   case 'C':
     if (memEQ(name, "NETSNMP_DS_AGENT_NO_ROOT_ACCESS", 31)) {
-    /*                                          ^          */
+    /*                                         ^           */
 #ifdef NETSNMP_DS_AGENT_NO_ROOT_ACCESS
       *iv_return = NETSNMP_DS_AGENT_NO_ROOT_ACCESS;
       return PERL_constant_ISIV;
@@ -198,9 +265,20 @@ constant_31 (pTHX_ const char *name, IV *iv_return) {
 #endif
     }
     break;
-  case 'E':
+  case 'F':
+    if (memEQ(name, "NETSNMP_DS_AGENT_EXTEND_REFRESH", 31)) {
+    /*                                         ^           */
+#ifdef NETSNMP_DS_AGENT_EXTEND_REFRESH
+      *iv_return = NETSNMP_DS_AGENT_EXTEND_REFRESH;
+      return PERL_constant_ISIV;
+#else
+      return PERL_constant_NOTDEF;
+#endif
+    }
+    break;
+  case 'M':
     if (memEQ(name, "NETSNMP_DS_AGENT_AGENTX_TIMEOUT", 31)) {
-    /*                                          ^          */
+    /*                                         ^           */
 #ifdef NETSNMP_DS_AGENT_AGENTX_TIMEOUT
       *iv_return = NETSNMP_DS_AGENT_AGENTX_TIMEOUT;
       return PERL_constant_ISIV;
@@ -209,25 +287,36 @@ constant_31 (pTHX_ const char *name, IV *iv_return) {
 #endif
     }
     break;
-  case 'F':
-    if (memEQ(name, "NETSNMP_DS_AGENT_PERL_INIT_FILE", 31)) {
-    /*                                          ^          */
-#ifdef NETSNMP_DS_AGENT_PERL_INIT_FILE
-      *iv_return = NETSNMP_DS_AGENT_PERL_INIT_FILE;
+  case 'R':
+    if (memEQ(name, "NETSNMP_DS_AGENT_WORKER_THREADS", 31)) {
+    /*                                         ^           */
+#ifdef NETSNMP_DS_AGENT_WORKER_THREADS
+      *iv_return = NETSNMP_DS_AGENT_WORKER_THREADS;
       return PERL_constant_ISIV;
 #else
       return PERL_constant_NOTDEF;
 #endif
     }
     break;
-  case 'R':
+  case 'T':
     if (memEQ(name, "NETSNMP_DS_AGENT_AGENTX_RETRIES", 31)) {
-    /*                                          ^          */
+    /*                                         ^           */
 #ifdef NETSNMP_DS_AGENT_AGENTX_RETRIES
       *iv_return = NETSNMP_DS_AGENT_AGENTX_RETRIES;
       return PERL_constant_ISIV;
 #else
       return PERL_constant_NOTDEF;
+#endif
+    }
+    break;
+  case '_':
+    if (memEQ(name, "NETSNMP_DS_AGENT_PERL_INIT_FILE", 31)) {
+    /*                                         ^           */
+#ifdef NETSNMP_DS_AGENT_PERL_INIT_FILE
+      *iv_return = NETSNMP_DS_AGENT_PERL_INIT_FILE;
+      return PERL_constant_ISIV;
+#else
+      return PERL_constant_NOTDEF;
 #endif
     }
     break;
@@ -240,7 +329,7 @@ constant_33 (pTHX_ const char *name, IV *iv_return) {
   /* When generated this function returned values for the list of names given
      here.  However, subsequent manual editing may have added or removed some.
      NETSNMP_DS_AGENT_INTERNAL_SECNAME NETSNMP_DS_AGENT_INTERNAL_VERSION
-     NETSNMP_DS_AGENT_QUIT_IMMEDIATELY */
+     NETSNMP_DS_AGENT_NO_ROUTE_NETLINK NETSNMP_DS_AGENT_QUIT_IMMEDIATELY */
   /* Offset 31 gives the best switch position.  */
   switch (name[31]) {
   case 'L':
@@ -262,6 +351,17 @@ constant_33 (pTHX_ const char *name, IV *iv_return) {
       return PERL_constant_ISIV;
 #else
       return PERL_constant_NOTDEF;
+#endif
+    }
+    break;
+  case 'N':
+    if (memEQ(name, "NETSNMP_DS_AGENT_NO_ROUTE_NETLINK", 33)) {
+    /*                                              ^        */
+#ifdef NETSNMP_DS_AGENT_NO_ROUTE_NETLINK
+      *iv_return = NETSNMP_DS_AGENT_NO_ROUTE_NETLINK;
+      return PERL_constant_ISIV;
+#else
+      return PERL_constant_NOTDEF;
 #endif
     }
     break;
@@ -280,6 +380,52 @@ constant_33 (pTHX_ const char *name, IV *iv_return) {
   return PERL_constant_NOTFOUND;
 }
 
+static int
+constant_37 (pTHX_ const char *name, IV *iv_return) {
+  /* When generated this function returned values for the list of names given
+     here.  However, subsequent manual editing may have added or removed some.
+     NETSNMP_DS_AGENT_AGENTX_PING_INTERVAL
+     NETSNMP_DS_AGENT_MAX_GETBULKRESPONSES
+     NETSNMP_DS_AGENT_NO_INTERFACE_NETLINK */
+  /* Offset 33 gives the best switch position.  */
+  switch (name[33]) {
+  case 'L':
+    if (memEQ(name, "NETSNMP_DS_AGENT_NO_INTERFACE_NETLINK", 37)) {
+    /*                                                ^          */
+#ifdef NETSNMP_DS_AGENT_NO_INTERFACE_NETLINK
+      *iv_return = NETSNMP_DS_AGENT_NO_INTERFACE_NETLINK;
+      return PERL_constant_ISIV;
+#else
+      return PERL_constant_NOTDEF;
+#endif
+    }
+    break;
+  case 'N':
+    if (memEQ(name, "NETSNMP_DS_AGENT_MAX_GETBULKRESPONSES", 37)) {
+    /*                                                ^          */
+#ifdef NETSNMP_DS_AGENT_MAX_GETBULKRESPONSES
+      *iv_return = NETSNMP_DS_AGENT_MAX_GETBULKRESPONSES;
+      return PERL_constant_ISIV;
+#else
+      return PERL_constant_NOTDEF;
+#endif
+    }
+    break;
+  case 'R':
+    if (memEQ(name, "NETSNMP_DS_AGENT_AGENTX_PING_INTERVAL", 37)) {
+    /*                                                ^          */
+#ifdef NETSNMP_DS_AGENT_AGENTX_PING_INTERVAL
+      *iv_return = NETSNMP_DS_AGENT_AGENTX_PING_INTERVAL;
+      return PERL_constant_ISIV;
+#else
+      return PERL_constant_NOTDEF;
+#endif
+    }
+    break;
+  }
+  return PERL_constant_NOTFOUND;
+}
+
 static int
 constant (pTHX_ const char *name, STRLEN len, IV *iv_return) {
   /* Initially switch on the length of the name.  */
@@ -300,10 +446,12 @@ my $types = {map {($_, 1)} qw(IV)};
 my @names = (qw(NETSNMP_DS_AGENT_AGENTX_MASTER
 	       NETSNMP_DS_AGENT_AGENTX_PING_INTERVAL
 	       NETSNMP_DS_AGENT_AGENTX_RETRIES NETSNMP_DS_AGENT_AGENTX_TIMEOUT
-	       NETSNMP_DS_AGENT_CACHE_TIMEOUT NETSNMP_DS_AGENT_DISABLE_PERL
+	       NETSNMP_DS_AGENT_AGENTX_WINDOW NETSNMP_DS_AGENT_CACHE_TIMEOUT
+	       NETSNMP_DS_AGENT_DISABLE_PERL
 	       NETSNMP_DS_AGENT_DONT_LOG_TCPWRAPPERS_CONNECTS
 	       NETSNMP_DS_AGENT_DONT_RETAIN_NOTIFICATIONS
-	       NETSNMP_DS_AGENT_FLAGS NETSNMP_DS_AGENT_GROUPID
+	       NETSNMP_DS_AGENT_EXTEND_REFRESH NETSNMP_DS_AGENT_FLAGS
+	       NETSNMP_DS_AGENT_GROUPID NETSNMP_DS_AGENT_INTERFACE_MONITOR
 	       NETSNMP_DS_AGENT_INTERNAL_SECLEVEL
 	       NETSNMP_DS_AGENT_INTERNAL_SECNAME
 	       NETSNMP_DS_AGENT_INTERNAL_VERSION NETSNMP_DS_AGENT_LEAVE_PIDFILE
@@ -311,16 +459,19 @@ my @names = (qw(NETSNMP_DS_AGENT_AGENTX_MASTER
 	       NETSNMP_DS_AGENT_MAX_GETBULKRESPONSES
 	       NETSNMP_DS_AGENT_NO_CACHING
 	       NETSNMP_DS_AGENT_NO_CONNECTION_WARNINGS
-	       NETSNMP_DS_AGENT_NO_ROOT_ACCESS NETSNMP_DS_AGENT_PERL_INIT_FILE
-	       NETSNMP_DS_AGENT_PORTS NETSNMP_DS_AGENT_PROGNAME
-	       NETSNMP_DS_AGENT_QUIT_IMMEDIATELY NETSNMP_DS_AGENT_ROLE
+	       NETSNMP_DS_AGENT_NO_INTERFACE_NETLINK
+	       NETSNMP_DS_AGENT_NO_ROOT_ACCESS
+	       NETSNMP_DS_AGENT_NO_ROUTE_NETLINK NETSNMP_DS_AGENT_NO_SOCK_DIAG
+	       NETSNMP_DS_AGENT_PERL_INIT_FILE NETSNMP_DS_AGENT_PORTS
+	       NETSNMP_DS_AGENT_PROGNAME NETSNMP_DS_AGENT_QUIT_IMMEDIATELY
+	       NETSNMP_DS_AGENT_ROLE NETSNMP_DS_AGENT_ROUTE_MONITOR
 	       NETSNMP_DS_AGENT_SKIPNFSINHOSTRESOURCES
 	       NETSNMP_DS_AGENT_STRICT_DISMAN NETSNMP_DS_AGENT_USERID
-	       NETSNMP_DS_AGENT_VERBOSE NETSNMP_DS_AGENT_X_DIR_PERM
-	       NETSNMP_DS_AGENT_X_SOCKET NETSNMP_DS_AGENT_X_SOCK_GROUP
-	       NETSNMP_DS_AGENT_X_SOCK_PERM NETSNMP_DS_AGENT_X_SOCK_USER
-	       NETSNMP_DS_APP_DONT_LOG NETSNMP_DS_NOTIF_LOG_CTX
-	       NETSNMP_DS_SMUX_SOCKET));
+	       NETSNMP_DS_AGENT_VERBOSE NETSNMP_DS_AGENT_WORKER_THREADS
+	       NETSNMP_DS_AGENT_X_DIR_PERM NETSNMP_DS_AGENT_X_SOCKET
+	       NETSNMP_DS_AGENT_X_SOCK_GROUP NETSNMP_DS_AGENT_X_SOCK_PERM
+	       NETSNMP_DS_AGENT_X_SOCK_USER NETSNMP_DS_APP_DONT_LOG
+	       NETSNMP_DS_NOTIF_LOG_CTX NETSNMP_DS_SMUX_SOCKET));
 
 print constant_types(); # macro defs
 foreach (C_constant ("NetSNMP::agent::default_store", 'constant', 'IV', $types, undef, 3, @names) ) {
@@ -465,33 +616,7 @@ __END__
     }
     break;
   case 29:
-    /* Names all of length 29.  */
-    /* NETSNMP_DS_AGENT_DISABLE_PERL NETSNMP_DS_AGENT_X_SOCK_GROUP */
-    /* Offset 21 gives the best switch position.  */
-    switch (name[21]) {
-    case 'B':
-      if (memEQ(name, "NETSNMP_DS_AGENT_DISABLE_PERL", 29)) {
-      /*                                    ^              */
-#ifdef NETSNMP_DS_AGENT_DISABLE_PERL
-        *iv_return = NETSNMP_DS_AGENT_DISABLE_PERL;
-        return PERL_constant_ISIV;
-#else
-        return PERL_constant_NOTDEF;
-#endif
-      }
-      break;
-    case 'C':
-      if (memEQ(name, "NETSNMP_DS_AGENT_X_SOCK_GROUP", 29)) {
-      /*                                    ^              */
-#ifdef NETSNMP_DS_AGENT_X_SOCK_GROUP
-        *iv_return = NETSNMP_DS_AGENT_X_SOCK_GROUP;
-        return PERL_constant_ISIV;
-#else
-        return PERL_constant_NOTDEF;
-#endif
-      }
-      break;
-    }
+    return constant_29 (aTHX_ name, iv_return);
     break;
   case 30:
     return constant_30 (aTHX_ name, iv_return);
@@ -503,13 +628,32 @@ __END__
     return constant_33 (aTHX_ name, iv_return);
     break;
   case 34:
-    if (memEQ(name, "NETSNMP_DS_AGENT_INTERNAL_SECLEVEL", 34)) {
+    /* Names all of length 34.  */
+    /* NETSNMP_DS_AGENT_INTERFACE_MONITOR NETSNMP_DS_AGENT_INTERNAL_SECLEVEL */
+    /* Offset 29 gives the best switch position.  */
+    switch (name[29]) {
+    case 'L':
+      if (memEQ(name, "NETSNMP_DS_AGENT_INTERNAL_SECLEVEL", 34)) {
+      /*                                            ^           */
 #ifdef NETSNMP_DS_AGENT_INTERNAL_SECLEVEL
-      *iv_return = NETSNMP_DS_AGENT_INTERNAL_SECLEVEL;
-      return PERL_constant_ISIV;
+        *iv_return = NETSNMP_DS_AGENT_INTERNAL_SECLEVEL;
+        return PERL_constant_ISIV;
 #else
-      return PERL_constant_NOTDEF;
+        return PERL_constant_NOTDEF;
+#endif
+      }
+      break;
+    case 'N':
+      if (memEQ(name, "NETSNMP_DS_AGENT_INTERFACE_MONITOR", 34)) {
+      /*                                            ^           */
+#ifdef NETSNMP_DS_AGENT_INTERFACE_MONITOR
+        *iv_return = NETSNMP_DS_AGENT_INTERFACE_MONITOR;
+        return PERL_constant_ISIV;
+#else
+        return PERL_constant_NOTDEF;
 #endif
+      }
+      break;
     }
     break;
   case 35:
@@ -523,34 +667,7 @@ __END__
     }
     break;
   case 37:
-    /* Names all of length 37.  */
-    /* NETSNMP_DS_AGENT_AGENTX_PING_INTERVAL
-       NETSNMP_DS_AGENT_MAX_GETBULKRESPONSES */
-    /* Offset 26 gives the best switch position.  */
-    switch (name[26]) {
-    case 'L':
-      if (memEQ(name, "NETSNMP_DS_AGENT_MAX_GETBULKRESPONSES", 37)) {
-      /*                                         ^                 */
-#ifdef NETSNMP_DS_AGENT_MAX_GETBULKRESPONSES
-        *iv_return = NETSNMP_DS_AGENT_MAX_GETBULKRESPONSES;
-        return PERL_constant_ISIV;
-#else
-        return PERL_constant_NOTDEF;
-#endif
-      }
-      break;
-    case 'N':
-      if (memEQ(name, "NETSNMP_DS_AGENT_AGENTX_PING_INTERVAL", 37)) {
-      /*                                         ^                 */
-#ifdef NETSNMP_DS_AGENT_AGENTX_PING_INTERVAL
-        *iv_return = NETSNMP_DS_AGENT_AGENTX_PING_INTERVAL;
-        return PERL_constant_ISIV;
-#else
-        return PERL_constant_NOTDEF;
-#endif
-      }
-      break;
-    }
+    return constant_37 (aTHX_ name, iv_return);
     break;
   case 39:
     /* Names all of length 39.  */
@@ -22,6 +22,12 @@ BEGIN { $| = 1;
                   "NETSNMP_DS_AGENT_DONT_RETAIN_NOTIFICATIONS" => 10,
                   "NETSNMP_DS_AGENT_DONT_LOG_TCPWRAPPERS_CONNECTS" => 12,
                   "NETSNMP_DS_AGENT_SKIPNFSINHOSTRESOURCES" => 13,
+                  "NETSNMP_DS_AGENT_NO_SOCK_DIAG"          => 21,
+                  "NETSNMP_DS_AGENT_NO_ROUTE_NETLINK"      => 22,
+                  "NETSNMP_DS_AGENT_ROUTE_MONITOR"         => 23,
+                  "NETSNMP_DS_AGENT_NO_INTERFACE_NETLINK"  => 24,
+                  "NETSNMP_DS_AGENT_INTERFACE_MONITOR"     => 25,
+                  "NETSNMP_DS_AGENT_EXTEND_REFRESH"        => 26,
                   "NETSNMP_DS_AGENT_PROGNAME"              => 0,
                   "NETSNMP_DS_AGENT_X_SOCKET"              => 1,
                   "NETSNMP_DS_AGENT_PORTS"                 => 2,
@@ -44,6 +50,8 @@ BEGIN { $| = 1;
                   "NETSNMP_DS_AGENT_INTERNAL_SECLEVEL"     => 12,
                   "NETSNMP_DS_AGENT_MAX_GETBULKREPEATS"    => 13,
                   "NETSNMP_DS_AGENT_MAX_GETBULKRESPONSES"  => 14,
+                  "NETSNMP_DS_AGENT_WORKER_THREADS"        => 18,
+                  "NETSNMP_DS_AGENT_AGENTX_WINDOW"         => 19,
 		  );
 
 	print "1.." . (scalar(keys(%tests)) + 2) . "\n"; 
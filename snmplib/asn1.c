@@ -2872,6 +2872,393 @@ asn_realloc(u_char ** pkt, size_t * pkt_len)
 
 #ifdef NETSNMP_USE_REVERSE_ASNENCODING
 
+/**
+ * @internal
+ * makes room for at least needed bytes in front of the offset bytes that
+ * have already been built at the top end of the buffer, with at most one
+ * reallocation (unlike asn_realloc(), which grows the buffer in steps).
+ * Used with the asn_rbuild_size_* functions to size a buffer up front.
+ *
+ * @param pkt     IN/OUT address of the begining of the buffer.
+ * @param pkt_len IN/OUT address to an integer containing the size of pkt.
+ * @param offset  IN number of bytes already built at the end of pkt.
+ * @param needed  IN number of bytes still to be built.
+ *
+ * @return 1 on success, 0 on error (memory cannot be reallocated)
+ */
+int
+asn_realloc_reserve(u_char ** pkt, size_t * pkt_len, size_t offset,
+                    size_t needed)
+{
+    u_char         *new_pkt;
+    size_t          new_pkt_len;
+
+    if (pkt == NULL || pkt_len == NULL || offset > *pkt_len)
+        return 0;
+    if (*pkt != NULL && *pkt_len - offset >= needed)
+        return 1;
+
+    new_pkt_len = offset + needed;
+    if (offset == 0) {
+        /*
+         * nothing to preserve, so don't let realloc() copy the old buffer 
+         */
+        new_pkt = (u_char *) malloc(new_pkt_len);
+        if (new_pkt == NULL)
+            return 0;
+        free(*pkt);
+    } else {
+        new_pkt = (u_char *) realloc(*pkt, new_pkt_len);
+        if (new_pkt == NULL)
+            return 0;
+        memmove(new_pkt + new_pkt_len - offset, new_pkt + *pkt_len - offset,
+                offset);
+    }
+    DEBUGMSGTL(("asn_realloc", " reserved %lu bytes, new_pkt_len %lu\n",
+                (unsigned long)needed, (unsigned long)new_pkt_len));
+    *pkt = new_pkt;
+    *pkt_len = new_pkt_len;
+    return 1;
+}
+
+/**
+ * @internal
+ * returns the size of the tag and length that asn_realloc_rbuild_header()
+ * builds for an object of the given length (not counting the object).
+ *
+ * @param length  IN - length of object
+ */
+size_t
+asn_rbuild_size_header(size_t length)
+{
+    size_t          size = 2;
+
+    if (length > 0x7f)
+        for (; length; length >>= 8)
+            size++;
+    return size;
+}
+
+/**
+ * @internal
+ * returns the size of the object asn_realloc_rbuild_int() builds.
+ *
+ * @param intp    IN - pointer to start of long integer
+ */
+size_t
+asn_rbuild_size_int(const long *intp)
+{
+    long            integer = *intp, testvalue;
+    u_char          last;
+    size_t          size = 1;
+
+    CHECK_OVERFLOW_S(integer,14);
+    testvalue = (integer < 0) ? -1 : 0;
+
+    last = (u_char) integer;
+    integer >>= 8;
+    while (integer != testvalue) {
+        last = (u_char) integer;
+        integer >>= 8;
+        size++;
+    }
+    if ((last & 0x80) != (testvalue & 0x80))
+        size++;
+    return size + asn_rbuild_size_header(size);
+}
+
+/**
+ * @internal
+ * returns the size of the object asn_realloc_rbuild_unsigned_int() builds.
+ *
+ * @param intp    IN - pointer to start of unsigned int
+ */
+size_t
+asn_rbuild_size_unsigned_int(const u_long *intp)
+{
+    u_long          integer = *intp;
+    u_char          last;
+    size_t          size = 1;
+
+    CHECK_OVERFLOW_U(integer,15);
+
+    last = (u_char) integer;
+    integer >>= 8;
+    while (integer != 0) {
+        last = (u_char) integer;
+        integer >>= 8;
+        size++;
+    }
+    if (last & 0x80)
+        size++;
+    return size + asn_rbuild_size_header(size);
+}
+
+/**
+ * @internal
+ * returns the size of the object asn_realloc_rbuild_objid() builds, or 0
+ * if it cannot be encoded.
+ *
+ * @param objid   IN - pointer to the object id
+ * @param objidlength  IN - length of the input 
+ */
+size_t
+asn_rbuild_size_objid(const oid * objid, size_t objidlength)
+{
+    size_t          i, size = 0;
+    oid             tmpint;
+
+    if (objidlength == 0) {
+        size = 2;
+    } else if (objid[0] > 2) {
+        return 0;
+    } else if (objidlength == 1) {
+        size = 1;
+    } else {
+        if ((objid[1] > 40) && (objid[0] < 2))
+            return 0;
+        for (i = 1; i < objidlength; i++) {
+            if (i == 1) {
+                tmpint = (objid[0] * 40) + objid[1];
+            } else {
+                tmpint = objid[i];
+                CHECK_OVERFLOW_U(tmpint,16);
+            }
+            for (size++, tmpint >>= 7; tmpint > 0; tmpint >>= 7)
+                size++;
+        }
+    }
+    return size + asn_rbuild_size_header(size);
+}
+
+/**
+ * @internal
+ * returns the size of the object asn_realloc_rbuild_unsigned_int64()
+ * builds for a Counter64 (not for the opaque special types).
+ *
+ * @param cp      IN - pointer to the counter64
+ */
+size_t
+asn_rbuild_size_unsigned_int64(const struct counter64 *cp)
+{
+    u_long          low = cp->low, high = cp->high;
+    u_char          last;
+    size_t          size = 1;
+
+    CHECK_OVERFLOW_U(high,17);
+    CHECK_OVERFLOW_U(low,17);
+
+    last = (u_char) low;
+    for (low >>= 8; low != 0; low >>= 8) {
+        last = (u_char) low;
+        size++;
+    }
+    if (high) {
+        size = 5;
+        last = (u_char) high;
+        for (high >>= 8; high != 0; high >>= 8) {
+            last = (u_char) high;
+            size++;
+        }
+    }
+    if (last & 0x80)
+        size++;
+    return size + asn_rbuild_size_header(size);
+}
+
+/*
+ * The asn_rbuild_*_unchecked() functions build the same encodings as the
+ * asn_realloc_rbuild_*() functions, backwards from cp (which points just
+ * past the end of the object) to the pointer they return, but without
+ * checking for room or producing any debug output: the caller must have
+ * made sure the object fits, using the asn_rbuild_size_*() functions or
+ * a safe upper bound.
+ */
+
+/**
+ * @internal
+ * builds an ASN header backwards without checks.
+ *
+ * @param cp      IN - end of the header
+ * @param type    IN - type of object
+ * @param length  IN - length of object
+ *
+ * @return start of the header
+ */
+u_char         *
+asn_rbuild_header_unchecked(u_char * cp, u_char type, size_t length)
+{
+    u_char         *end = cp;
+
+    if (length <= 0x7f) {
+        *--cp = (u_char) length;
+    } else {
+        do {
+            *--cp = (u_char) length;
+            length >>= 8;
+        } while (length);
+        length = end - cp;
+        *--cp = (u_char) (length | 0x80);
+    }
+    *--cp = type;
+    return cp;
+}
+
+/**
+ * @internal
+ * builds an ASN object containing an int backwards without checks.
+ *
+ * @param cp      IN - end of the object
+ * @param type    IN - type of object
+ * @param integer IN - the value
+ *
+ * @return start of the object
+ */
+u_char         *
+asn_rbuild_int_unchecked(u_char * cp, u_char type, long integer)
+{
+    u_char         *end = cp;
+    long            testvalue;
+
+    CHECK_OVERFLOW_S(integer,10);
+    testvalue = (integer < 0) ? -1 : 0;
+
+    *--cp = (u_char) integer;
+    for (integer >>= 8; integer != testvalue; integer >>= 8)
+        *--cp = (u_char) integer;
+    if ((*cp & 0x80) != (testvalue & 0x80))
+        *--cp = (u_char) testvalue;
+    return asn_rbuild_header_unchecked(cp, type, end - cp);
+}
+
+/**
+ * @internal
+ * builds an ASN object containing an unsigned int backwards without
+ * checks.
+ *
+ * @param cp      IN - end of the object
+ * @param type    IN - type of object
+ * @param integer IN - the value
+ *
+ * @return start of the object
+ */
+u_char         *
+asn_rbuild_unsigned_int_unchecked(u_char * cp, u_char type, u_long integer)
+{
+    u_char         *end = cp;
+
+    CHECK_OVERFLOW_U(integer,11);
+
+    *--cp = (u_char) integer;
+    for (integer >>= 8; integer != 0; integer >>= 8)
+        *--cp = (u_char) integer;
+    if (*cp & 0x80)
+        *--cp = 0;
+    return asn_rbuild_header_unchecked(cp, type, end - cp);
+}
+
+/**
+ * @internal
+ * builds an ASN object containing a Counter64 (not one of the opaque
+ * special types) backwards without checks.
+ *
+ * @param cp      IN - end of the object
+ * @param type    IN - type of object
+ * @param c64     IN - the value
+ *
+ * @return start of the object
+ */
+u_char         *
+asn_rbuild_unsigned_int64_unchecked(u_char * cp, u_char type,
+                                    const struct counter64 *c64)
+{
+    u_char         *end = cp;
+    u_long          low = c64->low, high = c64->high;
+
+    CHECK_OVERFLOW_U(high,13);
+    CHECK_OVERFLOW_U(low,13);
+
+    *--cp = (u_char) low;
+    for (low >>= 8; low != 0; low >>= 8)
+        *--cp = (u_char) low;
+    if (high) {
+        while (end - cp < 4)
+            *--cp = 0;
+        *--cp = (u_char) high;
+        for (high >>= 8; high != 0; high >>= 8)
+            *--cp = (u_char) high;
+    }
+    if (*cp & 0x80)
+        *--cp = 0;
+    return asn_rbuild_header_unchecked(cp, type, end - cp);
+}
+
+/**
+ * @internal
+ * builds an ASN object containing a string backwards without checks.
+ *
+ * @param cp      IN - end of the object
+ * @param type    IN - type of object
+ * @param str     IN - pointer to start of the string
+ * @param strlength IN - size of the string
+ *
+ * @return start of the object
+ */
+u_char         *
+asn_rbuild_string_unchecked(u_char * cp, u_char type,
+                            const u_char * str, size_t strlength)
+{
+    cp -= strlength;
+    if (strlength)
+        memcpy(cp, str, strlength);
+    return asn_rbuild_header_unchecked(cp, type, strlength);
+}
+
+/**
+ * @internal
+ * builds an ASN object containing an objid backwards without checks.
+ *
+ * @param cp      IN - end of the object
+ * @param type    IN - type of object
+ * @param objid   IN - pointer to the object id
+ * @param objidlength IN - length of the object id
+ *
+ * @return start of the object, or NULL if the object id cannot be
+ * encoded (nothing useful has been built then)
+ */
+u_char         *
+asn_rbuild_objid_unchecked(u_char * cp, u_char type,
+                           const oid * objid, size_t objidlength)
+{
+    u_char         *end = cp;
+    oid             tmpint;
+    size_t          i;
+
+    if (objidlength == 0) {
+        *--cp = 0;
+        *--cp = 0;
+    } else if (objid[0] > 2) {
+        return NULL;
+    } else if (objidlength == 1) {
+        *--cp = (u_char) objid[0];
+    } else {
+        if ((objid[1] > 40) && (objid[0] < 2))
+            return NULL;
+        for (i = objidlength; i > 1; i--) {
+            if (i == 2) {
+                tmpint = (objid[0] * 40) + objid[1];
+            } else {
+                tmpint = objid[i - 1];
+                CHECK_OVERFLOW_U(tmpint,12);
+            }
+            *--cp = (u_char) tmpint & 0x7f;
+            for (tmpint >>= 7; tmpint > 0; tmpint >>= 7)
+                *--cp = (u_char) ((tmpint & 0x7f) | 0x80);
+        }
+    }
+    return asn_rbuild_header_unchecked(cp, type, end - cp);
+}
+
 /**
  * @internal
  * reverse  builds an ASN header for a length with
@@ -20,6 +20,8 @@
 #include <net-snmp/library/container_binary_array.h>
 #include <net-snmp/library/container_list_ssll.h>
 #include <net-snmp/library/container_null.h>
+#include <net-snmp/library/container_hash.h>
+#include <net-snmp/library/container_skiplist.h>
 
 netsnmp_feature_child_of(container_all, libnetsnmp)
 
@@ -98,6 +100,12 @@ netsnmp_container_init_list(void)
 #ifndef NETSNMP_FEATURE_REMOVE_CONTAINER_NULL
     netsnmp_container_null_init();
 #endif /* NETSNMP_FEATURE_REMOVE_CONTAINER_NULL */
+#ifndef NETSNMP_FEATURE_REMOVE_CONTAINER_HASH
+    netsnmp_container_hash_init();
+#endif /* NETSNMP_FEATURE_REMOVE_CONTAINER_HASH */
+#ifndef NETSNMP_FEATURE_REMOVE_CONTAINER_SKIPLIST
+    netsnmp_container_skiplist_init();
+#endif /* NETSNMP_FEATURE_REMOVE_CONTAINER_SKIPLIST */
 
     /*
      * default aliases for some containers
@@ -531,7 +531,7 @@ netsnmp_binary_array_insert(netsnmp_container *c, const void *const_entry)
      */
     if (! (c->flags & CONTAINER_KEY_ALLOW_DUPLICATES) && t->count) {
         i = binary_search(entry, c, 1, &next);
-        if (i > 0) {
+        if (i >= 0) {
             DEBUGMSGTL(("container","not inserting duplicate key\n"));
             return -1;
         }
@@ -554,7 +554,7 @@ netsnmp_binary_array_insert(netsnmp_container *c, const void *const_entry)
         }
 
         pos = next;
-        if ( i > 0 )  /* if key found, advance past any dups */
+        if ( i >= 0 ) /* if key found, advance past any dups */
             while (pos < t->count && c->compare(t->data[pos], entry) == 0)
                 ++pos;
     }
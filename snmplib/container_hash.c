@@ -0,0 +1,713 @@
+/*
+ * container_hash.c
+ * $Id$
+ *
+ * see comments in header file.
+ *
+ */
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-features.h>
+
+#include <stdio.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_MALLOC_H
+#include <malloc.h>
+#endif
+#include <sys/types.h>
+#if HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/types.h>
+#include <net-snmp/library/snmp_api.h>
+#include <net-snmp/library/container.h>
+#include <net-snmp/library/container_hash.h>
+#include <net-snmp/library/tools.h>
+#include <net-snmp/library/snmp_assert.h>
+
+netsnmp_feature_child_of(container_hash, container_types)
+
+/** @defgroup hash_container hash_container
+ *  A container for exact-match lookups.
+ *  @ingroup container
+ *
+ *  Entries are kept in a hash table which doubles in size as it fills,
+ *  so find, insert and remove don't depend on the number of entries.
+ *  The entries are in no particular order: find_next has to look at
+ *  each of them, and for_each and iterators return them in table order.
+ *  Use it for tables only looked up by exact index, or as an additional
+ *  index (netsnmp_container_add_index) on an ordered container.
+ *
+ *  @{
+ */
+
+#ifndef NETSNMP_FEATURE_REMOVE_CONTAINER_HASH
+
+#define HASH_MIN_SIZE   64
+
+typedef struct hash_node_s {
+    void               *data;
+    u_int               hash;
+    struct hash_node_s *next;
+} hash_node;
+
+typedef struct hash_container_s {
+    netsnmp_container            c;
+
+    size_t                       count;    /* number of entries */
+    size_t                       size;     /* number of buckets, power of 2 */
+    hash_node                  **buckets;
+
+    netsnmp_container_hash_func *hash;     /* NULL: pick one from compare */
+} hash_container;
+
+typedef struct hash_iterator_s {
+    netsnmp_iterator base;
+
+    size_t           bucket;
+    hash_node       *pos;
+} hash_iterator;
+
+static netsnmp_iterator *_hash_iterator_get(netsnmp_container *c);
+
+/**********************************************************************
+ *
+ * hash functions for the compare routines in container.c
+ *
+ */
+NETSNMP_STATIC_INLINE u_int
+_hash_mix(u_int h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    return h;
+}
+
+static u_int
+_hash_index(const void *data)
+{
+    const netsnmp_index *idx = (const netsnmp_index *)data;
+    u_int               h = 2166136261U;
+    size_t              i;
+
+    for (i = 0; i < idx->len; i++)
+        h = (h ^ (u_int)idx->oids[i]) * 16777619U;
+    return _hash_mix(h ^ (u_int)idx->len);
+}
+
+static u_int
+_hash_string(const char *s)
+{
+    u_int               h = 2166136261U;
+
+    for (; *s; s++)
+        h = (h ^ (u_char)*s) * 16777619U;
+    return _hash_mix(h);
+}
+
+static u_int
+_hash_key(hash_container *hc, const void *data)
+{
+    netsnmp_container_compare *cmp = hc->c.compare;
+
+    if (hc->hash)
+        return hc->hash(data);
+
+    if (cmp == netsnmp_compare_netsnmp_index)
+        return _hash_index(data);
+    if (cmp == netsnmp_compare_cstring)
+        return _hash_string(*(const char * const *)data);
+    if (cmp == netsnmp_compare_direct_cstring)
+        return _hash_string((const char *)data);
+#ifndef NETSNMP_FEATURE_REMOVE_CONTAINER_COMPARE_LONG
+    if (cmp == netsnmp_compare_long)
+        return _hash_mix((u_int)*(const long *)data);
+#endif
+#ifndef NETSNMP_FEATURE_REMOVE_CONTAINER_COMPARE_ULONG
+    if (cmp == netsnmp_compare_ulong)
+        return _hash_mix((u_int)*(const u_long *)data);
+#endif
+#ifndef NETSNMP_FEATURE_REMOVE_CONTAINER_COMPARE_INT32
+    if (cmp == netsnmp_compare_int32)
+        return _hash_mix((u_int)*(const int32_t *)data);
+#endif
+#ifndef NETSNMP_FEATURE_REMOVE_CONTAINER_COMPARE_UINT32
+    if (cmp == netsnmp_compare_uint32)
+        return _hash_mix((u_int)*(const uint32_t *)data);
+#endif
+
+    /*
+     * unknown key: everything goes in one bucket. Slow, but correct.
+     */
+    return 0;
+}
+
+/**********************************************************************
+ *
+ *
+ *
+ **********************************************************************/
+static hash_node *
+_hash_lookup(hash_container *hc, const void *key, u_int h)
+{
+    hash_node *n;
+
+    for (n = hc->buckets[h & (hc->size - 1)]; n; n = n->next)
+        if (n->hash == h && hc->c.compare(n->data, key) == 0)
+            return n;
+    return NULL;
+}
+
+static int
+_hash_resize(hash_container *hc, size_t size)
+{
+    hash_node **buckets, *n, *next;
+    size_t      i;
+
+    buckets = (hash_node **)calloc(size, sizeof(hash_node *));
+    if (NULL == buckets)
+        return -1;
+
+    for (i = 0; i < hc->size; i++) {
+        for (n = hc->buckets[i]; n; n = next) {
+            next = n->next;
+            n->next = buckets[n->hash & (size - 1)];
+            buckets[n->hash & (size - 1)] = n;
+        }
+    }
+    free(hc->buckets);
+    hc->buckets = buckets;
+    hc->size = size;
+
+    return 0;
+}
+
+static int
+_hash_free(netsnmp_container *c)
+{
+    hash_container *hc = (hash_container *)c;
+    hash_node      *n, *next;
+    size_t          i;
+
+    if (NULL == hc)
+        return 0;
+
+    /*
+     * free our node structures, but not the data
+     */
+    for (i = 0; i < hc->size; i++)
+        for (n = hc->buckets[i]; n; n = next) {
+            next = n->next;
+            free(n);
+        }
+    free(hc->buckets);
+    free(hc);
+    return 0;
+}
+
+static void *
+_hash_find(netsnmp_container *c, const void *data)
+{
+    hash_container *hc = (hash_container *)c;
+    hash_node      *n;
+
+    if ((NULL == c) || (NULL == data) || (0 == hc->count))
+        return NULL;
+
+    n = _hash_lookup(hc, data, _hash_key(hc, data));
+    return n ? n->data : NULL;
+}
+
+static void *
+_hash_find_next(netsnmp_container *c, const void *data)
+{
+    hash_container *hc = (hash_container *)c;
+    hash_node      *n;
+    void           *best = NULL;
+    size_t          i;
+
+    if (NULL == c)
+        return NULL;
+
+    /*
+     * no order to follow: the next entry is the lowest one above data.
+     */
+    for (i = 0; i < hc->size; i++)
+        for (n = hc->buckets[i]; n; n = n->next) {
+            if (data && c->compare(n->data, data) <= 0)
+                continue;
+            if ((NULL == best) || (c->compare(n->data, best) < 0))
+                best = n->data;
+        }
+
+    return best;
+}
+
+static int
+_hash_insert(netsnmp_container *c, const void *data)
+{
+    hash_container *hc = (hash_container *)c;
+    hash_node      *n;
+    u_int           h, b;
+
+    if ((NULL == c) || (NULL == data))
+        return -1;
+
+    h = _hash_key(hc, data);
+    if (!(c->flags & CONTAINER_KEY_ALLOW_DUPLICATES) &&
+        _hash_lookup(hc, data, h)) {
+        DEBUGMSGTL(("container","not inserting duplicate key\n"));
+        return -1;
+    }
+
+    if (hc->count >= hc->size)
+        (void)_hash_resize(hc, hc->size * 2); /* full is fine, just slower */
+
+    n = SNMP_MALLOC_TYPEDEF(hash_node);
+    if (NULL == n)
+        return -1;
+    n->data = NETSNMP_REMOVE_CONST(void *, data);
+    n->hash = h;
+    b = h & (hc->size - 1);
+    n->next = hc->buckets[b];
+    hc->buckets[b] = n;
+
+    ++hc->count;
+    ++c->sync;
+
+    return 0;
+}
+
+static int
+_hash_remove(netsnmp_container *c, const void *data)
+{
+    hash_container *hc = (hash_container *)c;
+    hash_node      *n, **prev;
+    u_int           h;
+
+    if ((NULL == c) || (NULL == data) || (0 == hc->count))
+        return -1;
+
+    h = _hash_key(hc, data);
+    for (prev = &hc->buckets[h & (hc->size - 1)]; (n = *prev);
+         prev = &n->next)
+        if (n->hash == h && c->compare(n->data, data) == 0)
+            break;
+    if (NULL == n)
+        return -1;
+
+    /*
+     * free our node structure, but not the data
+     */
+    *prev = n->next;
+    free(n);
+    --hc->count;
+    ++c->sync;
+
+    return 0;
+}
+
+static size_t
+_hash_size(netsnmp_container *c)
+{
+    hash_container *hc = (hash_container *)c;
+
+    if (NULL == c)
+        return 0;
+
+    return hc->count;
+}
+
+static void
+_hash_for_each(netsnmp_container *c, netsnmp_container_obj_func *f,
+               void *context)
+{
+    hash_container *hc = (hash_container *)c;
+    hash_node      *n, *next;
+    size_t          i;
+
+    if (NULL == c)
+        return;
+
+    for (i = 0; i < hc->size; i++)
+        for (n = hc->buckets[i]; n; n = next) {
+            next = n->next;
+            (*f) (n->data, context);
+        }
+}
+
+static void
+_hash_clear(netsnmp_container *c, netsnmp_container_obj_func *f,
+            void *context)
+{
+    hash_container *hc = (hash_container *)c;
+    hash_node      *n, *next;
+    size_t          i;
+
+    if (NULL == c)
+        return;
+
+    for (i = 0; i < hc->size; i++) {
+        for (n = hc->buckets[i]; n; n = next) {
+            next = n->next;
+            if (NULL != f)
+                (*f) (n->data, context);
+            free(n);
+        }
+        hc->buckets[i] = NULL;
+    }
+    hc->count = 0;
+    ++c->sync;
+}
+
+static netsnmp_void_array *
+_hash_get_subset(netsnmp_container *c, void *data)
+{
+    hash_container     *hc = (hash_container *)c;
+    netsnmp_void_array *va;
+    hash_node          *n;
+    size_t              i, len = 0;
+
+    if ((NULL == c) || (NULL == data) || (NULL == c->ncompare))
+        return NULL;
+
+    for (i = 0; i < hc->size; i++)
+        for (n = hc->buckets[i]; n; n = n->next)
+            if (c->ncompare(n->data, data) == 0)
+                ++len;
+    if (0 == len)
+        return NULL;
+
+    va = SNMP_MALLOC_TYPEDEF(netsnmp_void_array);
+    if (NULL == va)
+        return NULL;
+    va->array = (void **)malloc(len * sizeof(void *));
+    if (NULL == va->array) {
+        free(va);
+        return NULL;
+    }
+    va->size = 0;
+    for (i = 0; i < hc->size; i++)
+        for (n = hc->buckets[i]; n; n = n->next)
+            if (c->ncompare(n->data, data) == 0)
+                va->array[va->size++] = n->data;
+
+    return va;
+}
+
+static int
+_hash_options(netsnmp_container *c, int set, u_int flags)
+{
+    if (set) {
+        /** always unsorted, so that one is free */
+        if ((flags & (CONTAINER_KEY_ALLOW_DUPLICATES |
+                      CONTAINER_KEY_UNSORTED)) != flags)
+            return -1; /* unsupported flag */
+        c->flags = flags;
+        return flags;
+    }
+    return ((c->flags & flags) == flags);
+}
+
+static hash_container *
+_hash_create(size_t size)
+{
+    hash_container *hc = SNMP_MALLOC_TYPEDEF(hash_container);
+    if (NULL == hc) {
+        snmp_log(LOG_ERR, "couldn't allocate memory\n");
+        return NULL;
+    }
+
+    hc->size = size;
+    hc->buckets = (hash_node **)calloc(hc->size, sizeof(hash_node *));
+    if (NULL == hc->buckets) {
+        snmp_log(LOG_ERR, "couldn't allocate memory\n");
+        free(hc);
+        return NULL;
+    }
+    return hc;
+}
+
+static netsnmp_container *_hash_setup(hash_container *hc);
+
+static netsnmp_container *
+_hash_duplicate(netsnmp_container *c, void *ctx, u_int flags)
+{
+    hash_container *hc = (hash_container *)c, *dup;
+    hash_node      *n, *dn;
+    size_t          i;
+
+    if (flags) {
+        snmp_log(LOG_ERR, "hash duplicate does not support flags yet\n");
+        return NULL;
+    }
+
+    dup = _hash_create(hc->size);
+    if (NULL == dup)
+        return NULL;
+    _hash_setup(dup);
+    dup->hash = hc->hash;
+    if (netsnmp_container_data_dup(&dup->c, c) != 0) {
+        _hash_free(&dup->c);
+        return NULL;
+    }
+
+    /*
+     * shallow copy, bucket for bucket
+     */
+    for (i = 0; i < hc->size; i++)
+        for (n = hc->buckets[i]; n; n = n->next) {
+            dn = SNMP_MALLOC_TYPEDEF(hash_node);
+            if (NULL == dn) {
+                snmp_log(LOG_ERR, "no memory for hash duplicate\n");
+                _hash_free(&dup->c);
+                return NULL;
+            }
+            dn->data = n->data;
+            dn->hash = n->hash;
+            dn->next = dup->buckets[i];
+            dup->buckets[i] = dn;
+            ++dup->count;
+        }
+
+    return &dup->c;
+}
+
+static netsnmp_container *
+_hash_setup(hash_container *hc)
+{
+    netsnmp_init_container(&hc->c, NULL, _hash_free, _hash_size, NULL,
+                           _hash_insert, _hash_remove, _hash_find);
+    hc->c.find_next = _hash_find_next;
+    hc->c.get_subset = _hash_get_subset;
+    hc->c.get_iterator = _hash_iterator_get;
+    hc->c.for_each = _hash_for_each;
+    hc->c.clear = _hash_clear;
+    hc->c.options = _hash_options;
+    hc->c.duplicate = _hash_duplicate;
+
+    return &hc->c;
+}
+
+/**********************************************************************
+ *
+ *
+ *
+ **********************************************************************/
+netsnmp_container *
+netsnmp_container_get_hash(void)
+{
+    hash_container *hc = _hash_create(HASH_MIN_SIZE);
+    if (NULL == hc)
+        return NULL; /* msg already logged */
+
+    return _hash_setup(hc);
+}
+
+netsnmp_factory *
+netsnmp_container_get_hash_factory(void)
+{
+    static netsnmp_factory f = {"hash",
+                                (netsnmp_factory_produce_f*)
+                                netsnmp_container_get_hash };
+
+    return &f;
+}
+
+int
+netsnmp_container_hash_set_func(netsnmp_container *c,
+                                netsnmp_container_hash_func *f)
+{
+    hash_container *hc = (hash_container *)c;
+    hash_node      *n;
+    size_t          i;
+
+    if ((NULL == c) || (c->cfree != _hash_free))
+        return -1;
+
+    hc->hash = f;
+
+    /*
+     * entries already in the table move to their new buckets
+     */
+    for (i = 0; i < hc->size; i++)
+        for (n = hc->buckets[i]; n; n = n->next)
+            n->hash = _hash_key(hc, n->data);
+    return _hash_resize(hc, hc->size);
+}
+
+void
+netsnmp_container_hash_init(void)
+{
+    netsnmp_container_register("hash",
+                               netsnmp_container_get_hash_factory());
+}
+
+
+/**********************************************************************
+ *
+ * iterator
+ *
+ */
+NETSNMP_STATIC_INLINE hash_container *
+_hash_it2cont(hash_iterator *it)
+{
+    if(NULL == it) {
+        netsnmp_assert(NULL != it);
+        return NULL;
+    }
+
+    if(NULL == it->base.container) {
+        netsnmp_assert(NULL != it->base.container);
+        return NULL;
+    }
+
+    if(it->base.container->sync != it->base.sync) {
+        DEBUGMSGTL(("container:iterator", "out of sync\n"));
+        return NULL;
+    }
+
+    return (hash_container *)it->base.container;
+}
+
+/*
+ * first node at or after the given bucket
+ */
+static hash_node *
+_hash_iterator_seek(hash_iterator *it, hash_container *hc, size_t bucket)
+{
+    for (it->bucket = bucket; it->bucket < hc->size; it->bucket++)
+        if (hc->buckets[it->bucket])
+            return hc->buckets[it->bucket];
+    return NULL;
+}
+
+static void *
+_hash_iterator_curr(hash_iterator *it)
+{
+    hash_container *hc = _hash_it2cont(it);
+    if ((NULL == hc) || (NULL == it->pos))
+        return NULL;
+
+    return it->pos->data;
+}
+
+static void *
+_hash_iterator_first(hash_iterator *it)
+{
+    hash_container *hc = _hash_it2cont(it);
+    size_t          i;
+
+    if (NULL == hc)
+        return NULL;
+
+    for (i = 0; i < hc->size; i++)
+        if (hc->buckets[i])
+            return hc->buckets[i]->data;
+    return NULL;
+}
+
+static void *
+_hash_iterator_next(hash_iterator *it)
+{
+    hash_container *hc = _hash_it2cont(it);
+    if ((NULL == hc) || (NULL == it->pos))
+        return NULL;
+
+    it->pos = it->pos->next;
+    if (NULL == it->pos)
+        it->pos = _hash_iterator_seek(it, hc, it->bucket + 1);
+
+    return it->pos ? it->pos->data : NULL;
+}
+
+static void *
+_hash_iterator_last(hash_iterator *it)
+{
+    hash_container *hc = _hash_it2cont(it);
+    hash_node      *n;
+    size_t          i;
+
+    if (NULL == hc)
+        return NULL;
+
+    for (i = hc->size; i > 0; i--)
+        if ((n = hc->buckets[i - 1])) {
+            while (n->next)
+                n = n->next;
+            return n->data;
+        }
+    return NULL;
+}
+
+static int
+_hash_iterator_reset(hash_iterator *it)
+{
+    hash_container *hc;
+
+    /** can't use it2cont cuz we might be out of sync */
+    if(NULL == it) {
+        netsnmp_assert(NULL != it);
+        return -1;
+    }
+
+    if(NULL == it->base.container) {
+        netsnmp_assert(NULL != it->base.container);
+        return -1;
+    }
+    hc = (hash_container *)it->base.container;
+
+    it->pos = _hash_iterator_seek(it, hc, 0);
+
+    /*
+     * save sync count, to make sure container doesn't change while
+     * iterator is in use.
+     */
+    it->base.sync = it->base.container->sync;
+
+    return 0;
+}
+
+static int
+_hash_iterator_release(netsnmp_iterator *it)
+{
+    free(it);
+
+    return 0;
+}
+
+static netsnmp_iterator *
+_hash_iterator_get(netsnmp_container *c)
+{
+    hash_iterator* it;
+
+    if(NULL == c)
+        return NULL;
+
+    it = SNMP_MALLOC_TYPEDEF(hash_iterator);
+    if(NULL == it)
+        return NULL;
+
+    it->base.container = c;
+
+    it->base.first = (netsnmp_iterator_rtn*)_hash_iterator_first;
+    it->base.next = (netsnmp_iterator_rtn*)_hash_iterator_next;
+    it->base.curr = (netsnmp_iterator_rtn*)_hash_iterator_curr;
+    it->base.last = (netsnmp_iterator_rtn*)_hash_iterator_last;
+    it->base.reset = (netsnmp_iterator_rc*)_hash_iterator_reset;
+    it->base.release = (netsnmp_iterator_rc*)_hash_iterator_release;
+
+    (void)_hash_iterator_reset(it);
+
+    return (netsnmp_iterator *)it;
+}
+#else  /* NETSNMP_FEATURE_REMOVE_CONTAINER_HASH */
+netsnmp_feature_unused(container_hash);
+#endif /* NETSNMP_FEATURE_REMOVE_CONTAINER_HASH */
+/**  @} */
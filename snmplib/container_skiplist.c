@@ -0,0 +1,588 @@
+/*
+ * container_skiplist.c
+ * $Id$
+ *
+ * see comments in header file.
+ *
+ */
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-features.h>
+
+#include <stdio.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_MALLOC_H
+#include <malloc.h>
+#endif
+#include <sys/types.h>
+#if HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/types.h>
+#include <net-snmp/library/snmp_api.h>
+#include <net-snmp/library/container.h>
+#include <net-snmp/library/container_skiplist.h>
+#include <net-snmp/library/tools.h>
+#include <net-snmp/library/snmp_assert.h>
+
+netsnmp_feature_child_of(container_skiplist, container_types)
+
+/** @defgroup skiplist_container skiplist_container
+ *  A sorted container for tables with many changes.
+ *  @ingroup container
+ *
+ *  Entries are kept in a sorted linked list, with every fourth node or
+ *  so also on a second list skipping ahead, every sixteenth on a third,
+ *  and so on.  Lookups, GETNEXT, inserts and removes take log(n) steps
+ *  and never move other entries around, where the binary_array has to
+ *  shift its tail on each insert and remove, or sort the whole array
+ *  after unsorted inserts.
+ *
+ *  @{
+ */
+
+#ifndef NETSNMP_FEATURE_REMOVE_CONTAINER_SKIPLIST
+
+#define SKIPLIST_MAX_LEVEL  16          /* enough for 4^16 entries */
+
+typedef struct skiplist_node_s {
+    void                   *data;
+    struct skiplist_node_s *next[1];    /* one for each level of the node */
+} skiplist_node;
+
+typedef struct skiplist_container_s {
+    netsnmp_container          c;
+
+    size_t                     count;   /* number of entries */
+    int                        level;   /* levels in use */
+    u_int                      seed;    /* for picking node levels */
+    skiplist_node             *head;    /* SKIPLIST_MAX_LEVEL levels, no data */
+} skiplist_container;
+
+typedef struct skiplist_iterator_s {
+    netsnmp_iterator base;
+
+    skiplist_node   *pos;
+} skiplist_iterator;
+
+static netsnmp_iterator *_skiplist_iterator_get(netsnmp_container *c);
+
+/**********************************************************************
+ *
+ *
+ *
+ **********************************************************************/
+static skiplist_node *
+_skiplist_node_new(int level)
+{
+    return (skiplist_node *)calloc(1, sizeof(skiplist_node) +
+                                   (level - 1) * sizeof(skiplist_node *));
+}
+
+/*
+ * a node is on level i+1 with a chance of one in four, given it's on
+ * level i.
+ */
+static int
+_skiplist_random_level(skiplist_container *sl)
+{
+    u_int r;
+    int   level = 1;
+
+    sl->seed ^= sl->seed << 13;
+    sl->seed ^= sl->seed >> 17;
+    sl->seed ^= sl->seed << 5;
+    for (r = sl->seed; (r & 3) == 0 && level < SKIPLIST_MAX_LEVEL; r >>= 2)
+        ++level;
+    return level;
+}
+
+/*
+ * find, on each level, the last node before key: the last one comparing
+ * lower, or with le set, lower or equal. The head if there is none.
+ */
+static skiplist_node *
+_skiplist_search(skiplist_container *sl, netsnmp_container_compare *cmp,
+                 const void *key, int le, skiplist_node **update)
+{
+    skiplist_node *x = sl->head, *n, *stop = NULL;
+    int            i, rc;
+
+    for (i = sl->level - 1; i >= 0; i--) {
+        /** the node which stopped us on the level above stops us here */
+        while ((n = x->next[i]) && n != stop &&
+               ((rc = cmp(n->data, key)) < 0 || (le && rc == 0)))
+            x = n;
+        stop = n;
+        if (update)
+            update[i] = x;
+    }
+    return x;
+}
+
+static int
+_skiplist_free(netsnmp_container *c)
+{
+    skiplist_container *sl = (skiplist_container *)c;
+    skiplist_node      *n, *next;
+
+    if (NULL == sl)
+        return 0;
+
+    /*
+     * free our node structures, but not the data
+     */
+    for (n = sl->head; n; n = next) {
+        next = n->next[0];
+        free(n);
+    }
+    free(sl);
+    return 0;
+}
+
+static void *
+_skiplist_find(netsnmp_container *c, const void *data)
+{
+    skiplist_container *sl = (skiplist_container *)c;
+    skiplist_node      *n;
+
+    if ((NULL == c) || (NULL == data))
+        return NULL;
+
+    n = _skiplist_search(sl, c->compare, data, 0, NULL)->next[0];
+    if (n && c->compare(n->data, data) == 0)
+        return n->data;
+    return NULL;
+}
+
+static void *
+_skiplist_find_next(netsnmp_container *c, const void *data)
+{
+    skiplist_container *sl = (skiplist_container *)c;
+    skiplist_node      *n;
+
+    if (NULL == c)
+        return NULL;
+
+    if (NULL == data)
+        n = sl->head->next[0];
+    else
+        n = _skiplist_search(sl, c->compare, data, 1, NULL)->next[0];
+    return n ? n->data : NULL;
+}
+
+static int
+_skiplist_insert(netsnmp_container *c, const void *data)
+{
+    skiplist_container *sl = (skiplist_container *)c;
+    skiplist_node      *update[SKIPLIST_MAX_LEVEL], *x, *n;
+    int                 i, level;
+
+    if ((NULL == c) || (NULL == data))
+        return -1;
+
+    /*
+     * duplicates go after the entries already there
+     */
+    x = _skiplist_search(sl, c->compare, data, 1, update);
+    if (!(c->flags & CONTAINER_KEY_ALLOW_DUPLICATES) &&
+        (x != sl->head) && (c->compare(x->data, data) == 0)) {
+        DEBUGMSGTL(("container","not inserting duplicate key\n"));
+        return -1;
+    }
+
+    level = _skiplist_random_level(sl);
+    n = _skiplist_node_new(level);
+    if (NULL == n)
+        return -1;
+    n->data = NETSNMP_REMOVE_CONST(void *, data);
+
+    for (; sl->level < level; ++sl->level)
+        update[sl->level] = sl->head;
+    for (i = 0; i < level; i++) {
+        n->next[i] = update[i]->next[i];
+        update[i]->next[i] = n;
+    }
+
+    ++sl->count;
+    ++c->sync;
+
+    return 0;
+}
+
+static int
+_skiplist_remove(netsnmp_container *c, const void *data)
+{
+    skiplist_container *sl = (skiplist_container *)c;
+    skiplist_node      *update[SKIPLIST_MAX_LEVEL], *n;
+    int                 i;
+
+    if ((NULL == c) || (NULL == data))
+        return -1;
+
+    n = _skiplist_search(sl, c->compare, data, 0, update)->next[0];
+    if ((NULL == n) || (c->compare(n->data, data) != 0))
+        return -1;
+
+    for (i = 0; i < sl->level && update[i]->next[i] == n; i++)
+        update[i]->next[i] = n->next[i];
+    while (sl->level > 1 && NULL == sl->head->next[sl->level - 1])
+        --sl->level;
+
+    /*
+     * free our node structure, but not the data
+     */
+    free(n);
+    --sl->count;
+    ++c->sync;
+
+    return 0;
+}
+
+static size_t
+_skiplist_size(netsnmp_container *c)
+{
+    skiplist_container *sl = (skiplist_container *)c;
+
+    if (NULL == c)
+        return 0;
+
+    return sl->count;
+}
+
+static void
+_skiplist_for_each(netsnmp_container *c, netsnmp_container_obj_func *f,
+                   void *context)
+{
+    skiplist_container *sl = (skiplist_container *)c;
+    skiplist_node      *n, *next;
+
+    if (NULL == c)
+        return;
+
+    for (n = sl->head->next[0]; n; n = next) {
+        next = n->next[0];
+        (*f) (n->data, context);
+    }
+}
+
+static void
+_skiplist_clear(netsnmp_container *c, netsnmp_container_obj_func *f,
+                void *context)
+{
+    skiplist_container *sl = (skiplist_container *)c;
+    skiplist_node      *n, *next;
+    int                 i;
+
+    if (NULL == c)
+        return;
+
+    for (n = sl->head->next[0]; n; n = next) {
+        next = n->next[0];
+        if (NULL != f)
+            (*f) (n->data, context);
+        free(n);
+    }
+    for (i = 0; i < SKIPLIST_MAX_LEVEL; i++)
+        sl->head->next[i] = NULL;
+    sl->level = 1;
+    sl->count = 0;
+    ++c->sync;
+}
+
+static netsnmp_void_array *
+_skiplist_get_subset(netsnmp_container *c, void *data)
+{
+    skiplist_container *sl = (skiplist_container *)c;
+    netsnmp_void_array *va;
+    skiplist_node      *start, *n;
+    size_t              len = 0;
+
+    if ((NULL == c) || (NULL == data))
+        return NULL;
+    netsnmp_assert(c->ncompare);
+    if (NULL == c->ncompare)
+        return NULL;
+
+    start = _skiplist_search(sl, c->ncompare, data, 0, NULL)->next[0];
+    for (n = start; n && c->ncompare(n->data, data) == 0; n = n->next[0])
+        ++len;
+    if (0 == len)
+        return NULL;
+
+    va = SNMP_MALLOC_TYPEDEF(netsnmp_void_array);
+    if (NULL == va)
+        return NULL;
+    va->array = (void **)malloc(len * sizeof(void *));
+    if (NULL == va->array) {
+        free(va);
+        return NULL;
+    }
+    for (n = start; va->size < len; n = n->next[0])
+        va->array[va->size++] = n->data;
+
+    return va;
+}
+
+static int
+_skiplist_options(netsnmp_container *c, int set, u_int flags)
+{
+    if (set) {
+        if ((flags & CONTAINER_KEY_ALLOW_DUPLICATES) != flags)
+            return -1; /* unsupported flag */
+        c->flags = flags;
+        return flags;
+    }
+    return ((c->flags & flags) == flags);
+}
+
+static netsnmp_container *
+_skiplist_duplicate(netsnmp_container *c, void *ctx, u_int flags)
+{
+    skiplist_container *sl = (skiplist_container *)c, *dup;
+    skiplist_node      *last[SKIPLIST_MAX_LEVEL], *n, *dn;
+    int                 i, level;
+
+    if (flags) {
+        snmp_log(LOG_ERR, "skiplist duplicate does not support flags yet\n");
+        return NULL;
+    }
+
+    dup = (skiplist_container *)netsnmp_container_get_skiplist();
+    if (NULL == dup)
+        return NULL;
+    if (netsnmp_container_data_dup(&dup->c, c) != 0) {
+        _skiplist_free(&dup->c);
+        return NULL;
+    }
+
+    /*
+     * shallow copy; entries come in order, so append each one.
+     */
+    for (i = 0; i < SKIPLIST_MAX_LEVEL; i++)
+        last[i] = dup->head;
+    for (n = sl->head->next[0]; n; n = n->next[0]) {
+        level = _skiplist_random_level(dup);
+        dn = _skiplist_node_new(level);
+        if (NULL == dn) {
+            snmp_log(LOG_ERR, "no memory for skiplist duplicate\n");
+            _skiplist_free(&dup->c);
+            return NULL;
+        }
+        dn->data = n->data;
+        for (i = 0; i < level; i++) {
+            last[i]->next[i] = dn;
+            last[i] = dn;
+        }
+        if (dup->level < level)
+            dup->level = level;
+        ++dup->count;
+    }
+
+    return &dup->c;
+}
+
+/**********************************************************************
+ *
+ *
+ *
+ **********************************************************************/
+netsnmp_container *
+netsnmp_container_get_skiplist(void)
+{
+    /*
+     * allocate memory
+     */
+    skiplist_container *sl = SNMP_MALLOC_TYPEDEF(skiplist_container);
+    if (NULL == sl) {
+        snmp_log(LOG_ERR, "couldn't allocate memory\n");
+        return NULL;
+    }
+    sl->head = _skiplist_node_new(SKIPLIST_MAX_LEVEL);
+    if (NULL == sl->head) {
+        snmp_log(LOG_ERR, "couldn't allocate memory\n");
+        free(sl);
+        return NULL;
+    }
+    sl->level = 1;
+    sl->seed = 2463534242U;
+
+    netsnmp_init_container((netsnmp_container *)sl, NULL, _skiplist_free,
+                           _skiplist_size, NULL, _skiplist_insert,
+                           _skiplist_remove, _skiplist_find);
+    sl->c.find_next = _skiplist_find_next;
+    sl->c.get_subset = _skiplist_get_subset;
+    sl->c.get_iterator = _skiplist_iterator_get;
+    sl->c.for_each = _skiplist_for_each;
+    sl->c.clear = _skiplist_clear;
+    sl->c.options = _skiplist_options;
+    sl->c.duplicate = _skiplist_duplicate;
+
+    return (netsnmp_container *)sl;
+}
+
+netsnmp_factory *
+netsnmp_container_get_skiplist_factory(void)
+{
+    static netsnmp_factory f = {"skiplist",
+                                (netsnmp_factory_produce_f*)
+                                netsnmp_container_get_skiplist };
+
+    return &f;
+}
+
+void
+netsnmp_container_skiplist_init(void)
+{
+    netsnmp_container_register("skiplist",
+                               netsnmp_container_get_skiplist_factory());
+}
+
+
+/**********************************************************************
+ *
+ * iterator
+ *
+ */
+NETSNMP_STATIC_INLINE skiplist_container *
+_skiplist_it2cont(skiplist_iterator *it)
+{
+    if(NULL == it) {
+        netsnmp_assert(NULL != it);
+        return NULL;
+    }
+
+    if(NULL == it->base.container) {
+        netsnmp_assert(NULL != it->base.container);
+        return NULL;
+    }
+
+    if(it->base.container->sync != it->base.sync) {
+        DEBUGMSGTL(("container:iterator", "out of sync\n"));
+        return NULL;
+    }
+
+    return (skiplist_container *)it->base.container;
+}
+
+static void *
+_skiplist_iterator_curr(skiplist_iterator *it)
+{
+    skiplist_container *sl = _skiplist_it2cont(it);
+    if ((NULL == sl) || (NULL == it->pos))
+        return NULL;
+
+    return it->pos->data;
+}
+
+static void *
+_skiplist_iterator_first(skiplist_iterator *it)
+{
+    skiplist_container *sl = _skiplist_it2cont(it);
+    if ((NULL == sl) || (NULL == sl->head->next[0]))
+        return NULL;
+
+    return sl->head->next[0]->data;
+}
+
+static void *
+_skiplist_iterator_next(skiplist_iterator *it)
+{
+    skiplist_container *sl = _skiplist_it2cont(it);
+    if ((NULL == sl) || (NULL == it->pos))
+        return NULL;
+
+    it->pos = it->pos->next[0];
+    if (NULL == it->pos)
+        return NULL;
+
+    return it->pos->data;
+}
+
+static void *
+_skiplist_iterator_last(skiplist_iterator *it)
+{
+    skiplist_container *sl = _skiplist_it2cont(it);
+    skiplist_node      *x;
+    int                 i;
+
+    if (NULL == sl)
+        return NULL;
+
+    for (x = sl->head, i = sl->level - 1; i >= 0; i--)
+        while (x->next[i])
+            x = x->next[i];
+
+    return (x == sl->head) ? NULL : x->data;
+}
+
+static int
+_skiplist_iterator_reset(skiplist_iterator *it)
+{
+    skiplist_container *sl;
+
+    /** can't use it2cont cuz we might be out of sync */
+    if(NULL == it) {
+        netsnmp_assert(NULL != it);
+        return -1;
+    }
+
+    if(NULL == it->base.container) {
+        netsnmp_assert(NULL != it->base.container);
+        return -1;
+    }
+    sl = (skiplist_container *)it->base.container;
+
+    it->pos = sl->head->next[0];
+
+    /*
+     * save sync count, to make sure container doesn't change while
+     * iterator is in use.
+     */
+    it->base.sync = it->base.container->sync;
+
+    return 0;
+}
+
+static int
+_skiplist_iterator_release(netsnmp_iterator *it)
+{
+    free(it);
+
+    return 0;
+}
+
+static netsnmp_iterator *
+_skiplist_iterator_get(netsnmp_container *c)
+{
+    skiplist_iterator* it;
+
+    if(NULL == c)
+        return NULL;
+
+    it = SNMP_MALLOC_TYPEDEF(skiplist_iterator);
+    if(NULL == it)
+        return NULL;
+
+    it->base.container = c;
+
+    it->base.first = (netsnmp_iterator_rtn*)_skiplist_iterator_first;
+    it->base.next = (netsnmp_iterator_rtn*)_skiplist_iterator_next;
+    it->base.curr = (netsnmp_iterator_rtn*)_skiplist_iterator_curr;
+    it->base.last = (netsnmp_iterator_rtn*)_skiplist_iterator_last;
+    it->base.reset = (netsnmp_iterator_rc*)_skiplist_iterator_reset;
+    it->base.release = (netsnmp_iterator_rc*)_skiplist_iterator_release;
+
+    (void)_skiplist_iterator_reset(it);
+
+    return (netsnmp_iterator *)it;
+}
+#else  /* NETSNMP_FEATURE_REMOVE_CONTAINER_SKIPLIST */
+netsnmp_feature_unused(container_skiplist);
+#endif /* NETSNMP_FEATURE_REMOVE_CONTAINER_SKIPLIST */
+/**  @} */
@@ -9,9 +9,28 @@
 #include <net-snmp/library/fd_event_manager.h>
 #include <net-snmp/library/snmp_logging.h>
 #include <net-snmp/library/large_fd_set.h>
+#ifdef NETSNMP_USE_EPOLL
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#endif
 
 netsnmp_feature_child_of(fd_event_manager, libnetsnmp)
 
+#ifdef NETSNMP_USE_EPOLL
+/*
+ * epoll backend state: the epoll set (-2 until first use, -1 if it could
+ * not be created) and the NETSNMP_FD_EVENT_* interest registered for each
+ * fd, indexed by fd.
+ */
+static int      epoll_fd = -2;
+static u_char  *epoll_interest;
+static int      epoll_interest_len;
+static int      epoll_fd_removed;
+#endif /* NETSNMP_USE_EPOLL */
+
 #ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
 int     external_readfd[NUM_EXTERNAL_FDS],   external_readfdlen   = 0;
 int     external_writefd[NUM_EXTERNAL_FDS],  external_writefdlen  = 0;
@@ -38,6 +57,10 @@ register_readfd(int fd, void (*func) (int, void *), void *data)
         external_readfd_data[external_readfdlen] = data;
         external_readfdlen++;
         DEBUGMSGTL(("fd_event_manager:register_readfd", "registered fd %d\n", fd));
+#ifdef NETSNMP_USE_EPOLL
+        if (netsnmp_epoll_active())
+            netsnmp_epoll_watch(fd, NETSNMP_FD_EVENT_READ);
+#endif
         return FD_REGISTERED_OK;
     } else {
         snmp_log(LOG_CRIT, "register_readfd: too many file descriptors\n");
@@ -58,6 +81,10 @@ register_writefd(int fd, void (*func) (int, void *), void *data)
         external_writefd_data[external_writefdlen] = data;
         external_writefdlen++;
         DEBUGMSGTL(("fd_event_manager:register_writefd", "registered fd %d\n", fd));
+#ifdef NETSNMP_USE_EPOLL
+        if (netsnmp_epoll_active())
+            netsnmp_epoll_watch(fd, NETSNMP_FD_EVENT_WRITE);
+#endif
         return FD_REGISTERED_OK;
     } else {
         snmp_log(LOG_CRIT,
@@ -79,6 +106,10 @@ register_exceptfd(int fd, void (*func) (int, void *), void *data)
         external_exceptfd_data[external_exceptfdlen] = data;
         external_exceptfdlen++;
         DEBUGMSGTL(("fd_event_manager:register_exceptfd", "registered fd %d\n", fd));
+#ifdef NETSNMP_USE_EPOLL
+        if (netsnmp_epoll_active())
+            netsnmp_epoll_watch(fd, NETSNMP_FD_EVENT_EXCEPT);
+#endif
         return FD_REGISTERED_OK;
     } else {
         snmp_log(LOG_CRIT,
@@ -105,6 +136,10 @@ unregister_readfd(int fd)
             }
             DEBUGMSGTL(("fd_event_manager:unregister_readfd", "unregistered fd %d\n", fd));
             external_fd_unregistered = 1;
+#ifdef NETSNMP_USE_EPOLL
+            if (netsnmp_epoll_active())
+                netsnmp_epoll_unwatch(fd, NETSNMP_FD_EVENT_READ);
+#endif
             return FD_UNREGISTERED_OK;
         }
     }
@@ -129,6 +164,10 @@ unregister_writefd(int fd)
             }
             DEBUGMSGTL(("fd_event_manager:unregister_writefd", "unregistered fd %d\n", fd));
             external_fd_unregistered = 1;
+#ifdef NETSNMP_USE_EPOLL
+            if (netsnmp_epoll_active())
+                netsnmp_epoll_unwatch(fd, NETSNMP_FD_EVENT_WRITE);
+#endif
             return FD_UNREGISTERED_OK;
         }
     }
@@ -154,6 +193,10 @@ unregister_exceptfd(int fd)
             DEBUGMSGTL(("fd_event_manager:unregister_exceptfd", "unregistered fd %d\n",
                         fd));
             external_fd_unregistered = 1;
+#ifdef NETSNMP_USE_EPOLL
+            if (netsnmp_epoll_active())
+                netsnmp_epoll_unwatch(fd, NETSNMP_FD_EVENT_EXCEPT);
+#endif
             return FD_UNREGISTERED_OK;
         }
     }
@@ -295,3 +338,191 @@ void netsnmp_dispatch_external_events2(int *count,
 #else  /*  !NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
 netsnmp_feature_unused(fd_event_manager);
 #endif /*  !NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
+
+#ifdef NETSNMP_USE_EPOLL
+/*
+ * Returns 1 if the epoll set is usable.  It is created on first use; if
+ * that fails the callers keep using the select() based event loop.
+ */
+int
+netsnmp_epoll_active(void)
+{
+    if (epoll_fd == -2) {
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd < 0) {
+            snmp_log_perror("epoll_create1: falling back to select()");
+            epoll_fd = -1;
+        } else
+            DEBUGMSGTL(("fd_event_manager:epoll", "created epoll set %d\n",
+                        epoll_fd));
+    }
+    return epoll_fd >= 0;
+}
+
+/*
+ * Bring the epoll registration of fd in line with the requested interest.
+ */
+static int
+_epoll_set_interest(int fd, int interest)
+{
+    struct epoll_event ev;
+    int                old, op, rc;
+
+    if (fd < 0 || !netsnmp_epoll_active())
+        return -1;
+
+    if (fd >= epoll_interest_len) {
+        int     newlen = epoll_interest_len ? epoll_interest_len : 64;
+        u_char *newtab;
+
+        while (newlen <= fd)
+            newlen *= 2;
+        newtab = (u_char *) realloc(epoll_interest, newlen);
+        if (newtab == NULL) {
+            snmp_log(LOG_ERR, "epoll: can't track fd %d\n", fd);
+            return -1;
+        }
+        memset(newtab + epoll_interest_len, 0, newlen - epoll_interest_len);
+        epoll_interest = newtab;
+        epoll_interest_len = newlen;
+    }
+
+    old = epoll_interest[fd];
+    if (old == interest)
+        return 0;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.data.fd = fd;
+    if (interest & NETSNMP_FD_EVENT_READ)
+        ev.events |= EPOLLIN;
+    if (interest & NETSNMP_FD_EVENT_WRITE)
+        ev.events |= EPOLLOUT;
+    if (interest & NETSNMP_FD_EVENT_EXCEPT)
+        ev.events |= EPOLLPRI;
+
+    if (interest == 0)
+        op = EPOLL_CTL_DEL;
+    else if (old == 0)
+        op = EPOLL_CTL_ADD;
+    else
+        op = EPOLL_CTL_MOD;
+
+    rc = epoll_ctl(epoll_fd, op, fd, &ev);
+    if (rc < 0) {
+        /*
+         * A closed fd silently leaves the epoll set, so the table may be
+         * stale: the fd may since have been closed (DEL) or closed and
+         * reused (MOD).
+         */
+        if (op == EPOLL_CTL_DEL && (errno == EBADF || errno == ENOENT))
+            rc = 0;
+        else if (op == EPOLL_CTL_MOD && errno == ENOENT)
+            rc = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        else if (op == EPOLL_CTL_ADD && errno == EEXIST)
+            rc = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+    }
+    if (rc < 0) {
+        snmp_log(LOG_ERR, "epoll_ctl(fd %d): %s\n", fd, strerror(errno));
+        return -1;
+    }
+
+    DEBUGMSGTL(("fd_event_manager:epoll", "fd %d interest 0x%x -> 0x%x\n",
+                fd, old, interest));
+    epoll_interest[fd] = interest;
+    if (interest == 0)
+        epoll_fd_removed = 1;
+    return 0;
+}
+
+int
+netsnmp_epoll_watch(int fd, int events)
+{
+    int old = (fd >= 0 && fd < epoll_interest_len) ? epoll_interest[fd] : 0;
+
+    return _epoll_set_interest(fd, old | events);
+}
+
+int
+netsnmp_epoll_unwatch(int fd, int events)
+{
+    if (fd < 0 || fd >= epoll_interest_len)
+        return 0;
+    return _epoll_set_interest(fd, epoll_interest[fd] & ~events);
+}
+
+#ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
+static int
+_epoll_dispatch_external(int fd, int *fds, int fdlen,
+                         void (**func) (int, void *), void **data)
+{
+    int i;
+
+    for (i = 0; i < fdlen; i++) {
+        if (fds[i] == fd) {
+            DEBUGMSGTL(("fd_event_manager:netsnmp_epoll_dispatch",
+                        "fd %d\n", fd));
+            func[i] (fd, data[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+#endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
+
+int
+netsnmp_epoll_dispatch(struct timeval *timeout)
+{
+    struct epoll_event events[NETSNMP_EPOLL_MAX_EVENTS];
+    int                count, i, fd, ms = -1;
+
+    if (!netsnmp_epoll_active()) {
+        errno = EBADF;
+        return -1;
+    }
+
+    if (timeout) {
+        if (timeout->tv_sec >= INT_MAX / 1000)
+            ms = INT_MAX;
+        else
+            ms = timeout->tv_sec * 1000 + (timeout->tv_usec + 999) / 1000;
+    }
+
+    count = epoll_wait(epoll_fd, events, NETSNMP_EPOLL_MAX_EVENTS, ms);
+    if (count <= 0)
+        return count;
+
+    /*
+     * Stop once any fd has been removed by a callback: a later event may
+     * refer to it, or to a new fd that reused its number.  Events that are
+     * not dispatched are level triggered and will be reported again.
+     */
+    epoll_fd_removed = 0;
+    for (i = 0; i < count && !epoll_fd_removed; i++) {
+        fd = events[i].data.fd;
+
+        if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+#ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
+            if (!_epoll_dispatch_external(fd, external_readfd,
+                                          external_readfdlen,
+                                          external_readfdfunc,
+                                          external_readfd_data))
+#endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
+                snmp_read_fd(fd);
+        }
+#ifndef NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER
+        if (!epoll_fd_removed &&
+            (events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR)))
+            _epoll_dispatch_external(fd, external_writefd,
+                                     external_writefdlen,
+                                     external_writefdfunc,
+                                     external_writefd_data);
+        if (!epoll_fd_removed && (events[i].events & EPOLLPRI))
+            _epoll_dispatch_external(fd, external_exceptfd,
+                                     external_exceptfdlen,
+                                     external_exceptfdfunc,
+                                     external_exceptfd_data);
+#endif /* NETSNMP_FEATURE_REMOVE_FD_EVENT_MANAGER */
+    }
+    return count;
+}
+#endif /* NETSNMP_USE_EPOLL */
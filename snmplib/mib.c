@@ -48,6 +48,9 @@ SOFTWARE.
 #include <stdio.h>
 #include <ctype.h>
 #include <sys/types.h>
+#if HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
 
 #if HAVE_DIRENT_H
 # include <dirent.h>
@@ -2497,6 +2500,8 @@ register_mib_handlers(void)
                        NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_MIB_WARNINGS);
     netsnmp_ds_register_premib(ASN_BOOLEAN, "snmp", "mibReplaceWithLatest",
                        NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_MIB_REPLACE);
+    netsnmp_ds_register_premib(ASN_OCTET_STR, "snmp", "mibImageDir",
+                       NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_MIB_IMAGE_DIR);
 #endif
 
     netsnmp_ds_register_premib(ASN_BOOLEAN, "snmp", "printNumericEnums",
@@ -2682,42 +2687,136 @@ netsnmp_fixup_mib_directory(void)
 
 }
 
-/**
- * Initialises the mib reader.
+/*
+ * The list of MIB modules to load: MIBS, or the mibs token, with any
+ * "+" or "-" applied to the default list.
+ */
+static char *
+_init_mib_modules(void)
+{
+    char           *env_var, *entry;
+
+    env_var = netsnmp_getenv("MIBS");
+    if (env_var == NULL) {
+        if (confmibs != NULL)
+            env_var = strdup(confmibs);
+        else
+            env_var = strdup(NETSNMP_DEFAULT_MIBS);
+    } else {
+        env_var = strdup(env_var);
+    }
+    if (env_var && ((*env_var == '+') || (*env_var == '-'))) {
+        entry =
+            (char *) malloc(strlen(NETSNMP_DEFAULT_MIBS) + strlen(env_var) + 2);
+        if (!entry) {
+            DEBUGMSGTL(("init_mib", "env mibs malloc failed"));
+            SNMP_FREE(env_var);
+            return NULL;
+        } else {
+            if (*env_var == '+')
+                sprintf(entry, "%s%c%s", NETSNMP_DEFAULT_MIBS, ENV_SEPARATOR_CHAR,
+                        env_var+1);
+            else
+                sprintf(entry, "%s%c%s", env_var+1, ENV_SEPARATOR_CHAR,
+                        NETSNMP_DEFAULT_MIBS );
+        }
+        SNMP_FREE(env_var);
+        env_var = entry;
+    }
+    return env_var;
+}
+
+/*
+ * The MIB image to use in place of reading the MIBs, if mibImageDir
+ * is set, and the key it must have been saved with.
  *
- * Reads in all settings from the environment.
+ * There is one image for each set of directories, modules and parsing
+ * options, so that applications loading different MIBs don't replace
+ * each other's.  Its key adds the modification times of the
+ * directories, which change as MIB files are added or removed; changes
+ * to the files that were read are checked by netsnmp_mib_image_load().
  */
-void
-netsnmp_init_mib(void)
+static char *
+_init_mib_image(const char *dirs, const char *modules, char **key)
+{
+    static char     file[SNMP_MAXPATH];
+    const char     *imagedir, *mibfiles;
+    char           *copy, *entry, *st = NULL, *tmp;
+    struct stat     sb;
+    u_int           hash = 2166136261U;
+    const char     *cp;
+
+    *key = NULL;
+    imagedir = netsnmp_ds_get_string(NETSNMP_DS_LIBRARY_ID,
+                                     NETSNMP_DS_LIB_MIB_IMAGE_DIR);
+    if (!imagedir || !*imagedir)
+        return NULL;
+    mibfiles = netsnmp_getenv("MIBFILES");
+    if (asprintf(key, "mibdirs %s\nmibs %s\nmibfiles %s\noptions %d%d%d%d\n",
+                 dirs, modules, mibfiles ? mibfiles : "",
+                 netsnmp_ds_get_boolean(NETSNMP_DS_LIBRARY_ID,
+                                        NETSNMP_DS_LIB_SAVE_MIB_DESCRS),
+                 netsnmp_ds_get_boolean(NETSNMP_DS_LIBRARY_ID,
+                                        NETSNMP_DS_LIB_MIB_COMMENT_TERM),
+                 netsnmp_ds_get_boolean(NETSNMP_DS_LIBRARY_ID,
+                                        NETSNMP_DS_LIB_MIB_PARSE_LABEL),
+                 netsnmp_ds_get_boolean(NETSNMP_DS_LIBRARY_ID,
+                                        NETSNMP_DS_LIB_MIB_REPLACE)) < 0) {
+        *key = NULL;
+        return NULL;
+    }
+    for (cp = *key; *cp; cp++)
+        hash = (hash ^ (u_char) *cp) * 16777619U;   /* FNV-1a */
+    snprintf(file, sizeof(file), "%s/mibs-%08x.img", imagedir, hash);
+    file[sizeof(file) - 1] = 0;
+
+    copy = strdup(dirs);
+    if (!copy) {
+        SNMP_FREE(*key);
+        return NULL;
+    }
+    for (entry = strtok_r(copy, ENV_SEPARATOR, &st); entry;
+         entry = strtok_r(NULL, ENV_SEPARATOR, &st)) {
+        if (stat(entry, &sb) != 0)
+            sb.st_mtime = 0;
+        if (asprintf(&tmp, "%s%s %ld\n", *key, entry,
+                     (long) sb.st_mtime) < 0) {
+            SNMP_FREE(*key);
+            break;
+        }
+        free(*key);
+        *key = tmp;
+    }
+    free(copy);
+    if (!*key)
+        return NULL;
+    if (mkdirhier(imagedir, NETSNMP_AGENT_DIRECTORY_MODE, 0) != SNMPERR_SUCCESS) {
+        SNMP_FREE(*key);
+        return NULL;
+    }
+    return file;
+}
+
+/*
+ * Reads the MIB files, from the directories and module list given.
+ */
+static void
+_init_mib_read(char *dirs, char *modules)
 {
-    const char     *prefix;
     char           *env_var, *entry;
-    PrefixListPtr   pp = &mib_prefixes[0];
     char           *st = NULL;
 
-    if (Mib)
-        return;
-    netsnmp_init_mib_internals();
-
-    /*
-     * Initialise the MIB directory/ies 
-     */
-    netsnmp_fixup_mib_directory();
-    env_var = strdup(netsnmp_get_mib_directory());
-    if (!env_var)
-        return;
     netsnmp_mibindex_load();
 
     DEBUGMSGTL(("init_mib",
                 "Seen MIBDIRS: Looking in '%s' for mib dirs ...\n",
-                env_var));
+                dirs));
 
-    entry = strtok_r(env_var, ENV_SEPARATOR, &st);
+    entry = strtok_r(dirs, ENV_SEPARATOR, &st);
     while (entry) {
         add_mibdir(entry);
         entry = strtok_r(NULL, ENV_SEPARATOR, &st);
     }
-    SNMP_FREE(env_var);
 
     env_var = netsnmp_getenv("MIBFILES");
     if (env_var != NULL) {
@@ -2737,38 +2836,10 @@ netsnmp_init_mib(void)
      * Read in any modules or mibs requested 
      */
 
-    env_var = netsnmp_getenv("MIBS");
-    if (env_var == NULL) {
-        if (confmibs != NULL)
-            env_var = strdup(confmibs);
-        else
-            env_var = strdup(NETSNMP_DEFAULT_MIBS);
-    } else {
-        env_var = strdup(env_var);
-    }
-    if (env_var && ((*env_var == '+') || (*env_var == '-'))) {
-        entry =
-            (char *) malloc(strlen(NETSNMP_DEFAULT_MIBS) + strlen(env_var) + 2);
-        if (!entry) {
-            DEBUGMSGTL(("init_mib", "env mibs malloc failed"));
-            SNMP_FREE(env_var);
-            return;
-        } else {
-            if (*env_var == '+')
-                sprintf(entry, "%s%c%s", NETSNMP_DEFAULT_MIBS, ENV_SEPARATOR_CHAR,
-                        env_var+1);
-            else
-                sprintf(entry, "%s%c%s", env_var+1, ENV_SEPARATOR_CHAR,
-                        NETSNMP_DEFAULT_MIBS );
-        }
-        SNMP_FREE(env_var);
-        env_var = entry;
-    }
-
     DEBUGMSGTL(("init_mib",
                 "Seen MIBS: Looking in '%s' for mib files ...\n",
-                env_var));
-    entry = strtok_r(env_var, ENV_SEPARATOR, &st);
+                modules));
+    entry = strtok_r(modules, ENV_SEPARATOR, &st);
     while (entry) {
         if (strcasecmp(entry, DEBUG_ALWAYS_TOKEN) == 0) {
             read_all_mibs();
@@ -2780,7 +2851,6 @@ netsnmp_init_mib(void)
         entry = strtok_r(NULL, ENV_SEPARATOR, &st);
     }
     adopt_orphans();
-    SNMP_FREE(env_var);
 
     env_var = netsnmp_getenv("MIBFILES");
     if (env_var != NULL) {
@@ -2824,6 +2894,48 @@ netsnmp_init_mib(void)
         }
         SNMP_FREE(env_var);
     }
+}
+
+/**
+ * Initialises the mib reader.
+ *
+ * Reads in all settings from the environment.
+ */
+void
+netsnmp_init_mib(void)
+{
+    const char     *prefix, *image;
+    char           *dirs, *modules, *image_key, *env_var;
+    PrefixListPtr   pp = &mib_prefixes[0];
+
+    if (Mib)
+        return;
+    netsnmp_init_mib_internals();
+
+    /*
+     * Initialise the MIB directory/ies 
+     */
+    netsnmp_fixup_mib_directory();
+    dirs = strdup(netsnmp_get_mib_directory());
+    if (!dirs)
+        return;
+    modules = _init_mib_modules();
+    if (!modules) {
+        SNMP_FREE(dirs);
+        return;
+    }
+
+    image = _init_mib_image(dirs, modules, &image_key);
+    if (image && netsnmp_mib_image_load(image, image_key) == 0) {
+        DEBUGMSGTL(("init_mib", "Loaded MIBs from %s\n", image));
+    } else {
+        _init_mib_read(dirs, modules);
+        if (image)
+            netsnmp_mib_image_save(image, image_key);
+    }
+    SNMP_FREE(image_key);
+    SNMP_FREE(modules);
+    SNMP_FREE(dirs);
 
     prefix = netsnmp_getenv("PREFIX");
 
@@ -93,6 +93,12 @@ SOFTWARE.
 #if HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#if HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 #if HAVE_DMALLOC_H
 #include <dmalloc.h>
 #endif
@@ -564,6 +570,18 @@ static int      max_module = 0;
 static int      first_err_module = 1;
 static char    *last_err_module = NULL; /* no repeats on "Cannot find module..." */
 
+/*
+ * The MIB image in use (see netsnmp_mib_image_load()), if any.
+ * Its strings are shared by the tree and must not be freed.
+ */
+static char    *mib_image = NULL;
+static size_t   mib_image_len = 0;
+static int      mib_image_mapped = 0;
+
+#define MIB_FREE(p)  do { mib_image_free(p); (p) = NULL; } while (0)
+
+static void     mib_image_free(void *p);
+static void     mib_image_release(void);
 static void     tree_from_node(struct tree *tp, struct node *np);
 static void     do_subtree(struct tree *, struct node **);
 static void     do_linkup(struct module *, struct node *);
@@ -900,13 +918,13 @@ free_partial_tree(struct tree *tp, int keep_label)
     free_indexes(&tp->indexes);
     free_varbinds(&tp->varbinds);
     if (!keep_label)
-        SNMP_FREE(tp->label);
-    SNMP_FREE(tp->hint);
-    SNMP_FREE(tp->units);
-    SNMP_FREE(tp->description);
-    SNMP_FREE(tp->reference);
-    SNMP_FREE(tp->augments);
-    SNMP_FREE(tp->defaultValue);
+        MIB_FREE(tp->label);
+    MIB_FREE(tp->hint);
+    MIB_FREE(tp->units);
+    MIB_FREE(tp->description);
+    MIB_FREE(tp->reference);
+    MIB_FREE(tp->augments);
+    MIB_FREE(tp->defaultValue);
 }
 
 /*
@@ -3708,7 +3726,7 @@ parse_imports(FILE * fp)
                                 "#### freeing Module %d '%s' %d\n",
                                 mp->modid, mp->imports[i].label,
                                 mp->imports[i].modid));
-                    free((char *) mp->imports[i].label);
+                    mib_image_free(mp->imports[i].label);
                 }
                 free((char *) mp->imports);
             }
@@ -4180,7 +4198,7 @@ unload_all_mibs(void)
         struct module_import *mi = mp->imports;
         if (mi) {
             for (i = 0; i < (unsigned int)mp->no_imports; ++i) {
-                SNMP_FREE((mi + i)->label);
+                MIB_FREE((mi + i)->label);
             }
             mp->no_imports = 0;
             if (mi == root_imports)
@@ -4191,8 +4209,8 @@ unload_all_mibs(void)
 
         unload_module_by_ID(mp->modid, tree_head);
         module_head = mp->next;
-        free(mp->name);
-        free(mp->file);
+        mib_image_free(mp->name);
+        mib_image_free(mp->file);
         free(mp);
     }
     unload_module_by_ID(-1, tree_head);
@@ -4205,11 +4223,9 @@ unload_all_mibs(void)
             continue;
         free_enums(&ptc->enums);
         free_ranges(&ptc->ranges);
-        free(ptc->descriptor);
-        if (ptc->hint)
-            free(ptc->hint);
-        if (ptc->description)
-            free(ptc->description);
+        mib_image_free(ptc->descriptor);
+        mib_image_free(ptc->hint);
+        mib_image_free(ptc->description);
     }
     memset(tclist, 0, MAXTC * sizeof(struct tc));
 
@@ -4225,6 +4241,7 @@ unload_all_mibs(void)
     current_module = 0;
     module_map_head = NULL;
     SNMP_FREE(last_err_module);
+    mib_image_release();
 }
 
 static void
@@ -4251,7 +4268,7 @@ new_module(const char *name, const char *file)
                 /*
                  * Use the new one in preference 
                  */
-                free(mp->file);
+                mib_image_free(mp->file);
                 mp->file = strdup(file);
             }
             return;
@@ -5057,6 +5074,977 @@ read_all_mibs(void)
     return tree_head;
 }
 
+/*
+ * MIB images.
+ *
+ * netsnmp_mib_image_save() writes the loaded tree, the module list and
+ * the textual conventions to a file, and netsnmp_mib_image_load()
+ * reads them back in place of parsing the MIB files.  The image holds
+ * fixed size records that refer to each other by index, and a table
+ * of the strings.  The tree nodes and lists are rebuilt from the
+ * records, but their strings are left in the image, which is mapped
+ * read-only (where mmap() is available) and so shared by all the
+ * processes using it.
+ */
+#define MIB_IMAGE_MAGIC         "NSMIBIM1"
+#define MIB_IMAGE_ENDIAN        0x01020304
+
+#define MIB_IMAGE_MODULES       0
+#define MIB_IMAGE_IMPORTS       1
+#define MIB_IMAGE_TCS           2
+#define MIB_IMAGE_NODES         3
+#define MIB_IMAGE_INTS          4
+#define MIB_IMAGE_ENUMS         5
+#define MIB_IMAGE_RANGES        6
+#define MIB_IMAGE_INDEXES       7
+#define MIB_IMAGE_STRINGS       8
+#define MIB_IMAGE_SECTIONS      9
+
+#define MIB_IMAGE_NO_IMPORTS    ((u_int)-1)     /* imports == NULL */
+#define MIB_IMAGE_ROOT_IMPORTS  ((u_int)-2)     /* imports == root_imports */
+
+struct mib_image_header {
+    char            magic[8];
+    u_int           endian;
+    u_int           length;             /* of the whole image */
+    u_int           key;                /* what the image was built from */
+    int             max_module;
+    int             anonymous;
+    int             tree_head;
+    int             root_modid[NUMBER_OF_ROOT_NODES];
+    struct {
+        u_int       offset;
+        u_int       count;              /* records, or bytes of strings */
+    }               section[MIB_IMAGE_SECTIONS];
+};
+
+/*
+ * Strings are offsets into the string table, 0 being NULL.  Lists are
+ * a count of consecutive records starting at an index.
+ */
+struct mib_image_list {
+    u_int           first, count;
+};
+
+struct mib_image_module {
+    u_int           name, file;
+    int             modid;
+    int             no_imports;
+    u_int           imports;
+    u_int           mtime, size;        /* of the file, if it was read */
+};
+
+struct mib_image_import {
+    u_int           label;
+    int             modid;
+};
+
+struct mib_image_tc {
+    int             index, type, modid;
+    u_int           descriptor, hint, description;
+    struct mib_image_list enums, ranges;
+};
+
+struct mib_image_node {
+    u_int           label;
+    u_int           subid;
+    int             parent, child_list, next_peer;
+    int             modid, number_modules;
+    u_int           module_list;
+    int             tc_index, type, access, status;
+    struct mib_image_list enums, ranges, indexes, varbinds;
+    u_int           augments, hint, units, description, reference;
+    u_int           defaultValue;
+};
+
+struct mib_image_enum {
+    int             value;
+    u_int           label;
+};
+
+struct mib_image_range {
+    int             low, high;
+};
+
+/*
+ * Indexes and varbinds both use these; varbinds have no isimplied.
+ */
+struct mib_image_index {
+    u_int           label;
+    int             isimplied;
+};
+
+static const size_t mib_image_record_size[MIB_IMAGE_SECTIONS] = {
+    sizeof(struct mib_image_module),
+    sizeof(struct mib_image_import),
+    sizeof(struct mib_image_tc),
+    sizeof(struct mib_image_node),
+    sizeof(int),
+    sizeof(struct mib_image_enum),
+    sizeof(struct mib_image_range),
+    sizeof(struct mib_image_index),
+    1
+};
+
+static int
+mib_image_owns(const void *p)
+{
+    return mib_image && (const char *) p >= mib_image &&
+        (const char *) p < mib_image + mib_image_len;
+}
+
+static void
+mib_image_free(void *p)
+{
+    if (p && !mib_image_owns(p))
+        free(p);
+}
+
+static void
+mib_image_release(void)
+{
+    if (!mib_image)
+        return;
+#if HAVE_MMAP
+    if (mib_image_mapped)
+        munmap(mib_image, mib_image_len);
+    else
+#endif
+        free(mib_image);
+    mib_image = NULL;
+    mib_image_len = 0;
+    mib_image_mapped = 0;
+}
+
+/*
+ * Writing an image: one growing buffer per section.
+ */
+struct mib_image_buf {
+    char           *data;
+    size_t          len, size;
+};
+
+static void    *
+mib_image_add(struct mib_image_buf *buf, size_t len)
+{
+    void           *p;
+
+    if (buf->len + len > buf->size) {
+        size_t          size = buf->size ? buf->size * 2 : 4096;
+        char           *data;
+
+        while (size < buf->len + len)
+            size *= 2;
+        data = realloc(buf->data, size);
+        if (!data)
+            return NULL;
+        buf->data = data;
+        buf->size = size;
+    }
+    p = buf->data + buf->len;
+    memset(p, 0, len);
+    buf->len += len;
+    return p;
+}
+
+static u_int
+mib_image_add_string(struct mib_image_buf *strings, const char *s,
+                     int *failed)
+{
+    size_t          len;
+    char           *p;
+
+    if (!s)
+        return 0;
+    len = strlen(s) + 1;
+    p = mib_image_add(strings, len);
+    if (!p) {
+        *failed = 1;
+        return 0;
+    }
+    memcpy(p, s, len);
+    return strings->len - len;
+}
+
+struct mib_image_ptr {
+    const struct tree *tp;
+    int             index;
+};
+
+static int
+mib_image_ptr_compare(const void *a, const void *b)
+{
+    const struct tree *pa = ((const struct mib_image_ptr *) a)->tp;
+    const struct tree *pb = ((const struct mib_image_ptr *) b)->tp;
+
+    return pa < pb ? -1 : pa > pb;
+}
+
+/*
+ * The index of a node, -1 for NULL, or -2 if it isn't in the tree.
+ */
+static int
+mib_image_node_index(const struct mib_image_ptr *ptrs, int count,
+                     const struct tree *tp)
+{
+    struct mib_image_ptr key, *found;
+
+    if (!tp)
+        return -1;
+    key.tp = tp;
+    found = bsearch(&key, ptrs, count, sizeof(*ptrs),
+                    mib_image_ptr_compare);
+    return found ? found->index : -2;
+}
+
+static void
+mib_image_add_enums(struct mib_image_buf *bufs, struct mib_image_list *list,
+                    const struct enum_list *ep, int *failed)
+{
+    struct mib_image_enum *rec;
+
+    list->first = bufs[MIB_IMAGE_ENUMS].len / sizeof(*rec);
+    for (; ep; ep = ep->next, list->count++) {
+        u_int           label = mib_image_add_string(&bufs[MIB_IMAGE_STRINGS],
+                                                     ep->label, failed);
+        if (!(rec = mib_image_add(&bufs[MIB_IMAGE_ENUMS], sizeof(*rec)))) {
+            *failed = 1;
+            return;
+        }
+        rec->value = ep->value;
+        rec->label = label;
+    }
+}
+
+static void
+mib_image_add_ranges(struct mib_image_buf *bufs,
+                     struct mib_image_list *list,
+                     const struct range_list *rp, int *failed)
+{
+    struct mib_image_range *rec;
+
+    list->first = bufs[MIB_IMAGE_RANGES].len / sizeof(*rec);
+    for (; rp; rp = rp->next, list->count++) {
+        if (!(rec = mib_image_add(&bufs[MIB_IMAGE_RANGES], sizeof(*rec)))) {
+            *failed = 1;
+            return;
+        }
+        rec->low = rp->low;
+        rec->high = rp->high;
+    }
+}
+
+static void
+mib_image_add_index(struct mib_image_buf *bufs, const char *label,
+                    int isimplied, int *failed)
+{
+    struct mib_image_index *rec;
+    u_int           s = mib_image_add_string(&bufs[MIB_IMAGE_STRINGS],
+                                             label, failed);
+
+    if (!(rec = mib_image_add(&bufs[MIB_IMAGE_INDEXES], sizeof(*rec)))) {
+        *failed = 1;
+        return;
+    }
+    rec->label = s;
+    rec->isimplied = isimplied;
+}
+
+/**
+ * Writes the MIBs loaded so far to a MIB image.
+ *
+ * Nothing is written if some MIBs failed to load, or left nodes that
+ * could not be linked into the tree: loading the image would then
+ * hide the errors.  The file is replaced atomically, so processes
+ * reading the old image at the same time are not disturbed.
+ *
+ * @param file the file to write
+ * @param key  a description of where the MIBs came from, which
+ *             netsnmp_mib_image_load() must be given to use the image
+ *
+ * @return 0 on success, or -1
+ */
+int
+netsnmp_mib_image_save(const char *file, const char *key)
+{
+    struct mib_image_buf bufs[MIB_IMAGE_SECTIONS];
+    struct mib_image_header hdr;
+    struct mib_image_ptr *ptrs = NULL;
+    struct tree   **nodes = NULL, *tp;
+    struct module  *mp;
+    struct tc      *tcp;
+    struct stat     st;
+    char           *tmpfile = NULL;
+    FILE           *fp = NULL;
+    int             count, i, j, fd, failed = 0, rc = -1;
+    size_t          offset;
+    static const char pad[8];
+
+    if (!tree_head || orphan_nodes || erroneousMibs || gpMibErrorString) {
+        DEBUGMSGTL(("mib_image", "not saving %s: MIBs have errors\n", file));
+        return -1;
+    }
+    memset(bufs, 0, sizeof(bufs));
+    /* offset 0 is NULL */
+    if (!mib_image_add(&bufs[MIB_IMAGE_STRINGS], 1))
+        goto out;
+
+    /*
+     * Number the nodes in the order of the name hash chains, so that
+     * loading the image can rebuild the chains as they are.
+     */
+    for (count = 0, i = 0; i < NHASHSIZE; i++)
+        for (tp = tbuckets[i]; tp; tp = tp->next)
+            count++;
+    nodes = malloc(count * sizeof(*nodes));
+    ptrs = malloc(count * sizeof(*ptrs));
+    if (!nodes || !ptrs)
+        goto out;
+    for (j = 0, i = 0; i < NHASHSIZE; i++)
+        for (tp = tbuckets[i]; tp; tp = tp->next, j++) {
+            nodes[j] = tp;
+            ptrs[j].tp = tp;
+            ptrs[j].index = j;
+        }
+    qsort(ptrs, count, sizeof(*ptrs), mib_image_ptr_compare);
+
+    for (j = 0; j < count && !failed; j++) {
+        struct mib_image_node *rec;
+        struct index_list *ip;
+        struct varbind_list *vp;
+        u_int           strs[7];
+
+        tp = nodes[j];
+        if (tp->subid > 0xffffffffUL) {
+            DEBUGMSGTL(("mib_image", "%s: subid too large\n", tp->label));
+            goto out;
+        }
+        strs[0] = mib_image_add_string(&bufs[MIB_IMAGE_STRINGS], tp->label,
+                                       &failed);
+        strs[1] = mib_image_add_string(&bufs[MIB_IMAGE_STRINGS],
+                                       tp->augments, &failed);
+        strs[2] = mib_image_add_string(&bufs[MIB_IMAGE_STRINGS], tp->hint,
+                                       &failed);
+        strs[3] = mib_image_add_string(&bufs[MIB_IMAGE_STRINGS], tp->units,
+                                       &failed);
+        strs[4] = mib_image_add_string(&bufs[MIB_IMAGE_STRINGS],
+                                       tp->description, &failed);
+        strs[5] = mib_image_add_string(&bufs[MIB_IMAGE_STRINGS],
+                                       tp->reference, &failed);
+        strs[6] = mib_image_add_string(&bufs[MIB_IMAGE_STRINGS],
+                                       tp->defaultValue, &failed);
+        if (!(rec = mib_image_add(&bufs[MIB_IMAGE_NODES], sizeof(*rec))))
+            goto out;
+        rec->label = strs[0];
+        rec->augments = strs[1];
+        rec->hint = strs[2];
+        rec->units = strs[3];
+        rec->description = strs[4];
+        rec->reference = strs[5];
+        rec->defaultValue = strs[6];
+        rec->subid = tp->subid;
+        rec->parent = mib_image_node_index(ptrs, count, tp->parent);
+        rec->child_list = mib_image_node_index(ptrs, count, tp->child_list);
+        rec->next_peer = mib_image_node_index(ptrs, count, tp->next_peer);
+        if (rec->parent == -2 || rec->child_list == -2 ||
+            rec->next_peer == -2) {
+            DEBUGMSGTL(("mib_image", "%s: linked to an unknown node\n",
+                        tp->label));
+            goto out;
+        }
+        rec->modid = tp->modid;
+        rec->number_modules = tp->number_modules;
+        rec->tc_index = tp->tc_index;
+        rec->type = tp->type;
+        rec->access = tp->access;
+        rec->status = tp->status;
+        if (tp->module_list != &tp->modid) {
+            int            *ints;
+
+            rec->module_list = bufs[MIB_IMAGE_INTS].len / sizeof(int);
+            ints = mib_image_add(&bufs[MIB_IMAGE_INTS],
+                                 tp->number_modules * sizeof(int));
+            if (!ints)
+                goto out;
+            memcpy(ints, tp->module_list, tp->number_modules * sizeof(int));
+        }
+        mib_image_add_enums(bufs, &rec->enums, tp->enums, &failed);
+        mib_image_add_ranges(bufs, &rec->ranges, tp->ranges, &failed);
+        rec->indexes.first =
+            bufs[MIB_IMAGE_INDEXES].len / sizeof(struct mib_image_index);
+        for (ip = tp->indexes; ip; ip = ip->next, rec->indexes.count++)
+            mib_image_add_index(bufs, ip->ilabel, ip->isimplied, &failed);
+        rec->varbinds.first =
+            bufs[MIB_IMAGE_INDEXES].len / sizeof(struct mib_image_index);
+        for (vp = tp->varbinds; vp; vp = vp->next, rec->varbinds.count++)
+            mib_image_add_index(bufs, vp->vblabel, 0, &failed);
+    }
+
+    for (mp = module_head; mp && !failed; mp = mp->next) {
+        struct mib_image_module rec, *p;
+
+        memset(&rec, 0, sizeof(rec));
+        rec.name = mib_image_add_string(&bufs[MIB_IMAGE_STRINGS], mp->name,
+                                        &failed);
+        rec.file = mib_image_add_string(&bufs[MIB_IMAGE_STRINGS], mp->file,
+                                        &failed);
+        rec.modid = mp->modid;
+        rec.no_imports = mp->no_imports;
+        if (mp->imports == NULL)
+            rec.imports = MIB_IMAGE_NO_IMPORTS;
+        else if (mp->imports == root_imports)
+            rec.imports = MIB_IMAGE_ROOT_IMPORTS;
+        else {
+            rec.imports = bufs[MIB_IMAGE_IMPORTS].len /
+                sizeof(struct mib_image_import);
+            for (i = 0; i < mp->no_imports; i++) {
+                u_int           label =
+                    mib_image_add_string(&bufs[MIB_IMAGE_STRINGS],
+                                         mp->imports[i].label, &failed);
+                struct mib_image_import *imp =
+                    mib_image_add(&bufs[MIB_IMAGE_IMPORTS], sizeof(*imp));
+
+                if (!imp)
+                    goto out;
+                imp->label = label;
+                imp->modid = mp->imports[i].modid;
+            }
+        }
+        if (mp->no_imports != -1) {
+            /* read: the image is out of date once the file changes */
+            if (stat(mp->file, &st) != 0) {
+                DEBUGMSGTL(("mib_image", "cannot stat %s\n", mp->file));
+                goto out;
+            }
+            rec.mtime = st.st_mtime;
+            rec.size = st.st_size;
+        }
+        if (!(p = mib_image_add(&bufs[MIB_IMAGE_MODULES], sizeof(*p))))
+            goto out;
+        *p = rec;
+    }
+
+    for (i = 0, tcp = tclist; i < MAXTC && !failed; i++, tcp++) {
+        struct mib_image_tc rec, *p;
+
+        if (tcp->type == 0)
+            continue;
+        memset(&rec, 0, sizeof(rec));
+        rec.index = i;
+        rec.type = tcp->type;
+        rec.modid = tcp->modid;
+        rec.descriptor = mib_image_add_string(&bufs[MIB_IMAGE_STRINGS],
+                                              tcp->descriptor, &failed);
+        rec.hint = mib_image_add_string(&bufs[MIB_IMAGE_STRINGS], tcp->hint,
+                                        &failed);
+        rec.description = mib_image_add_string(&bufs[MIB_IMAGE_STRINGS],
+                                               tcp->description, &failed);
+        mib_image_add_enums(bufs, &rec.enums, tcp->enums, &failed);
+        mib_image_add_ranges(bufs, &rec.ranges, tcp->ranges, &failed);
+        if (!(p = mib_image_add(&bufs[MIB_IMAGE_TCS], sizeof(*p))))
+            goto out;
+        *p = rec;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, MIB_IMAGE_MAGIC, sizeof(hdr.magic));
+    hdr.endian = MIB_IMAGE_ENDIAN;
+    hdr.key = mib_image_add_string(&bufs[MIB_IMAGE_STRINGS], key, &failed);
+    if (failed)
+        goto out;
+    hdr.max_module = max_module;
+    hdr.anonymous = anonymous;
+    hdr.tree_head = mib_image_node_index(ptrs, count, tree_head);
+    for (i = 0; i < NUMBER_OF_ROOT_NODES; i++)
+        hdr.root_modid[i] = root_imports[i].modid;
+    offset = sizeof(hdr);
+    for (i = 0; i < MIB_IMAGE_SECTIONS; i++) {
+        offset = (offset + 7) & ~(size_t) 7;
+        hdr.section[i].offset = offset;
+        hdr.section[i].count = bufs[i].len / mib_image_record_size[i];
+        offset += bufs[i].len;
+    }
+    if (offset > 0xffffffffUL)
+        goto out;
+    hdr.length = offset;
+
+    /*
+     * write to a new file with a name that can't be guessed, in the same
+     * directory so that it can be renamed over the image
+     */
+    if (asprintf(&tmpfile, "%s.XXXXXX", file) < 0) {
+        tmpfile = NULL;
+        goto out;
+    }
+#ifdef HAVE_MKSTEMP
+    fd = mkstemp(tmpfile);
+#else
+    fd = mktemp(tmpfile) ? open(tmpfile, O_CREAT | O_EXCL | O_WRONLY,
+                                S_IRUSR | S_IWUSR) : -1;
+#endif
+    if (fd < 0) {
+        DEBUGMSGTL(("mib_image", "cannot create %s\n", tmpfile));
+        SNMP_FREE(tmpfile);
+        goto out;
+    }
+    if ((fp = fdopen(fd, "wb")) == NULL) {
+        close(fd);
+        goto out;
+    }
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+        goto out;
+    offset = sizeof(hdr);
+    for (i = 0; i < MIB_IMAGE_SECTIONS; i++) {
+        if (hdr.section[i].offset > offset &&
+            fwrite(pad, hdr.section[i].offset - offset, 1, fp) != 1)
+            goto out;
+        if (bufs[i].len && fwrite(bufs[i].data, bufs[i].len, 1, fp) != 1)
+            goto out;
+        offset = hdr.section[i].offset + bufs[i].len;
+    }
+    i = fclose(fp);
+    fp = NULL;
+    if (i != 0 || rename(tmpfile, file) != 0)
+        goto out;
+    DEBUGMSGTL(("mib_image", "saved %d nodes, %d bytes to %s\n", count,
+                (int) hdr.length, file));
+    rc = 0;
+
+  out:
+    if (fp)
+        fclose(fp);
+    if (rc != 0 && tmpfile)
+        unlink(tmpfile);
+    free(tmpfile);
+    for (i = 0; i < MIB_IMAGE_SECTIONS; i++)
+        free(bufs[i].data);
+    free(nodes);
+    free(ptrs);
+    return rc;
+}
+
+/*
+ * Reading an image: every offset and index is checked before use, so
+ * that a damaged file is rejected rather than followed.
+ */
+struct mib_image_reader {
+    const char     *base;
+    const struct mib_image_header *hdr;
+    const char     *strings;
+    u_int           strings_len;
+    int             bad;
+};
+
+static const void *
+mib_image_section(struct mib_image_reader *r, int section,
+                  u_int first, u_int count)
+{
+    u_int           total = r->hdr->section[section].count;
+
+    if (first > total || count > total - first) {
+        r->bad = 1;
+        return NULL;
+    }
+    return r->base + r->hdr->section[section].offset +
+        first * mib_image_record_size[section];
+}
+
+static char    *
+mib_image_string(struct mib_image_reader *r, u_int offset)
+{
+    if (offset == 0)
+        return NULL;
+    if (offset >= r->strings_len) {
+        r->bad = 1;
+        return NULL;
+    }
+    return NETSNMP_REMOVE_CONST(char *, r->strings + offset);
+}
+
+static struct enum_list *
+mib_image_read_enums(struct mib_image_reader *r,
+                     const struct mib_image_list *list)
+{
+    const struct mib_image_enum *rec =
+        mib_image_section(r, MIB_IMAGE_ENUMS, list->first, list->count);
+    struct enum_list *head = NULL, **epp = &head;
+    u_int           i;
+
+    for (i = 0; rec && i < list->count; i++, rec++) {
+        if (!(*epp = malloc(sizeof(**epp)))) {
+            r->bad = 1;
+            break;
+        }
+        (*epp)->value = rec->value;
+        (*epp)->label = mib_image_string(r, rec->label);
+        epp = &(*epp)->next;
+    }
+    *epp = NULL;
+    return head;
+}
+
+static struct range_list *
+mib_image_read_ranges(struct mib_image_reader *r,
+                      const struct mib_image_list *list)
+{
+    const struct mib_image_range *rec =
+        mib_image_section(r, MIB_IMAGE_RANGES, list->first, list->count);
+    struct range_list *head = NULL, **rpp = &head;
+    u_int           i;
+
+    for (i = 0; rec && i < list->count; i++, rec++) {
+        if (!(*rpp = malloc(sizeof(**rpp)))) {
+            r->bad = 1;
+            break;
+        }
+        (*rpp)->low = rec->low;
+        (*rpp)->high = rec->high;
+        rpp = &(*rpp)->next;
+    }
+    *rpp = NULL;
+    return head;
+}
+
+static struct index_list *
+mib_image_read_indexes(struct mib_image_reader *r,
+                       const struct mib_image_list *list)
+{
+    const struct mib_image_index *rec =
+        mib_image_section(r, MIB_IMAGE_INDEXES, list->first, list->count);
+    struct index_list *head = NULL, **ipp = &head;
+    u_int           i;
+
+    for (i = 0; rec && i < list->count; i++, rec++) {
+        if (!(*ipp = malloc(sizeof(**ipp)))) {
+            r->bad = 1;
+            break;
+        }
+        (*ipp)->ilabel = mib_image_string(r, rec->label);
+        (*ipp)->isimplied = rec->isimplied;
+        ipp = &(*ipp)->next;
+    }
+    *ipp = NULL;
+    return head;
+}
+
+static struct varbind_list *
+mib_image_read_varbinds(struct mib_image_reader *r,
+                        const struct mib_image_list *list)
+{
+    const struct mib_image_index *rec =
+        mib_image_section(r, MIB_IMAGE_INDEXES, list->first, list->count);
+    struct varbind_list *head = NULL, **vpp = &head;
+    u_int           i;
+
+    for (i = 0; rec && i < list->count; i++, rec++) {
+        if (!(*vpp = malloc(sizeof(**vpp)))) {
+            r->bad = 1;
+            break;
+        }
+        (*vpp)->vblabel = mib_image_string(r, rec->label);
+        vpp = &(*vpp)->next;
+    }
+    *vpp = NULL;
+    return head;
+}
+
+static struct tree *
+mib_image_link(struct mib_image_reader *r, struct tree **nodes, int count,
+               int index)
+{
+    if (index == -1)
+        return NULL;
+    if (index < 0 || index >= count) {
+        r->bad = 1;
+        return NULL;
+    }
+    return nodes[index];
+}
+
+/**
+ * Loads the MIBs from a MIB image written by netsnmp_mib_image_save(),
+ * in place of reading them from the MIB files.
+ *
+ * The image is only used if it was saved with the same key, none of
+ * the MIB files it was built from have changed since, and no MIBs
+ * have been loaded yet.
+ *
+ * @param file the image
+ * @param key  as given to netsnmp_mib_image_save()
+ *
+ * @return 0 if the MIBs were loaded, -1 otherwise
+ */
+int
+netsnmp_mib_image_load(const char *file, const char *key)
+{
+    struct mib_image_reader r;
+    const struct mib_image_header *hdr;
+    const struct mib_image_module *mrec;
+    const struct mib_image_node *nrec;
+    const struct mib_image_tc *trec;
+    struct module  *modules = NULL, **mpp = &modules, *mp;
+    struct tree   **nodes = NULL, *tp, *tails[NHASHSIZE], *heads[NHASHSIZE];
+    struct tc      *tcs = NULL;
+    struct stat     st;
+    char           *image = NULL;
+    size_t          len = 0;
+    int             mapped = 0, count = 0, i, j, hash;
+    FILE           *fp;
+
+    if (mib_image || module_head)
+        return -1;
+    for (tp = tree_head; tp; tp = tp->next_peer)
+        if (tp->child_list)
+            return -1;
+
+    if ((fp = fopen(file, "rb")) == NULL)
+        return -1;
+    if (fstat(fileno(fp), &st) == 0 &&
+        st.st_size >= (off_t) sizeof(struct mib_image_header)) {
+        len = st.st_size;
+#if HAVE_MMAP
+        image = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+        if (image == MAP_FAILED)
+            image = NULL;
+        else
+            mapped = 1;
+#endif
+        if (!image && (image = malloc(len)) != NULL &&
+            fread(image, len, 1, fp) != 1) {
+            free(image);
+            image = NULL;
+        }
+    }
+    fclose(fp);
+    if (!image) {
+        DEBUGMSGTL(("mib_image", "cannot read %s\n", file));
+        return -1;
+    }
+    /* from here on, the strings in the image are not to be freed */
+    mib_image = image;
+    mib_image_len = len;
+    mib_image_mapped = mapped;
+
+    memset(&r, 0, sizeof(r));
+    r.base = image;
+    r.hdr = hdr = (const struct mib_image_header *) image;
+    if (memcmp(hdr->magic, MIB_IMAGE_MAGIC, sizeof(hdr->magic)) != 0 ||
+        hdr->endian != MIB_IMAGE_ENDIAN || hdr->length != len) {
+        DEBUGMSGTL(("mib_image", "%s is not a MIB image\n", file));
+        goto fail;
+    }
+    for (i = 0; i < MIB_IMAGE_SECTIONS; i++) {
+        u_int           offset = hdr->section[i].offset;
+        u_int           n = hdr->section[i].count;
+
+        if (offset % 8 || offset > len ||
+            n > (len - offset) / mib_image_record_size[i]) {
+            DEBUGMSGTL(("mib_image", "%s is damaged\n", file));
+            goto fail;
+        }
+    }
+    r.strings = image + hdr->section[MIB_IMAGE_STRINGS].offset;
+    r.strings_len = hdr->section[MIB_IMAGE_STRINGS].count;
+    if (r.strings_len == 0 || r.strings[r.strings_len - 1] != '\0') {
+        DEBUGMSGTL(("mib_image", "%s is damaged\n", file));
+        goto fail;
+    }
+    if (!mib_image_string(&r, hdr->key) ||
+        strcmp(mib_image_string(&r, hdr->key), key) != 0) {
+        DEBUGMSGTL(("mib_image", "%s was built from other MIBs\n", file));
+        goto fail;
+    }
+
+    /*
+     * Modules, checking that the files read have not changed
+     */
+    mrec = mib_image_section(&r, MIB_IMAGE_MODULES, 0,
+                             hdr->section[MIB_IMAGE_MODULES].count);
+    for (i = 0; mrec && i < (int) hdr->section[MIB_IMAGE_MODULES].count;
+         i++, mrec++) {
+        if (!(*mpp = calloc(1, sizeof(**mpp))))
+            goto fail;
+        mp = *mpp;
+        mpp = &mp->next;
+        mp->name = mib_image_string(&r, mrec->name);
+        mp->file = mib_image_string(&r, mrec->file);
+        mp->modid = mrec->modid;
+        mp->no_imports = mrec->no_imports;
+        if (!mp->name || !mp->file)
+            goto fail;
+        if (mp->no_imports != -1 &&
+            (stat(mp->file, &st) != 0 || (u_int) st.st_mtime != mrec->mtime
+             || (u_int) st.st_size != mrec->size)) {
+            DEBUGMSGTL(("mib_image", "%s is out of date: %s changed\n",
+                        file, mp->file));
+            goto fail;
+        }
+        if (mrec->imports == MIB_IMAGE_ROOT_IMPORTS)
+            mp->imports = root_imports;
+        else if (mrec->imports != MIB_IMAGE_NO_IMPORTS) {
+            const struct mib_image_import *irec;
+
+            if (mp->no_imports <= 0 ||
+                !(irec = mib_image_section(&r, MIB_IMAGE_IMPORTS,
+                                           mrec->imports, mp->no_imports)) ||
+                !(mp->imports = calloc(mp->no_imports,
+                                       sizeof(*mp->imports))))
+                goto fail;
+            for (j = 0; j < mp->no_imports; j++, irec++) {
+                mp->imports[j].label = mib_image_string(&r, irec->label);
+                mp->imports[j].modid = irec->modid;
+            }
+        }
+    }
+
+    /*
+     * Tree nodes, in hash chain order
+     */
+    count = hdr->section[MIB_IMAGE_NODES].count;
+    if (count == 0 || !(nodes = calloc(count, sizeof(*nodes))))
+        goto fail;
+    for (i = 0; i < count; i++)
+        if (!(nodes[i] = calloc(1, sizeof(struct tree))))
+            goto fail;
+    nrec = mib_image_section(&r, MIB_IMAGE_NODES, 0, count);
+    memset(heads, 0, sizeof(heads));
+    memset(tails, 0, sizeof(tails));
+    for (i = 0; nrec && i < count && !r.bad; i++, nrec++) {
+        tp = nodes[i];
+        tp->label = mib_image_string(&r, nrec->label);
+        if (!tp->label) {
+            r.bad = 1;
+            break;
+        }
+        tp->subid = nrec->subid;
+        tp->parent = mib_image_link(&r, nodes, count, nrec->parent);
+        tp->child_list = mib_image_link(&r, nodes, count, nrec->child_list);
+        tp->next_peer = mib_image_link(&r, nodes, count, nrec->next_peer);
+        tp->modid = nrec->modid;
+        tp->number_modules = nrec->number_modules;
+        tp->module_list = &tp->modid;
+        if (tp->number_modules > 1) {
+            const int      *ints =
+                mib_image_section(&r, MIB_IMAGE_INTS, nrec->module_list,
+                                  tp->number_modules);
+
+            if (!ints ||
+                !(tp->module_list = malloc(tp->number_modules *
+                                           sizeof(int)))) {
+                tp->module_list = &tp->modid;
+                r.bad = 1;
+                break;
+            }
+            memcpy(tp->module_list, ints, tp->number_modules * sizeof(int));
+        }
+        tp->tc_index = nrec->tc_index;
+        tp->type = nrec->type;
+        tp->access = nrec->access;
+        tp->status = nrec->status;
+        tp->enums = mib_image_read_enums(&r, &nrec->enums);
+        tp->ranges = mib_image_read_ranges(&r, &nrec->ranges);
+        tp->indexes = mib_image_read_indexes(&r, &nrec->indexes);
+        tp->varbinds = mib_image_read_varbinds(&r, &nrec->varbinds);
+        tp->augments = mib_image_string(&r, nrec->augments);
+        tp->hint = mib_image_string(&r, nrec->hint);
+        tp->units = mib_image_string(&r, nrec->units);
+        tp->description = mib_image_string(&r, nrec->description);
+        tp->reference = mib_image_string(&r, nrec->reference);
+        tp->defaultValue = mib_image_string(&r, nrec->defaultValue);
+        if (tp->tc_index < -1 || tp->tc_index >= MAXTC)
+            r.bad = 1;
+        set_function(tp);
+
+        hash = NBUCKET(name_hash(tp->label));
+        if (tails[hash])
+            tails[hash]->next = tp;
+        else
+            heads[hash] = tp;
+        tails[hash] = tp;
+    }
+    if (r.bad || !mib_image_link(&r, nodes, count, hdr->tree_head))
+        goto fail;
+
+    /*
+     * Textual conventions
+     */
+    if (!(tcs = calloc(MAXTC, sizeof(*tcs))))
+        goto fail;
+    trec = mib_image_section(&r, MIB_IMAGE_TCS, 0,
+                             hdr->section[MIB_IMAGE_TCS].count);
+    for (i = 0; trec && i < (int) hdr->section[MIB_IMAGE_TCS].count;
+         i++, trec++) {
+        struct tc      *tcp;
+
+        if (trec->index < 0 || trec->index >= MAXTC || trec->type == 0) {
+            r.bad = 1;
+            break;
+        }
+        tcp = &tcs[trec->index];
+        tcp->type = trec->type;
+        tcp->modid = trec->modid;
+        tcp->descriptor = mib_image_string(&r, trec->descriptor);
+        tcp->hint = mib_image_string(&r, trec->hint);
+        tcp->description = mib_image_string(&r, trec->description);
+        tcp->enums = mib_image_read_enums(&r, &trec->enums);
+        tcp->ranges = mib_image_read_ranges(&r, &trec->ranges);
+        if (!tcp->descriptor)
+            r.bad = 1;
+    }
+    if (r.bad)
+        goto fail;
+
+    /*
+     * All good: replace the bare roots with the image's tree
+     */
+    while ((tp = tree_head) != NULL) {
+        unlink_tree(tp);
+        free_tree(tp);
+    }
+    memcpy(tbuckets, heads, sizeof(tbuckets));
+    tree_head = nodes[hdr->tree_head];
+    module_head = modules;
+    memcpy(tclist, tcs, MAXTC * sizeof(struct tc));
+    max_module = hdr->max_module;
+    anonymous = hdr->anonymous;
+    for (i = 0; i < NUMBER_OF_ROOT_NODES; i++)
+        root_imports[i].modid = hdr->root_modid[i];
+    free(tcs);
+    free(nodes);
+    DEBUGMSGTL(("mib_image", "loaded %d nodes from %s\n", count, file));
+    return 0;
+
+  fail:
+    if (r.bad)
+        DEBUGMSGTL(("mib_image", "%s is damaged\n", file));
+    if (tcs) {
+        for (i = 0; i < MAXTC; i++) {
+            free_enums(&tcs[i].enums);
+            free_ranges(&tcs[i].ranges);
+        }
+        free(tcs);
+    }
+    if (nodes) {
+        for (i = 0; i < count; i++) {
+            if (!(tp = nodes[i]))
+                continue;
+            free_partial_tree(tp, FALSE);
+            if (tp->module_list != &tp->modid)
+                free(tp->module_list);
+            free(tp);
+        }
+        free(nodes);
+    }
+    while ((mp = modules) != NULL) {
+        modules = mp->next;
+        if (mp->imports != root_imports)
+            free(mp->imports);
+        free(mp);
+    }
+    mib_image_release();
+    return -1;
+}
+
 
 #ifdef TEST
 int main(int argc, char *argv[])
@@ -5215,8 +6203,7 @@ free_indexes(struct index_list **spp)
 
         while (pp) {
             npp = pp->next;
-            if (pp->ilabel)
-                free(pp->ilabel);
+            mib_image_free(pp->ilabel);
             free(pp);
             pp = npp;
         }
@@ -5234,8 +6221,7 @@ free_varbinds(struct varbind_list **spp)
 
         while (pp) {
             npp = pp->next;
-            if (pp->vblabel)
-                free(pp->vblabel);
+            mib_image_free(pp->vblabel);
             free(pp);
             pp = npp;
         }
@@ -5270,8 +6256,7 @@ free_enums(struct enum_list **spp)
 
         while (pp) {
             npp = pp->next;
-            if (pp->label)
-                free(pp->label);
+            mib_image_free(pp->label);
             free(pp);
             pp = npp;
         }
@@ -83,6 +83,10 @@ netsnmp_feature_child_of(usm_scapi, usm_support)
 #ifdef NETSNMP_USE_OPENSSL
 #include <openssl/hmac.h>
 #include <openssl/evp.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(LIBRESSL_VERSION_NUMBER)
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
 #include <openssl/rand.h>
 #include <openssl/des.h>
 #ifdef HAVE_AES
@@ -692,6 +696,281 @@ sc_get_openssl_privfn(int priv_type)
 #endif /* openssl */
 
 
+/*
+ * Key state kept per user by the sc_*_cached() functions: an HMAC context
+ * that has already taken in the authKey, so that each message only costs
+ * a copy of the inner and outer pad state, and the cipher key schedule
+ * for the privKey.  A copy of each key is kept to notice when it changes.
+ *
+ * OpenSSL 3.0 deprecates HMAC_CTX and the DES functions: there the HMAC
+ * state is an EVP_MAC_CTX that is duplicated for each message, and the
+ * DES key schedule is not cached.
+ */
+#if defined(NETSNMP_USE_OPENSSL) && \
+    OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(LIBRESSL_VERSION_NUMBER)
+#define SC_CACHE_HMAC 1
+#define SC_CACHE_EVP_MAC 1
+#elif defined(NETSNMP_USE_OPENSSL) && defined(HAVE_HMAC_CTX_NEW)
+#define SC_CACHE_HMAC 1
+#endif
+#if !defined(NETSNMP_DISABLE_DES) && !defined(OLD_DES) && \
+    ((defined(NETSNMP_USE_OPENSSL) && !defined(SC_CACHE_EVP_MAC)) || \
+     defined(NETSNMP_USE_INTERNAL_CRYPTO))
+#define SC_CACHE_DES 1
+#endif
+#if defined(NETSNMP_USE_OPENSSL) && defined(HAVE_AES)
+#define SC_CACHE_AES 1
+#endif
+
+struct netsnmp_sc_cache_s {
+    int             auth_type;
+    u_int           auth_keylen;        /* 0: nothing cached */
+    u_char          auth_key[USM_AUTH_KU_LEN];
+#ifdef SC_CACHE_EVP_MAC
+    EVP_MAC_CTX    *mac;        /* keyed, duplicated for each message */
+#elif defined(SC_CACHE_HMAC)
+    HMAC_CTX       *hmac;
+#endif
+    int             priv_type;
+    u_int           priv_keylen;        /* 0: nothing cached */
+    u_char          priv_key[USM_PRIV_KU_LEN];
+#ifdef SC_CACHE_DES
+    DES_key_schedule des_sched;
+#endif
+#ifdef SC_CACHE_AES
+    EVP_CIPHER_CTX *encrypt_ctx;
+    EVP_CIPHER_CTX *decrypt_ctx;
+#endif
+};
+
+static void
+sc_cache_flush_auth(netsnmp_sc_cache *c)
+{
+#ifdef SC_CACHE_EVP_MAC
+    if (c->mac) {
+        EVP_MAC_CTX_free(c->mac);
+        c->mac = NULL;
+    }
+#elif defined(SC_CACHE_HMAC)
+    if (c->hmac) {
+        HMAC_CTX_free(c->hmac);
+        c->hmac = NULL;
+    }
+#endif
+    memset(c->auth_key, 0, sizeof(c->auth_key));
+    c->auth_keylen = 0;
+}
+
+static void
+sc_cache_flush_priv(netsnmp_sc_cache *c)
+{
+#ifdef SC_CACHE_AES
+    if (c->encrypt_ctx) {
+        EVP_CIPHER_CTX_free(c->encrypt_ctx);
+        c->encrypt_ctx = NULL;
+    }
+    if (c->decrypt_ctx) {
+        EVP_CIPHER_CTX_free(c->decrypt_ctx);
+        c->decrypt_ctx = NULL;
+    }
+#endif
+#ifdef SC_CACHE_DES
+    memset(&c->des_sched, 0, sizeof(c->des_sched));
+#endif
+    memset(c->priv_key, 0, sizeof(c->priv_key));
+    c->priv_keylen = 0;
+}
+
+#if defined(SC_CACHE_HMAC) || defined(SC_CACHE_DES) || defined(SC_CACHE_AES)
+/*
+ * Returns the cache, allocating it on first use, if it can hold a key of
+ * keylen bytes.  If the cached key is not key of the given type, *fresh
+ * is set and the key is remembered; the caller sets the state up.
+ */
+static netsnmp_sc_cache *
+sc_cache_key(netsnmp_sc_cache **cache, int auth, int type,
+             const u_char * key, u_int keylen, int *fresh)
+{
+    netsnmp_sc_cache *c = *cache;
+    u_char         *ckey;
+    u_int          *ckeylen;
+    int            *ctype;
+
+    if (c == NULL && (c = *cache = calloc(1, sizeof(*c))) == NULL)
+        return NULL;
+    ckey = auth ? c->auth_key : c->priv_key;
+    ckeylen = auth ? &c->auth_keylen : &c->priv_keylen;
+    ctype = auth ? &c->auth_type : &c->priv_type;
+    if (keylen == 0 || keylen > (auth ? sizeof(c->auth_key) :
+                                 sizeof(c->priv_key)))
+        return NULL;
+
+    *fresh = (*ckeylen != keylen || *ctype != type ||
+              memcmp(ckey, key, keylen) != 0);
+    if (*fresh) {
+        if (auth)
+            sc_cache_flush_auth(c);
+        else
+            sc_cache_flush_priv(c);
+        memcpy(ckey, key, keylen);
+        *ckeylen = keylen;
+        *ctype = type;
+    }
+    return c;
+}
+#endif
+
+/*******************************************************************-o-******
+ * sc_free_cache
+ *
+ * Parameters:
+ *	*cache		Key state of the sc_*_cached() functions, or NULL.
+ *
+ * Wipes and frees the key state.
+ */
+void
+sc_free_cache(netsnmp_sc_cache *cache)
+{
+    if (cache == NULL)
+        return;
+    sc_cache_flush_auth(cache);
+    sc_cache_flush_priv(cache);
+    free(cache);
+}
+
+#ifdef SC_CACHE_HMAC
+/*
+ * Puts the HMAC of message with key into buf, which holds *buf_len bytes,
+ * using the keyed state cached for key.  Returns 1 if it did, 0 if no
+ * state can be cached (the caller computes the HMAC itself) and -1 if
+ * computing it failed.
+ */
+static int
+sc_cache_hmac(netsnmp_sc_cache **cache, int auth_type, const EVP_MD * hashfn,
+              const u_char * key, u_int keylen,
+              const u_char * message, u_int msglen,
+              u_char * buf, unsigned int *buf_len)
+{
+    netsnmp_sc_cache *c;
+    int             fresh, ok = 0;
+#ifdef SC_CACHE_EVP_MAC
+    EVP_MAC        *mac;
+    EVP_MAC_CTX    *ctx;
+    OSSL_PARAM      params[2];
+    size_t          len = 0;
+#endif
+
+    if ((c = sc_cache_key(cache, 1, auth_type, key, keylen, &fresh)) == NULL)
+        return 0;
+#ifdef SC_CACHE_EVP_MAC
+    if (c->mac == NULL) {
+        params[0] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                NETSNMP_REMOVE_CONST(char *, EVP_MD_get0_name(hashfn)), 0);
+        params[1] = OSSL_PARAM_construct_end();
+        if ((mac = EVP_MAC_fetch(NULL, "HMAC", NULL)) != NULL) {
+            c->mac = EVP_MAC_CTX_new(mac);
+            EVP_MAC_free(mac);
+        }
+        if (c->mac == NULL || EVP_MAC_init(c->mac, key, keylen, params) != 1) {
+            sc_cache_flush_auth(c);
+            return 0;
+        }
+    }
+    if ((ctx = EVP_MAC_CTX_dup(c->mac)) != NULL) {
+        ok = EVP_MAC_update(ctx, message, msglen) == 1 &&
+            EVP_MAC_final(ctx, buf, &len, *buf_len) == 1;
+        EVP_MAC_CTX_free(ctx);
+    }
+    if (ok)
+        *buf_len = len;
+#else
+    if (!fresh && c->hmac) {
+        if (HMAC_Init_ex(c->hmac, NULL, 0, NULL, NULL) != 1) {
+            sc_cache_flush_auth(c);
+            return 0;
+        }
+    } else if ((c->hmac = HMAC_CTX_new()) == NULL ||
+               HMAC_Init_ex(c->hmac, key, keylen, hashfn, NULL) != 1) {
+        sc_cache_flush_auth(c);
+        return 0;
+    }
+    ok = HMAC_Update(c->hmac, message, msglen) == 1 &&
+        HMAC_Final(c->hmac, buf, buf_len) == 1;
+#endif
+    if (!ok) {
+        sc_cache_flush_auth(c);
+        return -1;
+    }
+    return 1;
+}
+#endif
+
+#ifdef SC_CACHE_DES
+/*
+ * Returns the DES key schedule for key, or NULL if none can be cached.
+ */
+static DES_key_schedule *
+sc_cache_des(netsnmp_sc_cache **cache, int priv_type,
+             const u_char * key, u_int keylen)
+{
+    netsnmp_sc_cache *c;
+    DES_cblock      key_struct;
+    int             fresh;
+
+    if ((c = sc_cache_key(cache, 0, priv_type, key, keylen, &fresh)) == NULL)
+        return NULL;
+    if (fresh) {
+        memcpy(key_struct, key, sizeof(key_struct));
+        (void) DES_key_sched(&key_struct, &c->des_sched);
+        memset(key_struct, 0, sizeof(key_struct));
+    }
+    return &c->des_sched;
+}
+#endif
+
+#ifdef SC_CACHE_AES
+/*
+ * Returns a cipher context for encrypting (or decrypting) with key that
+ * only needs its IV set, or NULL if none can be cached.
+ */
+static EVP_CIPHER_CTX *
+sc_cache_cipher(netsnmp_sc_cache **cache, int priv_type,
+                const EVP_CIPHER * cipher, const u_char * key, u_int keylen,
+                int encrypt)
+{
+    netsnmp_sc_cache *c;
+    EVP_CIPHER_CTX **ctx;
+    int             fresh;
+
+    if ((c = sc_cache_key(cache, 0, priv_type, key, keylen, &fresh)) == NULL)
+        return NULL;
+    ctx = encrypt ? &c->encrypt_ctx : &c->decrypt_ctx;
+    if (*ctx == NULL &&
+        ((*ctx = EVP_CIPHER_CTX_new()) == NULL ||
+         EVP_CipherInit_ex(*ctx, cipher, NULL, key, NULL, encrypt) != 1)) {
+        sc_cache_flush_priv(c);
+        return NULL;
+    }
+    return *ctx;
+}
+
+/*
+ * Frees a cipher context after use; one from the cache is kept, unless
+ * using it failed.
+ */
+static void
+sc_cipher_done(netsnmp_sc_cache **cache, EVP_CIPHER_CTX *ctx, int failed)
+{
+    if (cache && *cache &&
+        (ctx == (*cache)->encrypt_ctx || ctx == (*cache)->decrypt_ctx)) {
+        if (failed)
+            sc_cache_flush_priv(*cache);
+    } else
+        EVP_CIPHER_CTX_free(ctx);
+}
+#endif
+
+
 /*******************************************************************-o-******
  * sc_generate_keyed_hash
  *
@@ -719,12 +998,13 @@ sc_get_openssl_privfn(int priv_type)
  *
  * ASSUMED that the number of hash bits is a multiple of 8.
  */
-int
-sc_generate_keyed_hash(const oid * authtypeOID, size_t authtypeOIDlen,
-                       const u_char * key, u_int keylen,
-                       const u_char * message, u_int msglen,
-                       u_char * MAC, size_t * maclen)
-#if  defined(NETSNMP_USE_INTERNAL_MD5) || defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_PKCS11) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+#if defined(NETSNMP_USE_INTERNAL_MD5) || defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_PKCS11) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+static int
+_sc_generate_keyed_hash(netsnmp_sc_cache **cache,
+                        const oid * authtypeOID, size_t authtypeOIDlen,
+                        const u_char * key, u_int keylen,
+                        const u_char * message, u_int msglen,
+                        u_char * MAC, size_t * maclen)
 {
     int             rval = SNMPERR_SUCCESS, auth_type;
     int             iproperlength;
@@ -735,6 +1015,9 @@ sc_generate_keyed_hash(const oid * authtypeOID, size_t authtypeOIDlen,
 #endif
 #ifdef NETSNMP_USE_OPENSSL
     const EVP_MD   *hashfn;
+#ifdef SC_CACHE_HMAC
+    int             cached;
+#endif
 #elif defined(NETSNMP_USE_PKCS11)
     u_long          ck_type;
 #endif
@@ -779,6 +1062,15 @@ sc_generate_keyed_hash(const oid * authtypeOID, size_t authtypeOIDlen,
         QUITFUN(SNMPERR_GENERR, sc_generate_keyed_hash_quit);
     }
 
+#ifdef SC_CACHE_HMAC
+    if (cache && (cached = sc_cache_hmac(cache, auth_type, hashfn, key,
+                                         keylen, message, msglen,
+                                         buf, &buf_len)) != 0) {
+        if (cached < 0) {
+            QUITFUN(SNMPERR_GENERR, sc_generate_keyed_hash_quit);
+        }
+    } else
+#endif
     HMAC(hashfn, key, keylen, message, msglen, buf, &buf_len);
     if (buf_len != properlength) {
         QUITFUN(rval, sc_generate_keyed_hash_quit);
@@ -853,11 +1145,43 @@ sc_generate_keyed_hash(const oid * authtypeOID, size_t authtypeOIDlen,
   sc_generate_keyed_hash_quit:
     memset(buf, 0, SNMP_MAXBUF_SMALL);
     return rval;
-}                               /* end sc_generate_keyed_hash() */
+}                               /* end _sc_generate_keyed_hash() */
+#endif
 
+int
+sc_generate_keyed_hash(const oid * authtypeOID, size_t authtypeOIDlen,
+                       const u_char * key, u_int keylen,
+                       const u_char * message, u_int msglen,
+                       u_char * MAC, size_t * maclen)
+#if defined(NETSNMP_USE_INTERNAL_MD5) || defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_PKCS11) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+{
+    return _sc_generate_keyed_hash(NULL, authtypeOID, authtypeOIDlen,
+                                   key, keylen, message, msglen,
+                                   MAC, maclen);
+}
 #else
                 _SCAPI_NOT_CONFIGURED
 #endif                          /* */
+
+/*
+ * As sc_generate_keyed_hash(), with the key state kept in *cache.
+ */
+int
+sc_generate_keyed_hash_cached(netsnmp_sc_cache **cache,
+                              const oid * authtypeOID, size_t authtypeOIDlen,
+                              const u_char * key, u_int keylen,
+                              const u_char * message, u_int msglen,
+                              u_char * MAC, size_t * maclen)
+{
+#if defined(NETSNMP_USE_INTERNAL_MD5) || defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_PKCS11) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+    return _sc_generate_keyed_hash(cache, authtypeOID, authtypeOIDlen,
+                                   key, keylen, message, msglen,
+                                   MAC, maclen);
+#else
+    return sc_generate_keyed_hash(authtypeOID, authtypeOIDlen, key, keylen,
+                                  message, msglen, MAC, maclen);
+#endif
+}
 /*******************************************************************-o-******
  * sc_hash(): a generic wrapper around whatever hashing package we are using.
  * 
@@ -1066,12 +1390,13 @@ _SCAPI_NOT_CONFIGURED
  * bytes are compared.  The length of MAC cannot be greater than the
  * length of the hash transform output.
  */
-int
-sc_check_keyed_hash(const oid * authtypeOID, size_t authtypeOIDlen,
-                    const u_char * key, u_int keylen,
-                    const u_char * message, u_int msglen,
-                    const u_char * MAC, u_int maclen)
 #if defined(NETSNMP_USE_INTERNAL_MD5) || defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_PKCS11) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+static int
+_sc_check_keyed_hash(netsnmp_sc_cache **cache,
+                     const oid * authtypeOID, size_t authtypeOIDlen,
+                     const u_char * key, u_int keylen,
+                     const u_char * message, u_int msglen,
+                     const u_char * MAC, u_int maclen)
 {
     int             rval = SNMPERR_SUCCESS, auth_type, auth_size;
     size_t          buf_len = SNMP_MAXBUF_SMALL;
@@ -1112,8 +1437,9 @@ sc_check_keyed_hash(const oid * authtypeOID, size_t authtypeOIDlen,
      * the result with the given MAC which may be shorter than
      * the full hash length.
      */
-    rval = sc_generate_keyed_hash(authtypeOID, authtypeOIDlen, key, keylen,
-                                  message, msglen, buf, &buf_len);
+    rval = _sc_generate_keyed_hash(cache, authtypeOID, authtypeOIDlen,
+                                   key, keylen, message, msglen,
+                                   buf, &buf_len);
     QUITFUN(rval, sc_check_keyed_hash_quit);
 
     if (maclen > msglen) {
@@ -1129,11 +1455,41 @@ sc_check_keyed_hash(const oid * authtypeOID, size_t authtypeOIDlen,
 
     return rval;
 
-}                               /* end sc_check_keyed_hash() */
+}                               /* end _sc_check_keyed_hash() */
+#endif
 
+int
+sc_check_keyed_hash(const oid * authtypeOID, size_t authtypeOIDlen,
+                    const u_char * key, u_int keylen,
+                    const u_char * message, u_int msglen,
+                    const u_char * MAC, u_int maclen)
+#if defined(NETSNMP_USE_INTERNAL_MD5) || defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_PKCS11) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+{
+    return _sc_check_keyed_hash(NULL, authtypeOID, authtypeOIDlen,
+                                key, keylen, message, msglen, MAC, maclen);
+}
 #else
 _SCAPI_NOT_CONFIGURED
 #endif                          /* NETSNMP_USE_INTERNAL_MD5 */
+
+/*
+ * As sc_check_keyed_hash(), with the key state kept in *cache.
+ */
+int
+sc_check_keyed_hash_cached(netsnmp_sc_cache **cache,
+                           const oid * authtypeOID, size_t authtypeOIDlen,
+                           const u_char * key, u_int keylen,
+                           const u_char * message, u_int msglen,
+                           const u_char * MAC, u_int maclen)
+{
+#if defined(NETSNMP_USE_INTERNAL_MD5) || defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_PKCS11) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+    return _sc_check_keyed_hash(cache, authtypeOID, authtypeOIDlen,
+                                key, keylen, message, msglen, MAC, maclen);
+#else
+    return sc_check_keyed_hash(authtypeOID, authtypeOIDlen, key, keylen,
+                               message, msglen, MAC, maclen);
+#endif
+}
 /*******************************************************************-o-******
  * sc_encrypt
  *
@@ -1159,13 +1515,14 @@ _SCAPI_NOT_CONFIGURED
  * ctlen contains actual number of crypted bytes in ciphertext upon
  * successful return.
  */
-int
-sc_encrypt(const oid * privtype, size_t privtypelen,
-           u_char * key, u_int keylen,
-           u_char * iv, u_int ivlen,
-           const u_char * plaintext, u_int ptlen,
-           u_char * ciphertext, size_t * ctlen)
 #if defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+static int
+_sc_encrypt(netsnmp_sc_cache **cache,
+            const oid * privtype, size_t privtypelen,
+            u_char * key, u_int keylen,
+            u_char * iv, u_int ivlen,
+            const u_char * plaintext, u_int ptlen,
+            u_char * ciphertext, size_t * ctlen)
 {
     int             rval = SNMPERR_SUCCESS;
     u_char          pad_block[128];      /* bigger than anything I need */
@@ -1181,6 +1538,9 @@ sc_encrypt(const oid * privtype, size_t privtypelen,
 #endif /* OLD_DES */
     DES_cblock       key_struct;
 #endif /* NETSNMP_DISABLE_DES */
+#ifdef SC_CACHE_DES
+    DES_key_schedule *cached_sch = NULL;
+#endif
 
     DEBUGTRACE;
 
@@ -1275,8 +1635,17 @@ sc_encrypt(const oid * privtype, size_t privtypelen,
             memset(&pad_block[pad_size - pad], pad, pad);   /* filling in padblock */
         }
 
-        memcpy(key_struct, key, sizeof(key_struct));
-        (void) DES_key_sched(&key_struct, key_sch);
+#ifdef SC_CACHE_DES
+        if (cache)
+            cached_sch = sc_cache_des(cache, pai->type, key, keylen);
+        if (cached_sch)
+            key_sch = cached_sch;
+        else
+#endif
+        {
+            memcpy(key_struct, key, sizeof(key_struct));
+            (void) DES_key_sched(&key_struct, key_sch);
+        }
 
         memcpy(my_iv, iv, ivlen);
         /*
@@ -1310,36 +1679,42 @@ sc_encrypt(const oid * privtype, size_t privtypelen,
 
         memcpy(my_iv, iv, ivlen);
         /*
-         * encrypt the data 
+         * encrypt the data; a cached context only needs the IV
          */
-        ctx = EVP_CIPHER_CTX_new();
-        if (!ctx) {
-            DEBUGMSGTL(("scapi:encrypt", "openssl error: ctx_new\n"));
-            QUITFUN(SNMPERR_GENERR, sc_encrypt_quit);
+        ctx = cache ? sc_cache_cipher(cache, pai->type, cipher,
+                                      key, keylen, 1) : NULL;
+        if (ctx) {
+            rc = EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, my_iv);
+        } else {
+            ctx = EVP_CIPHER_CTX_new();
+            if (!ctx) {
+                DEBUGMSGTL(("scapi:encrypt", "openssl error: ctx_new\n"));
+                QUITFUN(SNMPERR_GENERR, sc_encrypt_quit);
+            }
+            rc = EVP_EncryptInit_ex(ctx, cipher, NULL, key, my_iv);
         }
-        rc = EVP_EncryptInit(ctx, cipher, key, my_iv);
         if (rc != 1) {
             DEBUGMSGTL(("scapi:encrypt", "openssl error: init\n"));
-            EVP_CIPHER_CTX_free(ctx);
+            sc_cipher_done(cache, ctx, 1);
             QUITFUN(SNMPERR_GENERR, sc_encrypt_quit);
         }
         rc = EVP_EncryptUpdate(ctx, ciphertext, &len, plaintext, ptlen);
         if (rc != 1) {
             DEBUGMSGTL(("scapi:encrypt", "openssl error: update\n"));
-            EVP_CIPHER_CTX_free(ctx);
+            sc_cipher_done(cache, ctx, 1);
             QUITFUN(SNMPERR_GENERR, sc_encrypt_quit);
         }
         enclen = len;
-        rc = EVP_EncryptFinal(ctx, ciphertext + len, &len);
+        rc = EVP_EncryptFinal_ex(ctx, ciphertext + len, &len);
         if (rc != 1) {
             DEBUGMSGTL(("scapi:encrypt", "openssl error: final\n"));
-            EVP_CIPHER_CTX_free(ctx);
+            sc_cipher_done(cache, ctx, 1);
             QUITFUN(SNMPERR_GENERR, sc_encrypt_quit);
         }
         enclen += len;
         ptlen = enclen;
         /* Clean up */
-        EVP_CIPHER_CTX_free(ctx);
+        sc_cipher_done(cache, ctx, 0);
         *ctlen = ptlen;
     }
 #endif
@@ -1359,7 +1734,20 @@ sc_encrypt(const oid * privtype, size_t privtypelen,
 #endif
     return rval;
 
-}                               /* end sc_encrypt() */
+}                               /* end _sc_encrypt() */
+#endif
+
+int
+sc_encrypt(const oid * privtype, size_t privtypelen,
+           u_char * key, u_int keylen,
+           u_char * iv, u_int ivlen,
+           const u_char * plaintext, u_int ptlen,
+           u_char * ciphertext, size_t * ctlen)
+#if defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+{
+    return _sc_encrypt(NULL, privtype, privtypelen, key, keylen, iv, ivlen,
+                       plaintext, ptlen, ciphertext, ctlen);
+}
 #elif defined(NETSNMP_USE_PKCS11)
 {
     int             rval = SNMPERR_SUCCESS, priv_type
@@ -1416,6 +1804,26 @@ sc_encrypt(const oid * privtype, size_t privtypelen,
 }
 #endif                          /* */
 
+/*
+ * As sc_encrypt(), with the key schedule kept in *cache.
+ */
+int
+sc_encrypt_cached(netsnmp_sc_cache **cache,
+                  const oid * privtype, size_t privtypelen,
+                  u_char * key, u_int keylen,
+                  u_char * iv, u_int ivlen,
+                  const u_char * plaintext, u_int ptlen,
+                  u_char * ciphertext, size_t * ctlen)
+{
+#if defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+    return _sc_encrypt(cache, privtype, privtypelen, key, keylen, iv, ivlen,
+                       plaintext, ptlen, ciphertext, ctlen);
+#else
+    return sc_encrypt(privtype, privtypelen, key, keylen, iv, ivlen,
+                      plaintext, ptlen, ciphertext, ctlen);
+#endif
+}
+
 
 
 /*******************************************************************-o-******
@@ -1443,13 +1851,14 @@ sc_encrypt(const oid * privtype, size_t privtypelen,
  * ptlen contains actual number of plaintext bytes in plaintext upon
  * successful return.
  */
-int
-sc_decrypt(const oid * privtype, size_t privtypelen,
-           u_char * key, u_int keylen,
-           u_char * iv, u_int ivlen,
-           u_char * ciphertext, u_int ctlen,
-           u_char * plaintext, size_t * ptlen)
 #if defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+static int
+_sc_decrypt(netsnmp_sc_cache **cache,
+            const oid * privtype, size_t privtypelen,
+            u_char * key, u_int keylen,
+            u_char * iv, u_int ivlen,
+            u_char * ciphertext, u_int ctlen,
+            u_char * plaintext, size_t * ptlen)
 {
 
     int             rval = SNMPERR_SUCCESS;
@@ -1462,6 +1871,9 @@ sc_decrypt(const oid * privtype, size_t privtypelen,
     DES_key_schedule *key_sch = &key_sched_store;
 #endif
     DES_cblock      key_struct;
+#endif
+#ifdef SC_CACHE_DES
+    DES_key_schedule *cached_sch = NULL;
 #endif
     netsnmp_priv_alg_info *pai = NULL;
 
@@ -1511,8 +1923,17 @@ sc_decrypt(const oid * privtype, size_t privtypelen,
     memset(my_iv, 0, sizeof(my_iv));
 #ifndef NETSNMP_DISABLE_DES
     if (USM_CREATE_USER_PRIV_DES == (pai->type & USM_PRIV_MASK_ALG)) {
-        memcpy(key_struct, key, sizeof(key_struct));
-        (void) DES_key_sched(&key_struct, key_sch);
+#ifdef SC_CACHE_DES
+        if (cache)
+            cached_sch = sc_cache_des(cache, pai->type, key, keylen);
+        if (cached_sch)
+            key_sch = cached_sch;
+        else
+#endif
+        {
+            memcpy(key_struct, key, sizeof(key_struct));
+            (void) DES_key_sched(&key_struct, key_sch);
+        }
 
         memcpy(my_iv, iv, ivlen);
         DES_cbc_encrypt(ciphertext, plaintext, ctlen, key_sch,
@@ -1532,29 +1953,35 @@ sc_decrypt(const oid * privtype, size_t privtypelen,
 
         memcpy(my_iv, iv, ivlen);
         /*
-         * decrypt the data
+         * decrypt the data; a cached context only needs the IV
          */
-        ctx = EVP_CIPHER_CTX_new();
-        if (!ctx) {
-            QUITFUN(SNMPERR_GENERR, sc_decrypt_quit);
+        ctx = cache ? sc_cache_cipher(cache, pai->type, cipher,
+                                      key, keylen, 0) : NULL;
+        if (ctx) {
+            rc = EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, my_iv);
+        } else {
+            ctx = EVP_CIPHER_CTX_new();
+            if (!ctx) {
+                QUITFUN(SNMPERR_GENERR, sc_decrypt_quit);
+            }
+            rc = EVP_DecryptInit_ex(ctx, cipher, NULL, key, my_iv);
         }
-        rc = EVP_DecryptInit(ctx, cipher, key, my_iv);
         if (rc != 1) {
-            EVP_CIPHER_CTX_free(ctx);
+            sc_cipher_done(cache, ctx, 1);
             QUITFUN(SNMPERR_GENERR, sc_decrypt_quit);
         }
         rc = EVP_DecryptUpdate(ctx, plaintext, &len, ciphertext, ctlen);
         if (rc != 1) {
-            EVP_CIPHER_CTX_free(ctx);
+            sc_cipher_done(cache, ctx, 1);
             QUITFUN(SNMPERR_GENERR, sc_decrypt_quit);
         }
-        rc = EVP_DecryptFinal(ctx, plaintext + len, &len);
+        rc = EVP_DecryptFinal_ex(ctx, plaintext + len, &len);
         if (rc != 1) {
-            EVP_CIPHER_CTX_free(ctx);
+            sc_cipher_done(cache, ctx, 1);
             QUITFUN(SNMPERR_GENERR, sc_decrypt_quit);
         }
         /* Clean up */
-        EVP_CIPHER_CTX_free(ctx);
+        sc_cipher_done(cache, ctx, 0);
         *ptlen = ctlen;
     }
 #endif
@@ -1574,6 +2001,19 @@ sc_decrypt(const oid * privtype, size_t privtypelen,
     memset(my_iv, 0, sizeof(my_iv));
     return rval;
 }				/* USE OPEN_SSL */
+#endif
+
+int
+sc_decrypt(const oid * privtype, size_t privtypelen,
+           u_char * key, u_int keylen,
+           u_char * iv, u_int ivlen,
+           u_char * ciphertext, u_int ctlen,
+           u_char * plaintext, size_t * ptlen)
+#if defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+{
+    return _sc_decrypt(NULL, privtype, privtypelen, key, keylen, iv, ivlen,
+                       ciphertext, ctlen, plaintext, ptlen);
+}
 #elif NETSNMP_USE_PKCS11                  /* USE PKCS */
 {
     int             rval = SNMPERR_SUCCESS;
@@ -1625,6 +2065,26 @@ sc_decrypt(const oid * privtype, size_t privtypelen,
 }
 #endif                          /* NETSNMP_USE_OPENSSL */
 
+/*
+ * As sc_decrypt(), with the key schedule kept in *cache.
+ */
+int
+sc_decrypt_cached(netsnmp_sc_cache **cache,
+                  const oid * privtype, size_t privtypelen,
+                  u_char * key, u_int keylen,
+                  u_char * iv, u_int ivlen,
+                  u_char * ciphertext, u_int ctlen,
+                  u_char * plaintext, size_t * ptlen)
+{
+#if defined(NETSNMP_USE_OPENSSL) || defined(NETSNMP_USE_INTERNAL_CRYPTO)
+    return _sc_decrypt(cache, privtype, privtypelen, key, keylen, iv, ivlen,
+                       ciphertext, ctlen, plaintext, ptlen);
+#else
+    return sc_decrypt(privtype, privtypelen, key, keylen, iv, ivlen,
+                      ciphertext, ctlen, plaintext, ptlen);
+#endif
+}
+
 #ifdef NETSNMP_USE_INTERNAL_CRYPTO
 
 /* These functions are basically copies of the MDSign() routine in
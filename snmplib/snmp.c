@@ -464,4 +464,212 @@ snmp_realloc_rbuild_var_op(u_char ** pkt, size_t * pkt_len,
     return rc;
 }
 
+/*
+ * Returns the size of the varbind snmp_realloc_rbuild_var_op() builds for
+ * the same arguments, or 0 if it cannot be sized (or encoded).
+ */
+size_t
+snmp_rbuild_size_var_op(const oid * var_name, size_t var_name_len,
+                        u_char var_val_type,
+                        const u_char * var_val, size_t var_val_len)
+{
+    size_t          size = 0, name_size;
+
+    switch (var_val_type) {
+    case ASN_INTEGER:
+        if (var_val_len == sizeof(long))
+            size = asn_rbuild_size_int((const long *) var_val);
+        break;
+
+    case ASN_GAUGE:
+    case ASN_COUNTER:
+    case ASN_TIMETICKS:
+    case ASN_UINTEGER:
+        if (var_val_len == sizeof(u_long))
+            size = asn_rbuild_size_unsigned_int((const u_long *) var_val);
+        break;
+
+    case ASN_OCTET_STR:
+    case ASN_IPADDRESS:
+    case ASN_OPAQUE:
+    case ASN_NSAP:
+    case ASN_BIT_STR:
+        size = asn_rbuild_size_header(var_val_len) + var_val_len;
+        break;
+
+    case ASN_OBJECT_ID:
+        size = asn_rbuild_size_objid((const oid *) var_val,
+                                     var_val_len / sizeof(oid));
+        break;
+
+    case ASN_COUNTER64:
+        if (var_val_len == sizeof(struct counter64))
+            size = asn_rbuild_size_unsigned_int64((const struct counter64 *)
+                                                  var_val);
+        break;
+
+    case ASN_NULL:
+    case SNMP_NOSUCHOBJECT:
+    case SNMP_NOSUCHINSTANCE:
+    case SNMP_ENDOFMIBVIEW:
+        size = 2;
+        break;
+
+    default:
+        {
+            /*
+             * The opaque special types are rare enough: build them into a
+             * scratch buffer to see how big they get.
+             */
+            u_char          scratch[32], *sp = scratch;
+            size_t          sp_len = sizeof(scratch);
+            int             rc = 0;
+
+            switch (var_val_type) {
+#ifdef NETSNMP_WITH_OPAQUE_SPECIAL_TYPES
+            case ASN_OPAQUE_COUNTER64:
+            case ASN_OPAQUE_U64:
+                rc = asn_realloc_rbuild_unsigned_int64(&sp, &sp_len, &size,
+                                                       0, var_val_type,
+                                                       (const struct
+                                                        counter64 *)
+                                                       var_val, var_val_len);
+                break;
+            case ASN_OPAQUE_FLOAT:
+                rc = asn_realloc_rbuild_float(&sp, &sp_len, &size, 0,
+                                              var_val_type,
+                                              (const float *) var_val,
+                                              var_val_len);
+                break;
+            case ASN_OPAQUE_DOUBLE:
+                rc = asn_realloc_rbuild_double(&sp, &sp_len, &size, 0,
+                                               var_val_type,
+                                               (const double *) var_val,
+                                               var_val_len);
+                break;
+            case ASN_OPAQUE_I64:
+                rc = asn_realloc_rbuild_signed_int64(&sp, &sp_len, &size, 0,
+                                                     var_val_type,
+                                                     (const struct
+                                                      counter64 *) var_val,
+                                                     var_val_len);
+                break;
+#endif                          /* NETSNMP_WITH_OPAQUE_SPECIAL_TYPES */
+            }
+            if (rc == 0)
+                size = 0;
+        }
+    }
+
+    if (size == 0)
+        return 0;
+    name_size = asn_rbuild_size_objid(var_name, var_name_len);
+    if (name_size == 0)
+        return 0;
+    size += name_size;
+    return size + asn_rbuild_size_header(size);
+}
+
+/*
+ * Builds the same varbind as snmp_realloc_rbuild_var_op(), but straight
+ * into the buffer without per-byte checks or debug output, if there is
+ * certainly room for it (as there is when the buffer has been sized with
+ * snmp_pdu_rbuild_size()).  Returns 1 on success, 0 if the caller has to
+ * use snmp_realloc_rbuild_var_op() instead; nothing is built then.
+ */
+int
+snmp_rbuild_var_op_unchecked(u_char * pkt, size_t pkt_len, size_t * offset,
+                             const oid * var_name, size_t var_name_len,
+                             u_char var_val_type,
+                             const u_char * var_val, size_t var_val_len)
+{
+    u_char         *end = pkt + pkt_len - *offset, *cp;
+    size_t          room;
+
+    /*
+     * at most 5 bytes per sub-identifier, plus headers and numbers 
+     */
+    room = 5 * var_name_len + 40;
+    switch (var_val_type) {
+    case ASN_INTEGER:
+    case ASN_GAUGE:
+    case ASN_COUNTER:
+    case ASN_TIMETICKS:
+    case ASN_UINTEGER:
+        if (var_val_len != sizeof(long))
+            return 0;
+        break;
+    case ASN_COUNTER64:
+        if (var_val_len != sizeof(struct counter64))
+            return 0;
+        break;
+    case ASN_OCTET_STR:
+    case ASN_IPADDRESS:
+    case ASN_OPAQUE:
+    case ASN_NSAP:
+    case ASN_BIT_STR:
+        room += var_val_len;
+        break;
+    case ASN_OBJECT_ID:
+        room += 5 * (var_val_len / sizeof(oid));
+        break;
+    case ASN_NULL:
+    case SNMP_NOSUCHOBJECT:
+    case SNMP_NOSUCHINSTANCE:
+    case SNMP_ENDOFMIBVIEW:
+        break;
+    default:
+        return 0;
+    }
+    if (pkt_len - *offset < room)
+        return 0;
+
+    switch (var_val_type) {
+    case ASN_INTEGER:
+        cp = asn_rbuild_int_unchecked(end, var_val_type,
+                                      *(const long *) var_val);
+        break;
+    case ASN_GAUGE:
+    case ASN_COUNTER:
+    case ASN_TIMETICKS:
+    case ASN_UINTEGER:
+        cp = asn_rbuild_unsigned_int_unchecked(end, var_val_type,
+                                               *(const u_long *) var_val);
+        break;
+    case ASN_COUNTER64:
+        cp = asn_rbuild_unsigned_int64_unchecked(end, var_val_type,
+                                                 (const struct counter64 *)
+                                                 var_val);
+        break;
+    case ASN_OBJECT_ID:
+        cp = asn_rbuild_objid_unchecked(end, var_val_type,
+                                        (const oid *) var_val,
+                                        var_val_len / sizeof(oid));
+        break;
+    case ASN_OCTET_STR:
+    case ASN_IPADDRESS:
+    case ASN_OPAQUE:
+    case ASN_NSAP:
+    case ASN_BIT_STR:
+        cp = asn_rbuild_string_unchecked(end, var_val_type, var_val,
+                                         var_val_len);
+        break;
+    default:
+        cp = asn_rbuild_header_unchecked(end, var_val_type, 0);
+        break;
+    }
+    if (cp)
+        cp = asn_rbuild_objid_unchecked(cp, (u_char) (ASN_UNIVERSAL |
+                                                      ASN_PRIMITIVE |
+                                                      ASN_OBJECT_ID),
+                                        var_name, var_name_len);
+    if (cp == NULL)
+        return 0;
+    cp = asn_rbuild_header_unchecked(cp, (u_char) (ASN_SEQUENCE |
+                                                   ASN_CONSTRUCTOR),
+                                     end - cp);
+    *offset += end - cp;
+    return 1;
+}
+
 #endif                          /* NETSNMP_USE_REVERSE_ASNENCODING */
@@ -57,10 +57,134 @@
 #include <net-snmp/library/callback.h>
 #include <net-snmp/library/snmp_alarm.h>
 
-static struct snmp_alarm *thealarms = NULL;
+/*
+ * Pending alarms are kept in a binary min-heap ordered by the time they
+ * are next due (and then by clientreg, which keeps alarms that are due
+ * at the same time in the order they were registered), so the next one
+ * is found in constant time and alarms are added and removed in
+ * O(log n).  An alarm is in the heap unless its callback is running
+ * (SA_FIRED).  All alarms are also hashed by clientreg, chained through
+ * their next field.
+ */
+#define SA_NOT_QUEUED   ((size_t) -1)
+
+static struct snmp_alarm **alarm_heap = NULL;
+static size_t   alarm_heap_len = 0, alarm_heap_size = 0;
+static struct snmp_alarm **alarm_hash = NULL;
+static size_t   alarm_hash_size = 0;    /* a power of two */
+static size_t   alarm_count = 0;
 static int      start_alarms = 0;
 static unsigned int regnum = 1;
 
+static int
+sa_before(const struct snmp_alarm *a, const struct snmp_alarm *b)
+{
+    if (timercmp(&a->t_nextM, &b->t_nextM, !=))
+        return timercmp(&a->t_nextM, &b->t_nextM, <);
+    return a->clientreg < b->clientreg;
+}
+
+static void
+sa_heap_set(size_t i, struct snmp_alarm *a)
+{
+    alarm_heap[i] = a;
+    a->heap_index = i;
+}
+
+static void
+sa_heap_sift(size_t i)
+{
+    struct snmp_alarm *a = alarm_heap[i];
+    size_t          child;
+
+    while (i > 0 && sa_before(a, alarm_heap[(i - 1) / 2])) {
+        sa_heap_set(i, alarm_heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    for (;;) {
+        child = 2 * i + 1;
+        if (child >= alarm_heap_len)
+            break;
+        if (child + 1 < alarm_heap_len &&
+            sa_before(alarm_heap[child + 1], alarm_heap[child]))
+            child++;
+        if (!sa_before(alarm_heap[child], a))
+            break;
+        sa_heap_set(i, alarm_heap[child]);
+        i = child;
+    }
+    sa_heap_set(i, a);
+}
+
+static void
+sa_heap_remove(struct snmp_alarm *a)
+{
+    size_t          i = a->heap_index;
+
+    if (i == SA_NOT_QUEUED)
+        return;
+    a->heap_index = SA_NOT_QUEUED;
+    if (i != --alarm_heap_len) {
+        sa_heap_set(i, alarm_heap[alarm_heap_len]);
+        sa_heap_sift(i);
+    }
+}
+
+/*
+ * Puts a in its place in the heap after its t_nextM has been set.
+ * Returns 0, or -1 if there was no memory to add it.
+ */
+static int
+sa_queue(struct snmp_alarm *a)
+{
+    struct snmp_alarm **heap;
+    size_t          size;
+
+    if (a->flags & SA_FIRED)
+        return 0;
+    if (a->heap_index == SA_NOT_QUEUED) {
+        if (alarm_heap_len == alarm_heap_size) {
+            size = alarm_heap_size ? 2 * alarm_heap_size : 64;
+            heap = (struct snmp_alarm **)
+                realloc(alarm_heap, size * sizeof(*heap));
+            if (heap == NULL)
+                return -1;
+            alarm_heap = heap;
+            alarm_heap_size = size;
+        }
+        sa_heap_set(alarm_heap_len++, a);
+    }
+    sa_heap_sift(a->heap_index);
+    return 0;
+}
+
+static int
+sa_hash_add(struct snmp_alarm *a)
+{
+    struct snmp_alarm **hash, *b, *next;
+    size_t          size, i;
+
+    if (alarm_count >= alarm_hash_size) {
+        size = alarm_hash_size ? 2 * alarm_hash_size : 64;
+        hash = (struct snmp_alarm **) calloc(size, sizeof(*hash));
+        if (hash == NULL)
+            return -1;
+        for (i = 0; i < alarm_hash_size; i++)
+            for (b = alarm_hash[i]; b; b = next) {
+                next = b->next;
+                b->next = hash[b->clientreg & (size - 1)];
+                hash[b->clientreg & (size - 1)] = b;
+            }
+        free(alarm_hash);
+        alarm_hash = hash;
+        alarm_hash_size = size;
+    }
+    a->next = alarm_hash[a->clientreg & (alarm_hash_size - 1)];
+    alarm_hash[a->clientreg & (alarm_hash_size - 1)] = a;
+    alarm_count++;
+    return 0;
+}
+
 int
 init_alarm_post_config(int majorid, int minorid, void *serverarg,
                        void *clientarg)
@@ -99,14 +223,17 @@ sa_update_entry(struct snmp_alarm *a)
                 DEBUGMSGTL(("snmp_alarm",
                             "update_entry: illegal interval specified\n"));
                 snmp_alarm_unregister(a->clientreg);
+                return;
             }
         } else {
             /*
              * Single time call, remove it.  
              */
             snmp_alarm_unregister(a->clientreg);
+            return;
         }
     }
+    sa_queue(a);
 }
 
 /**
@@ -125,16 +252,21 @@ sa_update_entry(struct snmp_alarm *a)
 void
 snmp_alarm_unregister(unsigned int clientreg)
 {
-    struct snmp_alarm *sa_ptr, **prevNext = &thealarms;
-
-    for (sa_ptr = thealarms;
-         sa_ptr != NULL && sa_ptr->clientreg != clientreg;
-         sa_ptr = sa_ptr->next) {
-        prevNext = &(sa_ptr->next);
+    struct snmp_alarm *sa_ptr = NULL, **prevNext;
+
+    if (alarm_hash_size) {
+        prevNext = &alarm_hash[clientreg & (alarm_hash_size - 1)];
+        for (sa_ptr = *prevNext;
+             sa_ptr != NULL && sa_ptr->clientreg != clientreg;
+             sa_ptr = sa_ptr->next) {
+            prevNext = &(sa_ptr->next);
+        }
     }
 
     if (sa_ptr != NULL) {
         *prevNext = sa_ptr->next;
+        alarm_count--;
+        sa_heap_remove(sa_ptr);
         DEBUGMSGTL(("snmp_alarm", "unregistered alarm %d\n", 
 		    sa_ptr->clientreg));
         /*
@@ -159,26 +291,23 @@ void
 snmp_alarm_unregister_all(void)
 {
   struct snmp_alarm *sa_ptr, *sa_tmp;
+  size_t i;
 
-  for (sa_ptr = thealarms; sa_ptr != NULL; sa_ptr = sa_tmp) {
-    sa_tmp = sa_ptr->next;
-    free(sa_ptr);
-  }
+  for (i = 0; i < alarm_hash_size; i++)
+    for (sa_ptr = alarm_hash[i]; sa_ptr != NULL; sa_ptr = sa_tmp) {
+      sa_tmp = sa_ptr->next;
+      free(sa_ptr);
+    }
   DEBUGMSGTL(("snmp_alarm", "ALL alarms unregistered\n"));
-  thealarms = NULL;
+  SNMP_FREE(alarm_hash);
+  SNMP_FREE(alarm_heap);
+  alarm_hash_size = alarm_heap_size = alarm_heap_len = alarm_count = 0;
 }  
 
 struct snmp_alarm *
 sa_find_next(void)
 {
-    struct snmp_alarm *a, *lowest = NULL;
-
-    for (a = thealarms; a != NULL; a = a->next)
-        if (!(a->flags & SA_FIRED)
-            && (lowest == NULL || timercmp(&a->t_nextM, &lowest->t_nextM, <)))
-            lowest = a;
-
-    return lowest;
+    return alarm_heap_len ? alarm_heap[0] : NULL;
 }
 
 NETSNMP_IMPORT struct snmp_alarm *sa_find_specific(unsigned int clientreg);
@@ -186,7 +315,11 @@ struct snmp_alarm *
 sa_find_specific(unsigned int clientreg)
 {
     struct snmp_alarm *sa_ptr;
-    for (sa_ptr = thealarms; sa_ptr != NULL; sa_ptr = sa_ptr->next) {
+
+    if (alarm_hash_size == 0)
+        return NULL;
+    for (sa_ptr = alarm_hash[clientreg & (alarm_hash_size - 1)];
+         sa_ptr != NULL; sa_ptr = sa_ptr->next) {
         if (sa_ptr->clientreg == clientreg) {
             return sa_ptr;
         }
@@ -213,6 +346,7 @@ run_alarms(void)
             return;
 
         clientreg = a->clientreg;
+        sa_heap_remove(a);
         a->flags |= SA_FIRED;
         DEBUGMSGTL(("snmp_alarm", "run alarm %d\n", clientreg));
         (*(a->thecallback)) (clientreg, a->clientarg);
@@ -426,34 +560,42 @@ unsigned int
 snmp_alarm_register_hr(struct timeval t, unsigned int flags,
                        SNMPAlarmCallback * cb, void *cd)
 {
-    struct snmp_alarm **s = NULL;
-
-    for (s = &(thealarms); *s != NULL; s = &((*s)->next));
+    struct snmp_alarm *s;
+    unsigned int    clientreg;
 
-    *s = SNMP_MALLOC_STRUCT(snmp_alarm);
-    if (*s == NULL) {
+    s = SNMP_MALLOC_STRUCT(snmp_alarm);
+    if (s == NULL) {
         return 0;
     }
 
-    (*s)->t = t;
-    (*s)->flags = flags;
-    (*s)->clientarg = cd;
-    (*s)->thecallback = cb;
-    (*s)->clientreg = regnum++;
-    (*s)->next = NULL;
+    s->t = t;
+    s->flags = flags;
+    s->clientarg = cd;
+    s->thecallback = cb;
+    s->clientreg = clientreg = regnum++;
+    s->heap_index = SA_NOT_QUEUED;
+    if (sa_hash_add(s) != 0) {
+        free(s);
+        return 0;
+    }
 
-    sa_update_entry(*s);
+    sa_update_entry(s);
+    if (s->heap_index == SA_NOT_QUEUED) {
+        /* out of memory for the heap */
+        snmp_alarm_unregister(clientreg);
+        return 0;
+    }
 
     DEBUGMSGTL(("snmp_alarm",
                 "registered alarm %d, t = %ld.%03ld, flags=0x%02x\n",
-                (*s)->clientreg, (long) (*s)->t.tv_sec, (long)((*s)->t.tv_usec / 1000),
-                (*s)->flags));
+                s->clientreg, (long) s->t.tv_sec, (long)(s->t.tv_usec / 1000),
+                s->flags));
 
     if (start_alarms) {
         set_an_alarm();
     }
 
-    return (*s)->clientreg;
+    return clientreg;
 }
 
 /**
@@ -480,7 +622,7 @@ snmp_alarm_reset(unsigned int clientreg)
         a->t_nextM.tv_sec = 0;
         a->t_nextM.tv_usec = 0;
         NETSNMP_TIMERADD(&t_now, &a->t, &a->t_nextM);
-        return 0;
+        return sa_queue(a);
     }
     DEBUGMSGTL(("snmp_alarm_reset", "alarm %d not found\n",
                 clientreg));
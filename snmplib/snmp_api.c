@@ -128,6 +128,7 @@ SOFTWARE.
 #include <net-snmp/library/container.h>
 #include <net-snmp/library/snmp_secmod.h>
 #include <net-snmp/library/large_fd_set.h>
+#include <net-snmp/library/fd_event_manager.h>
 #ifdef NETSNMP_SECMOD_USM
 #include <net-snmp/library/snmpusm.h>
 #endif
@@ -219,6 +220,12 @@ struct snmp_internal_session {
     size_t        obuf_size;    /* size of buffer for packet data */
     u_char       *opacket;      /* send packet data (within obuf) */
     size_t        opacket_len;  /* length of data */
+
+    int           epoll_sock;   /* socket registered with the epoll set */
+    u_int         epoll_gen;    /* registration it belongs to, 0 if none */
+
+    int           reading;      /* snmp_sess_read2() calls in progress */
+    int           close_pending; /* closed by a callback while reading */
 };
 
 /*
@@ -329,6 +336,20 @@ static long     Msgid = 0;      /* MT_LIB_MESSAGEID */
 static long     Sessid = 0;     /* MT_LIB_SESSIONID */
 static long     Transid = 0;    /* MT_LIB_TRANSID */
 int             snmp_errno = 0;
+#ifdef NETSNMP_USE_EPOLL
+/*
+ * Session owning each socket registered with the epoll set, indexed by
+ * fd, and the number of sessions sharing that socket.
+ */
+struct epoll_sess {
+    struct session_list *slp;
+    int                  refs;
+    u_int                gen;
+};
+static struct epoll_sess *epoll_sessions = NULL;  /* MT_LIB_SESSION */
+static int      epoll_sessions_len = 0;           /* MT_LIB_SESSION */
+static netsnmp_large_fd_set epoll_readfds;        /* MT_LIB_SESSION */
+#endif /* NETSNMP_USE_EPOLL */
 /*
  * END MTCRITICAL_RESOURCE
  */
@@ -781,6 +802,8 @@ register_default_handlers(void)
 		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_DUMP_PACKET);
     netsnmp_ds_register_config(ASN_BOOLEAN, "snmp", "reverseEncodeBER",
 		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_REVERSE_ENCODE);
+    netsnmp_ds_register_config(ASN_BOOLEAN, "snmp", "sizedEncodeBER",
+		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_SIZED_ENCODE);
     netsnmp_ds_register_config(ASN_INTEGER, "snmp", "defaultPort",
 		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_DEFAULT_PORT);
 #ifndef NETSNMP_FEATURE_REMOVE_RUNTIME_DISABLE_VERSION
@@ -825,6 +848,10 @@ register_default_handlers(void)
 		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_CLIENTSENDBUF);
     netsnmp_ds_register_config(ASN_INTEGER, "snmp", "clientRecvBuf",
 		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_CLIENTRECVBUF);
+    netsnmp_ds_register_config(ASN_INTEGER, "snmp", "serverBatchSize",
+		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_SERVERBATCHSIZE);
+    netsnmp_ds_register_config(ASN_INTEGER, "snmp", "pduPoolSize",
+		      NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_PDU_POOL_SIZE);
     netsnmp_ds_register_config(ASN_INTEGER, "snmp", "sendMessageMaxSize",
                                NETSNMP_DS_LIBRARY_ID,
                                NETSNMP_DS_LIB_MSG_SEND_MAX);
@@ -984,12 +1011,135 @@ snmp_shutdown(const char *type)
     shutdown_secmod();
     shutdown_snmp_transport();
     shutdown_data_list();
+    netsnmp_pdu_pool_clear();
     snmp_debug_shutdown();    /* should be done last */
 
     init_snmp_init_done  = 0;
     _init_snmp_init_done = 0;
 }
 
+#ifdef NETSNMP_USE_EPOLL
+/*
+ * registers the socket of a listed session with the epoll set
+ * MTR: called with MT_LIB_SESSION held
+ */
+static void
+_sess_epoll_watch(struct session_list *slp)
+{
+    struct epoll_sess *e;
+    int                fd;
+
+    if (!slp->transport || !slp->internal || slp->transport->sock < 0 ||
+        !netsnmp_epoll_active())
+        return;
+
+    fd = slp->transport->sock;
+    if (fd >= epoll_sessions_len) {
+        int                newlen = epoll_sessions_len ? epoll_sessions_len : 64;
+        struct epoll_sess *newtab;
+
+        while (newlen <= fd)
+            newlen *= 2;
+        newtab = (struct epoll_sess *)
+            realloc(epoll_sessions, newlen * sizeof(*newtab));
+        if (newtab == NULL) {
+            snmp_log(LOG_ERR, "epoll: can't track session fd %d\n", fd);
+            return;
+        }
+        memset(newtab + epoll_sessions_len, 0,
+               (newlen - epoll_sessions_len) * sizeof(*newtab));
+        epoll_sessions = newtab;
+        epoll_sessions_len = newlen;
+    }
+
+    e = &epoll_sessions[fd];
+    if (e->refs > 0 &&
+        (!e->slp->transport || e->slp->transport->sock != fd)) {
+        /*
+         * The sessions that held this fd closed their socket without
+         * being removed from the list yet and the fd got reused.
+         */
+        e->refs = 0;
+    }
+    if (e->refs++ == 0) {
+        e->slp = slp;
+        e->gen++;
+        netsnmp_epoll_watch(fd, NETSNMP_FD_EVENT_READ);
+    }
+    slp->internal->epoll_sock = fd;
+    slp->internal->epoll_gen = e->gen;
+}
+
+/*
+ * removes a session that is no longer listed from the epoll set
+ * MTR: called with MT_LIB_SESSION held
+ */
+static void
+_sess_epoll_unwatch(struct session_list *slp)
+{
+    struct session_list *other;
+    struct epoll_sess   *e;
+    int                  fd;
+
+    if (!slp->internal)
+        return;
+    fd = slp->internal->epoll_sock;
+    if (fd < 0 || fd >= epoll_sessions_len)
+        return;
+    e = &epoll_sessions[fd];
+    if (e->refs == 0 || e->gen != slp->internal->epoll_gen)
+        return;                 /* never watched, or fd since reused */
+
+    if (--e->refs == 0) {
+        e->slp = NULL;
+        netsnmp_epoll_unwatch(fd, NETSNMP_FD_EVENT_READ);
+        return;
+    }
+    if (e->slp != slp)
+        return;
+
+    /*
+     * Another listed session shares this socket: hand the fd over to it.
+     */
+    for (other = Sessions; other; other = other->next)
+        if (other != slp && other->internal &&
+            other->internal->epoll_sock == fd &&
+            other->internal->epoll_gen == e->gen)
+            break;
+    e->slp = other;
+    if (other == NULL) {
+        e->refs = 0;
+        netsnmp_epoll_unwatch(fd, NETSNMP_FD_EVENT_READ);
+    }
+}
+
+/*
+ * Epoll counterpart of snmp_read2(): reads from the listed session that
+ * owns fd.  Returns 0 if no session owns it.
+ */
+int
+snmp_read_fd(int fd)
+{
+    struct session_list *slp;
+    int                  rc = 0;
+
+    snmp_res_lock(MT_LIBRARY_ID, MT_LIB_SESSION);
+    if (fd >= 0 && fd < epoll_sessions_len &&
+        (slp = epoll_sessions[fd].slp) != NULL) {
+        if (epoll_readfds.lfs_setsize == 0)
+            netsnmp_large_fd_set_init(&epoll_readfds, FD_SETSIZE);
+        if (fd >= epoll_readfds.lfs_setsize)
+            netsnmp_large_fd_set_resize(&epoll_readfds, fd + 1);
+        NETSNMP_LARGE_FD_SET(fd, &epoll_readfds);
+        snmp_sess_read2((void *) slp, &epoll_readfds);
+        NETSNMP_LARGE_FD_CLR(fd, &epoll_readfds);
+        rc = 1;
+    }
+    snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SESSION);
+    return rc;
+}
+#endif /* NETSNMP_USE_EPOLL */
+
 /*
  * inserts session into session list
  */
@@ -1001,6 +1151,9 @@ void  snmp_session_insert(struct session_list *slp)
     snmp_res_lock(MT_LIBRARY_ID, MT_LIB_SESSION);
     slp->next = Sessions;
     Sessions = slp;
+#ifdef NETSNMP_USE_EPOLL
+    _sess_epoll_watch(slp);
+#endif
     snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SESSION);
 }
 
@@ -1950,6 +2103,12 @@ snmp_sess_close(void *sessp)
         return 0;
     }
 
+    if (slp->internal && slp->internal->reading) {
+        /* closed from a callback; snmp_sess_read2() finishes the job */
+        slp->internal->close_pending = 1;
+        return 1;
+    }
+
     if (slp->session != NULL &&
         (sptr = find_sec_mod(slp->session->securityModel)) != NULL &&
         sptr->session_close != NULL) {
@@ -2038,6 +2197,10 @@ snmp_close(netsnmp_session * session)
                 oslp = slp;
             }
         }
+#ifdef NETSNMP_USE_EPOLL
+        if (slp)
+            _sess_epoll_unwatch(slp);
+#endif
         snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SESSION);
     }                           /*END MTCRITICAL_RESOURCE */
     if (slp == NULL) {
@@ -2055,6 +2218,9 @@ snmp_close_sessions(void)
     while (Sessions) {
         slp = Sessions;
         Sessions = Sessions->next;
+#ifdef NETSNMP_USE_EPOLL
+        _sess_epoll_unwatch(slp);
+#endif
         snmp_sess_close((void *) slp);
     }
     snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SESSION);
@@ -2590,6 +2756,27 @@ snmpv3_scopedPDU_header_realloc_rbuild(u_char ** pkt, size_t * pkt_len,
 #endif                          /* NETSNMP_USE_REVERSE_ASNENCODING */
 
 #ifdef NETSNMP_USE_REVERSE_ASNENCODING
+/*
+ * room left for the SNMPv3 message header and security parameters when
+ * the scoped PDU of a message is sized up front 
+ */
+#define SNMP_SIZED_V3_SLACK (SNMP_MAX_MSG_V3_HDRS + SNMP_SEC_PARAM_BUF_SIZE)
+
+/*
+ * With sizedEncodeBER set, returns the size snmp_pdu_realloc_rbuild()
+ * will need for pdu, so that the caller can make room for the whole
+ * message at once instead of letting the encoders grow the buffer bit by
+ * bit; 0 otherwise.
+ */
+static size_t
+_snmp_pdu_sized_length(netsnmp_pdu *pdu)
+{
+    if (!netsnmp_ds_get_boolean(NETSNMP_DS_LIBRARY_ID,
+                                NETSNMP_DS_LIB_SIZED_ENCODE))
+        return 0;
+    return snmp_pdu_rbuild_size(pdu);
+}
+
 /*
  * returns 0 if success, -1 if fail, not 0 if SM build failure 
  */
@@ -2620,6 +2807,22 @@ snmpv3_packet_realloc_rbuild(u_char ** pkt, size_t * pkt_len,
         *offset += pdu_data_len;
         memcpy(*pkt + *pkt_len - *offset, pdu_data, pdu_data_len);
     } else {
+        size_t          sized_len = _snmp_pdu_sized_length(pdu);
+
+        if (sized_len) {
+            /*
+             * the scoped PDU, plus room for the headers and USM 
+             */
+            sized_len += asn_rbuild_size_header(pdu->contextNameLen) +
+                pdu->contextNameLen +
+                asn_rbuild_size_header(pdu->contextEngineIDLen) +
+                pdu->contextEngineIDLen;
+            sized_len += asn_rbuild_size_header(sized_len) +
+                SNMP_SIZED_V3_SLACK;
+            if (!asn_realloc_reserve(pkt, pkt_len, *offset, sized_len)) {
+                return -1;
+            }
+        }
         rc = snmp_pdu_realloc_rbuild(pkt, pkt_len, offset, pdu);
         if (rc == 0) {
             return -1;
@@ -3024,6 +3227,18 @@ _snmp_build(u_char ** pkt, size_t * pkt_len, size_t * offset,
                     (1 + pdu->version)));
 #ifdef NETSNMP_USE_REVERSE_ASNENCODING
         if (!(pdu->flags & UCD_MSG_FLAG_FORWARD_ENCODE)) {
+            length = _snmp_pdu_sized_length(pdu);
+            if (length) {
+                version = pdu->version;
+                length += asn_rbuild_size_header(pdu->community_len) +
+                    pdu->community_len + asn_rbuild_size_int(&version);
+                length += asn_rbuild_size_header(length);
+                if (!asn_realloc_reserve(pkt, pkt_len, *offset, length)) {
+                    session->s_snmp_errno = SNMPERR_MALLOC;
+                    return -1;
+                }
+            }
+
             DEBUGPRINTPDUTYPE("send", pdu->command);
             rc = snmp_pdu_realloc_rbuild(pkt, pkt_len, offset, pdu);
             if (rc == 0) {
@@ -3414,6 +3629,28 @@ snmp_pdu_build(netsnmp_pdu *pdu, u_char * cp, size_t * out_length)
 }
 
 #ifdef NETSNMP_USE_REVERSE_ASNENCODING
+static int
+_snmp_rbuild_varbind(u_char ** pkt, size_t * pkt_len, size_t * offset,
+                     netsnmp_variable_list *vp, int unchecked)
+{
+    int             rc;
+
+    if (unchecked &&
+        snmp_rbuild_var_op_unchecked(*pkt, *pkt_len, offset, vp->name,
+                                     vp->name_length, vp->type,
+                                     vp->val.string, vp->val_len))
+        return 1;
+
+    DEBUGDUMPSECTION("send", "VarBind");
+    rc = snmp_realloc_rbuild_var_op(pkt, pkt_len, offset, 1,
+                                    vp->name, &vp->name_length,
+                                    vp->type,
+                                    (u_char *) vp->val.string,
+                                    vp->val_len);
+    DEBUGINDENTLESS();
+    return rc;
+}
+
 /*
  * On error, returns 0 (likely an encoding problem).  
  */
@@ -3428,8 +3665,17 @@ snmp_pdu_realloc_rbuild(u_char ** pkt, size_t * pkt_len, size_t * offset,
     netsnmp_variable_list *vp, *tmpvp;
     size_t          start_offset = *offset;
     int             i, wrapped = 0, notdone, final, rc = 0;
+    int             unchecked = 0;
 
     DEBUGMSGTL(("snmp_pdu_realloc_rbuild", "starting\n"));
+    /*
+     * With sizedEncodeBER the varbinds are built without per-byte checks
+     * where there is room, unless they are to be dumped.
+     */
+    if (netsnmp_ds_get_boolean(NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_SIZED_ENCODE) &&
+        !snmp_get_do_debugging())
+        unchecked = 1;
     for (vp = pdu->variables, i = VPCACHE_SIZE - 1; vp;
          vp = vp->next_variable, i--) {
         /*
@@ -3451,14 +3697,8 @@ snmp_pdu_realloc_rbuild(u_char ** pkt, size_t * pkt_len, size_t * offset,
 
     do {
         for (i = final; i < VPCACHE_SIZE; i++) {
-            vp = vpcache[i];
-            DEBUGDUMPSECTION("send", "VarBind");
-            rc = snmp_realloc_rbuild_var_op(pkt, pkt_len, offset, 1,
-                                            vp->name, &vp->name_length,
-                                            vp->type,
-                                            (u_char *) vp->val.string,
-                                            vp->val_len);
-            DEBUGINDENTLESS();
+            rc = _snmp_rbuild_varbind(pkt, pkt_len, offset, vpcache[i],
+                                      unchecked);
             if (rc == 0) {
                 return 0;
             }
@@ -3468,14 +3708,8 @@ snmp_pdu_realloc_rbuild(u_char ** pkt, size_t * pkt_len, size_t * offset,
         if (wrapped) {
             notdone = 1;
             for (i = 0; i < final; i++) {
-                vp = vpcache[i];
-                DEBUGDUMPSECTION("send", "VarBind");
-                rc = snmp_realloc_rbuild_var_op(pkt, pkt_len, offset, 1,
-                                                vp->name, &vp->name_length,
-                                                vp->type,
-                                                (u_char *) vp->val.string,
-                                                vp->val_len);
-                DEBUGINDENTLESS();
+                rc = _snmp_rbuild_varbind(pkt, pkt_len, offset, vpcache[i],
+                                          unchecked);
                 if (rc == 0) {
                     return 0;
                 }
@@ -3639,6 +3873,50 @@ snmp_pdu_realloc_rbuild(u_char ** pkt, size_t * pkt_len, size_t * offset,
                                      *offset - start_offset);
     return rc;
 }
+
+/*
+ * Returns the number of bytes snmp_pdu_realloc_rbuild() will build for
+ * pdu, or 0 if some varbind cannot be sized.
+ */
+size_t
+snmp_pdu_rbuild_size(netsnmp_pdu *pdu)
+{
+    netsnmp_variable_list *vp;
+    size_t          size = 0, vb_size;
+    long            value;
+
+    for (vp = pdu->variables; vp; vp = vp->next_variable) {
+        if (ASN_PRIV_STOP == vp->type)
+            break;
+        vb_size = snmp_rbuild_size_var_op(vp->name, vp->name_length,
+                                          vp->type, vp->val.string,
+                                          vp->val_len);
+        if (vb_size == 0)
+            return 0;
+        size += vb_size;
+    }
+    size += asn_rbuild_size_header(size);
+
+    if (pdu->command != SNMP_MSG_TRAP) {
+        size += asn_rbuild_size_int(&pdu->errindex) +
+            asn_rbuild_size_int(&pdu->errstat) +
+            asn_rbuild_size_int(&pdu->reqid);
+    } else {
+        size += asn_rbuild_size_unsigned_int(&pdu->time);
+        value = pdu->specific_type;
+        size += asn_rbuild_size_int(&value);
+        value = pdu->trap_type;
+        size += asn_rbuild_size_int(&value);
+        size += asn_rbuild_size_header(4) + 4;
+        vb_size = asn_rbuild_size_objid(pdu->enterprise,
+                                        pdu->enterprise_length);
+        if (vb_size == 0)
+            return 0;
+        size += vb_size;
+    }
+
+    return size + asn_rbuild_size_header(size);
+}
 #endif                          /* NETSNMP_USE_REVERSE_ASNENCODING */
 
 /*
@@ -4687,7 +4965,7 @@ snmp_pdu_parse(netsnmp_pdu *pdu, u_char * data, size_t * length)
      * get each varBind sequence 
      */
     while ((int) *length > 0) {
-        vp = SNMP_MALLOC_TYPEDEF(netsnmp_variable_list);
+        vp = netsnmp_varbind_alloc();
         if (NULL == vp)
             goto fail;
 
@@ -5404,6 +5682,124 @@ snmp_sess_async_send(void *sessp,
 }
 
 
+/*
+ * PDU and varbind pool (see "pduPoolSize").  Freed structures are kept
+ * on a list, linked through their first word, until there are
+ * pduPoolSize of them; the counters are kept whether or not the pool is
+ * in use.  The lists are shared by all sessions and threads.
+ */
+struct netsnmp_pool_item {
+    struct netsnmp_pool_item *next;
+};
+
+static struct netsnmp_pool_item *_pdu_pool;     /* MT_LIB_PDUPOOL */
+static struct netsnmp_pool_item *_varbind_pool;
+static netsnmp_pdu_pool_stats _pool_stats;
+
+/*
+ * Returns a cleared PDU, from the pool if there is one.
+ */
+netsnmp_pdu *
+netsnmp_pdu_alloc(void)
+{
+    netsnmp_pdu    *pdu = NULL;
+
+    snmp_res_lock(MT_LIBRARY_ID, MT_LIB_PDUPOOL);
+    _pool_stats.pdu_allocs++;
+    if (_pdu_pool) {
+        pdu = (netsnmp_pdu *) _pdu_pool;
+        _pdu_pool = _pdu_pool->next;
+        _pool_stats.pdus_free--;
+        _pool_stats.pdu_reused++;
+    }
+    snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_PDUPOOL);
+
+    if (pdu == NULL)
+        return (netsnmp_pdu *) calloc(1, sizeof(netsnmp_pdu));
+    memset(pdu, 0, sizeof(netsnmp_pdu));
+    return pdu;
+}
+
+/*
+ * Returns a cleared varbind, from the pool if there is one.
+ */
+netsnmp_variable_list *
+netsnmp_varbind_alloc(void)
+{
+    netsnmp_variable_list *var = NULL;
+
+    snmp_res_lock(MT_LIBRARY_ID, MT_LIB_PDUPOOL);
+    _pool_stats.varbind_allocs++;
+    if (_varbind_pool) {
+        var = (netsnmp_variable_list *) _varbind_pool;
+        _varbind_pool = _varbind_pool->next;
+        _pool_stats.varbinds_free--;
+        _pool_stats.varbind_reused++;
+    }
+    snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_PDUPOOL);
+
+    if (var == NULL)
+        return SNMP_MALLOC_TYPEDEF(netsnmp_variable_list);
+    memset(var, 0, sizeof(netsnmp_variable_list));
+    return var;
+}
+
+/*
+ * Puts item on *pool if there is room, or frees it.
+ */
+static void
+_pool_put(struct netsnmp_pool_item **pool, void *item, u_long *count,
+          u_long *frees, u_long *pooled)
+{
+    int             max = netsnmp_ds_get_int(NETSNMP_DS_LIBRARY_ID,
+                                             NETSNMP_DS_LIB_PDU_POOL_SIZE);
+
+    snmp_res_lock(MT_LIBRARY_ID, MT_LIB_PDUPOOL);
+    (*frees)++;
+    if (max > 0 && *count < (u_long) max) {
+        ((struct netsnmp_pool_item *) item)->next = *pool;
+        *pool = (struct netsnmp_pool_item *) item;
+        (*count)++;
+        (*pooled)++;
+        item = NULL;
+    }
+    snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_PDUPOOL);
+    free(item);
+}
+
+void
+netsnmp_pdu_pool_get_stats(netsnmp_pdu_pool_stats *stats)
+{
+    snmp_res_lock(MT_LIBRARY_ID, MT_LIB_PDUPOOL);
+    *stats = _pool_stats;
+    snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_PDUPOOL);
+}
+
+/*
+ * Frees everything in the pool.
+ */
+void
+netsnmp_pdu_pool_clear(void)
+{
+    struct netsnmp_pool_item *pdus, *varbinds, *next;
+
+    snmp_res_lock(MT_LIBRARY_ID, MT_LIB_PDUPOOL);
+    pdus = _pdu_pool;
+    varbinds = _varbind_pool;
+    _pdu_pool = _varbind_pool = NULL;
+    _pool_stats.pdus_free = _pool_stats.varbinds_free = 0;
+    snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_PDUPOOL);
+
+    for (; pdus; pdus = next) {
+        next = pdus->next;
+        free(pdus);
+    }
+    for (; varbinds; varbinds = next) {
+        next = varbinds->next;
+        free(varbinds);
+    }
+}
+
 /*
  * Frees the variable and any malloc'd data associated with it.
  */
@@ -5431,7 +5827,9 @@ void
 snmp_free_var(netsnmp_variable_list * var)
 {
     snmp_free_var_internals(var);
-    free((char *) var);
+    if (var)
+        _pool_put(&_varbind_pool, var, &_pool_stats.varbinds_free,
+                  &_pool_stats.varbind_frees, &_pool_stats.varbind_pooled);
 }
 
 void
@@ -5489,14 +5887,15 @@ snmp_free_pdu(netsnmp_pdu *pdu)
     SNMP_FREE(pdu->securityName);
     SNMP_FREE(pdu->transport_data);
     memset(pdu, 0, sizeof(netsnmp_pdu));
-    free((char *) pdu);
+    _pool_put(&_pdu_pool, pdu, &_pool_stats.pdus_free,
+              &_pool_stats.pdu_frees, &_pool_stats.pdu_pooled);
 }
 
 netsnmp_pdu    *
 snmp_create_sess_pdu(netsnmp_transport *transport, void *opaque,
                      size_t olength)
 {
-    netsnmp_pdu *pdu = (netsnmp_pdu *)calloc(1, sizeof(netsnmp_pdu));
+    netsnmp_pdu *pdu = netsnmp_pdu_alloc();
     if (pdu == NULL) {
         DEBUGMSGTL(("sess_process_packet", "can't malloc space for PDU\n"));
         return NULL;
@@ -5903,9 +6302,10 @@ snmp_read(fd_set * fdset)
 void
 snmp_read2(netsnmp_large_fd_set * fdset)
 {
-    struct session_list *slp;
+    struct session_list *slp, *next;
     snmp_res_lock(MT_LIBRARY_ID, MT_LIB_SESSION);
-    for (slp = Sessions; slp; slp = slp->next) {
+    for (slp = Sessions; slp; slp = next) {
+        next = slp->next;       /* slp may be closed by a callback */
         snmp_sess_read2((void *) slp, fdset);
     }
     snmp_res_unlock(MT_LIBRARY_ID, MT_LIB_SESSION);
@@ -6109,20 +6509,45 @@ _sess_read(void *sessp, netsnmp_large_fd_set * fdset)
 
     if (!(transport->flags & NETSNMP_TRANSPORT_FLAG_STREAM)) {
         snmp_rcv_packet rcvp;
-        memset(&rcvp, 0x0, sizeof(rcvp));
+        int             corked = 0;
 
-        /** read the packet */
-        rc = _sess_read_dgram_packet(sessp, fdset, &rcvp);
-        if (-1 == rc) /* protocol error */
-            return -1;
-        else if (-2 == rc) /* no packet to process */
-            return 0;
+        /*
+         * A transport that received a batch of datagrams keeps
+         * NETSNMP_TRANSPORT_FLAG_MORE_PKTS set until all of them have been
+         * handed out.  Process the whole batch now, with the transport
+         * corked so that the responses can be sent in a batch too.  A
+         * callback that closes the session ends the batch.
+         */
+        if (transport->f_flush &&
+            !(transport->flags & NETSNMP_TRANSPORT_FLAG_CORKED)) {
+            transport->flags |= NETSNMP_TRANSPORT_FLAG_CORKED;
+            corked = 1;
+        }
+
+        do {
+            memset(&rcvp, 0x0, sizeof(rcvp));
+
+            /** read the packet */
+            rc = _sess_read_dgram_packet(sessp, fdset, &rcvp);
+            if (-1 == rc) /* protocol error */
+                break;
+            else if (-2 == rc) { /* no packet to process */
+                rc = 0;
+                continue;
+            }
 
-        rc = _sess_process_packet(sessp, sp, isp, transport,
-                                  rcvp.opaque, rcvp.olength,
-                                  rcvp.packet, rcvp.packet_len);
-        SNMP_FREE(rcvp.packet);
-        /** opaque is freed in _sess_process_packet */
+            rc = _sess_process_packet(sessp, sp, isp, transport,
+                                      rcvp.opaque, rcvp.olength,
+                                      rcvp.packet, rcvp.packet_len);
+            SNMP_FREE(rcvp.packet);
+            /** opaque is freed in _sess_process_packet */
+        } while ((transport->flags & NETSNMP_TRANSPORT_FLAG_MORE_PKTS) &&
+                 transport->sock >= 0 && !isp->close_pending);
+
+        if (corked) {
+            transport->flags &= ~NETSNMP_TRANSPORT_FLAG_CORKED;
+            transport->f_flush(transport);
+        }
         return rc;
     }
 
@@ -6387,16 +6812,24 @@ snmp_sess_read(void *sessp, fd_set * fdset)
 int
 snmp_sess_read2(void *sessp, netsnmp_large_fd_set * fdset)
 {
-    struct session_list *psl;
+    struct session_list *psl = (struct session_list *) sessp;
+    struct snmp_internal_session *isp = psl ? psl->internal : NULL;
     netsnmp_session *pss;
     int             rc;
 
+    /*
+     * a callback may close the session; the close is put off until we
+     * are done with it
+     */
+    if (isp)
+        isp->reading++;
     rc = _sess_read(sessp, fdset);
-    psl = (struct session_list *) sessp;
     pss = psl->session;
     if (rc && pss->s_snmp_errno) {
         SET_SNMP_ERROR(pss->s_snmp_errno);
     }
+    if (isp && --isp->reading == 0 && isp->close_pending)
+        snmp_sess_close(psl);
     return rc;
 }
 
@@ -6497,7 +6930,8 @@ snmp_sess_select_info2(void *sessp, int *numfds, netsnmp_large_fd_set *fdset,
  *   and MSVC), do not use the value written into *numfds.
  * @param[in,out] fdset   A large file descriptor set to which all file
  *   descriptors will be added that are associated with one of the examined
- *   sessions.
+ *   sessions.  May be NULL if only the timeout is wanted, e.g. because the
+ *   session sockets are already registered with the epoll backend.
  * @param[in,out] timeout On input, if *block = 1, the maximum time the caller
  *   will block while waiting for Net-SNMP activity. On output, if this function
  *   has set *block to 0, the maximum time the caller is allowed to wait before
@@ -6567,7 +7001,8 @@ snmp_sess_select_info2_flags(void *sessp, int *numfds,
             *numfds = (slp->transport->sock + 1);
         }
 
-        NETSNMP_LARGE_FD_SET(slp->transport->sock, fdset);
+        if (fdset)
+            NETSNMP_LARGE_FD_SET(slp->transport->sock, fdset);
         if (slp->internal != NULL && slp->internal->requests) {
             /*
              * Found another session with outstanding requests.  
@@ -7201,7 +7636,7 @@ snmp_varlist_add_variable(netsnmp_variable_list ** varlist,
     if (varlist == NULL)
         return NULL;
 
-    vars = SNMP_MALLOC_TYPEDEF(netsnmp_variable_list);
+    vars = netsnmp_varbind_alloc();
     if (vars == NULL)
         return NULL;
 
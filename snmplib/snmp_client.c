@@ -128,7 +128,7 @@ snmp_pdu_create(int command)
 {
     netsnmp_pdu    *pdu;
 
-    pdu = (netsnmp_pdu *) calloc(1, sizeof(netsnmp_pdu));
+    pdu = netsnmp_pdu_alloc();
     if (pdu) {
         pdu->version = SNMP_DEFAULT_VERSION;
         pdu->command = command;
@@ -363,7 +363,7 @@ _clone_pdu_header(netsnmp_pdu *pdu)
     if (!pdu)
         return NULL;
 
-    newpdu = (netsnmp_pdu *) malloc(sizeof(netsnmp_pdu));
+    newpdu = netsnmp_pdu_alloc();
     if (!newpdu)
         return NULL;
     memmove(newpdu, pdu, sizeof(netsnmp_pdu));
@@ -452,8 +452,7 @@ _copy_varlist(netsnmp_variable_list * var,      /* source varList */
         /*
          * clone the next variable. Cleanup if alloc fails 
          */
-        newvar = (netsnmp_variable_list *)
-            malloc(sizeof(netsnmp_variable_list));
+        newvar = netsnmp_varbind_alloc();
         if (snmp_clone_var(var, newvar)) {
             if (newvar)
                 free((char *) newvar);
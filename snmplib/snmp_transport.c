@@ -217,8 +217,10 @@ netsnmp_transport_copy(const netsnmp_transport *t)
     n->f_copy = t->f_copy;
     n->f_config = t->f_config;
     n->f_fmtaddr = t->f_fmtaddr;
+    n->f_flush = t->f_flush;
     n->sock = t->sock;
-    n->flags = t->flags;
+    n->flags = t->flags & ~(NETSNMP_TRANSPORT_FLAG_MORE_PKTS |
+                            NETSNMP_TRANSPORT_FLAG_CORKED);
     n->base_transport = netsnmp_transport_copy(t->base_transport);
 
     /* give the transport a chance to do "special things" */
@@ -245,6 +247,7 @@ netsnmp_transport_free(netsnmp_transport *t)
     SNMP_FREE(t->local);
     SNMP_FREE(t->remote);
     SNMP_FREE(t->data);
+    SNMP_FREE(t->batch);
     netsnmp_transport_free(t->base_transport);
 
     SNMP_FREE(t);
@@ -0,0 +1,551 @@
+/*
+ * snmp_walk.c: asynchronous, parallel walks of a subtree.
+ *
+ * A walk is a list of ranges, in OID order, that together cover the
+ * subtree.  Range (start, end] asks for what follows its cursor, which
+ * starts at start, until it gets an OID beyond end, beyond the root or
+ * an exception; end_len 0 means it runs to the end of the root.  The
+ * varbinds of the first range in the list go to the callback as they
+ * arrive; those of later ranges are held until the ranges before them
+ * are done.
+ *
+ * When the walk splits by column, range k covers (prefix.k, prefix.k+1]
+ * and the first range ends where the column of its first varbind does.
+ * A range that goes past its end tells us which columns are empty: if
+ * the next OID is in column c, columns k+1 to c-1 are; if it is past the
+ * prefix, all columns after k are, and whatever is left of the root
+ * after the prefix is walked by one more range that starts at its
+ * cursor.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+
+#include <sys/types.h>
+#if HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#if HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/snmp_walk.h>
+
+#define RANGE_IDLE      0       /* no request outstanding */
+#define RANGE_SENDING   1       /* in snmp_sess_async_send() */
+#define RANGE_BUSY      2       /* request outstanding */
+#define RANGE_DONE      3
+
+typedef struct netsnmp_walk_range_s {
+    netsnmp_walk   *walk;
+    oid             cursor[MAX_OID_LEN];
+    size_t          cursor_len;
+    oid             end[MAX_OID_LEN];
+    size_t          end_len;
+    int             state;
+    int             has_column;
+    u_long          column;
+    netsnmp_variable_list *vars, *last_var;     /* held for delivery */
+    struct netsnmp_walk_range_s *next;
+} netsnmp_walk_range;
+
+static int      _walk_response(int op, netsnmp_session *session, int reqid,
+                               netsnmp_pdu *pdu, void *magic);
+
+static netsnmp_walk_range *
+_walk_range_new(netsnmp_walk *walk, const oid *start, size_t start_len,
+                const oid *end, size_t end_len)
+{
+    netsnmp_walk_range *range = SNMP_MALLOC_TYPEDEF(netsnmp_walk_range);
+
+    if (range == NULL)
+        return NULL;
+    range->walk = walk;
+    memcpy(range->cursor, start, start_len * sizeof(oid));
+    range->cursor_len = start_len;
+    if (end_len)
+        memcpy(range->end, end, end_len * sizeof(oid));
+    range->end_len = end_len;
+    return range;
+}
+
+static void
+_walk_range_append(netsnmp_walk *walk, netsnmp_walk_range *range)
+{
+    if (walk->last_range)
+        walk->last_range->next = range;
+    else
+        walk->ranges = range;
+    walk->last_range = range;
+}
+
+static int
+_walk_in_subtree(const oid *prefix, size_t prefix_len, const oid *name,
+                 size_t name_len)
+{
+    return name_len > prefix_len &&
+        memcmp(prefix, name, prefix_len * sizeof(oid)) == 0;
+}
+
+/*
+ * Frees the walk once it is finished and no response is still due.
+ */
+static void
+_walk_release(netsnmp_walk *walk)
+{
+    netsnmp_walk_range *range, *next;
+
+    if (!walk->finished || walk->outstanding > 0)
+        return;
+    for (range = walk->ranges; range; range = next) {
+        next = range->next;
+        snmp_free_varbind(range->vars);
+        free(range);
+    }
+    free(walk);
+}
+
+static void
+_walk_finish(netsnmp_walk *walk, int status)
+{
+    if (walk->finished)
+        return;
+    walk->finished = 1;
+    walk->status = status;
+    DEBUGMSGTL(("snmp_walk", "walk of "));
+    DEBUGMSGOID(("snmp_walk", walk->root, walk->root_len));
+    DEBUGMSG(("snmp_walk", " done, status %d, %lu varbinds\n", status,
+              walk->count));
+    walk->callback(NETSNMP_WALK_OP_DONE, walk, NULL, walk->magic);
+}
+
+static void
+_walk_fail(netsnmp_walk *walk, netsnmp_walk_range *range, int status)
+{
+    memcpy(walk->erroid, range->cursor, range->cursor_len * sizeof(oid));
+    walk->erroid_len = range->cursor_len;
+    _walk_finish(walk, status);
+}
+
+static int
+_walk_send(netsnmp_walk_range *range)
+{
+    netsnmp_walk   *walk = range->walk;
+    netsnmp_pdu    *pdu;
+
+    pdu = snmp_pdu_create(walk->version == SNMP_VERSION_1 ?
+                          SNMP_MSG_GETNEXT : SNMP_MSG_GETBULK);
+    if (pdu == NULL)
+        return 0;
+    if (pdu->command == SNMP_MSG_GETBULK) {
+        pdu->non_repeaters = 0;
+        pdu->max_repetitions = walk->max_repetitions;
+    }
+    snmp_add_null_var(pdu, range->cursor, range->cursor_len);
+
+    /*
+     * Failures are reported both to the callback and by the return
+     * value; take them from the return value only.
+     */
+    range->state = RANGE_SENDING;
+    if (snmp_sess_async_send(walk->sessp, pdu, _walk_response, range) == 0) {
+        snmp_free_pdu(pdu);
+        range->state = RANGE_IDLE;
+        return 0;
+    }
+    range->state = RANGE_BUSY;
+    walk->outstanding++;
+    return 1;
+}
+
+#ifndef NETSNMP_DISABLE_MIB_LOADING
+static struct tree *
+_walk_mib_node(const oid *name, size_t len)
+{
+    struct tree    *tp = get_tree_head();
+    size_t          i;
+
+    for (i = 0; i < len && tp; i++) {
+        while (tp && tp->subid != name[i])
+            tp = tp->next_peer;
+        if (tp && i + 1 < len)
+            tp = tp->child_list;
+    }
+    return tp;
+}
+#endif
+
+/*
+ * Decides, from the MIB or else from the first OID found, where to split
+ * the walk by column, and ends the first range at the column of that OID.
+ * A table is split at the columns of its entry; an entry or a group at
+ * its children; a column or a scalar is not split.
+ */
+static void
+_walk_split(netsnmp_walk *walk, netsnmp_walk_range *range,
+            netsnmp_variable_list *var)
+{
+    size_t          prefix_len = walk->root_len;
+#ifndef NETSNMP_DISABLE_MIB_LOADING
+    struct tree    *tp = _walk_mib_node(walk->root, walk->root_len), *child;
+#endif
+
+    if (var->type == SNMP_ENDOFMIBVIEW || var->type == SNMP_NOSUCHOBJECT ||
+        var->type == SNMP_NOSUCHINSTANCE ||
+        !_walk_in_subtree(walk->root, walk->root_len, var->name,
+                          var->name_length))
+        return;
+
+#ifndef NETSNMP_DISABLE_MIB_LOADING
+    if (tp) {
+        if (tp->child_list == NULL)
+            return;
+        for (child = tp->child_list; child; child = child->next_peer)
+            if (child->subid == 1 && (child->indexes || child->augments))
+                prefix_len++;
+    } else
+#endif
+    if (var->name_length <= walk->root_len + 1)
+        return;
+    else if (var->name[walk->root_len] == 1 &&
+             var->name_length >= walk->root_len + 3)
+        prefix_len++;
+
+    if (var->name_length <= prefix_len ||
+        var->name[prefix_len] >= MAX_SUBID ||
+        (prefix_len > walk->root_len && var->name[walk->root_len] != 1))
+        return;
+    memcpy(walk->prefix, var->name, prefix_len * sizeof(oid));
+    walk->prefix_len = prefix_len;
+    walk->next_column = var->name[prefix_len] + 1;
+    walk->last_column = MAX_SUBID - 1;
+
+    range->has_column = 1;
+    range->column = var->name[prefix_len];
+    memcpy(range->end, walk->prefix, prefix_len * sizeof(oid));
+    range->end[prefix_len] = range->column + 1;
+    range->end_len = prefix_len + 1;
+    DEBUGMSGTL(("snmp_walk", "splitting at columns of "));
+    DEBUGMSGOID(("snmp_walk", walk->prefix, walk->prefix_len));
+    DEBUGMSG(("snmp_walk", ", from %lu\n", range->column));
+}
+
+/*
+ * The range has ended at var (NULL for the end of the MIB view); learn
+ * what that says about the columns still to be walked.
+ */
+static void
+_walk_range_ended(netsnmp_walk_range *range, netsnmp_variable_list *var)
+{
+    netsnmp_walk   *walk = range->walk;
+    netsnmp_walk_range *tail;
+
+    range->state = RANGE_DONE;
+    if (!range->has_column)
+        return;
+    if (var && _walk_in_subtree(walk->prefix, walk->prefix_len, var->name,
+                                var->name_length)) {
+        if (var->name[walk->prefix_len] > walk->next_column)
+            walk->next_column = var->name[walk->prefix_len];
+        return;
+    }
+    if (range->column < walk->last_column)
+        walk->last_column = range->column;
+    if (var && !walk->tail_created &&
+        _walk_in_subtree(walk->root, walk->root_len, var->name,
+                         var->name_length)) {
+        tail = _walk_range_new(walk, range->cursor, range->cursor_len,
+                               NULL, 0);
+        if (tail == NULL) {
+            _walk_fail(walk, range, STAT_ERROR);
+            return;
+        }
+        _walk_range_append(walk, tail);
+        walk->tail_created = 1;
+    }
+}
+
+static void
+_walk_process(netsnmp_walk_range *range, netsnmp_pdu *pdu)
+{
+    netsnmp_walk   *walk = range->walk;
+    netsnmp_variable_list *var, *vars;
+    int             check = !(walk->flags &
+                              NETSNMP_WALK_DONT_CHECK_LEXICOGRAPHIC);
+
+    if (pdu->errstat != SNMP_ERR_NOERROR) {
+        if (pdu->errstat == SNMP_ERR_NOSUCHNAME &&
+            pdu->version == SNMP_VERSION_1) {
+            /* end of the MIB */
+            _walk_range_ended(range, NULL);
+            return;
+        }
+        walk->errstat = pdu->errstat;
+        _walk_fail(walk, range, STAT_ERROR);
+        return;
+    }
+
+    vars = pdu->variables;
+    pdu->variables = NULL;
+    if (vars == NULL) {
+        _walk_range_ended(range, NULL);
+        return;
+    }
+    if (range == walk->ranges && walk->prefix_len == 0 &&
+        !walk->explicit_split && walk->parallel > 1 &&
+        range->cursor_len == walk->root_len &&
+        snmp_oid_compare(range->cursor, range->cursor_len, walk->root,
+                         walk->root_len) == 0)
+        _walk_split(walk, range, vars);
+
+    while ((var = vars) != NULL) {
+        if (var->type == SNMP_ENDOFMIBVIEW ||
+            var->type == SNMP_NOSUCHOBJECT ||
+            var->type == SNMP_NOSUCHINSTANCE) {
+            _walk_range_ended(range, NULL);
+            break;
+        }
+        if (!_walk_in_subtree(walk->root, walk->root_len, var->name,
+                              var->name_length) ||
+            (range->end_len &&
+             snmp_oid_compare(var->name, var->name_length, range->end,
+                              range->end_len) > 0)) {
+            _walk_range_ended(range, var);
+            break;
+        }
+        if (check && snmp_oid_compare(var->name, var->name_length,
+                                      range->cursor,
+                                      range->cursor_len) <= 0) {
+            memcpy(walk->badoid, var->name, var->name_length * sizeof(oid));
+            walk->badoid_len = var->name_length;
+            snmp_free_varbind(vars);
+            _walk_fail(walk, range, STAT_ERROR);
+            return;
+        }
+        memcpy(range->cursor, var->name, var->name_length * sizeof(oid));
+        range->cursor_len = var->name_length;
+
+        vars = var->next_variable;
+        var->next_variable = NULL;
+        if (range->last_var)
+            range->last_var->next_variable = var;
+        else
+            range->vars = var;
+        range->last_var = var;
+    }
+    snmp_free_varbind(vars);
+
+    if (range->state == RANGE_IDLE && !walk->finished &&
+        !_walk_send(range))
+        _walk_fail(walk, range, STAT_ERROR);
+}
+
+/*
+ * Starts requests for idle ranges, and for new columns, while fewer
+ * than parallel are outstanding.
+ */
+static void
+_walk_fill(netsnmp_walk *walk)
+{
+    netsnmp_walk_range *range;
+    oid             start[MAX_OID_LEN];
+
+    while (!walk->finished && walk->outstanding < walk->parallel) {
+        for (range = walk->ranges; range; range = range->next)
+            if (range->state == RANGE_IDLE)
+                break;
+        if (range == NULL && walk->prefix_len &&
+            walk->next_column <= walk->last_column && !walk->tail_created) {
+            memcpy(start, walk->prefix, walk->prefix_len * sizeof(oid));
+            start[walk->prefix_len] = walk->next_column;
+            range = _walk_range_new(walk, start, walk->prefix_len + 1,
+                                    start, walk->prefix_len + 1);
+            if (range) {
+                range->has_column = 1;
+                range->column = walk->next_column++;
+                range->end[walk->prefix_len]++;
+                _walk_range_append(walk, range);
+            }
+        }
+        if (range == NULL)
+            break;
+        if (!_walk_send(range))
+            _walk_fail(walk, range, STAT_ERROR);
+    }
+}
+
+/*
+ * Hands the varbinds that are next in order to the callback, and drops
+ * the ranges that are done.
+ */
+static void
+_walk_deliver(netsnmp_walk *walk)
+{
+    netsnmp_walk_range *range;
+    netsnmp_variable_list *vars;
+
+    while (!walk->finished && (range = walk->ranges) != NULL) {
+        if (range->vars) {
+            vars = range->vars;
+            range->vars = range->last_var = NULL;
+            walk->count += count_varbinds(vars);
+            walk->callback(NETSNMP_WALK_OP_VARBINDS, walk, vars,
+                           walk->magic);
+            snmp_free_varbind(vars);
+        }
+        if (range->state != RANGE_DONE)
+            break;
+        walk->ranges = range->next;
+        if (walk->last_range == range)
+            walk->last_range = NULL;
+        free(range);
+    }
+    if (!walk->finished && walk->ranges == NULL)
+        _walk_finish(walk, STAT_SUCCESS);
+}
+
+static int
+_walk_response(int op, netsnmp_session *session, int reqid,
+               netsnmp_pdu *pdu, void *magic)
+{
+    netsnmp_walk_range *range = (netsnmp_walk_range *) magic;
+    netsnmp_walk   *walk = range->walk;
+
+    /*
+     * A failed retransmission is followed by a time-out, and failures
+     * while sending are taken from snmp_sess_async_send().
+     */
+    if (range->state != RANGE_BUSY || op == NETSNMP_CALLBACK_OP_RESEND ||
+        op == NETSNMP_CALLBACK_OP_SEND_FAILED)
+        return 1;
+    range->state = RANGE_IDLE;
+    walk->outstanding--;
+
+    if (walk->finished)
+        range->state = RANGE_DONE;
+    else if (op == NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE)
+        _walk_process(range, pdu);
+    else
+        _walk_fail(walk, range, op == NETSNMP_CALLBACK_OP_TIMED_OUT ?
+                   STAT_TIMEOUT : STAT_ERROR);
+
+    _walk_fill(walk);
+    _walk_deliver(walk);
+    _walk_release(walk);
+    return 1;
+}
+
+/**
+ * Creates a walk of the subtree below root on the session sessp, which
+ * is what snmp_sess_open() returns, or snmp_sess_pointer() for a session
+ * opened with snmp_open().  The callback is called as described in
+ * snmp_walk.h.  Set max_repetitions, parallel and flags in the walk
+ * before netsnmp_walk_start().
+ *
+ * @return the walk, or NULL if out of memory.
+ */
+netsnmp_walk   *
+netsnmp_walk_create(void *sessp, const oid *root, size_t root_len,
+                    netsnmp_walk_callback *callback, void *magic)
+{
+    netsnmp_session *session = snmp_sess_session(sessp);
+    netsnmp_walk   *walk;
+    netsnmp_walk_range *range;
+
+    if (session == NULL || callback == NULL || root_len == 0 ||
+        root_len > MAX_OID_LEN)
+        return NULL;
+    walk = SNMP_MALLOC_TYPEDEF(netsnmp_walk);
+    if (walk == NULL)
+        return NULL;
+    walk->max_repetitions = 10;
+    walk->parallel = 1;
+    walk->sessp = sessp;
+    walk->version = session->version;
+    memcpy(walk->root, root, root_len * sizeof(oid));
+    walk->root_len = root_len;
+    walk->callback = callback;
+    walk->magic = magic;
+
+    range = _walk_range_new(walk, root, root_len, NULL, 0);
+    if (range == NULL) {
+        free(walk);
+        return NULL;
+    }
+    _walk_range_append(walk, range);
+    return walk;
+}
+
+/**
+ * Splits the walk at name, which must be below the root: one range
+ * then ends with name and the next one starts after it.  Instead of
+ * splitting by column, the walk keeps the ranges so made, and walks up
+ * to parallel of them at a time.  Must be called before
+ * netsnmp_walk_start().
+ *
+ * @return SNMPERR_SUCCESS, or SNMPERR_GENERR if name is not below the
+ *         root or the walk has been started.
+ */
+int
+netsnmp_walk_split_at(netsnmp_walk *walk, const oid *name, size_t len)
+{
+    netsnmp_walk_range *range, *split;
+
+    if (walk == NULL || walk->started || len > MAX_OID_LEN ||
+        !_walk_in_subtree(walk->root, walk->root_len, name, len))
+        return SNMPERR_GENERR;
+    for (range = walk->ranges; range; range = range->next)
+        if (snmp_oid_compare(name, len, range->cursor,
+                             range->cursor_len) > 0 &&
+            (range->end_len == 0 ||
+             snmp_oid_compare(name, len, range->end, range->end_len) < 0))
+            break;
+    if (range == NULL)
+        return SNMPERR_SUCCESS;         /* already split there */
+
+    split = _walk_range_new(walk, name, len, range->end, range->end_len);
+    if (split == NULL)
+        return SNMPERR_GENERR;
+    memcpy(range->end, name, len * sizeof(oid));
+    range->end_len = len;
+    split->next = range->next;
+    range->next = split;
+    if (walk->last_range == range)
+        walk->last_range = split;
+    walk->explicit_split = 1;
+    return SNMPERR_SUCCESS;
+}
+
+/**
+ * Starts the walk.  From here on the walk is driven by the responses
+ * that snmp_read() or snmp_sess_read() process, and it frees itself
+ * after the NETSNMP_WALK_OP_DONE callback.
+ *
+ * @return SNMPERR_SUCCESS, or SNMPERR_GENERR if no request could be
+ *         sent, in which case the NETSNMP_WALK_OP_DONE callback has
+ *         already been called.
+ */
+int
+netsnmp_walk_start(netsnmp_walk *walk)
+{
+    int             rc;
+
+    if (walk == NULL || walk->started)
+        return SNMPERR_GENERR;
+    walk->started = 1;
+    if (walk->parallel < 1)
+        walk->parallel = 1;
+    if (walk->max_repetitions < 1)
+        walk->max_repetitions = 1;
+    DEBUGMSGTL(("snmp_walk", "walking "));
+    DEBUGMSGOID(("snmp_walk", walk->root, walk->root_len));
+    DEBUGMSG(("snmp_walk", ", %d in parallel\n", walk->parallel));
+
+    _walk_fill(walk);
+    rc = (walk->finished && walk->status != STAT_SUCCESS) ?
+        SNMPERR_GENERR : SNMPERR_SUCCESS;
+    _walk_release(walk);
+    return rc;
+}
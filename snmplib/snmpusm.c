@@ -214,6 +214,27 @@ static struct usmUser *noNameUser = NULL;
  * Local storage (LCD) of the default user list.
  */
 static struct usmUser *userList = NULL;
+/*
+ * Hash index of userList by engineID and name, kept up to date by
+ * usm_add_user() and the functions that remove users, so that finding
+ * the user of an incoming message does not need a walk of the list.
+ */
+static struct usmUser **userHash = NULL;
+static size_t   userHashSize = 0, userHashCount = 0;
+static int      userHashIncomplete = 0;   /* a user could not be added */
+#define USM_USER_HASH_MIN 64
+/*
+ * usm_add_user() appends to userList; the list is put back in order
+ * when it is next handed out by usm_get_userList().
+ */
+static struct usmUser *userListTail = NULL;
+static int      userListSorted = 1;
+
+static void     usm_sort_user_list(void);
+static netsnmp_sc_cache **usm_user_sc_cache(struct usmUser *user);
+static netsnmp_sc_cache **usm_ref_sc_cache(struct usmStateReference *ref,
+                                           const u_char * engineID,
+                                           size_t engineIDLen);
 
 /*
  * Prototypes
@@ -323,6 +344,8 @@ usm_free_usmStateReference(void *old)
 struct usmUser *
 usm_get_userList(void)
 {
+    if (!userListSorted)
+        usm_sort_user_list();
     return userList;
 }
 
@@ -992,6 +1015,7 @@ usm_generate_out_msg(int msgProcModel,  /* (UNUSED) */
     u_int           thePrivKeyLength = 0;
     const oid      *thePrivProtocol = NULL;
     u_int           thePrivProtocolLength = 0;
+    netsnmp_sc_cache **theCache = NULL;
     int             theSecLevel = 0;    /* No defined const for bad
                                          * value (other then err).
                                          */
@@ -1024,6 +1048,7 @@ usm_generate_out_msg(int msgProcModel,  /* (UNUSED) */
         thePrivKey = ref->usr_priv_key;
         thePrivKeyLength = ref->usr_priv_key_length;
         theSecLevel = ref->usr_sec_level;
+        theCache = usm_ref_sc_cache(ref, theEngineID, theEngineIDLength);
     }
 
     /*
@@ -1057,6 +1082,7 @@ usm_generate_out_msg(int msgProcModel,  /* (UNUSED) */
             thePrivProtocolLength = user->privProtocolLen;
             thePrivKey = user->privKey;
             thePrivKeyLength = user->privKeyLen;
+            theCache = usm_user_sc_cache(user);
         } else {
             /*
              * unknown users can not do authentication (obviously) 
@@ -1191,11 +1217,12 @@ usm_generate_out_msg(int msgProcModel,  /* (UNUSED) */
         }
 #endif
 
-        if (sc_encrypt(thePrivProtocol, thePrivProtocolLength,
-                       thePrivKey, thePrivKeyLength,
-                       salt, salt_length,
-                       scopedPdu, scopedPduLen,
-                       &ptr[dataOffset], &encrypted_length)
+        if (sc_encrypt_cached(theCache,
+                              thePrivProtocol, thePrivProtocolLength,
+                              thePrivKey, thePrivKeyLength,
+                              salt, salt_length,
+                              scopedPdu, scopedPduLen,
+                              &ptr[dataOffset], &encrypted_length)
             != SNMP_ERR_NOERROR) {
             DEBUGMSGTL(("usm", "encryption error.\n"));
             usm_free_usmStateReference(secStateRef);
@@ -1366,9 +1393,11 @@ usm_generate_out_msg(int msgProcModel,  /* (UNUSED) */
             return SNMPERR_USM_GENERICERROR;
         }
 
-        if (sc_generate_keyed_hash(theAuthProtocol, theAuthProtocolLength,
-                                   theAuthKey, theAuthKeyLength,
-                                   ptr, ptr_len, temp_sig, &temp_sig_len)
+        if (sc_generate_keyed_hash_cached(theCache, theAuthProtocol,
+                                          theAuthProtocolLength,
+                                          theAuthKey, theAuthKeyLength,
+                                          ptr, ptr_len,
+                                          temp_sig, &temp_sig_len)
             != SNMP_ERR_NOERROR) {
             /*
              * FIX temp_sig_len defined?!
@@ -1500,6 +1529,7 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
     u_int           thePrivKeyLength = 0;
     const oid      *thePrivProtocol = NULL;
     u_int           thePrivProtocolLength = 0;
+    netsnmp_sc_cache **theCache = NULL;
     int             theSecLevel = 0;    /* No defined const for bad
                                          * value (other then err). */
     size_t          salt_length = 0, save_salt_length = 0;
@@ -1537,6 +1567,7 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
         thePrivKey = ref->usr_priv_key;
         thePrivKeyLength = ref->usr_priv_key_length;
         theSecLevel = ref->usr_sec_level;
+        theCache = usm_ref_sc_cache(ref, theEngineID, theEngineIDLength);
     }
 
     /*
@@ -1570,6 +1601,7 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
             thePrivProtocolLength = user->privProtocolLen;
             thePrivKey = user->privKey;
             thePrivKeyLength = user->privKeyLen;
+            theCache = usm_user_sc_cache(user);
         } else {
             /*
              * unknown users can not do authentication (obviously) 
@@ -1684,11 +1716,13 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
         }
 #endif
 
-        if (sc_encrypt(thePrivProtocol, thePrivProtocolLength,
-                       thePrivKey, thePrivKeyLength,
-                       salt, salt_length,
-                       scopedPdu, scopedPduLen,
-                       ciphertext, &ciphertextlen) != SNMP_ERR_NOERROR) {
+        if (sc_encrypt_cached(theCache,
+                              thePrivProtocol, thePrivProtocolLength,
+                              thePrivKey, thePrivKeyLength,
+                              salt, salt_length,
+                              scopedPdu, scopedPduLen,
+                              ciphertext, &ciphertextlen)
+            != SNMP_ERR_NOERROR) {
             DEBUGMSGTL(("usm", "encryption error.\n"));
             usm_free_usmStateReference(secStateRef);
             SNMP_FREE(ciphertext);
@@ -1915,10 +1949,11 @@ usm_rgenerate_out_msg(int msgProcModel, /* (UNUSED) */
             return SNMPERR_USM_GENERICERROR;
         }
 
-        if (sc_generate_keyed_hash(theAuthProtocol, theAuthProtocolLength,
-                                   theAuthKey, theAuthKeyLength,
-                                   proto_msg, proto_msg_len,
-                                   temp_sig, &temp_sig_len)
+        if (sc_generate_keyed_hash_cached(theCache, theAuthProtocol,
+                                          theAuthProtocolLength,
+                                          theAuthKey, theAuthKeyLength,
+                                          proto_msg, proto_msg_len,
+                                          temp_sig, &temp_sig_len)
             != SNMP_ERR_NOERROR) {
             SNMP_FREE(temp_sig);
             DEBUGMSGTL(("usm", "Signing failed.\n"));
@@ -2604,10 +2639,12 @@ usm_process_in_msg(int msgProcModel,    /* (UNUSED) */
      */
     if (secLevel == SNMP_SEC_LEVEL_AUTHNOPRIV
         || secLevel == SNMP_SEC_LEVEL_AUTHPRIV) {
-        if (sc_check_keyed_hash(user->authProtocol, user->authProtocolLen,
-                                user->authKey, user->authKeyLen,
-                                wholeMsg, wholeMsgLen,
-                                signature, signature_length)
+        if (sc_check_keyed_hash_cached(usm_user_sc_cache(user),
+                                       user->authProtocol,
+                                       user->authProtocolLen,
+                                       user->authKey, user->authKeyLen,
+                                       wholeMsg, wholeMsgLen,
+                                       signature, signature_length)
             != SNMP_ERR_NOERROR) {
             DEBUGMSGTL(("usm", "Verification failed.\n"));
             snmp_increment_statistic(STAT_USMSTATSWRONGDIGESTS);
@@ -2768,10 +2805,11 @@ usm_process_in_msg(int msgProcModel,    /* (UNUSED) */
             dump_chunk("usm/dump", "IV + Encrypted form:", iv, iv_length);
         }
 #endif
-        if (sc_decrypt(user->privProtocol, user->privProtocolLen,
-                       user->privKey, user->privKeyLen,
-                       iv, iv_length,
-                       value_ptr, remaining, *scopedPdu, scopedPduLen)
+        if (sc_decrypt_cached(usm_user_sc_cache(user),
+                              user->privProtocol, user->privProtocolLen,
+                              user->privKey, user->privKeyLen,
+                              iv, iv_length,
+                              value_ptr, remaining, *scopedPdu, scopedPduLen)
             != SNMP_ERR_NOERROR) {
             DEBUGMSGTL(("usm", "%s\n", "Failed decryption."));
             snmp_increment_statistic(STAT_USMSTATSDECRYPTIONERRORS);
@@ -3550,6 +3588,11 @@ clear_user_list(void)
 {
     struct usmUser *tmp = userList, *next = NULL;
 
+    SNMP_FREE(userHash);
+    userHashSize = userHashCount = 0;
+    userHashIncomplete = 0;
+    userListTail = NULL;
+    userListSorted = 1;
     while (tmp != NULL) {
 	next = tmp->next;
 	usm_free_user(tmp);
@@ -3686,6 +3729,177 @@ usm_check_secLevel_vs_protocols(int level,
 
 
 
+/*
+ * FNV-1a hash of an engineID and user name.
+ */
+static u_int
+usm_user_hash(const u_char * engineID, size_t engineIDLen, const char *name)
+{
+    u_int           hash = 2166136261U;
+    size_t          i;
+
+    if (engineID)
+        for (i = 0; i < engineIDLen; i++)
+            hash = (hash ^ engineID[i]) * 16777619U;
+    hash = (hash ^ (u_int) engineIDLen) * 16777619U;
+    for (; *name; name++)
+        hash = (hash ^ (u_char) *name) * 16777619U;
+    return hash;
+}
+
+static int
+usm_user_matches(const struct usmUser *user, const u_char * engineID,
+                 size_t engineIDLen, const char *name)
+{
+    return user->name && !strcmp(user->name, name) &&
+        user->engineIDLen == engineIDLen &&
+        ((user->engineID == NULL && engineID == NULL) ||
+         (user->engineID != NULL && engineID != NULL &&
+          memcmp(user->engineID, engineID, engineIDLen) == 0));
+}
+
+static struct usmUser *
+usm_user_hash_find(const u_char * engineID, size_t engineIDLen,
+                   const char *name)
+{
+    struct usmUser *ptr;
+
+    if (userHashCount == 0)
+        return NULL;
+    for (ptr = userHash[usm_user_hash(engineID, engineIDLen, name) &
+                        (userHashSize - 1)]; ptr; ptr = ptr->hashNext)
+        if (usm_user_matches(ptr, engineID, engineIDLen, name))
+            return ptr;
+    return NULL;
+}
+
+/*
+ * Returns the crypto key state cached for a user.  A reentrant library
+ * may use a user from two threads at once, and a cache mustn't be, so
+ * it keeps none there.
+ */
+static netsnmp_sc_cache **
+usm_user_sc_cache(struct usmUser *user)
+{
+#ifdef NETSNMP_REENTRANT
+    return NULL;
+#else
+    return &user->scCache;
+#endif
+}
+
+/*
+ * Returns the crypto key state of the user a response goes to, so that
+ * it is shared with the requests of that user.  The state checks the
+ * keys it is used with by itself.
+ */
+static netsnmp_sc_cache **
+usm_ref_sc_cache(struct usmStateReference *ref, const u_char * engineID,
+                 size_t engineIDLen)
+{
+    struct usmUser *user;
+    char            name[SNMP_MAX_SEC_NAME_SIZE];
+
+    if (ref->usr_sec_level < SNMP_SEC_LEVEL_AUTHNOPRIV ||
+        ref->usr_name == NULL || ref->usr_name_length >= sizeof(name))
+        return NULL;
+    memcpy(name, ref->usr_name, ref->usr_name_length);
+    name[ref->usr_name_length] = '\0';
+    user = usm_user_hash_find(engineID, engineIDLen, name);
+    return user ? usm_user_sc_cache(user) : NULL;
+}
+
+/*
+ * Adds a user of userList to the hash, growing it to keep the chains
+ * short.  If memory runs out, lookups that miss in the hash go on to
+ * walk the list.
+ */
+static void
+usm_user_hash_add(struct usmUser *user)
+{
+    struct usmUser **table, *ptr, *next;
+    size_t          size, i;
+    u_int           bucket;
+
+    if (user->name == NULL)
+        return;
+    if (userHashCount >= userHashSize) {
+        size = userHashSize ? 2 * userHashSize : USM_USER_HASH_MIN;
+        table = (struct usmUser **) calloc(size, sizeof(struct usmUser *));
+        if (table == NULL && userHashSize == 0) {
+            userHashIncomplete = 1;
+            return;
+        }
+        if (table != NULL) {
+            for (i = 0; i < userHashSize; i++)
+                for (ptr = userHash[i]; ptr; ptr = next) {
+                    next = ptr->hashNext;
+                    bucket = usm_user_hash(ptr->engineID, ptr->engineIDLen,
+                                           ptr->name) & (size - 1);
+                    ptr->hashNext = table[bucket];
+                    table[bucket] = ptr;
+                }
+            free(userHash);
+            userHash = table;
+            userHashSize = size;
+        }
+    }
+    bucket = usm_user_hash(user->engineID, user->engineIDLen, user->name) &
+        (userHashSize - 1);
+    user->hashNext = userHash[bucket];
+    userHash[bucket] = user;
+    userHashCount++;
+}
+
+/*
+ * Removes a user from the hash.  Returns 1 if it was there, i.e. if the
+ * user is in userList.
+ */
+static int
+usm_user_hash_remove(struct usmUser *user)
+{
+    struct usmUser **pptr;
+
+    if (userHashCount == 0 || user->name == NULL)
+        return 0;
+    for (pptr = &userHash[usm_user_hash(user->engineID, user->engineIDLen,
+                                        user->name) & (userHashSize - 1)];
+         *pptr; pptr = &(*pptr)->hashNext)
+        if (*pptr == user) {
+            *pptr = user->hashNext;
+            user->hashNext = NULL;
+            userHashCount--;
+            return 1;
+        }
+    return 0;
+}
+
+/*
+ * Compares two users in the order usm_add_user_to_list() keeps: by
+ * engineID length, engineID, name length and name.
+ */
+static int
+usm_user_compare(const struct usmUser *a, const struct usmUser *b)
+{
+    const char     *aname = a->name ? a->name : "";
+    const char     *bname = b->name ? b->name : "";
+    size_t          alen, blen;
+    int             rc;
+
+    if (a->engineIDLen != b->engineIDLen)
+        return a->engineIDLen < b->engineIDLen ? -1 : 1;
+    if (a->engineID == NULL || b->engineID == NULL) {
+        if (a->engineID != b->engineID)
+            return a->engineID == NULL ? -1 : 1;
+    } else if ((rc = memcmp(a->engineID, b->engineID, a->engineIDLen)) != 0)
+        return rc;
+    alen = strlen(aname);
+    blen = strlen(bname);
+    if (alen != blen)
+        return alen < blen ? -1 : 1;
+    return strcmp(aname, bname);
+}
+
 /*
  * usm_get_user(): Returns a user from userList based on the engineID,
  * engineIDLen and name of the requested user. 
@@ -3708,6 +3922,15 @@ usm_get_user_from_list(u_char * engineID, size_t engineIDLen,
     char            noName[] = "";
     if (name == NULL)
         name = noName;
+    if (puserList != NULL && puserList == userList) {
+        ptr = usm_user_hash_find(engineID, engineIDLen, name);
+        if (ptr != NULL) {
+            DEBUGMSGTL(("usm", "match on user %s\n", ptr->name));
+            return ptr;
+        }
+        if (!userHashIncomplete)
+            puserList = NULL;
+    }
     for (ptr = puserList; ptr != NULL; ptr = ptr->next) {
         if (ptr->name && !strcmp(ptr->name, name)) {
           DEBUGMSGTL(("usm", "match on user %s\n", ptr->name));
@@ -3734,6 +3957,53 @@ usm_get_user_from_list(u_char * engineID, size_t engineIDLen,
     return NULL;
 }
 
+/*
+ * Merge sorts userList into the order usm_add_user_to_list() keeps.
+ */
+static void
+usm_sort_user_list(void)
+{
+    struct usmUser *in, *out, **tail, *a, *b;
+    size_t          width, alen, blen;
+    int             merges;
+
+    for (width = 1, in = userList; ; width *= 2, in = out) {
+        out = NULL;
+        tail = &out;
+        merges = 0;
+        while (in) {
+            merges++;
+            a = in;
+            for (alen = 0; in && alen < width; alen++)
+                in = in->next;
+            b = in;
+            for (blen = 0; in && blen < width; blen++)
+                in = in->next;
+            while (alen > 0 || blen > 0) {
+                if (alen > 0 && (blen == 0 || usm_user_compare(a, b) <= 0)) {
+                    *tail = a;
+                    a = a->next;
+                    alen--;
+                } else {
+                    *tail = b;
+                    b = b->next;
+                    blen--;
+                }
+                tail = &(*tail)->next;
+            }
+        }
+        *tail = NULL;
+        if (merges <= 1)
+            break;
+    }
+
+    userList = out;
+    userListTail = NULL;
+    for (a = userList; a; userListTail = a, a = a->next)
+        a->prev = userListTail;
+    userListSorted = 1;
+}
+
 /*
  * usm_add_user(): Add's a user to the userList, sorted by the
  * engineIDLength then the engineID then the name length then the name
@@ -3741,16 +4011,47 @@ usm_get_user_from_list(u_char * engineID, size_t engineIDLen,
  * these values.
  * 
  * returns the head of the list (which could change due to this add).
+ *
+ * An existing entry for the same user is replaced.  The user is
+ * appended to the list, which is sorted again only when it is next
+ * handed out by usm_get_userList(), so that adding many users (as when
+ * reading the configuration) does not need a walk of the list per user.
  */
 
 struct usmUser *
 usm_add_user(struct usmUser *user)
 {
     struct usmUser *uptr;
-    uptr = usm_add_user_to_list(user, userList);
-    if (uptr != NULL)
-        userList = uptr;
-    return uptr;
+
+    if (user->name == NULL) {
+        uptr = usm_add_user_to_list(user, usm_get_userList());
+        if (uptr != NULL)
+            userList = uptr;
+        return uptr;
+    }
+
+    uptr = usm_user_hash_find(user->engineID, user->engineIDLen, user->name);
+    if (uptr != NULL && uptr != user) {
+        usm_remove_usmUser_from_list(uptr, &userList);
+        uptr->next = uptr->prev = NULL;
+        usm_free_user(uptr);
+    }
+
+    if (userListTail == NULL || userListTail->next != NULL)
+        for (userListTail = userList; userListTail && userListTail->next;
+             userListTail = userListTail->next)
+            ;
+    user->next = NULL;
+    user->prev = userListTail;
+    if (userListTail != NULL) {
+        if (userListSorted && usm_user_compare(userListTail, user) > 0)
+            userListSorted = 0;
+        userListTail->next = user;
+    } else
+        userList = user;
+    userListTail = user;
+    usm_user_hash_add(user);
+    return userList;
 }
 
 struct usmUser *
@@ -3886,10 +4187,15 @@ usm_remove_usmUser_from_list(struct usmUser *user, struct usmUser **ppuserList)
     /*
      * find the user in the list 
      */
-    for (nptr = *ppuserList, pptr = NULL; nptr != NULL;
-         pptr = nptr, nptr = nptr->next) {
-        if (nptr == user)
-            break;
+    if (ppuserList == &userList && usm_user_hash_remove(user)) {
+        nptr = user;
+        pptr = user->prev;
+    } else {
+        for (nptr = *ppuserList, pptr = NULL; nptr != NULL;
+             pptr = nptr, nptr = nptr->next) {
+            if (nptr == user)
+                break;
+        }
     }
 
     if (nptr) {
@@ -3902,6 +4208,8 @@ usm_remove_usmUser_from_list(struct usmUser *user, struct usmUser **ppuserList)
         if (nptr->next) {
             nptr->next->prev = pptr;
         }
+        if (nptr == userListTail)
+            userListTail = pptr;
     } else {
         /*
          * user didn't exist 
@@ -3962,6 +4270,18 @@ usm_free_user(struct usmUser *user)
     if (user == NULL)
         return NULL;
 
+    if (usm_user_hash_remove(user)) {   /* still in userList */
+        if (user->prev)
+            user->prev->next = user->next;
+        else
+            userList = user->next;
+        if (user->next)
+            user->next->prev = user->prev;
+        else
+            userListTail = user->prev;
+        user->prev = user->next = NULL;
+    }
+
     SNMP_FREE(user->engineID);
     SNMP_FREE(user->name);
     SNMP_FREE(user->secName);
@@ -3970,6 +4290,9 @@ usm_free_user(struct usmUser *user)
     SNMP_FREE(user->authProtocol);
     SNMP_FREE(user->privProtocol);
 
+    sc_free_cache(user->scCache);
+    user->scCache = NULL;
+
     if (user->authKey != NULL) {
         SNMP_ZERO(user->authKey, user->authKeyLen);
         SNMP_FREE(user->authKey);
@@ -4243,7 +4566,7 @@ usm_store_users(int majorID, int minorID, void *serverarg, void *clientarg)
 void
 usm_save_users(const char *token, const char *type)
 {
-    usm_save_users_from_list(userList, token, type);
+    usm_save_users_from_list(usm_get_userList(), token, type);
 }
 
 void
@@ -52,6 +52,7 @@
 #include <net-snmp/library/default_store.h>
 #include <net-snmp/library/system.h>
 #include <net-snmp/library/snmp_assert.h>
+#include <net-snmp/library/snmp_api.h>
 
 #ifndef  MSG_DONTWAIT
 #define MSG_DONTWAIT 0
@@ -134,6 +135,40 @@ static LPFN_WSARECVMSG pfWSARecvMsg;
 static LPFN_WSASENDMSG pfWSASendMsg;
 #endif
 
+#if !defined(WIN32)
+/*
+ * Copy the destination address and interface of a received datagram from
+ * its ancillary data into dstip and if_index.
+ */
+static void
+_udpbase_get_pktinfo(struct msghdr *msg, struct sockaddr *dstip,
+                     int *if_index)
+{
+    struct cmsghdr *cm;
+
+    for (cm = CMSG_FIRSTHDR(msg); cm != NULL; cm = CMSG_NXTHDR(msg, cm)) {
+#if defined(HAVE_IP_PKTINFO)
+        if (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_PKTINFO) {
+            struct in_pktinfo* src = (struct in_pktinfo *)CMSG_DATA(cm);
+            netsnmp_assert(dstip->sa_family == AF_INET);
+            ((struct sockaddr_in*)dstip)->sin_addr = src->ipi_addr;
+            *if_index = src->ipi_ifindex;
+            DEBUGMSGTL(("udpbase:recv",
+                        "got destination (local) addr %s, iface %d\n",
+                        inet_ntoa(src->ipi_addr), *if_index));
+        }
+#elif defined(HAVE_IP_RECVDSTADDR)
+        if (cm->cmsg_level == IPPROTO_IP && cm->cmsg_type == IP_RECVDSTADDR) {
+            struct in_addr* src = (struct in_addr *)CMSG_DATA(cm);
+            ((struct sockaddr_in*)dstip)->sin_addr = *src;
+            DEBUGMSGTL(("netsnmp_udp", "got destination (local) addr %s\n",
+                        inet_ntoa(*src)));
+        }
+#endif
+    }
+}
+#endif /* !defined(WIN32) */
+
 int
 netsnmp_udpbase_recvfrom(int s, void *buf, int len, struct sockaddr *from,
                          socklen_t *fromlen, struct sockaddr *dstip,
@@ -143,7 +178,6 @@ netsnmp_udpbase_recvfrom(int s, void *buf, int len, struct sockaddr *from,
 #if !defined(WIN32)
     struct iovec iov;
     char cmsg[CMSG_SPACE(cmsg_data_size)];
-    struct cmsghdr *cm;
     struct msghdr msg;
 
     iov.iov_base = buf;
@@ -199,26 +233,7 @@ netsnmp_udpbase_recvfrom(int s, void *buf, int len, struct sockaddr *from,
     }
 
 #if !defined(WIN32)
-    for (cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
-#if defined(HAVE_IP_PKTINFO)
-        if (cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_PKTINFO) {
-            struct in_pktinfo* src = (struct in_pktinfo *)CMSG_DATA(cm);
-            netsnmp_assert(dstip->sa_family == AF_INET);
-            ((struct sockaddr_in*)dstip)->sin_addr = src->ipi_addr;
-            *if_index = src->ipi_ifindex;
-            DEBUGMSGTL(("udpbase:recv",
-                        "got destination (local) addr %s, iface %d\n",
-                        inet_ntoa(src->ipi_addr), *if_index));
-        }
-#elif defined(HAVE_IP_RECVDSTADDR)
-        if (cm->cmsg_level == IPPROTO_IP && cm->cmsg_type == IP_RECVDSTADDR) {
-            struct in_addr* src = (struct in_addr *)CMSG_DATA(cm);
-            ((struct sockaddr_in*)dstip)->sin_addr = *src;
-            DEBUGMSGTL(("netsnmp_udp", "got destination (local) addr %s\n",
-                        inet_ntoa(*src)));
-        }
-#endif
-    }
+    _udpbase_get_pktinfo(&msg, dstip, if_index);
 #else /* !defined(WIN32) */
     for (cm = WSA_CMSG_FIRSTHDR(&msg); cm; cm = WSA_CMSG_NXTHDR(&msg, cm)) {
         if (cm->cmsg_level == IPPROTO_IP && cm->cmsg_type == IP_PKTINFO) {
@@ -380,6 +395,209 @@ int netsnmp_udpbase_sendto(int fd, const struct in_addr *srcip, int if_index,
     return rc;
 #endif /* !defined(WIN32) */
 }
+
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG) && \
+    defined(HAVE_IP_PKTINFO) && !defined(WIN32)
+
+#define netsnmp_udpbase_batch_defined
+
+#define NETSNMP_UDP_BATCH_DEFAULT 16
+#define NETSNMP_UDP_BATCH_MAX     64
+
+typedef union {
+    struct cmsghdr  hdr;
+    char            buf[CMSG_SPACE(cmsg_data_size)];
+} netsnmp_udpbase_cmsg;
+
+/*
+ * Server transports receive up to serverBatchSize datagrams with one
+ * recvmmsg() call and hand them out one per f_recv call, setting
+ * NETSNMP_TRANSPORT_FLAG_MORE_PKTS while some are left.  Responses sent
+ * while the session layer has the transport corked are queued and sent
+ * with one sendmmsg() call by netsnmp_udpbase_flush().  Client transports
+ * only get the send queue, for applications that cork them while sending
+ * many requests or notifications.
+ */
+typedef struct netsnmp_udpbase_batch_s {
+    int                  size;      /* slots in use */
+    int                  send_only; /* no receive buffers */
+    int                  count;     /* datagrams from the last recvmmsg() */
+    int                  next;      /* next datagram to hand out */
+    int                  nsend;     /* responses queued for sendmmsg() */
+    struct sockaddr_in   local;     /* address the socket is bound to */
+
+    struct mmsghdr       rmsg[NETSNMP_UDP_BATCH_MAX];
+    struct iovec         riov[NETSNMP_UDP_BATCH_MAX];
+    struct sockaddr_in   rfrom[NETSNMP_UDP_BATCH_MAX];
+    netsnmp_udpbase_cmsg rcmsg[NETSNMP_UDP_BATCH_MAX];
+
+    struct mmsghdr       smsg[NETSNMP_UDP_BATCH_MAX];
+    struct iovec         siov[NETSNMP_UDP_BATCH_MAX];
+    netsnmp_indexed_addr_pair saddr[NETSNMP_UDP_BATCH_MAX];
+    netsnmp_udpbase_cmsg scmsg[NETSNMP_UDP_BATCH_MAX];
+
+    u_char               buf[1];    /* size receive buffers of msgMaxSize */
+} netsnmp_udpbase_batch;
+
+static netsnmp_udpbase_batch *
+_udpbase_batch_get(netsnmp_transport *t)
+{
+    netsnmp_udpbase_batch *b = (netsnmp_udpbase_batch *) t->batch;
+    int                    size, i;
+
+    if (NULL != b)
+        return b->send_only ? NULL : b;
+
+    /** only server transports; client sessions see one response at a time */
+    if (NULL != t->remote || t->msgMaxSize == 0)
+        return NULL;
+
+    size = netsnmp_ds_get_int(NETSNMP_DS_LIBRARY_ID,
+                              NETSNMP_DS_LIB_SERVERBATCHSIZE);
+    if (size <= 0)
+        size = NETSNMP_UDP_BATCH_DEFAULT;
+    else if (size > NETSNMP_UDP_BATCH_MAX)
+        size = NETSNMP_UDP_BATCH_MAX;
+    if (size == 1)
+        return NULL;
+
+    b = (netsnmp_udpbase_batch *)
+        calloc(1, offsetof(netsnmp_udpbase_batch, buf) +
+               size * t->msgMaxSize);
+    if (NULL == b)
+        return NULL;
+
+    b->size = size;
+    for (i = 0; i < size; i++) {
+        b->riov[i].iov_base = b->buf + i * t->msgMaxSize;
+        b->riov[i].iov_len = t->msgMaxSize;
+        b->rmsg[i].msg_hdr.msg_name = &b->rfrom[i];
+        b->rmsg[i].msg_hdr.msg_iov = &b->riov[i];
+        b->rmsg[i].msg_hdr.msg_iovlen = 1;
+        b->rmsg[i].msg_hdr.msg_control = &b->rcmsg[i];
+    }
+    DEBUGMSGTL(("udpbase:batch", "fd %d: batches of %d datagrams\n",
+                t->sock, size));
+    t->batch = b;
+    return b;
+}
+
+static netsnmp_udpbase_batch *
+_udpbase_batch_get_send(netsnmp_transport *t)
+{
+    netsnmp_udpbase_batch *b = (netsnmp_udpbase_batch *) t->batch;
+
+    if (NULL != b || NULL == t->remote)
+        return b;
+
+    b = SNMP_MALLOC_TYPEDEF(netsnmp_udpbase_batch);
+    if (NULL == b)
+        return NULL;
+    b->size = NETSNMP_UDP_BATCH_MAX;
+    b->send_only = 1;
+    DEBUGMSGTL(("udpbase:batch", "fd %d: send batches of %d datagrams\n",
+                t->sock, b->size));
+    t->batch = b;
+    return b;
+}
+
+static int
+_udpbase_batch_recv(netsnmp_transport *t, netsnmp_udpbase_batch *b,
+                    void *buf, int size, netsnmp_indexed_addr_pair *addr_pair)
+{
+    struct msghdr *m;
+    socklen_t      local_len;
+    int            rc, i;
+
+    if (b->next >= b->count) {
+        b->count = b->next = 0;
+        for (i = 0; i < b->size; i++) {
+            b->rmsg[i].msg_hdr.msg_namelen = sizeof(b->rfrom[i]);
+            b->rmsg[i].msg_hdr.msg_controllen = sizeof(b->rcmsg[i]);
+            b->rmsg[i].msg_hdr.msg_flags = 0;
+        }
+        rc = recvmmsg(t->sock, b->rmsg, b->size, MSG_DONTWAIT, NULL);
+        if (rc <= 0)
+            return -1;
+        b->count = rc;
+
+        /* Get the local port number once for the whole batch */
+        local_len = sizeof(b->local);
+        if (getsockname(t->sock, (struct sockaddr *) &b->local,
+                        &local_len) != 0) {
+            memset(&b->local, 0, sizeof(b->local));
+            b->local.sin_family = AF_INET;
+        }
+
+        snmp_increment_statistic(STAT_UDP_RECVBATCHES);
+        snmp_increment_statistic_by(STAT_UDP_RECVBATCHPKTS, rc);
+        if (rc == b->size)
+            snmp_increment_statistic(STAT_UDP_RECVBATCHFULL);
+        DEBUGMSGTL(("udpbase:batch", "recvmmsg fd %d got %d datagrams\n",
+                    t->sock, rc));
+    }
+
+    i = b->next++;
+    m = &b->rmsg[i].msg_hdr;
+    rc = b->rmsg[i].msg_len;
+    if (rc > size)
+        rc = size;
+    memcpy(buf, b->riov[i].iov_base, rc);
+    memcpy(&addr_pair->remote_addr.sin, &b->rfrom[i], sizeof(b->rfrom[i]));
+    memcpy(&addr_pair->local_addr.sin, &b->local, sizeof(b->local));
+    _udpbase_get_pktinfo(m, &addr_pair->local_addr.sa, &addr_pair->if_index);
+    return rc;
+}
+
+static int
+_udpbase_batch_queue(netsnmp_transport *t, netsnmp_udpbase_batch *b,
+                     const netsnmp_indexed_addr_pair *addr_pair,
+                     const void *buf, int size)
+{
+    struct msghdr *m;
+    void          *copy;
+    int            i;
+
+    if (b->nsend >= b->size)
+        netsnmp_udpbase_flush(t);
+
+    copy = netsnmp_memdup(buf, size);
+    if (NULL == copy)
+        return -1;
+
+    i = b->nsend++;
+    memcpy(&b->saddr[i], addr_pair, sizeof(b->saddr[i]));
+    b->siov[i].iov_base = copy;
+    b->siov[i].iov_len = size;
+
+    m = &b->smsg[i].msg_hdr;
+    memset(m, 0, sizeof(*m));
+    m->msg_name = &b->saddr[i].remote_addr;
+    m->msg_namelen = sizeof(struct sockaddr_in);
+    m->msg_iov = &b->siov[i];
+    m->msg_iovlen = 1;
+
+    if (b->saddr[i].local_addr.sin.sin_addr.s_addr != INADDR_ANY) {
+        struct cmsghdr    *cm;
+        struct in_pktinfo  ipi;
+
+        memset(&b->scmsg[i], 0, sizeof(b->scmsg[i]));
+        m->msg_control = &b->scmsg[i];
+        m->msg_controllen = sizeof(b->scmsg[i]);
+
+        cm = CMSG_FIRSTHDR(m);
+        cm->cmsg_len = CMSG_LEN(cmsg_data_size);
+        cm->cmsg_level = SOL_IP;
+        cm->cmsg_type = IP_PKTINFO;
+
+        /* see netsnmp_udpbase_sendto() for why ipi_ifindex stays 0 */
+        memset(&ipi, 0, sizeof(ipi));
+        ipi.ipi_spec_dst.s_addr = b->saddr[i].local_addr.sin.sin_addr.s_addr;
+        memcpy(CMSG_DATA(cm), &ipi, sizeof(ipi));
+    }
+    return 0;
+}
+#endif /* HAVE_RECVMMSG && HAVE_SENDMMSG && HAVE_IP_PKTINFO && !WIN32 */
 #endif /* HAVE_IP_PKTINFO || HAVE_IP_RECVDSTADDR */
 
 /*
@@ -396,6 +614,9 @@ netsnmp_udpbase_recv(netsnmp_transport *t, void *buf, int size,
     socklen_t       fromlen = sizeof(netsnmp_sockaddr_storage);
     netsnmp_indexed_addr_pair *addr_pair = NULL;
     struct sockaddr *from;
+#ifdef netsnmp_udpbase_batch_defined
+    netsnmp_udpbase_batch *batch;
+#endif
 
     if (t != NULL && t->sock >= 0) {
         addr_pair = SNMP_MALLOC_TYPEDEF(netsnmp_indexed_addr_pair);
@@ -406,7 +627,16 @@ netsnmp_udpbase_recv(netsnmp_transport *t, void *buf, int size,
         } else
             from = &addr_pair->remote_addr.sa;
 
+#ifdef netsnmp_udpbase_batch_defined
+        batch = _udpbase_batch_get(t);
+#endif
 	while (rc < 0) {
+#ifdef netsnmp_udpbase_batch_defined
+            if (NULL != batch) {
+                rc = _udpbase_batch_recv(t, batch, buf, size, addr_pair);
+            } else
+#endif
+            {
 #ifdef netsnmp_udpbase_recvfrom_sendto_defined
             socklen_t local_addr_len = sizeof(addr_pair->local_addr);
             rc = netsnmp_udp_recvfrom(t->sock, buf, size, from, &fromlen,
@@ -415,10 +645,17 @@ netsnmp_udpbase_recv(netsnmp_transport *t, void *buf, int size,
 #else
             rc = recvfrom(t->sock, buf, size, MSG_DONTWAIT, from, &fromlen);
 #endif /* netsnmp_udpbase_recvfrom_sendto_defined */
+            }
 	    if (rc < 0 && errno != EINTR) {
 		break;
 	    }
 	}
+#ifdef netsnmp_udpbase_batch_defined
+        if (NULL != batch && batch->next < batch->count)
+            t->flags |= NETSNMP_TRANSPORT_FLAG_MORE_PKTS;
+        else
+            t->flags &= ~NETSNMP_TRANSPORT_FLAG_MORE_PKTS;
+#endif
 
         if (rc >= 0) {
             DEBUGIF("netsnmp_udp") {
@@ -448,6 +685,9 @@ netsnmp_udpbase_send(netsnmp_transport *t, const void *buf, int size,
     int rc = -1;
     const netsnmp_indexed_addr_pair *addr_pair = NULL;
     const struct sockaddr *to = NULL;
+#ifdef netsnmp_udpbase_batch_defined
+    netsnmp_udpbase_batch *batch;
+#endif
 
     if (opaque != NULL && *opaque != NULL && NULL != olength &&
         ((*olength == sizeof(netsnmp_indexed_addr_pair) ||
@@ -476,6 +716,12 @@ netsnmp_udpbase_send(netsnmp_transport *t, const void *buf, int size,
                         size, buf, str, t->sock));
             free(str);
         }
+#ifdef netsnmp_udpbase_batch_defined
+        if ((t->flags & NETSNMP_TRANSPORT_FLAG_CORKED) &&
+            NULL != (batch = _udpbase_batch_get_send(t)) &&
+            _udpbase_batch_queue(t, batch, addr_pair, buf, size) == 0)
+            return size;
+#endif
 	while (rc < 0) {
 #ifdef netsnmp_udpbase_recvfrom_sendto_defined
             rc = netsnmp_udp_sendto(t->sock,
@@ -494,6 +740,58 @@ netsnmp_udpbase_send(netsnmp_transport *t, const void *buf, int size,
     return rc;
 }
 
+/*
+ * Send the responses netsnmp_udpbase_send() queued while the transport was
+ * corked, as few sendmmsg() calls as possible.
+ */
+int
+netsnmp_udpbase_flush(netsnmp_transport *t)
+{
+#ifdef netsnmp_udpbase_batch_defined
+    netsnmp_udpbase_batch *b = t ? (netsnmp_udpbase_batch *) t->batch : NULL;
+    netsnmp_indexed_addr_pair *a;
+    int                    sent = 0, rc, i;
+
+    if (NULL == b || 0 == b->nsend)
+        return 0;
+
+    while (sent < b->nsend) {
+        rc = sendmmsg(t->sock, &b->smsg[sent], b->nsend - sent,
+                      MSG_NOSIGNAL|MSG_DONTWAIT);
+        if (rc < 0 && errno == EINTR)
+            continue;
+        if (rc > 0) {
+            snmp_increment_statistic(STAT_UDP_SENDBATCHES);
+            snmp_increment_statistic_by(STAT_UDP_SENDBATCHPKTS, rc);
+            DEBUGMSGTL(("udpbase:batch", "sendmmsg fd %d sent %d of %d\n",
+                        t->sock, rc, b->nsend - sent));
+            sent += rc;
+            continue;
+        }
+
+        /*
+         * The first remaining response could not be sent; let
+         * netsnmp_udpbase_sendto() retry it the way it would have without
+         * batching (e.g. when responding to a broadcast request).
+         */
+        a = &b->saddr[sent];
+        rc = netsnmp_udpbase_sendto(t->sock, &a->local_addr.sin.sin_addr,
+                                    a->if_index, &a->remote_addr.sa,
+                                    b->siov[sent].iov_base,
+                                    b->siov[sent].iov_len);
+        if (rc < 0)
+            DEBUGMSGTL(("netsnmp_udp", "sendto error, rc %d (errno %d)\n",
+                        rc, errno));
+        sent++;
+    }
+
+    for (i = 0; i < b->nsend; i++)
+        SNMP_FREE(b->siov[i].iov_base);
+    b->nsend = 0;
+#endif /* netsnmp_udpbase_batch_defined */
+    return 0;
+}
+
 void
 netsnmp_udp_base_ctor(void)
 {
@@ -143,6 +143,7 @@ netsnmp_udp_transport_base(netsnmp_transport *t)
     t->msgMaxSize = 0xffff - 8 - 20;
     t->f_recv     = netsnmp_udpbase_recv;
     t->f_send     = netsnmp_udpbase_send;
+    t->f_flush    = netsnmp_udpbase_flush;
     t->f_close    = netsnmp_socketbase_close;
     t->f_accept   = NULL;
     t->f_fmtaddr  = netsnmp_udp_fmtaddr;
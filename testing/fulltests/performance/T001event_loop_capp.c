@@ -0,0 +1,156 @@
+/*
+ * HEADER Event loop wakeup cost vs. number of idle sessions
+ *
+ * Opens an increasing number of idle UDP sessions and measures the cost
+ * of one event loop pass that is woken up by a pipe registered through
+ * register_readfd().  The select() pass is the one snmptrapd and
+ * agent_check_and_process() use; the epoll pass is only built when
+ * configured with --enable-epoll.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/fd_event_manager.h>
+#include <net-snmp/library/large_fd_set.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "perftest.h"
+
+#define ITERATIONS 2000
+
+static const int nsessions[] = { 10, 100, 1000 };
+static int       wakeups;
+static int       pipefd[2];
+
+static void
+read_byte(int fd, void *data)
+{
+    char buf[1];
+
+    if (read(fd, buf, 1) == 1)
+        wakeups++;
+}
+
+static void
+select_pass(netsnmp_large_fd_set *readfds, netsnmp_large_fd_set *writefds,
+            netsnmp_large_fd_set *exceptfds)
+{
+    struct timeval tv = { 5, 0 };
+    int            numfds = 0, block = 0, count;
+
+    NETSNMP_LARGE_FD_ZERO(readfds);
+    NETSNMP_LARGE_FD_ZERO(writefds);
+    NETSNMP_LARGE_FD_ZERO(exceptfds);
+    snmp_select_info2(&numfds, readfds, &tv, &block);
+    netsnmp_external_event_info2(&numfds, readfds, writefds, exceptfds);
+    count = netsnmp_large_fd_set_select(numfds, readfds, writefds, exceptfds,
+                                        &tv);
+    if (count > 0) {
+        netsnmp_dispatch_external_events2(&count, readfds, writefds,
+                                          exceptfds);
+        snmp_read2(readfds);
+    }
+}
+
+#ifdef NETSNMP_USE_EPOLL
+static void
+epoll_pass(void)
+{
+    struct timeval tv = { 5, 0 };
+    int            numfds = 0, block = 0;
+
+    snmp_select_info2(&numfds, NULL, &tv, &block);
+    netsnmp_epoll_dispatch(&tv);
+}
+#endif
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_large_fd_set readfds, writefds, exceptfds;
+    netsnmp_session session;
+    struct timeval  start;
+    struct rlimit   rl;
+    double          usec;
+    int             opened = 0, i, n;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < 1100 &&
+        rl.rlim_max >= 1100) {
+        rl.rlim_cur = 1100;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    init_snmp("event-loop-perf");
+    netsnmp_large_fd_set_init(&readfds, FD_SETSIZE);
+    netsnmp_large_fd_set_init(&writefds, FD_SETSIZE);
+    netsnmp_large_fd_set_init(&exceptfds, FD_SETSIZE);
+
+    OK(pipe(pipefd) == 0, "pipe created");
+    OK(register_readfd(pipefd[0], read_byte, NULL) == FD_REGISTERED_OK,
+       "pipe registered with the fd event manager");
+
+    snmp_sess_init(&session);
+    session.version = SNMP_VERSION_2c;
+    session.community = NETSNMP_REMOVE_CONST(u_char *, "public");
+    session.community_len = strlen("public");
+    session.peername = NETSNMP_REMOVE_CONST(char *, "udp:127.0.0.1:1");
+
+    for (n = 0; n < sizeof(nsessions) / sizeof(nsessions[0]); n++) {
+        while (opened < nsessions[n] && snmp_open(&session) != NULL)
+            opened++;
+        if (opened < nsessions[n]) {
+            printf("# could only open %d sessions\n", opened);
+            break;
+        }
+
+        wakeups = 0;
+        gettimeofday(&start, NULL);
+        for (i = 0; i < ITERATIONS; i++) {
+            if (write(pipefd[1], "x", 1) != 1)
+                break;
+            select_pass(&readfds, &writefds, &exceptfds);
+        }
+        usec = perf_elapsed_us(&start);
+        OKF(wakeups == ITERATIONS,
+            ("select: %d sessions, %d/%d wakeups dispatched", opened,
+             wakeups, ITERATIONS));
+        printf("# select: %5d idle sessions: %8.2f us per wakeup\n",
+               opened, usec / ITERATIONS);
+
+#ifdef NETSNMP_USE_EPOLL
+        wakeups = 0;
+        gettimeofday(&start, NULL);
+        for (i = 0; i < ITERATIONS; i++) {
+            if (write(pipefd[1], "x", 1) != 1)
+                break;
+            epoll_pass();
+        }
+        usec = perf_elapsed_us(&start);
+        OKF(wakeups == ITERATIONS,
+            ("epoll: %d sessions, %d/%d wakeups dispatched", opened,
+             wakeups, ITERATIONS));
+        printf("# epoll:  %5d idle sessions: %8.2f us per wakeup\n",
+               opened, usec / ITERATIONS);
+#endif
+    }
+#ifndef NETSNMP_USE_EPOLL
+    printf("# epoll backend not configured (--enable-epoll)\n");
+#endif
+
+    unregister_readfd(pipefd[0]);
+    close(pipefd[0]);
+    close(pipefd[1]);
+    netsnmp_large_fd_set_cleanup(&readfds);
+    netsnmp_large_fd_set_cleanup(&writefds);
+    netsnmp_large_fd_set_cleanup(&exceptfds);
+    snmp_shutdown("event-loop-perf");
+
+    PLAN(__test_counter);
+    return 0;
+}
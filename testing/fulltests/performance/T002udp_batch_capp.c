@@ -0,0 +1,249 @@
+/*
+ * HEADER UDP server throughput with and without recvmmsg/sendmmsg batching
+ *
+ * A raw UDP client sends bursts of SNMPv2c GET requests to a server
+ * session that answers each of them from its callback.  The same load
+ * is run with serverBatchSize 1 (one recvmsg/sendmsg per datagram) and
+ * with the default batch size.  A callback that closes the session in
+ * the middle of a batch must end it.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/large_fd_set.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "perftest.h"
+
+#define REQUESTS 20000
+#define BURST    64
+
+/* SNMPv2c GET sysUpTime.0, community "public"; request-id at offset 17 */
+static u_char get_request[] = {
+    0x30, 0x29, 0x02, 0x01, 0x01, 0x04, 0x06, 'p', 'u', 'b', 'l', 'i', 'c',
+    0xa0, 0x1c, 0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x02, 0x01, 0x00,
+    0x02, 0x01, 0x00, 0x30, 0x0e, 0x30, 0x0c, 0x06, 0x08, 0x2b, 0x06,
+    0x01, 0x02, 0x01, 0x01, 0x03, 0x00, 0x05, 0x00
+};
+
+static int answered;
+
+static int
+respond(int op, netsnmp_session *session, int reqid, netsnmp_pdu *pdu,
+        void *magic)
+{
+    netsnmp_pdu *reply;
+
+    if (op != NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE ||
+        pdu->command != SNMP_MSG_GET)
+        return 1;
+    reply = snmp_clone_pdu(pdu);
+    if (reply == NULL)
+        return 1;
+    reply->command = SNMP_MSG_RESPONSE;
+    if (snmp_send(session, reply) == 0)
+        snmp_free_pdu(reply);
+    else
+        answered++;
+    return 1;
+}
+
+static int
+close_session(int op, netsnmp_session *session, int reqid, netsnmp_pdu *pdu,
+              void *magic)
+{
+    if (op == NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE) {
+        answered++;
+        snmp_close(session);
+    }
+    return 1;
+}
+
+static void
+serve(netsnmp_large_fd_set *readfds)
+{
+    struct timeval tv = { 1, 0 };
+    int            numfds = 0, block = 0;
+
+    NETSNMP_LARGE_FD_ZERO(readfds);
+    snmp_select_info2(&numfds, readfds, &tv, &block);
+    if (netsnmp_large_fd_set_select(numfds, readfds, NULL, NULL, &tv) > 0)
+        snmp_read2(readfds);
+}
+
+static double
+run(int batch_size, int *received)
+{
+    netsnmp_large_fd_set readfds;
+    netsnmp_transport   *t;
+    netsnmp_session      session, *ss;
+    struct sockaddr_in   addr;
+    socklen_t            addrlen = sizeof(addr);
+    struct timeval       start;
+    double               usec;
+    u_char               buf[1500];
+    int                  client, sent = 0, got = 0, i, idle = 0;
+
+    *received = 0;
+    netsnmp_ds_set_int(NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_SERVERBATCHSIZE,
+                       batch_size);
+    t = netsnmp_transport_open_server("udp-batch-perf", "udp:127.0.0.1:0");
+    if (t == NULL)
+        return -1;
+    if (getsockname(t->sock, (struct sockaddr *) &addr, &addrlen) != 0) {
+        netsnmp_transport_free(t);
+        return -1;
+    }
+
+    snmp_sess_init(&session);
+    session.version = SNMP_VERSION_2c;
+    session.callback = respond;
+    ss = snmp_add(&session, t, NULL, NULL);
+    if (ss == NULL)
+        return -1;
+
+    client = socket(AF_INET, SOCK_DGRAM, 0);
+    fcntl(client, F_SETFL, O_NONBLOCK);
+    connect(client, (struct sockaddr *) &addr, addrlen);
+
+    netsnmp_large_fd_set_init(&readfds, FD_SETSIZE);
+    answered = 0;
+    gettimeofday(&start, NULL);
+    while (got < REQUESTS && idle < 3) {
+        for (i = 0; i < BURST && sent < REQUESTS; i++, sent++) {
+            get_request[17] = (sent >> 24) & 0xff;
+            get_request[18] = (sent >> 16) & 0xff;
+            get_request[19] = (sent >> 8) & 0xff;
+            get_request[20] = sent & 0xff;
+            if (send(client, get_request, sizeof(get_request), 0) < 0)
+                break;
+        }
+        while (answered < sent && idle < 3) {
+            int before = answered;
+            serve(&readfds);
+            if (answered == before)
+                idle++;
+        }
+        while (recv(client, buf, sizeof(buf), 0) > 0)
+            got++;
+        if (answered < sent)
+            break;
+    }
+    usec = perf_elapsed_us(&start);
+    while (recv(client, buf, sizeof(buf), 0) > 0)
+        got++;
+
+    close(client);
+    snmp_close(ss);
+    netsnmp_large_fd_set_cleanup(&readfds);
+    *received = got;
+    return usec;
+}
+
+/*
+ * sends a burst to a session that closes itself on the first request;
+ * returns the number of requests it saw
+ */
+static int
+close_in_batch(void)
+{
+    netsnmp_large_fd_set readfds;
+    netsnmp_transport   *t;
+    netsnmp_session      session, *ss;
+    struct sockaddr_in   addr;
+    socklen_t            addrlen = sizeof(addr);
+    int                  client, i;
+
+    netsnmp_ds_set_int(NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_SERVERBATCHSIZE,
+                       0);
+    t = netsnmp_transport_open_server("udp-batch-perf", "udp:127.0.0.1:0");
+    if (t == NULL)
+        return -1;
+    if (getsockname(t->sock, (struct sockaddr *) &addr, &addrlen) != 0) {
+        netsnmp_transport_free(t);
+        return -1;
+    }
+
+    snmp_sess_init(&session);
+    session.version = SNMP_VERSION_2c;
+    session.callback = close_session;
+    ss = snmp_add(&session, t, NULL, NULL);
+    if (ss == NULL)
+        return -1;
+
+    client = socket(AF_INET, SOCK_DGRAM, 0);
+    connect(client, (struct sockaddr *) &addr, addrlen);
+    for (i = 0; i < BURST; i++)
+        send(client, get_request, sizeof(get_request), 0);
+
+    netsnmp_large_fd_set_init(&readfds, FD_SETSIZE);
+    answered = 0;
+    serve(&readfds);
+    if (snmp_sess_pointer(ss) != NULL) {
+        snmp_close(ss);
+        answered = -1;
+    }
+    close(client);
+    netsnmp_large_fd_set_cleanup(&readfds);
+    return answered;
+}
+
+int
+main(int argc, char *argv[])
+{
+    double usec;
+    int    received;
+    u_int  batches, pkts;
+
+    init_snmp("udp-batch-perf");
+
+    usec = run(1, &received);
+    OKF(received == REQUESTS,
+        ("unbatched: %d/%d responses received", received, REQUESTS));
+    printf("# serverBatchSize 1:  %8.0f requests/s\n",
+           REQUESTS * 1e6 / usec);
+    OKF(snmp_get_statistic(STAT_UDP_RECVBATCHES) == 0,
+        ("unbatched: no recvmmsg batches counted"));
+
+    usec = run(0, &received);
+    OKF(received == REQUESTS,
+        ("batched: %d/%d responses received", received, REQUESTS));
+    printf("# serverBatchSize 16: %8.0f requests/s\n",
+           REQUESTS * 1e6 / usec);
+
+    batches = snmp_get_statistic(STAT_UDP_RECVBATCHES);
+    pkts = snmp_get_statistic(STAT_UDP_RECVBATCHPKTS);
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG) && defined(HAVE_IP_PKTINFO)
+    OKF(batches > 0 && pkts == REQUESTS,
+        ("batched: %u datagrams received in %u recvmmsg calls", pkts,
+         batches));
+    OKF(snmp_get_statistic(STAT_UDP_SENDBATCHPKTS) == REQUESTS,
+        ("batched: %u responses sent in %u sendmmsg calls",
+         snmp_get_statistic(STAT_UDP_SENDBATCHPKTS),
+         snmp_get_statistic(STAT_UDP_SENDBATCHES)));
+    printf("# average receive batch %.1f, %u full batches\n",
+           batches ? (double) pkts / batches : 0.0,
+           snmp_get_statistic(STAT_UDP_RECVBATCHFULL));
+#else
+    printf("# recvmmsg/sendmmsg not available\n");
+#endif
+
+    received = close_in_batch();
+    OKF(received == 1,
+        ("session closed by its callback after %d of %d requests",
+         received, BURST));
+
+    snmp_shutdown("udp-batch-perf");
+
+    PLAN(__test_counter);
+    return 0;
+}
@@ -0,0 +1,245 @@
+/*
+ * HEADER Agent throughput with slow handlers vs. agentWorkerThreads
+ *
+ * Registers a few scalars whose handlers are marked thread-safe and
+ * either sleep (waiting on a slow data source) or burn CPU, and keeps a
+ * window of SNMPv2c GET requests for them outstanding against an
+ * in-process agent.  The same load is run without worker threads and
+ * with 1, 2, 4 and 8 of them; the sleeping handlers scale with the
+ * number of workers, the CPU-bound ones with the number of cores.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/agent/agent_workers.h>
+#include <net-snmp/library/fd_event_manager.h>
+#include <net-snmp/library/large_fd_set.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "perftest.h"
+
+#define REGISTRATIONS 8
+#define REQUESTS      400
+#define WINDOW        32
+#define SLEEP_US      1000
+#define SPIN_US       200
+
+/* SNMPv2c GET experimental.999.<n>.0; request-id at 17, <n> at 39 */
+static u_char get_request[] = {
+    0x30, 0x29, 0x02, 0x01, 0x01, 0x04, 0x06, 'p', 'u', 'b', 'l', 'i', 'c',
+    0xa0, 0x1c, 0x02, 0x04, 0x00, 0x00, 0x00, 0x00, 0x02, 0x01, 0x00,
+    0x02, 0x01, 0x00, 0x30, 0x0e, 0x30, 0x0c, 0x06, 0x08, 0x2b, 0x06,
+    0x01, 0x03, 0x87, 0x67, 0x00, 0x00, 0x05, 0x00
+};
+
+static const int workers[] = { 0, 1, 2, 4, 8 };
+static int       spin;
+
+static int
+slow_handler(netsnmp_mib_handler *handler,
+             netsnmp_handler_registration *reginfo,
+             netsnmp_agent_request_info *reqinfo,
+             netsnmp_request_info *requests)
+{
+    struct timeval start;
+    long           value = reginfo->rootoid[reginfo->rootoid_len - 2];
+
+    if (reqinfo->mode != MODE_GET)
+        return SNMP_ERR_NOERROR;
+    if (spin) {
+        gettimeofday(&start, NULL);
+        while (perf_elapsed_us(&start) < SPIN_US)
+            ;
+    } else
+        usleep(SLEEP_US);
+    for (; requests; requests = requests->next)
+        snmp_set_var_typed_value(requests->requestvb, ASN_INTEGER,
+                                 &value, sizeof(value));
+    return SNMP_ERR_NOERROR;
+}
+
+static void
+serve(netsnmp_large_fd_set *readfds, netsnmp_large_fd_set *writefds,
+      netsnmp_large_fd_set *exceptfds)
+{
+    struct timeval tv = { 1, 0 };
+    int            numfds = 0, block = 0, count;
+
+    NETSNMP_LARGE_FD_ZERO(readfds);
+    NETSNMP_LARGE_FD_ZERO(writefds);
+    NETSNMP_LARGE_FD_ZERO(exceptfds);
+    snmp_select_info2(&numfds, readfds, &tv, &block);
+    netsnmp_external_event_info2(&numfds, readfds, writefds, exceptfds);
+    count = netsnmp_large_fd_set_select(numfds, readfds, writefds, exceptfds,
+                                        &tv);
+    if (count > 0) {
+        netsnmp_dispatch_external_events2(&count, readfds, writefds,
+                                          exceptfds);
+        snmp_read2(readfds);
+    }
+    netsnmp_check_outstanding_agent_requests();
+}
+
+/*
+ * GETNEXT experimental.999.2.0 must go on to the next thread-safe
+ * scalar, experimental.999.3.0 = 3.
+ */
+static int
+getnext(int client)
+{
+    netsnmp_large_fd_set readfds, writefds, exceptfds;
+    u_char               buf[1500];
+    int                  i, len = -1;
+
+    netsnmp_large_fd_set_init(&readfds, FD_SETSIZE);
+    netsnmp_large_fd_set_init(&writefds, FD_SETSIZE);
+    netsnmp_large_fd_set_init(&exceptfds, FD_SETSIZE);
+    get_request[13] = SNMP_MSG_GETNEXT;
+    get_request[39] = 2;
+    if (send(client, get_request, sizeof(get_request), 0) > 0)
+        for (i = 0; i < 5 && len <= 0; i++) {
+            serve(&readfds, &writefds, &exceptfds);
+            len = recv(client, buf, sizeof(buf), 0);
+        }
+    get_request[13] = SNMP_MSG_GET;
+    netsnmp_large_fd_set_cleanup(&readfds);
+    netsnmp_large_fd_set_cleanup(&writefds);
+    netsnmp_large_fd_set_cleanup(&exceptfds);
+    return len > 5 && buf[len - 5] == 3 && buf[len - 1] == 3;
+}
+
+/*
+ * Returns the time taken to get REQUESTS answers, or -1; *good counts
+ * the answers that carry the value of the scalar that was asked for.
+ */
+static double
+run(int client, int *good)
+{
+    netsnmp_large_fd_set readfds, writefds, exceptfds;
+    struct timeval       start;
+    u_char               buf[1500];
+    int                  sent = 0, got = 0, idle = 0, len, before;
+
+    *good = 0;
+    netsnmp_large_fd_set_init(&readfds, FD_SETSIZE);
+    netsnmp_large_fd_set_init(&writefds, FD_SETSIZE);
+    netsnmp_large_fd_set_init(&exceptfds, FD_SETSIZE);
+    gettimeofday(&start, NULL);
+    while (got < REQUESTS && idle < 3) {
+        for (; sent < REQUESTS && sent - got < WINDOW; sent++) {
+            get_request[20] = sent & 0xff;
+            get_request[19] = (sent >> 8) & 0xff;
+            get_request[39] = sent % REGISTRATIONS;
+            if (send(client, get_request, sizeof(get_request), 0) < 0)
+                break;
+        }
+        before = got;
+        serve(&readfds, &writefds, &exceptfds);
+        while ((len = recv(client, buf, sizeof(buf), 0)) > 0) {
+            got++;
+            /* the only varbind ends in ... <n> 0x00 0x02 0x01 <n> */
+            if (len > 5 && buf[len - 3] == ASN_INTEGER && buf[len - 2] == 1 &&
+                buf[len - 1] == buf[len - 5])
+                (*good)++;
+        }
+        idle = (got == before) ? idle + 1 : 0;
+    }
+    netsnmp_large_fd_set_cleanup(&readfds);
+    netsnmp_large_fd_set_cleanup(&writefds);
+    netsnmp_large_fd_set_cleanup(&exceptfds);
+    return got == REQUESTS ? perf_elapsed_us(&start) : -1;
+}
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_handler_registration *reginfo;
+    netsnmp_transport   *t;
+    struct sockaddr_in   addr;
+    socklen_t            addrlen = sizeof(addr);
+    oid                  name[] = { 1, 3, 6, 1, 3, 999, 0, 0 };
+    char                 label[32];
+    double               usec, base = 0;
+    int                  client, good, i, n, threads;
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_ROLE,
+                           0);
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_agent("agent-workers-perf");
+    netsnmp_config(NETSNMP_REMOVE_CONST(char *,
+                                        "rocommunity public 127.0.0.1"));
+    init_snmp("agent-workers-perf");
+
+    for (i = 0; i < REGISTRATIONS; i++) {
+        name[6] = i;
+        snprintf(label, sizeof(label), "slow%d", i);
+        reginfo = netsnmp_create_handler_registration(label, slow_handler,
+                          name, OID_LENGTH(name),
+                          HANDLER_CAN_RONLY | HANDLER_CAN_THREADSAFE);
+        if (reginfo == NULL ||
+            netsnmp_register_instance(reginfo) != MIB_REGISTERED_OK)
+            break;
+    }
+    OK(i == REGISTRATIONS, "thread-safe scalars registered");
+
+    t = netsnmp_transport_open_server("agent-workers-perf",
+                                      "udp:127.0.0.1:0");
+    OK(t != NULL && getsockname(t->sock, (struct sockaddr *) &addr,
+                                &addrlen) == 0 &&
+       netsnmp_register_agent_nsap(t) >= 0, "agent listening");
+    client = socket(AF_INET, SOCK_DGRAM, 0);
+    fcntl(client, F_SETFL, O_NONBLOCK);
+    connect(client, (struct sockaddr *) &addr, addrlen);
+
+    printf("# %ld online CPUs, %d requests, %d outstanding\n",
+           sysconf(_SC_NPROCESSORS_ONLN), REQUESTS, WINDOW);
+    for (spin = 0; spin < 2; spin++) {
+        for (n = 0; n < sizeof(workers) / sizeof(workers[0]); n++) {
+            netsnmp_ds_set_int(NETSNMP_DS_APPLICATION_ID,
+                               NETSNMP_DS_AGENT_WORKER_THREADS, workers[n]);
+            usec = run(client, &good);
+            threads = netsnmp_agent_workers_running();
+#ifdef NETSNMP_REENTRANT
+            OKF(threads == workers[n],
+                ("%d worker threads running", workers[n]));
+#endif
+            if (!spin)
+                OKF(getnext(client), ("GETNEXT with %d workers", threads));
+            shutdown_agent_workers();
+            OKF(usec > 0 && good == REQUESTS,
+                ("%s handlers, %d workers: %d/%d correct answers",
+                 spin ? "spinning" : "sleeping", threads, good, REQUESTS));
+            if (usec <= 0)
+                continue;
+            if (threads == 0)
+                base = usec;
+            printf("# %s %4dus handlers, %d workers: %7.0f requests/s "
+                   "(x%.2f)\n", spin ? "spinning" : "sleeping",
+                   spin ? SPIN_US : SLEEP_US, threads,
+                   REQUESTS * 1e6 / usec, base / usec);
+#ifndef NETSNMP_REENTRANT
+            break;
+#endif
+        }
+    }
+#ifndef NETSNMP_REENTRANT
+    printf("# worker threads not available (--enable-reentrant)\n");
+#endif
+
+    close(client);
+    snmp_shutdown("agent-workers-perf");
+    shutdown_agent();
+
+    PLAN(__test_counter);
+    return 0;
+}
@@ -0,0 +1,219 @@
+/*
+ * HEADER Registry lookup cost vs. number of registrations
+ *
+ * Registers an increasing number of scalars, plus a subtree above every
+ * tenth group of them so that registrations get split, and times
+ * netsnmp_subtree_find() for OIDs in and around the registered ones.
+ * The answers are compared with a walk of the list of registrations,
+ * which is how lookups used to be done, and whose cost is shown for
+ * comparison.  Half of the scalars are then unregistered and the
+ * lookups checked again.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "perftest.h"
+
+#define MAX_REGISTRATIONS 10000
+#define GROUP             100
+#define LOOKUPS           20000
+#define LIST_LOOKUPS      1000  /* the list walk is too slow for more */
+
+static const int nregistrations[] = { 100, 1000, MAX_REGISTRATIONS };
+static netsnmp_handler_registration *scalars[MAX_REGISTRATIONS];
+static oid       lookups[LOOKUPS][10];
+static size_t    lookup_len[LOOKUPS];
+static volatile int found;
+
+static int
+null_handler(netsnmp_mib_handler *handler,
+             netsnmp_handler_registration *reginfo,
+             netsnmp_agent_request_info *reqinfo,
+             netsnmp_request_info *requests)
+{
+    return SNMP_ERR_NOERROR;
+}
+
+static int
+register_oid(const char *label, const oid *name, size_t len,
+             netsnmp_handler_registration **reginfop)
+{
+    netsnmp_handler_registration *reginfo;
+
+    reginfo = netsnmp_create_handler_registration(label, null_handler,
+                                                  name, len,
+                                                  HANDLER_CAN_RONLY);
+    if (reginfop)
+        *reginfop = reginfo;
+    return reginfo ? netsnmp_register_handler(reginfo) : MIB_REGISTRATION_FAILED;
+}
+
+/* netsnmp_subtree_find_prev() the way it used to be: a walk of the list */
+static netsnmp_subtree *
+list_find_prev(const oid *name, size_t len)
+{
+    netsnmp_subtree *sub, *prev = NULL;
+
+    for (sub = netsnmp_subtree_find_first(""); sub; sub = sub->next) {
+        if (snmp_oid_compare(name, len, sub->start_a, sub->start_len) < 0)
+            break;
+        prev = sub;
+    }
+    return prev;
+}
+
+static netsnmp_subtree *
+list_find(const oid *name, size_t len)
+{
+    netsnmp_subtree *prev = list_find_prev(name, len);
+
+    if (prev && snmp_oid_compare(name, len, prev->end_a, prev->end_len) < 0)
+        return prev;
+    return NULL;
+}
+
+static netsnmp_subtree *
+list_find_next(const oid *name, size_t len)
+{
+    netsnmp_subtree *sub = list_find_prev(name, len);
+
+    if (sub == NULL)
+        return NULL;
+    for (sub = sub->next; sub && (sub->variables == NULL ||
+                                  sub->variables_len == 0); sub = sub->next)
+        ;
+    return sub;
+}
+
+/*
+ * experimental.999.<group>.<n>.0, its parent, a child of it, or the OID
+ * after it; each tenth group also has experimental.999.<group> itself
+ * registered.
+ */
+static void
+make_lookups(int n)
+{
+    int i, r;
+
+    for (i = 0; i < LOOKUPS; i++) {
+        r = random() % (n + n / 10 + 1);
+        lookups[i][0] = 1;
+        lookups[i][1] = 3;
+        lookups[i][2] = 6;
+        lookups[i][3] = 1;
+        lookups[i][4] = 3;
+        lookups[i][5] = 999;
+        lookups[i][6] = r / GROUP;
+        lookups[i][7] = r % GROUP;
+        lookups[i][8] = 0;
+        lookups[i][9] = random() % 3;
+        lookup_len[i] = 7 + random() % 4;
+        if (random() % 4 == 0)
+            lookups[i][lookup_len[i] - 1]++;
+    }
+}
+
+/*
+ * Returns the time per lookup; *errors counts the first LIST_LOOKUPS
+ * lookups (and GETNEXT lookups) whose answer differs from a list walk.
+ */
+static double
+run(int use_list, int *errors)
+{
+    struct timeval start;
+    netsnmp_subtree *sub;
+    double      usec;
+    int         i, count = use_list ? LIST_LOOKUPS : LOOKUPS;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < count; i++) {
+        sub = use_list ? list_find(lookups[i], lookup_len[i]) :
+            netsnmp_subtree_find(lookups[i], lookup_len[i], NULL, "");
+        found += (sub != NULL);
+    }
+    usec = perf_elapsed_us(&start);
+
+    *errors = 0;
+    if (!use_list)
+        for (i = 0; i < LIST_LOOKUPS; i++)
+            if (netsnmp_subtree_find(lookups[i], lookup_len[i], NULL, "") !=
+                list_find(lookups[i], lookup_len[i]) ||
+                netsnmp_subtree_find_next(lookups[i], lookup_len[i], NULL,
+                                          "") !=
+                list_find_next(lookups[i], lookup_len[i]))
+                (*errors)++;
+    return usec / count;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct timeval start;
+    oid         name[] = { 1, 3, 6, 1, 3, 999, 0, 0, 0 };
+    char        label[32];
+    double      usec, list_usec;
+    int         registered = 0, failed = 0, errors, i, n;
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_ROLE,
+                           0);
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_agent("registry-lookup-perf");
+    netsnmp_config(NETSNMP_REMOVE_CONST(char *,
+                                        "rocommunity public 127.0.0.1"));
+    init_snmp("registry-lookup-perf");
+    srandom(1);
+
+    for (n = 0; n < sizeof(nregistrations) / sizeof(nregistrations[0]); n++) {
+        gettimeofday(&start, NULL);
+        for (; registered < nregistrations[n]; registered++) {
+            name[6] = registered / GROUP;
+            name[7] = registered % GROUP;
+            snprintf(label, sizeof(label), "scalar%d", registered);
+            if (register_oid(label, name, OID_LENGTH(name),
+                             &scalars[registered]) != MIB_REGISTERED_OK)
+                failed++;
+            if (registered % (10 * GROUP) == GROUP / 2) {
+                snprintf(label, sizeof(label), "group%d", registered / GROUP);
+                if (register_oid(label, name, 7, NULL) != MIB_REGISTERED_OK)
+                    failed++;
+            }
+        }
+        usec = perf_elapsed_us(&start);
+        OKF(failed == 0, ("%d scalars registered", registered));
+        printf("# %5d registrations: %8.2f us per registration\n",
+               registered, usec / registered);
+
+        make_lookups(registered);
+        usec = run(0, &errors);
+        OKF(errors == 0, ("%d registrations: %d/%d lookups differ from a "
+                          "list walk", registered, errors, LIST_LOOKUPS));
+        list_usec = run(1, &errors);
+        printf("# %5d registrations: %8.3f us per lookup, list walk "
+               "%8.3f us (x%.1f)\n", registered, usec, list_usec,
+               list_usec / usec);
+    }
+
+    for (i = 0; i < registered; i += 2)
+        if (netsnmp_unregister_handler(scalars[i]) != MIB_UNREGISTERED_OK)
+            failed++;
+    OKF(failed == 0, ("%d scalars unregistered", registered / 2));
+    make_lookups(registered);
+    run(0, &errors);
+    OKF(errors == 0, ("after unregistering: %d/%d lookups differ from a "
+                      "list walk", errors, LIST_LOOKUPS));
+
+    snmp_shutdown("registry-lookup-perf");
+    shutdown_agent();
+
+    PLAN(__test_counter);
+    return 0;
+}
@@ -0,0 +1,265 @@
+/*
+ * HEADER USM user lookup and loading cost vs. number of users
+ *
+ * Adds an increasing number of USM users, spread over a few engineIDs
+ * and in random order, and times usm_add_user(), putting the list in
+ * order for usm_get_userList(), and usm_get_user() for existing and
+ * unknown users.  The lookups are checked against, and timed next to, a
+ * walk of the list; up to 10000 users the ordered insert into a list
+ * that usm_add_user() used to do is timed too.  Half of the users are
+ * then removed and the lookups checked again.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "perftest.h"
+
+#define MAX_USERS    100000
+#define ENGINES      4
+#define LOOKUPS      100000
+#define LIST_LOOKUPS 200        /* the list walk is too slow for more */
+#define LIST_INSERTS 10000      /* and so is the ordered insert */
+
+static const int nusers[] = { 1000, 10000, MAX_USERS };
+static int       order[MAX_USERS];
+static struct usmUser *users[MAX_USERS];
+static struct usmUser *scratch[LIST_INSERTS];
+static u_char    engineID[] = { 0x80, 0x00, 0x1f, 0x88, 0x80, 0x12, 0x34,
+                                0x56, 0x78, 0x9a, 0xbc, 0x00 };
+
+static void
+user_key(int i, u_char *eid, char *name, size_t len)
+{
+    memcpy(eid, engineID, sizeof(engineID));
+    eid[sizeof(engineID) - 1] = i % ENGINES;
+    snprintf(name, len, "tenant%d", i);
+}
+
+static struct usmUser *
+make_user(int i)
+{
+    struct usmUser *user = usm_create_user();
+    char            name[32];
+
+    if (user == NULL)
+        return NULL;
+    user->engineID = netsnmp_memdup(engineID, sizeof(engineID));
+    user->engineIDLen = sizeof(engineID);
+    user_key(i, user->engineID, name, sizeof(name));
+    user->name = strdup(name);
+    user->secName = strdup(name);
+    user->userStatus = RS_ACTIVE;
+    return user;
+}
+
+/* usm_get_user() the way it used to be: a walk of the list */
+static struct usmUser *
+list_get_user(const u_char *eid, const char *name)
+{
+    struct usmUser *ptr;
+
+    for (ptr = usm_get_userList(); ptr; ptr = ptr->next)
+        if (!strcmp(ptr->name, name) &&
+            ptr->engineIDLen == sizeof(engineID) &&
+            !memcmp(ptr->engineID, eid, sizeof(engineID)))
+            return ptr;
+    return NULL;
+}
+
+/* Returns 1 if the list is sorted as usm_add_user_to_list() sorts it */
+static int
+list_is_sorted(int *count)
+{
+    struct usmUser *ptr, *prev = NULL;
+    int             ok = 1;
+
+    *count = 0;
+    for (ptr = usm_get_userList(); ptr; prev = ptr, ptr = ptr->next) {
+        (*count)++;
+        if (ptr->prev != prev)
+            ok = 0;
+        if (prev && (memcmp(prev->engineID, ptr->engineID,
+                            sizeof(engineID)) > 0 ||
+                     (!memcmp(prev->engineID, ptr->engineID,
+                              sizeof(engineID)) &&
+                      (strlen(prev->name) > strlen(ptr->name) ||
+                       (strlen(prev->name) == strlen(ptr->name) &&
+                        strcmp(prev->name, ptr->name) >= 0)))))
+            ok = 0;
+    }
+    return ok;
+}
+
+static void
+shuffle(int from, int to)
+{
+    int i, j, tmp;
+
+    for (i = from; i < to; i++)
+        order[i] = i;
+    for (i = to - 1; i > from; i--) {
+        j = from + random() % (i - from + 1);
+        tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+}
+
+/*
+ * Looks up random users, a quarter of them unknown.  Returns the time
+ * per lookup; *errors counts the answers that are wrong, or that differ
+ * from a list walk for the first LIST_LOOKUPS of them.
+ */
+static double
+lookup(int n, int removed, int *errors)
+{
+    struct timeval  start;
+    struct usmUser *user;
+    u_char          eid[sizeof(engineID)];
+    char            name[32];
+    double          usec;
+    int             i, u;
+
+    *errors = 0;
+    srandom(n);
+    gettimeofday(&start, NULL);
+    for (i = 0; i < LOOKUPS; i++) {
+        u = random() % (n + n / 3);
+        user_key(u, eid, name, sizeof(name));
+        user = usm_get_user(eid, sizeof(eid), name);
+        if (user != ((u < n && !(removed && u % 2 == 0)) ? users[u] : NULL))
+            (*errors)++;
+    }
+    usec = perf_elapsed_us(&start);
+
+    for (i = 0; i < LIST_LOOKUPS; i++) {
+        u = random() % (n + n / 3);
+        user_key(u, eid, name, sizeof(name));
+        if (usm_get_user(eid, sizeof(eid), name) != list_get_user(eid, name))
+            (*errors)++;
+    }
+    return usec / LOOKUPS;
+}
+
+static double
+list_lookup(int n)
+{
+    struct timeval start;
+    u_char         eid[sizeof(engineID)];
+    char           name[32];
+    int            i;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < LIST_LOOKUPS; i++) {
+        user_key(random() % (n + n / 3), eid, name, sizeof(name));
+        list_get_user(eid, name);
+    }
+    return perf_elapsed_us(&start) / LIST_LOOKUPS;
+}
+
+/* The ordered insert usm_add_user() used to do, into a private list */
+static double
+list_insert(int n)
+{
+    struct timeval  start;
+    struct usmUser *list = NULL, *user, *next;
+    double          usec;
+    int             i;
+
+    shuffle(0, n);
+    for (i = 0; i < n; i++)
+        scratch[i] = make_user(order[i]);
+    gettimeofday(&start, NULL);
+    for (i = 0; i < n; i++)
+        list = usm_add_user_to_list(scratch[i], list);
+    usec = perf_elapsed_us(&start);
+    for (user = list; user; user = next) {
+        next = user->next;
+        user->next = user->prev = NULL;
+        usm_free_user(user);
+    }
+    return usec / n;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct timeval  start;
+    struct usmUser *user;
+    double          usec, sort_usec, list_usec;
+    int             added = 0, failed = 0, count, errors, i, n;
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_snmp("usm-users-perf");
+    srandom(1);
+
+    for (n = 0; n < sizeof(nusers) / sizeof(nusers[0]); n++) {
+        if (nusers[n] <= LIST_INSERTS)
+            list_usec = list_insert(nusers[n]);
+
+        shuffle(added, nusers[n]);
+        for (i = added; i < nusers[n]; i++)
+            users[order[i]] = make_user(order[i]);
+        gettimeofday(&start, NULL);
+        for (i = added; i < nusers[n]; i++)
+            if (users[order[i]] == NULL ||
+                usm_add_user(users[order[i]]) == NULL)
+                failed++;
+        usec = perf_elapsed_us(&start);
+        gettimeofday(&start, NULL);
+        usm_get_userList();
+        sort_usec = perf_elapsed_us(&start);
+        added = nusers[n];
+        OKF(failed == 0 && list_is_sorted(&count) && count == added,
+            ("%d users added, list in order", count));
+        printf("# %6d users: %6.2f us per usm_add_user(), %8.0f us to sort "
+               "the list\n", added, usec / (added - (n ? nusers[n - 1] : 0)),
+               sort_usec);
+        if (added <= LIST_INSERTS)
+            printf("# %6d users: %6.2f us per ordered list insert\n",
+                   added, list_usec);
+
+        usec = lookup(added, 0, &errors);
+        OKF(errors == 0, ("%d users: %d wrong lookups", added, errors));
+        list_usec = list_lookup(added);
+        printf("# %6d users: %6.3f us per lookup, list walk %8.3f us "
+               "(x%.0f)\n", added, usec, list_usec, list_usec / usec);
+    }
+
+    /* adding a user again replaces it */
+    user = make_user(0);
+    usm_add_user(user);
+    OK(list_is_sorted(&count) && count == added &&
+       usm_get_user(user->engineID, user->engineIDLen, user->name) == user,
+       "re-added user replaces the old entry");
+    users[0] = user;
+
+    for (i = 0; i < added; i += 2) {
+        usm_remove_user(users[i]);
+        users[i]->next = users[i]->prev = NULL;
+        usm_free_user(users[i]);
+    }
+    OKF(list_is_sorted(&count) && count == added / 2,
+        ("%d users left after removing every other one", count));
+    lookup(added, 1, &errors);
+    OKF(errors == 0, ("after removing: %d wrong lookups", errors));
+
+    /* freeing a user that is still in the middle of the list unlinks it */
+    user = users[added / 2 + 1];
+    usm_free_user(user);
+    OKF(list_is_sorted(&count) && count == added / 2 - 1,
+        ("%d users left after freeing one still in the list", count));
+
+    snmp_shutdown("usm-users-perf");
+
+    PLAN(__test_counter);
+    return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * HEADER Per-message SNMPv3 crypto cost with and without cached key state
+ *
+ * For each authentication protocol known to sc_get_auth_alg_byindex(),
+ * signs and checks a typical message with sc_generate_keyed_hash() and
+ * with sc_generate_keyed_hash_cached(), which keeps the HMAC context of
+ * the key between calls; and the same for each privacy protocol with
+ * sc_encrypt() and sc_decrypt().  The results must be the same, also
+ * after the key has changed under the cache.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/scapi.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "perftest.h"
+
+#define MSG_LEN    484          /* the smallest maximum message size */
+#define ITERATIONS 20000
+
+static u_char message[MSG_LEN];
+static u_char result[MSG_LEN + 64];
+
+static int
+mac(netsnmp_auth_alg_info *aai, netsnmp_sc_cache **cache,
+    const u_char *key, u_int keylen, u_char *buf, size_t *len)
+{
+    if (cache)
+        return sc_generate_keyed_hash_cached(cache, aai->alg_oid,
+                                             aai->oid_len, key, keylen,
+                                             message, sizeof(message),
+                                             buf, len);
+    return sc_generate_keyed_hash(aai->alg_oid, aai->oid_len, key, keylen,
+                                  message, sizeof(message), buf, len);
+}
+
+/*
+ * Returns the time per MAC; *bad counts the MACs that differ from the
+ * uncached one, or that sc_check_keyed_hash_cached() does not accept.
+ */
+static double
+time_auth(netsnmp_auth_alg_info *aai, netsnmp_sc_cache **cache,
+          const u_char *key, u_int keylen, int *bad)
+{
+    struct timeval start;
+    u_char         buf[64], ref[64];
+    size_t         len, reflen = sizeof(ref);
+    double         usec;
+    int            i;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < ITERATIONS; i++) {
+        message[0] = i;
+        len = sizeof(buf);
+        mac(aai, cache, key, keylen, buf, &len);
+    }
+    usec = perf_elapsed_us(&start);
+
+    message[0] = 0;
+    len = sizeof(buf);
+    if (mac(aai, NULL, key, keylen, ref, &reflen) != SNMPERR_SUCCESS ||
+        mac(aai, cache, key, keylen, buf, &len) != SNMPERR_SUCCESS ||
+        len != reflen || memcmp(buf, ref, reflen) != 0)
+        (*bad)++;
+    if (cache && sc_check_keyed_hash_cached(cache, aai->alg_oid,
+                                            aai->oid_len, key, keylen,
+                                            message, sizeof(message), ref,
+                                            aai->mac_length) !=
+        SNMPERR_SUCCESS)
+        (*bad)++;
+    return usec / ITERATIONS;
+}
+
+/*
+ * Returns the time to encrypt and decrypt one message; *bad counts the
+ * results that differ from the uncached ones.
+ */
+static double
+time_priv(netsnmp_priv_alg_info *pai, netsnmp_sc_cache **cache,
+          u_char *key, u_int keylen, int *bad)
+{
+    struct timeval start;
+    u_char         iv[16], ref[sizeof(result)], plain[sizeof(result)];
+    size_t         len = 0, reflen = sizeof(ref), plainlen;
+    int            i;
+
+    memset(iv, 0x5a, sizeof(iv));
+    sc_encrypt(pai->alg_oid, pai->oid_len, key, keylen, iv, pai->iv_length,
+               message, sizeof(message), ref, &reflen);
+    gettimeofday(&start, NULL);
+    for (i = 0; i < ITERATIONS; i++) {
+        len = sizeof(result);
+        plainlen = sizeof(plain);
+        if (cache) {
+            sc_encrypt_cached(cache, pai->alg_oid, pai->oid_len, key, keylen,
+                              iv, pai->iv_length, message, sizeof(message),
+                              result, &len);
+            sc_decrypt_cached(cache, pai->alg_oid, pai->oid_len, key, keylen,
+                              iv, pai->iv_length, result, len, plain,
+                              &plainlen);
+        } else {
+            sc_encrypt(pai->alg_oid, pai->oid_len, key, keylen, iv,
+                       pai->iv_length, message, sizeof(message), result,
+                       &len);
+            sc_decrypt(pai->alg_oid, pai->oid_len, key, keylen, iv,
+                       pai->iv_length, result, len, plain, &plainlen);
+        }
+    }
+    if (len != reflen || memcmp(result, ref, reflen) ||
+        memcmp(plain, message, sizeof(message)))
+        (*bad)++;
+    return perf_elapsed_us(&start) / ITERATIONS;
+}
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_auth_alg_info *aai;
+    netsnmp_priv_alg_info *pai;
+    netsnmp_sc_cache *cache = NULL;
+    u_char          key[64];
+    double          usec, cached_usec;
+    int             bad, i;
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_snmp("crypto-cache-perf");
+    for (i = 0; i < sizeof(message); i++)
+        message[i] = i * 7;
+    for (i = 0; i < sizeof(key); i++)
+        key[i] = i * 13 + 1;
+
+    for (i = 0; (aai = sc_get_auth_alg_byindex(i)) != NULL; i++) {
+        if (aai->type == NETSNMP_USMAUTH_NOAUTH)
+            continue;
+        bad = 0;
+        usec = time_auth(aai, NULL, key, aai->proper_length, &bad);
+        cached_usec = time_auth(aai, &cache, key, aai->proper_length, &bad);
+        /* the cache follows a change of the key */
+        key[0]++;
+        time_auth(aai, &cache, key, aai->proper_length, &bad);
+        OKF(bad == 0, ("%s: cached MACs match", aai->name));
+        printf("# %-30s %6.2f us per %d byte message, cached %6.2f us "
+               "(x%.2f)\n", aai->name, usec, MSG_LEN, cached_usec,
+               usec / cached_usec);
+    }
+
+    for (i = 0; (pai = sc_get_priv_alg_byindex(i)) != NULL; i++) {
+        if (pai->type == USM_CREATE_USER_PRIV_NONE)
+            continue;
+        bad = 0;
+        usec = time_priv(pai, NULL, key, pai->proper_length, &bad);
+        cached_usec = time_priv(pai, &cache, key, pai->proper_length, &bad);
+        key[0]++;
+        time_priv(pai, &cache, key, pai->proper_length, &bad);
+        OKF(bad == 0, ("%s: cached encryption matches", pai->name));
+        printf("# %-30s %6.2f us per %d byte message, cached %6.2f us "
+               "(x%.2f)\n", pai->name, usec, MSG_LEN, cached_usec,
+               usec / cached_usec);
+    }
+
+    sc_free_cache(cache);
+    snmp_shutdown("crypto-cache-perf");
+
+    PLAN(__test_counter);
+    return 0;
+}
@@ -0,0 +1,183 @@
+/*
+ * HEADER PDU encoding cost with and without sizedEncodeBER
+ *
+ * Encodes SNMPv2c responses carrying 1, 50 and 1000 ifXTable-like
+ * varbinds (as a GETBULK over ifXTable returns them), and GET requests
+ * for as many OIDs, with snmp_build() starting from a buffer of
+ * SNMP_MIN_MAX_LEN bytes the way snmp_send() does.  This is timed with
+ * the buffer grown by the encoders as they go and with the message
+ * sized up front; both must give the same packet, and the sized buffer
+ * must be no bigger than the packet.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "perftest.h"
+
+#define VARBINDS_PER_RUN 200000
+
+static const int nvarbinds[] = { 1, 50, 1000 };
+static oid       ifXEntry[] = { 1, 3, 6, 1, 2, 1, 31, 1, 1, 1, 0, 0 };
+
+/* Varbind i: a column of ifXTable for interface i / 8 + 1 */
+static void
+add_varbind(netsnmp_pdu *pdu, int i, int response)
+{
+    struct counter64 c64;
+    char             name[32];
+    long             l;
+
+    ifXEntry[10] = 1 + i % 8;
+    ifXEntry[11] = 1 + i / 8;
+    if (!response) {
+        snmp_add_null_var(pdu, ifXEntry, OID_LENGTH(ifXEntry));
+        return;
+    }
+    switch (i % 8) {
+    case 0:
+        snprintf(name, sizeof(name), "eth%d", i / 8);
+        snmp_pdu_add_variable(pdu, ifXEntry, OID_LENGTH(ifXEntry),
+                              ASN_OCTET_STR, name, strlen(name));
+        break;
+    case 1:
+    case 2:
+        l = 1000 * i;
+        snmp_pdu_add_variable(pdu, ifXEntry, OID_LENGTH(ifXEntry),
+                              ASN_COUNTER, &l, sizeof(l));
+        break;
+    case 3:
+    case 4:
+        c64.high = i;
+        c64.low = 0x89abcdef;
+        snmp_pdu_add_variable(pdu, ifXEntry, OID_LENGTH(ifXEntry),
+                              ASN_COUNTER64, &c64, sizeof(c64));
+        break;
+    case 5:
+        l = 10000;
+        snmp_pdu_add_variable(pdu, ifXEntry, OID_LENGTH(ifXEntry),
+                              ASN_GAUGE, &l, sizeof(l));
+        break;
+    case 6:
+        l = i % 2 + 1;
+        snmp_pdu_add_variable(pdu, ifXEntry, OID_LENGTH(ifXEntry),
+                              ASN_INTEGER, &l, sizeof(l));
+        break;
+    default:
+        snprintf(name, sizeof(name), "uplink to rack %d, port %d",
+                 i / 64, i % 64);
+        snmp_pdu_add_variable(pdu, ifXEntry, OID_LENGTH(ifXEntry),
+                              ASN_OCTET_STR, name, strlen(name));
+        break;
+    }
+}
+
+/*
+ * Builds pdu into a fresh buffer; returns the packet, which the caller
+ * must free, and in *len its length and in *buf_len the buffer size.
+ */
+static u_char *
+build(netsnmp_session *session, netsnmp_pdu *pdu, size_t *len,
+      size_t *buf_len)
+{
+    u_char *pkt;
+    size_t  offset = 0;
+
+    *buf_len = SNMP_MIN_MAX_LEN;
+    pkt = (u_char *) malloc(*buf_len);
+    if (pkt == NULL ||
+        snmp_build(&pkt, buf_len, &offset, session, pdu) != 0) {
+        free(pkt);
+        return NULL;
+    }
+    *len = offset;
+    return pkt;
+}
+
+/* Returns the time per PDU */
+static double
+run(netsnmp_session *session, netsnmp_pdu *pdu, int sized, int iterations)
+{
+    struct timeval start;
+    size_t         len, buf_len;
+    int            i;
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_SIZED_ENCODE, sized);
+    gettimeofday(&start, NULL);
+    for (i = 0; i < iterations; i++)
+        free(build(session, pdu, &len, &buf_len));
+    return perf_elapsed_us(&start) / iterations;
+}
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_session session;
+    netsnmp_pdu    *pdu;
+    u_char         *pkt, *sized_pkt;
+    size_t          len, sized_len, buf_len, sized_buf_len;
+    double          usec, sized_usec;
+    int             i, n, response;
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_snmp("pdu-encode-perf");
+    snmp_sess_init(&session);
+    session.version = SNMP_VERSION_2c;
+    session.community = (u_char *) strdup("public");
+    session.community_len = strlen("public");
+
+    for (response = 1; response >= 0; response--) {
+        for (n = 0; n < sizeof(nvarbinds) / sizeof(nvarbinds[0]); n++) {
+            pdu = snmp_pdu_create(response ? SNMP_MSG_RESPONSE :
+                                  SNMP_MSG_GET);
+            pdu->version = session.version;
+            pdu->reqid = 0x12345678;
+            for (i = 0; i < nvarbinds[n]; i++)
+                add_varbind(pdu, i, response);
+
+            netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                                   NETSNMP_DS_LIB_SIZED_ENCODE, 0);
+            pkt = build(&session, pdu, &len, &buf_len);
+            netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                                   NETSNMP_DS_LIB_SIZED_ENCODE, 1);
+            sized_pkt = build(&session, pdu, &sized_len, &sized_buf_len);
+            OKF(pkt && sized_pkt && len == sized_len &&
+                memcmp(pkt + buf_len - len,
+                       sized_pkt + sized_buf_len - sized_len, len) == 0,
+                ("%s, %d varbinds: sized encoding gives the same %d "
+                 "bytes", response ? "response" : "GET", nvarbinds[n],
+                 (int) len));
+            OKF(sized_pkt && (sized_buf_len == sized_len ||
+                              (sized_buf_len == SNMP_MIN_MAX_LEN &&
+                               sized_len <= SNMP_MIN_MAX_LEN)),
+                ("%s, %d varbinds: %d byte buffer for %d bytes",
+                 response ? "response" : "GET", nvarbinds[n],
+                 (int) sized_buf_len, (int) sized_len));
+            free(pkt);
+            free(sized_pkt);
+
+            usec = run(&session, pdu, 0, VARBINDS_PER_RUN / nvarbinds[n]);
+            sized_usec = run(&session, pdu, 1,
+                             VARBINDS_PER_RUN / nvarbinds[n]);
+            printf("# %-8s %4d varbinds, %6d bytes: %9.2f us per PDU, "
+                   "sized %9.2f us (x%.2f)\n", response ? "response" : "GET",
+                   nvarbinds[n], (int) len, usec, sized_usec,
+                   usec / sized_usec);
+            snmp_free_pdu(pdu);
+        }
+    }
+
+    free(session.community);
+    snmp_shutdown("pdu-encode-perf");
+
+    PLAN(__test_counter);
+    return 0;
+}
@@ -0,0 +1,204 @@
+/*
+ * HEADER PDU and varbind allocation cost with and without pduPoolSize
+ *
+ * Does what a busy agent or trap receiver does for each message: parses
+ * a received SNMPv2c request with 1, 10 or 50 varbinds into a new PDU,
+ * clones it into a response and frees both.  This is timed with the
+ * pool disabled and with it enabled; the parsed PDUs must be the same,
+ * the pool must hand out freed structures again and it must never hold
+ * more than pduPoolSize of each.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "perftest.h"
+
+#define VARBINDS_PER_RUN 500000
+#define POOL_SIZE        128
+
+static const int nvarbinds[] = { 1, 10, 50 };
+static oid       ifEntry[] = { 1, 3, 6, 1, 2, 1, 2, 2, 1, 0, 0 };
+
+/*
+ * Returns a GET request for n ifTable columns, which the caller must
+ * free, with the PDU part (after the community) at *pdu_data.
+ */
+static u_char *
+build(netsnmp_session *session, int n, u_char **pdu_data, size_t *pdu_len)
+{
+    netsnmp_pdu *pdu;
+    u_char      *pkt, *data;
+    size_t       buf_len = SNMP_MIN_MAX_LEN, offset = 0, len;
+    long         version;
+    u_char       community[64];
+    size_t       community_len = sizeof(community);
+    int          i;
+
+    pdu = snmp_pdu_create(SNMP_MSG_GET);
+    pdu->version = session->version;
+    pdu->reqid = 0x12345678;
+    for (i = 0; i < n; i++) {
+        ifEntry[9] = 2 + i % 20;
+        ifEntry[10] = 1 + i / 20;
+        snmp_add_null_var(pdu, ifEntry, OID_LENGTH(ifEntry));
+    }
+    pkt = (u_char *) malloc(buf_len);
+    if (pkt == NULL ||
+        snmp_build(&pkt, &buf_len, &offset, session, pdu) != 0) {
+        free(pkt);
+        snmp_free_pdu(pdu);
+        return NULL;
+    }
+    snmp_free_pdu(pdu);
+    memmove(pkt, pkt + buf_len - offset, offset);
+
+    len = offset;
+    data = snmp_comstr_parse(pkt, &len, community, &community_len, &version);
+    *pdu_data = data;
+    *pdu_len = len;
+    return pkt;
+}
+
+static netsnmp_pdu *
+parse(u_char *data, size_t len)
+{
+    netsnmp_pdu *pdu = snmp_pdu_create(0);
+
+    if (pdu && snmp_pdu_parse(pdu, data, &len) != 0) {
+        snmp_free_pdu(pdu);
+        return NULL;
+    }
+    return pdu;
+}
+
+/* Returns 1 if both PDUs carry the same request */
+static int
+same(netsnmp_pdu *a, netsnmp_pdu *b)
+{
+    netsnmp_variable_list *va, *vb;
+
+    if (a == NULL || b == NULL || a->command != b->command ||
+        a->reqid != b->reqid)
+        return 0;
+    for (va = a->variables, vb = b->variables; va && vb;
+         va = va->next_variable, vb = vb->next_variable)
+        if (snmp_oid_compare(va->name, va->name_length, vb->name,
+                             vb->name_length) != 0 || va->type != vb->type)
+            return 0;
+    return va == NULL && vb == NULL;
+}
+
+/* Returns the time per message */
+static double
+run(u_char *data, size_t len, int pool_size, int iterations)
+{
+    struct timeval start;
+    netsnmp_pdu   *pdu, *response;
+    int            i;
+
+    netsnmp_ds_set_int(NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_PDU_POOL_SIZE,
+                       pool_size);
+    gettimeofday(&start, NULL);
+    for (i = 0; i < iterations; i++) {
+        pdu = parse(data, len);
+        response = snmp_clone_pdu(pdu);
+        response->command = SNMP_MSG_RESPONSE;
+        snmp_free_pdu(pdu);
+        snmp_free_pdu(response);
+    }
+    return perf_elapsed_us(&start) / iterations;
+}
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_session session;
+    netsnmp_pdu_pool_stats before, stats;
+    netsnmp_pdu    *pdus[2 * POOL_SIZE], *plain, *pooled;
+    u_char         *pkt, *data;
+    size_t          len;
+    double          usec, pooled_usec;
+    int             i, n, iterations;
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_snmp("pdu-pool-perf");
+    snmp_sess_init(&session);
+    session.version = SNMP_VERSION_2c;
+    session.community = (u_char *) strdup("public");
+    session.community_len = strlen("public");
+
+    for (n = 0; n < sizeof(nvarbinds) / sizeof(nvarbinds[0]); n++) {
+        pkt = build(&session, nvarbinds[n], &data, &len);
+        if (!pkt) {
+            OKF(0, ("%d varbinds: request built", nvarbinds[n]));
+            continue;
+        }
+
+        netsnmp_ds_set_int(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_PDU_POOL_SIZE, 0);
+        plain = parse(data, len);
+        netsnmp_ds_set_int(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_PDU_POOL_SIZE, POOL_SIZE);
+        snmp_free_pdu(parse(data, len));
+        pooled = parse(data, len);
+        OKF(same(plain, pooled),
+            ("%d varbinds: PDU parsed into pooled structures is the same",
+             nvarbinds[n]));
+        snmp_free_pdu(plain);
+        snmp_free_pdu(pooled);
+
+        iterations = VARBINDS_PER_RUN / nvarbinds[n];
+        usec = run(data, len, 0, iterations);
+        netsnmp_pdu_pool_clear();
+        netsnmp_pdu_pool_get_stats(&before);
+        pooled_usec = run(data, len, POOL_SIZE, iterations);
+        netsnmp_pdu_pool_get_stats(&stats);
+        /* in steady state everything but the first message is reused */
+        OKF(stats.pdu_reused - before.pdu_reused ==
+            stats.pdu_allocs - before.pdu_allocs - 2 &&
+            stats.varbind_reused - before.varbind_reused ==
+            stats.varbind_allocs - before.varbind_allocs - 2 * nvarbinds[n],
+            ("%d varbinds: %lu/%lu PDUs and %lu/%lu varbinds reused",
+             nvarbinds[n], stats.pdu_reused - before.pdu_reused,
+             stats.pdu_allocs - before.pdu_allocs,
+             stats.varbind_reused - before.varbind_reused,
+             stats.varbind_allocs - before.varbind_allocs));
+        printf("# %3d varbinds: %7.2f us per message, pooled %7.2f us "
+               "(x%.2f)\n", nvarbinds[n], usec, pooled_usec,
+               usec / pooled_usec);
+        free(pkt);
+    }
+
+    /* the pool is capped at pduPoolSize */
+    netsnmp_pdu_pool_clear();
+    for (i = 0; i < 2 * POOL_SIZE; i++)
+        pdus[i] = snmp_pdu_create(SNMP_MSG_GET);
+    for (i = 0; i < 2 * POOL_SIZE; i++)
+        snmp_free_pdu(pdus[i]);
+    netsnmp_pdu_pool_get_stats(&stats);
+    OKF(stats.pdus_free == POOL_SIZE,
+        ("%lu PDUs kept in a pool of %d", stats.pdus_free, POOL_SIZE));
+
+    /* and emptied when it is disabled */
+    netsnmp_ds_set_int(NETSNMP_DS_LIBRARY_ID, NETSNMP_DS_LIB_PDU_POOL_SIZE, 0);
+    netsnmp_pdu_pool_clear();
+    pooled = snmp_pdu_create(SNMP_MSG_GET);
+    snmp_free_pdu(pooled);
+    netsnmp_pdu_pool_get_stats(&stats);
+    OK(stats.pdus_free == 0 && stats.varbinds_free == 0,
+       "nothing kept with the pool disabled");
+
+    free(session.community);
+    snmp_shutdown("pdu-pool-perf");
+
+    PLAN(__test_counter);
+    return 0;
+}
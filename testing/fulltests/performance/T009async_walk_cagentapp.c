@@ -0,0 +1,463 @@
+/*
+ * HEADER Walk time over a slow link vs. requests in flight
+ *
+ * Walks a table of an in-process agent through a relay that delays each
+ * datagram, as a link with a round-trip time of a few milliseconds
+ * would, with netsnmp_walk_start() keeping 1, 2, 4 and 8 requests
+ * outstanding, and walks it on several sessions at once.  The varbinds
+ * must arrive complete and in order every time: split by column (the
+ * table has gaps in its column numbers and is followed by a scalar),
+ * split at given index values, and over SNMPv1.  A walk of an agent that
+ * does not answer must time out.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/library/snmp_walk.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "perftest.h"
+
+#define DELAY_US  1000          /* each way */
+#define ROWS      200
+#define SESSIONS  8
+#define QUEUE     256
+
+static const int parallel[] = { 1, 2, 4, 8 };
+static const u_long columns[] = { 1, 2, 3, 5, 6, 9 };
+#define NCOLUMNS  (sizeof(columns) / sizeof(columns[0]))
+
+static oid       table_oid[] = { 1, 3, 6, 1, 3, 999, 1 };
+static oid       group_oid[] = { 1, 3, 6, 1, 3, 999 };
+static oid       after_oid[] = { 1, 3, 6, 1, 3, 999, 2, 0 };
+static int       after_value = 42;
+#define TABLE_LEN OID_LENGTH(table_oid)
+
+/*
+ * The relay: one socket per client session, passing datagrams between
+ * the session and the agent DELAY_US after they arrive.
+ */
+static struct link {
+    int                 sock;
+    struct sockaddr_in  client;
+    int                 have_client;
+} links[SESSIONS];
+static struct sockaddr_in agent_addr;
+static struct delayed {
+    struct timeval      when;
+    int                 link, to_agent, len;
+    u_char              data[4096];
+} queue[QUEUE];
+static int       queue_head, queue_len;
+
+/* What a walk got, checked against the table as it arrives */
+static struct result {
+    int             done, status, got, bad, with_after;
+} results[SESSIONS];
+
+/* Finds the first instance after name; returns 0 past the end */
+static int
+table_next(const oid *name, size_t len, u_long *column, u_long *row)
+{
+    oid             last[TABLE_LEN + 3];
+    int             c;
+
+    memcpy(last, table_oid, sizeof(table_oid));
+    last[TABLE_LEN] = 1;
+    last[TABLE_LEN + 2] = ROWS;
+    for (c = 0; c < NCOLUMNS; c++) {
+        last[TABLE_LEN + 1] = columns[c];
+        if (snmp_oid_compare(name, len, last, TABLE_LEN + 3) >= 0)
+            continue;
+        *column = columns[c];
+        if (len >= TABLE_LEN + 3 &&
+            snmp_oid_compare(name, TABLE_LEN + 2, last, TABLE_LEN + 2) == 0)
+            *row = name[TABLE_LEN + 2] + 1;
+        else
+            *row = 1;
+        return 1;
+    }
+    return 0;
+}
+
+static int
+table_handler(netsnmp_mib_handler *handler,
+              netsnmp_handler_registration *reginfo,
+              netsnmp_agent_request_info *reqinfo,
+              netsnmp_request_info *requests)
+{
+    netsnmp_variable_list *var;
+    oid             name[TABLE_LEN + 3];
+    u_long          column, row;
+    long            value;
+    int             c;
+
+    for (; requests; requests = requests->next) {
+        var = requests->requestvb;
+        if (reqinfo->mode == MODE_GETNEXT) {
+            if (!table_next(var->name, var->name_length, &column, &row))
+                continue;
+            memcpy(name, table_oid, sizeof(table_oid));
+            name[TABLE_LEN] = 1;
+            name[TABLE_LEN + 1] = column;
+            name[TABLE_LEN + 2] = row;
+            snmp_set_var_objid(var, name, TABLE_LEN + 3);
+        } else if (reqinfo->mode == MODE_GET) {
+            for (c = 0; c < NCOLUMNS; c++)
+                if (var->name_length == TABLE_LEN + 3 &&
+                    var->name[TABLE_LEN + 1] == columns[c])
+                    break;
+            if (c == NCOLUMNS || var->name[TABLE_LEN] != 1 ||
+                var->name[TABLE_LEN + 2] < 1 ||
+                var->name[TABLE_LEN + 2] > ROWS) {
+                netsnmp_set_request_error(reqinfo, requests,
+                                          SNMP_NOSUCHINSTANCE);
+                continue;
+            }
+            column = var->name[TABLE_LEN + 1];
+            row = var->name[TABLE_LEN + 2];
+        } else
+            continue;
+        value = column * 1000 + row;
+        snmp_set_var_typed_value(var, ASN_INTEGER, &value, sizeof(value));
+    }
+    return SNMP_ERR_NOERROR;
+}
+
+static void
+relay_receive(int l)
+{
+    struct delayed    *d;
+    struct sockaddr_in from;
+    socklen_t          fromlen;
+    int                len;
+
+    for (;;) {
+        d = &queue[(queue_head + queue_len) % QUEUE];
+        fromlen = sizeof(from);
+        len = recvfrom(links[l].sock, d->data, sizeof(d->data), 0,
+                       (struct sockaddr *) &from, &fromlen);
+        if (len <= 0 || queue_len == QUEUE)
+            return;
+        d->to_agent = (from.sin_port != agent_addr.sin_port);
+        if (d->to_agent) {
+            links[l].client = from;
+            links[l].have_client = 1;
+        }
+        d->link = l;
+        d->len = len;
+        gettimeofday(&d->when, NULL);
+        d->when.tv_usec += DELAY_US;
+        d->when.tv_sec += d->when.tv_usec / 1000000;
+        d->when.tv_usec %= 1000000;
+        queue_len++;
+    }
+}
+
+/* Passes on what is due; returns the time until the next one, or -1 */
+static long
+relay_flush(void)
+{
+    struct delayed *d;
+    struct timeval  now;
+    long            wait;
+
+    gettimeofday(&now, NULL);
+    while (queue_len) {
+        d = &queue[queue_head];
+        wait = (d->when.tv_sec - now.tv_sec) * 1000000 +
+            (d->when.tv_usec - now.tv_usec);
+        if (wait > 0)
+            return wait;
+        if (d->to_agent)
+            sendto(links[d->link].sock, d->data, d->len, 0,
+                   (struct sockaddr *) &agent_addr, sizeof(agent_addr));
+        else if (links[d->link].have_client)
+            sendto(links[d->link].sock, d->data, d->len, 0,
+                   (struct sockaddr *) &links[d->link].client,
+                   sizeof(links[d->link].client));
+        queue_head = (queue_head + 1) % QUEUE;
+        queue_len--;
+    }
+    return -1;
+}
+
+/* Runs the agent, the relay and the walks until all n walks are done */
+static void
+serve(int n)
+{
+    fd_set         readfds;
+    struct timeval tv;
+    long           wait;
+    int            numfds, block, count, i, done;
+
+    for (;;) {
+        for (i = 0, done = 0; i < n; i++)
+            done += results[i].done;
+        if (done == n)
+            return;
+        numfds = 0;
+        block = 0;
+        tv.tv_sec = 0;
+        tv.tv_usec = 100000;
+        FD_ZERO(&readfds);
+        snmp_select_info(&numfds, &readfds, &tv, &block);
+        for (i = 0; i < SESSIONS; i++) {
+            FD_SET(links[i].sock, &readfds);
+            if (links[i].sock >= numfds)
+                numfds = links[i].sock + 1;
+        }
+        wait = relay_flush();
+        if (wait >= 0 && (block || wait < tv.tv_sec * 1000000 + tv.tv_usec)) {
+            tv.tv_sec = wait / 1000000;
+            tv.tv_usec = wait % 1000000;
+        } else if (block) {
+            tv.tv_sec = 0;
+            tv.tv_usec = 100000;
+        }
+        count = select(numfds, &readfds, NULL, NULL, &tv);
+        if (count > 0) {
+            for (i = 0; i < SESSIONS; i++)
+                if (FD_ISSET(links[i].sock, &readfds))
+                    relay_receive(i);
+            snmp_read(&readfds);
+        } else if (count == 0)
+            snmp_timeout();
+        relay_flush();
+        run_alarms();
+        netsnmp_check_outstanding_agent_requests();
+    }
+}
+
+static void
+walk_callback(int op, netsnmp_walk *walk, netsnmp_variable_list *vars,
+              void *magic)
+{
+    struct result  *r = (struct result *) magic;
+    oid             name[TABLE_LEN + 3];
+
+    if (op == NETSNMP_WALK_OP_DONE) {
+        r->done = 1;
+        r->status = walk->status;
+        return;
+    }
+    memcpy(name, table_oid, sizeof(table_oid));
+    name[TABLE_LEN] = 1;
+    for (; vars; vars = vars->next_variable, r->got++) {
+        if (r->got == NCOLUMNS * ROWS) {
+            if (r->with_after &&
+                snmp_oid_compare(vars->name, vars->name_length, after_oid,
+                                 OID_LENGTH(after_oid)) == 0 &&
+                *vars->val.integer == after_value)
+                continue;
+            r->bad++;
+            continue;
+        }
+        name[TABLE_LEN + 1] = columns[r->got / ROWS];
+        name[TABLE_LEN + 2] = r->got % ROWS + 1;
+        if (snmp_oid_compare(vars->name, vars->name_length, name,
+                             TABLE_LEN + 3) != 0 ||
+            vars->type != ASN_INTEGER ||
+            *vars->val.integer != name[TABLE_LEN + 1] * 1000 +
+            name[TABLE_LEN + 2])
+            r->bad++;
+    }
+}
+
+static netsnmp_session *
+open_session(int version, int port)
+{
+    netsnmp_session session;
+    char            peer[64];
+
+    snprintf(peer, sizeof(peer), "udp:127.0.0.1:%d", port);
+    snmp_sess_init(&session);
+    session.version = version;
+    session.peername = peer;
+    session.community = NETSNMP_REMOVE_CONST(u_char *, "public");
+    session.community_len = strlen("public");
+    session.timeout = 200000;
+    session.retries = 0;
+    return snmp_open(&session);
+}
+
+/*
+ * Walks root on ss with up to n requests in flight, and splits at the
+ * given OIDs if any; returns the time taken, or -1 if the walk failed.
+ */
+static double
+walk(netsnmp_session *ss, struct result *r, const oid *root,
+     size_t root_len, int n, oid (*split)[TABLE_LEN + 3], int nsplit)
+{
+    struct timeval start;
+    netsnmp_walk  *w;
+    int            i;
+
+    memset(r, 0, sizeof(*r));
+    r->with_after = (root_len < TABLE_LEN);
+    w = netsnmp_walk_create(snmp_sess_pointer(ss), root, root_len,
+                            walk_callback, r);
+    if (w == NULL)
+        return -1;
+    w->parallel = n;
+    for (i = 0; i < nsplit; i++)
+        netsnmp_walk_split_at(w, split[i], TABLE_LEN + 3);
+    gettimeofday(&start, NULL);
+    netsnmp_walk_start(w);
+    serve(r - results + 1);
+    return r->status == STAT_SUCCESS ? perf_elapsed_us(&start) : -1;
+}
+
+static int
+complete(const struct result *r)
+{
+    return r->done && r->status == STAT_SUCCESS && r->bad == 0 &&
+        r->got == NCOLUMNS * ROWS + r->with_after;
+}
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_handler_registration *reginfo;
+    netsnmp_transport  *t;
+    netsnmp_session    *ss[SESSIONS], *v1, *dead;
+    struct sockaddr_in  addr;
+    socklen_t           addrlen;
+    struct timeval      start;
+    oid                 split[3][TABLE_LEN + 3];
+    double              usec, base = 0;
+    int                 i, n, ok;
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_ROLE,
+                           0);
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_agent("async-walk-perf");
+    netsnmp_config(NETSNMP_REMOVE_CONST(char *,
+                                        "rocommunity public 127.0.0.1"));
+    init_snmp("async-walk-perf");
+
+    reginfo = netsnmp_create_handler_registration("walkTable",
+                                                  table_handler, table_oid,
+                                                  TABLE_LEN,
+                                                  HANDLER_CAN_RONLY);
+    OK(reginfo && netsnmp_register_handler(reginfo) == MIB_REGISTERED_OK &&
+       netsnmp_register_read_only_int_instance("walkAfter", after_oid,
+                                               OID_LENGTH(after_oid),
+                                               &after_value, NULL) ==
+       MIB_REGISTERED_OK, "table and scalar registered");
+
+    t = netsnmp_transport_open_server("async-walk-perf", "udp:127.0.0.1:0");
+    addrlen = sizeof(agent_addr);
+    OK(t != NULL && getsockname(t->sock, (struct sockaddr *) &agent_addr,
+                                &addrlen) == 0 &&
+       netsnmp_register_agent_nsap(t) >= 0, "agent listening");
+
+    for (i = 0; i < SESSIONS; i++) {
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addrlen = sizeof(addr);
+        links[i].sock = socket(AF_INET, SOCK_DGRAM, 0);
+        bind(links[i].sock, (struct sockaddr *) &addr, sizeof(addr));
+        getsockname(links[i].sock, (struct sockaddr *) &addr, &addrlen);
+        fcntl(links[i].sock, F_SETFL, O_NONBLOCK);
+        ss[i] = open_session(SNMP_VERSION_2c, ntohs(addr.sin_port));
+    }
+    v1 = open_session(SNMP_VERSION_1, ntohs(addr.sin_port));
+    OK(ss[0] && ss[SESSIONS - 1] && v1, "sessions open");
+
+    printf("# %d columns x %d rows, %d us each way\n", (int) NCOLUMNS, ROWS,
+           DELAY_US);
+    for (n = 0; n < sizeof(parallel) / sizeof(parallel[0]); n++) {
+        usec = walk(ss[0], &results[0], table_oid, TABLE_LEN, parallel[n],
+                    NULL, 0);
+        OKF(complete(&results[0]),
+            ("%d in flight: %d varbinds, %d wrong", parallel[n],
+             results[0].got, results[0].bad));
+        if (parallel[n] == 1)
+            base = usec;
+        printf("# %d in flight: %8.0f us per walk (x%.2f)\n", parallel[n],
+               usec, base / usec);
+    }
+
+    /* a group whose first child is a table, with a scalar after it */
+    walk(ss[0], &results[0], group_oid, OID_LENGTH(group_oid), 4, NULL, 0);
+    OKF(complete(&results[0]),
+        ("group, 4 in flight: %d varbinds, %d wrong", results[0].got,
+         results[0].bad));
+
+    /* index ranges */
+    for (i = 0; i < 3; i++) {
+        memcpy(split[i], table_oid, sizeof(table_oid));
+        split[i][TABLE_LEN] = 1;
+    }
+    split[0][TABLE_LEN + 1] = 1;
+    split[0][TABLE_LEN + 2] = ROWS / 2;
+    split[1][TABLE_LEN + 1] = 3;
+    split[1][TABLE_LEN + 2] = 0;
+    split[2][TABLE_LEN + 1] = 6;
+    split[2][TABLE_LEN + 2] = ROWS / 4;
+    usec = walk(ss[0], &results[0], table_oid, TABLE_LEN, 4, split, 3);
+    OKF(complete(&results[0]),
+        ("split at 3 OIDs, 4 in flight: %d varbinds, %d wrong",
+         results[0].got, results[0].bad));
+    printf("# split at 3 OIDs, 4 in flight: %8.0f us per walk (x%.2f)\n",
+           usec, base / usec);
+
+    usec = walk(v1, &results[0], table_oid, TABLE_LEN, 4, NULL, 0);
+    OKF(complete(&results[0]),
+        ("SNMPv1, 4 in flight: %d varbinds, %d wrong", results[0].got,
+         results[0].bad));
+
+    /* one walk on each session, all at once */
+    gettimeofday(&start, NULL);
+    for (i = 0; i < SESSIONS; i++) {
+        netsnmp_walk *w;
+
+        memset(&results[i], 0, sizeof(results[i]));
+        w = netsnmp_walk_create(snmp_sess_pointer(ss[i]), table_oid,
+                                TABLE_LEN, walk_callback, &results[i]);
+        if (w)
+            netsnmp_walk_start(w);
+        else
+            results[i].done = 1;
+    }
+    serve(SESSIONS);
+    usec = perf_elapsed_us(&start);
+    for (i = 0, ok = 0; i < SESSIONS; i++)
+        ok += complete(&results[i]);
+    OKF(ok == SESSIONS, ("%d/%d concurrent walks complete", ok, SESSIONS));
+    printf("# %d sessions at once: %8.0f us for all (x%.2f)\n", SESSIONS,
+           usec, SESSIONS * base / usec);
+
+    /* nobody listens on the agent's old port once it is closed */
+    dead = open_session(SNMP_VERSION_2c, ntohs(addr.sin_port));
+    close(links[SESSIONS - 1].sock);
+    links[SESSIONS - 1].sock = socket(AF_INET, SOCK_DGRAM, 0);
+    walk(dead, &results[0], table_oid, TABLE_LEN, 4, NULL, 0);
+    OKF(results[0].done && results[0].status == STAT_TIMEOUT,
+        ("walk of a silent agent: status %d", results[0].status));
+
+    for (i = 0; i < SESSIONS; i++) {
+        snmp_close(ss[i]);
+        close(links[i].sock);
+    }
+    snmp_close(v1);
+    snmp_close(dead);
+    snmp_shutdown("async-walk-perf");
+    shutdown_agent();
+
+    PLAN(__test_counter);
+    return 0;
+}
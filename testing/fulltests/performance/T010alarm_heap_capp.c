@@ -0,0 +1,210 @@
+/*
+ * HEADER snmp_alarm with 100000 alarms
+ *
+ * Registers 100000 repeating alarms and times registration, finding the
+ * next alarm due, resetting and unregistering them, comparing the cost
+ * of finding the next one with the scan of every alarm this used to
+ * take.  The next alarm must always be the earliest one registered.
+ * Then 100000 one-shot alarms due within a fraction of a second, plus
+ * repeating ones that unregister themselves from their callback, are
+ * run: each must fire once, not early, and in the order they are due.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "perftest.h"
+
+#define NALARMS         100000
+#define NREPEATING      1000
+#define SCANS           200
+
+struct snmp_alarm *sa_find_specific(unsigned int clientreg);
+
+static unsigned int regs[NALARMS];
+static struct timeval due[NALARMS];
+static int      fired[NALARMS];
+static int      nfired, out_of_order, early, repeats_left;
+static struct timeval last_due;
+
+static void
+idle_callback(unsigned int clientreg, void *clientarg)
+{
+}
+
+static void
+once_callback(unsigned int clientreg, void *clientarg)
+{
+    int             i = (int) (intptr_t) clientarg;
+    struct timeval  now;
+
+    netsnmp_get_monotonic_clock(&now);
+    if (timercmp(&now, &due[i], <))
+        early++;
+    if (timercmp(&due[i], &last_due, <))
+        out_of_order++;
+    last_due = due[i];
+    fired[i]++;
+    nfired++;
+}
+
+static void
+repeat_callback(unsigned int clientreg, void *clientarg)
+{
+    int            *count = (int *) clientarg;
+
+    if (++*count == 3) {
+        snmp_alarm_unregister(clientreg);
+        repeats_left--;
+    }
+}
+
+/*
+ * What sa_find_next() used to do: look at every alarm.
+ */
+static struct snmp_alarm *
+scan_for_next(int n)
+{
+    struct snmp_alarm *a, *lowest = NULL;
+    int             i;
+
+    for (i = 0; i < n; i++) {
+        a = sa_find_specific(regs[i]);
+        if (a && (lowest == NULL ||
+                  timercmp(&a->t_nextM, &lowest->t_nextM, <)))
+            lowest = a;
+    }
+    return lowest;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct timeval  start, t, now, deadline, next;
+    static int      counts[NREPEATING];
+    double          usec, scan_usec;
+    int             i, j, ok, remaining;
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_snmp("alarm-perf");
+    snmp_alarm_unregister_all();
+    srandom(10);
+
+    /* register: intervals of 100 to 1000 seconds, which never fire here */
+    gettimeofday(&start, NULL);
+    ok = 1;
+    for (i = 0; i < NALARMS; i++) {
+        t.tv_sec = 100 + random() % 900;
+        t.tv_usec = random() % 1000000;
+        regs[i] = snmp_alarm_register_hr(t, SA_REPEAT, idle_callback, NULL);
+        if (regs[i] == 0)
+            ok = 0;
+    }
+    usec = perf_elapsed_us(&start);
+    printf("# register: %.3f us per alarm\n", usec / NALARMS);
+    OK(ok, "100000 alarms registered");
+
+    OK(sa_find_next() == scan_for_next(NALARMS),
+       "next alarm is the earliest one");
+
+    gettimeofday(&start, NULL);
+    netsnmp_get_monotonic_clock(&now);
+    for (i = 0; i < NALARMS; i++)
+        netsnmp_get_next_alarm_time(&next, &now);
+    usec = perf_elapsed_us(&start) / NALARMS;
+    gettimeofday(&start, NULL);
+    for (i = 0; i < SCANS; i++)
+        scan_for_next(NALARMS);
+    scan_usec = perf_elapsed_us(&start) / SCANS;
+    printf("# next alarm: %.3f us, scanning all alarms %.1f us (x%.0f)\n",
+           usec, scan_usec, scan_usec / usec);
+    OKF(usec * 100 < scan_usec,
+        ("finding the next alarm does not look at every alarm"));
+
+    /* reset: moves the alarms' next time, and their place */
+    gettimeofday(&start, NULL);
+    ok = 1;
+    for (i = 0; i < NALARMS; i += 10)
+        if (snmp_alarm_reset(regs[i]) != 0)
+            ok = 0;
+    usec = perf_elapsed_us(&start);
+    printf("# reset: %.3f us per alarm\n", usec / (NALARMS / 10));
+    OK(ok && sa_find_next() == scan_for_next(NALARMS),
+       "next alarm is the earliest one after resetting some");
+
+    /* unregister every other alarm, from the middle out */
+    gettimeofday(&start, NULL);
+    for (i = 0; i < NALARMS / 2; i += 2) {
+        snmp_alarm_unregister(regs[NALARMS / 2 + i]);
+        snmp_alarm_unregister(regs[NALARMS / 2 - 2 - i]);
+    }
+    usec = perf_elapsed_us(&start);
+    printf("# unregister: %.3f us per alarm\n", usec / (NALARMS / 2));
+    ok = 1;
+    for (i = 0; i < NALARMS; i++)
+        if ((sa_find_specific(regs[i]) == NULL) != (i % 2 == 0))
+            ok = 0;
+    OK(ok, "unregistered alarms are gone and the others remain");
+    OK(sa_find_next() == scan_for_next(NALARMS),
+       "next alarm is the earliest one after unregistering half");
+
+    snmp_alarm_unregister_all();
+    OK(sa_find_next() == NULL && sa_find_specific(regs[1]) == NULL,
+       "no alarms after unregistering all");
+
+    /* run: one-shot alarms due within 200ms, and some repeating ones */
+    for (i = 0; i < NALARMS; i++) {
+        t.tv_sec = 0;
+        t.tv_usec = random() % 200000;
+        regs[i] = snmp_alarm_register_hr(t, 0, once_callback,
+                                         (void *) (intptr_t) i);
+        due[i] = sa_find_specific(regs[i])->t_nextM;
+    }
+    for (i = 0; i < NREPEATING; i++) {
+        t.tv_sec = 0;
+        t.tv_usec = 10000 + random() % 40000;
+        snmp_alarm_register_hr(t, SA_REPEAT, repeat_callback, &counts[i]);
+    }
+    repeats_left = NREPEATING;
+
+    gettimeofday(&start, NULL);
+    netsnmp_get_monotonic_clock(&deadline);
+    deadline.tv_sec += 30;
+    do {
+        run_alarms();
+        netsnmp_get_monotonic_clock(&now);
+    } while ((nfired < NALARMS || repeats_left > 0) &&
+             timercmp(&now, &deadline, <));
+    usec = perf_elapsed_us(&start);
+    printf("# ran %d alarms in %.0f ms\n", nfired + 3 * NREPEATING,
+           usec / 1000);
+
+    remaining = 0;
+    for (i = 0, j = 0; i < NALARMS; i++) {
+        if (fired[i] != 1)
+            j++;
+        if (sa_find_specific(regs[i]))
+            remaining++;
+    }
+    OKF(j == 0, ("every one-shot alarm fired once (%d did not)", j));
+    OKF(remaining == 0,
+        ("fired one-shot alarms are unregistered (%d remain)", remaining));
+    OKF(early == 0, ("no alarm fired early (%d did)", early));
+    OKF(out_of_order == 0,
+        ("alarms fired in the order they were due (%d did not)",
+         out_of_order));
+    OKF(repeats_left == 0 && sa_find_next() == NULL,
+        ("repeating alarms fired until they unregistered themselves"));
+
+    snmp_shutdown("alarm-perf");
+
+    PLAN(__test_counter);
+    return 0;
+}
@@ -0,0 +1,363 @@
+/*
+ * HEADER GETBULK walk of a 10000-row table, natively and repetition by repetition
+ *
+ * Registers the same 10000-row table_tdata table twice: once as it is,
+ * where the table helper answers all the repetitions of a GETBULK in
+ * one call, and once with the bulk_to_next helper put back in front of
+ * it, so that the agent makes a pass over its handlers for each
+ * repetition as it used to.  Both are walked with GETBULK requests of 10
+ * and 50 repetitions through an in-process agent, and the fastest of
+ * three walks timed.
+ * Every walk must return each instance once, in order, with its value,
+ * and leave out the one instance excluded from the view of a second
+ * community.  A request whose repetitions run off the end of the table
+ * must carry on into the registrations that follow it.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "perftest.h"
+
+#define ROWS      10000
+#define COLUMNS   4
+#define HIDDEN_COLUMN 3
+#define HIDDEN_ROW    5000
+#define RUNS      3
+
+static const int repetitions[] = { 10, 50 };
+
+static oid       native_oid[] = { 1, 3, 6, 1, 3, 998, 1 };
+static oid       after_oid[] = { 1, 3, 6, 1, 3, 998, 2, 0 };
+static oid       loop_oid[] = { 1, 3, 6, 1, 3, 999, 1 };
+static int       after_value = 42;
+static long      row_numbers[ROWS + 1];
+#define TABLE_LEN OID_LENGTH(native_oid)
+
+/* Each instance holds row * 10 + column */
+static int
+table_handler(netsnmp_mib_handler *handler,
+              netsnmp_handler_registration *reginfo,
+              netsnmp_agent_request_info *reqinfo,
+              netsnmp_request_info *requests)
+{
+    netsnmp_request_info *request;
+    netsnmp_table_request_info *table_info;
+    long           *row;
+
+    for (request = requests; request; request = request->next) {
+        if (request->processed)
+            continue;
+        row = (long *) netsnmp_tdata_extract_entry(request);
+        table_info = netsnmp_extract_table_info(request);
+        if (row == NULL || table_info == NULL) {
+            netsnmp_set_request_error(reqinfo, request,
+                                      SNMP_NOSUCHINSTANCE);
+            continue;
+        }
+        snmp_set_var_typed_integer(request->requestvb, ASN_INTEGER,
+                                   *row * 10 + table_info->colnum);
+    }
+    return SNMP_ERR_NOERROR;
+}
+
+static netsnmp_handler_registration *
+register_table(const char *name, netsnmp_tdata *table, oid *root)
+{
+    netsnmp_handler_registration *reginfo;
+    netsnmp_table_registration_info *table_info;
+
+    reginfo = netsnmp_create_handler_registration(name, table_handler, root,
+                                                  TABLE_LEN,
+                                                  HANDLER_CAN_RONLY);
+    table_info = SNMP_MALLOC_TYPEDEF(netsnmp_table_registration_info);
+    if (reginfo == NULL || table_info == NULL)
+        return NULL;
+    netsnmp_table_helper_add_indexes(table_info, ASN_INTEGER, 0);
+    table_info->min_column = 1;
+    table_info->max_column = COLUMNS;
+    if (netsnmp_tdata_register(reginfo, table, table_info) !=
+        MIB_REGISTERED_OK)
+        return NULL;
+    return reginfo;
+}
+
+static netsnmp_session *
+open_session(const char *community, int port)
+{
+    netsnmp_session session;
+    char            peer[64];
+
+    snprintf(peer, sizeof(peer), "udp:127.0.0.1:%d", port);
+    snmp_sess_init(&session);
+    session.version = SNMP_VERSION_2c;
+    session.peername = peer;
+    session.community = (u_char *) NETSNMP_REMOVE_CONST(char *, community);
+    session.community_len = strlen(community);
+    session.timeout = 5000000;
+    session.retries = 0;
+    return snmp_open(&session);
+}
+
+/*
+ * Walks the table at root with GETBULK requests; returns the time taken
+ * and counts the instances in *got and the wrong, repeated or misplaced
+ * ones in *bad.
+ */
+static double
+walk(netsnmp_session *ss, const oid *root, int reps, int hidden,
+     int *got, int *bad)
+{
+    struct timeval  start;
+    netsnmp_pdu    *pdu, *response;
+    netsnmp_variable_list *vb;
+    oid             name[MAX_OID_LEN];
+    size_t          name_len = TABLE_LEN;
+    u_long          column, row;
+    int             done = 0;
+
+    *got = *bad = 0;
+    memcpy(name, root, TABLE_LEN * sizeof(oid));
+    gettimeofday(&start, NULL);
+    while (!done) {
+        pdu = snmp_pdu_create(SNMP_MSG_GETBULK);
+        pdu->non_repeaters = 0;
+        pdu->max_repetitions = reps;
+        snmp_add_null_var(pdu, name, name_len);
+        if (snmp_synch_response(ss, pdu, &response) != STAT_SUCCESS ||
+            response->errstat != SNMP_ERR_NOERROR) {
+            (*bad)++;
+            if (response)
+                snmp_free_pdu(response);
+            break;
+        }
+        for (vb = response->variables; vb; vb = vb->next_variable) {
+            if (vb->type == SNMP_ENDOFMIBVIEW ||
+                snmp_oidtree_compare(root, TABLE_LEN, vb->name,
+                                     vb->name_length) != 0) {
+                done = 1;
+                break;
+            }
+            if (snmp_oid_compare(vb->name, vb->name_length,
+                                 name, name_len) <= 0)
+                (*bad)++;
+            memcpy(name, vb->name, vb->name_length * sizeof(oid));
+            name_len = vb->name_length;
+            column = name[TABLE_LEN + 1];
+            row = name[TABLE_LEN + 2];
+            if (name_len != TABLE_LEN + 3 || vb->type != ASN_INTEGER ||
+                *vb->val.integer != (long) (row * 10 + column) ||
+                (hidden && column == HIDDEN_COLUMN && row == HIDDEN_ROW))
+                (*bad)++;
+            (*got)++;
+        }
+        if (response->variables == NULL)
+            done = 1;
+        snmp_free_pdu(response);
+    }
+    return perf_elapsed_us(&start);
+}
+
+/* The fastest of RUNS walks, which must all get the same */
+static double
+best_walk(netsnmp_session *ss, const oid *root, int reps, int *got, int *bad)
+{
+    double          usec, best = 0;
+    int             i, got1, bad1;
+
+    *bad = 0;
+    for (i = 0; i < RUNS; i++) {
+        usec = walk(ss, root, reps, 0, &got1, &bad1);
+        if (i == 0 || usec < best)
+            best = usec;
+        if (i > 0 && got1 != *got)
+            bad1++;
+        *got = got1;
+        *bad += bad1;
+    }
+    return best;
+}
+
+/* A GETBULK for the last rows of the table, running on past its end */
+static int
+past_the_end(netsnmp_session *ss)
+{
+    netsnmp_pdu    *pdu, *response;
+    netsnmp_variable_list *vb;
+    oid             name[TABLE_LEN + 3];
+    static const struct {
+        const oid      *prefix;
+        size_t          prefix_len;
+        oid             column, row;
+    } expect[] = {
+        { native_oid, TABLE_LEN, 4, ROWS },
+        { native_oid, TABLE_LEN, 3, 1 },
+        { after_oid, OID_LENGTH(after_oid) },
+        { native_oid, TABLE_LEN, 3, 2 },
+        { loop_oid, TABLE_LEN, 1, 1 },
+        { native_oid, TABLE_LEN, 3, 3 },
+        { loop_oid, TABLE_LEN, 1, 2 },
+        { native_oid, TABLE_LEN, 3, 4 },
+    };
+    int             i, ok;
+
+    pdu = snmp_pdu_create(SNMP_MSG_GETBULK);
+    pdu->non_repeaters = 0;
+    pdu->max_repetitions = 4;
+    memcpy(name, native_oid, sizeof(native_oid));
+    name[TABLE_LEN] = 1;
+    name[TABLE_LEN + 1] = 4;
+    name[TABLE_LEN + 2] = ROWS - 1;
+    snmp_add_null_var(pdu, name, TABLE_LEN + 3);
+    name[TABLE_LEN + 1] = 2;
+    name[TABLE_LEN + 2] = ROWS;
+    snmp_add_null_var(pdu, name, TABLE_LEN + 3);
+    if (snmp_synch_response(ss, pdu, &response) != STAT_SUCCESS)
+        return 0;
+
+    ok = response->errstat == SNMP_ERR_NOERROR;
+    for (i = 0, vb = response->variables;
+         ok && i < sizeof(expect) / sizeof(expect[0]);
+         i++, vb = vb->next_variable) {
+        if (vb == NULL) {
+            ok = 0;
+            break;
+        }
+        if (expect[i].prefix == after_oid) {
+            ok = snmp_oid_compare(vb->name, vb->name_length, after_oid,
+                                  OID_LENGTH(after_oid)) == 0;
+            continue;
+        }
+        memcpy(name, expect[i].prefix, TABLE_LEN * sizeof(oid));
+        name[TABLE_LEN] = 1;
+        name[TABLE_LEN + 1] = expect[i].column;
+        name[TABLE_LEN + 2] = expect[i].row;
+        ok = snmp_oid_compare(vb->name, vb->name_length, name,
+                              TABLE_LEN + 3) == 0 &&
+            *vb->val.integer == (long) (expect[i].row * 10 +
+                                        expect[i].column);
+    }
+    if (vb != NULL)
+        ok = 0;
+    snmp_free_pdu(response);
+    return ok;
+}
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_handler_registration *native, *loop;
+    netsnmp_mib_handler *bulk_to_next;
+    netsnmp_tdata      *table;
+    netsnmp_tdata_row  *row;
+    netsnmp_transport  *t;
+    netsnmp_session    *ss, *limited;
+    struct sockaddr_in  agent_addr;
+    socklen_t           addrlen;
+    double              usec, loop_usec;
+    char                what[64];
+    int                 i, n, got, bad, ok;
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_ROLE,
+                           0);
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_agent("bulk-table-perf");
+    netsnmp_config(NETSNMP_REMOVE_CONST(char *,
+                                        "rocommunity public 127.0.0.1"));
+    netsnmp_config(NETSNMP_REMOVE_CONST(char *, "view most included .1"));
+    netsnmp_config(NETSNMP_REMOVE_CONST(char *,
+                                        "view most excluded .1.3.6.1.3.998.1.1.3.5000"));
+    netsnmp_config(NETSNMP_REMOVE_CONST(char *,
+                                        "view most excluded .1.3.6.1.3.999.1.1.3.5000"));
+    netsnmp_config(NETSNMP_REMOVE_CONST(char *,
+                                        "rocommunity limited 127.0.0.1 -V most"));
+    init_snmp("bulk-table-perf");
+
+    table = netsnmp_tdata_create_table("bulkTable", 0);
+    ok = table != NULL;
+    for (i = 1; ok && i <= ROWS; i++) {
+        row_numbers[i] = i;
+        row = netsnmp_tdata_create_row();
+        if (row == NULL) {
+            ok = 0;
+            break;
+        }
+        row->data = &row_numbers[i];
+        netsnmp_tdata_row_add_index(row, ASN_INTEGER, &row_numbers[i],
+                                    sizeof(row_numbers[i]));
+        if (netsnmp_tdata_add_row(table, row) != SNMPERR_SUCCESS)
+            ok = 0;
+    }
+    OK(ok, "10000 rows created");
+
+    native = register_table("nativeBulkTable", table, native_oid);
+    loop = register_table("loopBulkTable", table, loop_oid);
+    OK(native && (native->modes & HANDLER_CAN_GETBULK) && loop &&
+       netsnmp_register_read_only_int_instance("bulkAfter", after_oid,
+                                               OID_LENGTH(after_oid),
+                                               &after_value, NULL) ==
+       MIB_REGISTERED_OK, "tables registered, answering GETBULK natively");
+
+    /* the way every table used to be run */
+    bulk_to_next = netsnmp_get_bulk_to_next_handler();
+    if (loop && bulk_to_next) {
+        loop->modes &= ~HANDLER_CAN_GETBULK;
+        netsnmp_inject_handler(loop, bulk_to_next);
+    }
+
+    t = netsnmp_transport_open_server("bulk-table-perf", "udp:127.0.0.1:0");
+    addrlen = sizeof(agent_addr);
+    OK(t != NULL && getsockname(t->sock, (struct sockaddr *) &agent_addr,
+                                &addrlen) == 0 &&
+       netsnmp_register_agent_nsap(t) >= 0, "agent listening");
+    ss = open_session("public", ntohs(agent_addr.sin_port));
+    limited = open_session("limited", ntohs(agent_addr.sin_port));
+    OK(ss && limited, "sessions open");
+
+    for (n = 0; n < sizeof(repetitions) / sizeof(repetitions[0]); n++) {
+        usec = best_walk(ss, native_oid, repetitions[n], &got, &bad);
+        OKF(got == ROWS * COLUMNS && bad == 0,
+            ("%d repetitions, native: %d instances, %d wrong",
+             repetitions[n], got, bad));
+        loop_usec = best_walk(ss, loop_oid, repetitions[n], &got, &bad);
+        OKF(got == ROWS * COLUMNS && bad == 0,
+            ("%d repetitions, a pass per repetition: %d instances, "
+             "%d wrong", repetitions[n], got, bad));
+        printf("# %d repetitions: %.0f varbinds/s natively, %.0f a pass "
+               "per repetition (x%.2f)\n", repetitions[n],
+               ROWS * COLUMNS / usec * 1e6,
+               ROWS * COLUMNS / loop_usec * 1e6, loop_usec / usec);
+        snprintf(what, sizeof(what), "%d repetitions, native walk",
+                 repetitions[n]);
+        PERF_FASTER(usec, what, loop_usec, "a pass per repetition");
+    }
+
+    walk(limited, native_oid, 50, 1, &got, &bad);
+    OKF(got == ROWS * COLUMNS - 1 && bad == 0,
+        ("native, with an instance out of view: %d instances, %d wrong",
+         got, bad));
+    walk(limited, loop_oid, 50, 1, &got, &bad);
+    OKF(got == ROWS * COLUMNS - 1 && bad == 0,
+        ("a pass per repetition, with an instance out of view: "
+         "%d instances, %d wrong", got, bad));
+
+    OK(past_the_end(ss), "repetitions run on past the end of the table");
+
+    snmp_close(ss);
+    snmp_close(limited);
+    snmp_shutdown("bulk-table-perf");
+    shutdown_agent();
+
+    PLAN(__test_counter);
+    return 0;
+}
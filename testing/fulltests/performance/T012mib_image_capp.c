@@ -0,0 +1,252 @@
+/*
+ * HEADER init_snmp() with and without a MIB image
+ *
+ * Times init_snmp() loading every MIB in the MIB directories, with their
+ * descriptions, by parsing the MIB files and then from the MIB image
+ * saved by the first run with mibImageDir set.  The tree loaded from the
+ * image must be the same as the one parsed, and must still be usable by
+ * later module loads.  Changing a MIB file that was read must make the
+ * next init_snmp() parse the MIBs again and save a new image.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "perftest.h"
+
+#define RUNS            5
+
+static char     imagedir[] = "/tmp/snmp-mib-image-XXXXXX";
+static char     mibdir[SNMP_MAXPATH], mibfile[SNMP_MAXPATH];
+static u_int    dump_hash;
+static int      dump_nodes;
+
+static void
+hash_str(const char *s)
+{
+    if (!s)
+        s = "(null)";
+    for (; *s; s++)
+        dump_hash = (dump_hash ^ (u_char) *s) * 16777619U;
+    dump_hash = (dump_hash ^ '\n') * 16777619U;
+}
+
+static void
+hash_int(long i)
+{
+    char            buf[32];
+
+    snprintf(buf, sizeof(buf), "%ld", i);
+    hash_str(buf);
+}
+
+/*
+ * Everything the tree holds about each node, in tree order.
+ */
+static void
+hash_tree(struct tree *tp)
+{
+    struct enum_list *ep;
+    struct range_list *rp;
+    struct index_list *ip;
+    struct varbind_list *vp;
+    char            modbuf[256];
+    int             i;
+
+    for (; tp; tp = tp->next_peer) {
+        dump_nodes++;
+        hash_str(tp->label);
+        hash_int(tp->subid);
+        for (i = 0; i < tp->number_modules; i++)
+            hash_str(module_name(tp->module_list[i], modbuf));
+        hash_int(tp->type);
+        hash_int(tp->access);
+        hash_int(tp->status);
+        hash_str(tp->tc_index >= 0 ? get_tc_descriptor(tp->tc_index) : "");
+        hash_str(tp->tc_index >= 0 ? get_tc_description(tp->tc_index) : "");
+        for (ep = tp->enums; ep; ep = ep->next) {
+            hash_int(ep->value);
+            hash_str(ep->label);
+        }
+        for (rp = tp->ranges; rp; rp = rp->next) {
+            hash_int(rp->low);
+            hash_int(rp->high);
+        }
+        for (ip = tp->indexes; ip; ip = ip->next) {
+            hash_str(ip->ilabel);
+            hash_int(ip->isimplied);
+        }
+        for (vp = tp->varbinds; vp; vp = vp->next)
+            hash_str(vp->vblabel);
+        hash_str(tp->augments);
+        hash_str(tp->hint);
+        hash_str(tp->units);
+        hash_str(tp->description);
+        hash_str(tp->reference);
+        hash_str(tp->defaultValue);
+        hash_int(tp->printomat != NULL);
+        hash_tree(tp->child_list);
+    }
+}
+
+static void
+write_mib(int objects)
+{
+    FILE           *fp = fopen(mibfile, "w");
+    int             i;
+
+    fprintf(fp, "IMAGE-TEST-MIB DEFINITIONS ::= BEGIN\n"
+            "IMPORTS enterprises FROM SNMPv2-SMI;\n"
+            "imageTest OBJECT IDENTIFIER ::= { enterprises 99999 }\n");
+    for (i = 1; i <= objects; i++)
+        fprintf(fp, "imageTest%d OBJECT IDENTIFIER ::= { imageTest %d }\n",
+                i, i);
+    fprintf(fp, "END\n");
+    fclose(fp);
+}
+
+/*
+ * init_snmp(), hashing the tree loaded, and snmp_shutdown().
+ */
+static double
+run_init(const char *image)
+{
+    struct timeval  start;
+    double          usec;
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_SAVE_MIB_DESCRS, 1);
+    netsnmp_ds_set_string(NETSNMP_DS_LIBRARY_ID,
+                          NETSNMP_DS_LIB_MIB_IMAGE_DIR, image);
+    gettimeofday(&start, NULL);
+    init_snmp("mib-image-perf");
+    usec = perf_elapsed_us(&start);
+    dump_hash = 2166136261U;
+    dump_nodes = 0;
+    hash_tree(get_tree_head());
+    snmp_shutdown("mib-image-perf");
+    return usec;
+}
+
+static int
+image_count(void)
+{
+    char            cmd[SNMP_MAXPATH + 32];
+    FILE           *fp;
+    int             n = 0;
+
+    snprintf(cmd, sizeof(cmd), "ls %s/*.img 2>/dev/null", imagedir);
+    fp = popen(cmd, "r");
+    while (fp && fgets(cmd, sizeof(cmd), fp))
+        n++;
+    if (fp)
+        pclose(fp);
+    return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+    double          usec, parse_usec = 0, image_usec = 0;
+    u_int           parsed_hash;
+    int             parsed_nodes, i, ok;
+    char            dirs[2 * SNMP_MAXPATH + 2];
+    const char     *srcmibs = getenv("MIBDIRS");
+    char           *cmd = NULL;
+
+    if (!mkdtemp(imagedir)) {
+        perror(imagedir);
+        return 1;
+    }
+    snprintf(mibdir, sizeof(mibdir), "%s/mibs", imagedir);
+    mkdir(mibdir, 0700);
+    snprintf(mibfile, sizeof(mibfile), "%s/IMAGE-TEST-MIB.txt", mibdir);
+    write_mib(1);
+    snprintf(dirs, sizeof(dirs), "%s%c%s", srcmibs ? srcmibs : "../mibs",
+             ENV_SEPARATOR_CHAR, mibdir);
+    setenv("MIBDIRS", dirs, 1);
+    setenv("MIBS", "ALL", 1);
+    snmp_set_do_debugging(0);
+
+    /* parsing the MIB files */
+    for (i = 0; i < RUNS; i++) {
+        usec = run_init("");
+        if (i == 0 || usec < parse_usec)
+            parse_usec = usec;
+    }
+    parsed_hash = dump_hash;
+    parsed_nodes = dump_nodes;
+    printf("# parsing the MIBs: %.1f ms, %d nodes\n", parse_usec / 1000,
+           parsed_nodes);
+    OKF(image_count() == 0, ("no MIB image without mibImageDir"));
+
+    /* the first run saves the image, the others load it */
+    usec = run_init(imagedir);
+    printf("# parsing the MIBs and saving the image: %.1f ms\n",
+           usec / 1000);
+    OKF(image_count() == 1, ("a MIB image was saved"));
+    OKF(dump_hash == parsed_hash && dump_nodes == parsed_nodes,
+        ("saving the image leaves the tree as parsed"));
+    ok = 1;
+    for (i = 0; i < RUNS; i++) {
+        usec = run_init(imagedir);
+        if (i == 0 || usec < image_usec)
+            image_usec = usec;
+        if (dump_hash != parsed_hash || dump_nodes != parsed_nodes)
+            ok = 0;
+    }
+    printf("# loading the image: %.1f ms (x%.1f)\n", image_usec / 1000,
+           parse_usec / image_usec);
+    OKF(ok, ("the tree loaded from the image is the tree parsed"));
+    PERF_FASTER(image_usec, "loading the image", parse_usec,
+                "parsing the MIBs");
+
+    /* the image must not get in the way of loading more MIBs */
+    setenv("MIBS", "IF-MIB", 1);
+    for (i = 0; i < 2; i++) {
+        oid             name[MAX_OID_LEN];
+        size_t          name_len = MAX_OID_LEN;
+
+        netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                               NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+        netsnmp_ds_set_string(NETSNMP_DS_LIBRARY_ID,
+                              NETSNMP_DS_LIB_MIB_IMAGE_DIR, imagedir);
+        init_snmp("mib-image-perf");
+        ok = find_tree_node("imageTest1", -1) == NULL;
+        netsnmp_read_module("IMAGE-TEST-MIB");
+        ok = ok && read_objid("IMAGE-TEST-MIB::imageTest1", name, &name_len)
+            && name_len == 8 && name[6] == 99999 && name[7] == 1;
+        OKF(ok, ("a module can be read on top of %s",
+                 i == 0 ? "the MIBs parsed" : "a MIB image"));
+        snmp_shutdown("mib-image-perf");
+    }
+    setenv("MIBS", "ALL", 1);
+    OKF(image_count() == 2, ("one MIB image for each set of MIBs"));
+
+    /* changing a file that was read makes the MIBs be parsed again */
+    write_mib(2);
+    run_init(imagedir);
+    OKF(dump_nodes == parsed_nodes + 1,
+        ("a changed MIB file is parsed again (%d nodes, was %d)",
+         dump_nodes, parsed_nodes));
+    run_init(imagedir);
+    OKF(dump_nodes == parsed_nodes + 1,
+        ("the image saved for the changed MIB file is used"));
+
+    if (asprintf(&cmd, "rm -rf %s", imagedir) >= 0 && system(cmd) != 0)
+        printf("# could not remove %s\n", imagedir);
+    free(cmd);
+
+    PLAN(__test_counter);
+    return 0;
+}
@@ -0,0 +1,246 @@
+/*
+ * HEADER containers with 50000 table rows
+ *
+ * Times inserting 50000 rows with tcpConnectionTable style indexes in
+ * random order, finding each one, walking them with find_next and an
+ * iterator, and removing them again in random order, in a binary_array,
+ * the skiplist and the hash container.  The skiplist must return the
+ * rows in the same order as the binary_array, the hash container must
+ * find every row, and both must behave like the binary_array for
+ * duplicates, subsets and copies.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "perftest.h"
+
+#define NROWS           50000
+#define INDEX_LEN       10
+#define HASH_NEXTS      200
+
+typedef struct row_s {
+    netsnmp_index   index;
+    oid             oids[INDEX_LEN];
+} row;
+
+static row      rows[NROWS];
+static int      order[NROWS];
+
+/*
+ * tcpConnectionLocalAddressType, LocalAddress, LocalPort, RemAddressType,
+ * RemAddress, RemPort
+ */
+static void
+make_rows(void)
+{
+    int             i, j, t;
+
+    for (i = 0; i < NROWS; i++) {
+        row            *r = &rows[i];
+        oid             o[] = { 1, 4, 10, 0, 0, 1, 22, 1, 4, 192 };
+
+        o[3] = i % 7;
+        o[4] = (i / 7) % 256;
+        o[6] = 1024 + i / 1792;
+        o[9] = random() % 256;
+        memcpy(r->oids, o, sizeof(o));
+        r->index.oids = r->oids;
+        r->index.len = INDEX_LEN;
+        order[i] = i;
+    }
+    for (i = NROWS - 1; i > 0; i--) {
+        j = random() % (i + 1);
+        t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+}
+
+/*
+ * time the operations on one container, checking the results
+ */
+static int
+run(const char *type, int ordered, double *usec)
+{
+    netsnmp_container *c = netsnmp_container_find(type);
+    netsnmp_iterator *it;
+    struct timeval  start;
+    void           *d, *prev;
+    int             i, n, ok = 1;
+
+    if (c == NULL)
+        return 0;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < NROWS; i++)
+        if (CONTAINER_INSERT(c, &rows[order[i]]) != 0)
+            ok = 0;
+    usec[0] = perf_elapsed_us(&start);
+    if (CONTAINER_SIZE(c) != NROWS)
+        ok = 0;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < NROWS; i++)
+        if (CONTAINER_FIND(c, &rows[order[i]]) != &rows[order[i]])
+            ok = 0;
+    usec[1] = perf_elapsed_us(&start);
+
+    /* find_next through the whole table, a few steps for the hash */
+    n = ordered ? NROWS : HASH_NEXTS;
+    gettimeofday(&start, NULL);
+    for (i = 0, prev = NULL, d = CONTAINER_FIRST(c); d && i < n;
+         prev = d, d = CONTAINER_NEXT(c, d), i++)
+        if (prev && c->compare(prev, d) >= 0)
+            ok = 0;
+    usec[2] = perf_elapsed_us(&start) / i;
+    if (i != n)
+        ok = 0;
+
+    gettimeofday(&start, NULL);
+    it = CONTAINER_ITERATOR(c);
+    for (i = 0, prev = NULL, d = ITERATOR_FIRST(it); d;
+         prev = d, d = ITERATOR_NEXT(it), i++)
+        if (ordered && prev && c->compare(prev, d) >= 0)
+            ok = 0;
+    ITERATOR_RELEASE(it);
+    usec[3] = perf_elapsed_us(&start);
+    if (i != NROWS)
+        ok = 0;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < NROWS; i++)
+        if (CONTAINER_REMOVE(c, &rows[order[i]]) != 0)
+            ok = 0;
+    usec[4] = perf_elapsed_us(&start);
+    if (CONTAINER_SIZE(c) != 0 || CONTAINER_FIRST(c) != NULL)
+        ok = 0;
+
+    CONTAINER_FREE(c);
+
+    printf("# %-12s insert %.3f  find %.3f  find_next %.3f  iterate %.3f"
+           "  remove %.3f us per row\n", type, usec[0] / NROWS,
+           usec[1] / NROWS, usec[2], usec[3] / NROWS, usec[4] / NROWS);
+    return ok;
+}
+
+/*
+ * the things tables rely on besides plain lookups
+ */
+static int
+behaviour(const char *type, int ordered)
+{
+    netsnmp_container *c = netsnmp_container_find(type), *dup, *dups;
+    netsnmp_void_array *va;
+    row             key;
+    oid             prefix[] = { 1, 4, 10, 3 };
+    int             i, n, rc, ok = 1;
+
+    if (c == NULL)
+        return 0;
+    c->ncompare = netsnmp_ncompare_netsnmp_index;
+    for (i = 0; i < 1000; i++)
+        CONTAINER_INSERT(c, &rows[order[i]]);
+
+    /* duplicates are refused, unless allowed */
+    dups = netsnmp_container_find(type);
+    key = rows[order[10]];
+    key.index.oids = key.oids;
+    if (dups == NULL || dups->insert(dups, &rows[order[10]]) != 0 ||
+        dups->insert(dups, &key) == 0 || CONTAINER_SIZE(dups) != 1)
+        ok = 0;
+    CONTAINER_SET_OPTIONS(dups, CONTAINER_KEY_ALLOW_DUPLICATES, rc);
+    if (rc < 0 || dups->insert(dups, &key) != 0 ||
+        CONTAINER_SIZE(dups) != 2)
+        ok = 0;
+    if (CONTAINER_REMOVE(dups, &key) != 0 || CONTAINER_SIZE(dups) != 1 ||
+        CONTAINER_FIND(dups, &key) == NULL)
+        ok = 0;
+    CONTAINER_FREE(dups);
+
+    /* a subset: every row with the same start of the index */
+    key.index.oids = prefix;
+    key.index.len = OID_LENGTH(prefix);
+    for (i = 0, n = 0; i < 1000; i++)
+        if (netsnmp_ncompare_netsnmp_index(&rows[order[i]], &key) == 0)
+            n++;
+    va = CONTAINER_GET_SUBSET(c, &key);
+    if (va == NULL || va->size != (size_t)n)
+        ok = 0;
+    for (i = 0; va && i < (int)va->size; i++)
+        if (netsnmp_ncompare_netsnmp_index(va->array[i], &key) != 0 ||
+            (ordered && i && c->compare(va->array[i - 1], va->array[i]) >= 0))
+            ok = 0;
+    if (va) {
+        free(va->array);
+        free(va);
+    }
+
+    /* a copy has the same rows, and is independent of the original */
+    dup = CONTAINER_DUP(c, NULL, 0);
+    if (dup == NULL || CONTAINER_SIZE(dup) != 1000)
+        ok = 0;
+    for (i = 0; dup && i < 1000; i++)
+        if (CONTAINER_FIND(dup, &rows[order[i]]) != &rows[order[i]])
+            ok = 0;
+    CONTAINER_CLEAR(c, NULL, NULL);
+    if (CONTAINER_SIZE(c) != 0 || (dup && CONTAINER_SIZE(dup) != 1000))
+        ok = 0;
+    if (dup) {
+        if (ordered && CONTAINER_FIRST(dup) == NULL)
+            ok = 0;
+        CONTAINER_FREE(dup);
+    }
+
+    CONTAINER_FREE(c);
+    return ok;
+}
+
+int
+main(int argc, char *argv[])
+{
+    double          ba[5], sl[5], hash[5];
+    netsnmp_container *c;
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_snmp("container-perf");
+    srandom(13);
+    make_rows();
+
+    c = netsnmp_container_find("skiplist");
+    OK(c && c->compare == netsnmp_compare_netsnmp_index,
+       "skiplist container found by name");
+    if (c)
+        CONTAINER_FREE(c);
+    c = netsnmp_container_find("hash");
+    OK(c && c->compare == netsnmp_compare_netsnmp_index,
+       "hash container found by name");
+    if (c)
+        CONTAINER_FREE(c);
+
+    OK(run("binary_array", 1, ba), "binary_array rows");
+    OK(run("skiplist", 1, sl), "skiplist rows in order");
+    OK(run("hash", 0, hash), "hash rows all found");
+
+    OKF(sl[0] + sl[4] < ba[0] + ba[4],
+        ("skiplist inserts and removes rows faster than binary_array"
+         " (x%.1f)", (ba[0] + ba[4]) / (sl[0] + sl[4])));
+    OKF(hash[1] < ba[1],
+        ("hash finds rows faster than binary_array (x%.1f)",
+         ba[1] / hash[1]));
+
+    OK(behaviour("skiplist", 1), "skiplist duplicates, subsets and copies");
+    OK(behaviour("hash", 0), "hash duplicates, subsets and copies");
+
+    snmp_shutdown("container-perf");
+
+    PLAN(__test_counter);
+    return 0;
+}
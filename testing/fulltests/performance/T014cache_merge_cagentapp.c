@@ -0,0 +1,312 @@
+/*
+ * HEADER reloading a 50000-row table cache, in full and merged
+ *
+ * Reloads a cache of 50000 tcpConnectionTable style rows, of which 1%
+ * go, 1% are new and 1% change each time, once freeing the rows and
+ * loading them all again and once merging the reload into the rows that
+ * are there.  Both must end up with the same rows as the source; the
+ * merge must keep the rows which are still there, count what changed,
+ * and let a walk which goes on through several reloads find every row
+ * that was there all along, in order.  A reload which loads every row
+ * twice must leave one of each.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "perftest.h"
+
+#define NROWS           50000
+#define NSOURCE         (NROWS + NROWS / 4)
+#define CHURN           (NROWS / 100)
+#define INDEX_LEN       10
+#define RELOADS         5
+#define WALK_STEP       (NROWS / RELOADS / 2)
+
+typedef struct row_s {
+    netsnmp_index   index;
+    oid             oids[INDEX_LEN];
+    long            state;
+} row;
+
+/* the connections the "kernel" has; the first NROWS are there to start */
+static row      source[NSOURCE];
+static char     present[NSOURCE];
+static int      next_new = NROWS;
+static char     seen[NROWS / 4];
+static int      duplicates;     /* load every row twice */
+
+static void
+make_source(void)
+{
+    int             i;
+
+    for (i = 0; i < NSOURCE; i++) {
+        row            *r = &source[i];
+        oid             o[] = { 1, 4, 10, 0, 0, 1, 22, 1, 4, 192 };
+
+        o[3] = i % 7;
+        o[4] = (i / 7) % 256;
+        o[6] = 1024 + i / 1792;
+        o[9] = i % 3;
+        memcpy(r->oids, o, sizeof(o));
+        r->index.oids = r->oids;
+        r->index.len = INDEX_LEN;
+        r->state = 5;
+        present[i] = i < NROWS;
+    }
+}
+
+/*
+ * some connections close, some open and some change state. The first
+ * quarter of the rows never change, for the walk.
+ */
+static void
+churn(void)
+{
+    int             i, n;
+
+    for (n = 0; n < CHURN; n++) {
+        do
+            i = NROWS / 4 + random() % (NROWS * 3 / 4);
+        while (!present[i]);
+        present[i] = 0;
+    }
+    for (n = 0; n < CHURN; n++)
+        present[next_new++] = 1;
+    for (n = 0; n < CHURN; n++) {
+        do
+            i = NROWS / 4 + random() % (NROWS * 3 / 4);
+        while (!present[i]);
+        source[i].state = source[i].state == 5 ? 8 : 5;
+    }
+}
+
+static int
+load_rows(netsnmp_cache *cache, void *magic)
+{
+    netsnmp_container *c = (netsnmp_container *) magic;
+    int             i, copy;
+
+    for (i = 0; i < NSOURCE; i++) {
+        row            *r;
+
+        if (!present[i])
+            continue;
+        for (copy = 0; copy <= duplicates; copy++) {
+            r = SNMP_MALLOC_TYPEDEF(row);
+            if (r == NULL)
+                return -1;
+            *r = source[i];
+            r->index.oids = r->oids;
+            if (CONTAINER_INSERT(c, r) != 0) {
+                free(r);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void
+free_row(void *r, void *context)
+{
+    free(r);
+}
+
+static void
+free_rows(netsnmp_cache *cache, void *magic)
+{
+    CONTAINER_CLEAR((netsnmp_container *) magic, free_row, NULL);
+}
+
+static int
+merge_row(netsnmp_cache *cache, void *old_row, void *new_row)
+{
+    row            *o = (row *) old_row, *n = (row *) new_row;
+
+    if (o->state == n->state)
+        return 0;
+    o->state = n->state;
+    return 1;
+}
+
+static netsnmp_cache *
+make_cache(int merge)
+{
+    netsnmp_cache  *cache = netsnmp_cache_create(-1, load_rows, free_rows,
+                                                 NULL, 0);
+
+    if (cache == NULL)
+        return NULL;
+    cache->magic = netsnmp_container_find("cache_merge:table_container");
+    if (merge) {
+        cache->flags |= NETSNMP_CACHE_MERGE_ON_RELOAD;
+        cache->merge_row = merge_row;
+        cache->free_row = free_row;
+    }
+    return cache;
+}
+
+/*
+ * the cache has the rows that are present, with their state
+ */
+static int
+same_as_source(netsnmp_cache *cache)
+{
+    netsnmp_container *c = (netsnmp_container *) cache->magic;
+    row            *r;
+    int             i, n = 0;
+
+    for (i = 0; i < NSOURCE; i++) {
+        if (!present[i])
+            continue;
+        n++;
+        r = (row *) CONTAINER_FIND(c, &source[i]);
+        if (r == NULL || r->state != source[i].state)
+            return 0;
+    }
+    return n == (int) CONTAINER_SIZE(c);
+}
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_cache  *full, *merged, *dups;
+    netsnmp_container *c, *full_rows, *merged_rows;
+    netsnmp_cache_merge_stats stats;
+    struct timeval  start;
+    double          full_us = 0, merge_us = 0;
+    row            *kept, *r, key;
+    int             i, ok_full = 1, ok_merged = 1, ok_kept = 1, walked, missed, order;
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_ROLE,
+                           0);
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_agent("cache-merge-perf");
+    init_snmp("cache-merge-perf");
+    srandom(14);
+    make_source();
+
+    full = make_cache(0);
+    merged = make_cache(1);
+    OK(full && full->magic && merged && merged->magic, "caches created");
+    if (!full || !full->magic || !merged || !merged->magic)
+        return 1;
+    full_rows = (netsnmp_container *) full->magic;
+    merged_rows = (netsnmp_container *) merged->magic;
+
+    OK(netsnmp_cache_check_and_reload(full) >= 0 &&
+       netsnmp_cache_check_and_reload(merged) >= 0 &&
+       same_as_source(full) && same_as_source(merged),
+       "first load");
+    kept = (row *) CONTAINER_FIND(merged_rows, &source[0]);
+
+    /* the first lookup after a load sorts the rows, so time that too */
+    for (i = 0; i < RELOADS; i++) {
+        churn();
+        gettimeofday(&start, NULL);
+        if (netsnmp_cache_check_and_reload(full) < 0 ||
+            CONTAINER_FIND(full_rows, &source[0]) == NULL)
+            ok_full = 0;
+        full_us += perf_elapsed_us(&start);
+        gettimeofday(&start, NULL);
+        if (netsnmp_cache_check_and_reload(merged) < 0 ||
+            CONTAINER_FIND(merged_rows, &source[0]) != kept)
+            ok_kept = 0;
+        merge_us += perf_elapsed_us(&start);
+        if (!same_as_source(full))
+            ok_full = 0;
+        if (!same_as_source(merged))
+            ok_merged = 0;
+    }
+    OK(ok_full, "full reloads have the source rows");
+    OK(ok_merged, "merged reloads have the source rows");
+    netsnmp_cache_get_merge_stats(merged, &stats);
+    OKF(stats.rows_inserted == RELOADS * CHURN &&
+        stats.rows_deleted == RELOADS * CHURN &&
+        stats.rows_updated <= RELOADS * CHURN &&
+        stats.rows_updated >= RELOADS * CHURN * 9 / 10 &&
+        stats.rows_updated + stats.rows_unchanged ==
+        RELOADS * (NROWS - CHURN),
+        ("changes counted: %lu new, %lu updated, %lu gone, %lu unchanged",
+         stats.rows_inserted, stats.rows_updated, stats.rows_deleted,
+         stats.rows_unchanged));
+    OK(ok_kept, "merged reloads keep the rows that are still there");
+    PERF_FASTER(merge_us / RELOADS, "merged reload", full_us / RELOADS,
+                "full reload");
+
+    /*
+     * walk the merged cache with find_next from the index of the last
+     * row, as GETNEXT does, reloading it as we go; the rows of the first
+     * quarter never change, so each must be found.
+     */
+    c = (netsnmp_container *) merged->magic;
+    walked = missed = 0;
+    order = 1;
+    memset(&key, 0, sizeof(key));
+    for (r = (row *) CONTAINER_FIRST(c); r;
+         r = (row *) CONTAINER_NEXT(c, &key)) {
+        if (walked && c->compare(&key, r) >= 0)
+            order = 0;
+        i = (r->oids[6] - 1024) * 1792 + r->oids[4] * 7 + r->oids[3];
+        if (i < NROWS / 4)
+            seen[i] = 1;
+        key = *r;
+        key.index.oids = key.oids;
+        if (++walked % WALK_STEP == 0) {
+            churn();
+            if (netsnmp_cache_check_and_reload(merged) < 0)
+                order = 0;
+        }
+    }
+    for (i = 0; i < NROWS / 4; i++)
+        if (!seen[i])
+            missed++;
+    OKF(order && missed == 0 && same_as_source(merged),
+        ("walk through %d reloads: %d rows, in order, %d unchanged rows "
+         "missed", walked / WALK_STEP, walked, missed));
+
+    /*
+     * without a merge_row routine every row is replaced, once, by the
+     * first of its two copies
+     */
+    dups = make_cache(1);
+    if (dups && dups->magic) {
+        dups->merge_row = NULL;
+        netsnmp_cache_check_and_reload(dups);
+        duplicates = 1;
+        i = netsnmp_cache_check_and_reload(dups);
+        duplicates = 0;
+        netsnmp_cache_get_merge_stats(dups, &stats);
+    }
+    OKF(dups && dups->magic && i >= 0 && same_as_source(dups) &&
+        stats.rows_inserted == 0 && stats.rows_deleted == 0 &&
+        stats.rows_updated == CONTAINER_SIZE((netsnmp_container *)
+                                             dups->magic),
+        ("reload with every row twice: %lu new, %lu updated, %lu gone",
+         stats.rows_inserted, stats.rows_updated, stats.rows_deleted));
+
+    netsnmp_cache_free(full);
+    netsnmp_cache_free(merged);
+    CONTAINER_FREE(full_rows);
+    CONTAINER_FREE(c);
+    if (dups) {
+        c = (netsnmp_container *) dups->magic;
+        netsnmp_cache_free(dups);
+        CONTAINER_FREE(c);
+    }
+    snmp_shutdown("cache-merge-perf");
+    shutdown_agent();
+
+    PLAN(__test_counter);
+    return 0;
+}
@@ -0,0 +1,265 @@
+/*
+ * HEADER loading the TCP and UDP tables over sock_diag and from /proc
+ *
+ * Opens 3000 loopback TCP connections and 1000 UDP sockets, and loads
+ * the tcpConnectionTable and udpEndpointTable data over a netlink
+ * sock_diag socket and from /proc/net.  Both must find the same
+ * connections and endpoints, in the same states and owned by this
+ * process; the listen flags must be applied by the kernel, and the
+ * netlink load must be the faster one.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/data_access/tcpConn.h>
+#include <net-snmp/data_access/udp_endpoint.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "perftest.h"
+
+#define NCONN           3000
+#define NUDP            1000
+#define LOADS           5
+
+typedef struct key_s {
+    u_char          loc_addr[16];
+    u_char          rmt_addr[16];
+    u_short         loc_port;
+    u_short         rmt_port;
+    u_int           state;
+    u_int           pid;
+    u_int           instance;
+} key;
+
+static u_short  listen_port;
+static char     udp_port[65536];
+static key      tcp_keys[2][2 * NCONN + 1];
+static key      udp_keys[2][NUDP];
+
+static int
+compare_keys(const void *a, const void *b)
+{
+    return memcmp(a, b, sizeof(key));
+}
+
+/*
+ * a listener, and NCONN connections to it with both ends open
+ */
+static int
+open_tcp(void)
+{
+    struct sockaddr_in sa;
+    socklen_t       len = sizeof(sa);
+    int             l, c, a, i;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    l = socket(AF_INET, SOCK_STREAM, 0);
+    if (l < 0 || bind(l, (struct sockaddr *) &sa, sizeof(sa)) < 0 ||
+        listen(l, 128) < 0 ||
+        getsockname(l, (struct sockaddr *) &sa, &len) < 0)
+        return -1;
+    listen_port = ntohs(sa.sin_port);
+    for (i = 0; i < NCONN; i++) {
+        c = socket(AF_INET, SOCK_STREAM, 0);
+        if (c < 0 || connect(c, (struct sockaddr *) &sa, sizeof(sa)) < 0)
+            return -1;
+        a = accept(l, NULL, NULL);
+        if (a < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/*
+ * NUDP sockets, every other one connected
+ */
+static int
+open_udp(void)
+{
+    struct sockaddr_in sa, peer;
+    socklen_t       len;
+    int             s, i;
+
+    memset(&peer, 0, sizeof(peer));
+    peer.sin_family = AF_INET;
+    peer.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    peer.sin_port = htons(9);
+    for (i = 0; i < NUDP; i++) {
+        memset(&sa, 0, sizeof(sa));
+        sa.sin_family = AF_INET;
+        sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        len = sizeof(sa);
+        s = socket(AF_INET, SOCK_DGRAM, 0);
+        if (s < 0 || bind(s, (struct sockaddr *) &sa, sizeof(sa)) < 0 ||
+            (i % 2 && connect(s, (struct sockaddr *) &peer,
+                              sizeof(peer)) < 0) ||
+            getsockname(s, (struct sockaddr *) &sa, &len) < 0)
+            return -1;
+        udp_port[ntohs(sa.sin_port)] = 1;
+    }
+    return 0;
+}
+
+/*
+ * load the tcp connections, and sort ours into keys; returns how many
+ * of ours there are, or -1 if one isn't owned by this process
+ */
+static int
+load_tcp(int proc, u_int flags, key *keys, double *usec)
+{
+    netsnmp_container *c;
+    netsnmp_iterator *it;
+    netsnmp_tcpconn_entry *e;
+    struct timeval  start;
+    int             n = 0, bad = 0;
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID,
+                           NETSNMP_DS_AGENT_NO_SOCK_DIAG, proc);
+    gettimeofday(&start, NULL);
+    c = netsnmp_access_tcpconn_container_load(NULL, flags);
+    if (usec)
+        *usec += perf_elapsed_us(&start);
+    if (c == NULL)
+        return -1;
+
+    it = CONTAINER_ITERATOR(c);
+    for (e = ITERATOR_FIRST(it); e; e = ITERATOR_NEXT(it)) {
+        if (e->loc_port != listen_port && e->rmt_port != listen_port)
+            continue;
+        if (n == 2 * NCONN + 1 || e->loc_addr_len != 4 ||
+            e->pid != (u_int) getpid()) {
+            bad = 1;
+            break;
+        }
+        if (keys) {
+            memset(&keys[n], 0, sizeof(key));
+            memcpy(keys[n].loc_addr, e->loc_addr, 4);
+            memcpy(keys[n].rmt_addr, e->rmt_addr, 4);
+            keys[n].loc_port = e->loc_port;
+            keys[n].rmt_port = e->rmt_port;
+            keys[n].state = e->tcpConnState;
+            keys[n].pid = e->pid;
+        }
+        n++;
+    }
+    ITERATOR_RELEASE(it);
+    netsnmp_access_tcpconn_container_free(c,
+                                          NETSNMP_ACCESS_TCPCONN_FREE_NOFLAGS);
+    if (keys)
+        qsort(keys, n, sizeof(key), compare_keys);
+    return bad ? -1 : n;
+}
+
+static int
+load_udp(int proc, key *keys, double *usec)
+{
+    netsnmp_container *c;
+    netsnmp_iterator *it;
+    netsnmp_udp_endpoint_entry *e;
+    struct timeval  start;
+    int             n = 0, bad = 0;
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID,
+                           NETSNMP_DS_AGENT_NO_SOCK_DIAG, proc);
+    gettimeofday(&start, NULL);
+    c = netsnmp_access_udp_endpoint_container_load(NULL,
+                                    NETSNMP_ACCESS_UDP_ENDPOINT_LOAD_NOFLAGS);
+    *usec += perf_elapsed_us(&start);
+    if (c == NULL)
+        return -1;
+
+    it = CONTAINER_ITERATOR(c);
+    for (e = ITERATOR_FIRST(it); e; e = ITERATOR_NEXT(it)) {
+        if (e->loc_addr_len != 4 || e->loc_addr[0] != 127 ||
+            !udp_port[e->loc_port])
+            continue;
+        if (n == NUDP || e->pid != (u_int) getpid()) {
+            bad = 1;
+            break;
+        }
+        memset(&keys[n], 0, sizeof(key));
+        memcpy(keys[n].loc_addr, e->loc_addr, 4);
+        memcpy(keys[n].rmt_addr, e->rmt_addr, 4);
+        keys[n].loc_port = e->loc_port;
+        keys[n].rmt_port = e->rmt_port;
+        keys[n].state = e->state;
+        keys[n].pid = e->pid;
+        keys[n].instance = e->instance;
+        n++;
+    }
+    ITERATOR_RELEASE(it);
+    netsnmp_access_udp_endpoint_container_free(c,
+                                    NETSNMP_ACCESS_UDP_ENDPOINT_FREE_NOFLAGS);
+    qsort(keys, n, sizeof(key), compare_keys);
+    return bad ? -1 : n;
+}
+
+int
+main(int argc, char *argv[])
+{
+    double          tcp_us[2] = { 0, 0 }, udp_us[2] = { 0, 0 };
+    int             i, mode, ntcp[2], nudp[2], ok_tcp = 1, ok_udp = 1;
+
+#ifndef HAVE_LINUX_SOCK_DIAG_H
+    printf("1..0 # SKIP no linux sock_diag support\n");
+    return 0;
+#endif
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_ROLE,
+                           0);
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_agent("sock-diag-perf");
+    init_snmp("sock-diag-perf");
+
+    OK(open_tcp() == 0, "tcp connections opened");
+    OK(open_udp() == 0, "udp sockets opened");
+
+    /* the first load of each scans /proc for the socket owners */
+    for (i = 0; i < LOADS + 1; i++) {
+        for (mode = 0; mode < 2; mode++) {
+            ntcp[mode] = load_tcp(mode, NETSNMP_ACCESS_TCPCONN_LOAD_NOFLAGS,
+                                  tcp_keys[mode], i ? &tcp_us[mode] : NULL);
+            nudp[mode] = load_udp(mode, udp_keys[mode], &udp_us[mode]);
+            if (i == 0)
+                udp_us[mode] = 0;
+        }
+        if (ntcp[0] != 2 * NCONN + 1 || ntcp[1] != ntcp[0] ||
+            memcmp(tcp_keys[0], tcp_keys[1], ntcp[0] * sizeof(key)))
+            ok_tcp = 0;
+        if (nudp[0] != NUDP || nudp[1] != nudp[0] ||
+            memcmp(udp_keys[0], udp_keys[1], nudp[0] * sizeof(key)))
+            ok_udp = 0;
+    }
+    OKF(ok_tcp, ("sock_diag and /proc have the same %d tcp connections",
+                 ntcp[0]));
+    OKF(ok_udp, ("sock_diag and /proc have the same %d udp endpoints",
+                 nudp[0]));
+
+    OK(load_tcp(0, NETSNMP_ACCESS_TCPCONN_LOAD_ONLYLISTEN, NULL, NULL) == 1 &&
+       load_tcp(0, NETSNMP_ACCESS_TCPCONN_LOAD_NOLISTEN, NULL, NULL) ==
+       2 * NCONN, "sock_diag loads only or no listeners");
+
+    PERF_FASTER(tcp_us[0] / LOADS, "tcp load over sock_diag",
+                tcp_us[1] / LOADS, "from /proc");
+    PERF_FASTER(udp_us[0] / LOADS, "udp load over sock_diag",
+                udp_us[1] / LOADS, "from /proc");
+
+    snmp_shutdown("sock-diag-perf");
+    shutdown_agent();
+
+    PLAN(__test_counter);
+    return 0;
+}
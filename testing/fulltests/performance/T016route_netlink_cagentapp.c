@@ -0,0 +1,278 @@
+/*
+ * HEADER loading 200000 routes over netlink and from /proc
+ *
+ * In a network namespace of its own, adds 200000 IPv4 routes to the
+ * main table, some through a gateway, and a few more to a policy
+ * routing table, then loads the route data access container with a
+ * netlink route dump and from /proc/net/route.  Both must have the same
+ * main table routes; netlink must also have the policy routes and must
+ * be the faster one, and the route monitor must see a route change.
+ * Build with -DNROUTES=1000000 for a full BGP table sized run.
+ */
+
+#define _GNU_SOURCE
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/data_access/route.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/time.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#ifdef HAVE_LINUX_RTNETLINK_H
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#endif
+#include "perftest.h"
+
+#ifndef NROUTES
+#define NROUTES         200000
+#endif
+#define NPOLICY         100
+#define POLICY_TABLE    100
+#define LOADS           3
+
+int             netsnmp_access_route_monitor_start(void);
+u_long          netsnmp_access_route_monitor_generation(void);
+
+typedef struct key_s {
+    u_char          dest[4];
+    u_char          nexthop[4];
+    oid             if_index;
+    int32_t         metric;
+    u_char          pfx_len;
+    u_char          type;
+    u_char          proto;
+} key;
+
+static key     *keys[2];
+
+static int
+compare_keys(const void *a, const void *b)
+{
+    return memcmp(a, b, sizeof(key));
+}
+
+#ifdef HAVE_LINUX_RTNETLINK_H
+static void
+add_attr(struct nlmsghdr *h, int type, const void *data, int len)
+{
+    struct rtattr  *rta = (struct rtattr *) ((char *) h +
+                                             NLMSG_ALIGN(h->nlmsg_len));
+
+    rta->rta_type = type;
+    rta->rta_len = RTA_LENGTH(len);
+    memcpy(RTA_DATA(rta), data, len);
+    h->nlmsg_len = NLMSG_ALIGN(h->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+}
+
+/*
+ * add routes 10.0.0.0 + first .. + n - 1 through lo, every 4th through
+ * a gateway, sending many requests at a time
+ */
+static int
+add_routes(int fd, int first, int n, uint32_t table)
+{
+    static char     buf[65536];
+    struct sockaddr_nl sa;
+    int             i, used = 0, lo = if_nametoindex("lo");
+    uint32_t        gateway = htonl(0xc0000209);        /* 192.0.2.9 */
+
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    for (i = first; i < first + n; i++) {
+        struct nlmsghdr *h = (struct nlmsghdr *) (buf + used);
+        struct rtmsg   *rtm = (struct rtmsg *) NLMSG_DATA(h);
+        uint32_t        dest = htonl(0x0a000000 + i);
+
+        memset(h, 0, 128);
+        h->nlmsg_len = NLMSG_LENGTH(sizeof(*rtm));
+        h->nlmsg_type = RTM_NEWROUTE;
+        h->nlmsg_flags = NLM_F_REQUEST | NLM_F_CREATE | NLM_F_EXCL;
+        rtm->rtm_family = AF_INET;
+        rtm->rtm_dst_len = 32;
+        rtm->rtm_table = RT_TABLE_UNSPEC;
+        rtm->rtm_protocol = RTPROT_BOOT;
+        rtm->rtm_scope = (i % 4) ? RT_SCOPE_LINK : RT_SCOPE_UNIVERSE;
+        rtm->rtm_type = RTN_UNICAST;
+        add_attr(h, RTA_TABLE, &table, 4);
+        add_attr(h, RTA_DST, &dest, 4);
+        add_attr(h, RTA_OIF, &lo, 4);
+        if (i % 4 == 0) {
+            rtm->rtm_flags = RTNH_F_ONLINK;
+            add_attr(h, RTA_GATEWAY, &gateway, 4);
+        }
+        used += NLMSG_ALIGN(h->nlmsg_len);
+        if (used > (int) sizeof(buf) - 128 || i == first + n - 1) {
+            if (sendto(fd, buf, used, 0, (struct sockaddr *) &sa,
+                       sizeof(sa)) != used)
+                return -1;
+            used = 0;
+        }
+    }
+    return 0;
+}
+
+/*
+ * a network namespace of our own, with lo up and the routes in it
+ */
+static int
+make_routes(void)
+{
+    struct ifreq    ifr;
+    int             s, fd, rc;
+
+    if (unshare(CLONE_NEWNET) < 0)
+        return -1;
+    s = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&ifr, 0, sizeof(ifr));
+    strcpy(ifr.ifr_name, "lo");
+    if (s < 0 || ioctl(s, SIOCGIFFLAGS, &ifr) < 0)
+        return -1;
+    ifr.ifr_flags |= IFF_UP;
+    rc = ioctl(s, SIOCSIFFLAGS, &ifr);
+    close(s);
+    if (rc < 0)
+        return -1;
+
+    fd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_ROUTE);
+    if (fd < 0)
+        return -1;
+    rc = add_routes(fd, 0, NROUTES, RT_TABLE_MAIN);
+    if (rc == 0)
+        rc = add_routes(fd, NROUTES, NPOLICY, POLICY_TABLE);
+    close(fd);
+    return rc;
+}
+#endif /* HAVE_LINUX_RTNETLINK_H */
+
+/*
+ * load the routes, and sort the main table's into keys; returns how
+ * many routes there are in all
+ */
+static int
+load_routes(int proc, key *k, int *nkeys, int *npolicy, double *usec)
+{
+    netsnmp_container *c;
+    netsnmp_iterator *it;
+    netsnmp_route_entry *e;
+    struct timeval  start;
+    int             n = 0;
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID,
+                           NETSNMP_DS_AGENT_NO_ROUTE_NETLINK, proc);
+    gettimeofday(&start, NULL);
+    c = netsnmp_access_route_container_load(NULL,
+                                     NETSNMP_ACCESS_ROUTE_LOAD_IPV4_ONLY);
+    *usec += perf_elapsed_us(&start);
+    if (c == NULL)
+        return -1;
+
+    *nkeys = *npolicy = 0;
+    it = CONTAINER_ITERATOR(c);
+    for (e = ITERATOR_FIRST(it); e; e = ITERATOR_NEXT(it), n++) {
+        if (e->rt_dest_len != 4)
+            continue;
+        if (e->rt_policy && e->rt_policy[1] == POLICY_TABLE) {
+            (*npolicy)++;
+            continue;
+        }
+        if (*nkeys == NROUTES + 16)
+            continue;
+        memset(&k[*nkeys], 0, sizeof(key));
+        memcpy(k[*nkeys].dest, e->rt_dest, 4);
+        memcpy(k[*nkeys].nexthop, e->rt_nexthop, 4);
+        k[*nkeys].if_index = e->if_index;
+        k[*nkeys].metric = e->rt_metric1;
+        k[*nkeys].pfx_len = e->rt_pfx_len;
+        k[*nkeys].type = e->rt_type;
+        k[*nkeys].proto = e->rt_proto;
+        (*nkeys)++;
+    }
+    ITERATOR_RELEASE(it);
+    netsnmp_access_route_container_free(c, NETSNMP_ACCESS_ROUTE_FREE_NOFLAGS);
+    qsort(k, *nkeys, sizeof(key), compare_keys);
+    return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+    double          us[2] = { 0, 0 };
+    int             i, mode, n[2], nkeys[2], npolicy[2], ok = 1;
+    u_long          generation;
+
+#ifndef HAVE_LINUX_RTNETLINK_H
+    printf("1..0 # SKIP no linux rtnetlink support\n");
+    return 0;
+#else
+    if (make_routes() < 0) {
+        printf("1..0 # SKIP can't add routes in a network namespace\n");
+        return 0;
+    }
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_ROLE,
+                           0);
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_agent("route-netlink-perf");
+    init_snmp("route-netlink-perf");
+    keys[0] = (key *) malloc((NROUTES + 16) * sizeof(key));
+    keys[1] = (key *) malloc((NROUTES + 16) * sizeof(key));
+    OK(keys[0] && keys[1], "routes added");
+    if (!keys[0] || !keys[1])
+        return 1;
+
+    for (i = 0; i < LOADS; i++) {
+        for (mode = 0; mode < 2; mode++)
+            n[mode] = load_routes(mode, keys[mode], &nkeys[mode],
+                                  &npolicy[mode], &us[mode]);
+        if (nkeys[0] < NROUTES || nkeys[1] != nkeys[0] ||
+            memcmp(keys[0], keys[1], nkeys[0] * sizeof(key)))
+            ok = 0;
+    }
+    OKF(ok, ("netlink and /proc have the same %d main table routes",
+             nkeys[0]));
+    OKF(npolicy[0] == NPOLICY && npolicy[1] == 0 && n[0] == n[1] + NPOLICY,
+        ("netlink has the %d policy routes too", npolicy[0]));
+
+    printf("# %d routes\n", n[1]);
+    PERF_FASTER(us[0] / LOADS, "route load over netlink", us[1] / LOADS,
+                "from /proc");
+
+    /*
+     * the monitor sees nothing until a route changes
+     */
+    OK(netsnmp_access_route_monitor_start() == 0 &&
+       (generation = netsnmp_access_route_monitor_generation()) != 0,
+       "route monitor started");
+    agent_check_and_process(0);
+    ok = netsnmp_access_route_monitor_generation() == generation;
+    i = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_ROUTE);
+    if (i < 0 || add_routes(i, NROUTES + NPOLICY, 1, RT_TABLE_MAIN) < 0)
+        ok = 0;
+    close(i);
+    for (mode = 0; mode < 10 &&
+         netsnmp_access_route_monitor_generation() == generation; mode++)
+        agent_check_and_process(0);
+    OK(ok && netsnmp_access_route_monitor_generation() != generation,
+       "route monitor sees a new route, and nothing else");
+
+    free(keys[0]);
+    free(keys[1]);
+    snmp_shutdown("route-netlink-perf");
+    shutdown_agent();
+
+    PLAN(__test_counter);
+    return 0;
+#endif
+}
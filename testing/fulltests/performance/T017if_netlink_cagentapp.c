@@ -0,0 +1,388 @@
+/*
+ * HEADER loading 2000 interfaces over netlink and from /proc
+ *
+ * In a network namespace of its own, adds 1000 veth pairs, some of them
+ * up and with an IPv4 address, then loads the interface data access
+ * container with a netlink link dump and from /proc/net/dev and ioctls.
+ * Both must find the same interfaces with the same data, and netlink must
+ * be the faster one.  The link monitor must then report a link which goes
+ * down and a pair which is deleted, and nothing else.
+ */
+
+#define _GNU_SOURCE
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/data_access/interface.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#ifdef HAVE_LINUX_RTNETLINK_H
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#endif
+#include "perftest.h"
+
+#ifndef VETH_INFO_PEER
+#define VETH_INFO_PEER  1
+#endif
+
+#define NPAIRS          1000
+#define LOADS           3
+
+typedef void    (netsnmp_access_interface_monitor_callback)
+                (netsnmp_container *changed, netsnmp_container *removed);
+int             netsnmp_access_interface_monitor_start(netsnmp_access_interface_monitor_callback *callback);
+
+typedef struct key_s {
+    oid             index;
+    char            name[IFNAMSIZ];
+    u_char          paddr[6];
+    int             type;
+    u_int           mtu;
+    u_int           os_flags;
+    u_int           ns_flags;
+    u_int           speed;
+    u_int           speed_high;
+    u_int           retransmit_v4;
+    char            admin_status;
+    char            oper_status;
+    char            connector_present;
+    char            promiscuous;
+    netsnmp_interface_stats stats;
+} key;
+
+static key      keys[2][2 * NPAIRS + 2];
+
+static int
+compare_keys(const void *a, const void *b)
+{
+    return memcmp(a, b, sizeof(key));
+}
+
+#ifdef HAVE_LINUX_RTNETLINK_H
+static struct rtattr *
+add_attr(struct nlmsghdr *h, int type, const void *data, int len)
+{
+    struct rtattr  *rta = (struct rtattr *) ((char *) h +
+                                             NLMSG_ALIGN(h->nlmsg_len));
+
+    rta->rta_type = type;
+    rta->rta_len = RTA_LENGTH(len);
+    if (data)
+        memcpy(RTA_DATA(rta), data, len);
+    h->nlmsg_len = NLMSG_ALIGN(h->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+    return rta;
+}
+
+static void
+end_nest(struct nlmsghdr *h, struct rtattr *nest)
+{
+    nest->rta_len = (char *) h + h->nlmsg_len - (char *) nest;
+}
+
+static int
+send_request(int fd, struct nlmsghdr *h)
+{
+    struct sockaddr_nl sa;
+    char            buf[4096];
+    struct nlmsghdr *r = (struct nlmsghdr *) buf;
+    int             len;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    h->nlmsg_flags |= NLM_F_REQUEST | NLM_F_ACK;
+    if (sendto(fd, h, h->nlmsg_len, 0, (struct sockaddr *) &sa,
+               sizeof(sa)) != (int) h->nlmsg_len)
+        return -1;
+    len = recv(fd, buf, sizeof(buf), 0);
+    if (len < (int) NLMSG_LENGTH(sizeof(struct nlmsgerr)) ||
+        NLMSG_ERROR != r->nlmsg_type)
+        return -1;
+    return ((struct nlmsgerr *) NLMSG_DATA(r))->error ? -1 : 0;
+}
+
+/*
+ * veth pair va<i> / vb<i>
+ */
+static int
+add_pair(int fd, int i)
+{
+    char            buf[1024], name[IFNAMSIZ];
+    struct nlmsghdr *h = (struct nlmsghdr *) buf;
+    struct ifinfomsg *ifi = (struct ifinfomsg *) NLMSG_DATA(h), *peer;
+    struct rtattr  *linkinfo, *data, *info_peer;
+
+    memset(buf, 0, sizeof(buf));
+    h->nlmsg_len = NLMSG_LENGTH(sizeof(*ifi));
+    h->nlmsg_type = RTM_NEWLINK;
+    h->nlmsg_flags = NLM_F_CREATE | NLM_F_EXCL;
+    ifi->ifi_family = AF_UNSPEC;
+    snprintf(name, sizeof(name), "va%d", i);
+    add_attr(h, IFLA_IFNAME, name, strlen(name) + 1);
+    linkinfo = add_attr(h, IFLA_LINKINFO, NULL, 0);
+    add_attr(h, IFLA_INFO_KIND, "veth", 4);
+    data = add_attr(h, IFLA_INFO_DATA, NULL, 0);
+    info_peer = add_attr(h, VETH_INFO_PEER, NULL, sizeof(*peer));
+    peer = (struct ifinfomsg *) RTA_DATA(info_peer);
+    peer->ifi_family = AF_UNSPEC;
+    snprintf(name, sizeof(name), "vb%d", i);
+    add_attr(h, IFLA_IFNAME, name, strlen(name) + 1);
+    end_nest(h, info_peer);
+    end_nest(h, data);
+    end_nest(h, linkinfo);
+    return send_request(fd, h);
+}
+
+static int
+add_address(int fd, int i)
+{
+    char            buf[256], name[IFNAMSIZ];
+    struct nlmsghdr *h = (struct nlmsghdr *) buf;
+    struct ifaddrmsg *ifa = (struct ifaddrmsg *) NLMSG_DATA(h);
+    uint32_t        addr = htonl(0x0a000000 + i);
+
+    memset(buf, 0, sizeof(buf));
+    snprintf(name, sizeof(name), "va%d", i);
+    h->nlmsg_len = NLMSG_LENGTH(sizeof(*ifa));
+    h->nlmsg_type = RTM_NEWADDR;
+    h->nlmsg_flags = NLM_F_CREATE | NLM_F_EXCL;
+    ifa->ifa_family = AF_INET;
+    ifa->ifa_prefixlen = 32;
+    ifa->ifa_index = if_nametoindex(name);
+    add_attr(h, IFA_LOCAL, &addr, 4);
+    add_attr(h, IFA_ADDRESS, &addr, 4);
+    return send_request(fd, h);
+}
+
+static int
+change_link(int fd, const char *name, int type, u_int flags)
+{
+    char            buf[256];
+    struct nlmsghdr *h = (struct nlmsghdr *) buf;
+    struct ifinfomsg *ifi = (struct ifinfomsg *) NLMSG_DATA(h);
+
+    memset(buf, 0, sizeof(buf));
+    h->nlmsg_len = NLMSG_LENGTH(sizeof(*ifi));
+    h->nlmsg_type = type;
+    ifi->ifi_family = AF_UNSPEC;
+    ifi->ifi_index = if_nametoindex(name);
+    ifi->ifi_change = IFF_UP;
+    ifi->ifi_flags = flags;
+    return send_request(fd, h);
+}
+
+/*
+ * a network namespace of our own, without ipv6 (whose neighbour
+ * discovery would change the counters between loads), with lo up and
+ * the veth pairs in it: every other one up, and every fourth with an
+ * address.
+ */
+static int
+make_interfaces(void)
+{
+    char            name[IFNAMSIZ];
+    int             fd, i, rc = 0;
+
+    if (unshare(CLONE_NEWNET) < 0)
+        return -1;
+    fd = open("/proc/sys/net/ipv6/conf/default/disable_ipv6", O_WRONLY);
+    if (fd >= 0) {
+        rc = write(fd, "1\n", 2);
+        close(fd);
+    }
+
+    fd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_ROUTE);
+    if (fd < 0 || change_link(fd, "lo", RTM_NEWLINK, IFF_UP) < 0)
+        return -1;
+    for (i = 0; i < NPAIRS && rc >= 0; i++) {
+        rc = add_pair(fd, i);
+        if (rc == 0 && i % 2 == 0) {
+            snprintf(name, sizeof(name), "va%d", i);
+            rc = change_link(fd, name, RTM_NEWLINK, IFF_UP);
+            name[1] = 'b';
+            if (rc == 0)
+                rc = change_link(fd, name, RTM_NEWLINK, IFF_UP);
+        }
+        if (rc == 0 && i % 4 == 0)
+            rc = add_address(fd, i);
+    }
+    close(fd);
+    return rc < 0 ? -1 : 0;
+}
+#endif /* HAVE_LINUX_RTNETLINK_H */
+
+/*
+ * load the interfaces, and sort them into keys; returns how many
+ * there are
+ */
+static int
+load_interfaces(int proc, key *k, double *usec)
+{
+    netsnmp_container *c;
+    netsnmp_iterator *it;
+    netsnmp_interface_entry *e;
+    struct timeval  start;
+    int             n = 0;
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID,
+                           NETSNMP_DS_AGENT_NO_INTERFACE_NETLINK, proc);
+    gettimeofday(&start, NULL);
+    c = netsnmp_access_interface_container_load(NULL,
+                                     NETSNMP_ACCESS_INTERFACE_LOAD_NOFLAGS);
+    *usec += perf_elapsed_us(&start);
+    if (c == NULL)
+        return -1;
+
+    it = CONTAINER_ITERATOR(c);
+    for (e = ITERATOR_FIRST(it); e && n < 2 * NPAIRS + 2;
+         e = ITERATOR_NEXT(it), n++) {
+        memset(&k[n], 0, sizeof(key));
+        k[n].index = e->index;
+        strlcpy(k[n].name, e->name, sizeof(k[n].name));
+        if (e->paddr && e->paddr_len == 6)
+            memcpy(k[n].paddr, e->paddr, 6);
+        k[n].type = e->type;
+        k[n].mtu = e->mtu;
+        k[n].os_flags = e->os_flags;
+        k[n].ns_flags = e->ns_flags;
+        k[n].speed = e->speed;
+        k[n].speed_high = e->speed_high;
+        k[n].retransmit_v4 = e->retransmit_v4;
+        k[n].admin_status = e->admin_status;
+        k[n].oper_status = e->oper_status;
+        k[n].connector_present = e->connector_present;
+        k[n].promiscuous = e->promiscuous;
+        k[n].stats = e->stats;
+    }
+    ITERATOR_RELEASE(it);
+    netsnmp_access_interface_container_free(c,
+                                    NETSNMP_ACCESS_INTERFACE_FREE_NOFLAGS);
+    qsort(k, n, sizeof(key), compare_keys);
+    return n;
+}
+
+static void
+free_entry(void *e, void *context)
+{
+    netsnmp_access_interface_entry_free((netsnmp_interface_entry *) e);
+}
+
+static int      monitor_calls, monitor_lost;
+static oid      down_index, peer_index, gone_index[2];
+static int      saw_down, saw_gone, saw_other;
+
+static void
+monitor_callback(netsnmp_container *changed, netsnmp_container *removed)
+{
+    netsnmp_iterator *it;
+    netsnmp_interface_entry *e;
+
+    monitor_calls++;
+    if (NULL == changed) {
+        monitor_lost++;
+        return;
+    }
+    it = CONTAINER_ITERATOR(changed);
+    for (e = ITERATOR_FIRST(it); e; e = ITERATOR_NEXT(it)) {
+        if (e->index == down_index && e->admin_status == IFADMINSTATUS_DOWN &&
+            e->oper_status == IFOPERSTATUS_DOWN)
+            saw_down = 1;
+        else if (e->index != gone_index[0] && e->index != gone_index[1] &&
+                 e->index != peer_index)
+            saw_other++;
+    }
+    ITERATOR_RELEASE(it);
+    CONTAINER_CLEAR(changed, free_entry, NULL);
+
+    it = CONTAINER_ITERATOR(removed);
+    for (e = ITERATOR_FIRST(it); e; e = ITERATOR_NEXT(it)) {
+        if (e->index == gone_index[0] || e->index == gone_index[1])
+            saw_gone++;
+        else
+            saw_other++;
+    }
+    ITERATOR_RELEASE(it);
+}
+
+int
+main(int argc, char *argv[])
+{
+    double          us[2] = { 0, 0 };
+    int             i, mode, n[2], ok = 1, fd;
+
+#ifndef HAVE_LINUX_RTNETLINK_H
+    printf("1..0 # SKIP no linux rtnetlink support\n");
+    return 0;
+#else
+    if (make_interfaces() < 0) {
+        printf("1..0 # SKIP can't add veth pairs in a network namespace\n");
+        return 0;
+    }
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_ROLE,
+                           0);
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_agent("if-netlink-perf");
+    init_snmp("if-netlink-perf");
+    netsnmp_access_interface_init();
+    OK(1, "interfaces added");
+
+    for (i = 0; i < LOADS; i++) {
+        for (mode = 0; mode < 2; mode++)
+            n[mode] = load_interfaces(mode, keys[mode], &us[mode]);
+        if (n[0] != 2 * NPAIRS + 1 || n[1] != n[0] ||
+            memcmp(keys[0], keys[1], n[0] * sizeof(key)))
+            ok = 0;
+    }
+    OKF(ok, ("netlink and /proc have the same %d interfaces", n[0]));
+    for (i = 0, mode = 0; i < n[0]; i++)
+        if (keys[0][i].ns_flags & NETSNMP_INTERFACE_FLAGS_HAS_IPV4)
+            mode++;
+    OKF(mode == NPAIRS / 4 + 1, ("lo and %d veths have an IPv4 address",
+                                 mode - 1));
+
+    printf("# %d interfaces\n", n[1]);
+    PERF_FASTER(us[0] / LOADS, "interface load over netlink", us[1] / LOADS,
+                "from /proc");
+
+    /*
+     * the monitor sees nothing until a link changes
+     */
+    OK(netsnmp_access_interface_monitor_start(monitor_callback) == 0,
+       "link monitor started");
+    agent_check_and_process(0);
+    ok = monitor_calls == 0;
+    down_index = if_nametoindex("va0");
+    peer_index = if_nametoindex("vb0");
+    gone_index[0] = if_nametoindex("va2");
+    gone_index[1] = if_nametoindex("vb2");
+    fd = socket(PF_NETLINK, SOCK_DGRAM, NETLINK_ROUTE);
+    if (fd < 0 || change_link(fd, "va0", RTM_NEWLINK, 0) < 0 ||
+        change_link(fd, "va2", RTM_DELLINK, 0) < 0)
+        ok = 0;
+    close(fd);
+    for (i = 0; i < 10 && !(saw_down && saw_gone == 2); i++)
+        agent_check_and_process(0);
+    OKF(ok && saw_down && saw_gone == 2 && !saw_other && !monitor_lost,
+        ("link monitor sees a link go down and a pair removed (%d calls)",
+         monitor_calls));
+
+    snmp_shutdown("if-netlink-perf");
+    shutdown_agent();
+
+    PLAN(__test_counter);
+    return 0;
+#endif
+}
@@ -0,0 +1,470 @@
+/*
+ * HEADER pass_persist and extend helpers answering in the background
+ *
+ * Runs an in-process agent with several pass_persist helpers and extend
+ * commands that take SLOW_US to answer, and sends requests for all of
+ * them at once, with a request for an ordinary scalar.  The scalar must
+ * be answered straight away, and the slow requests must be answered in
+ * about the time one of them takes, not the time they take one after
+ * the other.  A helper that never answers must be killed at its -t
+ * timeout, more requests than its pipe holds for a helper that isn't
+ * reading yet must not hold the agent up, an extend result must be
+ * refreshed before it expires when extend_refresh is set, and walks and
+ * SETs must still work, also with the helper's pipes above FD_SETSIZE.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "perftest.h"
+
+#define HELPERS         4
+#define SLOW_US         300000
+#define SLOW            "0.3"
+#define BIG_GET         60      /* varbinds, > 64k of requests to a helper */
+
+void            init_pass_persist(void);
+void            init_extend(void);
+
+static oid      pass_oid[] = { 1, 3, 6, 1, 4, 1, 8072, 9999, 0, 0 };
+static oid      fast_oid[] = { 1, 3, 6, 1, 4, 1, 8072, 9998, 0 };
+static oid      extend_oid[] = { 1, 3, 6, 1, 4, 1, 8072, 1, 3, 2 };
+static int      fast_value = 42;
+static char     dir[] = "/tmp/async-helpersXXXXXX";
+
+struct answer {
+    struct timeval  start;
+    double          usec;
+    int             done;
+    int             status;
+    netsnmp_variable_list *vars;
+};
+
+/*
+ * a pass_persist helper that answers GETs with its second argument,
+ * after sleeping for its first; "hang" never answers them, and "lazy"
+ * as the third waits before reading anything
+ */
+static int
+write_helper(void)
+{
+    char            path[sizeof(dir) + 16];
+    FILE           *f;
+
+    snprintf(path, sizeof(path), "%s/helper", dir);
+    f = fopen(path, "w");
+    if (f == NULL)
+        return -1;
+    fprintf(f, "#!/bin/sh\n"
+            "[ \"$3\" = lazy ] && sleep 0.5\n"
+            "while read cmd; do\n"
+            "    case \"$cmd\" in\n"
+            "    PING) echo PONG ;;\n"
+            "    get) read oid\n"
+            "        [ \"$1\" = hang ] && continue\n"
+            "        sleep $1; echo \"$oid\"; echo integer; echo $2 ;;\n"
+            "    getnext) read oid; echo NONE ;;\n"
+            "    set) read oid; read value; echo DONE ;;\n"
+            "    esac\n"
+            "done\n");
+    fclose(f);
+    return chmod(path, 0755);
+}
+
+static void
+agent_config(const char *fmt, ...)
+{
+    char            line[512];
+    va_list         ap;
+
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    netsnmp_config(line);
+}
+
+static int
+response(int op, netsnmp_session *session, int reqid, netsnmp_pdu *pdu,
+         void *magic)
+{
+    struct answer  *a = (struct answer *) magic;
+
+    a->usec = perf_elapsed_us(&a->start);
+    a->done = 1;
+    if (op == NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE) {
+        a->status = pdu->errstat;
+        a->vars = snmp_clone_varbind(pdu->variables);
+    } else
+        a->status = -1;
+    return 1;
+}
+
+static void
+send_request(netsnmp_session *ss, int type, const oid *name, size_t len,
+             struct answer *a)
+{
+    netsnmp_pdu    *pdu = snmp_pdu_create(type);
+
+    if (type == SNMP_MSG_GETBULK) {
+        pdu->non_repeaters = 0;
+        pdu->max_repetitions = HELPERS;
+    }
+    if (type == SNMP_MSG_SET)
+        snmp_pdu_add_variable(pdu, name, len, ASN_INTEGER, &fast_value,
+                              sizeof(fast_value));
+    else
+        snmp_add_null_var(pdu, name, len);
+    memset(a, 0, sizeof(*a));
+    gettimeofday(&a->start, NULL);
+    if (snmp_async_send(ss, pdu, response, a) == 0) {
+        snmp_free_pdu(pdu);
+        a->done = 1;
+        a->status = -1;
+    }
+}
+
+static void
+wait_for(struct answer *a, int n)
+{
+    struct timeval  start;
+    int             i;
+
+    gettimeofday(&start, NULL);
+    for (;;) {
+        for (i = 0; i < n && a[i].done; i++)
+            ;
+        if (i == n || perf_elapsed_us(&start) > 10e6)
+            return;
+        agent_check_and_process(1);
+    }
+}
+
+static void
+serve_for(double usec)
+{
+    struct timeval  start;
+
+    gettimeofday(&start, NULL);
+    while (perf_elapsed_us(&start) < usec)
+        agent_check_and_process(0), usleep(10000);
+}
+
+static void
+free_answers(struct answer *a, int n)
+{
+    int             i;
+
+    for (i = 0; i < n; i++)
+        snmp_free_varbind(a[i].vars);
+}
+
+static int
+is_integer(const struct answer *a, long value)
+{
+    return a->done && a->status == 0 && a->vars &&
+        a->vars->type == ASN_INTEGER && *a->vars->val.integer == value;
+}
+
+static int
+is_string(const struct answer *a, const char *value)
+{
+    return a->done && a->status == 0 && a->vars &&
+        a->vars->type == ASN_OCTET_STR &&
+        a->vars->val_len == strlen(value) &&
+        memcmp(a->vars->val.string, value, a->vars->val_len) == 0;
+}
+
+/* nsExtendOutput1Line."name" */
+static size_t
+extend_line_oid(oid *name, const char *token)
+{
+    size_t          len = OID_LENGTH(extend_oid), i;
+
+    memcpy(name, extend_oid, sizeof(extend_oid));
+    name[len++] = 3;
+    name[len++] = 1;
+    name[len++] = 1;
+    name[len++] = strlen(token);
+    for (i = 0; token[i]; i++)
+        name[len++] = (u_char) token[i];
+    return len;
+}
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_session session, *ss;
+    netsnmp_transport *t;
+    struct sockaddr_in addr;
+    socklen_t       addrlen = sizeof(addr);
+    struct answer   a[HELPERS + 1], b[1];
+    netsnmp_pdu    *pdu;
+    netsnmp_variable_list *v;
+    oid             name[MAX_OID_LEN];
+    char            peer[64], token[16], first[64];
+    size_t          len;
+    double          slowest;
+    struct rlimit   rl;
+    static int      fill[FD_SETSIZE];
+    int             i, ok, nfill;
+
+    if (mkdtemp(dir) == NULL || write_helper() < 0) {
+        printf("1..0 # SKIP can't write the helper script\n");
+        return 0;
+    }
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_ROLE,
+                           0);
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_agent("async-helpers-perf");
+    init_pass_persist();
+    init_extend();
+    agent_config("rwcommunity public 127.0.0.1");
+    for (i = 0; i < HELPERS; i++)
+        agent_config("pass_persist .1.3.6.1.4.1.8072.9999.%d %s/helper "
+                     SLOW " %d", i, dir, i);
+    agent_config("pass_persist -t 1 .1.3.6.1.4.1.8072.9999.%d %s/helper "
+                 "hang 0", HELPERS, dir);
+    agent_config("pass_persist .1.3.6.1.4.1.8072.9999.%d %s/helper "
+                 "0 7 lazy", HELPERS + 1, dir);
+    agent_config("pass_persist .1.3.6.1.4.1.8072.9999.%d %s/helper 0 8",
+                 HELPERS + 2, dir);
+    for (i = 0; i < HELPERS; i++)
+        agent_config("extend-sh -cacheTime 60 slow%d sleep " SLOW
+                     "; echo slow%d", i, i);
+    agent_config("extend-sh -cacheTime 2 stamp sleep " SLOW
+                 "; date +%%s.%%N");
+    agent_config("extend_refresh yes");
+    init_snmp("async-helpers-perf");
+
+    OK(netsnmp_register_read_only_int_instance("fast", fast_oid,
+                                               OID_LENGTH(fast_oid),
+                                               &fast_value, NULL) ==
+       MIB_REGISTERED_OK, "fast scalar registered");
+    t = netsnmp_transport_open_server("async-helpers-perf",
+                                      "udp:127.0.0.1:0");
+    OK(t != NULL && getsockname(t->sock, (struct sockaddr *) &addr,
+                                &addrlen) == 0 &&
+       netsnmp_register_agent_nsap(t) >= 0, "agent listening");
+
+    snprintf(peer, sizeof(peer), "udp:127.0.0.1:%d", ntohs(addr.sin_port));
+    snmp_sess_init(&session);
+    session.version = SNMP_VERSION_2c;
+    session.peername = peer;
+    session.community = NETSNMP_REMOVE_CONST(u_char *, "public");
+    session.community_len = strlen("public");
+    session.timeout = 10000000;
+    session.retries = 0;
+    ss = snmp_open(&session);
+    OK(ss != NULL, "session open");
+    if (ss == NULL)
+        return 1;
+
+    /*
+     * one GET for each pass_persist helper, and one for the scalar
+     */
+    for (i = 0; i < HELPERS; i++) {
+        pass_oid[8] = i;
+        send_request(ss, SNMP_MSG_GET, pass_oid, OID_LENGTH(pass_oid), &a[i]);
+    }
+    send_request(ss, SNMP_MSG_GET, fast_oid, OID_LENGTH(fast_oid),
+                 &a[HELPERS]);
+    wait_for(a, HELPERS + 1);
+    for (i = 0, ok = 1, slowest = 0; i < HELPERS; i++) {
+        if (!is_integer(&a[i], i))
+            ok = 0;
+        if (a[i].usec > slowest)
+            slowest = a[i].usec;
+    }
+    OK(ok, "pass_persist helpers answered");
+    printf("# pass_persist: scalar %.0f us, %d helpers %.0f us\n",
+           a[HELPERS].usec, HELPERS, slowest);
+    OKF(is_integer(&a[HELPERS], fast_value) && a[HELPERS].usec < SLOW_US / 2,
+        ("scalar answered while the helpers were busy (%.0f us)",
+         a[HELPERS].usec));
+    OKF(slowest < 2 * SLOW_US,
+        ("helpers answered concurrently (%.0f us for %d)", slowest,
+         HELPERS));
+    free_answers(a, HELPERS + 1);
+
+    /*
+     * the same again for extend commands
+     */
+    for (i = 0; i < HELPERS; i++) {
+        snprintf(token, sizeof(token), "slow%d", i);
+        len = extend_line_oid(name, token);
+        send_request(ss, SNMP_MSG_GET, name, len, &a[i]);
+    }
+    send_request(ss, SNMP_MSG_GET, fast_oid, OID_LENGTH(fast_oid),
+                 &a[HELPERS]);
+    wait_for(a, HELPERS + 1);
+    for (i = 0, ok = 1, slowest = 0; i < HELPERS; i++) {
+        snprintf(token, sizeof(token), "slow%d", i);
+        if (!is_string(&a[i], token))
+            ok = 0;
+        if (a[i].usec > slowest)
+            slowest = a[i].usec;
+    }
+    OK(ok, "extend commands answered");
+    printf("# extend: scalar %.0f us, %d commands %.0f us\n",
+           a[HELPERS].usec, HELPERS, slowest);
+    OKF(is_integer(&a[HELPERS], fast_value) && a[HELPERS].usec < SLOW_US / 2,
+        ("scalar answered while the commands ran (%.0f us)",
+         a[HELPERS].usec));
+    OKF(slowest < 2 * SLOW_US,
+        ("commands ran concurrently (%.0f us for %d)", slowest, HELPERS));
+    free_answers(a, HELPERS + 1);
+
+    /*
+     * a helper that doesn't answer is killed at its timeout
+     */
+    pass_oid[8] = HELPERS;
+    send_request(ss, SNMP_MSG_GET, pass_oid, OID_LENGTH(pass_oid), &a[0]);
+    send_request(ss, SNMP_MSG_GET, fast_oid, OID_LENGTH(fast_oid), &a[1]);
+    wait_for(a, 2);
+    OKF(a[0].done && a[0].status == 0 && a[0].vars &&
+        a[0].vars->type != ASN_INTEGER && a[0].usec > 0.8e6 &&
+        a[0].usec < 3e6,
+        ("hung helper timed out (%.0f us)", a[0].usec));
+    OKF(is_integer(&a[1], fast_value) && a[1].usec < SLOW_US / 2,
+        ("scalar answered while the helper hung (%.0f us)", a[1].usec));
+    free_answers(a, 2);
+
+    /*
+     * a GET with long names for a helper that doesn't read them yet: what
+     * its pipe doesn't take is written later, and other requests are
+     * answered meanwhile
+     */
+    pdu = snmp_pdu_create(SNMP_MSG_GET);
+    memcpy(name, pass_oid, sizeof(pass_oid));
+    name[8] = HELPERS + 1;
+    for (len = OID_LENGTH(pass_oid); len < MAX_OID_LEN; len++)
+        name[len] = 4294967295U;
+    for (i = 0; i < BIG_GET; i++) {
+        name[MAX_OID_LEN - 1] = i;
+        snmp_add_null_var(pdu, name, MAX_OID_LEN);
+    }
+    memset(&a[0], 0, sizeof(a[0]));
+    gettimeofday(&a[0].start, NULL);
+    if (snmp_async_send(ss, pdu, response, &a[0]) == 0) {
+        snmp_free_pdu(pdu);
+        a[0].done = 1;
+        a[0].status = -1;
+    }
+    send_request(ss, SNMP_MSG_GET, fast_oid, OID_LENGTH(fast_oid), &a[1]);
+    wait_for(a, 2);
+    for (v = a[0].vars, i = 0; v; v = v->next_variable)
+        if (v->type == ASN_INTEGER && *v->val.integer == 7)
+            i++;
+    OKF(a[0].done && a[0].status == 0 && i == BIG_GET &&
+        is_integer(&a[1], fast_value) && a[1].usec < SLOW_US / 2,
+        ("%d answers from a helper slow to read, scalar %.0f us", i,
+         a[1].usec));
+    free_answers(a, 2);
+
+    /*
+     * SETs are passed on as before
+     */
+    pass_oid[8] = 0;
+    send_request(ss, SNMP_MSG_SET, pass_oid, OID_LENGTH(pass_oid), &a[0]);
+    wait_for(a, 1);
+    OKF(a[0].done && a[0].status == 0,
+        ("SET through a helper (%.0f us)", a[0].usec));
+    free_answers(a, 1);
+
+    /*
+     * and to a helper started with its pipes above FD_SETSIZE
+     */
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 &&
+        rl.rlim_cur < FD_SETSIZE + 64 && rl.rlim_max >= FD_SETSIZE + 64) {
+        rl.rlim_cur = FD_SETSIZE + 64;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    nfill = 0;
+    while (nfill < FD_SETSIZE &&
+           (fill[nfill] = open("/dev/null", O_RDONLY)) >= 0 &&
+           fill[nfill++] < FD_SETSIZE)
+        ;
+    pass_oid[8] = HELPERS + 2;
+    send_request(ss, SNMP_MSG_SET, pass_oid, OID_LENGTH(pass_oid), &a[0]);
+    wait_for(a, 1);
+    OKF(a[0].done && a[0].status == 0 && fill[nfill - 1] >= FD_SETSIZE,
+        ("SET through a helper with fds from %d (%.0f us)",
+         fill[nfill - 1] + 1, a[0].usec));
+    free_answers(a, 1);
+    while (nfill > 0)
+        close(fill[--nfill]);
+
+    /*
+     * with extend_refresh, output that has been read is rerun before
+     * it expires, so the next read needn't wait for it
+     */
+    len = extend_line_oid(name, "stamp");
+    send_request(ss, SNMP_MSG_GET, name, len, &a[0]);
+    wait_for(a, 1);
+    first[0] = '\0';
+    if (a[0].vars && a[0].vars->type == ASN_OCTET_STR &&
+        a[0].vars->val_len < sizeof(first)) {
+        memcpy(first, a[0].vars->val.string, a[0].vars->val_len);
+        first[a[0].vars->val_len] = '\0';
+    }
+    OKF(first[0] && a[0].usec >= SLOW_US,
+        ("first read of a refreshed entry waits for it (%.0f us)",
+         a[0].usec));
+    free_answers(a, 1);
+    serve_for(2.2e6);
+    send_request(ss, SNMP_MSG_GET, name, len, &a[0]);
+    wait_for(a, 1);
+    OKF(a[0].done && a[0].status == 0 && a[0].vars &&
+        a[0].vars->type == ASN_OCTET_STR && !is_string(&a[0], first) &&
+        a[0].usec < SLOW_US / 2,
+        ("refreshed before it expired (%.0f us)", a[0].usec));
+    free_answers(a, 1);
+
+    /*
+     * walking nsExtendOutput2Table uses the cached output
+     */
+    len = OID_LENGTH(extend_oid);
+    memcpy(name, extend_oid, sizeof(extend_oid));
+    name[len++] = 4;
+    send_request(ss, SNMP_MSG_GETBULK, name, len, b);
+    wait_for(b, 1);
+    ok = b[0].done && b[0].status == 0;
+    for (i = 0; ok && i < HELPERS; i++) {
+        netsnmp_variable_list *v = b[0].vars;
+        int             j;
+
+        snprintf(token, sizeof(token), "slow%d", i);
+        for (j = 0; v && j < i; j++)
+            v = v->next_variable;
+        if (!v || v->type != ASN_OCTET_STR || v->val_len != strlen(token) ||
+            memcmp(v->val.string, token, v->val_len))
+            ok = 0;
+    }
+    OKF(ok && b[0].usec < SLOW_US,
+        ("GETBULK of the output table (%.0f us)", b[0].usec));
+    free_answers(b, 1);
+
+    snmp_close(ss);
+    snmp_shutdown("async-helpers-perf");
+    shutdown_agent();
+    snprintf(peer, sizeof(peer), "%s/helper", dir);
+    unlink(peer);
+    rmdir(dir);
+
+    PLAN(__test_counter);
+    return 0;
+}
@@ -0,0 +1,336 @@
+/*
+ * HEADER AgentX master batching and pipelining requests to a subagent
+ *
+ * Runs an in-process AgentX master with a forked subagent that takes
+ * SUB_DELAY_US to answer each AgentX request, and sends it NREQUESTS
+ * GETs at once.  All must be answered, in much less than the time the
+ * subagent would take to answer them one at a time, with fewer AgentX
+ * requests than GETs; nsAgentxSubagentTable must account for them.  A
+ * subagent that registers a subtree with a 1 second timeout must be
+ * timed out after that second, not after the 5 second agentxTimeout.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "perftest.h"
+
+#define NREQUESTS       64
+#define SUB_DELAY_US    5000
+#define HANG_US         2500000
+
+static oid      slow_oid[] = { 1, 3, 6, 1, 4, 1, 8072, 9995, 1 };
+static oid      hang_oid[] = { 1, 3, 6, 1, 4, 1, 8072, 9995, 2 };
+static oid      table_oid[] = { 1, 3, 6, 1, 4, 1, 8072, 1, 8, 2, 1, 0, 1 };
+static char     dir[] = "/tmp/agentx-pipelineXXXXXX";
+static char     socket_path[sizeof(dir) + 16];
+
+struct answer {
+    struct timeval  start;
+    double          usec;
+    int             done;
+    int             status;
+    netsnmp_variable_list *vars;
+};
+
+/*
+ * the subagent: each instance under slow_oid is its own last subid,
+ * after a delay for each AgentX request; hang_oid doesn't answer in time
+ */
+static int
+slow_handler(netsnmp_mib_handler *handler,
+             netsnmp_handler_registration *reginfo,
+             netsnmp_agent_request_info *reqinfo,
+             netsnmp_request_info *requests)
+{
+    if (reqinfo->mode != MODE_GET)
+        return SNMP_ERR_NOERROR;
+    usleep(SUB_DELAY_US);
+    for (; requests; requests = requests->next) {
+        netsnmp_variable_list *var = requests->requestvb;
+
+        snmp_set_var_typed_integer(var, ASN_INTEGER,
+                                   var->name[var->name_length - 1]);
+    }
+    return SNMP_ERR_NOERROR;
+}
+
+static int
+hang_handler(netsnmp_mib_handler *handler,
+             netsnmp_handler_registration *reginfo,
+             netsnmp_agent_request_info *reqinfo,
+             netsnmp_request_info *requests)
+{
+    usleep(HANG_US);
+    return slow_handler(handler, reginfo, reqinfo, requests);
+}
+
+static void
+run_subagent(int ready)
+{
+    netsnmp_handler_registration *reg;
+    char            c;
+
+    if (read(ready, &c, 1) != 1)
+        _exit(1);
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_ROLE,
+                           1);
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    netsnmp_ds_set_string(NETSNMP_DS_APPLICATION_ID,
+                          NETSNMP_DS_AGENT_X_SOCKET, socket_path);
+    init_agent("agentx-pipeline-sub");
+    reg = netsnmp_create_handler_registration("slow", slow_handler, slow_oid,
+                                              OID_LENGTH(slow_oid),
+                                              HANDLER_CAN_RONLY);
+    netsnmp_register_handler(reg);
+    reg = netsnmp_create_handler_registration("hang", hang_handler, hang_oid,
+                                              OID_LENGTH(hang_oid),
+                                              HANDLER_CAN_RONLY);
+    reg->timeout = 1;
+    netsnmp_register_handler(reg);
+    init_snmp("agentx-pipeline-sub");
+    while (getppid() != 1)
+        agent_check_and_process(1);
+    _exit(0);
+}
+
+static int
+response(int op, netsnmp_session *session, int reqid, netsnmp_pdu *pdu,
+         void *magic)
+{
+    struct answer  *a = (struct answer *) magic;
+
+    a->usec = perf_elapsed_us(&a->start);
+    a->done = 1;
+    if (op == NETSNMP_CALLBACK_OP_RECEIVED_MESSAGE) {
+        a->status = pdu->errstat;
+        a->vars = snmp_clone_varbind(pdu->variables);
+    } else
+        a->status = -1;
+    return 1;
+}
+
+static void
+send_get(netsnmp_session *ss, const oid *name, size_t len,
+         struct answer *a)
+{
+    netsnmp_pdu    *pdu = snmp_pdu_create(SNMP_MSG_GET);
+
+    snmp_add_null_var(pdu, name, len);
+    memset(a, 0, sizeof(*a));
+    gettimeofday(&a->start, NULL);
+    if (snmp_async_send(ss, pdu, response, a) == 0) {
+        snmp_free_pdu(pdu);
+        a->done = 1;
+        a->status = -1;
+    }
+}
+
+static void
+wait_for(struct answer *a, int n)
+{
+    struct timeval  start;
+    int             i;
+
+    gettimeofday(&start, NULL);
+    for (;;) {
+        for (i = 0; i < n && a[i].done; i++)
+            ;
+        if (i == n || perf_elapsed_us(&start) > 10e6)
+            return;
+        agent_check_and_process(1);
+    }
+}
+
+static void
+free_answers(struct answer *a, int n)
+{
+    int             i;
+
+    for (i = 0; i < n; i++)
+        snmp_free_varbind(a[i].vars);
+}
+
+/* the slow instance sub, with the answer it should have */
+static int
+get_slow(netsnmp_session *ss, int sub, struct answer *a)
+{
+    oid             name[MAX_OID_LEN];
+
+    memcpy(name, slow_oid, sizeof(slow_oid));
+    name[OID_LENGTH(slow_oid)] = sub;
+    send_get(ss, name, OID_LENGTH(slow_oid) + 1, a);
+    return sub;
+}
+
+static int
+is_integer(const struct answer *a, long value)
+{
+    return a->done && a->status == 0 && a->vars &&
+        a->vars->type == ASN_INTEGER && *a->vars->val.integer == value;
+}
+
+/* a column of the first row of nsAgentxSubagentTable, or -1 */
+static long
+subagent_stat(netsnmp_session *ss, int column)
+{
+    struct answer   a;
+    long            value = -1;
+
+    table_oid[OID_LENGTH(table_oid) - 2] = column;
+    send_get(ss, table_oid, OID_LENGTH(table_oid), &a);
+    wait_for(&a, 1);
+    if (a.done && a.status == 0 && a.vars &&
+        (a.vars->type == ASN_COUNTER || a.vars->type == ASN_GAUGE))
+        value = *a.vars->val.integer;
+    free_answers(&a, 1);
+    return value;
+}
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_session session, *ss;
+    netsnmp_transport *t;
+    struct sockaddr_in addr;
+    socklen_t       addrlen = sizeof(addr);
+    struct answer   a[NREQUESTS];
+    struct timeval  start;
+    char            peer[64];
+    double          usec;
+    long            requests, varbinds, batched;
+    int             i, ok, ready[2];
+    pid_t           pid;
+
+    if (mkdtemp(dir) == NULL || pipe(ready) < 0) {
+        printf("1..0 # SKIP can't make a socket directory\n");
+        return 0;
+    }
+    snprintf(socket_path, sizeof(socket_path), "%s/master", dir);
+    pid = fork();
+    if (pid < 0) {
+        printf("1..0 # SKIP can't fork a subagent\n");
+        return 0;
+    }
+    if (pid == 0)
+        run_subagent(ready[0]);
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_ROLE,
+                           0);
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID,
+                           NETSNMP_DS_AGENT_AGENTX_MASTER, 1);
+    netsnmp_ds_set_string(NETSNMP_DS_APPLICATION_ID,
+                          NETSNMP_DS_AGENT_X_SOCKET, socket_path);
+    netsnmp_ds_set_string(NETSNMP_DS_APPLICATION_ID,
+                          NETSNMP_DS_AGENT_PORTS, "none");
+    netsnmp_ds_set_int(NETSNMP_DS_APPLICATION_ID,
+                       NETSNMP_DS_AGENT_AGENTX_TIMEOUT, 5 * ONE_SEC);
+    netsnmp_ds_set_int(NETSNMP_DS_APPLICATION_ID,
+                       NETSNMP_DS_AGENT_AGENTX_RETRIES, 0);
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_agent("agentx-pipeline-perf");
+    netsnmp_config(NETSNMP_REMOVE_CONST(char *,
+                                        "rocommunity public 127.0.0.1"));
+    init_snmp("agentx-pipeline-perf");
+    OK(init_master_agent() == 0, "AgentX master listening");
+    t = netsnmp_transport_open_server("agentx-pipeline-perf",
+                                      "udp:127.0.0.1:0");
+    OK(t != NULL && getsockname(t->sock, (struct sockaddr *) &addr,
+                                &addrlen) == 0 &&
+       netsnmp_register_agent_nsap(t) >= 0, "agent listening");
+    OK(write(ready[1], "", 1) == 1, "subagent started");
+
+    snprintf(peer, sizeof(peer), "udp:127.0.0.1:%d", ntohs(addr.sin_port));
+    snmp_sess_init(&session);
+    session.version = SNMP_VERSION_2c;
+    session.peername = peer;
+    session.community = NETSNMP_REMOVE_CONST(u_char *, "public");
+    session.community_len = strlen("public");
+    session.timeout = 10000000;
+    session.retries = 0;
+    ss = snmp_open(&session);
+    OK(ss != NULL, "session open");
+    if (ss == NULL) {
+        kill(pid, SIGKILL);
+        return 1;
+    }
+
+    /*
+     * wait for the subagent to register
+     */
+    gettimeofday(&start, NULL);
+    do {
+        get_slow(ss, 1, &a[0]);
+        wait_for(a, 1);
+        ok = is_integer(&a[0], 1);
+        free_answers(a, 1);
+    } while (!ok && perf_elapsed_us(&start) < 10e6);
+    OK(ok, "subagent registered");
+
+    /*
+     * all the GETs at once
+     */
+    requests = subagent_stat(ss, 5);
+    varbinds = subagent_stat(ss, 6);
+    batched = subagent_stat(ss, 7);
+    gettimeofday(&start, NULL);
+    for (i = 0; i < NREQUESTS; i++)
+        get_slow(ss, i + 1, &a[i]);
+    wait_for(a, NREQUESTS);
+    usec = perf_elapsed_us(&start);
+    for (i = 0, ok = 1; i < NREQUESTS; i++)
+        if (!is_integer(&a[i], i + 1))
+            ok = 0;
+    free_answers(a, NREQUESTS);
+    OK(ok, "GETs answered by the subagent");
+    requests = subagent_stat(ss, 5) - requests;
+    varbinds = subagent_stat(ss, 6) - varbinds;
+    batched = subagent_stat(ss, 7) - batched;
+    printf("# %d GETs: %.0f us, %ld AgentX requests, %ld batched\n",
+           NREQUESTS, usec, requests, batched);
+    OKF(usec < NREQUESTS * SUB_DELAY_US / 2,
+        ("GETs took %.0f us, not %d one after the other", usec,
+         NREQUESTS * SUB_DELAY_US));
+    OKF(varbinds == NREQUESTS && requests < NREQUESTS / 2 &&
+        requests + batched == NREQUESTS,
+        ("%ld varbinds in %ld AgentX requests", varbinds, requests));
+    OKF(subagent_stat(ss, 3) == 0 && subagent_stat(ss, 4) == 0,
+        ("nothing left in flight or queued"));
+    OKF(subagent_stat(ss, 9) >= SUB_DELAY_US &&
+        subagent_stat(ss, 10) >= subagent_stat(ss, 9),
+        ("latency %ld us, at most %ld us", subagent_stat(ss, 9),
+         subagent_stat(ss, 10)));
+
+    /*
+     * a subtree registered with a shorter timeout than agentxTimeout
+     */
+    send_get(ss, hang_oid, OID_LENGTH(hang_oid), &a[0]);
+    wait_for(a, 1);
+    OKF(a[0].done && a[0].status == SNMP_ERR_GENERR &&
+        a[0].usec > 0.8e6 && a[0].usec < 2e6,
+        ("subagent timed out after its own timeout (%.0f us)", a[0].usec));
+    free_answers(a, 1);
+
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    snmp_close(ss);
+    snmp_shutdown("agentx-pipeline-perf");
+    shutdown_agent();
+    unlink(socket_path);
+    rmdir(dir);
+
+    PLAN(__test_counter);
+    return 0;
+}
@@ -0,0 +1,308 @@
+/*
+ * HEADER shared /proc snapshot for the process tables
+ *
+ * Starts up to NCHILDREN idle processes and, at several process counts,
+ * times a scan of /proc into the shared process snapshot, with no open
+ * /proc/<pid> directories and with the directories kept open since the
+ * last scan, against reading the status, cmdline and stat files of each
+ * process by path as hrSWRunTable used to.  The snapshot must find the
+ * processes with the names and command lines read by path and the
+ * sockets of this process; it must be used again, reading only the
+ * parts it lacks, until it expires, and hrSWRunTable must be loaded
+ * from it.  However many processes there are, the directories kept open
+ * must leave the fds of the agent well below FD_SETSIZE.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/data_access/swrun.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#ifdef linux
+#include <sys/prctl.h>
+#endif
+
+#include "../../../agent/mibgroup/util_funcs/proc_snapshot.h"
+#include "perftest.h"
+
+#ifndef NCHILDREN
+#define NCHILDREN       2000
+#endif
+#define SCANS           5
+
+void            init_swrun(void);
+netsnmp_swrun_entry *netsnmp_swrun_entry_get_by_index(netsnmp_container *,
+                                                      oid);
+
+static pid_t    children[NCHILDREN];
+static int      nchildren;
+
+static int
+spawn(int n)
+{
+    pid_t           pid;
+
+    while (nchildren < n) {
+        pid = fork();
+        if (pid < 0)
+            return -1;
+        if (pid == 0) {
+#ifdef PR_SET_PDEATHSIG
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+            for (;;)
+                pause();
+        }
+        children[nchildren++] = pid;
+    }
+    return 0;
+}
+
+/*
+ * what hrSWRunTable read for each process before the snapshot
+ */
+static int
+scan_by_path(void)
+{
+    DIR            *procdir;
+    struct dirent  *procentry;
+    char            buf[BUFSIZ], path[64];
+    const char     *files[] = { "status", "cmdline", "stat" };
+    FILE           *fp;
+    int             count = 0, i;
+
+    procdir = opendir("/proc");
+    if (NULL == procdir)
+        return -1;
+    while ((procentry = readdir(procdir)) != NULL) {
+        if (0 == atoi(procentry->d_name))
+            continue;
+        for (i = 0; i < 3; i++) {
+            snprintf(path, sizeof(path), "/proc/%s/%s", procentry->d_name,
+                     files[i]);
+            fp = fopen(path, "r");
+            if (NULL == fp)
+                break;
+            if (fgets(buf, sizeof(buf), fp) == NULL)
+                buf[0] = '\0';
+            fclose(fp);
+        }
+        if (i == 3)
+            count++;
+    }
+    closedir(procdir);
+    return count;
+}
+
+/* the file descriptors this process has open */
+static int
+open_fds(void)
+{
+    DIR            *fddir;
+    int             count = 0;
+
+    fddir = opendir("/proc/self/fd");
+    if (NULL == fddir)
+        return -1;
+    while (readdir(fddir) != NULL)
+        count++;
+    closedir(fddir);
+    return count - 3;           /* ".", ".." and fddir's own */
+}
+
+static int
+read_file(pid_t pid, const char *file, char *buf, size_t size)
+{
+    char            path[64];
+    FILE           *fp;
+    size_t          len;
+
+    snprintf(path, sizeof(path), "/proc/%d/%s", (int) pid, file);
+    fp = fopen(path, "r");
+    if (NULL == fp)
+        return -1;
+    len = fread(buf, 1, size - 1, fp);
+    fclose(fp);
+    buf[len] = '\0';
+    return len;
+}
+
+static netsnmp_proc_entry *
+find(netsnmp_proc_snapshot *procs, pid_t pid)
+{
+    size_t          i;
+
+    for (i = 0; procs && i < procs->count; i++)
+        if (procs->entries[i].pid == pid)
+            return &procs->entries[i];
+    return NULL;
+}
+
+/* the median time of SCANS calls */
+static double
+time_scans(int cold, int *count)
+{
+    double          usec[SCANS], t;
+    struct timeval  start;
+    netsnmp_proc_snapshot *procs;
+    int             i, j;
+
+    for (i = 0; i < SCANS; i++) {
+        if (cold < 0) {
+            gettimeofday(&start, NULL);
+            *count = scan_by_path();
+        } else {
+            if (cold)
+                shutdown_proc_snapshot();
+            netsnmp_proc_snapshot_expire();
+            gettimeofday(&start, NULL);
+            procs = netsnmp_proc_snapshot_get(NETSNMP_PROC_STAT |
+                                              NETSNMP_PROC_CMDLINE);
+            *count = procs ? (int) procs->count : -1;
+        }
+        usec[i] = perf_elapsed_us(&start);
+        for (j = i; j > 0 && usec[j - 1] > usec[j]; j--) {
+            t = usec[j];
+            usec[j] = usec[j - 1];
+            usec[j - 1] = t;
+        }
+    }
+    return usec[SCANS / 2];
+}
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_proc_snapshot *procs;
+    netsnmp_proc_entry *proc;
+    netsnmp_container *container;
+    netsnmp_swrun_entry *entry;
+    struct rlimit   rl;
+    struct stat     st;
+    char            name[64], cmdline[BUFSIZ];
+    double          by_path = 0, cold = 0, warm = 0;
+    const int       levels[] = { 0, NCHILDREN / 3, NCHILDREN };
+    int             i, ok, sock, count, cmdline_len;
+    pid_t           late;
+
+#ifndef linux
+    printf("1..0 # SKIP the process snapshot is only built on linux\n");
+    return 0;
+#endif
+
+    /* the directories kept open must not depend on a low fd limit */
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_ROLE,
+                           0);
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_agent("proc-snapshot-perf");
+    init_snmp("proc-snapshot-perf");
+    init_swrun();
+
+    for (i = 0; i < (int) (sizeof(levels) / sizeof(levels[0])); i++) {
+        if (spawn(levels[i]) < 0) {
+            printf("# only %d processes could be started\n", nchildren);
+            if (i > 0)
+                break;
+        }
+        usleep(200000);         /* until the new processes are idle */
+        by_path = time_scans(-1, &count);
+        cold = time_scans(1, &count);
+        warm = time_scans(0, &count);
+        printf("# %d processes: by path %.0f us, snapshot %.0f us, "
+               "with open directories %.0f us\n", count, by_path, cold,
+               warm);
+    }
+    OKF(cold < by_path && warm < by_path,
+        ("snapshot scans %.0f and %.0f us, by path %.0f us", cold, warm,
+         by_path));
+    i = open_fds();
+    OKF(i > 0 && i < FD_SETSIZE / 2,
+        ("%d fds open with %d processes' directories kept", i, count));
+
+    /*
+     * the same names and command lines as read by path
+     */
+    procs = netsnmp_proc_snapshot_get(NETSNMP_PROC_STAT |
+                                      NETSNMP_PROC_CMDLINE);
+    OK(procs && procs->count >= (size_t) nchildren + 1,
+       "snapshot has every process");
+    read_file(getpid(), "comm", name, sizeof(name));
+    name[strcspn(name, "\n")] = '\0';
+    cmdline_len = read_file(getpid(), "cmdline", cmdline, sizeof(cmdline));
+    for (i = 0, ok = 1; i <= nchildren; i++) {
+        proc = find(procs, i < nchildren ? children[i] : getpid());
+        if (NULL == proc || strcmp(proc->name, name) != 0 ||
+            proc->cmdline_len != (size_t) cmdline_len ||
+            memcmp(proc->cmdline, cmdline, cmdline_len) != 0 ||
+            (i < nchildren && proc->state != 'S'))
+            ok = 0;
+    }
+    OK(ok, "names, command lines and states as read by path");
+
+    /*
+     * the sockets are read on their own, in the same snapshot
+     */
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    fstat(sock, &st);
+    late = fork();
+    if (late == 0) {
+        pause();
+        _exit(0);
+    }
+    procs = netsnmp_proc_snapshot_get(NETSNMP_PROC_SOCKETS);
+    proc = find(procs, getpid());
+    for (i = 0, ok = 0; proc && i < (int) proc->nsockets; i++)
+        if (proc->sockets[i] == st.st_ino)
+            ok = 1;
+    OK(ok, "snapshot has this process's socket");
+    OK(find(procs, late) == NULL &&
+       (procs->parts & NETSNMP_PROC_STAT) && proc && proc->name[0],
+       "snapshot used again, with the sockets added");
+    netsnmp_proc_snapshot_expire();
+    procs = netsnmp_proc_snapshot_get(NETSNMP_PROC_SOCKETS);
+    OK(find(procs, late) != NULL, "expired snapshot scanned again");
+    kill(late, SIGKILL);
+    waitpid(late, NULL, 0);
+    close(sock);
+
+    /*
+     * hrSWRunTable
+     */
+    container = netsnmp_container_find("swrun:table_container");
+    netsnmp_swrun_container_load(container, 0);
+    entry = netsnmp_swrun_entry_get_by_index(container, getpid());
+    OK(entry && strcmp(entry->hrSWRunName, name) == 0 &&
+       strcmp(entry->hrSWRunPath, cmdline) == 0 &&
+       entry->hrSWRunType == 4, "hrSWRunTable loaded from the snapshot");
+    OK(CONTAINER_SIZE(container) >= (size_t) nchildren + 1,
+       "hrSWRunTable has every process");
+    netsnmp_swrun_container_free(container, 0);
+
+    for (i = 0; i < nchildren; i++)
+        kill(children[i], SIGKILL);
+    for (i = 0; i < nchildren; i++)
+        waitpid(children[i], NULL, 0);
+    snmp_shutdown("proc-snapshot-perf");
+    shutdown_agent();
+
+    PLAN(__test_counter);
+    return 0;
+}
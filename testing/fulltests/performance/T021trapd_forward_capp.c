@@ -0,0 +1,361 @@
+/*
+ * HEADER snmptrapd forwarding over long-lived sessions
+ *
+ * Starts snmptrapd with "forward default" pointing at a collector in this
+ * process and times the forwarding of TRAPS notifications over UDP, each
+ * sent on its own and with forwardQueueSize.  Over TCP, the collector
+ * closes the connection half way through, and snmptrapd must reconnect;
+ * with the collector not listening, up to forwardQueueSize notifications
+ * must be kept and sent once it is, and the rest dropped.  The counts
+ * snmptrapd logs when it exits must match what the collector got.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "perftest.h"
+
+#define TRAPS   10240
+#define BURST   64
+#define QUEUE   64
+
+static char     dir[] = "/tmp/trapd-forward-XXXXXX";
+static char     trapd[BUFSIZ], conf[BUFSIZ], log_file[BUFSIZ];
+static int      trapd_port;
+
+/* the counts snmptrapd logs for a forwarding destination */
+typedef struct {
+    u_long          forwarded, dropped, failed, reconnects;
+} forward_counts;
+
+static int
+bound_socket(int type, int *port)
+{
+    struct sockaddr_in addr;
+    socklen_t       len = sizeof(addr);
+    int             s;
+
+    s = socket(AF_INET, type, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (s < 0 || bind(s, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+        getsockname(s, (struct sockaddr *) &addr, &len) < 0)
+        return -1;
+    *port = ntohs(addr.sin_port);
+    return s;
+}
+
+static int
+log_contains(const char *what, char *line, size_t size)
+{
+    FILE           *fp = fopen(log_file, "r");
+    int             found = 0;
+
+    if (NULL == fp)
+        return 0;
+    while (!found && fgets(line, size, fp))
+        found = strstr(line, what) != NULL;
+    fclose(fp);
+    return found;
+}
+
+static pid_t
+start_trapd(const char *dest, int queue)
+{
+    FILE           *fp;
+    char            line[BUFSIZ];
+    pid_t           pid;
+    int             s, i;
+
+    /* a port for snmptrapd to listen on */
+    s = bound_socket(SOCK_DGRAM, &trapd_port);
+    close(s);
+
+    fp = fopen(conf, "w");
+    if (NULL == fp)
+        return -1;
+    fprintf(fp, "[snmp] persistentDir %s\n"
+            "disableAuthorization yes\n"
+            "doNotLogTraps yes\n"
+            "doNotRetainNotificationLogs yes\n"
+            "snmpTrapdAddr udp:127.0.0.1:%d\n"
+            "forwardQueueSize %d\n"
+            "forward default %s\n", dir, trapd_port, queue, dest);
+    fclose(fp);
+    unlink(log_file);
+
+    pid = fork();
+    if (pid == 0) {
+        execl(trapd, trapd, "-f", "-C", "-c", conf, "-Lf", log_file,
+              "-x", "none", NULL);
+        _exit(1);
+    }
+    for (i = 0; i < 100 && pid > 0; i++) {
+        if (log_contains("NET-SNMP version", line, sizeof(line)))
+            return pid;
+        usleep(50000);
+    }
+    if (pid > 0)
+        kill(pid, SIGKILL);
+    return -1;
+}
+
+static int
+stop_trapd(pid_t pid, const char *dest, forward_counts *counts)
+{
+    char            what[BUFSIZ], line[BUFSIZ];
+    const char     *cp;
+    int             i;
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    memset(counts, 0, sizeof(*counts));
+    snprintf(what, sizeof(what), "forward %s: ", dest);
+    if (!log_contains(what, line, sizeof(line)))
+        return -1;
+    cp = strstr(line, what) + strlen(what);
+    i = sscanf(cp, "%lu forwarded, %lu dropped, %lu failed, %lu reconnects",
+               &counts->forwarded, &counts->dropped, &counts->failed,
+               &counts->reconnects);
+    return i == 4 ? 0 : -1;
+}
+
+static netsnmp_session *
+open_sender(void)
+{
+    static u_char   community[] = "public";
+    netsnmp_session session;
+    char            peer[64];
+
+    snprintf(peer, sizeof(peer), "udp:127.0.0.1:%d", trapd_port);
+    snmp_sess_init(&session);
+    session.peername = peer;
+    session.version = SNMP_VERSION_2c;
+    session.community = community;
+    session.community_len = sizeof(community) - 1;
+    return snmp_open(&session);
+}
+
+static void
+send_traps(netsnmp_session *ss, int n)
+{
+    static oid      sysUpTime[] = { 1, 3, 6, 1, 2, 1, 1, 3, 0 };
+    static oid      snmpTrapOID[] = { 1, 3, 6, 1, 6, 3, 1, 1, 4, 1, 0 };
+    static oid      coldStart[] = { 1, 3, 6, 1, 6, 3, 1, 1, 5, 1 };
+    netsnmp_pdu    *pdu;
+    long            uptime = 42;
+
+    while (n-- > 0) {
+        pdu = snmp_pdu_create(SNMP_MSG_TRAP2);
+        snmp_pdu_add_variable(pdu, sysUpTime, OID_LENGTH(sysUpTime),
+                              ASN_TIMETICKS, &uptime, sizeof(uptime));
+        snmp_pdu_add_variable(pdu, snmpTrapOID, OID_LENGTH(snmpTrapOID),
+                              ASN_OBJECT_ID, coldStart, sizeof(coldStart));
+        if (!snmp_send(ss, pdu))
+            snmp_free_pdu(pdu);
+    }
+}
+
+/*
+ * counts the notifications that arrive on s (a UDP socket or a TCP
+ * connection) until there are want of them or none for timeout ms;
+ * returns -1 if the connection was closed
+ */
+static int
+collect(int s, int stream, int *got, int want, int timeout)
+{
+    static u_char   buf[65536];
+    static size_t   len;
+    struct pollfd   pfd;
+    size_t          pdulen;
+    ssize_t         n;
+
+    pfd.fd = s;
+    pfd.events = POLLIN;
+    while (*got < want && poll(&pfd, 1, timeout) > 0) {
+        if (!stream) {
+            while (recv(s, buf, sizeof(buf), MSG_DONTWAIT) > 0)
+                (*got)++;
+            continue;
+        }
+        n = recv(s, buf + len, sizeof(buf) - len, 0);
+        if (n <= 0)
+            return -1;
+        len += n;
+        while (len > 0 && (pdulen = asn_check_packet(buf, len)) > 0 &&
+               pdulen <= len) {
+            memmove(buf, buf + pdulen, len - pdulen);
+            len -= pdulen;
+            (*got)++;
+        }
+    }
+    return 0;
+}
+
+static int
+accept_one(int listener)
+{
+    struct pollfd   pfd;
+
+    pfd.fd = listener;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, 3000) <= 0)
+        return -1;
+    return accept(listener, NULL, NULL);
+}
+
+static double
+run_udp(int queue, int *got, forward_counts *counts)
+{
+    netsnmp_session *ss;
+    struct timeval  start;
+    char            dest[64];
+    double          ms;
+    int             collector, port, sent;
+    pid_t           pid;
+
+    *got = 0;
+    collector = bound_socket(SOCK_DGRAM, &port);
+    snprintf(dest, sizeof(dest), "udp:127.0.0.1:%d", port);
+    pid = start_trapd(dest, queue);
+    if (collector < 0 || pid < 0)
+        return -1;
+    ss = open_sender();
+
+    gettimeofday(&start, NULL);
+    for (sent = 0; sent < TRAPS; sent += BURST) {
+        send_traps(ss, BURST);
+        collect(collector, 0, got, sent + BURST, 1000);
+    }
+    ms = perf_elapsed_ms(&start);
+
+    snmp_close(ss);
+    if (stop_trapd(pid, dest, counts) < 0)
+        counts->forwarded = (u_long) -1;
+    close(collector);
+    return ms;
+}
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_session *ss;
+    forward_counts  counts;
+    const char     *builddir = getenv("builddir");
+    char            dest[64];
+    double          ms_single, ms_queued;
+    int             got, got2, listener, port, conn, closed;
+    pid_t           pid;
+
+    snprintf(trapd, sizeof(trapd), "%s/apps/snmptrapd",
+             builddir ? builddir : "..");
+    if (access(trapd, X_OK) != 0) {
+        printf("1..0 # SKIP no snmptrapd in %s\n", trapd);
+        return 0;
+    }
+    if (NULL == mkdtemp(dir)) {
+        printf("1..0 # SKIP can't create a temporary directory\n");
+        return 0;
+    }
+    snprintf(conf, sizeof(conf), "%s/snmptrapd.conf", dir);
+    snprintf(log_file, sizeof(log_file), "%s/snmptrapd.log", dir);
+    setenv("SNMP_PERSISTENT_DIR", dir, 1);
+    setenv("SNMPCONFPATH", dir, 1);
+    setenv("MIBS", "", 1);
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_snmp("trapd-forward-perf");
+
+    /*
+     * UDP, one notification at a time and queued
+     */
+    ms_single = run_udp(0, &got, &counts);
+    printf("# UDP, one at a time: %d of %d in %.0f ms (%.0f/s)\n", got,
+           TRAPS, ms_single, got * 1e3 / ms_single);
+    OKF(got == TRAPS && counts.forwarded == TRAPS && counts.reconnects == 0,
+        ("UDP: %d collected, %lu forwarded over one session", got,
+         counts.forwarded));
+
+    ms_queued = run_udp(QUEUE, &got, &counts);
+    printf("# UDP, forwardQueueSize %d: %d of %d in %.0f ms (%.0f/s)\n",
+           QUEUE, got, TRAPS, ms_queued, got * 1e3 / ms_queued);
+    OKF(got == TRAPS && counts.forwarded == TRAPS && counts.dropped == 0,
+        ("UDP queued: %d collected, %lu forwarded, %lu dropped", got,
+         counts.forwarded, counts.dropped));
+
+    /*
+     * TCP, with the collector closing the connection half way
+     */
+    listener = bound_socket(SOCK_STREAM, &port);
+    listen(listener, 5);
+    snprintf(dest, sizeof(dest), "tcp:127.0.0.1:%d", port);
+    pid = start_trapd(dest, 0);
+    ss = open_sender();
+    got = got2 = 0;
+    send_traps(ss, BURST);
+    conn = accept_one(listener);
+    collect(conn, 1, &got, BURST, 1000);
+    close(conn);
+    usleep(200000);             /* until snmptrapd has seen it closed */
+    send_traps(ss, BURST);
+    conn = accept_one(listener);
+    closed = conn < 0 ? -1 : collect(conn, 1, &got2, BURST, 1000);
+    snmp_close(ss);
+    stop_trapd(pid, dest, &counts);
+    if (conn >= 0)
+        close(conn);
+    OKF(got == BURST && got2 == BURST && closed == 0,
+        ("TCP: %d collected before and %d after the connection closed",
+         got, got2));
+    OKF(counts.forwarded == 2 * BURST && counts.reconnects == 1,
+        ("TCP: %lu forwarded, %lu reconnects", counts.forwarded,
+         counts.reconnects));
+    close(listener);
+
+    /*
+     * TCP with nobody listening: the queue is kept, the rest dropped
+     */
+    listener = bound_socket(SOCK_STREAM, &port);
+    snprintf(dest, sizeof(dest), "tcp:127.0.0.1:%d", port);
+    pid = start_trapd(dest, 8);
+    ss = open_sender();
+    got = 0;
+    send_traps(ss, 50);
+    usleep(200000);
+    listen(listener, 5);
+    conn = accept_one(listener);
+    if (conn >= 0)
+        collect(conn, 1, &got, 50, 1500);
+    snmp_close(ss);
+    stop_trapd(pid, dest, &counts);
+    if (conn >= 0)
+        close(conn);
+    close(listener);
+    OKF(got == 8 && counts.forwarded == 8 && counts.dropped == 42,
+        ("unreachable: %d collected, %lu forwarded, %lu dropped", got,
+         counts.forwarded, counts.dropped));
+
+    unlink(conf);
+    unlink(log_file);
+    rmdir(dir);
+    snmp_shutdown("trapd-forward-perf");
+
+    PLAN(__test_counter);
+    return 0;
+}
@@ -0,0 +1,214 @@
+/*
+ * HEADER snmptrapd trap handler lookup with an OID trie
+ *
+ * Registers NHANDLERS trap-specific handlers the way traphandle and
+ * forward directives generated from vendor MIBs would: exact trap OIDs,
+ * with some enterprise subtrees wildcarded as "oid*" or "oid.*".  Trap
+ * OIDs that are registered, below a registered OID, next to one, or
+ * unrelated are then looked up, and each lookup must find the handlers
+ * the linear scan of the sorted list used to, which is timed alongside.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "../../../apps/snmptrapd_handlers.h"
+#include "perftest.h"
+
+#define NHANDLERS       10000
+#define LOOKUPS         200000
+
+extern netsnmp_trapd_handler *netsnmp_specific_traphandlers;
+void            snmptrapd_free_traphandle(void);
+
+static netsnmp_trapd_handler **sorted;
+static int      nsorted;
+
+static int
+handler(netsnmp_pdu *pdu, netsnmp_transport *transport,
+        netsnmp_trapd_handler *traph)
+{
+    return NETSNMPTRAPD_HANDLER_OK;
+}
+
+static int
+compare_desc(const void *a, const void *b)
+{
+    const netsnmp_trapd_handler *ta = *(netsnmp_trapd_handler * const *) a;
+    const netsnmp_trapd_handler *tb = *(netsnmp_trapd_handler * const *) b;
+
+    return snmp_oid_compare(tb->trapoid, tb->trapoid_len,
+                            ta->trapoid, ta->trapoid_len);
+}
+
+/*
+ * the lookup before the trie: the first match in the list of trap OIDs,
+ * sorted in decreasing order
+ */
+static netsnmp_trapd_handler *
+lookup_by_scan(oid *trapOid, int trapOidLen)
+{
+    netsnmp_trapd_handler *traph;
+    int             i;
+
+    for (i = 0; i < nsorted; i++) {
+        traph = sorted[i];
+        if (!(traph->flags & NETSNMP_TRAPHANDLER_FLAG_MATCH_TREE)) {
+            if (snmp_oid_compare(traph->trapoid, traph->trapoid_len,
+                                 trapOid, trapOidLen) == 0)
+                return traph;
+        } else if (snmp_oidsubtree_compare(traph->trapoid,
+                                           traph->trapoid_len,
+                                           trapOid, trapOidLen) == 0) {
+            if (!(traph->flags & NETSNMP_TRAPHANDLER_FLAG_STRICT_SUBTREE) ||
+                snmp_oid_compare(traph->trapoid, traph->trapoid_len,
+                                 trapOid, trapOidLen) != 0)
+                return traph;
+        }
+    }
+    return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static oid      enterprises[] = { 1, 3, 6, 1, 4, 1 };
+    static oid      coldStart[] = { 1, 3, 6, 1, 6, 3, 1, 1, 5, 1 };
+    static oid      registered[NHANDLERS][MAX_OID_LEN];
+    static size_t   registered_len[NHANDLERS];
+    static oid      probes[LOOKUPS][MAX_OID_LEN];
+    static size_t   probes_len[LOOKUPS];
+    netsnmp_trapd_handler *traph, *a, *b;
+    struct timeval  start;
+    double          reg_us, trie_us, scan_us;
+    size_t          len;
+    int             i, n, r, ok, matched, flags;
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    init_snmp("traphandler-trie-perf");
+    srandom(22);
+
+    /*
+     * enterprises.<vendor>.<mib>.0.<trap>, and now and then a vendor
+     * or MIB subtree, or a trap OID a second handler is added for
+     */
+    gettimeofday(&start, NULL);
+    for (n = 0; n < NHANDLERS; n++) {
+        oid            *name = registered[n];
+
+        memcpy(name, enterprises, sizeof(enterprises));
+        len = OID_LENGTH(enterprises);
+        name[len++] = 1 + random() % 400;
+        r = random() % 100;
+        flags = 0;
+        if (r < 3) {
+            flags = NETSNMP_TRAPHANDLER_FLAG_MATCH_TREE;
+        } else if (r < 6) {
+            name[len++] = random() % 20;
+            flags = NETSNMP_TRAPHANDLER_FLAG_MATCH_TREE |
+                NETSNMP_TRAPHANDLER_FLAG_STRICT_SUBTREE;
+        } else if (r < 10 && n > 0) {
+            len = registered_len[n - 1];
+            memcpy(name, registered[n - 1], len * sizeof(oid));
+            flags = random() % 2 ? NETSNMP_TRAPHANDLER_FLAG_MATCH_TREE : 0;
+        } else {
+            name[len++] = random() % 20;
+            name[len++] = 0;
+            name[len++] = 1 + random() % 50;
+        }
+        registered_len[n] = len;
+        traph = netsnmp_add_traphandler(handler, name, len);
+        if (traph)
+            traph->flags = flags;
+    }
+    reg_us = perf_elapsed_us(&start);
+
+    for (nsorted = 0, traph = netsnmp_specific_traphandlers; traph;
+         traph = traph->nextt)
+        nsorted++;
+    sorted = (netsnmp_trapd_handler **) calloc(nsorted, sizeof(*sorted));
+    for (i = 0, traph = netsnmp_specific_traphandlers; traph;
+         traph = traph->nextt)
+        sorted[i++] = traph;
+    qsort(sorted, nsorted, sizeof(*sorted), compare_desc);
+    printf("# %d handlers for %d trap OIDs registered in %.0f us\n",
+           NHANDLERS, nsorted, reg_us);
+    OK(nsorted > NHANDLERS / 2, "handlers grouped by trap OID");
+
+    /*
+     * registered trap OIDs, OIDs below and next to them, and others
+     */
+    for (i = 0; i < LOOKUPS; i++) {
+        n = random() % NHANDLERS;
+        len = registered_len[n];
+        memcpy(probes[i], registered[n], len * sizeof(oid));
+        switch (random() % 5) {
+        case 0:
+            break;
+        case 1:
+            probes[i][len++] = random() % 3;
+            break;
+        case 2:
+            probes[i][len - 1]++;
+            break;
+        case 3:
+            len = OID_LENGTH(enterprises) + 1;
+            probes[i][len++] = random() % 20;
+            probes[i][len++] = 0;
+            probes[i][len++] = 1 + random() % 50;
+            break;
+        default:
+            len = OID_LENGTH(coldStart);
+            memcpy(probes[i], coldStart, sizeof(coldStart));
+            probes[i][len - 1] = 1 + random() % 6;
+            break;
+        }
+        probes_len[i] = len;
+    }
+
+    gettimeofday(&start, NULL);
+    for (i = 0, matched = 0; i < LOOKUPS; i++)
+        if (netsnmp_get_traphandler(probes[i], probes_len[i]))
+            matched++;
+    trie_us = perf_elapsed_us(&start);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < LOOKUPS / 100; i++)
+        lookup_by_scan(probes[i], probes_len[i]);
+    scan_us = perf_elapsed_us(&start) * 100;
+
+    printf("# %d lookups, %d matched; the list scan estimated from %d\n",
+           LOOKUPS, matched, LOOKUPS / 100);
+    PERF_FASTER(trie_us, "trie lookups", scan_us, "list scan");
+
+    for (i = 0, ok = 1; i < LOOKUPS; i += 50) {
+        a = netsnmp_get_traphandler(probes[i], probes_len[i]);
+        b = lookup_by_scan(probes[i], probes_len[i]);
+        if (a != b) {
+            printf("# lookup %d: trie %p, list scan %p\n", i, a, b);
+            ok = 0;
+            break;
+        }
+    }
+    OK(ok, "the same handlers as the list scan");
+    OK(matched > LOOKUPS / 2 && matched < LOOKUPS,
+       "some trap OIDs match no handler");
+
+    snmptrapd_free_traphandle();
+    OK(netsnmp_get_traphandler(registered[0], registered_len[0]) == NULL &&
+       netsnmp_specific_traphandlers == NULL, "handlers freed");
+
+    free(sorted);
+    snmp_shutdown("traphandler-trie-perf");
+
+    PLAN(__test_counter);
+    return 0;
+}
@@ -0,0 +1,298 @@
+/*
+ * HEADER snmptrapd traphandle commands run by a pool of workers
+ *
+ * Passes a burst of traps to command_handler, with a traphandle command
+ * that takes about DELAY ms, and times how long the handler holds up
+ * receiving traps: with traphandleWorkers 0 each command is run to
+ * completion as before, while with workers the commands are queued and
+ * run in the background, WORKERS at a time, from the event loop.  Every
+ * command must run, a full queue must drop the traps beyond it, those
+ * running or queued at exit must have finished when snmptrapd is done
+ * with them, and the statistics snmptrapd logs must count them.  A trap
+ * whose text is more than the pipe holds must not hold snmptrapd up
+ * until the command gets round to reading it.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "../../../apps/snmptrapd_handlers.h"
+#include "perftest.h"
+
+#define TRAPS           200
+#define SYNC_TRAPS      40
+#define WORKERS         8
+#define DELAY           20
+#define BIG_VALUE       200000
+
+void            snmptrapd_register_configs(void);
+
+static char     dir[] = "/tmp/traphandle-workers-XXXXXX";
+static char     out_file[BUFSIZ], log_file[BUFSIZ], command[BUFSIZ];
+
+static int
+count_lines(const char *file)
+{
+    FILE           *fp = fopen(file, "r");
+    char            line[BUFSIZ];
+    int             n = 0;
+
+    if (NULL == fp)
+        return 0;
+    while (fgets(line, sizeof(line), fp))
+        n++;
+    fclose(fp);
+    return n;
+}
+
+/*
+ * runs the event loop until the commands have written lines lines, or
+ * for timeout_ms
+ */
+static void
+event_loop(int lines, int timeout_ms)
+{
+    fd_set          readfds, writefds, exceptfds;
+    struct timeval  start, tv;
+    int             numfds, block, count;
+
+    gettimeofday(&start, NULL);
+    while (count_lines(out_file) < lines &&
+           perf_elapsed_ms(&start) < timeout_ms) {
+        numfds = 0;
+        block = 0;
+        FD_ZERO(&readfds);
+        FD_ZERO(&writefds);
+        FD_ZERO(&exceptfds);
+        tv.tv_sec = 0;
+        tv.tv_usec = 10000;
+        snmp_select_info(&numfds, &readfds, &tv, &block);
+        netsnmp_external_event_info(&numfds, &readfds, &writefds,
+                                    &exceptfds);
+        count = select(numfds, &readfds, &writefds, &exceptfds, &tv);
+        if (count > 0)
+            netsnmp_dispatch_external_events(&count, &readfds, &writefds,
+                                             &exceptfds);
+        run_alarms();
+    }
+}
+
+/*
+ * passes the same trap to command_handler traps times; returns the
+ * time it took
+ */
+static double
+burst(int traps)
+{
+    static oid      sysUpTime[] = { 1, 3, 6, 1, 2, 1, 1, 3, 0 };
+    static oid      snmpTrapOID[] = { 1, 3, 6, 1, 6, 3, 1, 1, 4, 1, 0 };
+    static oid      linkDown[] = { 1, 3, 6, 1, 6, 3, 1, 1, 5, 3 };
+    static char     format[] = "%v\n";
+    netsnmp_trapd_handler handler;
+    netsnmp_pdu    *pdu;
+    struct timeval  start;
+    long            uptime = 42;
+    double          ms;
+    int             i;
+
+    memset(&handler, 0, sizeof(handler));
+    handler.token = command;
+    handler.format = format;
+    handler.handler = command_handler;
+
+    unlink(out_file);
+    pdu = snmp_pdu_create(SNMP_MSG_TRAP2);
+    snmp_pdu_add_variable(pdu, sysUpTime, OID_LENGTH(sysUpTime),
+                          ASN_TIMETICKS, &uptime, sizeof(uptime));
+    snmp_pdu_add_variable(pdu, snmpTrapOID, OID_LENGTH(snmpTrapOID),
+                          ASN_OBJECT_ID, linkDown, sizeof(linkDown));
+    gettimeofday(&start, NULL);
+    for (i = 0; i < traps; i++)
+        command_handler(pdu, NULL, &handler);
+    ms = perf_elapsed_ms(&start);
+    snmp_free_pdu(pdu);
+    return ms;
+}
+
+/*
+ * passes a trap with a BIG_VALUE long string to command_handler; returns
+ * the time it took
+ */
+static double
+big_trap(char *big_command)
+{
+    static oid      sysUpTime[] = { 1, 3, 6, 1, 2, 1, 1, 3, 0 };
+    static oid      sysDescr[] = { 1, 3, 6, 1, 2, 1, 1, 1, 0 };
+    static char     format[] = "%v\n";
+    netsnmp_trapd_handler handler;
+    netsnmp_pdu    *pdu;
+    struct timeval  start;
+    long            uptime = 42;
+    char           *value;
+    double          ms;
+
+    memset(&handler, 0, sizeof(handler));
+    handler.token = big_command;
+    handler.format = format;
+    handler.handler = command_handler;
+
+    value = (char *) malloc(BIG_VALUE);
+    if (NULL == value)
+        return -1;
+    memset(value, 'x', BIG_VALUE);
+    unlink(out_file);
+    pdu = snmp_pdu_create(SNMP_MSG_TRAP2);
+    snmp_pdu_add_variable(pdu, sysUpTime, OID_LENGTH(sysUpTime),
+                          ASN_TIMETICKS, &uptime, sizeof(uptime));
+    snmp_pdu_add_variable(pdu, sysDescr, OID_LENGTH(sysDescr),
+                          ASN_OCTET_STR, value, BIG_VALUE);
+    gettimeofday(&start, NULL);
+    command_handler(pdu, NULL, &handler);
+    ms = perf_elapsed_ms(&start);
+    snmp_free_pdu(pdu);
+    free(value);
+    return ms;
+}
+
+/* the statistics logged by snmptrapd_flush_traphandle(), so far */
+static int
+traphandle_stats(u_long *run, u_long *failed, u_long *dropped,
+                 int *queue_max)
+{
+    FILE           *fp;
+    char            line[BUFSIZ], *cp;
+    int             found = 0;
+
+    snmptrapd_flush_traphandle();
+    fp = fopen(log_file, "r");
+    if (NULL == fp)
+        return -1;
+    while (fgets(line, sizeof(line), fp))
+        if ((cp = strstr(line, "traphandle: ")) != NULL &&
+            sscanf(cp, "traphandle: %lu run, %lu failed, %lu dropped, "
+                   "queue max %d", run, failed, dropped, queue_max) == 4)
+            found = 1;
+    fclose(fp);
+    return found ? 0 : -1;
+}
+
+int
+main(int argc, char *argv[])
+{
+    char            line[BUFSIZ], big_command[BUFSIZ];
+    double          big_ms, sync_ms, async_ms, drain_ms, total_ms;
+    struct timeval  start;
+    u_long          run, failed, dropped;
+    int             queue_max, lines;
+    long            size = 0;
+    FILE           *fp;
+
+#ifndef USING_UTILITIES_EXECUTE_MODULE
+    printf("1..0 # SKIP utilities/execute isn't built\n");
+    return 0;
+#endif
+    if (NULL == mkdtemp(dir)) {
+        printf("1..0 # SKIP can't create a temporary directory\n");
+        return 0;
+    }
+    snprintf(out_file, sizeof(out_file), "%s/out", dir);
+    snprintf(log_file, sizeof(log_file), "%s/log", dir);
+    snprintf(command, sizeof(command),
+             "cat > /dev/null; sleep 0.0%d; echo done >> %s", DELAY,
+             out_file);
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_ROLE,
+                           0);
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    snmp_enable_filelog(log_file, 0);
+    init_agent("snmptrapd");
+    snmptrapd_register_configs();
+    init_snmp("snmptrapd");
+
+    /*
+     * each command run as the trap is received
+     */
+    netsnmp_config(strcpy(line, "traphandleWorkers 0"));
+    sync_ms = burst(SYNC_TRAPS);
+    printf("# %d traps, no workers: handled in %.0f ms (%.1f ms each)\n",
+           SYNC_TRAPS, sync_ms, sync_ms / SYNC_TRAPS);
+    OK(count_lines(out_file) == SYNC_TRAPS, "each command run at once");
+
+    /*
+     * queued, and run by the workers
+     */
+    snprintf(line, sizeof(line), "traphandleWorkers %d", WORKERS);
+    netsnmp_config(line);
+    gettimeofday(&start, NULL);
+    async_ms = burst(TRAPS);
+    event_loop(TRAPS, 30000);
+    total_ms = perf_elapsed_ms(&start);
+    lines = count_lines(out_file);
+    event_loop(TRAPS + 1, 200);         /* until the last have exited */
+    printf("# %d traps, %d workers: handled in %.0f ms (%.2f ms each), "
+           "all run in %.0f ms\n", TRAPS, WORKERS, async_ms,
+           async_ms / TRAPS, total_ms);
+    OKF(async_ms / TRAPS < sync_ms / SYNC_TRAPS / 4,
+        ("traps handled in %.2f ms each with workers, %.1f ms without",
+         async_ms / TRAPS, sync_ms / SYNC_TRAPS));
+    OKF(lines == TRAPS, ("%d of %d commands run", lines, TRAPS));
+    OKF(total_ms < TRAPS * sync_ms / SYNC_TRAPS,
+        ("all run in %.0f ms, %.0f ms one at a time", total_ms,
+         TRAPS * sync_ms / SYNC_TRAPS));
+    OK(traphandle_stats(&run, &failed, &dropped, &queue_max) == 0 &&
+       run == TRAPS && failed == 0 && dropped == 0 &&
+       queue_max == TRAPS - WORKERS, "statistics logged");
+
+    /*
+     * a full queue drops traps; at exit the running command is waited
+     * for, and what is still queued is run
+     */
+    netsnmp_config(strcpy(line, "traphandleWorkers 1"));
+    netsnmp_config(strcpy(line, "traphandleQueueSize 10"));
+    burst(50);
+    gettimeofday(&start, NULL);
+    traphandle_stats(&run, &failed, &dropped, &queue_max);
+    drain_ms = perf_elapsed_ms(&start);
+    lines = count_lines(out_file);
+    printf("# queue of 10: %lu dropped, the rest run at exit in %.0f ms\n",
+           dropped, drain_ms);
+    OKF(dropped == 39 && lines == 11 && run == TRAPS + 11 && failed == 0,
+        ("%lu dropped, %d run by exit, %lu counted", dropped, lines,
+         run - TRAPS));
+    event_loop(12, 200);
+    OKF(count_lines(out_file) == 11,
+        ("%d run, none left behind", count_lines(out_file)));
+
+    /*
+     * more input than the pipe holds, for a command that writes first
+     */
+    snprintf(big_command, sizeof(big_command),
+             "seq 100000; sleep 0.%d; wc -c >> %s", DELAY * 10, out_file);
+    big_ms = big_trap(big_command);
+    event_loop(1, 5000);
+    if ((fp = fopen(out_file, "r")) != NULL) {
+        if (fscanf(fp, "%ld", &size) != 1)
+            size = 0;
+        fclose(fp);
+    }
+    OKF(big_ms >= 0 && big_ms < DELAY * 10 / 2 && size > BIG_VALUE,
+        ("%ld bytes of input written, handled in %.0f ms", size, big_ms));
+
+    unlink(out_file);
+    unlink(log_file);
+    rmdir(dir);
+    snmp_shutdown("snmptrapd");
+    shutdown_agent();
+
+    PLAN(__test_counter);
+    return 0;
+}
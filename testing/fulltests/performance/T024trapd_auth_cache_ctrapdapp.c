@@ -0,0 +1,264 @@
+/*
+ * HEADER snmptrapd authorization cache
+ *
+ * Sets up authCommunity rules, and authorizes TRAPS notifications from
+ * a few communities and source addresses, for a few dozen trap OIDs,
+ * with netsnmp_trapd_auth, which keeps the result of the VACM checks
+ * for each sender and trap OID.  Each must be authorized for the same
+ * actions as by running the VACM checks for every notification, as it
+ * used to be, which is timed alongside.  Re-reading the configuration
+ * must empty the cache.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../../../apps/snmptrapd_handlers.h"
+#include "../../../apps/snmptrapd_auth.h"
+#ifdef USING_MIBII_VACM_CONF_MODULE
+#include "../../../agent/mibgroup/mibII/vacm_conf.h"
+#endif
+#include "perftest.h"
+
+#define TRAPS           100000
+#define TRAP_OIDS       40
+
+static const char *communities[] = { "public", "private", "other" };
+static const char *sources[] = { "127.0.0.1", "10.1.2.3" };
+
+static char     dir[] = "/tmp/trapd-auth-cache-XXXXXX";
+static char     conf_file[BUFSIZ], log_file[BUFSIZ];
+
+/* a notification as the UDP transport would have received it */
+static netsnmp_pdu *
+notification(int n)
+{
+    static oid      sysUpTime[] = { 1, 3, 6, 1, 2, 1, 1, 3, 0 };
+    static oid      snmpTrapOID[] = { 1, 3, 6, 1, 6, 3, 1, 1, 4, 1, 0 };
+    static oid      linkDown[] = { 1, 3, 6, 1, 6, 3, 1, 1, 5, 3 };
+    static oid      enterprise[] = { 1, 3, 6, 1, 4, 1, 8072, 0, 0 };
+    const char     *community = communities[n % 3];
+    netsnmp_indexed_addr_pair *addr;
+    netsnmp_pdu    *pdu;
+    long            uptime = 42;
+
+    pdu = snmp_pdu_create(SNMP_MSG_TRAP2);
+    pdu->version = SNMP_VERSION_2c;
+    pdu->securityModel = SNMP_SEC_MODEL_SNMPv2c;
+    pdu->securityLevel = SNMP_SEC_LEVEL_NOAUTH;
+    pdu->community = (u_char *) strdup(community);
+    pdu->community_len = strlen(community);
+    pdu->tDomain = netsnmpUDPDomain;
+    pdu->tDomainLen = netsnmpUDPDomain_len;
+    addr = SNMP_MALLOC_TYPEDEF(netsnmp_indexed_addr_pair);
+    addr->remote_addr.sin.sin_family = AF_INET;
+    inet_pton(AF_INET, sources[n / 3 % 2], &addr->remote_addr.sin.sin_addr);
+    pdu->transport_data = addr;
+    pdu->transport_data_length = sizeof(*addr);
+
+    snmp_pdu_add_variable(pdu, sysUpTime, OID_LENGTH(sysUpTime),
+                          ASN_TIMETICKS, &uptime, sizeof(uptime));
+    if (n / 6 % TRAP_OIDS == 0) {
+        snmp_pdu_add_variable(pdu, snmpTrapOID, OID_LENGTH(snmpTrapOID),
+                              ASN_OBJECT_ID, linkDown, sizeof(linkDown));
+    } else {
+        enterprise[OID_LENGTH(enterprise) - 1] = n / 6 % TRAP_OIDS;
+        snmp_pdu_add_variable(pdu, snmpTrapOID, OID_LENGTH(snmpTrapOID),
+                              ASN_OBJECT_ID, enterprise, sizeof(enterprise));
+    }
+    return pdu;
+}
+
+/*
+ * the authorization before the cache: every VACM view type checked
+ * for every notification
+ */
+static int
+auth_by_vacm(netsnmp_pdu *pdu)
+{
+    int             authtypes = 0;
+#ifdef USING_MIBII_VACM_CONF_MODULE
+    netsnmp_variable_list *var = pdu->variables->next_variable;
+    int             i;
+
+    for (i = 0; i < VACM_MAX_VIEWS; i++)
+        if (vacm_check_view_contents(pdu, var->val.objid,
+                                     var->val_len / sizeof(oid), 0, i,
+                                     VACM_CHECK_VIEW_CONTENTS_DNE_CONTEXT_OK)
+            == VACM_SUCCESS)
+            authtypes |= 1 << i;
+#endif
+    return authtypes;
+}
+
+static void
+write_config(const char *config)
+{
+    FILE           *fp = fopen(conf_file, "w");
+
+    if (fp) {
+        fputs(config, fp);
+        fclose(fp);
+    }
+}
+
+/* the actions netsnmp_trapd_auth authorized a notification for */
+static int
+auth_cached(netsnmp_pdu *pdu, netsnmp_transport *transport,
+            netsnmp_trapd_handler *handler)
+{
+    int             authtypes = 0, i;
+
+    if (netsnmp_trapd_auth(pdu, transport, handler) !=
+        NETSNMPTRAPD_HANDLER_OK)
+        return 0;
+    for (i = 0; i < VACM_MAX_VIEWS; i++)
+        if (netsnmp_trapd_check_auth(1 << i))
+            authtypes |= 1 << i;
+    return authtypes;
+}
+
+/* the counts logged by shutdown_netsnmp_trapd_auth() */
+static int
+auth_cache_stats(u_long *hits, u_long *misses)
+{
+    FILE           *fp;
+    char            line[BUFSIZ], *cp;
+    int             found = 0;
+
+    shutdown_netsnmp_trapd_auth();
+    fp = fopen(log_file, "r");
+    if (NULL == fp)
+        return -1;
+    while (fgets(line, sizeof(line), fp))
+        if ((cp = strstr(line, "authorization cache: ")) != NULL &&
+            sscanf(cp, "authorization cache: %lu hits, %lu misses",
+                   hits, misses) == 2)
+            found = 1;
+    fclose(fp);
+    return found ? 0 : -1;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static netsnmp_pdu *pdus[6 * TRAP_OIDS];
+    netsnmp_transport transport;
+    netsnmp_trapd_handler handler;
+    struct timeval  start;
+    double          cached_us, vacm_us;
+    char           *cmd = NULL;
+    u_long          hits, misses, unknown;
+    int             i, ok, npdus = 6 * TRAP_OIDS;
+
+#ifndef USING_MIBII_VACM_CONF_MODULE
+    printf("1..0 # SKIP mibII/vacm_conf isn't built\n");
+    return 0;
+#endif
+    if (NULL == mkdtemp(dir)) {
+        printf("1..0 # SKIP can't create a temporary directory\n");
+        return 0;
+    }
+    snprintf(conf_file, sizeof(conf_file), "%s/snmptrapd.conf", dir);
+    snprintf(log_file, sizeof(log_file), "%s/log", dir);
+
+    /*
+     * public may do anything with any notification; private may only
+     * log enterprise notifications, and only from 127.0.0.1
+     */
+    write_config("authCommunity log,execute,net public\n"
+                 "authCommunity log private 127.0.0.1 .1.3.6.1.4.1\n");
+    setenv("SNMPCONFPATH", dir, 1);
+    setenv("SNMP_PERSISTENT_DIR", dir, 1);
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_ROLE,
+                           0);
+    snmp_enable_filelog(log_file, 0);
+    init_agent("snmptrapd");
+    init_netsnmp_trapd_auth();
+    init_snmp("snmptrapd");
+
+    memset(&transport, 0, sizeof(transport));
+    memset(&handler, 0, sizeof(handler));
+    for (i = 0; i < npdus; i++)
+        pdus[i] = notification(i);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < TRAPS; i++)
+        auth_cached(pdus[i % npdus], &transport, &handler);
+    cached_us = perf_elapsed_us(&start);
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < TRAPS; i++)
+        auth_by_vacm(pdus[i % npdus]);
+    vacm_us = perf_elapsed_us(&start);
+
+    printf("# %d notifications from %d senders, %d trap OIDs\n", TRAPS, 6,
+           TRAP_OIDS);
+    PERF_FASTER(cached_us, "cached", vacm_us, "VACM checks");
+
+    for (i = 0, ok = 1; i < npdus; i++) {
+        int             a = auth_cached(pdus[i], &transport, &handler);
+        int             b = auth_by_vacm(pdus[i]);
+
+        if (a != b) {
+            printf("# notification %d: cached %x, VACM checks %x\n", i, a,
+                   b);
+            ok = 0;
+        }
+    }
+    OK(ok, "the same actions authorized as by the VACM checks");
+    OK(auth_by_vacm(pdus[0]) == TRAP_AUTH_ALL &&
+       auth_by_vacm(pdus[1]) == 0 && auth_by_vacm(pdus[6 + 1]) ==
+       TRAP_AUTH_LOG && auth_by_vacm(pdus[6 + 4]) == 0 &&
+       auth_by_vacm(pdus[6 + 2]) == 0, "authCommunity rules applied");
+
+    /*
+     * other, and private from 10.1.2.3, have no security name and are
+     * checked every time
+     */
+    for (i = 0, unknown = 0; i < TRAPS + npdus; i++)
+        if (i % npdus % 3 == 2 || i % npdus % 6 == 4)
+            unknown++;
+    OK(auth_cache_stats(&hits, &misses) == 0 &&
+       hits + misses == (u_long) (TRAPS + npdus) &&
+       misses >= unknown && misses < unknown + npdus,
+       "hits and misses counted");
+    printf("# %lu hits, %lu misses (%lu without a security name)\n", hits,
+           misses, unknown);
+
+    /*
+     * public may no longer do anything; private may log and forward any
+     * notification, from anywhere
+     */
+    auth_cached(pdus[0], &transport, &handler);
+    auth_cached(pdus[1], &transport, &handler);
+    write_config("authCommunity log,net private\n");
+    free_config();
+    read_configs();
+    OK(auth_cached(pdus[0], &transport, &handler) == 0 &&
+       auth_cached(pdus[1], &transport, &handler) ==
+       (TRAP_AUTH_LOG | TRAP_AUTH_NET),
+       "cache emptied when the configuration is read");
+
+    for (i = 0; i < npdus; i++)
+        snmp_free_pdu(pdus[i]);
+    snmp_shutdown("snmptrapd");
+    shutdown_agent();
+    if (asprintf(&cmd, "rm -rf %s", dir) >= 0 && system(cmd) != 0)
+        printf("# could not remove %s\n", dir);
+    free(cmd);
+
+    PLAN(__test_counter);
+    return 0;
+}
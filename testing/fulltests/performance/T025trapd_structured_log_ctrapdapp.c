@@ -0,0 +1,404 @@
+/*
+ * HEADER snmptrapd structured logs
+ *
+ * Logs a burst of notifications with a mix of varbind types, as text
+ * with print_handler the way snmptrapd logs them to a file, and then as
+ * JSON lines and as binary records with structured_handler, and times
+ * each.  Every notification must be written as one record, with its
+ * trap OID and typed varbinds, in few writes; records must be written
+ * once structuredLogFlushInterval has passed, or as soon as there are
+ * structuredLogBufferSize bytes of them.
+ */
+
+#include <net-snmp/net-snmp-config.h>
+#include <net-snmp/net-snmp-includes.h>
+#include <net-snmp/agent/net-snmp-agent-includes.h>
+#include <net-snmp/library/testing.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../../../apps/snmptrapd_handlers.h"
+#include "../../../apps/snmptrapd_structured.h"
+#include "perftest.h"
+
+#define TRAPS           20000
+
+static char     dir[] = "/tmp/trapd-structured-XXXXXX";
+static char     log_file[BUFSIZ], json_file[BUFSIZ], bin_file[BUFSIZ];
+static char     flush_file[BUFSIZ];
+
+static char    *
+fmtaddr(netsnmp_transport *t, const void *data, int len)
+{
+    return strdup("UDP: [10.1.2.3]:1162->[127.0.0.1]:162");
+}
+
+/* an SNMPv2c linkDown, as the UDP transport would have received it */
+static netsnmp_pdu *
+notification(void)
+{
+    static oid      sysUpTime[] = { 1, 3, 6, 1, 2, 1, 1, 3, 0 };
+    static oid      snmpTrapOID[] = { 1, 3, 6, 1, 6, 3, 1, 1, 4, 1, 0 };
+    static oid      linkDown[] = { 1, 3, 6, 1, 6, 3, 1, 1, 5, 3 };
+    static oid      ifIndex[] = { 1, 3, 6, 1, 2, 1, 2, 2, 1, 1, 7 };
+    static oid      ifDescr[] = { 1, 3, 6, 1, 2, 1, 2, 2, 1, 2, 7 };
+    static oid      ifPhysAddress[] = { 1, 3, 6, 1, 2, 1, 2, 2, 1, 6, 7 };
+    static oid      ifHCInOctets[] = { 1, 3, 6, 1, 2, 1, 31, 1, 1, 1, 6, 7 };
+    static oid      ipAdEntAddr[] = { 1, 3, 6, 1, 2, 1, 4, 20, 1, 1, 10,
+        1, 2, 3 };
+    static u_char   mac[] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0xff };
+    static u_char   ip[] = { 10, 1, 2, 3 };
+    struct counter64 octets = { 1, 5 };
+    long            uptime = 42, index = 7;
+    netsnmp_pdu    *pdu;
+
+    pdu = snmp_pdu_create(SNMP_MSG_TRAP2);
+    pdu->version = SNMP_VERSION_2c;
+    pdu->securityModel = SNMP_SEC_MODEL_SNMPv2c;
+    pdu->securityLevel = SNMP_SEC_LEVEL_NOAUTH;
+    pdu->reqid = 1234;
+    pdu->community = (u_char *) strdup("public");
+    pdu->community_len = strlen("public");
+
+    snmp_pdu_add_variable(pdu, sysUpTime, OID_LENGTH(sysUpTime),
+                          ASN_TIMETICKS, &uptime, sizeof(uptime));
+    snmp_pdu_add_variable(pdu, snmpTrapOID, OID_LENGTH(snmpTrapOID),
+                          ASN_OBJECT_ID, linkDown, sizeof(linkDown));
+    snmp_pdu_add_variable(pdu, ifIndex, OID_LENGTH(ifIndex), ASN_INTEGER,
+                          &index, sizeof(index));
+    snmp_pdu_add_variable(pdu, ifDescr, OID_LENGTH(ifDescr), ASN_OCTET_STR,
+                          "eth0 \"uplink\"", strlen("eth0 \"uplink\""));
+    snmp_pdu_add_variable(pdu, ifPhysAddress, OID_LENGTH(ifPhysAddress),
+                          ASN_OCTET_STR, mac, sizeof(mac));
+    snmp_pdu_add_variable(pdu, ifHCInOctets, OID_LENGTH(ifHCInOctets),
+                          ASN_COUNTER64, &octets, sizeof(octets));
+    snmp_pdu_add_variable(pdu, ipAdEntAddr, OID_LENGTH(ipAdEntAddr),
+                          ASN_IPADDRESS, ip, sizeof(ip));
+    return pdu;
+}
+
+/* an SNMPv1 enterprise-specific trap */
+static netsnmp_pdu *
+v1_trap(void)
+{
+    static oid      enterprise[] = { 1, 3, 6, 1, 4, 1, 8072, 4 };
+    netsnmp_pdu    *pdu;
+
+    pdu = snmp_pdu_create(SNMP_MSG_TRAP);
+    pdu->version = SNMP_VERSION_1;
+    pdu->securityModel = SNMP_SEC_MODEL_SNMPv1;
+    pdu->community = (u_char *) strdup("public");
+    pdu->community_len = strlen("public");
+    pdu->enterprise = snmp_duplicate_objid(enterprise,
+                                           OID_LENGTH(enterprise));
+    pdu->enterprise_length = OID_LENGTH(enterprise);
+    pdu->trap_type = SNMP_TRAP_ENTERPRISESPECIFIC;
+    pdu->specific_type = 7;
+    pdu->time = 99;
+    inet_pton(AF_INET, "10.1.2.3", pdu->agent_addr);
+    return pdu;
+}
+
+static double
+burst(netsnmp_pdu *pdu, netsnmp_transport *transport,
+      Netsnmp_Trap_Handler *handler)
+{
+    struct timeval  start;
+    int             i;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < TRAPS; i++)
+        handler(pdu, transport, NULL);
+    snmptrapd_free_structured();        /* what is still buffered */
+    return perf_elapsed_us(&start);
+}
+
+static long
+file_size(const char *file)
+{
+    struct stat     st;
+
+    return stat(file, &st) == 0 ? (long) st.st_size : -1;
+}
+
+static int
+count_lines(const char *file, char *first, size_t size)
+{
+    FILE           *fp = fopen(file, "r");
+    char           *line = NULL;
+    size_t          len = 0;
+    int             n = 0;
+
+    if (NULL == fp)
+        return 0;
+    while (getline(&line, &len, fp) > 0) {
+        if (n++ == 0 && first)
+            snprintf(first, size, "%s", line);
+    }
+    free(line);
+    fclose(fp);
+    return n;
+}
+
+/* the counts logged by snmptrapd_free_structured() for a file */
+static int
+structured_stats(const char *file, u_long *records, u_long *writes)
+{
+    FILE           *fp;
+    char            line[BUFSIZ], prefix[BUFSIZ], *cp;
+    u_long          bytes, failed;
+    int             found = 0;
+
+    snprintf(prefix, sizeof(prefix), "structuredLog %s: ", file);
+    fp = fopen(log_file, "r");
+    if (NULL == fp)
+        return -1;
+    while (fgets(line, sizeof(line), fp))
+        if ((cp = strstr(line, prefix)) != NULL &&
+            sscanf(cp + strlen(prefix), "%lu records, %lu bytes in %lu "
+                   "writes, %lu failed", records, &bytes, writes,
+                   &failed) == 4 && failed == 0)
+            found = 1;
+    fclose(fp);
+    return found ? 0 : -1;
+}
+
+static u_long
+get_u(const u_char **cp, int bytes)
+{
+    u_long          value = 0;
+
+    while (bytes--)
+        value = value << 8 | *(*cp)++;
+    return value;
+}
+
+/*
+ * reads the binary records back; checks the first, and returns how many
+ * there are
+ */
+static int
+read_binary(const char *file, int *first_ok)
+{
+    static u_char   buf[1 << 16];
+    FILE           *fp = fopen(file, "rb");
+    const u_char   *cp;
+    u_long          len, subids, i;
+    int             n = 0, vars;
+
+    *first_ok = 0;
+    if (NULL == fp)
+        return 0;
+    while (fread(buf, 1, 4, fp) == 4) {
+        cp = buf;
+        len = get_u(&cp, 4);
+        if (len > sizeof(buf) || fread(buf, 1, len, fp) != len)
+            break;
+        if (n++ == 0) {
+            cp = buf;
+            if (get_u(&cp, 1) != 1 || get_u(&cp, 1) != SNMP_VERSION_2c ||
+                get_u(&cp, 1) != SNMP_MSG_TRAP2)
+                continue;
+            cp += 2 + 8;                        /* security, time */
+            if (get_u(&cp, 4) != 1234 || get_u(&cp, 4) != 0)
+                continue;
+            cp += get_u(&cp, 2);                /* source */
+            cp += get_u(&cp, 2);                /* agent address */
+            if (get_u(&cp, 2) != 6 || memcmp(cp, "public", 6))
+                continue;
+            cp += 6;
+            cp += get_u(&cp, 2);                /* context */
+            subids = get_u(&cp, 1);             /* trap OID */
+            for (i = 0; i < subids; i++)
+                get_u(&cp, 4);
+            if (subids != 10 || cp[-1] != 3)
+                continue;
+            vars = get_u(&cp, 2);
+            cp += 1 + 9 * 4 + 1 + 2 + 4;        /* sysUpTime.0 */
+            cp += 1 + 11 * 4 + 1 + 2;           /* snmpTrapOID.0 */
+            cp += 10 * 4;
+            cp += 1 + 11 * 4;                   /* ifIndex.7 */
+            *first_ok = vars == 7 && get_u(&cp, 1) == ASN_INTEGER &&
+                get_u(&cp, 2) == 4 && get_u(&cp, 4) == 7;
+        }
+    }
+    fclose(fp);
+    return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+    netsnmp_transport transport;
+    netsnmp_pdu    *pdu, *v1;
+    double          text_us, json_us, binary_us;
+    long            text_bytes, json_bytes, binary_bytes;
+    u_long          records, writes;
+    char            line[BUFSIZ], first[BUFSIZ], *cmd = NULL;
+    int             first_ok, n;
+
+    if (NULL == mkdtemp(dir)) {
+        printf("1..0 # SKIP can't create a temporary directory\n");
+        return 0;
+    }
+    snprintf(log_file, sizeof(log_file), "%s/log", dir);
+    snprintf(json_file, sizeof(json_file), "%s/json", dir);
+    snprintf(bin_file, sizeof(bin_file), "%s/binary", dir);
+    snprintf(flush_file, sizeof(flush_file), "%s/flush", dir);
+
+    netsnmp_ds_set_boolean(NETSNMP_DS_APPLICATION_ID, NETSNMP_DS_AGENT_ROLE,
+                           0);
+    netsnmp_ds_set_boolean(NETSNMP_DS_LIBRARY_ID,
+                           NETSNMP_DS_LIB_DONT_READ_CONFIGS, 1);
+    snmp_enable_filelog(log_file, 0);
+    init_agent("snmptrapd");
+    snmptrapd_register_structured_configs();
+    init_snmp("snmptrapd");
+
+    memset(&transport, 0, sizeof(transport));
+    transport.f_fmtaddr = fmtaddr;
+    pdu = notification();
+    v1 = v1_trap();
+
+    /*
+     * the text snmptrapd logs by default, then the structured records
+     */
+    text_us = burst(pdu, &transport, print_handler);
+    text_bytes = file_size(log_file);
+    snprintf(line, sizeof(line), "structuredLog json %s", json_file);
+    netsnmp_config(line);
+    json_us = burst(pdu, &transport, structured_handler);
+    json_bytes = file_size(json_file);
+    snprintf(line, sizeof(line), "structuredLog binary %s", bin_file);
+    netsnmp_config(line);
+    binary_us = burst(pdu, &transport, structured_handler);
+    binary_bytes = file_size(bin_file);
+
+    printf("# %d notifications: text %ld bytes, JSON %ld bytes, binary %ld "
+           "bytes\n", TRAPS, text_bytes, json_bytes, binary_bytes);
+    PERF_FASTER(json_us, "JSON", text_us, "text");
+    PERF_FASTER(binary_us, "binary", json_us, "JSON");
+
+    n = count_lines(json_file, first, sizeof(first));
+    OKF(n == TRAPS, ("%d of %d JSON lines", n, TRAPS));
+    OKF(strstr(first, "\"source\":\"UDP: [10.1.2.3]:1162->[127.0.0.1]:162\"")
+        && strstr(first, "\"version\":\"2c\",\"type\":\"TRAP2\"")
+        && strstr(first, "\"requestID\":1234")
+        && strstr(first, "\"community\":\"public\"")
+        && strstr(first, "\"trapOID\":\".1.3.6.1.6.3.1.1.5.3\""),
+        ("notification in the JSON: %s", first));
+    OKF(strstr(first, "{\"oid\":\".1.3.6.1.2.1.2.2.1.1.7\",\"type\":"
+               "\"INTEGER\",\"value\":7}")
+        && strstr(first, "\"value\":\"eth0 \\\"uplink\\\"\"")
+        && strstr(first, "\"type\":\"OCTET STRING\",\"hex\":\"0011223344ff\"")
+        && strstr(first, "\"type\":\"Counter64\",\"value\":4294967301}")
+        && strstr(first, "\"type\":\"IpAddress\",\"value\":\"10.1.2.3\"")
+        && strstr(first, "\"type\":\"TimeTicks\",\"value\":42}"),
+        ("typed varbinds in the JSON: %s", first));
+    OK(structured_stats(json_file, &records, &writes) == 0 &&
+       records == TRAPS && (writes - 1) * 65536 <= (u_long) json_bytes,
+       "JSON written in batches of the buffer size");
+    printf("# JSON: %lu records in %lu writes\n", records, writes);
+
+    n = read_binary(bin_file, &first_ok);
+    OKF(n == TRAPS, ("%d of %d binary records", n, TRAPS));
+    OK(first_ok, "notification in the binary record");
+    OK(structured_stats(bin_file, &records, &writes) == 0 &&
+       records == TRAPS && (writes - 1) * 65536 <= (u_long) binary_bytes,
+       "binary written in batches of the buffer size");
+
+    /*
+     * written at the end of the event loop pass, or when the buffer holds
+     * structuredLogBufferSize bytes
+     */
+    netsnmp_config(strcpy(line, "structuredLogFlushInterval 0"));
+    snprintf(line, sizeof(line), "structuredLog json %s", flush_file);
+    netsnmp_config(line);
+    structured_handler(pdu, &transport, NULL);
+    structured_handler(v1, &transport, NULL);
+    n = count_lines(flush_file, NULL, 0);
+    run_alarms();
+    OKF(n == 0 && count_lines(flush_file, first, sizeof(first)) == 2,
+        ("%d lines written before the flush, %d after", n,
+         count_lines(flush_file, NULL, 0)));
+    OKF(strstr(first, "\"enterprise\":\".1.3.6.1.4.1.8072.4\"") == NULL,
+        ("first line is the SNMPv2c notification: %s", first));
+    netsnmp_config(strcpy(line, "structuredLogBufferSize 1"));
+    structured_handler(v1, &transport, NULL);
+    n = count_lines(flush_file, NULL, 0);
+    OKF(n == 3, ("%d lines written with a 1 byte buffer", n));
+    snmptrapd_free_structured();
+    {
+        FILE           *fp = fopen(flush_file, "r");
+
+        while (fp && fgets(first, sizeof(first), fp))
+            ;
+        if (fp)
+            fclose(fp);
+    }
+    OKF(strstr(first, "\"version\":\"1\",\"type\":\"TRAP\"")
+        && strstr(first, "\"enterprise\":\".1.3.6.1.4.1.8072.4\"")
+        && strstr(first, "\"agentAddress\":\"10.1.2.3\"")
+        && strstr(first, "\"specificTrap\":7,\"uptime\":99")
+        && strstr(first, "\"trapOID\":\".1.3.6.1.4.1.8072.4.0.7\"")
+        && strstr(first, "\"varbinds\":[]}"),
+        ("SNMPv1 trap in the JSON: %s", first));
+
+#ifdef NETSNMP_WITH_OPAQUE_SPECIAL_TYPES
+    /* JSON has no NaN or Infinity: they are written as null */
+    {
+        static oid      nsExtendOutput[] = { 1, 3, 6, 1, 4, 1, 8072, 1, 3,
+            2, 3, 1, 1, 1 };
+        netsnmp_pdu    *floats = snmp_clone_pdu(pdu);
+        FILE           *fp;
+        float           f = NAN;
+        double          d = -INFINITY, ok = 0.5;
+
+        snmp_pdu_add_variable(floats, nsExtendOutput,
+                              OID_LENGTH(nsExtendOutput), ASN_OPAQUE_FLOAT,
+                              &f, sizeof(f));
+        snmp_pdu_add_variable(floats, nsExtendOutput,
+                              OID_LENGTH(nsExtendOutput), ASN_OPAQUE_DOUBLE,
+                              &d, sizeof(d));
+        snmp_pdu_add_variable(floats, nsExtendOutput,
+                              OID_LENGTH(nsExtendOutput), ASN_OPAQUE_DOUBLE,
+                              &ok, sizeof(ok));
+        snprintf(line, sizeof(line), "structuredLog json %s", json_file);
+        netsnmp_config(line);
+        unlink(json_file);
+        structured_handler(floats, &transport, NULL);
+        snmptrapd_free_structured();
+        snmp_free_pdu(floats);
+        first[0] = '\0';
+        fp = fopen(json_file, "r");
+        if (fp) {
+            if (!fgets(first, sizeof(first), fp))
+                first[0] = '\0';
+            fclose(fp);
+        }
+        OKF(strstr(first, "\"type\":\"Opaque Float\",\"value\":null}")
+            && strstr(first, "\"type\":\"Opaque Double\",\"value\":null}")
+            && strstr(first, "\"type\":\"Opaque Double\",\"value\":0.5}"),
+            ("non-finite floats in the JSON: %s", first));
+    }
+#endif
+
+    snmp_free_pdu(pdu);
+    snmp_free_pdu(v1);
+    snmp_shutdown("snmptrapd");
+    shutdown_agent();
+    if (asprintf(&cmd, "rm -rf %s", dir) >= 0 && system(cmd) != 0)
+        printf("# could not remove %s\n", dir);
+    free(cmd);
+
+    PLAN(__test_counter);
+    return 0;
+}
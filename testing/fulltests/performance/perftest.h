@@ -0,0 +1,42 @@
+#ifndef NETSNMP_PERFTEST_H
+#define NETSNMP_PERFTEST_H
+
+/*
+ * Timing helpers for the performance tests, to be included after
+ * <net-snmp/library/testing.h>.  A test times what it measures with
+ *
+ *     struct timeval start;
+ *
+ *     gettimeofday(&start, NULL);
+ *     ...
+ *     usec = perf_elapsed_us(&start);
+ *
+ * and compares two ways of doing the same thing with PERF_FASTER().
+ */
+
+#include <sys/time.h>
+
+/* microseconds since start */
+static double
+perf_elapsed_us(const struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return (end.tv_sec - start->tv_sec) * 1e6 +
+        (end.tv_usec - start->tv_usec);
+}
+
+#define perf_elapsed_ms(start)  (perf_elapsed_us(start) / 1e3)
+
+/*
+ * passes if what took fast_us took less time than what took slow_us, and
+ * reports both, eg "trie lookups: 1234 us, list scan: 56789 us (x46.02)"
+ */
+#define PERF_FASTER(fast_us, fast_what, slow_us, slow_what)              \
+    OKF((fast_us) < (slow_us),                                            \
+        ("%s: %.0f us, %s: %.0f us (x%.2f)", fast_what, (double) (fast_us), \
+         slow_what, (double) (slow_us),                                   \
+         (fast_us) > 0 ? (double) (slow_us) / (fast_us) : 0.0))
+
+#endif /* NETSNMP_PERFTEST_H */
@@ -99,6 +99,10 @@ SOURCE=..\..\apps\snmptrapd_handlers.c
 
 SOURCE=..\..\apps\snmptrapd_log.c
 # End Source File
+# Begin Source File
+
+SOURCE=..\..\apps\snmptrapd_structured.c
+# End Source File
 # End Group
 # Begin Group "Header Files"
 
@@ -119,6 +123,10 @@ SOURCE="..\..\apps\snmptrapd_handlers.h"
 
 SOURCE="..\..\apps\snmptrapd_log.h"
 # End Source File
+# Begin Source File
+
+SOURCE="..\..\apps\snmptrapd_structured.h"
+# End Source File
 # End Group
 # End Target
 # End Project